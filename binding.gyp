@@ -1,9 +1,28 @@
 {
+  "variables": {
+    "native_benchmark%": "<!(node -p \"process.env.WEBP_SCREENSHOT_NATIVE_BENCHMARK || 0\")"
+  },
   "targets": [
     {
       "target_name": "webp_screenshot",
       "sources": [
-        "src/native/screenshot.cc"
+        "src/native/screenshot.cc",
+        "src/native/webp_encoder.cc",
+        "src/native/content_analyzer.cc",
+        "src/native/encode_cost_model.cc",
+        "src/native/multi_display_capture.cc",
+        "src/native/animation_recorder.cc",
+        "src/native/tile_cache.cc",
+        "src/native/warmup.cc",
+        "src/native/capture_session.cc",
+        "src/native/shared_frame_ring.cc",
+        "src/native/thread_placement.cc",
+        "src/native/memory_pool.cc",
+        "src/native/performance_stats.cc",
+        "src/native/simd_converter.cc",
+        "src/native/webp_simd_encoder.cc",
+        "src/native/gpu_webp_encoder.cc",
+        "src/native/ultra_streaming_pipeline.cc"
       ],
       "include_dirs": [
       ],
@@ -14,10 +33,19 @@
           "OS==\"win\"",
           {
             "sources": [
+              "src/native/windows/screenshot.cc",
+              "src/native/windows/capture_api.cc",
+              "src/native/windows/gpu_yuv_converter.cc",
+              "src/native/windows/graphics_capture_stream.cc"
             ],
             "libraries": [
               "-lgdi32",
-              "-luser32"
+              "-luser32",
+              "-ldxgi",
+              "-ld3d11",
+              "-ld3dcompiler",
+              "-lavrt",
+              "-llibwebp"
             ],
             "defines": [
               "_WIN32_WINNT=0x0A00",
@@ -34,7 +62,6 @@
                 "FavorSizeOrSpeed": 1,
                 "AdditionalOptions": [
                   "/std:c++17",
-                  "/arch:AVX2",
                   "/GL",
                   "/Oi",
                   "/fp:fast"
@@ -51,16 +78,23 @@
           {
             "sources": [
               "src/native/macos/screenshot.mm",
-              "src/native/macos/capture_manager.mm",
-              "src/native/macos/permissions.mm"
+              "src/native/macos/screencapturekit_capture.mm"
             ],
             "libraries": [
               "-framework CoreGraphics",
               "-framework CoreFoundation",
               "-framework AppKit",
-              "-framework AVFoundation"
+              "-framework AVFoundation",
+              "-framework CoreMedia",
+              "-framework CoreVideo",
+              "-weak_framework ScreenCaptureKit",
+              "-framework Foundation",
+              "-framework Metal",
+              "-framework MetalPerformanceShaders",
+              "-lwebp"
             ],
             "xcode_settings": {
+              "GCC_INPUT_FILETYPE": "sourcecode.cpp.objcpp",
               "CLANG_CXX_LANGUAGE_STANDARD": "c++17",
               "CLANG_CXX_LIBRARY": "libc++",
               "MACOSX_DEPLOYMENT_TARGET": "10.14",
@@ -68,9 +102,6 @@
               "GCC_OPTIMIZATION_LEVEL": "3",
               "LLVM_LTO": "YES",
               "OTHER_CPLUSPLUSFLAGS": [
-                "-march=native",
-                "-mavx2",
-                "-msse4.1",
                 "-flto",
                 "-ffast-math",
                 "-funroll-loops"
@@ -90,16 +121,17 @@
               "-lX11",
               "-lXrandr",
               "-lXfixes",
-              "-lXext"
+              "-lXdamage",
+              "-lXcomposite",
+              "-lXext",
+              "-lrt",
+              "-lwebp"
             ],
             "cflags_cc": [
               "-std=c++17",
               "-fexceptions",
               "-fPIC",
               "-O3",
-              "-march=native",
-              "-mavx2",
-              "-msse4.1",
               "-flto",
               "-ffast-math",
               "-funroll-loops",
@@ -110,25 +142,80 @@
                 "-lX11",
                 "-lXrandr",
                 "-lXfixes",
-                "-lXext"
+                "-lXdamage",
+                "-lXcomposite",
+                "-lXext",
+                "-lrt",
+                "-lwebp"
               ],
               "ldflags": [
                 "-flto",
                 "-O3"
               ]
             },
+            "variables": {
+              "has_wayland": "<!(pkg-config --exists wayland-client && command -v wayland-scanner >/dev/null && echo 1 || echo 0)",
+              "has_gbm": "<!(pkg-config --exists gbm wayland-protocols && echo 1 || echo 0)"
+            },
             "conditions": [
               [
-                "pkg-config --exists wayland-client 2>/dev/null",
+                "has_wayland==1",
                 {
                   "libraries": [
-                    "<!@(pkg-config --libs wayland-client 2>/dev/null || echo '')"
+                    "<!@(pkg-config --libs wayland-client)"
                   ],
                   "include_dirs": [
-                    "<!@(pkg-config --cflags-only-I wayland-client 2>/dev/null | sed 's/-I//g' || echo '')"
+                    "<!@(pkg-config --cflags-only-I wayland-client | sed 's/-I//g')",
+                    "<(SHARED_INTERMEDIATE_DIR)/wayland-protocols"
                   ],
                   "defines": [
                     "HAVE_WAYLAND=1"
+                  ],
+                  "actions": [
+                    {
+                      "action_name": "wlr_screencopy_client_header",
+                      "inputs": ["src/native/linux/protocols/wlr-screencopy-unstable-v1.xml"],
+                      "outputs": ["<(SHARED_INTERMEDIATE_DIR)/wayland-protocols/wlr-screencopy-unstable-v1-client-protocol.h"],
+                      "action": ["wayland-scanner", "client-header", "<@(_inputs)", "<@(_outputs)"]
+                    },
+                    {
+                      "action_name": "wlr_screencopy_private_code",
+                      "inputs": ["src/native/linux/protocols/wlr-screencopy-unstable-v1.xml"],
+                      "outputs": ["<(SHARED_INTERMEDIATE_DIR)/wayland-protocols/wlr-screencopy-unstable-v1-protocol.c"],
+                      "action": ["wayland-scanner", "private-code", "<@(_inputs)", "<@(_outputs)"],
+                      "process_outputs_as_sources": 1
+                    }
+                  ],
+                  "conditions": [
+                    [
+                      "has_gbm==1",
+                      {
+                        "variables": {
+                          "linux_dmabuf_xml": "<!(pkg-config --variable=pkgdatadir wayland-protocols)/unstable/linux-dmabuf/linux-dmabuf-unstable-v1.xml"
+                        },
+                        "libraries": [
+                          "<!@(pkg-config --libs gbm)"
+                        ],
+                        "defines": [
+                          "HAVE_GBM=1"
+                        ],
+                        "actions": [
+                          {
+                            "action_name": "linux_dmabuf_client_header",
+                            "inputs": ["<(linux_dmabuf_xml)"],
+                            "outputs": ["<(SHARED_INTERMEDIATE_DIR)/wayland-protocols/linux-dmabuf-unstable-v1-client-protocol.h"],
+                            "action": ["wayland-scanner", "client-header", "<@(_inputs)", "<@(_outputs)"]
+                          },
+                          {
+                            "action_name": "linux_dmabuf_private_code",
+                            "inputs": ["<(linux_dmabuf_xml)"],
+                            "outputs": ["<(SHARED_INTERMEDIATE_DIR)/wayland-protocols/linux-dmabuf-unstable-v1-protocol.c"],
+                            "action": ["wayland-scanner", "private-code", "<@(_inputs)", "<@(_outputs)"],
+                            "process_outputs_as_sources": 1
+                          }
+                        ]
+                      }
+                    ]
                   ]
                 },
                 {
@@ -142,5 +229,112 @@
         ]
       ]
     }
+  ],
+  "conditions": [
+    [
+      "native_benchmark==1",
+      {
+        "targets": [
+          {
+            "target_name": "native_benchmark",
+            "type": "executable",
+            "win_delay_load_hook": "false",
+            "sources": [
+              "test/performance/native/native_benchmark.cc",
+              "src/native/webp_encoder.cc",
+              "src/native/content_analyzer.cc",
+              "src/native/encode_cost_model.cc",
+              "src/native/multi_display_capture.cc",
+              "src/native/animation_recorder.cc",
+              "src/native/tile_cache.cc",
+              "src/native/warmup.cc",
+              "src/native/capture_session.cc",
+              "src/native/shared_frame_ring.cc",
+              "src/native/thread_placement.cc",
+              "src/native/memory_pool.cc",
+              "src/native/performance_stats.cc",
+              "src/native/simd_converter.cc",
+              "src/native/webp_simd_encoder.cc",
+              "src/native/gpu_webp_encoder.cc",
+              "src/native/ultra_streaming_pipeline.cc"
+            ],
+            "include_dirs": [
+              "src/native"
+            ],
+            "conditions": [
+              [
+                "OS==\"win\"",
+                {
+                  "sources": [
+                    "src/native/windows/gpu_yuv_converter.cc"
+                  ],
+                  "libraries": [
+                    "-ld3d11",
+                    "-ld3dcompiler",
+                    "-lavrt",
+                    "-llibwebp"
+                  ],
+                  "defines": [
+                    "_WIN32_WINNT=0x0A00",
+                    "WINVER=0x0A00",
+                    "NOMINMAX",
+                    "WIN32_LEAN_AND_MEAN"
+                  ],
+                  "msvs_settings": {
+                    "VCCLCompilerTool": {
+                      "ExceptionHandling": 1,
+                      "Optimization": 2,
+                      "AdditionalOptions": [
+                        "/std:c++17"
+                      ]
+                    },
+                    "VCLinkerTool": {
+                      "SubSystem": 1
+                    }
+                  }
+                }
+              ],
+              [
+                "OS==\"mac\"",
+                {
+                  "libraries": [
+                    "-framework Foundation",
+                    "-framework Metal",
+                    "-framework MetalPerformanceShaders",
+                    "-lwebp"
+                  ],
+                  "xcode_settings": {
+                    "GCC_INPUT_FILETYPE": "sourcecode.cpp.objcpp",
+                    "CLANG_CXX_LANGUAGE_STANDARD": "c++17",
+                    "CLANG_CXX_LIBRARY": "libc++",
+                    "MACOSX_DEPLOYMENT_TARGET": "10.14",
+                    "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
+                    "GCC_OPTIMIZATION_LEVEL": "3"
+                  }
+                }
+              ],
+              [
+                "OS==\"linux\"",
+                {
+                  "cflags_cc": [
+                    "-std=c++17",
+                    "-fexceptions",
+                    "-O3",
+                    "-pthread"
+                  ],
+                  "ldflags": [
+                    "-pthread"
+                  ],
+                  "libraries": [
+                    "-lrt",
+                    "-lwebp"
+                  ]
+                }
+              ]
+            ]
+          }
+        ]
+      }
+    ]
   ]
-}
\ No newline at end of file
+}
@@ -0,0 +1,40 @@
+#!/usr/bin/env node
+
+/**
+ * Builds and runs the native microbenchmark (test/performance/native).
+ * Arguments are passed through, e.g.
+ *   npm run benchmark:native -- --sizes=4k --filter=encode. --output=bench.json
+ * Pass --skip-build to reuse the last build.
+ */
+
+const { spawnSync } = require('child_process');
+const fs = require('fs');
+const path = require('path');
+
+const root = path.join(__dirname, '..');
+const args = process.argv.slice(2);
+const skipBuild = args.includes('--skip-build');
+const benchmarkArgs = args.filter(arg => arg !== '--skip-build');
+
+const binary = path.join(root, 'build', 'Release',
+    process.platform === 'win32' ? 'native_benchmark.exe' : 'native_benchmark');
+
+if (!skipBuild) {
+    const build = spawnSync('node-gyp', ['rebuild'], {
+        cwd: root,
+        stdio: 'inherit',
+        shell: true,
+        env: { ...process.env, WEBP_SCREENSHOT_NATIVE_BENCHMARK: '1' }
+    });
+    if (build.status !== 0) {
+        process.exit(build.status || 1);
+    }
+}
+
+if (!fs.existsSync(binary)) {
+    console.error(`Native benchmark not found at ${binary}; run without --skip-build first`);
+    process.exit(1);
+}
+
+const run = spawnSync(binary, benchmarkArgs, { cwd: root, stdio: 'inherit' });
+process.exit(run.status === null ? 1 : run.status);
@@ -72,9 +72,11 @@ class WebPScreenshot {
 
         // Merge with default options
         const finalOptions = {
+            lossless: 0,
             quality: 80,
             method: 4,
             targetSize: 0,
+            maxOutputSize: 0,
             targetPsnr: 0.0,
             segments: 4,
             snsStrength: 50,
@@ -97,6 +99,9 @@ class WebPScreenshot {
             exact: 0,
             useDeltaPalette: 0,
             useSharpYuv: 0,
+            contentAdaptive: 0,
+            maxEncodeMs: 0,
+            tileCache: 0,
             ...options
         };
 
@@ -138,28 +143,151 @@ class WebPScreenshot {
     async captureAllDisplays(options = {}) {
         try {
             const displays = await this.getDisplays();
-            const results = [];
 
-            for (let i = 0; i < displays.length; i++) {
-                try {
-                    const result = await this.captureDisplay(i, options);
-                    results.push(result);
-                } catch (error) {
+            // Displays are captured concurrently so the frames are close in time
+            return await Promise.all(displays.map((display, i) =>
+                this.captureDisplay(i, options).catch(error => ({
                     // Continue with other displays even if one fails
-                    results.push({
-                        error: error.message,
-                        displayIndex: i,
-                        success: false
-                    });
-                }
-            }
-
-            return results;
+                    error: error.message,
+                    displayIndex: i,
+                    success: false
+                }))
+            ));
         } catch (error) {
             throw new Error(`Failed to capture all displays: ${error.message}`);
         }
     }
 
+    /**
+     * Do the one-time setup of the first capture and encode now: libwebp's
+     * tables, the GPU shader and the capture backend. Each step runs once per
+     * process, so later calls resolve immediately.
+     * @param {WarmupOptions} [options] - Steps to run (all by default)
+     * @returns {Promise<WarmupReport>}
+     */
+    async warmup(options = {}) {
+        if (this.fallbackMode) {
+            const startTime = Date.now();
+            // Loads libvips and its WebP saver
+            await sharp({
+                create: { width: 16, height: 16, channels: 4, background: { r: 0, g: 0, b: 0, alpha: 1 } }
+            }).webp().toBuffer();
+            return {
+                encoderReady: true,
+                gpuReady: false,
+                captureReady: false,
+                captureBackend: '',
+                encoderMs: Date.now() - startTime,
+                gpuMs: 0,
+                captureMs: 0
+            };
+        }
+
+        if (typeof nativeBinding.warmup !== 'function') {
+            return { encoderReady: false, gpuReady: false, captureReady: false, captureBackend: '',
+                encoderMs: 0, gpuMs: 0, captureMs: 0 };
+        }
+        return nativeBinding.warmup(options);
+    }
+
+    /**
+     * Encode RGBA pixels straight into a caller-owned buffer, e.g. a slot of
+     * a preallocated pool, without allocating a Buffer per frame
+     * @param {Buffer} output - Destination; the file is written from offset 0
+     * @param {Buffer} pixels - RGBA pixels
+     * @param {number} width - Width in pixels
+     * @param {number} height - Height in pixels
+     * @param {number} [stride=width*4] - Bytes per row
+     * @param {CaptureOptions} [options] - Encoding options
+     * @returns {Promise<EncodeIntoResult>}
+     */
+    async encodeInto(output, pixels, width, height, stride = width * 4, options = {}) {
+        if (this.fallbackMode || typeof nativeBinding.encodeWebPInto !== 'function') {
+            // Sharp has no caller-buffer output, so this path copies once
+            const webpBuffer = await sharp(this._packRows(pixels, width, height, stride),
+                { raw: { width, height, channels: 4 } })
+                .webp({ quality: Math.round(options.quality ?? 80), lossless: !!options.lossless })
+                .toBuffer();
+            if (options.maxOutputSize > 0 && webpBuffer.length > options.maxOutputSize) {
+                throw new Error(`Encoded image exceeds max_output_size (${webpBuffer.length} > ${options.maxOutputSize} bytes)`);
+            }
+            if (webpBuffer.length > output.length) {
+                return { bytesWritten: 0, requiredSize: webpBuffer.length };
+            }
+            webpBuffer.copy(output);
+            return { bytesWritten: webpBuffer.length, requiredSize: webpBuffer.length };
+        }
+        return nativeBinding.encodeWebPInto(output, pixels, width, height, stride, options);
+    }
+
+    /**
+     * Encode many RGBA frames of the same size with the same options. Whole
+     * frames encode in parallel, which scales better than tiling each frame.
+     * @param {Buffer[]} frames - RGBA pixels, one buffer per frame
+     * @param {number} width - Width in pixels
+     * @param {number} height - Height in pixels
+     * @param {number} [stride=width*4] - Bytes per row
+     * @param {CaptureOptions} [options] - Encoding options
+     * @returns {Promise<BatchEncodeResult>}
+     */
+    async encodeBatch(frames, width, height, stride = width * 4, options = {}) {
+        if (this.fallbackMode || typeof nativeBinding.encodeWebPBatchAsync !== 'function') {
+            const startTime = Date.now();
+            const settled = await Promise.allSettled(frames.map(async frame =>
+                sharp(this._packRows(frame, width, height, stride), { raw: { width, height, channels: 4 } })
+                    .webp({ quality: Math.round(options.quality ?? 80), lossless: !!options.lossless })
+                    .toBuffer()));
+            const elapsedMs = Date.now() - startTime;
+            const errors = settled.map(entry => entry.status === 'rejected' ? entry.reason.message : null);
+            return {
+                frames: settled.map(entry => entry.status === 'fulfilled' ? entry.value : null),
+                errors,
+                failedFrames: errors.filter(error => error !== null).length,
+                workers: 1,
+                elapsedMs,
+                framesPerSecond: elapsedMs > 0 ? frames.length * 1000 / elapsedMs : 0
+            };
+        }
+        return nativeBinding.encodeWebPBatchAsync(frames, width, height, stride, options);
+    }
+
+    /**
+     * Encode several sizes of one RGBA frame, e.g. full size, half size and a
+     * thumbnail. Natively the frame is converted to YUV420 once and every
+     * level is scaled from it and encoded in parallel.
+     * @param {Buffer} pixels - RGBA pixels
+     * @param {number} width - Width in pixels
+     * @param {number} height - Height in pixels
+     * @param {number} [stride=width*4] - Bytes per row
+     * @param {PyramidLevel[]} levels - Sizes to encode, each with its own options
+     * @returns {Promise<MultiResolutionLevel[]>} One entry per level, in the order given
+     */
+    async encodeMultiResolution(pixels, width, height, stride = width * 4, levels = [{ scale: 1 }]) {
+        if (this.fallbackMode || typeof nativeBinding.encodeMultiResolutionAsync !== 'function') {
+            const packed = this._packRows(pixels, width, height, stride);
+            return Promise.all(levels.map(async ({ scale = 1, maxDimension = 0, ...options } = {}) => {
+                let levelWidth = Math.max(1, Math.round(width * scale));
+                let levelHeight = Math.max(1, Math.round(height * scale));
+                const longer = Math.max(levelWidth, levelHeight);
+                if (maxDimension > 0 && longer > maxDimension) {
+                    levelWidth = Math.max(1, Math.round(levelWidth * maxDimension / longer));
+                    levelHeight = Math.max(1, Math.round(levelHeight * maxDimension / longer));
+                }
+                const level = { width: levelWidth, height: levelHeight, scaleFactor: levelWidth / width };
+                try {
+                    const data = await sharp(packed, { raw: { width, height, channels: 4 } })
+                        .resize(levelWidth, levelHeight)
+                        .webp({ quality: Math.round(options.quality ?? 80), lossless: !!options.lossless })
+                        .toBuffer();
+                    return { ...level, data, error: null };
+                } catch (error) {
+                    return { ...level, data: null, error: error.message };
+                }
+            }));
+        }
+        return nativeBinding.encodeMultiResolutionAsync(pixels, width, height, stride, levels);
+    }
+
     /**
      * Check if native WebP screenshot capture is supported
      * @returns {boolean}
@@ -222,6 +350,26 @@ class WebPScreenshot {
         };
     }
 
+    /**
+     * Get native per-stage latency histograms and copy/allocation counters
+     * @returns {NativePerformanceStats|null} null in fallback mode
+     */
+    getPerformanceStats() {
+        if (this.fallbackMode || typeof nativeBinding.getPerformanceStats !== 'function') {
+            return null;
+        }
+        return nativeBinding.getPerformanceStats();
+    }
+
+    /**
+     * Reset native per-stage statistics (process-wide)
+     */
+    resetPerformanceStats() {
+        if (!this.fallbackMode && typeof nativeBinding.resetPerformanceStats === 'function') {
+            nativeBinding.resetPerformanceStats();
+        }
+    }
+
     // Private methods
 
     /**
@@ -229,6 +377,11 @@ class WebPScreenshot {
      * @private
      */
     async _captureNative(displayIndex, options) {
+        // Capture and encode run on the libuv thread pool either way
+        if (typeof nativeBinding.captureDisplayAsync === 'function') {
+            return nativeBinding.captureDisplayAsync(displayIndex, options);
+        }
+
         return new Promise((resolve, reject) => {
             nativeBinding.captureDisplay(displayIndex, options, (error, result) => {
                 if (error) {
@@ -249,11 +402,24 @@ class WebPScreenshot {
             throw new Error('Sharp is not available for fallback WebP conversion');
         }
 
+        if (options.windowId) {
+            throw new Error('Window capture requires the native module');
+        }
+
         // For fallback, we need to use system screenshot tools
         const screenshot = await this._captureSystemScreenshot(displayIndex);
+
+        // System tools grab the whole display, so a region is cropped here
+        let image = sharp(screenshot.buffer);
+        let { width, height } = screenshot;
+        if (options.region) {
+            const region = this._clipRegion(options.region, width, height);
+            image = image.extract(region);
+            ({ width, height } = region);
+        }
         
         // Convert to WebP using Sharp
-        const webpBuffer = await sharp(screenshot.buffer)
+        const webpBuffer = await image
             .webp({
                 quality: Math.round(options.quality),
                 effort: Math.min(6, Math.max(0, options.method)),
@@ -265,13 +431,54 @@ class WebPScreenshot {
 
         return {
             data: webpBuffer,
-            width: screenshot.width,
-            height: screenshot.height,
+            width,
+            height,
             format: 'webp',
             success: true
         };
     }
 
+    /**
+     * Sharp's raw input has no row pitch, so padded rows are copied out
+     * tightly packed for the fallback; unpadded pixels are used as-is
+     * @private
+     */
+    _packRows(pixels, width, height, stride) {
+        const rowBytes = width * 4;
+        if (stride === rowBytes) {
+            return pixels;
+        }
+        if (stride < rowBytes) {
+            throw new Error('Stride is smaller than row size');
+        }
+        if (pixels.length < stride * (height - 1) + rowBytes) {
+            throw new Error('Buffer too small for the given dimensions');
+        }
+        const packed = Buffer.allocUnsafe(rowBytes * height);
+        for (let y = 0; y < height; y++) {
+            packed.set(pixels.subarray(y * stride, y * stride + rowBytes), y * rowBytes);
+        }
+        return packed;
+    }
+
+    /**
+     * Clip a capture region to the source the way the native backends do
+     * @private
+     */
+    _clipRegion(region, sourceWidth, sourceHeight) {
+        const left = Math.max(0, Math.floor(region.x || 0));
+        const top = Math.max(0, Math.floor(region.y || 0));
+        if (left >= sourceWidth || top >= sourceHeight) {
+            throw new Error(`Capture region lies outside the ${sourceWidth}x${sourceHeight} source`);
+        }
+        return {
+            left,
+            top,
+            width: region.width > 0 ? Math.min(Math.floor(region.width), sourceWidth - left) : sourceWidth - left,
+            height: region.height > 0 ? Math.min(Math.floor(region.height), sourceHeight - top) : sourceHeight - top
+        };
+    }
+
     /**
      * Capture screenshot using system tools (fallback)
      * @private
@@ -328,6 +535,12 @@ class WebPScreenshot {
     }
 }
 
+// WEBP_SCREENSHOT_WARMUP=1 starts the warmup while the host is still loading,
+// for CLIs and serverless functions that capture once right after start
+if (process.env.WEBP_SCREENSHOT_WARMUP && process.env.WEBP_SCREENSHOT_WARMUP !== '0') {
+    new WebPScreenshot().warmup().catch(() => {});
+}
+
 // Export the main class and utility functions
 module.exports = {
     WebPScreenshot,
@@ -342,6 +555,11 @@ module.exports = {
         return !!nativeBinding && nativeBinding.isSupported();
     },
     
+    // Warm up the shared native state (same as instance.warmup())
+    warmup(options) {
+        return new WebPScreenshot().warmup(options);
+    },
+    
     // Get version information
     getVersion() {
         return require('../package.json').version;
@@ -364,9 +582,11 @@ module.exports = {
 
 /**
  * @typedef {Object} CaptureOptions
+ * @property {number} [lossless=0] - Lossless encoding (0=lossy, 1=lossless)
  * @property {number} [quality=80] - WebP quality (0-100)
  * @property {number} [method=4] - Compression method (0-6, 0=fast, 6=slow/better)
  * @property {number} [targetSize=0] - Target size in bytes (0=disabled)
+ * @property {number} [maxOutputSize=0] - Hard cap in bytes; lossy encodes lower quality to fit, others fail (0=disabled)
  * @property {number} [targetPsnr=0.0] - Target PSNR (0=disabled)
  * @property {number} [segments=4] - Number of segments (1-4)
  * @property {number} [snsStrength=50] - Spatial noise shaping strength (0-100)
@@ -389,6 +609,69 @@ module.exports = {
  * @property {number} [exact=0] - Preserve RGB under transparency (0-1)
  * @property {number} [useDeltaPalette=0] - Use delta palettes (0-1)
  * @property {number} [useSharpYuv=0] - Use sharp RGB->YUV conversion (0-1)
+ * @property {number} [contentAdaptive=0] - Pick lossless for UI/text tiles and fast lossy for photos (0-1)
+ * @property {number} [maxEncodeMs=0] - Encode latency budget in ms; lowers method/pass to fit (0 = off)
+ * @property {number} [tileCache=0] - Reuse encoded tiles of unchanged screen regions across captures (0-1)
+ * @property {CaptureRegion} [region] - Capture only this rectangle; the backend reads back nothing else
+ * @property {number} [windowId] - Capture a window (HWND, X11 Window or CGWindowID) instead of the display; region is then relative to the window
+ */
+
+/**
+ * @typedef {Object} EncodeIntoResult
+ * @property {number} bytesWritten - Bytes of the file now in the output buffer (0 when it did not fit)
+ * @property {number} requiredSize - Size of the encoded file; grow the buffer to this and retry when bytesWritten is 0
+ */
+
+/**
+ * @typedef {Object} BatchEncodeResult
+ * @property {Array<Buffer|null>} frames - WebP files in input order (null where a frame failed)
+ * @property {Array<string|null>} errors - Error of each failed frame, in the same order
+ * @property {number} failedFrames - Number of frames that failed
+ * @property {number} workers - Threads the batch ran on
+ * @property {number} elapsedMs - Wall time of the whole batch
+ * @property {number} framesPerSecond - Batch throughput
+ */
+
+/**
+ * @typedef {CaptureOptions} PyramidLevel
+ * @property {number} [scale=1] - Multiplies both dimensions, in (0, 1]
+ * @property {number} [maxDimension=0] - Caps the longer side after scaling (0 = no cap)
+ */
+
+/**
+ * @typedef {Object} MultiResolutionLevel
+ * @property {number} width - Level width in pixels
+ * @property {number} height - Level height in pixels
+ * @property {number} scaleFactor - Level width over frame width
+ * @property {Buffer|null} data - WebP file, or null when the level failed
+ * @property {string|null} error - Why the level failed
+ */
+
+/**
+ * @typedef {Object} CaptureRegion
+ * @property {number} [x=0] - Left edge in pixels
+ * @property {number} [y=0] - Top edge in pixels
+ * @property {number} [width] - Width in pixels (default: to the right edge)
+ * @property {number} [height] - Height in pixels (default: to the bottom edge)
+ */
+
+/**
+ * @typedef {Object} WarmupOptions
+ * @property {boolean} [encoder=true] - Run a tiny lossy and lossless encode
+ * @property {boolean} [gpu=true] - Compile the GPU YUV420 shader (Windows)
+ * @property {boolean} [capture=true] - Set up the capture backend
+ */
+
+/**
+ * @typedef {Object} WarmupReport
+ * @property {boolean} encoderReady - Encoder setup done
+ * @property {boolean} gpuReady - GPU shader ready; false without a GPU path
+ * @property {boolean} captureReady - Capture backend reachable
+ * @property {string} captureBackend - Backend that was set up
+ * @property {number} encoderMs - Time this call spent on each step
+ * @property {number} gpuMs
+ * @property {number} captureMs
+ * @property {string} [error] - Why a step failed
  */
 
 /**
@@ -423,4 +706,31 @@ module.exports = {
  * @property {number} averageCaptureTime - Average capture time
  * @property {number} successRate - Success rate percentage
  * @property {number} fallbackUsagePercent - Fallback usage percentage
+ */
+
+/**
+ * @typedef {Object} StageStats
+ * @property {number} count - Samples recorded
+ * @property {number} totalMs - Sum of all samples in milliseconds
+ * @property {number} meanUs - Mean latency in microseconds
+ * @property {number} minUs - Fastest sample in microseconds
+ * @property {number} maxUs - Slowest sample in microseconds
+ * @property {number} p50Us - Median latency in microseconds
+ * @property {number} p90Us - 90th percentile in microseconds
+ * @property {number} p99Us - 99th percentile in microseconds
+ * @property {number} p999Us - 99.9th percentile in microseconds
+ */
+
+/**
+ * @typedef {Object} NativePerformanceStats
+ * @property {{capture: StageStats, readback: StageStats, convert: StageStats, encode: StageStats, marshal: StageStats}} stages
+ * @property {number} frames - Frames handed to JavaScript
+ * @property {number} bytesCopied - Pixel bytes copied on the CPU
+ * @property {number} bytesCopiedPerFrame - bytesCopied / frames
+ * @property {number} allocations - Frame-sized allocations outside the memory pool caches
+ * @property {number} allocatedBytes - Bytes behind those allocations
+ * @property {number} allocationsPerFrame - allocations / frames
+ * @property {number} elapsedSeconds - Time since start-up or the last reset
+ * @property {Object} memoryPool - Memory pool counters
+ * @property {Object} tileCache - Tile and frame hits/misses/hit rates of `tileCache` encodes, plus entries, bytes, maxBytes and evictions
  */
\ No newline at end of file
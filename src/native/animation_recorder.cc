@@ -0,0 +1,375 @@
+#include "common/screenshot_common.h"
+#include "common/webp_container.h"
+#include <webp/encode.h>
+#include <algorithm>
+#include <cstring>
+
+namespace WebPScreenshot {
+
+namespace {
+
+// Duration of the last frame when there is no frame interval to go by
+constexpr uint32_t kDefaultFrameMs = 100;
+
+constexpr uint32_t BytesPerPixel(WebPEncoder::PixelLayout layout) {
+    return layout == WebPEncoder::PixelLayout::RGB ? 3 : 4;
+}
+
+// Inclusive pixel bounds of a changed area
+struct Bounds {
+    uint32_t left;
+    uint32_t top;
+    uint32_t right;
+    uint32_t bottom;
+};
+
+// Union of the dirty rects clipped to the frame; false when none intersects it
+bool BoundDirtyRects(const std::vector<DirtyRect>& rects, uint32_t width, uint32_t height,
+                     Bounds* bounds) {
+    bool any = false;
+    for (const DirtyRect& rect : rects) {
+        if (rect.x >= width || rect.y >= height || rect.width == 0 || rect.height == 0) {
+            continue;
+        }
+        const uint32_t right = rect.x + std::min(rect.width, width - rect.x) - 1;
+        const uint32_t bottom = rect.y + std::min(rect.height, height - rect.y) - 1;
+        if (!any) {
+            *bounds = {rect.x, rect.y, right, bottom};
+            any = true;
+        } else {
+            bounds->left = std::min(bounds->left, rect.x);
+            bounds->top = std::min(bounds->top, rect.y);
+            bounds->right = std::max(bounds->right, right);
+            bounds->bottom = std::max(bounds->bottom, bottom);
+        }
+    }
+    return any;
+}
+
+// Shrink `bounds` to the pixels that really differ between the frames; false
+// when none does. The first and last changed rows are found with full-row
+// compares, rows between them only compare outside the columns already known
+// to have changed.
+bool TightenToDifferences(const uint8_t* current, uint32_t current_stride,
+                          const uint8_t* previous, uint32_t previous_stride,
+                          uint32_t bytes_per_pixel, Bounds* bounds) {
+    const size_t x_offset = static_cast<size_t>(bounds->left) * bytes_per_pixel;
+    const size_t row_bytes = static_cast<size_t>(bounds->right - bounds->left + 1) * bytes_per_pixel;
+    auto row_of = [&](const uint8_t* base, uint32_t stride, uint32_t row) {
+        return base + static_cast<size_t>(row) * stride + x_offset;
+    };
+
+    // Byte offsets within the bounded row
+    size_t first = row_bytes;
+    size_t last = 0;
+    uint32_t top = bounds->top;
+    for (; top <= bounds->bottom; ++top) {
+        const uint8_t* a = row_of(current, current_stride, top);
+        const uint8_t* b = row_of(previous, previous_stride, top);
+        first = SIMD::FindFirstDifference(a, b, row_bytes);
+        if (first < row_bytes) {
+            last = SIMD::FindLastDifference(a, b, row_bytes);
+            break;
+        }
+    }
+    if (top > bounds->bottom) {
+        return false;
+    }
+
+    uint32_t bottom = top;
+    for (uint32_t row = bounds->bottom; row > top; --row) {
+        const uint8_t* a = row_of(current, current_stride, row);
+        const uint8_t* b = row_of(previous, previous_stride, row);
+        const size_t row_last = SIMD::FindLastDifference(a, b, row_bytes);
+        if (row_last < row_bytes) {
+            bottom = row;
+            last = std::max(last, row_last);
+            first = std::min(first, SIMD::FindFirstDifference(a, b, row_bytes));
+            break;
+        }
+    }
+
+    for (uint32_t row = top + 1; row < bottom; ++row) {
+        const uint8_t* a = row_of(current, current_stride, row);
+        const uint8_t* b = row_of(previous, previous_stride, row);
+        if (first > 0) {
+            first = std::min(first, SIMD::FindFirstDifference(a, b, first));
+        }
+        if (last + 1 < row_bytes) {
+            const size_t tail = row_bytes - last - 1;
+            const size_t tail_last = SIMD::FindLastDifference(a + last + 1, b + last + 1, tail);
+            if (tail_last < tail) {
+                last += 1 + tail_last;
+            }
+        }
+    }
+
+    const uint32_t left = bounds->left;
+    bounds->left = left + static_cast<uint32_t>(first / bytes_per_pixel);
+    bounds->right = left + static_cast<uint32_t>(last / bytes_per_pixel);
+    bounds->top = top;
+    bounds->bottom = bottom;
+    return true;
+}
+
+} // anonymous namespace
+
+struct AnimationRecorder::Impl {
+    // Encoded, waiting for the next written frame to fix its duration
+    struct PendingFrame {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint64_t timestamp_us = 0;
+        std::vector<uint8_t> encoded;
+        size_t chunk_offset = 0;
+        size_t chunk_size = 0;
+    };
+
+    Config config;
+    WebPEncodeParams params;
+    WebPEncoder encoder;
+
+    // Geometry fixed by the first frame
+    uint32_t width = 0;
+    uint32_t height = 0;
+    WebPEncoder::PixelLayout layout = WebPEncoder::PixelLayout::RGBA;
+    uint32_t bytes_per_pixel = 4;
+
+    std::vector<uint8_t> output;
+    size_t flags_offset = 0;
+    bool any_alpha = false;
+    bool has_pending = false;
+    PendingFrame pending;
+
+    // Pixels of the last added frame, packed rows, to diff against
+    std::vector<uint8_t> previous;
+    uint32_t previous_stride = 0;
+
+    uint64_t first_timestamp_us = 0;
+    uint64_t last_timestamp_us = 0;
+    uint64_t last_keyframe_us = 0;
+    Stats stats = {};
+
+    void Reset();
+    uint32_t ElapsedMs(uint64_t timestamp_us) const;
+    void WritePending(uint64_t end_timestamp_us);
+    void RememberRows(const uint8_t* data, uint32_t stride, const Bounds& bounds);
+};
+
+void AnimationRecorder::Impl::Reset() {
+    width = height = 0;
+    output.clear();
+    any_alpha = false;
+    has_pending = false;
+    pending = PendingFrame();
+    previous.clear();
+}
+
+// Durations are taken from the rounded elapsed time of both ends so rounding
+// never accumulates over a long recording
+uint32_t AnimationRecorder::Impl::ElapsedMs(uint64_t timestamp_us) const {
+    return static_cast<uint32_t>(std::min<uint64_t>((timestamp_us - first_timestamp_us) / 1000,
+                                                    UINT32_MAX));
+}
+
+void AnimationRecorder::Impl::WritePending(uint64_t end_timestamp_us) {
+    const uint32_t elapsed = ElapsedMs(end_timestamp_us) - ElapsedMs(pending.timestamp_us);
+    const uint32_t duration = std::max(1u, std::min(elapsed, WebPContainer::kMaxFrameDuration));
+
+    // The rect holds every current pixel, so it replaces the canvas area and
+    // stays for the deltas drawn on top of it
+    WebPContainer::PutAnimationFrame(output, pending.x, pending.y, pending.width, pending.height,
+                                     duration, WebPContainer::kANMFNoBlend,
+                                     pending.encoded.data() + pending.chunk_offset, pending.chunk_size);
+    ++stats.frames_written;
+    has_pending = false;
+}
+
+void AnimationRecorder::Impl::RememberRows(const uint8_t* data, uint32_t stride, const Bounds& bounds) {
+    const size_t x_offset = static_cast<size_t>(bounds.left) * bytes_per_pixel;
+    const size_t row_bytes = static_cast<size_t>(bounds.right - bounds.left + 1) * bytes_per_pixel;
+    for (uint32_t row = bounds.top; row <= bounds.bottom; ++row) {
+        std::memcpy(previous.data() + static_cast<size_t>(row) * previous_stride + x_offset,
+                    data + static_cast<size_t>(row) * stride + x_offset, row_bytes);
+    }
+}
+
+AnimationRecorder::AnimationRecorder(const Config& config)
+    : impl_(std::make_unique<Impl>()) {
+    impl_->config = config;
+    // A tiled encode is an animation itself and cannot be nested in an ANMF frame
+    impl_->params = config.params;
+    impl_->params.enable_multithreading = false;
+    impl_->params.content_adaptive = 0;
+    impl_->params.tile_cache = 0;
+}
+
+AnimationRecorder::~AnimationRecorder() {}
+
+bool AnimationRecorder::AddFrame(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+                                 WebPEncoder::PixelLayout layout, uint64_t timestamp_us,
+                                 const std::vector<DirtyRect>* dirty_rects) {
+    Impl& state = *impl_;
+    last_error_.clear();
+
+    const uint32_t bytes_per_pixel = BytesPerPixel(layout);
+    if (!data || width == 0 || height == 0 || stride < width * bytes_per_pixel) {
+        last_error_ = "Invalid frame";
+        return false;
+    }
+
+    const bool first = state.width == 0;
+    if (first) {
+        if (width > WEBP_MAX_DIMENSION || height > WEBP_MAX_DIMENSION) {
+            last_error_ = "Frame exceeds the WebP dimension limit";
+            return false;
+        }
+        state.stats = {};
+        state.width = width;
+        state.height = height;
+        state.layout = layout;
+        state.bytes_per_pixel = bytes_per_pixel;
+        state.previous_stride = width * bytes_per_pixel;
+        state.previous.resize(static_cast<size_t>(state.previous_stride) * height);
+        state.first_timestamp_us = timestamp_us;
+        state.last_keyframe_us = timestamp_us;
+
+        state.flags_offset = WebPContainer::PutExtendedHeader(state.output, width, height);
+        state.output[state.flags_offset] |= WebPContainer::kVP8XAnimationFlag;
+        WebPContainer::PutAnimationHeader(state.output, state.config.background_argb,
+                                          state.config.loop_count);
+    } else if (width != state.width || height != state.height || layout != state.layout) {
+        last_error_ = "Frame size or layout changed during the recording";
+        return false;
+    } else if (timestamp_us < state.last_timestamp_us) {
+        last_error_ = "Frame timestamps must not go backwards";
+        return false;
+    }
+
+    ++state.stats.frames_added;
+    state.stats.full_frame_pixels += static_cast<uint64_t>(width) * height;
+    state.last_timestamp_us = timestamp_us;
+
+    const uint64_t interval_us = static_cast<uint64_t>(state.config.keyframe_interval_ms) * 1000;
+    const bool keyframe = first ||
+        (interval_us > 0 && timestamp_us - state.last_keyframe_us >= interval_us);
+
+    Bounds bounds = {0, 0, width - 1, height - 1};
+    if (!keyframe) {
+        bool changed = dirty_rects ? BoundDirtyRects(*dirty_rects, width, height, &bounds) : true;
+        changed = changed && TightenToDifferences(data, stride, state.previous.data(),
+                                                  state.previous_stride, bytes_per_pixel, &bounds);
+        if (!changed) {
+            // The pending frame simply stays on screen longer
+            return true;
+        }
+
+        // ANMF offsets are stored halved
+        bounds.left &= ~1u;
+        bounds.top &= ~1u;
+    }
+
+    const uint32_t rect_width = bounds.right - bounds.left + 1;
+    const uint32_t rect_height = bounds.bottom - bounds.top + 1;
+    const uint8_t* origin = data + static_cast<size_t>(bounds.top) * stride +
+                            static_cast<size_t>(bounds.left) * bytes_per_pixel;
+
+    Impl::PendingFrame frame;
+    switch (layout) {
+        case WebPEncoder::PixelLayout::RGB:
+            frame.encoded = state.encoder.EncodeRGB(origin, rect_width, rect_height, stride, state.params);
+            break;
+        case WebPEncoder::PixelLayout::RGBA:
+            frame.encoded = state.encoder.EncodeRGBA(origin, rect_width, rect_height, stride, state.params);
+            break;
+        case WebPEncoder::PixelLayout::BGRA:
+        case WebPEncoder::PixelLayout::BGRX:
+            frame.encoded = state.encoder.EncodeBGRA(origin, rect_width, rect_height, stride, state.params,
+                                                     layout == WebPEncoder::PixelLayout::BGRA);
+            break;
+    }
+    if (frame.encoded.empty()) {
+        last_error_ = state.encoder.GetLastError();
+        return false;
+    }
+
+    bool frame_alpha = false;
+    if (!WebPContainer::FindImageChunks(frame.encoded, &frame.chunk_offset, &frame.chunk_size,
+                                        &frame_alpha)) {
+        last_error_ = "Malformed frame bitstream";
+        return false;
+    }
+    state.any_alpha |= frame_alpha;
+
+    frame.x = bounds.left;
+    frame.y = bounds.top;
+    frame.width = rect_width;
+    frame.height = rect_height;
+    frame.timestamp_us = timestamp_us;
+
+    if (state.has_pending) {
+        state.WritePending(timestamp_us);
+    }
+    state.pending = std::move(frame);
+    state.has_pending = true;
+
+    state.RememberRows(data, stride, bounds);
+    if (keyframe) {
+        state.last_keyframe_us = timestamp_us;
+        ++state.stats.keyframes;
+    }
+    state.stats.encoded_pixels += static_cast<uint64_t>(rect_width) * rect_height;
+    return true;
+}
+
+bool AnimationRecorder::AddFrame(const CapturedFrame& frame) {
+    const WebPEncoder::PixelLayout layout = frame.bytes_per_pixel == 3 ? WebPEncoder::PixelLayout::RGB
+                                                                       : WebPEncoder::PixelLayout::RGBA;
+    return AddFrame(frame.data, frame.width, frame.height, frame.stride, layout, frame.timestamp_us,
+                    frame.dirty_rects);
+}
+
+std::vector<uint8_t> AnimationRecorder::Finish() {
+    Impl& state = *impl_;
+    last_error_.clear();
+
+    if (!state.has_pending) {
+        last_error_ = "No frames recorded";
+        return {};
+    }
+
+    // The last frame shows for as long as the frames after it went unchanged,
+    // plus one average frame interval
+    const uint64_t recorded_us = state.last_timestamp_us - state.first_timestamp_us;
+    const uint64_t interval_us = state.stats.frames_added > 1
+        ? recorded_us / (state.stats.frames_added - 1)
+        : static_cast<uint64_t>(kDefaultFrameMs) * 1000;
+    state.WritePending(state.last_timestamp_us + interval_us);
+
+    if (state.any_alpha) {
+        state.output[state.flags_offset] |= WebPContainer::kVP8XAlphaFlag;
+    }
+    if (!WebPContainer::FinishFile(state.output)) {
+        last_error_ = "Encoded file too big (> 4G)";
+        state.Reset();
+        return {};
+    }
+
+    std::vector<uint8_t> animation = std::move(state.output);
+    state.stats.output_bytes = animation.size();
+    state.Reset();
+    return animation;
+}
+
+AnimationRecorder::Stats AnimationRecorder::GetStats() const {
+    Stats stats = impl_->stats;
+    // While recording, the frames written so far; the pending one is held back
+    if (!impl_->output.empty()) {
+        stats.output_bytes = impl_->output.size();
+    }
+    return stats;
+}
+
+} // namespace WebPScreenshot
@@ -0,0 +1,444 @@
+#include "common/screenshot_common.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <thread>
+
+namespace WebPScreenshot {
+
+namespace {
+
+// Bounded single-producer/single-consumer ring of slot indices. Capacity is
+// rounded up to a power of two; push fails instead of growing when full.
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        items_.resize(size);
+        mask_ = size - 1;
+    }
+
+    bool Push(uint32_t value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) {
+            return false;
+        }
+        items_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(uint32_t& value) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = items_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<uint32_t> items_;
+    size_t mask_ = 0;
+    // Separate cache lines so producer and consumer don't false-share
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
+
+uint64_t SteadyMicros() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // anonymous namespace
+
+struct CaptureSession::Impl {
+    struct Slot {
+        PoolBuffer buffer;         // Null while the slot lives in the shared ring
+        uint8_t* data = nullptr;
+        size_t capacity = 0;
+        bool shared = false;
+        CapturedFrame frame;
+        std::vector<DirtyRect> dirty_rects;
+    };
+
+    std::shared_ptr<ScreenshotCapture> capture;
+    Config config;
+    std::vector<Slot> slots;
+    SharedFrameRing ring;
+
+    // Ready frames flow producer -> consumer, released slots flow back
+    SpscQueue ready;
+    SpscQueue free_slots;
+
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::mutex wake_mutex;
+    std::condition_variable stop_condition;    // Interrupts the frame-pacing sleep
+    std::condition_variable frame_condition;   // Wakes a blocked AcquireFrame
+
+    std::atomic<uint64_t> frames_captured{0};
+    std::atomic<uint64_t> frames_dropped{0};
+    std::atomic<uint64_t> capture_failures{0};
+    std::atomic<uint64_t> frames_shared{0};
+    std::atomic<uint64_t> capture_time_us{0};
+    std::atomic<bool> thread_placed{true};
+    uint64_t sequence = 0;
+
+    Impl(std::shared_ptr<ScreenshotCapture> c, const Config& cfg)
+        : capture(std::move(c)), config(cfg),
+          ready(std::max(1u, cfg.ring_size)), free_slots(std::max(1u, cfg.ring_size)) {}
+
+    void CaptureLoop();
+    bool CaptureInto(Slot& slot);
+};
+
+bool CaptureSession::Impl::CaptureInto(Slot& slot) {
+    FrameDescriptor descriptor;
+    bool ok = capture->CaptureDisplayInto(config.display_index, slot.data,
+                                          slot.capacity, descriptor);
+
+    // Resolution changed since Start; grow this slot once and retry. Ring
+    // slots cannot grow, so the slot leaves the ring.
+    if (!ok && descriptor.required_size > slot.capacity) {
+        if (slot.shared) {
+            ring.Abandon(static_cast<uint32_t>(&slot - slots.data()));
+            slot.shared = false;
+        }
+        slot.buffer = Utils::AllocateScreenshotBuffer(descriptor.required_size);
+        slot.data = slot.buffer.get();
+        slot.capacity = descriptor.required_size;
+        descriptor = FrameDescriptor();
+        ok = capture->CaptureDisplayInto(config.display_index, slot.data,
+                                         slot.capacity, descriptor);
+    }
+
+    if (!ok) {
+        return false;
+    }
+
+    slot.frame.data = slot.data;
+    slot.frame.width = descriptor.width;
+    slot.frame.height = descriptor.height;
+    slot.frame.stride = descriptor.stride;
+    slot.frame.bytes_per_pixel = descriptor.bytes_per_pixel;
+    slot.frame.timestamp_us = SteadyMicros();
+    slot.dirty_rects.swap(descriptor.dirty_rects);
+    slot.frame.dirty_rects = descriptor.has_dirty_rects ? &slot.dirty_rects : nullptr;
+    return true;
+}
+
+void CaptureSession::Impl::CaptureLoop() {
+    if (!config.capture_thread.IsDefault()) {
+        const ThreadPlacement::Result placement = ThreadPlacement::Apply(config.capture_thread);
+        thread_placed.store(placement.placed && placement.prioritized, std::memory_order_relaxed);
+    }
+
+    const double fps = config.target_fps > 0.0 ? config.target_fps : 30.0;
+    const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / fps));
+    auto next_tick = std::chrono::steady_clock::now();
+
+    // A slot whose capture failed is kept here rather than pushed back, since
+    // only the consumer may push onto free_slots
+    bool holding_slot = false;
+    uint32_t index = 0;
+
+    while (running.load(std::memory_order_acquire)) {
+        const uint64_t tick_sequence = sequence++;
+
+        if (!holding_slot && !free_slots.Pop(index)) {
+            // Consumer holds every buffer; skip this tick rather than queue
+            frames_dropped.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            holding_slot = true;
+            Slot& slot = slots[index];
+            const uint64_t start = SteadyMicros();
+
+            // Readers of the shared ring see the slot as busy until Publish
+            if (slot.shared) {
+                ring.BeginWrite(index);
+            }
+
+            if (CaptureInto(slot)) {
+                capture_time_us.fetch_add(SteadyMicros() - start, std::memory_order_relaxed);
+                frames_captured.fetch_add(1, std::memory_order_relaxed);
+                slot.frame.sequence = tick_sequence;
+                slot.frame.slot = index;
+                if (slot.shared) {
+                    ring.Publish(index, slot.frame);
+                    frames_shared.fetch_add(1, std::memory_order_relaxed);
+                }
+                ready.Push(index);  // Never full: it holds at most ring_size slots
+                holding_slot = false;
+
+                // Taking the lock orders the push against a consumer about to wait
+                {
+                    std::lock_guard<std::mutex> lock(wake_mutex);
+                }
+                frame_condition.notify_one();
+            } else {
+                capture_failures.fetch_add(1, std::memory_order_relaxed);
+                if (slot.shared) {
+                    ring.Abandon(index);
+                }
+            }
+        }
+
+        // Pace to the target rate; a slow capture does not cause a burst later
+        next_tick += interval;
+        const auto now = std::chrono::steady_clock::now();
+        if (next_tick < now) {
+            next_tick = now;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        stop_condition.wait_until(lock, next_tick, [this] {
+            return !running.load(std::memory_order_acquire);
+        });
+    }
+}
+
+CaptureSession::CaptureSession(std::shared_ptr<ScreenshotCapture> capture, const Config& config)
+    : impl_(std::make_unique<Impl>(std::move(capture), config)) {}
+
+CaptureSession::~CaptureSession() {
+    Stop();
+}
+
+bool CaptureSession::Start() {
+    if (impl_->running) {
+        return true;
+    }
+
+    if (!impl_->capture || !impl_->capture->IsSupported()) {
+        last_error_ = "Screenshot capture is not supported";
+        return false;
+    }
+
+    const auto displays = impl_->capture->GetDisplays();
+    if (impl_->config.display_index >= displays.size()) {
+        last_error_ = "Display index out of range";
+        return false;
+    }
+
+    // Allocate the whole ring up front so the capture loop never allocates
+    const auto& display = displays[impl_->config.display_index];
+    const size_t frame_size = static_cast<size_t>(display.width) * display.height * 4;
+    const uint32_t ring_size = std::max(1u, impl_->config.ring_size);
+
+    // With a shared ring the slots are the ring's, so the consumer and other
+    // processes read the same pixels
+    if (impl_->config.shared_ring) {
+        SharedFrameRing::Config ring_config;
+        ring_config.name = impl_->config.shared_ring_name;
+        ring_config.slot_count = ring_size;
+        ring_config.slot_capacity = frame_size;
+        if (!impl_->ring.Create(ring_config)) {
+            last_error_ = impl_->ring.GetLastError();
+            return false;
+        }
+    }
+
+    impl_->slots.clear();
+    impl_->slots.resize(ring_size);
+    for (uint32_t i = 0; i < ring_size; ++i) {
+        Impl::Slot& slot = impl_->slots[i];
+        if (impl_->ring.IsOpen()) {
+            slot.data = impl_->ring.GetSlotData(i);
+            slot.shared = true;
+        } else {
+            slot.buffer = Utils::AllocateScreenshotBuffer(frame_size);
+            slot.data = slot.buffer.get();
+        }
+        slot.capacity = frame_size;
+        impl_->free_slots.Push(i);
+    }
+
+    impl_->running = true;
+    impl_->thread = std::thread(&Impl::CaptureLoop, impl_.get());
+    return true;
+}
+
+// Call from the consumer thread, after it has stopped acquiring frames
+void CaptureSession::Stop() {
+    if (!impl_->running.exchange(false)) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(impl_->wake_mutex);
+    }
+    impl_->stop_condition.notify_all();
+    impl_->frame_condition.notify_all();
+
+    if (impl_->thread.joinable()) {
+        impl_->thread.join();
+    }
+
+    // Return everything to the free list so the session can be restarted
+    uint32_t index = 0;
+    while (impl_->ready.Pop(index)) {}
+    while (impl_->free_slots.Pop(index)) {}
+    impl_->slots.clear();
+    impl_->ring.Close();
+}
+
+bool CaptureSession::IsRunning() const {
+    return impl_->running.load(std::memory_order_acquire);
+}
+
+bool CaptureSession::TryAcquireFrame(CapturedFrame& frame) {
+    uint32_t index = 0;
+    if (!impl_->ready.Pop(index)) {
+        return false;
+    }
+    frame = impl_->slots[index].frame;
+    return true;
+}
+
+bool CaptureSession::AcquireFrame(CapturedFrame& frame, uint32_t timeout_ms) {
+    if (TryAcquireFrame(frame)) {
+        return true;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    std::unique_lock<std::mutex> lock(impl_->wake_mutex);
+
+    bool acquired = false;
+    impl_->frame_condition.wait_until(lock, deadline, [&] {
+        acquired = TryAcquireFrame(frame);
+        return acquired || !impl_->running.load(std::memory_order_acquire);
+    });
+
+    return acquired;
+}
+
+void CaptureSession::ReleaseFrame(const CapturedFrame& frame) {
+    if (frame.slot < impl_->slots.size()) {
+        impl_->free_slots.Push(frame.slot);
+    }
+}
+
+CaptureSession::Stats CaptureSession::GetStats() const {
+    Stats stats = {};
+    stats.frames_captured = impl_->frames_captured.load(std::memory_order_relaxed);
+    stats.frames_dropped = impl_->frames_dropped.load(std::memory_order_relaxed);
+    stats.capture_failures = impl_->capture_failures.load(std::memory_order_relaxed);
+    stats.frames_shared = impl_->frames_shared.load(std::memory_order_relaxed);
+    if (stats.frames_captured > 0) {
+        stats.average_capture_ms = impl_->capture_time_us.load(std::memory_order_relaxed) /
+                                   1000.0 / stats.frames_captured;
+    }
+    stats.capture_thread_placed = impl_->thread_placed.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::string CaptureSession::GetSharedRingLocator() const {
+    return impl_->ring.GetLocator();
+}
+
+// Default in-place capture: one-shot capture, then copy into the caller's buffer
+bool ScreenshotCapture::CaptureDisplayInto(uint32_t display_index, uint8_t* buffer,
+                                           size_t capacity, FrameDescriptor& frame) {
+    ScreenshotResult result = CaptureDisplay(display_index);
+    if (!result.success) {
+        frame.error_message = result.error_message;
+        return false;
+    }
+
+    const uint32_t row_size = result.width * result.bytes_per_pixel;
+    frame.required_size = static_cast<size_t>(row_size) * result.height;
+    if (!buffer || capacity < frame.required_size) {
+        frame.error_message = "Frame buffer too small";
+        return false;
+    }
+
+    for (uint32_t row = 0; row < result.height; ++row) {
+        std::memcpy(buffer + static_cast<size_t>(row) * row_size,
+                    result.data.get() + static_cast<size_t>(row) * result.stride, row_size);
+    }
+
+    frame.width = result.width;
+    frame.height = result.height;
+    frame.stride = row_size;
+    frame.bytes_per_pixel = result.bytes_per_pixel;
+    return true;
+}
+
+// Default region capture: full display, then crop
+ScreenshotResult ScreenshotCapture::CaptureDisplay(uint32_t display_index, const CaptureRegion& region) {
+    if (region.IsFullFrame()) {
+        return CaptureDisplay(display_index);
+    }
+
+    ScreenshotResult result;
+    if (region.window_id != 0) {
+        result.error_message = "Window capture not supported by " + GetImplementationName();
+        return result;
+    }
+
+    ScreenshotResult full = CaptureDisplay(display_index);
+    if (!full.success) {
+        return full;
+    }
+
+    DirtyRect rect;
+    if (!Utils::ClipCaptureRegion(region, full.width, full.height, rect, result.error_message)) {
+        return result;
+    }
+    return Utils::CropScreenshotResult(full, rect);
+}
+
+namespace Utils {
+
+bool ClipCaptureRegion(const CaptureRegion& region, uint32_t width, uint32_t height,
+                       DirtyRect& clipped, std::string& error) {
+    if (region.x >= width || region.y >= height) {
+        error = "Capture region lies outside the " + std::to_string(width) + "x" +
+                std::to_string(height) + " source";
+        return false;
+    }
+
+    clipped.x = region.x;
+    clipped.y = region.y;
+    clipped.width = region.width ? std::min(region.width, width - region.x) : width - region.x;
+    clipped.height = region.height ? std::min(region.height, height - region.y) : height - region.y;
+    return true;
+}
+
+ScreenshotResult CropScreenshotResult(const ScreenshotResult& source, const DirtyRect& rect) {
+    ScreenshotResult result;
+    const uint32_t row_size = rect.width * source.bytes_per_pixel;
+    const size_t size = static_cast<size_t>(row_size) * rect.height;
+    result.data = AllocateScreenshotBuffer(size);
+    if (!result.data) {
+        result.error_message = "Failed to allocate region buffer";
+        return result;
+    }
+
+    const uint8_t* src = source.data.get() + static_cast<size_t>(rect.y) * source.stride +
+                         static_cast<size_t>(rect.x) * source.bytes_per_pixel;
+    for (uint32_t row = 0; row < rect.height; ++row) {
+        std::memcpy(result.data.get() + static_cast<size_t>(row) * row_size,
+                    src + static_cast<size_t>(row) * source.stride, row_size);
+    }
+    Stats::AddBytesCopied(size);
+
+    result.width = rect.width;
+    result.height = rect.height;
+    result.stride = row_size;
+    result.bytes_per_pixel = source.bytes_per_pixel;
+    result.data_size = static_cast<uint32_t>(size);
+    result.format = source.format;
+    result.implementation = source.implementation;
+    result.success = true;
+    return result;
+}
+
+} // namespace Utils
+} // namespace WebPScreenshot
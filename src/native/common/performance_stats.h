@@ -0,0 +1,105 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace WebPScreenshot {
+namespace Stats {
+
+// Pipeline stages timed per frame. Stages can nest, e.g. Encode includes the
+// colour conversion libwebp does internally.
+enum class Stage : uint32_t {
+    Capture,    // OS or compositor hands over a frame (BitBlt, XShmGetImage, WGC/SCK frame)
+    Readback,   // GPU or shared surface copied into CPU memory (staging Map, IOSurface, dmabuf)
+    Convert,    // CPU pixel-format conversion of a whole frame
+    Encode,     // One WebP encode (whole image, tile or chunk)
+    Marshal,    // Turning results into JS values on the main thread
+    Count
+};
+
+constexpr uint32_t kStageCount = static_cast<uint32_t>(Stage::Count);
+
+// Lower-case name used as the JS key ("capture", "readback", ...)
+const char* StageName(Stage stage);
+
+// Recording is lock-free: every thread writes its own histograms and
+// counters, which GetSnapshot merges. Safe to call from any thread.
+void RecordLatency(Stage stage, uint64_t nanoseconds);
+void AddBytesCopied(uint64_t bytes);
+void AddAllocation(uint64_t bytes);
+void AddFrame();  // One frame handed to the caller; the per-frame denominator
+void AddTileCacheLookups(uint64_t hits, uint64_t misses);  // Tiles looked up in TileCache
+void AddFrameCacheLookup(bool hit);                        // Whole frames looked up in TileCache
+
+// Recording is on by default; disabling turns every call above into one load
+void SetEnabled(bool enabled);
+bool IsEnabled();
+
+// Times a scope into a stage histogram
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(Stage stage)
+        : stage_(stage), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedStageTimer() { Stop(); }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+    // Record now instead of at the end of the scope; later calls do nothing
+    void Stop() {
+        if (!stopped_) {
+            stopped_ = true;
+            RecordLatency(stage_, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count()));
+        }
+    }
+
+    // Drop the sample, e.g. when the operation failed
+    void Cancel() { stopped_ = true; }
+
+private:
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+    bool stopped_ = false;
+};
+
+// Latency distribution of one stage. Percentiles come from log-linear
+// buckets (16 per power of two), so they are accurate to about 6%.
+struct StageSummary {
+    uint64_t count = 0;
+    double total_ms = 0.0;
+    double mean_us = 0.0;
+    double min_us = 0.0;
+    double max_us = 0.0;
+    double p50_us = 0.0;
+    double p90_us = 0.0;
+    double p99_us = 0.0;
+    double p999_us = 0.0;
+};
+
+struct Snapshot {
+    StageSummary stages[kStageCount];
+    uint64_t frames = 0;
+    uint64_t bytes_copied = 0;
+    uint64_t allocations = 0;       // Heap or system allocations of frame-sized memory
+    uint64_t allocated_bytes = 0;
+    double bytes_copied_per_frame = 0.0;
+    double allocations_per_frame = 0.0;
+    double elapsed_seconds = 0.0;   // Since start-up or the last Reset
+
+    // Encodes with WebPEncodeParams::tile_cache; a frame hit looks up no tiles
+    uint64_t tile_cache_hits = 0;
+    uint64_t tile_cache_misses = 0;
+    uint64_t frame_cache_hits = 0;
+    uint64_t frame_cache_misses = 0;
+    double tile_cache_hit_rate = 0.0;
+    double frame_cache_hit_rate = 0.0;
+};
+
+Snapshot GetSnapshot();
+
+// Zero every histogram and counter, including those of running threads
+void Reset();
+
+} // namespace Stats
+} // namespace WebPScreenshot
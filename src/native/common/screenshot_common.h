@@ -1,70 +1,101 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
 #include <cstdint>
 #include <mutex>
 #include <chrono>
+#include <functional>
+#include <future>
+#include "performance_stats.h"
 
 namespace WebPScreenshot {
 
-// Memory pool for efficient buffer management
+class ScreenshotMemoryPool;
+
+// Returns a pool block to the size class it came from (or frees it)
+struct PoolBufferDeleter {
+    ScreenshotMemoryPool* pool = nullptr;  // Must outlive the buffer
+    size_t capacity = 0;                   // Usable size of the block, >= the requested size
+    void operator()(uint8_t* block) const;
+};
+
+// 64-byte aligned, uninitialized pixel memory owned by the memory pool.
+// Dropping it recycles the block; there is no need to return it explicitly.
+using PoolBuffer = std::unique_ptr<uint8_t[], PoolBufferDeleter>;
+
+// Size-classed buffer pool. Each class (small powers of two, then common
+// frame sizes) has its own locked free list; each thread additionally keeps
+// a few blocks per class so a thread that captures and recycles frames never
+// touches a shared lock.
 class ScreenshotMemoryPool {
 public:
+    struct Config {
+        size_t max_cached_bytes = 512ull << 20;       // Shared free lists, all classes
+        size_t max_thread_cache_bytes = 64ull << 20;  // Per thread
+        uint32_t thread_cache_blocks = 2;             // Per thread and class
+        bool use_huge_pages = false;                  // Linux THP hint for blocks >= 2 MB
+        // Keep one set of free lists per NUMA node and hand each thread
+        // blocks from its own node; fresh blocks are bound to it on Linux
+        bool numa_local = false;
+    };
+
     ScreenshotMemoryPool();
     ~ScreenshotMemoryPool();
     
-    // Get a buffer of specified size (reuses existing buffer if available)
-    std::unique_ptr<uint8_t[]> GetBuffer(size_t size);
+    // Get a buffer of at least the specified size (reuses a pooled block if available)
+    PoolBuffer GetBuffer(size_t size);
     
-    // Return a buffer to the pool for reuse
-    void ReturnBuffer(std::unique_ptr<uint8_t[]> buffer, size_t size);
+    // Return a buffer to the pool for reuse; same as letting it go out of scope
+    void ReturnBuffer(PoolBuffer buffer, size_t size);
     
-    // Clear all pooled buffers
+    // Free all pooled blocks (shared lists and the calling thread's cache)
     void Clear();
     
+    void Configure(const Config& config);
+    Config GetConfig() const;
+    
     // Get pool statistics
     struct PoolStats {
-        size_t available_buffers;
-        size_t total_buffers_created;
-        size_t total_memory_allocated;
-        size_t peak_memory_usage;
-        size_t memory_reuse_count;
+        size_t available_buffers;       // Blocks cached for reuse
+        size_t total_buffers_created;   // Blocks ever requested from the system
+        size_t total_memory_allocated;  // Bytes currently held from the system (in use + cached)
+        size_t peak_memory_usage;       // High-water mark of total_memory_allocated
+        size_t memory_reuse_count;      // Requests served from a cache
+        size_t bytes_in_use;            // Bytes handed out and not yet returned
+        size_t bytes_cached;            // Bytes sitting in caches
+        size_t thread_cache_hits;       // Reuses that needed no lock
+        size_t oversize_allocations;    // Requests larger than every size class
     };
     
     PoolStats GetStats() const;
 
+    // Internal: called by PoolBufferDeleter
+    void Release(uint8_t* block, size_t capacity);
+
 private:
-    struct BufferInfo {
-        std::unique_ptr<uint8_t[]> buffer;
-        size_t size;
-        uint64_t last_used_time;
-        
-        BufferInfo(std::unique_ptr<uint8_t[]> buf, size_t sz) 
-            : buffer(std::move(buf)), size(sz), last_used_time(0) {}
-    };
-    
-    mutable std::mutex mutex_;
-    std::vector<BufferInfo> available_buffers_;
-    
-    // Statistics
-    mutable PoolStats stats_;
-    
-    // Pool configuration
-    static constexpr size_t MAX_POOL_SIZE = 10;  // Maximum buffers to keep
-    static constexpr uint64_t BUFFER_TIMEOUT_MS = 60000;  // 1 minute timeout
-    
-    void CleanupExpiredBuffers();
-    size_t FindBestFitBuffer(size_t required_size) const;
+    friend ScreenshotMemoryPool* GetGlobalMemoryPool();
+
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
 };
 
 // Global memory pool instance
 extern ScreenshotMemoryPool* GetGlobalMemoryPool();
 
+// Changed region of a frame, in frame-local pixel coordinates
+struct DirtyRect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
 // Screenshot capture result structure
 struct ScreenshotResult {
-    std::unique_ptr<uint8_t[]> data;
+    PoolBuffer data;
     uint32_t width;
     uint32_t height;
     uint32_t stride;
@@ -116,6 +147,7 @@ struct ScreenshotResult {
 
 // WebP encoding parameters
 struct WebPEncodeParams {
+    int lossless = 0;             // Lossless encoding (0=lossy, 1=lossless)
     float quality = 80.0f;        // 0.0 - 100.0
     int method = 4;               // 0 = fast, 6 = slower/better
     int target_size = 0;          // If non-zero, try to achieve target size
@@ -141,6 +173,10 @@ struct WebPEncodeParams {
     int exact = 0;                // Preserve RGB values under transparent area
     int use_delta_palette = 0;    // Use delta-palettes
     int use_sharp_yuv = 0;        // Use sharp (accurate) RGB to YUV conversion
+    int content_adaptive = 0;     // Classify each tile and pick lossless or fast lossy (0-1)
+    float max_encode_ms = 0.0f;   // If non-zero, latency budget that lowers method/pass to fit
+    int tile_cache = 0;           // Reuse the encoded tiles of unchanged regions across frames (0-1)
+    int max_output_size = 0;      // If non-zero, hard cap in bytes; lossy rate control lowers quality to fit
     
     // Multi-threading parameters
     bool enable_multithreading = true;  // Enable multi-threaded encoding for large images
@@ -148,9 +184,71 @@ struct WebPEncodeParams {
     
     // Streaming parameters
     bool enable_streaming = true;      // Enable streaming encoding for large images
-    uint32_t stream_buffer_size = 64 * 1024;  // Stream buffer size in bytes
+    uint32_t stream_buffer_size = 64 * 1024;  // Chunk size of EncodeStreamingWithCallback
 };
 
+// Sampled screen-content analysis behind WebPEncodeParams::content_adaptive
+namespace ContentAnalysis {
+    enum class ContentClass {
+        Palette,    // At most 256 colours: UI, text, terminals. VP8L colour-indexes it.
+        Graphics,   // Flat areas and hard edges with too many colours for a palette
+        Photo       // Continuous tone: photos, video, 3D views
+    };
+
+    struct ContentStats {
+        uint32_t sampled_pixels = 0;
+        uint32_t unique_colors = 0;     // Distinct sampled RGB values, saturates at 257
+        float flat_fraction = 0.0f;     // Sampled neighbours that are identical
+        float edge_density = 0.0f;      // Sampled neighbours with a step above 32 in any channel
+        ContentClass content_class = ContentClass::Photo;
+    };
+
+    // Looks at one row in eight (at least 32 rows); alpha is ignored.
+    // bytes_per_pixel is 3 or 4, channel order does not matter.
+    ContentStats AnalyzeRegion(const uint8_t* data, uint32_t width, uint32_t height,
+                               uint32_t stride, uint32_t bytes_per_pixel);
+
+    // Encode settings for a region of the given class, derived from the
+    // caller's. The result has content_adaptive cleared. Lossless requests
+    // are never turned lossy, and target_size/target_psnr requests are
+    // returned unchanged since VP8L cannot aim for them.
+    WebPEncodeParams ParamsForContent(const ContentStats& stats, const WebPEncodeParams& base);
+
+    const char* ContentClassName(ContentClass content_class);
+}
+
+// Per-machine encode latency model behind WebPEncodeParams::max_encode_ms.
+// Relative method costs were measured per content class; the model learns
+// how fast this machine is for each class from the encodes it times.
+namespace EncodeCost {
+    // Predicted wall time of one single-threaded encode, input conversion included
+    double EstimateMs(const WebPEncodeParams& params, uint64_t pixels,
+                      ContentAnalysis::ContentClass content_class);
+
+    // Feed back the measured time of an encode with these settings
+    void Record(const WebPEncodeParams& params, uint64_t pixels,
+                ContentAnalysis::ContentClass content_class, double elapsed_ms);
+
+    // Cheapest settings derived from params: method 0, one pass, no sharp YUV.
+    // Lossless stays lossless.
+    WebPEncodeParams FastestParams(const WebPEncodeParams& params);
+
+    struct BudgetPlan {
+        WebPEncodeParams params;        // Highest effort predicted to fit
+        WebPEncodeParams fallback;      // Re-run with these when params overruns
+        double predicted_ms = 0.0;
+        double abort_after_ms = 0.0;    // Abort params past this; 0 when params is the fallback
+    };
+
+    // Lowers method, then pass, from the requested values until the encode
+    // plus a fallback encode fit budget_ms. Both results have max_encode_ms cleared.
+    BudgetPlan PlanForBudget(const WebPEncodeParams& params, uint64_t pixels,
+                             ContentAnalysis::ContentClass content_class, double budget_ms);
+
+    // Forget the learned speed (tests, changed hardware)
+    void Reset();
+}
+
 // Display information structure
 struct DisplayInfo {
     uint32_t index;
@@ -163,9 +261,42 @@ struct DisplayInfo {
     std::string name;
 };
 
+// Geometry of a frame written into a caller-owned buffer
+struct FrameDescriptor {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+    uint32_t bytes_per_pixel = 0;
+    size_t required_size = 0;   // Set when the supplied buffer was too small
+    std::string error_message;
+
+    // Regions changed since this backend's previous capture of the display,
+    // for backends that track damage (XDamage, Wayland screencopy,
+    // ScreenCaptureKit, DXGI desktop duplication). Empty with has_dirty_rects
+    // set means nothing changed.
+    bool has_dirty_rects = false;
+    std::vector<DirtyRect> dirty_rects;
+};
+
+// Part of a display, or a single window, to capture. Coordinates are in
+// pixels relative to the display (or to the window when window_id is set).
+struct CaptureRegion {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;      // 0 extends to the right edge
+    uint32_t height = 0;     // 0 extends to the bottom edge
+    uint64_t window_id = 0;  // X11 Window, HWND or CGWindowID; 0 captures the display
+
+    bool IsFullFrame() const { return window_id == 0 && x == 0 && y == 0 && width == 0 && height == 0; }
+};
+
+class MultiDisplayCapture;
+
 // Abstract base class for platform-specific screenshot implementations
 class ScreenshotCapture {
 public:
+    using Factory = std::function<std::unique_ptr<ScreenshotCapture>()>;
+
     virtual ~ScreenshotCapture() = default;
     
     // Get list of available displays
@@ -173,9 +304,20 @@ public:
     
     // Capture screenshot from specific display
     virtual ScreenshotResult CaptureDisplay(uint32_t display_index) = 0;
+
+    // Capture only `region` of the display, or of one of its windows. The
+    // default captures the whole display and crops; backends that can read
+    // back just the rectangle override it. Windows without a native path fail.
+    virtual ScreenshotResult CaptureDisplay(uint32_t display_index, const CaptureRegion& region);
     
     // Capture screenshot from all displays
     virtual std::vector<ScreenshotResult> CaptureAllDisplays() = 0;
+
+    // Capture straight into a caller-owned RGBA buffer (used by CaptureSession).
+    // The default goes through CaptureDisplay and copies; backends that can
+    // write in place should override it.
+    virtual bool CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                                    FrameDescriptor& frame);
     
     // Check if the implementation is available on current system
     virtual bool IsSupported() = 0;
@@ -191,6 +333,28 @@ protected:
     // Helper function to flip image vertically if needed
     static void FlipImageVertically(uint8_t* data, uint32_t width, uint32_t height, 
                                   uint32_t bytes_per_pixel);
+
+    // CaptureAllDisplays for backends whose instances are independent: one
+    // instance per display, made by `factory`, captures on its own thread.
+    // The instances are kept until the display count changes.
+    std::vector<ScreenshotResult> CaptureAllDisplaysConcurrently(const Factory& factory);
+
+private:
+    std::shared_ptr<MultiDisplayCapture> concurrent_capture_;
+};
+
+// Caller memory an encode writes its file into, e.g. a pool block or a
+// Node Buffer. Nothing is written past capacity.
+struct EncodeSpan {
+    uint8_t* data = nullptr;
+    size_t capacity = 0;
+};
+
+// Outcome of an encode into an EncodeSpan
+struct EncodeIntoResult {
+    bool success = false;       // The whole file is in the span
+    size_t bytes_written = 0;
+    size_t required_size = 0;   // File size; above capacity when it did not fit, 0 on other errors
 };
 
 // WebP encoder wrapper
@@ -209,67 +373,697 @@ public:
                                   uint32_t height, uint32_t stride,
                                   const WebPEncodeParams& params);
     
+    // Encode a native BGRA capture buffer without swizzling it first. Pass
+    // alpha_valid = false for BGRX sources (GDI, X11) whose fourth byte is undefined.
+    std::vector<uint8_t> EncodeBGRA(const uint8_t* bgra_data, uint32_t width,
+                                   uint32_t height, uint32_t stride,
+                                   const WebPEncodeParams& params, bool alpha_valid = true);
+
+    // Encode opaque YUV420 planes that are already converted (e.g. read back
+    // from the GPU) with no colour conversion. Lossy only; the planes are
+    // never written to and must stay valid for the duration of the call.
+    std::vector<uint8_t> EncodeYUV420(const uint8_t* y_plane, int y_stride,
+                                     const uint8_t* u_plane, const uint8_t* v_plane, int uv_stride,
+                                     uint32_t width, uint32_t height,
+                                     const WebPEncodeParams& params);
+
+    // Memory order of the input pixels
+    enum class PixelLayout { RGB, RGBA, BGRA, BGRX };
+
+    // Encode straight into caller memory: libwebp's writer fills the span
+    // with no intermediate vector. A file that does not fit is still encoded
+    // to the end so required_size is exact; grow the span and retry, or set
+    // params.max_output_size to the capacity to make it fit.
+    EncodeIntoResult EncodeInto(const uint8_t* data, uint32_t width, uint32_t height,
+                                uint32_t stride, PixelLayout layout,
+                                const WebPEncodeParams& params, EncodeSpan output);
+
+    // EncodeYUV420 into caller memory
+    EncodeIntoResult EncodeYUV420Into(const uint8_t* y_plane, int y_stride,
+                                      const uint8_t* u_plane, const uint8_t* v_plane, int uv_stride,
+                                      uint32_t width, uint32_t height,
+                                      const WebPEncodeParams& params, EncodeSpan output);
+
+    // One image placed on a larger canvas, e.g. a display of a virtual desktop
+    struct CanvasLayer {
+        const uint8_t* data = nullptr;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;
+        int32_t x = 0;      // Canvas position; an odd edge drops its first column/row
+        int32_t y = 0;
+        PixelLayout layout = PixelLayout::RGBA;
+    };
+
+    // Encode non-overlapping layers as one WebP canvas without compositing
+    // them into a full-size bitmap first: every layer is tiled and encoded in
+    // place, and areas no layer covers stay transparent
+    std::vector<uint8_t> EncodeCanvas(const std::vector<CanvasLayer>& layers,
+                                     uint32_t canvas_width, uint32_t canvas_height,
+                                     const WebPEncodeParams& params);
+
+    // A tile that is already a standalone WebP file, e.g. a pipeline chunk
+    // or a TileCache entry, and where it goes on the canvas
+    struct EncodedTile {
+        uint32_t x = 0;     // Must be even (ANMF offsets are stored halved)
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::shared_ptr<const std::vector<uint8_t>> bitstream;
+    };
+
+    // Write pre-encoded tiles as one WebP canvas, one ANMF frame per tile.
+    // Only the image chunks of each tile are copied, straight into the file.
+    std::vector<uint8_t> AssembleTiles(const std::vector<EncodedTile>& tiles,
+                                      uint32_t canvas_width, uint32_t canvas_height,
+                                      bool has_alpha);
+
+    // AssembleTiles into caller memory, with the same result as EncodeInto
+    EncodeIntoResult AssembleTilesInto(const std::vector<EncodedTile>& tiles,
+                                       uint32_t canvas_width, uint32_t canvas_height,
+                                       bool has_alpha, EncodeSpan output);
+
+    // One frame of a batch; every frame shares the batch's size and layout
+    struct BatchFrame {
+        const uint8_t* data = nullptr;
+        uint32_t stride = 0;    // 0 = tightly packed
+    };
+
+    struct BatchStats {
+        size_t frames = 0;
+        size_t failed_frames = 0;
+        uint32_t workers = 0;
+        double elapsed_ms = 0.0;
+        double frames_per_second = 0.0;
+    };
+
+    // Gets every frame of a batch in input order, one call at a time. An
+    // empty `encoded` comes with the frame's error.
+    using BatchCallback = std::function<void(size_t index, std::vector<uint8_t>&& encoded,
+                                             const std::string& error)>;
+
+    // Encode many same-sized frames with one set of params. The params and
+    // size are validated once; then each worker (params.max_threads, 0 =
+    // one per hardware thread) encodes whole frames, reusing its picture and
+    // planes, instead of splitting single frames into tiles. Returns false
+    // only for an invalid batch; frames that fail are reported to on_frame.
+    bool EncodeBatch(const std::vector<BatchFrame>& frames, uint32_t width, uint32_t height,
+                     PixelLayout layout, const WebPEncodeParams& params,
+                     const BatchCallback& on_frame, BatchStats* stats = nullptr);
+    
+    // Receives the file from EncodeStreamingWithCallback
+    class StreamingCallback {
+    public:
+        virtual ~StreamingCallback() = default;
+        
+        // Next params.stream_buffer_size bytes of the file (the last chunk may
+        // be shorter). The memory is reused once this returns; return false to
+        // stop the encode.
+        virtual bool OnDataChunk(const uint8_t* data, size_t size) = 0;
+        
+        // Called once per encode, after the last chunk or on failure
+        virtual void OnComplete(bool success, const std::string& error_message) = 0;
+    };
+    
+    // Encode and hand the file to `callback` in fixed-size chunks straight
+    // from libwebp's writer instead of returning one buffer, so the output is
+    // never held in memory as a whole. Chunks come from the memory pool and
+    // are reused. Tiled encodes (multithreaded or content-adaptive) keep the
+    // encoded tiles until all are done, since the file header needs their
+    // sizes, and then stream them without joining them first.
+    bool EncodeStreamingWithCallback(const uint8_t* data, uint32_t width,
+                                    uint32_t height, uint32_t stride,
+                                    PixelLayout layout, const WebPEncodeParams& params,
+                                    StreamingCallback* callback);
+    
     // Get last error message
     const std::string& GetLastError() const { return last_error_; }
 
 private:
     std::string last_error_;
     
+    // Forward declaration for TileInfo structure
+    struct TileInfo;
+    
+    // Destination of an encode: one in-memory buffer, or a StreamingCallback
+    // fed in chunks
+    struct EncodeOutput;
+    
+    // Deadline of the running call when params.max_encode_ms is set. Tile
+    // workers inherit it; slice_ms_ caps the share one tile may spend.
+    struct BudgetWatch;
+    bool has_deadline_ = false;
+    std::chrono::steady_clock::time_point deadline_;
+    double slice_ms_ = 0.0;
+    
+    void StartBudget(const WebPEncodeParams& params);
+    double RemainingBudgetMs() const;
+    
     // Internal encoding implementation
     std::vector<uint8_t> EncodeInternal(const uint8_t* data, uint32_t width, 
                                        uint32_t height, uint32_t stride,
-                                       bool has_alpha, const WebPEncodeParams& params);
+                                       PixelLayout layout, const WebPEncodeParams& params);
+
+    // The whole EncodeYUV420 call, for either kind of output
+    bool EncodeYUV420To(const uint8_t* y_plane, int y_stride,
+                        const uint8_t* u_plane, const uint8_t* v_plane, int uv_stride,
+                        uint32_t width, uint32_t height,
+                        const WebPEncodeParams& params, EncodeOutput& output);
+
+    // Run `encode` (params, output) under params.max_output_size: the cap is
+    // libwebp's target size, and a file that overshoots it is encoded again
+    // at a proportionally smaller target
+    template <typename EncodeFn>
+    bool EncodeBounded(const WebPEncodeParams& params, EncodeOutput& output, EncodeFn&& encode);
+    
+    // Checks shared by the encode entry points; resolves a zero stride
+    bool ValidateInput(const uint8_t* data, uint32_t width, uint32_t height, uint32_t& stride,
+                       PixelLayout layout, const WebPEncodeParams& params);
+    
+    // Pick single, tiled or content-adaptive encoding and write to `output`
+    bool EncodeTo(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+                  PixelLayout layout, const WebPEncodeParams& params, EncodeOutput& output);
     
     // Multi-threaded encoding for large images
-    std::vector<uint8_t> EncodeMultiThreaded(const uint8_t* data, uint32_t width,
-                                            uint32_t height, uint32_t stride,
-                                            bool has_alpha, const WebPEncodeParams& params);
+    bool EncodeMultiThreaded(const uint8_t* data, uint32_t width,
+                             uint32_t height, uint32_t stride,
+                             PixelLayout layout, const WebPEncodeParams& params,
+                             EncodeOutput& output);
     
     // Single-threaded encoding implementation
-    std::vector<uint8_t> EncodeSingleThreaded(const uint8_t* data, uint32_t width,
-                                             uint32_t height, uint32_t stride,
-                                             bool has_alpha, const WebPEncodeParams& params);
+    bool EncodeSingleThreaded(const uint8_t* data, uint32_t width,
+                              uint32_t height, uint32_t stride,
+                              PixelLayout layout, const WebPEncodeParams& params,
+                              EncodeOutput& output);
     
     // Encode individual tile for multi-threaded processing
     std::vector<uint8_t> EncodeTile(const uint8_t* data, uint32_t width, uint32_t height,
-                                   uint32_t stride, bool has_alpha, const WebPEncodeParams& params);
+                                   uint32_t stride, PixelLayout layout, const WebPEncodeParams& params);
     
-    // Streaming encoding for memory efficiency
-    std::vector<uint8_t> EncodeStreaming(const uint8_t* data, uint32_t width,
-                                        uint32_t height, uint32_t stride,
-                                        bool has_alpha, const WebPEncodeParams& params);
+    // Run `encode` with the best settings the cost model fits into the
+    // remaining budget, and once more with the fastest ones if it overruns
+    template <typename EncodeFn>
+    bool EncodeWithinBudget(const WebPEncodeParams& params, uint64_t pixels,
+                            ContentAnalysis::ContentClass content_class,
+                            EncodeFn&& encode);
     
-    // Progressive encoding callback interface
-    class StreamingCallback {
-    public:
-        virtual ~StreamingCallback() = default;
-        
-        // Called when encoded data chunk is ready
-        virtual bool OnDataChunk(const uint8_t* data, size_t size) = 0;
-        
-        // Called when encoding is complete
-        virtual void OnComplete(bool success, const std::string& error_message) = 0;
-    };
+    // One libwebp encode of RGB(A) input; `watch` aborts it past a deadline
+    bool EncodePicture(const uint8_t* data, uint32_t width, uint32_t height,
+                       uint32_t stride, PixelLayout layout,
+                       const WebPEncodeParams& params, BudgetWatch* watch,
+                       EncodeOutput& output);
     
-    // Encode with streaming callback (for very large images)
-    bool EncodeStreamingWithCallback(const uint8_t* data, uint32_t width,
-                                    uint32_t height, uint32_t stride,
-                                    bool has_alpha, const WebPEncodeParams& params,
-                                    StreamingCallback* callback);
-
-private:
-    // Forward declaration for TileInfo structure
-    struct TileInfo;
+    // Cover an image with tiles of at most tile_width x tile_height
+    static std::vector<TileInfo> MakeTileGrid(const uint8_t* data, uint32_t stride, PixelLayout layout,
+                                              uint32_t width, uint32_t height,
+                                              uint32_t tile_width, uint32_t tile_height,
+                                              const WebPEncodeParams& params);
     
-    // Combine multiple encoded WebP tiles into a single WebP using VP8X extended format
-    std::vector<uint8_t> CombineEncodedTiles(const std::vector<TileInfo>& tiles, 
-                                            uint32_t total_width, uint32_t total_height,
-                                            bool has_alpha);
+    // Encode every tile with its own source and params on up to `threads` threads
+    bool EncodeTiles(std::vector<TileInfo>& tiles, uint32_t threads);
+    
+    // Tiled encode on a fixed grid when params.tile_cache is set; unchanged
+    // tiles, or an unchanged frame, come from TileCache
+    bool EncodeWithTileCache(const uint8_t* data, uint32_t width,
+                             uint32_t height, uint32_t stride,
+                             PixelLayout layout, const WebPEncodeParams& params,
+                             EncodeOutput& output);
+    
+    // Split a frame along content boundaries when params.content_adaptive is set
+    bool EncodeContentAdaptive(const uint8_t* data, uint32_t width,
+                               uint32_t height, uint32_t stride,
+                               PixelLayout layout, const WebPEncodeParams& params,
+                               EncodeOutput& output);
+    
+    // Checks and places EncodedTiles for AssembleTiles(Into)
+    bool AssembleTilesTo(const std::vector<EncodedTile>& tiles,
+                         uint32_t canvas_width, uint32_t canvas_height,
+                         bool has_alpha, EncodeOutput& output);
+    
+    // Write encoded tiles as one WebP file (VP8X canvas, one ANMF frame per tile)
+    // transparent_gaps marks a canvas that tiles do not fully cover
+    bool CombineEncodedTiles(const std::vector<TileInfo>& tiles, 
+                             uint32_t total_width, uint32_t total_height,
+                             bool has_alpha, bool transparent_gaps, EncodeOutput& output);
 };
 
+// Process-wide LRU of encoded tiles and whole files behind
+// WebPEncodeParams::tile_cache. Polling captures repeat most of the screen
+// from frame to frame, so a tile whose pixels and settings were encoded
+// before is reused instead of encoded again. Thread-safe.
+namespace TileCache {
+    struct Key {
+        uint64_t pixel_hash = 0;
+        uint64_t params_hash = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+
+        bool operator==(const Key& other) const {
+            return pixel_hash == other.pixel_hash && params_hash == other.params_hash &&
+                   width == other.width && height == other.height;
+        }
+    };
+
+    // Shared with every encode that hits the entry; never modified
+    using Bitstream = std::shared_ptr<const std::vector<uint8_t>>;
+
+    // xxHash64 of a buffer, and of `height` rows of row_bytes each (the
+    // stride does not change the result)
+    uint64_t HashBytes(const uint8_t* data, size_t size, uint64_t seed = 0);
+    uint64_t HashRows(const uint8_t* data, size_t row_bytes, uint32_t height, uint32_t stride,
+                      uint64_t seed = 0);
+
+    // Every setting that changes the encoded bytes, and the pixel layout
+    uint64_t HashParams(const WebPEncodeParams& params, WebPEncoder::PixelLayout layout);
+
+    Key MakeKey(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+                WebPEncoder::PixelLayout layout, const WebPEncodeParams& params);
+
+    // Key of a whole file made of tiles, from the tiles' keys in order. Its
+    // pixel hash never equals a tile's, so frames and tiles share the cache.
+    Key MakeFrameKey(const std::vector<Key>& tile_keys, uint32_t width, uint32_t height);
+
+    // Null on a miss; a hit becomes the most recently used entry
+    Bitstream Find(const Key& key);
+
+    // Evicts least recently used entries until the budget holds; an entry
+    // larger than the whole budget is not kept
+    void Insert(const Key& key, Bitstream encoded);
+
+    struct CacheStats {
+        size_t entries;
+        size_t bytes;
+        size_t max_bytes;
+        uint64_t evictions;
+    };
+
+    CacheStats GetStats();
+
+    // Byte budget of the encoded data, 64 MB by default; 0 disables the cache
+    void SetMaxBytes(size_t max_bytes);
+    void Clear();
+}
+
 // Factory function to create platform-specific screenshot capture instance
 std::unique_ptr<ScreenshotCapture> CreateScreenshotCapture();
 
+// One-time setup that would otherwise land on the first capture or encode:
+// libwebp's DSP tables, GPU shader bytecode and the capture backend's
+// display-server probes. Each step runs at most once per process; repeated
+// and concurrent calls wait only for a step still in progress. Thread-safe.
+namespace Warmup {
+    struct Options {
+        bool encoder = true;  // Lossy and lossless libwebp paths
+        bool gpu = true;      // YUV420 compute shader (Windows); nothing elsewhere
+        // Builds one backend and lists its displays, which fills the process-wide
+        // probes later instances reuse. Null skips the step.
+        std::function<std::unique_ptr<ScreenshotCapture>()> capture_factory;
+    };
+
+    struct Report {
+        bool encoder_ready = false;
+        bool gpu_ready = false;       // False when there is no GPU path to prepare
+        bool capture_ready = false;
+        std::string capture_backend;  // GetImplementationName of the warmed backend
+        std::string error;            // Why a step failed
+        // Time this call spent in each step; near zero once a step has run
+        double encoder_ms = 0.0;
+        double gpu_ms = 0.0;
+        double capture_ms = 0.0;
+    };
+
+    Report Run(const Options& options = Options());
+
+    // Run on a new thread, e.g. while a CLI parses its arguments or a
+    // serverless handler waits for its first request. The future may be
+    // dropped; the thread is joined at exit.
+    std::shared_future<Report> RunInBackground(Options options = Options());
+}
+
+// Frame handed to the consumer of a CaptureSession. The pixels live in one of
+// the session's ring buffers and stay valid until ReleaseFrame.
+struct CapturedFrame {
+    const uint8_t* data = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+    uint32_t bytes_per_pixel = 0;
+    uint64_t timestamp_us = 0;   // Steady clock, taken when the capture completed
+    uint64_t sequence = 0;       // One per capture tick; gaps mean dropped frames
+    uint32_t slot = 0;
+    // Damage since the previous captured frame, valid until ReleaseFrame;
+    // nullptr when the backend does not report it
+    const std::vector<DirtyRect>* dirty_rects = nullptr;
+};
+
+// Named shared-memory ring of raw frames for consumers in other processes
+// (OCR, ML sidecars). The mapping starts with a RingHeader, followed by
+// slot_count SlotHeaders and then the page-aligned pixel area of each slot.
+// The writer never waits for readers: every SlotHeader is a seqlock that is
+// odd while its slot is being refilled, and readers check it again after
+// using the pixels. Layout version 1; integers are in the writer's native
+// byte order.
+namespace SharedRing {
+    constexpr uint32_t kMagic = 0x52465357;        // "WSFR"
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kMaxSlots = 255;
+    constexpr uint32_t kMaxDirtyRects = 16;        // More are merged into their bounding box
+    constexpr uint32_t kNoDirtyRects = 0xFFFFFFFF; // dirty_count when the backend reports none
+    constexpr uint32_t kFormatRGBA = 0x41424752;   // "RGBA"
+    constexpr uint32_t kFormatRGB = 0x20424752;    // "RGB "
+
+    struct alignas(64) RingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slot_count;
+        uint32_t writer_pid;
+        uint64_t slot_headers_offset;
+        uint64_t data_offset;        // First slot's pixels
+        uint64_t slot_stride;        // Distance between slots' pixels, a page multiple
+        uint64_t slot_capacity;      // Pixel bytes a slot can hold
+        // ((sequence + 1) << 8) | slot of the newest complete frame; 0 before the first
+        std::atomic<uint64_t> latest;
+        std::atomic<uint32_t> closed;  // Set when the writer stops
+    };
+
+    struct alignas(64) SlotHeader {
+        std::atomic<uint64_t> lock;  // Odd while the slot is being written
+        uint64_t sequence;           // CapturedFrame::sequence
+        uint64_t timestamp_us;       // Writer's steady clock
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+        uint32_t format;             // kFormatRGBA or kFormatRGB
+        uint32_t dirty_count;
+        uint32_t reserved;
+        DirtyRect dirty_rects[kMaxDirtyRects];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+                  "Ring atomics are shared between processes and must not use locks");
+}
+
+// Writer side of a SharedRing mapping. Linux uses a memfd, or POSIX shm when
+// given a name; macOS uses POSIX shm; Windows a named file mapping. Not
+// thread-safe; CaptureSession drives it from its capture thread.
+class SharedFrameRing {
+public:
+    struct Config {
+        // Empty picks an anonymous memfd on Linux and a generated name elsewhere
+        std::string name;
+        uint32_t slot_count = 4;
+        size_t slot_capacity = 0;   // Pixel bytes per slot
+    };
+
+    SharedFrameRing();
+    ~SharedFrameRing();
+
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+    bool Create(const Config& config);
+    // Marks the ring closed for readers and unmaps it; a named ring is unlinked
+    void Close();
+    bool IsOpen() const;
+
+    uint32_t GetSlotCount() const;
+    size_t GetSlotCapacity() const;
+    uint8_t* GetSlotData(uint32_t slot);
+
+    // Bracket every write of a slot's pixels. Publish makes the frame the
+    // ring's latest; Abandon leaves the slot empty after a failed capture.
+    void BeginWrite(uint32_t slot);
+    void Publish(uint32_t slot, const CapturedFrame& frame);
+    void Abandon(uint32_t slot);
+
+    // What a reader passes to SharedFrameReader::Open: the shm or mapping
+    // name, or /proc/<pid>/fd/<fd> for a memfd. Opening another process's
+    // fd needs ptrace access (Yama may refuse it); pass GetNativeHandle over
+    // a Unix socket instead, or use a named ring.
+    std::string GetLocator() const;
+    intptr_t GetNativeHandle() const;   // fd, or HANDLE on Windows
+
+    const std::string& GetLastError() const { return last_error_; }
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::string last_error_;
+};
+
+// A frame read in place from another process's ring. The pixels stay
+// mapped while the reader is open but can be overwritten at any time;
+// SharedFrameReader::IsIntact says whether they were.
+struct SharedFrameView {
+    const uint8_t* data = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+    uint32_t format = 0;
+    uint64_t sequence = 0;
+    uint64_t timestamp_us = 0;
+    uint32_t slot = 0;
+    uint64_t lock = 0;
+    bool has_dirty_rects = false;
+    std::vector<DirtyRect> dirty_rects;
+};
+
+// Read-only side of a SharedRing mapping, for sidecar processes
+class SharedFrameReader {
+public:
+    SharedFrameReader();
+    ~SharedFrameReader();
+
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+    bool Open(const std::string& locator);
+    void Close();
+
+    // Newest complete frame with a sequence above after_sequence (pass the
+    // previous view's sequence to wait for a new one). False when there is
+    // none yet or the writer is refilling that slot right now.
+    bool AcquireLatest(SharedFrameView& view, uint64_t after_sequence = 0);
+
+    // True while view's slot still holds that frame; check after reading
+    // the pixels, or copy them first
+    bool IsIntact(const SharedFrameView& view) const;
+
+    bool IsWriterClosed() const;
+    const std::string& GetLastError() const { return last_error_; }
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::string last_error_;
+};
+
+// Where a thread runs and how the OS schedules it. Every part is best effort:
+// anything the platform or the process's privileges refuse is skipped and
+// reported in the Result, never fatal.
+namespace ThreadPlacement {
+    constexpr int32_t kAnyCore = -1;
+    constexpr int32_t kAnyNode = -1;
+
+    enum class Priority {
+        Normal,
+        High,      // MMCSS "Capture" (Windows), QoS user-interactive (macOS), nice -10 (Linux)
+        Realtime   // High plus MMCSS critical priority (Windows) or SCHED_FIFO (Linux)
+    };
+
+    struct Policy {
+        int32_t core = kAnyCore;        // Pin to this logical CPU; not available on macOS
+        int32_t numa_node = kAnyNode;   // Else keep to this node's CPUs
+        Priority priority = Priority::Normal;
+
+        bool IsDefault() const {
+            return core == kAnyCore && numa_node == kAnyNode && priority == Priority::Normal;
+        }
+    };
+
+    struct Result {
+        bool placed = true;         // Core or node affinity applied (or none asked for)
+        bool prioritized = true;    // Priority applied (or Normal asked for)
+        std::string error;          // What was skipped and why
+    };
+
+    // Apply to the calling thread
+    Result Apply(const Policy& policy);
+
+    // 1 on machines (and platforms) without NUMA
+    uint32_t GetNumaNodeCount();
+    // Logical CPUs of a node, ascending; empty for an unknown node
+    std::vector<uint32_t> GetNodeCores(uint32_t node);
+    // Node of the CPU the calling thread is on right now, kAnyNode if unknown
+    int32_t GetCurrentNumaNode();
+    // Node holding the page at address, kAnyNode if unknown or not yet faulted in
+    int32_t GetMemoryNode(const void* address);
+    // Prefer node for the pages of [address, address + size), moving any that
+    // are already resident. address must be page aligned. Linux only; Windows
+    // places pages on the node of the thread that first touches them.
+    bool BindMemory(void* address, size_t size, int32_t node);
+}
+
+// Continuous capture of one display at a target frame rate. Setup happens once
+// in Start; a capture thread fills a ring of preallocated buffers and hands
+// them to a single consumer through a lock-free SPSC queue. When the consumer
+// holds every buffer the tick is dropped instead of queueing more frames.
+class CaptureSession {
+public:
+    struct Config {
+        uint32_t display_index = 0;
+        double target_fps = 30.0;
+        uint32_t ring_size = 4;   // Number of preallocated frame buffers
+        // Capture into a SharedFrameRing so other processes can map the same
+        // frames the consumer gets. Its slots are sized for the display at
+        // Start; frames of a larger mode are captured privately and not shared.
+        bool shared_ring = false;
+        std::string shared_ring_name;   // See SharedFrameRing::Config::name
+        // Applied by the capture thread as it starts. A pinned, High priority
+        // thread keeps capture timestamps steady while encoders load the box.
+        ThreadPlacement::Policy capture_thread;
+    };
+
+    struct Stats {
+        uint64_t frames_captured;
+        uint64_t frames_dropped;
+        uint64_t capture_failures;
+        uint64_t frames_shared;    // Published to the shared ring
+        double average_capture_ms;
+        bool capture_thread_placed;   // Every part of capture_thread applied
+    };
+
+    CaptureSession(std::shared_ptr<ScreenshotCapture> capture, const Config& config);
+    ~CaptureSession();
+
+    CaptureSession(const CaptureSession&) = delete;
+    CaptureSession& operator=(const CaptureSession&) = delete;
+
+    bool Start();
+    void Stop();
+    bool IsRunning() const;
+
+    // Consumer side; must be called from a single thread
+    bool TryAcquireFrame(CapturedFrame& frame);
+    bool AcquireFrame(CapturedFrame& frame, uint32_t timeout_ms);
+    void ReleaseFrame(const CapturedFrame& frame);
+
+    Stats GetStats() const;
+    const std::string& GetLastError() const { return last_error_; }
+
+    // SharedFrameRing::GetLocator of the running session; empty without one
+    std::string GetSharedRingLocator() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::string last_error_;
+};
+
+// Captures several displays at the same moment. Every display gets its own
+// backend instance and worker thread, both created in Start and reused for
+// each CaptureAll, so per-display state (X connection, duplication, capture
+// stream) is never shared between threads and the displays do not queue
+// behind each other.
+class MultiDisplayCapture {
+public:
+    struct DisplayFrame {
+        DisplayInfo info;
+        ScreenshotResult result;
+        uint64_t timestamp_us = 0;   // Steady clock, taken when this display's capture completed
+    };
+
+    explicit MultiDisplayCapture(ScreenshotCapture::Factory factory);
+    ~MultiDisplayCapture();
+
+    MultiDisplayCapture(const MultiDisplayCapture&) = delete;
+    MultiDisplayCapture& operator=(const MultiDisplayCapture&) = delete;
+
+    // Start one worker per display; an empty list means every display
+    bool Start(const std::vector<uint32_t>& display_indices = {});
+    void Stop();
+    bool IsRunning() const;
+    size_t GetDisplayCount() const;
+
+    // Release every worker at once and wait for all of them; frames are in
+    // the order of Start's display list
+    std::vector<DisplayFrame> CaptureAll();
+
+    // Spread between the first and last completed capture of the last CaptureAll
+    uint64_t GetLastCaptureSkewUs() const;
+
+    // Encode CaptureAll's frames as one virtual-desktop WebP. Displays are
+    // placed by DisplayInfo x/y, scaled by the largest scale_factor, and
+    // encoded in place as tiles of a single canvas.
+    static std::vector<uint8_t> EncodeVirtualDesktop(const std::vector<DisplayFrame>& frames,
+                                                     const WebPEncodeParams& params,
+                                                     std::string& error);
+
+    const std::string& GetLastError() const { return last_error_; }
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::string last_error_;
+};
+
+// Records a sequence of frames as one animated WebP (session replay). Each
+// frame is encoded only over the bounding rectangle of what changed since the
+// previous one and drawn over the canvas with an ANMF frame (no blending, no
+// disposal); a full keyframe is written on a schedule so a player that seeks
+// or a truncated file recovers. Changes come from the backend's dirty rects
+// when it reports them, checked and tightened by a SIMD frame diff, or from
+// the diff alone. All frames share the first frame's size. Not thread-safe;
+// feed it from the thread that consumes the CaptureSession.
+class AnimationRecorder {
+public:
+    struct Config {
+        WebPEncodeParams params;              // Every frame is a single picture; tiling is turned off
+        uint32_t keyframe_interval_ms = 10000; // 0 encodes only the first frame in full
+        uint32_t loop_count = 1;               // 0 loops forever
+        uint32_t background_argb = 0x00000000;
+    };
+
+    struct Stats {
+        uint64_t frames_added;
+        uint64_t frames_written;     // ANMF frames; an unchanged frame extends the previous one
+        uint64_t keyframes;
+        uint64_t encoded_pixels;     // Pixels sent to the encoder
+        uint64_t full_frame_pixels;  // Pixels encoding every added frame in full would take
+        uint64_t output_bytes;
+    };
+
+    explicit AnimationRecorder(const Config& config);
+    ~AnimationRecorder();
+
+    AnimationRecorder(const AnimationRecorder&) = delete;
+    AnimationRecorder& operator=(const AnimationRecorder&) = delete;
+
+    // Add a frame taken at timestamp_us (steady clock). dirty_rects, when
+    // set, must cover everything that changed since the previously added
+    // frame; an empty list means nothing did.
+    bool AddFrame(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+                  WebPEncoder::PixelLayout layout, uint64_t timestamp_us,
+                  const std::vector<DirtyRect>* dirty_rects = nullptr);
+
+    // Add a CaptureSession frame with the damage its backend reported. Every
+    // acquired frame has to be added for that damage to add up.
+    bool AddFrame(const CapturedFrame& frame);
+
+    // Write the animation and start a new, empty recording. Stats describe
+    // the finished recording until the next frame is added.
+    std::vector<uint8_t> Finish();
+
+    Stats GetStats() const;
+    const std::string& GetLastError() const { return last_error_; }
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::string last_error_;
+};
+
 // Utility functions
 namespace Utils {
     // Get current timestamp in milliseconds
@@ -286,29 +1080,85 @@ namespace Utils {
                                  uint32_t bytes_per_pixel);
     
     // Memory pool utilities
-    std::unique_ptr<uint8_t[]> AllocateScreenshotBuffer(size_t size);
-    void ReturnScreenshotBuffer(std::unique_ptr<uint8_t[]> buffer, size_t size);
+    PoolBuffer AllocateScreenshotBuffer(size_t size);
+    void ReturnScreenshotBuffer(PoolBuffer buffer, size_t size);
     ScreenshotMemoryPool::PoolStats GetMemoryPoolStats();
+
+    // Clip a capture region to a width x height source. False, with error
+    // set, when none of it is left.
+    bool ClipCaptureRegion(const CaptureRegion& region, uint32_t width, uint32_t height,
+                           DirtyRect& clipped, std::string& error);
+
+    // Copy `rect` of a captured frame into a new, tightly packed result
+    ScreenshotResult CropScreenshotResult(const ScreenshotResult& source, const DirtyRect& rect);
 }
 
 // SIMD-optimized pixel format conversion functions
 namespace SIMD {
+    // Kernel sets, one per instruction set level. The x86 levels are ordered
+    // so a higher level includes the ones below it.
+    enum class ISA { Scalar, SSE2, SSE41, AVX2, AVX512, NEON };
+
     // Convert BGRA format to RGBA format
     void ConvertBGRAToRGBA(const uint8_t* bgra_data, uint8_t* rgba_data, uint32_t pixel_count);
     
+    // Same, for BGRX sources whose fourth byte is undefined: every alpha is set to 0xFF
+    void ConvertBGRXToRGBA(const uint8_t* bgrx_data, uint8_t* rgba_data, uint32_t pixel_count);
+    
     // Convert RGBA format to RGB format (removes alpha channel)
     void ConvertRGBAToRGB(const uint8_t* rgba_data, uint8_t* rgb_data, uint32_t pixel_count);
     
     // In-place BGRA to RGBA conversion (swaps R and B channels)
     void ConvertBGRAToRGBAInPlace(uint8_t* data, uint32_t pixel_count);
     
+    // Convert RGB(A)/BGR(A) rows straight into YUV420 (and alpha) planes in one
+    // pass, bit-exact with WebPPictureImportRGBA. step is 3 or 4 bytes per
+    // pixel; bgr_order reads native BGRA/BGRX capture buffers without a swizzle.
+    // Alpha is written only when a_plane is set. Returns true if any alpha is not 0xFF.
+    bool ConvertToYUV420(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+                         uint32_t step, bool bgr_order,
+                         uint8_t* y_plane, int y_stride,
+                         uint8_t* u_plane, uint8_t* v_plane, int uv_stride,
+                         uint8_t* a_plane, int a_stride);
+    
+    // Byte offset of the first / the last difference between two buffers of
+    // `size` bytes, or `size` when they are equal (frame differencing)
+    size_t FindFirstDifference(const uint8_t* a, const uint8_t* b, size_t size);
+    size_t FindLastDifference(const uint8_t* a, const uint8_t* b, size_t size);
+    
+    // Halve an 8-bit plane (Y, U or V) with a 2x2 box filter into a
+    // (width + 1) / 2 x (height + 1) / 2 plane; an odd last column or row is
+    // averaged with itself
+    void DownsamplePlane2x(const uint8_t* src, uint32_t width, uint32_t height, int src_stride,
+                           uint8_t* dst, int dst_stride);
+    
     // Get available SIMD capabilities as string
     std::string GetSIMDCapabilities();
+
+    // Kernels are compiled per ISA into one portable binary and chosen at
+    // load time from the CPU's features; this is the level in use
+    ISA GetActiveISA();
+
+    // Kernels this build and CPU can run, best first ("avx512", "avx2",
+    // "sse4.1", "sse2", "neon"), always ending with "scalar". "avx512" needs
+    // AVX-512 F, BW and VBMI.
+    std::vector<std::string> GetAvailableISAs();
+
+    // Dispatch to one of GetAvailableISAs() so benchmarks and tests can
+    // exercise each kernel; "auto" restores the detected level. Returns false
+    // for an unavailable ISA. Conversions already running finish on the
+    // kernels they started with.
+    bool SetISALimit(const std::string& isa);
     
     // Advanced SIMD-optimized WebP encoding
     std::vector<uint8_t> EncodeSIMDOptimized(const uint8_t* rgba_data, uint32_t width, 
                                             uint32_t height, uint32_t stride,
                                             const WebPEncodeParams& params);
+
+    // EncodeSIMDOptimized into caller memory (see WebPEncoder::EncodeInto)
+    EncodeIntoResult EncodeSIMDOptimizedInto(const uint8_t* rgba_data, uint32_t width,
+                                             uint32_t height, uint32_t stride,
+                                             const WebPEncodeParams& params, EncodeSpan output);
     
     // Get WebP SIMD optimization capabilities
     std::string GetWebPSIMDOptimizations();
@@ -320,6 +1170,11 @@ namespace GPU {
     std::vector<uint8_t> EncodeGPUAccelerated(const uint8_t* rgba_data, uint32_t width,
                                              uint32_t height, uint32_t stride,
                                              const WebPEncodeParams& params);
+
+    // EncodeGPUAccelerated into caller memory (see WebPEncoder::EncodeInto)
+    EncodeIntoResult EncodeGPUAcceleratedInto(const uint8_t* rgba_data, uint32_t width,
+                                              uint32_t height, uint32_t stride,
+                                              const WebPEncodeParams& params, EncodeSpan output);
     
     // Get GPU WebP encoding capabilities
     std::string GetGPUWebPCapabilities();
@@ -344,17 +1199,124 @@ namespace ZeroCopy {
     
     // Encode WebP with zero-copy optimization (no intermediate pixel copying)
     std::vector<uint8_t> EncodeWebPZeroCopy(uint32_t display_index, const WebPEncodeParams& params);
+
+    // EncodeWebPZeroCopy into caller memory (see WebPEncoder::EncodeInto)
+    EncodeIntoResult EncodeWebPZeroCopyInto(uint32_t display_index, const WebPEncodeParams& params,
+                                            EncodeSpan output);
     
     // Zero-copy statistics
     struct ZeroCopyStats {
         uint64_t zero_copy_operations;
         uint64_t traditional_operations;
         uint64_t total_memory_saved_mb;
-        double average_speed_improvement_percent;
     };
     
     ZeroCopyStats GetZeroCopyStatistics();
     std::string GetZeroCopyInfo();
 }
 
+// Chunked worker-pool pipeline for 8K+ captures (ultra_streaming_pipeline.cc)
+namespace UltraStreaming {
+    // Return false to cancel; progress runs from 0 to 100
+    using StreamingProgressCallback = std::function<bool(double progress_percent, const std::string& status)>;
+
+    // Where the pipeline's encode workers run
+    struct WorkerPlacement {
+        // Split the workers evenly over the NUMA nodes, each kept to its
+        // node's CPUs, and queue every chunk on a worker of the node holding
+        // the frame. Idle workers steal from their own node first.
+        bool numa_aware = false;
+        // Pin each worker to one core of its node (of the machine without
+        // numa_aware). libwebp's thread_level helper shares that core.
+        bool pin_workers = false;
+    };
+
+    // Start the shared pipeline (0 = one worker per hardware thread). The
+    // placement only takes effect on the call that starts the workers.
+    bool InitializeUltraStreaming(uint32_t worker_threads = 0, const WorkerPlacement& placement = {});
+
+    // Capture a display and encode it, tiling across the workers at 8K and up
+    std::future<std::vector<uint8_t>> CaptureAndEncodeUltraLarge(
+        uint32_t display_index, const WebPEncodeParams& params,
+        StreamingProgressCallback callback = nullptr);
+
+    // CaptureAndEncodeUltraLarge into caller memory: the chunks' frames are
+    // assembled straight into `output`, which must stay valid until the
+    // future is ready
+    std::future<EncodeIntoResult> CaptureAndEncodeUltraLargeInto(
+        uint32_t display_index, const WebPEncodeParams& params, EncodeSpan output,
+        StreamingProgressCallback callback = nullptr);
+
+    std::future<std::vector<std::vector<uint8_t>>> CaptureMultipleDisplaysUltraLarge(
+        const std::vector<uint32_t>& display_indices, const WebPEncodeParams& params,
+        StreamingProgressCallback callback = nullptr);
+
+    // All displays (empty = every display) captured together as one WebP
+    // laid out by desktop position
+    std::future<std::vector<uint8_t>> CaptureVirtualDesktopUltraLarge(
+        const std::vector<uint32_t>& display_indices, const WebPEncodeParams& params,
+        StreamingProgressCallback callback = nullptr);
+
+    // One size of a multi-resolution encode. scale multiplies both dimensions
+    // (1 = full size) and max_dimension, when set, caps the longer side after
+    // scaling: {1.0f}, {0.5f} and {1.0f, 256} give full, half and thumbnail.
+    struct PyramidLevelSpec {
+        float scale = 1.0f;
+        uint32_t max_dimension = 0;
+        WebPEncodeParams params;
+    };
+
+    struct MultiResolutionLevel {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        float scale_factor = 0.0f;          // Level width over frame width
+        std::vector<uint8_t> encoded_data;  // Empty on failure
+        std::string error_message;
+    };
+
+    // Encode several sizes of one frame from a single YUV420 conversion: the
+    // smaller levels are box-filtered down from the converted planes and all
+    // levels encode in parallel on the workers. Results follow the order of
+    // `levels`. Downscaled levels are lossy and opaque; a full-size level
+    // that needs RGB (lossless, sharp YUV, content-adaptive, tile cache) is
+    // encoded from the frame itself.
+    std::future<std::vector<MultiResolutionLevel>> CaptureMultiResolutionUltraLarge(
+        uint32_t display_index, const std::vector<PyramidLevelSpec>& levels,
+        StreamingProgressCallback callback = nullptr);
+
+    // The same for a frame that is already captured
+    std::vector<MultiResolutionLevel> EncodeMultiResolution(
+        const ScreenshotResult& screenshot, const std::vector<PyramidLevelSpec>& levels,
+        StreamingProgressCallback callback = nullptr);
+
+    void ConfigureUltraStreaming(uint32_t chunk_width, uint32_t chunk_height,
+                                 uint64_t max_memory_mb, int compression_level);
+
+    // Pipeline counters since it started; all zero before InitializeUltraStreaming
+    struct StreamingStats {
+        uint64_t total_pixels_processed;
+        uint64_t total_chunks_processed;
+        uint64_t peak_memory_usage_mb;
+        double average_throughput_mpixels_per_sec;
+        uint32_t active_worker_threads;
+        double compression_ratio;
+
+        // Scheduler contention
+        uint64_t tasks_stolen;              // Tasks run by a worker other than the one queued on
+        uint64_t queue_lock_contentions;    // Deque lock acquisitions that had to wait
+        uint64_t worker_idle_waits;         // Times a worker found every deque empty and slept
+        uint64_t memory_budget_waits;       // Submissions that blocked on the memory budget
+        double memory_budget_wait_ms;       // Total time spent blocked on the memory budget
+
+        // Placement
+        uint32_t numa_nodes;                // Nodes the workers are spread over
+        uint64_t cross_node_steals;         // Stolen tasks that came from another node's queue
+        uint32_t placement_failures;        // Workers whose affinity could not be applied
+    };
+
+    StreamingStats GetUltraStreamingStats();
+
+    std::string GetUltraStreamingInfo();
+}
+
 } // namespace WebPScreenshot
\ No newline at end of file
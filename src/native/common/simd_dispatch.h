@@ -0,0 +1,37 @@
+#pragma once
+
+// Intrinsics and per-function ISA targets for runtime-dispatched kernels.
+// Code is built for the architecture baseline; each kernel opts into its ISA
+// with WEBP_TARGET_*, so one binary runs on every CPU of the architecture and
+// callers pick kernels from SIMD::GetActiveISA(). MSVC compiles any intrinsic
+// without /arch, so the attributes are empty there.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define WEBP_USE_X86 1
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #endif
+    // AVX-512 kernels use 64-bit byte masks
+    #if defined(__x86_64__) || defined(_M_X64)
+        #define WEBP_USE_AVX512 1
+    #endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__aarch64__)
+    #define WEBP_USE_NEON 1
+    #include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define WEBP_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define WEBP_TARGET(isa)
+#endif
+
+// Intrinsics do not inline into functions without the matching target, so
+// helpers called from a kernel carry its target too (lambdas cannot)
+#define WEBP_TARGET_SSE2 WEBP_TARGET("sse2")
+#define WEBP_TARGET_SSE41 WEBP_TARGET("sse4.1")
+#define WEBP_TARGET_AVX2 WEBP_TARGET("avx2")
+#define WEBP_TARGET_AVX512 WEBP_TARGET("avx512f,avx512bw,avx512vbmi")
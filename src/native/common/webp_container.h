@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace WebPScreenshot {
+namespace WebPContainer {
+
+// RIFF/WebP chunk helpers shared by the writers of extended (VP8X) files:
+// tiled canvases and animations
+
+constexpr size_t kRiffHeaderSize = 12;
+constexpr size_t kChunkHeaderSize = 8;
+
+constexpr uint8_t kVP8XAlphaFlag = 0x10;
+constexpr uint8_t kVP8XAnimationFlag = 0x02;
+constexpr uint8_t kANMFNoBlend = 0x02;      // Overwrite the canvas instead of alpha-blending
+constexpr uint32_t kMaxFrameDuration = (1u << 24) - 1;  // ANMF durations are 24-bit ms
+
+inline void PutLE16(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+}
+
+inline void PutLE24(std::vector<uint8_t>& out, uint32_t value) {
+    PutLE16(out, value);
+    out.push_back((value >> 16) & 0xFF);
+}
+
+inline void PutLE32(std::vector<uint8_t>& out, uint32_t value) {
+    PutLE16(out, value);
+    PutLE16(out, value >> 16);
+}
+
+inline void SetLE32(std::vector<uint8_t>& out, size_t offset, uint32_t value) {
+    out[offset] = value & 0xFF;
+    out[offset + 1] = (value >> 8) & 0xFF;
+    out[offset + 2] = (value >> 16) & 0xFF;
+    out[offset + 3] = (value >> 24) & 0xFF;
+}
+
+inline uint32_t GetLE32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+// RIFF header and a VP8X chunk with no flags set; returns the flags offset
+inline size_t PutExtendedHeader(std::vector<uint8_t>& out, uint32_t canvas_width, uint32_t canvas_height) {
+    out.insert(out.end(), {'R', 'I', 'F', 'F'});
+    PutLE32(out, 0);  // patched by FinishFile
+    out.insert(out.end(), {'W', 'E', 'B', 'P'});
+
+    out.insert(out.end(), {'V', 'P', '8', 'X'});
+    PutLE32(out, 10);
+    const size_t flags_offset = out.size();
+    out.push_back(0);
+    PutLE24(out, 0);  // reserved
+    PutLE24(out, canvas_width - 1);
+    PutLE24(out, canvas_height - 1);
+    return flags_offset;
+}
+
+inline void PutAnimationHeader(std::vector<uint8_t>& out, uint32_t background_bgra, uint32_t loop_count) {
+    out.insert(out.end(), {'A', 'N', 'I', 'M'});
+    PutLE32(out, 6);
+    PutLE32(out, background_bgra);
+    PutLE16(out, loop_count);
+}
+
+// Header of an ANMF frame whose `size` bytes of image chunks (from
+// FindImageChunks) follow it. x and y must be even.
+inline void PutAnimationFrameHeader(std::vector<uint8_t>& out, uint32_t x, uint32_t y,
+                                    uint32_t width, uint32_t height, uint32_t duration_ms,
+                                    uint8_t flags, size_t size) {
+    out.insert(out.end(), {'A', 'N', 'M', 'F'});
+    PutLE32(out, static_cast<uint32_t>(16 + size));
+    PutLE24(out, x / 2);
+    PutLE24(out, y / 2);
+    PutLE24(out, width - 1);
+    PutLE24(out, height - 1);
+    PutLE24(out, duration_ms);
+    out.push_back(flags);
+}
+
+inline void PutAnimationFrame(std::vector<uint8_t>& out, uint32_t x, uint32_t y,
+                              uint32_t width, uint32_t height, uint32_t duration_ms, uint8_t flags,
+                              const uint8_t* image_chunks, size_t size) {
+    PutAnimationFrameHeader(out, x, y, width, height, duration_ms, flags, size);
+    // libwebp pads every chunk, so the payload is already even-sized
+    out.insert(out.end(), image_chunks, image_chunks + size);
+}
+
+// Patch the RIFF size; false when the file outgrew the 32-bit RIFF limit
+inline bool FinishFile(std::vector<uint8_t>& out) {
+    if (out.size() - 8 > UINT32_MAX) {
+        return false;
+    }
+    SetLE32(out, 4, static_cast<uint32_t>(out.size() - 8));
+    return true;
+}
+
+// Locate the image chunks (ALPH + VP8, or VP8L) inside a standalone WebP file,
+// skipping the RIFF header and any VP8X chunk
+inline bool FindImageChunks(const std::vector<uint8_t>& webp, size_t* offset, size_t* size,
+                            bool* has_alpha) {
+    if (webp.size() < kRiffHeaderSize + kChunkHeaderSize ||
+        std::memcmp(webp.data(), "RIFF", 4) != 0 ||
+        std::memcmp(webp.data() + 8, "WEBP", 4) != 0) {
+        return false;
+    }
+
+    size_t pos = kRiffHeaderSize;
+    *has_alpha = false;
+
+    if (std::memcmp(webp.data() + pos, "VP8X", 4) == 0) {
+        // An animation has no single image to take chunks from
+        if (webp[pos + kChunkHeaderSize] & kVP8XAnimationFlag) {
+            return false;
+        }
+        *has_alpha = (webp[pos + kChunkHeaderSize] & kVP8XAlphaFlag) != 0;
+        pos += kChunkHeaderSize + GetLE32(webp.data() + pos + 4);
+    }
+
+    if (pos + kChunkHeaderSize > webp.size()) {
+        return false;
+    }
+
+    if (std::memcmp(webp.data() + pos, "ALPH", 4) == 0) {
+        *has_alpha = true;
+    } else if (std::memcmp(webp.data() + pos, "VP8L", 4) == 0 &&
+               pos + kChunkHeaderSize + 5 <= webp.size()) {
+        // alpha_is_used is bit 28 of the VP8L header, after the 0x2f signature
+        *has_alpha |= (webp[pos + kChunkHeaderSize + 4] & 0x10) != 0;
+    }
+
+    *offset = pos;
+    *size = webp.size() - pos;
+    return true;
+}
+
+} // namespace WebPContainer
+} // namespace WebPScreenshot
@@ -0,0 +1,237 @@
+#include "common/screenshot_common.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define WEBP_USE_SSE2 1
+    #include <emmintrin.h>
+#endif
+
+namespace WebPScreenshot {
+namespace ContentAnalysis {
+
+namespace {
+
+constexpr uint32_t kRowStep = 8;
+constexpr uint32_t kMinSampledRows = 32;
+constexpr uint32_t kPaletteLimit = 256;
+constexpr uint8_t kEdgeThreshold = 32;
+// Neighbours that differ by a little: sensor noise, JPEG/video artefacts, shading
+constexpr float kPhotoTexturedFraction = 0.15f;
+// UI is mostly flat; a tile of nothing but hard edges is noise or dithering
+constexpr float kGraphicsFlatFraction = 0.5f;
+
+// Open-addressing set of RGB values, sized to stay sparse at kPaletteLimit + 1
+class ColorSet {
+public:
+    ColorSet() { std::memset(slots_, 0, sizeof(slots_)); }
+
+    bool Saturated() const { return count_ > kPaletteLimit; }
+    uint32_t Count() const { return count_; }
+
+    void Insert(uint32_t rgb) {
+        const uint32_t key = rgb + 1;  // 0 marks an empty slot
+        uint32_t slot = (key * 0x9E3779B1u) >> (32 - kBits);
+        while (slots_[slot] != 0) {
+            if (slots_[slot] == key) return;
+            slot = (slot + 1) & (kSlots - 1);
+        }
+        slots_[slot] = key;
+        ++count_;
+    }
+
+private:
+    static constexpr uint32_t kBits = 10;
+    static constexpr uint32_t kSlots = 1u << kBits;
+    uint32_t slots_[kSlots];
+    uint32_t count_ = 0;
+};
+
+inline uint32_t LoadRGB(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+// Counts identical and hard-edged horizontal neighbours in one row
+void ScanRowScalar(const uint8_t* row, uint32_t first, uint32_t width, uint32_t bytes_per_pixel,
+                   uint32_t* flat, uint32_t* edges) {
+    for (uint32_t x = first; x + 1 < width; ++x) {
+        const uint8_t* a = row + x * bytes_per_pixel;
+        const uint8_t* b = a + bytes_per_pixel;
+        int max_diff = 0;
+        for (int c = 0; c < 3; ++c) {
+            max_diff = std::max(max_diff, std::abs(static_cast<int>(a[c]) - b[c]));
+        }
+        *flat += max_diff == 0;
+        *edges += max_diff > kEdgeThreshold;
+    }
+}
+
+#ifdef WEBP_USE_SSE2
+// Four neighbour pairs per iteration on 4-byte pixels; returns where it stopped
+uint32_t ScanRowSSE2(const uint8_t* row, uint32_t width, uint32_t* flat, uint32_t* edges) {
+    const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i threshold = _mm_set1_epi8(static_cast<char>(kEdgeThreshold));
+    const __m128i zero = _mm_setzero_si128();
+
+    uint32_t x = 0;
+    for (; x + 5 <= width; x += 4) {
+        const __m128i a = _mm_and_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4)), rgb_mask);
+        const __m128i b = _mm_and_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4 + 4)), rgb_mask);
+        const __m128i diff = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+
+        const int same = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(diff, zero)));
+        const __m128i over = _mm_subs_epu8(diff, threshold);
+        const int soft = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(over, zero)));
+
+        static const uint8_t kBitCount[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+        *flat += kBitCount[same];
+        *edges += 4 - kBitCount[soft];
+    }
+    return x;
+}
+#endif
+
+void ScanRow(const uint8_t* row, uint32_t width, uint32_t bytes_per_pixel,
+             uint32_t* flat, uint32_t* edges) {
+    uint32_t x = 0;
+#ifdef WEBP_USE_SSE2
+    if (bytes_per_pixel == 4) {
+        x = ScanRowSSE2(row, width, flat, edges);
+    }
+#endif
+    ScanRowScalar(row, x, width, bytes_per_pixel, flat, edges);
+}
+
+// Runs of one colour are the norm in UI content, so only colour changes are hashed
+void CollectColors(const uint8_t* row, uint32_t width, uint32_t bytes_per_pixel, ColorSet& colors) {
+    uint32_t previous = LoadRGB(row);
+    colors.Insert(previous);
+    for (uint32_t x = 1; x < width && !colors.Saturated(); ++x) {
+        const uint32_t rgb = LoadRGB(row + x * bytes_per_pixel);
+        if (rgb != previous) {
+            colors.Insert(rgb);
+            previous = rgb;
+        }
+    }
+}
+
+ContentClass Classify(const ContentStats& stats) {
+    if (stats.unique_colors <= kPaletteLimit) {
+        return ContentClass::Palette;
+    }
+    // UI neighbours are either identical or a hard edge; continuous tone is
+    // everything in between, so even a partly photographic tile counts
+    const float textured = 1.0f - stats.flat_fraction - stats.edge_density;
+    if (textured < kPhotoTexturedFraction && stats.flat_fraction >= kGraphicsFlatFraction) {
+        return ContentClass::Graphics;
+    }
+    return ContentClass::Photo;
+}
+
+} // anonymous namespace
+
+ContentStats AnalyzeRegion(const uint8_t* data, uint32_t width, uint32_t height,
+                           uint32_t stride, uint32_t bytes_per_pixel) {
+    ContentStats stats;
+    if (!data || width == 0 || height == 0 || (bytes_per_pixel != 3 && bytes_per_pixel != 4)) {
+        return stats;
+    }
+
+    const uint32_t step = std::max(1u, std::min(kRowStep, height / kMinSampledRows));
+    ColorSet colors;
+    uint32_t flat = 0;
+    uint32_t edges = 0;
+    uint32_t pairs = 0;
+
+    // Start half a step in so the first and last rows of a tile weigh the same
+    for (uint32_t y = step / 2; y < height; y += step) {
+        const uint8_t* row = data + static_cast<size_t>(y) * stride;
+        ScanRow(row, width, bytes_per_pixel, &flat, &edges);
+        if (!colors.Saturated()) {
+            CollectColors(row, width, bytes_per_pixel, colors);
+        }
+        pairs += width - 1;
+        stats.sampled_pixels += width;
+    }
+
+    stats.unique_colors = colors.Count();
+    if (pairs > 0) {
+        stats.flat_fraction = static_cast<float>(flat) / pairs;
+        stats.edge_density = static_cast<float>(edges) / pairs;
+    } else {
+        // A one-pixel-wide region has no neighbours; the colour count decides
+        stats.flat_fraction = 1.0f;
+    }
+    stats.content_class = Classify(stats);
+    return stats;
+}
+
+WebPEncodeParams ParamsForContent(const ContentStats& stats, const WebPEncodeParams& base) {
+    WebPEncodeParams params = base;
+    params.content_adaptive = 0;
+
+    if (base.target_size > 0 || base.target_psnr > 0.0f) {
+        return params;
+    }
+
+    // Lossless quality is encoder effort. The levels below measured smaller
+    // and faster than method 4 lossy on UI tiles; a lower requested method
+    // still wins so callers can trade size for speed.
+    switch (stats.content_class) {
+        case ContentClass::Palette:
+            // Colour-indexed VP8L barely improves beyond method 2
+            params.lossless = 1;
+            params.quality = 25.0f;
+            params.method = std::min(base.method, 2);
+            break;
+
+        case ContentClass::Graphics:
+            // Methods 1-2 spend their time on backward-reference search that
+            // flat UI does not reward; method 3 is both smaller and quicker
+            params.lossless = 1;
+            params.quality = 25.0f;
+            params.method = std::min(base.method, 3);
+            break;
+
+        case ContentClass::Photo:
+            if (!base.lossless) {
+                params.method = std::min(base.method, 2);
+            }
+            break;
+    }
+    return params;
+}
+
+const char* ContentClassName(ContentClass content_class) {
+    switch (content_class) {
+        case ContentClass::Palette: return "palette";
+        case ContentClass::Graphics: return "graphics";
+        case ContentClass::Photo: return "photo";
+    }
+    return "unknown";
+}
+
+} // namespace ContentAnalysis
+
+namespace Utils {
+
+float CalculateOptimalQuality(const uint8_t* data, uint32_t width, uint32_t height,
+                              uint32_t bytes_per_pixel) {
+    const ContentAnalysis::ContentStats stats = ContentAnalysis::AnalyzeRegion(
+        data, width, height, width * bytes_per_pixel, bytes_per_pixel);
+
+    // Lossy quality that keeps text legible for the detected content
+    switch (stats.content_class) {
+        case ContentAnalysis::ContentClass::Palette: return 95.0f;
+        case ContentAnalysis::ContentClass::Graphics: return 90.0f;
+        case ContentAnalysis::ContentClass::Photo: return 80.0f;
+    }
+    return 80.0f;
+}
+
+} // namespace Utils
+
+} // namespace WebPScreenshot
@@ -0,0 +1,167 @@
+#include "common/screenshot_common.h"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace WebPScreenshot {
+namespace EncodeCost {
+
+namespace {
+
+constexpr int kMethodCount = 7;
+constexpr int kClassCount = 3;
+
+// Nanoseconds per pixel by method for one encode on the reference machine,
+// measured on 1 MP screen-content frames with libwebp 1.2.4. Lossy cost
+// hardly depends on content; lossless cost does, by a factor of three.
+constexpr double kLossyNsPerPixel[kMethodCount] = {30, 40, 45, 95, 95, 110, 185};
+constexpr double kLosslessNsPerPixel[kClassCount][kMethodCount] = {
+    {8, 95, 95, 100, 95, 120, 120},      // Palette
+    {30, 150, 150, 150, 150, 200, 220},  // Graphics
+    {50, 250, 300, 280, 290, 450, 400},  // Photo
+};
+constexpr double kSharpYuvFactor = 1.3;
+
+constexpr double kOverheadMs = 0.3;        // Per-call setup that does not scale with pixels
+constexpr uint64_t kMinLearnPixels = 64 * 64;  // Smaller encodes are all overhead
+constexpr double kLearningRate = 0.25;
+constexpr double kMinScale = 0.05;
+constexpr double kMaxScale = 20.0;
+
+// Plan below the budget since frame-to-frame encode times vary, and pad the
+// estimate of the fallback that has to fit after an abort
+constexpr double kBudgetHeadroom = 0.85;
+constexpr double kFallbackMargin = 1.25;
+
+// This machine's speed relative to the reference, per class and lossy/lossless
+struct Model {
+    std::mutex mutex;
+    double scale[kClassCount][2];
+
+    Model() { ResetLocked(); }
+
+    void ResetLocked() {
+        std::fill(&scale[0][0], &scale[0][0] + kClassCount * 2, 1.0);
+    }
+};
+
+Model& GetModel() {
+    static Model model;
+    return model;
+}
+
+inline int ClassIndex(ContentAnalysis::ContentClass content_class) {
+    return static_cast<int>(content_class);
+}
+
+double ReferenceMs(const WebPEncodeParams& params, uint64_t pixels,
+                   ContentAnalysis::ContentClass content_class) {
+    const int method = std::max(0, std::min(params.method, kMethodCount - 1));
+    double ns_per_pixel;
+    if (params.lossless) {
+        ns_per_pixel = kLosslessNsPerPixel[ClassIndex(content_class)][method];
+    } else {
+        ns_per_pixel = kLossyNsPerPixel[method];
+        // Size and PSNR targets re-encode up to `pass` times
+        if (params.target_size > 0 || params.target_psnr > 0.0f) {
+            ns_per_pixel *= std::max(1, params.pass);
+        }
+        if (params.use_sharp_yuv) {
+            ns_per_pixel *= kSharpYuvFactor;
+        }
+    }
+    return ns_per_pixel * static_cast<double>(pixels) / 1e6;
+}
+
+bool SameEffort(const WebPEncodeParams& a, const WebPEncodeParams& b) {
+    return a.method == b.method && a.pass == b.pass && a.use_sharp_yuv == b.use_sharp_yuv;
+}
+
+} // anonymous namespace
+
+double EstimateMs(const WebPEncodeParams& params, uint64_t pixels,
+                  ContentAnalysis::ContentClass content_class) {
+    Model& model = GetModel();
+    double scale;
+    {
+        std::lock_guard<std::mutex> lock(model.mutex);
+        scale = model.scale[ClassIndex(content_class)][params.lossless ? 1 : 0];
+    }
+    return kOverheadMs + ReferenceMs(params, pixels, content_class) * scale;
+}
+
+void Record(const WebPEncodeParams& params, uint64_t pixels,
+            ContentAnalysis::ContentClass content_class, double elapsed_ms) {
+    if (pixels < kMinLearnPixels || elapsed_ms <= 0.0) {
+        return;
+    }
+
+    const double reference_ms = ReferenceMs(params, pixels, content_class);
+    const double ratio = std::max(kMinScale, std::min(kMaxScale,
+        std::max(elapsed_ms - kOverheadMs, 0.01) / reference_ms));
+
+    // Averaged in the log domain so one slow outlier cannot double the estimate
+    Model& model = GetModel();
+    std::lock_guard<std::mutex> lock(model.mutex);
+    double& scale = model.scale[ClassIndex(content_class)][params.lossless ? 1 : 0];
+    scale = std::exp((1.0 - kLearningRate) * std::log(scale) + kLearningRate * std::log(ratio));
+}
+
+WebPEncodeParams FastestParams(const WebPEncodeParams& params) {
+    WebPEncodeParams fastest = params;
+    fastest.method = 0;
+    fastest.pass = 1;
+    fastest.use_sharp_yuv = 0;
+    fastest.max_encode_ms = 0.0f;
+    return fastest;
+}
+
+BudgetPlan PlanForBudget(const WebPEncodeParams& params, uint64_t pixels,
+                         ContentAnalysis::ContentClass content_class, double budget_ms) {
+    BudgetPlan plan;
+    plan.fallback = FastestParams(params);
+    plan.params = plan.fallback;
+    plan.predicted_ms = EstimateMs(plan.fallback, pixels, content_class);
+
+    // Anything slower than the fallback must leave time to run the fallback
+    const double abort_after_ms = budget_ms - plan.predicted_ms * kFallbackMargin;
+    if (abort_after_ms <= 0.0) {
+        return plan;
+    }
+
+    WebPEncodeParams candidate = params;
+    candidate.max_encode_ms = 0.0f;
+
+    // Pass count only matters with a size/PSNR target, so it is dropped before
+    // method; sharp YUV is kept as long as any method fits with it
+    for (int sharp = params.use_sharp_yuv; sharp >= 0; --sharp) {
+        candidate.use_sharp_yuv = sharp;
+        for (int method = params.method; method >= 0; --method) {
+            candidate.method = method;
+            for (int pass : {params.pass, 1}) {
+                candidate.pass = pass;
+                if (SameEffort(candidate, plan.fallback)) {
+                    return plan;
+                }
+
+                const double predicted_ms = EstimateMs(candidate, pixels, content_class);
+                if (predicted_ms <= abort_after_ms * kBudgetHeadroom) {
+                    plan.params = candidate;
+                    plan.predicted_ms = predicted_ms;
+                    plan.abort_after_ms = abort_after_ms;
+                    return plan;
+                }
+            }
+        }
+    }
+    return plan;
+}
+
+void Reset() {
+    Model& model = GetModel();
+    std::lock_guard<std::mutex> lock(model.mutex);
+    model.ResetLocked();
+}
+
+} // namespace EncodeCost
+} // namespace WebPScreenshot
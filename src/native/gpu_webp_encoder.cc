@@ -1,11 +1,13 @@
 #include "common/screenshot_common.h"
+#include <atomic>
+#include <mutex>
 
 #ifdef _WIN32
+#include "windows/gpu_yuv_converter.h"
 #include <d3d11.h>
-#include <d3dcompiler.h>
+#include <webp/encode.h>
 #include <winrt/base.h>
 #pragma comment(lib, "d3d11.lib")
-#pragma comment(lib, "d3dcompiler.lib")
 #endif
 
 #ifdef __APPLE__
@@ -22,32 +24,47 @@ public:
     GPUWebPEncoder();
     ~GPUWebPEncoder();
     
+    // Device creation and the shader build are attempted once; later calls,
+    // from any thread, return the cached outcome
     bool Initialize();
-    bool IsSupported() const { return is_supported_; }
+    bool IsSupported() const { return is_supported_.load(std::memory_order_acquire); }
     
     // GPU-accelerated WebP encoding
     std::vector<uint8_t> EncodeGPU(const uint8_t* rgba_data, uint32_t width, 
                                   uint32_t height, uint32_t stride,
                                   const WebPEncodeParams& params);
+
+    // GPU-accelerated encoding into caller memory
+    EncodeIntoResult EncodeGPUInto(const uint8_t* rgba_data, uint32_t width,
+                                   uint32_t height, uint32_t stride,
+                                   const WebPEncodeParams& params, EncodeSpan output);
     
     // Get GPU acceleration capabilities
     std::string GetGPUCapabilities() const;
 
 private:
-    bool is_supported_;
+    std::once_flag init_once_;
+    std::atomic<bool> is_supported_;
     
 #ifdef _WIN32
-    // DirectCompute implementation
+    // DirectCompute implementation: RGB->YUV420 on the GPU, VP8 in libwebp
     winrt::com_ptr<ID3D11Device> d3d_device_;
     winrt::com_ptr<ID3D11DeviceContext> d3d_context_;
-    winrt::com_ptr<ID3D11ComputeShader> webp_encode_shader_;
-    winrt::com_ptr<ID3D11Buffer> constant_buffer_;
+    std::unique_ptr<Windows::D3D11YUVConverter> yuv_converter_;
     
     bool InitializeDirectCompute();
     std::vector<uint8_t> EncodeWithDirectCompute(const uint8_t* rgba_data, 
                                                 uint32_t width, uint32_t height, 
                                                 uint32_t stride, const WebPEncodeParams& params);
-    bool CreateWebPShaders();
+    EncodeIntoResult EncodeWithDirectComputeInto(const uint8_t* rgba_data,
+                                                 uint32_t width, uint32_t height, uint32_t stride,
+                                                 const WebPEncodeParams& params, EncodeSpan output);
+
+    // Uploads the frame and maps its YUV420 planes; false means use the CPU.
+    // A true return must be followed by yuv_converter_->Unmap().
+    bool ConvertOnGPU(const uint8_t* rgba_data, uint32_t width, uint32_t height,
+                      uint32_t stride, const WebPEncodeParams& params,
+                      Windows::YUV420Planes& planes);
 #endif
 
 #ifdef __APPLE__
@@ -77,15 +94,12 @@ private:
     std::vector<uint8_t> FallbackCPUEncode(const uint8_t* rgba_data, uint32_t width,
                                           uint32_t height, uint32_t stride,
                                           const WebPEncodeParams& params);
+    EncodeIntoResult FallbackCPUEncodeInto(const uint8_t* rgba_data, uint32_t width,
+                                           uint32_t height, uint32_t stride,
+                                           const WebPEncodeParams& params, EncodeSpan output);
 };
 
 GPUWebPEncoder::GPUWebPEncoder() : is_supported_(false) {
-#ifdef _WIN32
-    d3d_device_ = nullptr;
-    d3d_context_ = nullptr;
-    webp_encode_shader_ = nullptr;
-    constant_buffer_ = nullptr;
-#endif
 
 #ifdef __APPLE__
     metal_device_ = nullptr;
@@ -97,43 +111,39 @@ GPUWebPEncoder::GPUWebPEncoder() : is_supported_(false) {
 GPUWebPEncoder::~GPUWebPEncoder() = default;
 
 bool GPUWebPEncoder::Initialize() {
-    if (is_supported_) return true;
-    
-    try {
+    // A machine without a usable GPU would otherwise retry device creation
+    // and shader compilation on every chunk
+    std::call_once(init_once_, [this] {
+        bool supported = false;
+        try {
 #ifdef _WIN32
-        if (InitializeDirectCompute()) {
-            is_supported_ = true;
-            return true;
-        }
+            supported = InitializeDirectCompute();
 #endif
 
 #ifdef __APPLE__
-        if (InitializeMetal()) {
-            is_supported_ = true;
-            return true;
-        }
+            supported = InitializeMetal();
 #endif
-        
-        return false;
-    } catch (...) {
-        return false;
-    }
+        } catch (...) {
+            supported = false;
+        }
+        is_supported_.store(supported, std::memory_order_release);
+    });
+    return IsSupported();
 }
 
 #ifdef _WIN32
 bool GPUWebPEncoder::InitializeDirectCompute() {
-    // Create D3D11 device for compute
+    // Compute shaders with typed UAV stores need feature level 11_0
     D3D_FEATURE_LEVEL feature_levels[] = {
         D3D_FEATURE_LEVEL_11_1,
-        D3D_FEATURE_LEVEL_11_0,
-        D3D_FEATURE_LEVEL_10_1
+        D3D_FEATURE_LEVEL_11_0
     };
     
     HRESULT hr = D3D11CreateDevice(
         nullptr,
         D3D_DRIVER_TYPE_HARDWARE,
         nullptr,
-        D3D11_CREATE_DEVICE_DEBUG,
+        D3D11_CREATE_DEVICE_BGRA_SUPPORT,
         feature_levels,
         ARRAYSIZE(feature_levels),
         D3D11_SDK_VERSION,
@@ -146,123 +156,20 @@ bool GPUWebPEncoder::InitializeDirectCompute() {
         return false;
     }
     
-    // Check for compute shader support
-    D3D11_FEATURE_DATA_D3D11_OPTIONS options;
-    hr = d3d_device_->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
-    
-    if (FAILED(hr)) {
-        return false;
-    }
-    
-    return CreateWebPShaders();
-}
-
-bool GPUWebPEncoder::CreateWebPShaders() {
-    // GPU-accelerated WebP encoding compute shader
-    const char* webp_shader_source = R"(
-cbuffer WebPParams : register(b0)
-{
-    float quality;
-    uint method;
-    uint segments;
-    uint filter_strength;
-    uint width;
-    uint height;
-    uint2 padding;
+    yuv_converter_ = std::make_unique<Windows::D3D11YUVConverter>();
+    return yuv_converter_->Initialize(d3d_device_.get());
 }
 
-Texture2D<float4> InputTexture : register(t0);
-RWTexture2D<float4> OutputTexture : register(u0);
-RWByteAddressBuffer OutputBuffer : register(u1);
-
-// Simplified WebP encoding on GPU (conceptual implementation)
-[numthreads(8, 8, 1)]
-void CSMain(uint3 id : SV_DispatchThreadID)
-{
-    if (id.x >= width || id.y >= height)
-        return;
-    
-    float4 pixel = InputTexture[id.xy];
-    
-    // GPU-accelerated color space conversion (RGB to YUV)
-    float Y = 0.299f * pixel.r + 0.587f * pixel.g + 0.114f * pixel.b;
-    float U = -0.169f * pixel.r - 0.331f * pixel.g + 0.5f * pixel.b + 0.5f;
-    float V = 0.5f * pixel.r - 0.419f * pixel.g - 0.081f * pixel.b + 0.5f;
-    
-    // Apply quality-based quantization on GPU
-    float quant_factor = (100.0f - quality) / 100.0f;
-    Y = round(Y / (1.0f + quant_factor)) * (1.0f + quant_factor);
-    U = round(U / (1.0f + quant_factor)) * (1.0f + quant_factor);
-    V = round(V / (1.0f + quant_factor)) * (1.0f + quant_factor);
-    
-    // Store processed pixel
-    OutputTexture[id.xy] = float4(Y, U, V, pixel.a);
-    
-    // Write compressed data to output buffer (simplified)
-    uint pixel_index = id.y * width + id.x;
-    uint compressed_value = 
-        (uint(Y * 255.0f) << 24) |
-        (uint(U * 255.0f) << 16) |
-        (uint(V * 255.0f) << 8) |
-        uint(pixel.a * 255.0f);
-    
-    OutputBuffer.Store(pixel_index * 4, compressed_value);
-}
-)";
-    
-    winrt::com_ptr<ID3DBlob> shader_blob;
-    winrt::com_ptr<ID3DBlob> error_blob;
-    
-    HRESULT hr = D3DCompile(
-        webp_shader_source,
-        strlen(webp_shader_source),
-        nullptr,
-        nullptr,
-        nullptr,
-        "CSMain",
-        "cs_5_0",
-        D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION,
-        0,
-        shader_blob.put(),
-        error_blob.put()
-    );
-    
-    if (FAILED(hr)) {
-        if (error_blob) {
-            // Log compilation error
-            const char* error_msg = static_cast<const char*>(error_blob->GetBufferPointer());
-            // In a real implementation, log this error
-        }
-        return false;
-    }
-    
-    hr = d3d_device_->CreateComputeShader(
-        shader_blob->GetBufferPointer(),
-        shader_blob->GetBufferSize(),
-        nullptr,
-        webp_encode_shader_.put()
-    );
-    
-    if (FAILED(hr)) {
+bool GPUWebPEncoder::ConvertOnGPU(const uint8_t* rgba_data, uint32_t width, uint32_t height,
+                                  uint32_t stride, const WebPEncodeParams& params,
+                                  Windows::YUV420Planes& planes) {
+    // The GPU produces opaque YUV420, which only plain lossy encoding can use
+    if (params.lossless || params.use_sharp_yuv || width > WEBP_MAX_DIMENSION ||
+        height > WEBP_MAX_DIMENSION) {
         return false;
     }
     
-    // Create constant buffer
-    D3D11_BUFFER_DESC buffer_desc = {};
-    buffer_desc.ByteWidth = sizeof(GPUWebPParams);
-    buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
-    buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    
-    hr = d3d_device_->CreateBuffer(&buffer_desc, nullptr, constant_buffer_.put());
-    
-    return SUCCEEDED(hr);
-}
-
-std::vector<uint8_t> GPUWebPEncoder::EncodeWithDirectCompute(const uint8_t* rgba_data,
-                                                           uint32_t width, uint32_t height,
-                                                           uint32_t stride, const WebPEncodeParams& params) {
-    // Create input texture
+    // Upload the frame; for captures already on the GPU use D3D11YUVConverter directly
     D3D11_TEXTURE2D_DESC tex_desc = {};
     tex_desc.Width = width;
     tex_desc.Height = height;
@@ -270,143 +177,64 @@ std::vector<uint8_t> GPUWebPEncoder::EncodeWithDirectCompute(const uint8_t* rgba
     tex_desc.ArraySize = 1;
     tex_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     tex_desc.SampleDesc.Count = 1;
-    tex_desc.Usage = D3D11_USAGE_DEFAULT;
+    tex_desc.Usage = D3D11_USAGE_IMMUTABLE;
     tex_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
     
     D3D11_SUBRESOURCE_DATA init_data = {};
     init_data.pSysMem = rgba_data;
-    init_data.SysMemPitch = stride;
+    init_data.SysMemPitch = stride ? stride : width * 4;
     
     winrt::com_ptr<ID3D11Texture2D> input_texture;
     HRESULT hr = d3d_device_->CreateTexture2D(&tex_desc, &init_data, input_texture.put());
     
     if (FAILED(hr)) {
-        return FallbackCPUEncode(rgba_data, width, height, stride, params);
-    }
-    
-    // Create shader resource view
-    winrt::com_ptr<ID3D11ShaderResourceView> input_srv;
-    hr = d3d_device_->CreateShaderResourceView(input_texture.get(), nullptr, input_srv.put());
-    
-    if (FAILED(hr)) {
-        return FallbackCPUEncode(rgba_data, width, height, stride, params);
-    }
-    
-    // Create output texture
-    tex_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-    winrt::com_ptr<ID3D11Texture2D> output_texture;
-    hr = d3d_device_->CreateTexture2D(&tex_desc, nullptr, output_texture.put());
-    
-    if (FAILED(hr)) {
-        return FallbackCPUEncode(rgba_data, width, height, stride, params);
-    }
-    
-    // Create unordered access view
-    winrt::com_ptr<ID3D11UnorderedAccessView> output_uav;
-    hr = d3d_device_->CreateUnorderedAccessView(output_texture.get(), nullptr, output_uav.put());
-    
-    if (FAILED(hr)) {
-        return FallbackCPUEncode(rgba_data, width, height, stride, params);
-    }
-    
-    // Create output buffer for compressed data
-    D3D11_BUFFER_DESC buffer_desc = {};
-    buffer_desc.ByteWidth = width * height * 4; // Maximum possible size
-    buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-    buffer_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-    buffer_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
-    
-    winrt::com_ptr<ID3D11Buffer> output_buffer;
-    hr = d3d_device_->CreateBuffer(&buffer_desc, nullptr, output_buffer.put());
-    
-    if (FAILED(hr)) {
-        return FallbackCPUEncode(rgba_data, width, height, stride, params);
+        return false;
     }
     
-    // Create buffer UAV
-    D3D11_UNORDERED_ACCESS_VIEW_DESC uav_desc = {};
-    uav_desc.Format = DXGI_FORMAT_R32_TYPELESS;
-    uav_desc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-    uav_desc.Buffer.FirstElement = 0;
-    uav_desc.Buffer.NumElements = width * height;
-    uav_desc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
-    
-    winrt::com_ptr<ID3D11UnorderedAccessView> buffer_uav;
-    hr = d3d_device_->CreateUnorderedAccessView(output_buffer.get(), &uav_desc, buffer_uav.put());
-    
-    if (FAILED(hr)) {
+    yuv_converter_->Reset();
+    return yuv_converter_->Submit(input_texture.get(), 1.0f) && yuv_converter_->MapOldest(planes, true);
+}
+
+std::vector<uint8_t> GPUWebPEncoder::EncodeWithDirectCompute(const uint8_t* rgba_data,
+                                                           uint32_t width, uint32_t height,
+                                                           uint32_t stride, const WebPEncodeParams& params) {
+    Windows::YUV420Planes planes;
+    if (!ConvertOnGPU(rgba_data, width, height, stride, params, planes)) {
         return FallbackCPUEncode(rgba_data, width, height, stride, params);
     }
     
-    // Update constant buffer
-    D3D11_MAPPED_SUBRESOURCE mapped;
-    hr = d3d_context_->Map(constant_buffer_.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    WebPEncoder encoder;
+    std::vector<uint8_t> result = encoder.EncodeYUV420(planes.y, planes.y_stride, planes.u, planes.v,
+                                                       planes.uv_stride, planes.width, planes.height,
+                                                       params);
+    yuv_converter_->Unmap();
     
-    if (FAILED(hr)) {
+    if (result.empty()) {
         return FallbackCPUEncode(rgba_data, width, height, stride, params);
     }
     
-    GPUWebPParams* gpu_params = static_cast<GPUWebPParams*>(mapped.pData);
-    gpu_params->quality = params.quality;
-    gpu_params->method = params.method;
-    gpu_params->segments = params.segments;
-    gpu_params->filter_strength = params.filter_strength;
-    gpu_params->width = width;
-    gpu_params->height = height;
-    
-    d3d_context_->Unmap(constant_buffer_.get(), 0);
-    
-    // Dispatch compute shader
-    d3d_context_->CSSetShader(webp_encode_shader_.get(), nullptr, 0);
-    d3d_context_->CSSetConstantBuffers(0, 1, constant_buffer_.get());
-    d3d_context_->CSSetShaderResources(0, 1, input_srv.get());
-    
-    ID3D11UnorderedAccessView* uavs[] = { output_uav.get(), buffer_uav.get() };
-    d3d_context_->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
-    
-    // Dispatch threads
-    uint32_t dispatch_x = (width + 7) / 8;
-    uint32_t dispatch_y = (height + 7) / 8;
-    d3d_context_->Dispatch(dispatch_x, dispatch_y, 1);
-    
-    // Read back results
-    buffer_desc.Usage = D3D11_USAGE_STAGING;
-    buffer_desc.BindFlags = 0;
-    buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-    buffer_desc.MiscFlags = 0;
-    
-    winrt::com_ptr<ID3D11Buffer> staging_buffer;
-    hr = d3d_device_->CreateBuffer(&buffer_desc, nullptr, staging_buffer.put());
-    
-    if (FAILED(hr)) {
-        return FallbackCPUEncode(rgba_data, width, height, stride, params);
+    return result;
+}
+
+EncodeIntoResult GPUWebPEncoder::EncodeWithDirectComputeInto(const uint8_t* rgba_data,
+                                                             uint32_t width, uint32_t height, uint32_t stride,
+                                                             const WebPEncodeParams& params, EncodeSpan output) {
+    Windows::YUV420Planes planes;
+    if (!ConvertOnGPU(rgba_data, width, height, stride, params, planes)) {
+        return FallbackCPUEncodeInto(rgba_data, width, height, stride, params, output);
     }
     
-    d3d_context_->CopyResource(staging_buffer.get(), output_buffer.get());
+    WebPEncoder encoder;
+    EncodeIntoResult result = encoder.EncodeYUV420Into(planes.y, planes.y_stride, planes.u, planes.v,
+                                                       planes.uv_stride, planes.width, planes.height,
+                                                       params, output);
+    yuv_converter_->Unmap();
     
-    hr = d3d_context_->Map(staging_buffer.get(), 0, D3D11_MAP_READ, 0, &mapped);
-    
-    if (FAILED(hr)) {
-        return FallbackCPUEncode(rgba_data, width, height, stride, params);
+    // A file that only missed the span would miss it on the CPU as well
+    if (!result.success && result.required_size == 0) {
+        return FallbackCPUEncodeInto(rgba_data, width, height, stride, params, output);
     }
     
-    // Copy GPU-processed data
-    std::vector<uint8_t> result;
-    const uint8_t* gpu_data = static_cast<const uint8_t*>(mapped.pData);
-    
-    // In a real implementation, this would be proper WebP-formatted data
-    // For now, we return the GPU-processed raw data as a placeholder
-    result.assign(gpu_data, gpu_data + (width * height * 4));
-    
-    d3d_context_->Unmap(staging_buffer.get(), 0);
-    
-    // Clean up
-    ID3D11UnorderedAccessView* null_uavs[] = { nullptr, nullptr };
-    d3d_context_->CSSetUnorderedAccessViews(0, 2, null_uavs, nullptr);
-    ID3D11ShaderResourceView* null_srvs[] = { nullptr };
-    d3d_context_->CSSetShaderResources(0, 1, null_srvs);
-    d3d_context_->CSSetShader(nullptr, nullptr, 0);
-    
     return result;
 }
 #endif
@@ -561,7 +389,7 @@ std::vector<uint8_t> GPUWebPEncoder::EncodeWithMetal(const uint8_t* rgba_data,
 std::vector<uint8_t> GPUWebPEncoder::EncodeGPU(const uint8_t* rgba_data, uint32_t width,
                                               uint32_t height, uint32_t stride,
                                               const WebPEncodeParams& params) {
-    if (!is_supported_) {
+    if (!IsSupported()) {
         return FallbackCPUEncode(rgba_data, width, height, stride, params);
     }
     
@@ -580,6 +408,25 @@ std::vector<uint8_t> GPUWebPEncoder::EncodeGPU(const uint8_t* rgba_data, uint32_
     }
 }
 
+EncodeIntoResult GPUWebPEncoder::EncodeGPUInto(const uint8_t* rgba_data, uint32_t width,
+                                               uint32_t height, uint32_t stride,
+                                               const WebPEncodeParams& params, EncodeSpan output) {
+    if (!IsSupported()) {
+        return FallbackCPUEncodeInto(rgba_data, width, height, stride, params, output);
+    }
+    
+    try {
+#ifdef _WIN32
+        return EncodeWithDirectComputeInto(rgba_data, width, height, stride, params, output);
+#endif
+        
+        // The Metal path has no bitstream writer of its own to redirect
+        return FallbackCPUEncodeInto(rgba_data, width, height, stride, params, output);
+    } catch (...) {
+        return FallbackCPUEncodeInto(rgba_data, width, height, stride, params, output);
+    }
+}
+
 std::vector<uint8_t> GPUWebPEncoder::FallbackCPUEncode(const uint8_t* rgba_data, uint32_t width,
                                                       uint32_t height, uint32_t stride,
                                                       const WebPEncodeParams& params) {
@@ -587,8 +434,14 @@ std::vector<uint8_t> GPUWebPEncoder::FallbackCPUEncode(const uint8_t* rgba_data,
     return SIMD::EncodeSIMDOptimized(rgba_data, width, height, stride, params);
 }
 
+EncodeIntoResult GPUWebPEncoder::FallbackCPUEncodeInto(const uint8_t* rgba_data, uint32_t width,
+                                                       uint32_t height, uint32_t stride,
+                                                       const WebPEncodeParams& params, EncodeSpan output) {
+    return SIMD::EncodeSIMDOptimizedInto(rgba_data, width, height, stride, params, output);
+}
+
 std::string GPUWebPEncoder::GetGPUCapabilities() const {
-    if (!is_supported_) {
+    if (!IsSupported()) {
         return "GPU WebP Encoding: Not Available";
     }
     
@@ -616,13 +469,17 @@ static GPUWebPEncoder g_gpu_encoder;
 std::vector<uint8_t> EncodeGPUAccelerated(const uint8_t* rgba_data, uint32_t width,
                                          uint32_t height, uint32_t stride,
                                          const WebPEncodeParams& params) {
-    if (!g_gpu_encoder.IsSupported()) {
-        g_gpu_encoder.Initialize();
-    }
-    
+    g_gpu_encoder.Initialize();
     return g_gpu_encoder.EncodeGPU(rgba_data, width, height, stride, params);
 }
 
+EncodeIntoResult EncodeGPUAcceleratedInto(const uint8_t* rgba_data, uint32_t width,
+                                          uint32_t height, uint32_t stride,
+                                          const WebPEncodeParams& params, EncodeSpan output) {
+    g_gpu_encoder.Initialize();
+    return g_gpu_encoder.EncodeGPUInto(rgba_data, width, height, stride, params, output);
+}
+
 std::string GetGPUWebPCapabilities() {
     return g_gpu_encoder.GetGPUCapabilities();
 }
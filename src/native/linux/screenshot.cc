@@ -7,6 +7,7 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 
 // X11 includes
@@ -18,15 +19,23 @@
 #include <sys/shm.h>
 
 // Wayland includes (if available)
-#ifdef HAVE_WAYLAND
+#if HAVE_WAYLAND
 #include <wayland-client.h>
 #include <wayland-client-protocol.h>
-// Note: wlr-screencopy protocol headers would be generated from .xml files
 #endif
 
 namespace WebPScreenshot {
 namespace Linux {
 
+namespace {
+
+std::atomic<bool>& WaylandUnusable() {
+    static std::atomic<bool> unusable{false};
+    return unusable;
+}
+
+} // anonymous namespace
+
 // LinuxScreenshotCapture implementation
 LinuxScreenshotCapture::LinuxScreenshotCapture() 
     : initialized_(false), display_server_(DisplayServerType::Unknown) {
@@ -50,9 +59,16 @@ void LinuxScreenshotCapture::Initialize() {
                 break;
                 
             case DisplayServerType::Wayland:
-                wayland_impl_ = std::make_unique<WaylandImplementation>();
-                if (wayland_impl_->Initialize()) {
-                    initialized_ = true;
+                // A compositor without wlr-screencopy (GNOME, KDE) will not gain
+                // it, so once one instance found that out the rest skip the
+                // connection and go straight to XWayland
+                if (!WaylandUnusable().load(std::memory_order_acquire)) {
+                    wayland_impl_ = std::make_unique<WaylandImplementation>();
+                    if (wayland_impl_->Initialize()) {
+                        initialized_ = true;
+                    } else {
+                        WaylandUnusable().store(true, std::memory_order_release);
+                    }
                 }
                 // Try X11 as fallback if Wayland fails
                 if (!initialized_) {
@@ -148,17 +164,61 @@ ScreenshotResult LinuxScreenshotCapture::CaptureDisplay(uint32_t display_index)
     return result;
 }
 
-std::vector<ScreenshotResult> LinuxScreenshotCapture::CaptureAllDisplays() {
+ScreenshotResult LinuxScreenshotCapture::CaptureDisplay(uint32_t display_index, const CaptureRegion& region) {
+    if (region.IsFullFrame()) {
+        return CaptureDisplay(display_index);
+    }
     if (!initialized_) Initialize();
-    
-    std::vector<ScreenshotResult> results;
-    std::vector<DisplayInfo> displays = GetDisplays();
-    
-    for (uint32_t i = 0; i < displays.size(); ++i) {
-        results.push_back(CaptureDisplay(i));
+
+    ScreenshotResult result;
+
+    try {
+        if (display_server_ == DisplayServerType::Wayland && wayland_impl_ && wayland_impl_->IsSupported()) {
+            result = wayland_impl_->CaptureDisplayRegion(display_index, region);
+        } else if (x11_impl_) {
+            // Also covers XWayland when no screencopy is available
+            result = x11_impl_->CaptureDisplayRegion(display_index, region);
+        } else {
+            result.error_message = "No screenshot implementation available";
+        }
+
+    } catch (const std::exception& e) {
+        result.success = false;
+        result.error_message = std::string("Linux screenshot capture failed: ") + e.what();
     }
+
+    return result;
+}
+
+bool LinuxScreenshotCapture::CaptureDisplayInto(uint32_t display_index, uint8_t* buffer,
+                                                size_t capacity, FrameDescriptor& frame) {
+    if (!initialized_) Initialize();
+
+    // X11 converts from its persistent XShm image directly into the buffer
+    if (display_server_ == DisplayServerType::X11 && x11_impl_ &&
+        x11_impl_->CaptureDisplayInto(display_index, buffer, capacity, frame)) {
+        return true;
+    }
+
+    // Wayland converts from the session's front wl_shm / dmabuf buffer
+    if (display_server_ == DisplayServerType::Wayland && wayland_impl_ && wayland_impl_->IsSupported() &&
+        wayland_impl_->CaptureDisplayInto(display_index, buffer, capacity, frame)) {
+        return true;
+    }
+
+    if (frame.required_size > capacity) {
+        return false;
+    }
+
+    frame = FrameDescriptor();
+    return ScreenshotCapture::CaptureDisplayInto(display_index, buffer, capacity, frame);
+}
+
+std::vector<ScreenshotResult> LinuxScreenshotCapture::CaptureAllDisplays() {
+    if (!initialized_) Initialize();
     
-    return results;
+    // Each instance has its own X or Wayland connection
+    return CaptureAllDisplaysConcurrently([] { return std::make_unique<LinuxScreenshotCapture>(); });
 }
 
 bool LinuxScreenshotCapture::IsSupported() {
@@ -184,59 +244,61 @@ std::string LinuxScreenshotCapture::GetImplementationName() {
 namespace Utils {
 
 DisplayServerType DetectDisplayServer() {
-    // Check for Wayland first
-    if (IsWaylandAvailable()) {
-        return DisplayServerType::Wayland;
-    }
-    
-    // Check for X11
-    if (IsX11Available()) {
-        return DisplayServerType::X11;
-    }
-    
-    return DisplayServerType::Unknown;
+    // Asked again by every backend instance, one per display in CaptureAllDisplays
+    static const DisplayServerType detected = [] {
+        // Check for Wayland first
+        if (IsWaylandAvailable()) {
+            return DisplayServerType::Wayland;
+        }
+
+        // Check for X11
+        if (IsX11Available()) {
+            return DisplayServerType::X11;
+        }
+
+        return DisplayServerType::Unknown;
+    }();
+    return detected;
 }
 
 bool IsX11Available() {
-    // Check if DISPLAY environment variable is set
-    const char* display_env = std::getenv("DISPLAY");
-    if (!display_env) {
+    static const bool available = [] {
+        // Check if DISPLAY environment variable is set
+        const char* display_env = std::getenv("DISPLAY");
+        if (!display_env) {
+            return false;
+        }
+
+        // Try to open X11 display
+        Display* display = XOpenDisplay(nullptr);
+        if (display) {
+            XCloseDisplay(display);
+            return true;
+        }
+
         return false;
-    }
-    
-    // Try to open X11 display
-    Display* display = XOpenDisplay(nullptr);
-    if (display) {
-        XCloseDisplay(display);
-        return true;
-    }
-    
-    return false;
+    }();
+    return available;
 }
 
 bool IsWaylandAvailable() {
-    // Check for Wayland environment variables
-    const char* wayland_display = std::getenv("WAYLAND_DISPLAY");
-    const char* xdg_session_type = std::getenv("XDG_SESSION_TYPE");
-    
-    if (wayland_display && std::strlen(wayland_display) > 0) {
-        return true;
-    }
-    
-    if (xdg_session_type && std::strcmp(xdg_session_type, "wayland") == 0) {
-        return true;
-    }
-    
-#ifdef HAVE_WAYLAND
-    // Try to connect to Wayland display
-    struct wl_display* display = wl_display_connect(nullptr);
-    if (display) {
-        wl_display_disconnect(display);
-        return true;
-    }
-#endif
-    
-    return false;
+    static const bool available = [] {
+        // Check for Wayland environment variables
+        const char* wayland_display = std::getenv("WAYLAND_DISPLAY");
+        const char* xdg_session_type = std::getenv("XDG_SESSION_TYPE");
+
+        if (wayland_display && std::strlen(wayland_display) > 0) {
+            return true;
+        }
+
+        if (xdg_session_type && std::strcmp(xdg_session_type, "wayland") == 0) {
+            return true;
+        }
+
+        // Without either variable, fall back to a connection attempt
+        return IsWaylandCompositorRunning();
+    }();
+    return available;
 }
 
 std::string GetDisplayServerName(DisplayServerType type) {
@@ -275,14 +337,19 @@ std::string GetWaylandDisplayName() {
 }
 
 bool IsWaylandCompositorRunning() {
-#ifdef HAVE_WAYLAND
-    struct wl_display* display = wl_display_connect(nullptr);
-    if (display) {
-        wl_display_disconnect(display);
-        return true;
-    }
-#endif
+#if HAVE_WAYLAND
+    static const bool running = [] {
+        struct wl_display* display = wl_display_connect(nullptr);
+        if (display) {
+            wl_display_disconnect(display);
+            return true;
+        }
+        return false;
+    }();
+    return running;
+#else
     return false;
+#endif
 }
 
 // Color format conversion functions
@@ -470,23 +537,6 @@ LinuxDistribution DetectLinuxDistribution() {
     return dist;
 }
 
-// Performance timer implementation
-PerformanceTimer::PerformanceTimer() : start_time_(0) {}
-
-void PerformanceTimer::Start() {
-    auto now = std::chrono::high_resolution_clock::now();
-    start_time_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        now.time_since_epoch()).count();
-}
-
-double PerformanceTimer::ElapsedMilliseconds() const {
-    auto now = std::chrono::high_resolution_clock::now();
-    uint64_t current_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
-        now.time_since_epoch()).count();
-    
-    return static_cast<double>(current_time - start_time_) / 1000000.0;
-}
-
 } // namespace Utils
 
 } // namespace Linux
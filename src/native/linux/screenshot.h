@@ -7,13 +7,13 @@
 #include <memory>
 #include <string>
 #include <cstdint>
+#include <mutex>
 
 // Forward declarations for X11 types
 typedef struct _XDisplay Display;
 typedef unsigned long Window;
 typedef unsigned long Atom;
 typedef struct _XImage XImage;
-typedef struct _XWindowAttributes XWindowAttributes;
 typedef struct _XRRScreenResources XRRScreenResources;
 typedef struct _XRROutputInfo XRROutputInfo;
 typedef struct _XRRCrtcInfo XRRCrtcInfo;
@@ -22,8 +22,11 @@ typedef struct _XRRCrtcInfo XRRCrtcInfo;
 struct wl_display;
 struct wl_registry;
 struct wl_output;
+struct wl_shm;
 struct zwlr_screencopy_manager_v1;
 struct zwlr_screencopy_frame_v1;
+struct zwp_linux_dmabuf_v1;
+struct gbm_device;
 
 namespace WebPScreenshot {
 namespace Linux {
@@ -44,7 +47,10 @@ public:
     // ScreenshotCapture interface
     std::vector<DisplayInfo> GetDisplays() override;
     ScreenshotResult CaptureDisplay(uint32_t display_index) override;
+    ScreenshotResult CaptureDisplay(uint32_t display_index, const CaptureRegion& region) override;
     std::vector<ScreenshotResult> CaptureAllDisplays() override;
+    bool CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                            FrameDescriptor& frame) override;
     bool IsSupported() override;
     std::string GetImplementationName() override;
 
@@ -75,6 +81,9 @@ private:
     std::vector<LinuxDisplayHandle> display_handles_;
 };
 
+// Persistent per-display XShm + XDamage state (x11_capture.cc)
+class X11CaptureSession;
+
 // X11 implementation
 class X11Implementation {
 public:
@@ -88,15 +97,42 @@ public:
     ScreenshotResult CaptureDisplay(uint32_t display_index);
     ScreenshotResult CaptureScreen(int screen_number);
     ScreenshotResult CaptureWindow(Window window);
+
+    // Read back only `region` of a display through a persistent XShm image
+    // of that size. With region.window_id set the rectangle is taken from
+    // the window's own contents (XComposite when available, so covered
+    // parts come out right) instead of the screen.
+    ScreenshotResult CaptureDisplayRegion(uint32_t display_index, const CaptureRegion& region);
+
+    // Capture through the display's persistent session. When XDamage reports
+    // nothing new inside the display, *changed is false and result is left
+    // untouched; otherwise damage (if given) lists the changed regions.
+    bool CaptureDisplayIncremental(uint32_t display_index, ScreenshotResult& result,
+                                   std::vector<DirtyRect>* damage, bool* changed);
+
+    // Convert the session image straight into a caller-owned RGBA buffer
+    bool CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                            FrameDescriptor& frame);
     
 private:
     bool is_supported_;
     Display* display_;
     int screen_count_;
+
+    // XDamage / XFixes support
+    bool has_damage_ = false;
+    int damage_event_base_ = 0;
+    int damage_error_base_ = 0;
+
+    // XComposite 0.2+ (NameWindowPixmap). The last window captured stays
+    // redirected so its pixmap keeps up with the window between captures.
+    bool has_composite_ = false;
+    Window redirected_window_ = 0;
     
     struct X11DisplayInfo {
         int screen_number;
         Window root_window;
+        int x = 0, y = 0;  // Offset of the output within the root window
         int width, height;
         int depth;
         std::string name;
@@ -104,6 +140,9 @@ private:
     };
     
     std::vector<X11DisplayInfo> x11_displays_;
+    std::vector<std::unique_ptr<X11CaptureSession>> sessions_;  // One per display, created lazily
+    std::unique_ptr<X11CaptureSession> region_session_;  // Sized to the last region captured
+    Window region_root_ = 0;
     
     bool OpenDisplay();
     void CloseDisplay();
@@ -111,8 +150,16 @@ private:
     void EnumerateXRandROutputs();
     
     // Screenshot capture methods
-    ScreenshotResult CaptureWithXGetImage(Window window, int width, int height);
+    ScreenshotResult CaptureWithXGetImage(Window window, int x, int y, int width, int height);
     ScreenshotResult CaptureWithXShmGetImage(Window window, int width, int height);
+    ScreenshotResult CaptureWindowRegion(Window window, const CaptureRegion& region);
+    
+    // Session management
+    X11CaptureSession* GetSession(uint32_t display_index);
+    void ResetSessions();
+    void DispatchDamageEvents();
+    bool CheckDamageExtension();
+    bool CheckCompositeExtension();
     
     // Image processing
     ScreenshotResult XImageToScreenshotResult(XImage* ximage);
@@ -129,6 +176,10 @@ private:
     static int X11IOErrorHandler(Display* display);
 };
 
+// Persistent per-output wl_shm / dmabuf buffers and armed screencopy frame
+// (wayland_capture.cc)
+class WaylandCaptureSession;
+
 // Wayland implementation
 class WaylandImplementation {
 public:
@@ -140,47 +191,82 @@ public:
     
     std::vector<DisplayInfo> GetDisplays();
     ScreenshotResult CaptureDisplay(uint32_t display_index);
+
+    // One-off capture_output_region screencopy into a buffer of the region's
+    // size, so only the rectangle is copied out of the compositor
+    ScreenshotResult CaptureDisplayRegion(uint32_t display_index, const CaptureRegion& region);
+
+    // Same contract as X11Implementation::CaptureDisplayIncremental, driven by
+    // zwlr_screencopy_frame_v1.copy_with_damage (protocol version 2+)
+    bool CaptureDisplayIncremental(uint32_t display_index, ScreenshotResult& result,
+                                   std::vector<DirtyRect>* damage, bool* changed);
+
+    // Convert the session's front buffer straight into a caller-owned RGBA buffer
+    bool CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                            FrameDescriptor& frame);
+
+    // GPU-resident frame. fd stays owned by the session and is valid until
+    // the next capture on the same display; dup() it to keep it longer.
+    struct DmabufFrame {
+        int fd = -1;
+        uint32_t drm_format = 0;    // DRM fourcc
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;
+        uint32_t offset = 0;
+        uint64_t modifier = 0;
+        bool y_invert = false;
+    };
+
+    // Capture into a linux-dmabuf buffer without touching the pixels on the
+    // CPU. Fails when the compositor or GBM can't provide one.
+    bool CaptureDisplayDmabuf(uint32_t display_index, DmabufFrame& frame);
+
+    // Route regular captures through dmabuf buffers (read back via GBM)
+    // instead of wl_shm when the compositor offers both
+    void SetPreferDmabuf(bool prefer);
+    bool HasDmabufSupport() const;
     
 private:
+    friend class WaylandCaptureSession;
+
     bool is_supported_;
     struct wl_display* display_;
     struct wl_registry* registry_;
+    struct wl_shm* shm_ = nullptr;
     struct zwlr_screencopy_manager_v1* screencopy_manager_;
+    uint32_t screencopy_version_ = 0;
+    struct zwp_linux_dmabuf_v1* linux_dmabuf_ = nullptr;
+    struct gbm_device* gbm_device_ = nullptr;
+    int drm_fd_ = -1;
+    bool prefer_dmabuf_ = false;
+
+    // All protocol traffic on display_ happens under this lock
+    std::mutex mutex_;
     
     struct WaylandDisplayInfo {
-        struct wl_output* output;
+        struct wl_output* output = nullptr;
+        uint32_t global_name = 0;
         std::string name;
         std::string description;
-        int x, y;
-        int width, height;
-        int scale;
-        bool is_primary;
+        int x = 0, y = 0;
+        int width = 0, height = 0;
+        int scale = 1;
+        bool is_primary = false;
     };
     
     std::vector<WaylandDisplayInfo> wayland_displays_;
+    std::vector<std::unique_ptr<WaylandCaptureSession>> sessions_;  // One per output, created lazily
+    std::unique_ptr<WaylandCaptureSession> region_session_;  // Sized to the last region captured
     
     bool ConnectToDisplay();
     void DisconnectFromDisplay();
-    void EnumerateOutputs();
-    
-    // Screenshot capture
-    ScreenshotResult CaptureWithScreencopy(struct wl_output* output);
-    
-    // Helper methods
-    int CreateSharedMemoryFile(size_t size);
-    
-    // Screencopy context for managing capture state
-    struct ScreencopyContext {
-        ScreenshotResult* result;
-        uint32_t width;
-        uint32_t height;
-        uint32_t format;
-        uint32_t stride;
-        bool finished;
-        bool failed;
-        void* shm_data;
-        size_t shm_size;
-    };
+    bool OpenRenderNode();
+    
+    // Session management
+    WaylandCaptureSession* GetSession(uint32_t display_index);
+    void PruneRemovedOutputs();
+    bool DispatchEvents(int timeout_ms);
     
     // Wayland protocol handlers
     static void RegistryGlobalHandler(void* data, struct wl_registry* registry,
@@ -199,23 +285,12 @@ private:
     static void OutputDoneHandler(void* data, struct wl_output* output);
     static void OutputScaleHandler(void* data, struct wl_output* output,
                                  int32_t factor);
-    
-    // Screencopy handlers
-    static void ScreencopyFrameHandler(void* data, 
-                                     struct zwlr_screencopy_frame_v1* frame,
-                                     uint32_t format, uint32_t width, uint32_t height,
-                                     uint32_t stride);
-    static void ScreencopyReadyHandler(void* data,
-                                     struct zwlr_screencopy_frame_v1* frame,
-                                     uint32_t tv_sec_hi, uint32_t tv_sec_lo,
-                                     uint32_t tv_nsec);
-    static void ScreencopyFailedHandler(void* data,
-                                      struct zwlr_screencopy_frame_v1* frame);
 };
 
 // Utility functions
 namespace Utils {
-    // Display server detection
+    // Display server detection. The probes open a connection, so each answer
+    // is worked out once and kept for the life of the process.
     DisplayServerType DetectDisplayServer();
     bool IsX11Available();
     bool IsWaylandAvailable();
@@ -280,17 +355,6 @@ namespace Utils {
     LinuxDistribution DetectLinuxDistribution();
     std::vector<std::string> GetInstalledPackages();
     bool IsPackageInstalled(const std::string& package_name);
-    
-    // Performance utilities
-    class PerformanceTimer {
-    public:
-        PerformanceTimer();
-        void Start();
-        double ElapsedMilliseconds() const;
-        
-    private:
-        uint64_t start_time_;
-    };
 }
 
 } // namespace Linux
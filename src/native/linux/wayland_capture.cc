@@ -1,25 +1,659 @@
 #ifdef __linux__
-#ifdef HAVE_WAYLAND
+#if HAVE_WAYLAND
 
 #include "screenshot.h"
 #include <wayland-client.h>
 #include <wayland-client-protocol.h>
+#include "wlr-screencopy-unstable-v1-client-protocol.h"
+#if HAVE_GBM
+#include "linux-dmabuf-unstable-v1-client-protocol.h"
+#include <gbm.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
 
-// Note: In a real implementation, these would be generated from the 
-// wlr-screencopy-unstable-v1.xml protocol file
-// For now, we'll provide stub implementations
-
 namespace WebPScreenshot {
 namespace Linux {
 
+namespace {
+
+// How long a blocking capture waits for the compositor
+constexpr int kCaptureTimeoutMs = 2000;
+
+// wl_shm uses its own codes for the two mandatory formats and DRM fourcc
+// codes for everything else; dmabuf offers are always DRM fourcc
+constexpr uint32_t kFourccARGB8888 = 0x34325241;  // 'AR24'
+constexpr uint32_t kFourccXRGB8888 = 0x34325258;  // 'XR24'
+constexpr uint32_t kFourccABGR8888 = 0x34324241;  // 'AB24'
+constexpr uint32_t kFourccXBGR8888 = 0x34324258;  // 'XB24'
+
+// In-memory byte order of the 32-bit formats we can convert. Wayland formats
+// are defined little-endian, so this does not depend on the host.
+enum class PixelOrder { Unsupported, BGRA, BGRX, RGBA, RGBX };
+
+PixelOrder FourccPixelOrder(uint32_t fourcc) {
+    switch (fourcc) {
+        case kFourccARGB8888: return PixelOrder::BGRA;
+        case kFourccXRGB8888: return PixelOrder::BGRX;
+        case kFourccABGR8888: return PixelOrder::RGBA;
+        case kFourccXBGR8888: return PixelOrder::RGBX;
+        default: return PixelOrder::Unsupported;
+    }
+}
+
+PixelOrder ShmPixelOrder(uint32_t format) {
+    switch (format) {
+        case WL_SHM_FORMAT_ARGB8888: return PixelOrder::BGRA;
+        case WL_SHM_FORMAT_XRGB8888: return PixelOrder::BGRX;
+        default: return FourccPixelOrder(format);
+    }
+}
+
+void ConvertRowToRGBA(const uint8_t* src, uint8_t* dst, uint32_t width, PixelOrder order) {
+    switch (order) {
+        case PixelOrder::BGRA:
+        case PixelOrder::BGRX:
+            SIMD::ConvertBGRAToRGBA(src, dst, width);
+            break;
+        case PixelOrder::RGBA:
+        case PixelOrder::RGBX:
+            std::memcpy(dst, src, static_cast<size_t>(width) * 4);
+            break;
+        default:
+            return;
+    }
+
+    // The padding byte of X formats is undefined
+    if (order == PixelOrder::BGRX || order == PixelOrder::RGBX) {
+        for (uint32_t x = 0; x < width; ++x) {
+            dst[x * 4 + 3] = 0xFF;
+        }
+    }
+}
+
+void ConvertToRGBA(const uint8_t* src, uint32_t src_stride, PixelOrder order,
+                   uint32_t width, uint32_t height, bool y_invert,
+                   uint8_t* dst, uint32_t dst_stride) {
+    Stats::ScopedStageTimer convert_timer(Stats::Stage::Convert);
+    Stats::AddBytesCopied(static_cast<uint64_t>(width) * height * 4);
+    for (uint32_t row = 0; row < height; ++row) {
+        const uint32_t src_row = y_invert ? height - 1 - row : row;
+        ConvertRowToRGBA(src + static_cast<size_t>(src_row) * src_stride,
+                         dst + static_cast<size_t>(row) * dst_stride, width, order);
+    }
+}
+
+// Anonymous shared memory for the wl_shm pool; created once per session
+int CreateSharedMemoryFile(size_t size) {
+    int fd = -1;
+
+#ifdef MFD_CLOEXEC
+    fd = memfd_create("webp-screenshot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#endif
+
+    if (fd < 0) {
+        // Kernels without memfd: an unlinked file on the runtime tmpfs
+        const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+        std::string path = std::string(runtime_dir ? runtime_dir : "/tmp") + "/webp-screenshot-XXXXXX";
+        fd = mkostemp(&path[0], O_CLOEXEC);
+        if (fd < 0) {
+            return -1;
+        }
+        unlink(path.c_str());
+    }
+
+    if (ftruncate(fd, static_cast<off_t>(size)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+#ifdef F_ADD_SEALS
+    // The compositor maps this too; make sure nobody can shrink it under us
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL);
+#endif
+
+    return fd;
+}
+
+} // anonymous namespace
+
+// Long-lived capture state for one output. Two wl_buffers (wl_shm from one
+// memfd-backed pool, or dmabufs from GBM) stay alive across frames: the front
+// buffer holds the last completed frame and the compositor copies into the
+// other one. Between captures a copy_with_damage request stays armed on the
+// back buffer, so an unchanged output costs one non-blocking poll per frame.
+class WaylandCaptureSession {
+public:
+    WaylandCaptureSession(WaylandImplementation* owner, wl_output* output)
+        : owner_(owner), output_(output) {}
+
+    // Capture only `region` of the output, in the compositor's logical
+    // coordinates; the buffers are sized to the region
+    WaylandCaptureSession(WaylandImplementation* owner, wl_output* output, const DirtyRect& region)
+        : owner_(owner), output_(output), region_(region), has_region_(true) {}
+
+    ~WaylandCaptureSession() {
+        DestroyFrame();
+        ReleaseBuffers();
+    }
+
+    WaylandCaptureSession(const WaylandCaptureSession&) = delete;
+    WaylandCaptureSession& operator=(const WaylandCaptureSession&) = delete;
+
+    // Bring the front buffer up to date. Sets *changed to false, without any
+    // pixel transfer, while the armed frame is still waiting for damage.
+    // Damage is tracked per wl_buffer by the compositor, so with two buffers
+    // the reported rects can be a superset of what changed since the last call.
+    bool Update(bool prefer_dmabuf, std::vector<DirtyRect>* damage, bool* changed,
+                std::string& error) {
+        *changed = false;
+        if (damage) damage->clear();
+
+        // Switching buffer kinds restarts from a blocking copy
+        if (frame_ && frame_prefers_dmabuf_ != prefer_dmabuf) {
+            DestroyFrame();
+        }
+
+        if (front_ >= 0 && frame_) {
+            if (!owner_->DispatchEvents(0)) {
+                error = "Wayland connection lost";
+                return false;
+            }
+            if (state_ == FrameState::Negotiating || state_ == FrameState::Copying) {
+                return true;
+            }
+            if (state_ == FrameState::Ready) {
+                CompleteFrame(damage);
+                *changed = true;
+                Arm(prefer_dmabuf);
+                return true;
+            }
+            // Failed: fall through to a blocking copy
+        }
+
+        DestroyFrame();
+        Stats::ScopedStageTimer capture_timer(Stats::Stage::Capture);
+        if (!BeginFrame(false, prefer_dmabuf)) {
+            capture_timer.Cancel();
+            error = "Failed to create screencopy frame";
+            return false;
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() +
+                              std::chrono::milliseconds(kCaptureTimeoutMs);
+        while (state_ == FrameState::Negotiating || state_ == FrameState::Copying) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - std::chrono::steady_clock::now()).count();
+            if (remaining <= 0) {
+                capture_timer.Cancel();
+                error = "Timed out waiting for screencopy frame";
+                DestroyFrame();
+                return false;
+            }
+            if (!owner_->DispatchEvents(static_cast<int>(remaining))) {
+                capture_timer.Cancel();
+                error = "Wayland connection lost";
+                DestroyFrame();
+                return false;
+            }
+        }
+
+        if (state_ != FrameState::Ready) {
+            capture_timer.Cancel();
+            error = error_.empty() ? "Screencopy frame failed" : error_;
+            DestroyFrame();
+            return false;
+        }
+        capture_timer.Stop();
+
+        CompleteFrame(nullptr);
+        if (damage) {
+            damage->push_back({0, 0, width_, height_});
+        }
+        *changed = true;
+        Arm(prefer_dmabuf);
+        return true;
+    }
+
+    uint32_t Width() const { return width_; }
+    uint32_t Height() const { return height_; }
+    bool HasFrame() const { return front_ >= 0; }
+    bool Matches(wl_output* output, const DirtyRect& region) const {
+        return has_region_ && output == output_ && region.x == region_.x && region.y == region_.y &&
+               region.width == region_.width && region.height == region_.height;
+    }
+
+    // Convert the front buffer into a caller-owned RGBA buffer
+    bool ReadFront(uint8_t* dst, uint32_t dst_stride, std::string& error) {
+        if (front_ < 0) {
+            error = "No frame captured";
+            return false;
+        }
+
+        const Buffer& buffer = buffers_[front_];
+        if (kind_ == BufferKind::Shm) {
+            ConvertToRGBA(buffer.pixels, buffer.stride, ShmPixelOrder(format_),
+                          width_, height_, buffer.y_invert, dst, dst_stride);
+            return true;
+        }
+
+#if HAVE_GBM
+        uint32_t map_stride = 0;
+        void* map_data = nullptr;
+        Stats::ScopedStageTimer readback_timer(Stats::Stage::Readback);
+        void* addr = gbm_bo_map(buffer.bo, 0, 0, width_, height_, GBM_BO_TRANSFER_READ,
+                                &map_stride, &map_data);
+        if (!addr) {
+            readback_timer.Cancel();
+            error = "Failed to map dmabuf for readback";
+            return false;
+        }
+        readback_timer.Stop();
+        ConvertToRGBA(static_cast<const uint8_t*>(addr), map_stride, FourccPixelOrder(format_),
+                      width_, height_, buffer.y_invert, dst, dst_stride);
+        gbm_bo_unmap(buffer.bo, map_data);
+        return true;
+#else
+        error = "dmabuf support not compiled in";
+        return false;
+#endif
+    }
+
+    bool ExportFront(WaylandImplementation::DmabufFrame& frame) const {
+#if HAVE_GBM
+        if (front_ < 0 || kind_ != BufferKind::Dmabuf) {
+            return false;
+        }
+        const Buffer& buffer = buffers_[front_];
+        frame.fd = buffer.fd;
+        frame.drm_format = format_;
+        frame.width = width_;
+        frame.height = height_;
+        frame.stride = buffer.stride;
+        frame.offset = buffer.offset;
+        frame.modifier = buffer.modifier;
+        frame.y_invert = buffer.y_invert;
+        return true;
+#else
+        (void)frame;
+        return false;
+#endif
+    }
+
+private:
+    enum class FrameState { Idle, Negotiating, Copying, Ready, Failed };
+    enum class BufferKind { None, Shm, Dmabuf };
+
+    struct BufferOffer {
+        bool present = false;
+        uint32_t format = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;  // wl_shm only
+    };
+
+    struct Buffer {
+        wl_buffer* buffer = nullptr;
+        uint8_t* pixels = nullptr;  // Inside the shm mapping
+        uint32_t stride = 0;
+        bool y_invert = false;
+#if HAVE_GBM
+        gbm_bo* bo = nullptr;
+        int fd = -1;
+        uint32_t offset = 0;
+        uint64_t modifier = 0;
+#endif
+    };
+
+    WaylandImplementation* owner_;
+    wl_output* output_;
+    DirtyRect region_ = {};
+    bool has_region_ = false;
+
+    // Buffers, reallocated only when the compositor asks for a new size or format
+    Buffer buffers_[2];
+    BufferKind kind_ = BufferKind::None;
+    uint32_t format_ = 0;
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    int front_ = -1;
+
+    int shm_fd_ = -1;
+    uint8_t* shm_map_ = nullptr;
+    size_t shm_size_ = 0;
+    wl_shm_pool* pool_ = nullptr;
+
+    // The in-flight frame, if any
+    zwlr_screencopy_frame_v1* frame_ = nullptr;
+    FrameState state_ = FrameState::Idle;
+    bool frame_with_damage_ = false;
+    bool frame_prefers_dmabuf_ = false;
+    BufferOffer shm_offer_;
+    BufferOffer dmabuf_offer_;
+    uint32_t frame_flags_ = 0;
+    int target_ = -1;
+    std::vector<DirtyRect> frame_damage_;
+    std::string error_;
+
+    static const zwlr_screencopy_frame_v1_listener kFrameListener;
+
+    bool BeginFrame(bool with_damage, bool prefer_dmabuf) {
+        frame_ = has_region_
+            ? zwlr_screencopy_manager_v1_capture_output_region(
+                  owner_->screencopy_manager_, 0, output_, static_cast<int32_t>(region_.x),
+                  static_cast<int32_t>(region_.y), static_cast<int32_t>(region_.width),
+                  static_cast<int32_t>(region_.height))
+            : zwlr_screencopy_manager_v1_capture_output(owner_->screencopy_manager_, 0, output_);
+        if (!frame_) {
+            return false;
+        }
+        zwlr_screencopy_frame_v1_add_listener(frame_, &kFrameListener, this);
+
+        state_ = FrameState::Negotiating;
+        frame_with_damage_ = with_damage;
+        frame_prefers_dmabuf_ = prefer_dmabuf;
+        shm_offer_ = BufferOffer();
+        dmabuf_offer_ = BufferOffer();
+        frame_flags_ = 0;
+        target_ = -1;
+        frame_damage_.clear();
+        error_.clear();
+
+        wl_display_flush(owner_->display_);
+        return true;
+    }
+
+    // Keep a copy_with_damage armed on the back buffer until the next Update
+    void Arm(bool prefer_dmabuf) {
+        if (owner_->screencopy_version_ >= 2) {
+            BeginFrame(true, prefer_dmabuf);
+        }
+    }
+
+    void DestroyFrame() {
+        if (frame_) {
+            zwlr_screencopy_frame_v1_destroy(frame_);
+            frame_ = nullptr;
+        }
+        state_ = FrameState::Idle;
+    }
+
+    void CompleteFrame(std::vector<DirtyRect>* damage) {
+        const bool y_invert = (frame_flags_ & ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT) != 0;
+        buffers_[target_].y_invert = y_invert;
+        front_ = target_;
+
+        if (damage) {
+            if (frame_damage_.empty()) {
+                damage->push_back({0, 0, width_, height_});
+            }
+            for (DirtyRect rect : frame_damage_) {
+                if (rect.x >= width_ || rect.y >= height_) continue;
+                rect.width = std::min(rect.width, width_ - rect.x);
+                rect.height = std::min(rect.height, height_ - rect.y);
+                if (y_invert) {
+                    rect.y = height_ - rect.y - rect.height;
+                }
+                damage->push_back(rect);
+            }
+        }
+
+        DestroyFrame();
+    }
+
+    // All buffer types have been offered; pick one and request the copy
+    void StartCopy() {
+        if (state_ != FrameState::Negotiating) {
+            return;
+        }
+
+        bool use_dmabuf = false;
+#if HAVE_GBM
+        use_dmabuf = frame_prefers_dmabuf_ && dmabuf_offer_.present &&
+                     owner_->gbm_device_ && owner_->linux_dmabuf_ &&
+                     FourccPixelOrder(dmabuf_offer_.format) != PixelOrder::Unsupported;
+#endif
+        const BufferKind kind = use_dmabuf ? BufferKind::Dmabuf : BufferKind::Shm;
+        const BufferOffer& offer = use_dmabuf ? dmabuf_offer_ : shm_offer_;
+
+        if (!use_dmabuf && (!offer.present || ShmPixelOrder(offer.format) == PixelOrder::Unsupported)) {
+            error_ = "Compositor offered no supported screencopy buffer format";
+            state_ = FrameState::Failed;
+            return;
+        }
+
+        if (!EnsureBuffers(kind, offer)) {
+            state_ = FrameState::Failed;
+            return;
+        }
+
+        target_ = front_ == 0 ? 1 : 0;
+        if (frame_with_damage_) {
+            zwlr_screencopy_frame_v1_copy_with_damage(frame_, buffers_[target_].buffer);
+        } else {
+            zwlr_screencopy_frame_v1_copy(frame_, buffers_[target_].buffer);
+        }
+        state_ = FrameState::Copying;
+        wl_display_flush(owner_->display_);
+    }
+
+    bool EnsureBuffers(BufferKind kind, const BufferOffer& offer) {
+        if (kind_ == kind && format_ == offer.format && width_ == offer.width &&
+            height_ == offer.height && (kind == BufferKind::Dmabuf || buffers_[0].stride == offer.stride)) {
+            return true;
+        }
+
+        ReleaseBuffers();
+        const bool created = kind == BufferKind::Shm ? CreateShmBuffers(offer) : CreateDmabufBuffers(offer);
+        if (!created) {
+            ReleaseBuffers();
+            return false;
+        }
+
+        kind_ = kind;
+        format_ = offer.format;
+        width_ = offer.width;
+        height_ = offer.height;
+        return true;
+    }
+
+    bool CreateShmBuffers(const BufferOffer& offer) {
+        const size_t buffer_size = static_cast<size_t>(offer.stride) * offer.height;
+        shm_size_ = buffer_size * 2;
+
+        shm_fd_ = CreateSharedMemoryFile(shm_size_);
+        if (shm_fd_ < 0) {
+            error_ = "Failed to create shared memory file";
+            return false;
+        }
+
+        void* map = mmap(nullptr, shm_size_, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_, 0);
+        if (map == MAP_FAILED) {
+            error_ = "Failed to map shared memory";
+            return false;
+        }
+        shm_map_ = static_cast<uint8_t*>(map);
+
+        pool_ = wl_shm_create_pool(owner_->shm_, shm_fd_, static_cast<int32_t>(shm_size_));
+        for (int i = 0; i < 2; ++i) {
+            buffers_[i].buffer = wl_shm_pool_create_buffer(
+                pool_, static_cast<int32_t>(i * buffer_size),
+                static_cast<int32_t>(offer.width), static_cast<int32_t>(offer.height),
+                static_cast<int32_t>(offer.stride), offer.format);
+            buffers_[i].pixels = shm_map_ + i * buffer_size;
+            buffers_[i].stride = offer.stride;
+            if (!buffers_[i].buffer) {
+                error_ = "Failed to create wl_shm buffer";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool CreateDmabufBuffers(const BufferOffer& offer) {
+#if HAVE_GBM
+        for (Buffer& buffer : buffers_) {
+            buffer.bo = gbm_bo_create(owner_->gbm_device_, offer.width, offer.height,
+                                      offer.format, GBM_BO_USE_RENDERING);
+            if (!buffer.bo) {
+                error_ = "Failed to allocate GBM buffer";
+                return false;
+            }
+
+            buffer.fd = gbm_bo_get_fd(buffer.bo);
+            buffer.stride = gbm_bo_get_stride(buffer.bo);
+            buffer.offset = gbm_bo_get_offset(buffer.bo, 0);
+            buffer.modifier = gbm_bo_get_modifier(buffer.bo);
+            if (buffer.fd < 0) {
+                error_ = "Failed to export GBM buffer";
+                return false;
+            }
+
+            zwp_linux_buffer_params_v1* params = zwp_linux_dmabuf_v1_create_params(owner_->linux_dmabuf_);
+            zwp_linux_buffer_params_v1_add(params, buffer.fd, 0, buffer.offset, buffer.stride,
+                                           static_cast<uint32_t>(buffer.modifier >> 32),
+                                           static_cast<uint32_t>(buffer.modifier & 0xFFFFFFFF));
+            buffer.buffer = zwp_linux_buffer_params_v1_create_immed(
+                params, static_cast<int32_t>(offer.width), static_cast<int32_t>(offer.height),
+                offer.format, 0);
+            zwp_linux_buffer_params_v1_destroy(params);
+            if (!buffer.buffer) {
+                error_ = "Failed to import dmabuf";
+                return false;
+            }
+        }
+        return true;
+#else
+        (void)offer;
+        error_ = "dmabuf support not compiled in";
+        return false;
+#endif
+    }
+
+    void ReleaseBuffers() {
+        for (Buffer& buffer : buffers_) {
+            if (buffer.buffer) {
+                wl_buffer_destroy(buffer.buffer);
+            }
+#if HAVE_GBM
+            if (buffer.fd >= 0) {
+                close(buffer.fd);
+            }
+            if (buffer.bo) {
+                gbm_bo_destroy(buffer.bo);
+            }
+#endif
+            buffer = Buffer();
+        }
+
+        if (pool_) {
+            wl_shm_pool_destroy(pool_);
+            pool_ = nullptr;
+        }
+        if (shm_map_) {
+            munmap(shm_map_, shm_size_);
+            shm_map_ = nullptr;
+        }
+        if (shm_fd_ >= 0) {
+            close(shm_fd_);
+            shm_fd_ = -1;
+        }
+
+        shm_size_ = 0;
+        kind_ = BufferKind::None;
+        format_ = width_ = height_ = 0;
+        front_ = -1;
+    }
+
+    // zwlr_screencopy_frame_v1 events
+    static void OnBuffer(void* data, zwlr_screencopy_frame_v1*, uint32_t format,
+                         uint32_t width, uint32_t height, uint32_t stride) {
+        auto* session = static_cast<WaylandCaptureSession*>(data);
+        session->shm_offer_ = {true, format, width, height, stride};
+
+        // Before version 3 there is no buffer_done and wl_shm is the only option
+        if (session->owner_->screencopy_version_ < 3) {
+            session->StartCopy();
+        }
+    }
+
+    static void OnFlags(void* data, zwlr_screencopy_frame_v1*, uint32_t flags) {
+        static_cast<WaylandCaptureSession*>(data)->frame_flags_ = flags;
+    }
+
+    static void OnReady(void* data, zwlr_screencopy_frame_v1*, uint32_t, uint32_t, uint32_t) {
+        static_cast<WaylandCaptureSession*>(data)->state_ = FrameState::Ready;
+    }
+
+    static void OnFailed(void* data, zwlr_screencopy_frame_v1*) {
+        auto* session = static_cast<WaylandCaptureSession*>(data);
+        session->state_ = FrameState::Failed;
+        if (session->error_.empty()) {
+            session->error_ = "Compositor failed the screencopy frame";
+        }
+    }
+
+    static void OnDamage(void* data, zwlr_screencopy_frame_v1*, uint32_t x, uint32_t y,
+                         uint32_t width, uint32_t height) {
+        static_cast<WaylandCaptureSession*>(data)->frame_damage_.push_back({x, y, width, height});
+    }
+
+    static void OnLinuxDmabuf(void* data, zwlr_screencopy_frame_v1*, uint32_t format,
+                              uint32_t width, uint32_t height) {
+        static_cast<WaylandCaptureSession*>(data)->dmabuf_offer_ = {true, format, width, height, 0};
+    }
+
+    static void OnBufferDone(void* data, zwlr_screencopy_frame_v1*) {
+        static_cast<WaylandCaptureSession*>(data)->StartCopy();
+    }
+};
+
+const zwlr_screencopy_frame_v1_listener WaylandCaptureSession::kFrameListener = {
+    OnBuffer,
+    OnFlags,
+    OnReady,
+    OnFailed,
+    OnDamage,
+    OnLinuxDmabuf,
+    OnBufferDone
+};
+
+namespace {
+
+ScreenshotResult SessionToScreenshotResult(WaylandCaptureSession* session) {
+    ScreenshotResult result;
+
+    const uint32_t stride = session->Width() * 4;
+    const size_t output_size = static_cast<size_t>(stride) * session->Height();
+    result.data = WebPScreenshot::Utils::AllocateScreenshotBuffer(output_size);
+
+    if (!session->ReadFront(result.data.get(), stride, result.error_message)) {
+        result.data.reset();
+        return result;
+    }
+
+    result.width = session->Width();
+    result.height = session->Height();
+    result.stride = stride;
+    result.bytes_per_pixel = 4;
+    result.data_size = static_cast<uint32_t>(output_size);
+    result.format = "RGBA";
+    result.success = true;
+    return result;
+}
+
+} // anonymous namespace
+
 // WaylandImplementation class implementation
-WaylandImplementation::WaylandImplementation() 
-    : is_supported_(false), display_(nullptr), registry_(nullptr), 
+WaylandImplementation::WaylandImplementation()
+    : is_supported_(false), display_(nullptr), registry_(nullptr),
       screencopy_manager_(nullptr) {
 }
 
@@ -28,18 +662,20 @@ WaylandImplementation::~WaylandImplementation() {
 }
 
 bool WaylandImplementation::Initialize() {
+    std::lock_guard<std::mutex> lock(mutex_);
     if (is_supported_) return true;
-    
+
     try {
         if (!ConnectToDisplay()) {
             return false;
         }
-        
-        EnumerateOutputs();
-        
-        is_supported_ = screencopy_manager_ != nullptr && !wayland_displays_.empty();
+
+        is_supported_ = screencopy_manager_ != nullptr && shm_ != nullptr && !wayland_displays_.empty();
+        if (!is_supported_) {
+            DisconnectFromDisplay();
+        }
         return is_supported_;
-        
+
     } catch (const std::exception& e) {
         DisconnectFromDisplay();
         return false;
@@ -51,70 +687,194 @@ bool WaylandImplementation::ConnectToDisplay() {
     if (!display_) {
         return false;
     }
-    
+
     registry_ = wl_display_get_registry(display_);
     if (!registry_) {
         wl_display_disconnect(display_);
         display_ = nullptr;
         return false;
     }
-    
+
     // Set up registry listeners
     static const struct wl_registry_listener registry_listener = {
         RegistryGlobalHandler,
         RegistryGlobalRemoveHandler
     };
-    
+
     wl_registry_add_listener(registry_, &registry_listener, this);
-    
-    // Roundtrip to get all globals
-    wl_display_roundtrip(display_);
-    
+
+    // First roundtrip binds the globals, second delivers output geometry and modes
+    if (wl_display_roundtrip(display_) < 0 || wl_display_roundtrip(display_) < 0) {
+        DisconnectFromDisplay();
+        return false;
+    }
+
     return true;
 }
 
 void WaylandImplementation::DisconnectFromDisplay() {
+    // Sessions own protocol objects and must go before the connection
+    sessions_.clear();
+    region_session_.reset();
+
+    for (auto& display : wayland_displays_) {
+        if (display.output) {
+            wl_output_destroy(display.output);
+        }
+    }
     wayland_displays_.clear();
-    
+
     if (screencopy_manager_) {
-        // zwlr_screencopy_manager_v1_destroy(screencopy_manager_);
+        zwlr_screencopy_manager_v1_destroy(screencopy_manager_);
         screencopy_manager_ = nullptr;
     }
-    
+
+#if HAVE_GBM
+    if (linux_dmabuf_) {
+        zwp_linux_dmabuf_v1_destroy(linux_dmabuf_);
+        linux_dmabuf_ = nullptr;
+    }
+    if (gbm_device_) {
+        gbm_device_destroy(gbm_device_);
+        gbm_device_ = nullptr;
+    }
+#endif
+    if (drm_fd_ >= 0) {
+        close(drm_fd_);
+        drm_fd_ = -1;
+    }
+
+    if (shm_) {
+        wl_shm_destroy(shm_);
+        shm_ = nullptr;
+    }
+
     if (registry_) {
         wl_registry_destroy(registry_);
         registry_ = nullptr;
     }
-    
+
     if (display_) {
         wl_display_disconnect(display_);
         display_ = nullptr;
     }
+
+    is_supported_ = false;
 }
 
-void WaylandImplementation::EnumerateOutputs() {
-    // This would normally be handled through the registry global handler
-    // For now, we'll create a default display entry
-    WaylandDisplayInfo default_display;
-    default_display.output = nullptr;
-    default_display.name = "Wayland Display";
-    default_display.description = "Default Wayland Output";
-    default_display.x = 0;
-    default_display.y = 0;
-    default_display.width = 1920; // Default resolution
-    default_display.height = 1080;
-    default_display.scale = 1;
-    default_display.is_primary = true;
-    
-    wayland_displays_.push_back(default_display);
+bool WaylandImplementation::OpenRenderNode() {
+#if HAVE_GBM
+    if (gbm_device_) {
+        return true;
+    }
+
+    for (int minor = 128; minor < 136; ++minor) {
+        const std::string path = "/dev/dri/renderD" + std::to_string(minor);
+        int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        gbm_device* device = gbm_create_device(fd);
+        if (!device) {
+            close(fd);
+            continue;
+        }
+
+        drm_fd_ = fd;
+        gbm_device_ = device;
+        return true;
+    }
+#endif
+    return false;
+}
+
+bool WaylandImplementation::HasDmabufSupport() const {
+#if HAVE_GBM
+    return linux_dmabuf_ != nullptr && screencopy_version_ >= 3;
+#else
+    return false;
+#endif
+}
+
+void WaylandImplementation::SetPreferDmabuf(bool prefer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    prefer_dmabuf_ = prefer && HasDmabufSupport() && OpenRenderNode();
+}
+
+// Read and dispatch whatever the compositor has sent, waiting at most
+// timeout_ms for it. Returns false only when the connection is broken.
+bool WaylandImplementation::DispatchEvents(int timeout_ms) {
+    if (wl_display_prepare_read(display_) != 0) {
+        // Events already queued; the caller re-checks its state and calls again
+        return wl_display_dispatch_pending(display_) >= 0;
+    }
+
+    if (wl_display_flush(display_) < 0 && errno != EAGAIN) {
+        wl_display_cancel_read(display_);
+        return false;
+    }
+
+    struct pollfd pfd = {wl_display_get_fd(display_), POLLIN, 0};
+    const int ready = poll(&pfd, 1, timeout_ms);
+    if (ready <= 0) {
+        wl_display_cancel_read(display_);
+        return ready == 0 || errno == EINTR;
+    }
+
+    if (wl_display_read_events(display_) < 0) {
+        return false;
+    }
+    return wl_display_dispatch_pending(display_) >= 0;
+}
+
+// Drop outputs the compositor removed. Done here rather than in the registry
+// handler, which can run while the output's session is inside Update.
+void WaylandImplementation::PruneRemovedOutputs() {
+    for (size_t i = wayland_displays_.size(); i-- > 0;) {
+        if (wayland_displays_[i].output) continue;
+        wayland_displays_.erase(wayland_displays_.begin() + i);
+        region_session_.reset();
+        if (i < sessions_.size()) {
+            sessions_.erase(sessions_.begin() + i);
+        }
+    }
+}
+
+WaylandCaptureSession* WaylandImplementation::GetSession(uint32_t display_index) {
+    if (!display_ || !screencopy_manager_ || !shm_) {
+        return nullptr;
+    }
+
+    PruneRemovedOutputs();
+    if (display_index >= wayland_displays_.size()) {
+        return nullptr;
+    }
+
+    if (sessions_.size() < wayland_displays_.size()) {
+        sessions_.resize(wayland_displays_.size());
+    }
+
+    auto& session = sessions_[display_index];
+    if (!session) {
+        session = std::make_unique<WaylandCaptureSession>(this, wayland_displays_[display_index].output);
+    }
+    return session.get();
 }
 
 std::vector<DisplayInfo> WaylandImplementation::GetDisplays() {
+    std::lock_guard<std::mutex> lock(mutex_);
     std::vector<DisplayInfo> displays;
-    
+
+    // Pick up hotplugged or removed outputs
+    if (display_) {
+        DispatchEvents(0);
+    }
+    PruneRemovedOutputs();
+
     for (size_t i = 0; i < wayland_displays_.size(); ++i) {
         const auto& wayland_display = wayland_displays_[i];
-        
+
         DisplayInfo info;
         info.index = static_cast<uint32_t>(i);
         info.width = static_cast<uint32_t>(wayland_display.width);
@@ -124,157 +884,227 @@ std::vector<DisplayInfo> WaylandImplementation::GetDisplays() {
         info.scale_factor = static_cast<float>(wayland_display.scale);
         info.is_primary = wayland_display.is_primary;
         info.name = wayland_display.name;
-        
+
         displays.push_back(info);
     }
-    
+
     return displays;
 }
 
 ScreenshotResult WaylandImplementation::CaptureDisplay(uint32_t display_index) {
+    std::lock_guard<std::mutex> lock(mutex_);
     ScreenshotResult result;
-    
-    if (display_index >= wayland_displays_.size()) {
-        result.error_message = "Display index out of range";
+
+    WaylandCaptureSession* session = GetSession(display_index);
+    if (!session) {
+        result.error_message = screencopy_manager_ ? "Display index out of range"
+                                                   : "wlr-screencopy protocol not available";
         return result;
     }
-    
-    if (!screencopy_manager_) {
-        result.error_message = "wlr-screencopy protocol not available";
+
+    bool changed = false;
+    if (!session->Update(prefer_dmabuf_, nullptr, &changed, result.error_message)) {
         return result;
     }
-    
-    const auto& display_info = wayland_displays_[display_index];
-    return CaptureWithScreencopy(display_info.output);
+
+    return SessionToScreenshotResult(session);
 }
 
-ScreenshotResult WaylandImplementation::CaptureWithScreencopy(struct wl_output* output) {
+ScreenshotResult WaylandImplementation::CaptureDisplayRegion(uint32_t display_index, const CaptureRegion& region) {
+    std::lock_guard<std::mutex> lock(mutex_);
     ScreenshotResult result;
-    
-    if (!screencopy_manager_) {
-        result.error_message = "wlr-screencopy manager not available";
+
+    // wlr-screencopy only knows outputs; toplevel capture needs another protocol
+    if (region.window_id != 0) {
+        result.error_message = "Window capture not supported on Wayland";
         return result;
     }
-    
-    // Find display info for this output
-    const WaylandDisplayInfo* display_info = nullptr;
-    for (const auto& display : wayland_displays_) {
-        if (display.output == output) {
-            display_info = &display;
-            break;
-        }
+
+    if (!display_ || !screencopy_manager_ || !shm_) {
+        result.error_message = "wlr-screencopy protocol not available";
+        return result;
+    }
+
+    PruneRemovedOutputs();
+    if (display_index >= wayland_displays_.size()) {
+        result.error_message = "Display index out of range";
+        return result;
     }
-    
-    if (!display_info) {
-        result.error_message = "Output not found in display list";
+
+    const auto& info = wayland_displays_[display_index];
+    DirtyRect rect;
+    if (!WebPScreenshot::Utils::ClipCaptureRegion(region, static_cast<uint32_t>(info.width),
+                                                  static_cast<uint32_t>(info.height), rect,
+                                                  result.error_message)) {
         return result;
     }
-    
-    // Create screenshot frame context
-    ScreencopyContext context;
-    context.result = &result;
-    context.width = display_info->width;
-    context.height = display_info->height;
-    context.format = 0;
-    context.stride = 0;
-    context.finished = false;
-    context.failed = false;
-    
-    // Create screencopy frame
-    // Note: In a real implementation, we would use the actual wlr-screencopy protocol
-    // For now, we'll simulate the process but mark as not implemented
-    
-    // Setup shared memory buffer
-    const uint32_t bytes_per_pixel = 4; // RGBA
-    const size_t buffer_size = display_info->width * display_info->height * bytes_per_pixel;
-    
-    // Create shared memory file
-    int shm_fd = CreateSharedMemoryFile(buffer_size);
-    if (shm_fd < 0) {
-        result.error_message = "Failed to create shared memory file";
+
+    // The request takes logical coordinates; widen to whole logical pixels
+    // and trim the scaled buffer afterwards
+    const uint32_t scale = static_cast<uint32_t>(std::max(info.scale, 1));
+    DirtyRect logical;
+    logical.x = rect.x / scale;
+    logical.y = rect.y / scale;
+    logical.width = (rect.x + rect.width + scale - 1) / scale - logical.x;
+    logical.height = (rect.y + rect.height + scale - 1) / scale - logical.y;
+
+    if (region_session_ && !region_session_->Matches(info.output, logical)) {
+        region_session_.reset();
+    }
+    if (!region_session_) {
+        region_session_ = std::make_unique<WaylandCaptureSession>(this, info.output, logical);
+    }
+
+    bool changed = false;
+    if (!region_session_->Update(prefer_dmabuf_, nullptr, &changed, result.error_message)) {
+        region_session_.reset();
         return result;
     }
-    
-    // Map the shared memory
-    void* shm_data = mmap(nullptr, buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (shm_data == MAP_FAILED) {
-        close(shm_fd);
-        result.error_message = "Failed to map shared memory";
+
+    result = SessionToScreenshotResult(region_session_.get());
+    if (!result.success || scale == 1) {
         return result;
     }
-    
-    // In a complete implementation, we would:
-    // 1. Create a wl_shm_pool from the fd
-    // 2. Create a wl_buffer from the pool
-    // 3. Create a zwlr_screencopy_frame_v1 
-    // 4. Set up proper event handlers
-    // 5. Wait for the frame to complete
-    
-    // For now, we'll return an error indicating the feature is not fully implemented
-    munmap(shm_data, buffer_size);
-    close(shm_fd);
-    
-    result.error_message = "Wayland screencopy requires full wlr-screencopy protocol implementation";
-    result.success = false;
-    
-    return result;
+
+    DirtyRect trim;
+    trim.x = std::min(rect.x - logical.x * scale, result.width);
+    trim.y = std::min(rect.y - logical.y * scale, result.height);
+    trim.width = std::min(rect.width, result.width - trim.x);
+    trim.height = std::min(rect.height, result.height - trim.y);
+    if (trim.x == 0 && trim.y == 0 && trim.width == result.width && trim.height == result.height) {
+        return result;
+    }
+    return WebPScreenshot::Utils::CropScreenshotResult(result, trim);
 }
 
-int WaylandImplementation::CreateSharedMemoryFile(size_t size) {
-    // Create a temporary file for shared memory
-    char name[] = "/tmp/webp-screenshot-XXXXXX";
-    int fd = mkstemp(name);
-    if (fd < 0) {
-        return -1;
+bool WaylandImplementation::CaptureDisplayIncremental(uint32_t display_index, ScreenshotResult& result,
+                                                      std::vector<DirtyRect>* damage, bool* changed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WaylandCaptureSession* session = GetSession(display_index);
+    if (!session) {
+        return false;
     }
-    
-    // Unlink the file so it's automatically cleaned up
-    unlink(name);
-    
-    // Resize the file
-    if (ftruncate(fd, size) < 0) {
-        close(fd);
-        return -1;
+
+    std::string error;
+    if (!session->Update(prefer_dmabuf_, damage, changed, error)) {
+        result.error_message = error;
+        return false;
     }
-    
-    return fd;
+
+    if (*changed) {
+        result = SessionToScreenshotResult(session);
+    }
+    return true;
+}
+
+bool WaylandImplementation::CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                                               FrameDescriptor& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    WaylandCaptureSession* session = GetSession(display_index);
+    if (!session) {
+        frame.error_message = "Wayland capture session not available";
+        return false;
+    }
+
+    bool changed = false;
+    if (!session->Update(prefer_dmabuf_, &frame.dirty_rects, &changed, frame.error_message)) {
+        return false;
+    }
+    frame.has_dirty_rects = true;
+
+    frame.required_size = static_cast<size_t>(session->Width()) * session->Height() * 4;
+    if (!buffer || capacity < frame.required_size) {
+        frame.error_message = "Frame buffer too small";
+        return false;
+    }
+
+    if (!session->ReadFront(buffer, session->Width() * 4, frame.error_message)) {
+        return false;
+    }
+
+    frame.width = session->Width();
+    frame.height = session->Height();
+    frame.stride = frame.width * 4;
+    frame.bytes_per_pixel = 4;
+    return true;
+}
+
+bool WaylandImplementation::CaptureDisplayDmabuf(uint32_t display_index, DmabufFrame& frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!HasDmabufSupport() || !OpenRenderNode()) {
+        return false;
+    }
+
+    WaylandCaptureSession* session = GetSession(display_index);
+    if (!session) {
+        return false;
+    }
+
+    bool changed = false;
+    std::string error;
+    return session->Update(true, nullptr, &changed, error) && session->ExportFront(frame);
 }
 
 // Static Wayland protocol handlers
 void WaylandImplementation::RegistryGlobalHandler(void* data, struct wl_registry* registry,
-                                                uint32_t name, const char* interface, 
+                                                uint32_t name, const char* interface,
                                                 uint32_t version) {
     WaylandImplementation* impl = static_cast<WaylandImplementation*>(data);
-    
-    if (std::strcmp(interface, "wl_output") == 0) {
+
+    if (std::strcmp(interface, wl_output_interface.name) == 0) {
         struct wl_output* output = static_cast<struct wl_output*>(
             wl_registry_bind(registry, name, &wl_output_interface, std::min(version, 2U)));
-        
+
         static const struct wl_output_listener output_listener = {
             OutputGeometryHandler,
             OutputModeHandler,
             OutputDoneHandler,
             OutputScaleHandler
         };
-        
+
         wl_output_add_listener(output, &output_listener, impl);
-        
+
         // Add to displays list
         WaylandDisplayInfo display_info;
         display_info.output = output;
+        display_info.global_name = name;
         display_info.name = "Wayland Output " + std::to_string(impl->wayland_displays_.size());
+        display_info.is_primary = impl->wayland_displays_.empty();
         impl->wayland_displays_.push_back(display_info);
-        
-    } else if (std::strcmp(interface, "zwlr_screencopy_manager_v1") == 0) {
-        // impl->screencopy_manager_ = static_cast<struct zwlr_screencopy_manager_v1*>(
-        //     wl_registry_bind(registry, name, &zwlr_screencopy_manager_v1_interface, version));
-        // Note: This requires the actual protocol implementation
+
+    } else if (std::strcmp(interface, wl_shm_interface.name) == 0) {
+        impl->shm_ = static_cast<struct wl_shm*>(
+            wl_registry_bind(registry, name, &wl_shm_interface, 1));
+
+    } else if (std::strcmp(interface, zwlr_screencopy_manager_v1_interface.name) == 0) {
+        impl->screencopy_version_ = std::min(version, 3U);
+        impl->screencopy_manager_ = static_cast<struct zwlr_screencopy_manager_v1*>(
+            wl_registry_bind(registry, name, &zwlr_screencopy_manager_v1_interface,
+                             impl->screencopy_version_));
+    }
+#if HAVE_GBM
+    else if (std::strcmp(interface, zwp_linux_dmabuf_v1_interface.name) == 0 && version >= 2) {
+        // create_immed needs version 2; format events are not needed since
+        // screencopy tells us the format per frame
+        impl->linux_dmabuf_ = static_cast<struct zwp_linux_dmabuf_v1*>(
+            wl_registry_bind(registry, name, &zwp_linux_dmabuf_v1_interface, std::min(version, 3U)));
     }
+#endif
 }
 
 void WaylandImplementation::RegistryGlobalRemoveHandler(void* data, struct wl_registry* registry,
                                                       uint32_t name) {
-    // Handle removal of global objects
+    WaylandImplementation* impl = static_cast<WaylandImplementation*>(data);
+
+    // Release the output now and leave an empty entry for GetSession to prune;
+    // its session may be mid-Update further up the stack
+    for (auto& display : impl->wayland_displays_) {
+        if (display.output && display.global_name == name) {
+            wl_output_destroy(display.output);
+            display.output = nullptr;
+            break;
+        }
+    }
 }
 
 void WaylandImplementation::OutputGeometryHandler(void* data, struct wl_output* output,
@@ -283,7 +1113,7 @@ void WaylandImplementation::OutputGeometryHandler(void* data, struct wl_output*
                                                 const char* make, const char* model,
                                                 int32_t transform) {
     WaylandImplementation* impl = static_cast<WaylandImplementation*>(data);
-    
+
     // Find the corresponding display and update geometry
     for (auto& display : impl->wayland_displays_) {
         if (display.output == output) {
@@ -299,13 +1129,16 @@ void WaylandImplementation::OutputModeHandler(void* data, struct wl_output* outp
                                             uint32_t flags, int32_t width, int32_t height,
                                             int32_t refresh) {
     WaylandImplementation* impl = static_cast<WaylandImplementation*>(data);
-    
-    // Update display mode information
+
+    // Outputs advertise every mode; only the current one matters
+    if ((flags & WL_OUTPUT_MODE_CURRENT) == 0) {
+        return;
+    }
+
     for (auto& display : impl->wayland_displays_) {
         if (display.output == output) {
             display.width = width;
             display.height = height;
-            display.is_primary = (flags & WL_OUTPUT_MODE_CURRENT) != 0;
             break;
         }
     }
@@ -318,7 +1151,7 @@ void WaylandImplementation::OutputDoneHandler(void* data, struct wl_output* outp
 void WaylandImplementation::OutputScaleHandler(void* data, struct wl_output* output,
                                              int32_t factor) {
     WaylandImplementation* impl = static_cast<WaylandImplementation*>(data);
-    
+
     // Update scale factor
     for (auto& display : impl->wayland_displays_) {
         if (display.output == output) {
@@ -328,36 +1161,22 @@ void WaylandImplementation::OutputScaleHandler(void* data, struct wl_output* out
     }
 }
 
-// Screencopy protocol handlers (stubs)
-void WaylandImplementation::ScreencopyFrameHandler(void* data, 
-                                                 struct zwlr_screencopy_frame_v1* frame,
-                                                 uint32_t format, uint32_t width, uint32_t height,
-                                                 uint32_t stride) {
-    // Handle frame buffer information
-}
-
-void WaylandImplementation::ScreencopyReadyHandler(void* data,
-                                                 struct zwlr_screencopy_frame_v1* frame,
-                                                 uint32_t tv_sec_hi, uint32_t tv_sec_lo,
-                                                 uint32_t tv_nsec) {
-    // Frame is ready for copying
-}
-
-void WaylandImplementation::ScreencopyFailedHandler(void* data,
-                                                  struct zwlr_screencopy_frame_v1* frame) {
-    // Screencopy operation failed
-}
-
 } // namespace Linux
 } // namespace WebPScreenshot
 
 #else // !HAVE_WAYLAND
 
+#include "screenshot.h"
+
 // Stub implementation when Wayland is not available
 namespace WebPScreenshot {
 namespace Linux {
 
-WaylandImplementation::WaylandImplementation() : is_supported_(false) {}
+class WaylandCaptureSession {};
+
+WaylandImplementation::WaylandImplementation()
+    : is_supported_(false), display_(nullptr), registry_(nullptr),
+      screencopy_manager_(nullptr) {}
 WaylandImplementation::~WaylandImplementation() {}
 
 bool WaylandImplementation::Initialize() { return false; }
@@ -368,8 +1187,29 @@ ScreenshotResult WaylandImplementation::CaptureDisplay(uint32_t display_index) {
     return result;
 }
 
+ScreenshotResult WaylandImplementation::CaptureDisplayRegion(uint32_t, const CaptureRegion&) {
+    ScreenshotResult result;
+    result.error_message = "Wayland support not compiled in";
+    return result;
+}
+
+bool WaylandImplementation::CaptureDisplayIncremental(uint32_t, ScreenshotResult& result,
+                                                      std::vector<DirtyRect>*, bool*) {
+    result.error_message = "Wayland support not compiled in";
+    return false;
+}
+
+bool WaylandImplementation::CaptureDisplayInto(uint32_t, uint8_t*, size_t, FrameDescriptor& frame) {
+    frame.error_message = "Wayland support not compiled in";
+    return false;
+}
+
+bool WaylandImplementation::CaptureDisplayDmabuf(uint32_t, DmabufFrame&) { return false; }
+void WaylandImplementation::SetPreferDmabuf(bool) {}
+bool WaylandImplementation::HasDmabufSupport() const { return false; }
+
 } // namespace Linux
 } // namespace WebPScreenshot
 
 #endif // HAVE_WAYLAND
-#endif // __linux__
\ No newline at end of file
+#endif // __linux__
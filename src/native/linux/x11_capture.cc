@@ -5,6 +5,9 @@
 #include <X11/Xutil.h>
 #include <X11/extensions/XShm.h>
 #include <X11/extensions/Xrandr.h>
+#include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xcomposite.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <cstring>
@@ -13,6 +16,189 @@
 namespace WebPScreenshot {
 namespace Linux {
 
+// Long-lived capture state for one display. The XShm segment and XImage stay
+// attached across frames, and an XDamage object on the root window tells us
+// whether anything inside the display changed without reading back pixels.
+class X11CaptureSession {
+public:
+    X11CaptureSession(Display* display, int screen, Window root,
+                      int x, int y, int width, int height, bool use_damage)
+        : display_(display), screen_(screen), root_(root),
+          x_(x), y_(y), width_(width), height_(height), use_damage_(use_damage) {
+        shm_info_.shmid = -1;
+        shm_info_.shmaddr = nullptr;
+    }
+
+    ~X11CaptureSession() {
+        if (damage_) {
+            XDamageDestroy(display_, damage_);
+        }
+        if (region_) {
+            XFixesDestroyRegion(display_, region_);
+        }
+        if (attached_) {
+            XShmDetach(display_, &shm_info_);
+            XSync(display_, False);
+        }
+        if (ximage_) {
+            ximage_->data = nullptr;  // Owned by the segment, not Xlib
+            XDestroyImage(ximage_);
+        }
+        if (shm_info_.shmaddr) {
+            shmdt(shm_info_.shmaddr);
+        }
+    }
+
+    X11CaptureSession(const X11CaptureSession&) = delete;
+    X11CaptureSession& operator=(const X11CaptureSession&) = delete;
+
+    bool Open() {
+        ximage_ = XShmCreateImage(display_, DefaultVisual(display_, screen_),
+                                  DefaultDepth(display_, screen_), ZPixmap, nullptr,
+                                  &shm_info_, width_, height_);
+        if (!ximage_) {
+            return false;
+        }
+
+        const size_t segment_size = static_cast<size_t>(ximage_->bytes_per_line) * ximage_->height;
+        shm_info_.shmid = shmget(IPC_PRIVATE, segment_size, IPC_CREAT | 0600);
+        if (shm_info_.shmid < 0) {
+            return false;
+        }
+
+        void* addr = shmat(shm_info_.shmid, nullptr, 0);
+        if (addr == reinterpret_cast<void*>(-1)) {
+            shmctl(shm_info_.shmid, IPC_RMID, nullptr);
+            return false;
+        }
+
+        shm_info_.shmaddr = ximage_->data = static_cast<char*>(addr);
+        shm_info_.readOnly = False;
+
+        if (!XShmAttach(display_, &shm_info_)) {
+            shmctl(shm_info_.shmid, IPC_RMID, nullptr);
+            return false;
+        }
+        XSync(display_, False);
+        attached_ = true;
+
+        // The segment goes away once both we and the server have detached
+        shmctl(shm_info_.shmid, IPC_RMID, nullptr);
+
+        if (use_damage_) {
+            damage_ = XDamageCreate(display_, root_, XDamageReportNonEmpty);
+            region_ = XFixesCreateRegion(display_, nullptr, 0);
+        }
+
+        return true;
+    }
+
+    // Refresh the session image. Sets *changed to false, without any pixel
+    // transfer, when no damage intersects the display since the last update.
+    bool Update(std::vector<DirtyRect>* damage, bool* changed) {
+        std::vector<DirtyRect> rects;
+        *changed = false;
+
+        if (valid_ && damage_) {
+            if (!damaged_) {
+                if (damage) damage->clear();
+                return true;
+            }
+            damaged_ = false;
+
+            // Subtract before reading so later updates raise a new notify
+            XDamageSubtract(display_, damage_, None, region_);
+            CollectDamage(rects);
+            if (rects.empty()) {
+                if (damage) damage->clear();
+                return true;
+            }
+        } else {
+            if (damage_) {
+                XDamageSubtract(display_, damage_, None, None);
+                damaged_ = false;
+            }
+            rects.push_back({0, 0, static_cast<uint32_t>(width_), static_cast<uint32_t>(height_)});
+        }
+
+        uint64_t damaged_area = 0;
+        for (const auto& rect : rects) {
+            damaged_area += static_cast<uint64_t>(rect.width) * rect.height;
+        }
+
+        // Small updates are cheaper as per-rect uploads into the shared image
+        const uint64_t full_area = static_cast<uint64_t>(width_) * height_;
+        Stats::ScopedStageTimer capture_timer(Stats::Stage::Capture);
+        if (valid_ && damaged_area * kPartialReadbackRatio < full_area) {
+            for (const auto& rect : rects) {
+                XGetSubImage(display_, root_, x_ + static_cast<int>(rect.x), y_ + static_cast<int>(rect.y),
+                             rect.width, rect.height, AllPlanes, ZPixmap, ximage_,
+                             static_cast<int>(rect.x), static_cast<int>(rect.y));
+            }
+        } else if (!XShmGetImage(display_, root_, ximage_, x_, y_, AllPlanes)) {
+            capture_timer.Cancel();
+            valid_ = false;
+            return false;
+        }
+
+        valid_ = true;
+        *changed = true;
+        if (damage) *damage = std::move(rects);
+        return true;
+    }
+
+    // Returns true if the event belonged to this session
+    bool HandleDamageEvent(const XDamageNotifyEvent& event) {
+        if (event.damage != damage_) {
+            return false;
+        }
+        damaged_ = true;
+        return true;
+    }
+
+    XImage* Image() const { return ximage_; }
+    bool Matches(int x, int y, int width, int height) const {
+        return x == x_ && y == y_ && width == width_ && height == height_;
+    }
+
+private:
+    static constexpr uint64_t kPartialReadbackRatio = 4;  // Below 25% of the display
+
+    Display* display_;
+    int screen_;
+    Window root_;
+    int x_, y_, width_, height_;
+    bool use_damage_;
+
+    XShmSegmentInfo shm_info_ = {};
+    XImage* ximage_ = nullptr;
+    bool attached_ = false;
+    bool valid_ = false;    // ximage_ holds a complete frame
+
+    Damage damage_ = 0;
+    XserverRegion region_ = 0;
+    bool damaged_ = true;
+
+    // Clip the fetched damage region to this display, in display coordinates
+    void CollectDamage(std::vector<DirtyRect>& rects) {
+        int count = 0;
+        XRectangle* boxes = XFixesFetchRegion(display_, region_, &count);
+        for (int i = 0; i < count; ++i) {
+            const int left = std::max<int>(boxes[i].x, x_);
+            const int top = std::max<int>(boxes[i].y, y_);
+            const int right = std::min<int>(boxes[i].x + boxes[i].width, x_ + width_);
+            const int bottom = std::min<int>(boxes[i].y + boxes[i].height, y_ + height_);
+            if (right > left && bottom > top) {
+                rects.push_back({static_cast<uint32_t>(left - x_), static_cast<uint32_t>(top - y_),
+                                 static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top)});
+            }
+        }
+        if (boxes) {
+            XFree(boxes);
+        }
+    }
+};
+
 // X11Implementation class implementation
 X11Implementation::X11Implementation() 
     : is_supported_(false), display_(nullptr), screen_count_(0) {
@@ -36,6 +222,9 @@ bool X11Implementation::Initialize() {
         if (CheckXRandRExtension()) {
             EnumerateXRandROutputs();
         }
+
+        has_damage_ = CheckDamageExtension();
+        has_composite_ = CheckCompositeExtension();
         
         is_supported_ = !x11_displays_.empty();
         return is_supported_;
@@ -61,6 +250,14 @@ bool X11Implementation::OpenDisplay() {
 }
 
 void X11Implementation::CloseDisplay() {
+    // Sessions hold server resources and must go before the connection
+    ResetSessions();
+
+    if (display_ && redirected_window_) {
+        XCompositeUnredirectWindow(display_, redirected_window_, CompositeRedirectAutomatic);
+        redirected_window_ = 0;
+    }
+
     if (display_) {
         XCloseDisplay(display_);
         display_ = nullptr;
@@ -114,6 +311,8 @@ void X11Implementation::EnumerateXRandROutputs() {
                     X11DisplayInfo info;
                     info.screen_number = screen;
                     info.root_window = root;
+                    info.x = crtc_info->x;
+                    info.y = crtc_info->y;
                     info.width = crtc_info->width;
                     info.height = crtc_info->height;
                     info.depth = GetScreenDepth(screen);
@@ -137,6 +336,7 @@ void X11Implementation::EnumerateXRandROutputs() {
     // Use XRandR displays if we found any, otherwise keep the basic screen enumeration
     if (!randr_displays.empty()) {
         x11_displays_ = randr_displays;
+        ResetSessions();
     }
 }
 
@@ -150,8 +350,8 @@ std::vector<DisplayInfo> X11Implementation::GetDisplays() {
         info.index = static_cast<uint32_t>(i);
         info.width = static_cast<uint32_t>(x11_display.width);
         info.height = static_cast<uint32_t>(x11_display.height);
-        info.x = 0; // X11 screens typically start at origin
-        info.y = 0;
+        info.x = x11_display.x;
+        info.y = x11_display.y;
         info.scale_factor = 1.0f; // X11 doesn't have built-in DPI scaling
         info.is_primary = x11_display.is_primary;
         info.name = x11_display.name;
@@ -169,10 +369,238 @@ ScreenshotResult X11Implementation::CaptureDisplay(uint32_t display_index) {
         return result;
     }
     
+    // Persistent XShm session; falls back to a one-off capture if unavailable
+    bool changed = false;
+    ScreenshotResult result;
+    if (CaptureDisplayIncremental(display_index, result, nullptr, &changed)) {
+        if (!changed) {
+            result = XImageToScreenshotResult(GetSession(display_index)->Image());
+        }
+        return result;
+    }
+    
     const auto& display_info = x11_displays_[display_index];
     return CaptureWindow(display_info.root_window);
 }
 
+bool X11Implementation::CaptureDisplayIncremental(uint32_t display_index, ScreenshotResult& result,
+                                                  std::vector<DirtyRect>* damage, bool* changed) {
+    X11CaptureSession* session = GetSession(display_index);
+    if (!session) {
+        return false;
+    }
+
+    DispatchDamageEvents();
+
+    if (!session->Update(damage, changed)) {
+        return false;
+    }
+
+    if (*changed) {
+        result = XImageToScreenshotResult(session->Image());
+    }
+    return true;
+}
+
+bool X11Implementation::CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                                           FrameDescriptor& frame) {
+    X11CaptureSession* session = GetSession(display_index);
+    if (!session) {
+        frame.error_message = "X11 capture session not available";
+        return false;
+    }
+
+    XImage* ximage = session->Image();
+    frame.required_size = static_cast<size_t>(ximage->width) * ximage->height * 4;
+    if (!buffer || capacity < frame.required_size) {
+        frame.error_message = "Frame buffer too small";
+        return false;
+    }
+
+    DispatchDamageEvents();
+
+    bool changed = false;
+    if (!session->Update(&frame.dirty_rects, &changed)) {
+        frame.error_message = "XShmGetImage failed";
+        return false;
+    }
+    frame.has_dirty_rects = true;
+
+    ConvertPixelFormat(ximage, buffer);
+    frame.width = static_cast<uint32_t>(ximage->width);
+    frame.height = static_cast<uint32_t>(ximage->height);
+    frame.stride = frame.width * 4;
+    frame.bytes_per_pixel = 4;
+    return true;
+}
+
+X11CaptureSession* X11Implementation::GetSession(uint32_t display_index) {
+    if (!display_ || display_index >= x11_displays_.size() || !CheckXShmExtension()) {
+        return nullptr;
+    }
+
+    if (sessions_.size() < x11_displays_.size()) {
+        sessions_.resize(x11_displays_.size());
+    }
+
+    const auto& info = x11_displays_[display_index];
+    auto& session = sessions_[display_index];
+    if (session && !session->Matches(info.x, info.y, info.width, info.height)) {
+        session.reset();
+    }
+
+    if (!session) {
+        auto created = std::make_unique<X11CaptureSession>(
+            display_, info.screen_number, info.root_window,
+            info.x, info.y, info.width, info.height, has_damage_);
+        if (!created->Open()) {
+            return nullptr;
+        }
+        session = std::move(created);
+    }
+
+    return session.get();
+}
+
+void X11Implementation::ResetSessions() {
+    sessions_.clear();
+    region_session_.reset();
+}
+
+void X11Implementation::DispatchDamageEvents() {
+    if (!has_damage_) {
+        return;
+    }
+
+    // XPending only reads what the server already sent; no round-trip
+    while (XPending(display_) > 0) {
+        XEvent event;
+        XNextEvent(display_, &event);
+        if (event.type != damage_event_base_ + XDamageNotify) {
+            continue;
+        }
+
+        const auto& notify = *reinterpret_cast<const XDamageNotifyEvent*>(&event);
+        for (auto& session : sessions_) {
+            if (session && session->HandleDamageEvent(notify)) {
+                break;
+            }
+        }
+    }
+}
+
+ScreenshotResult X11Implementation::CaptureDisplayRegion(uint32_t display_index, const CaptureRegion& region) {
+    ScreenshotResult result;
+    if (!display_) {
+        result.error_message = "X11 display not available";
+        return result;
+    }
+
+    if (region.window_id != 0) {
+        return CaptureWindowRegion(static_cast<Window>(region.window_id), region);
+    }
+
+    if (display_index >= x11_displays_.size()) {
+        result.error_message = "Display index out of range";
+        return result;
+    }
+
+    const auto& info = x11_displays_[display_index];
+    DirtyRect rect;
+    if (!WebPScreenshot::Utils::ClipCaptureRegion(region, static_cast<uint32_t>(info.width),
+                                                  static_cast<uint32_t>(info.height), rect,
+                                                  result.error_message)) {
+        return result;
+    }
+
+    // Root window coordinates
+    const int x = info.x + static_cast<int>(rect.x);
+    const int y = info.y + static_cast<int>(rect.y);
+    const int width = static_cast<int>(rect.width);
+    const int height = static_cast<int>(rect.height);
+
+    // Keep the segment while the same rectangle is polled; a new one only
+    // costs a shmget and attach
+    if (region_session_ && (region_root_ != info.root_window || !region_session_->Matches(x, y, width, height))) {
+        region_session_.reset();
+    }
+    if (!region_session_ && CheckXShmExtension()) {
+        auto created = std::make_unique<X11CaptureSession>(
+            display_, info.screen_number, info.root_window, x, y, width, height, false);
+        if (created->Open()) {
+            region_session_ = std::move(created);
+            region_root_ = info.root_window;
+        }
+    }
+
+    if (region_session_) {
+        bool changed = false;
+        if (region_session_->Update(nullptr, &changed)) {
+            return XImageToScreenshotResult(region_session_->Image());
+        }
+        region_session_.reset();
+    }
+
+    return CaptureWithXGetImage(info.root_window, x, y, width, height);
+}
+
+ScreenshotResult X11Implementation::CaptureWindowRegion(Window window, const CaptureRegion& region) {
+    ScreenshotResult result;
+
+    XWindowAttributes window_attrs;
+    if (XGetWindowAttributes(display_, window, &window_attrs) == 0) {
+        result.error_message = "Failed to get window attributes";
+        return result;
+    }
+    if (window_attrs.map_state != IsViewable) {
+        result.error_message = "Window is not viewable";
+        return result;
+    }
+
+    if (window_attrs.width <= 0 || window_attrs.height <= 0) {
+        result.error_message = "Invalid window dimensions";
+        return result;
+    }
+
+    DirtyRect rect;
+    if (!WebPScreenshot::Utils::ClipCaptureRegion(region, static_cast<uint32_t>(window_attrs.width),
+                                                  static_cast<uint32_t>(window_attrs.height), rect,
+                                                  result.error_message)) {
+        return result;
+    }
+
+    const int x = static_cast<int>(rect.x);
+    const int y = static_cast<int>(rect.y);
+    const int width = static_cast<int>(rect.width);
+    const int height = static_cast<int>(rect.height);
+
+    // A redirected window renders into its own pixmap, so parts covered by
+    // other windows still read back. Redirection is a no-op for the window's
+    // looks and is dropped when another window is captured.
+    if (has_composite_) {
+        if (redirected_window_ != window) {
+            if (redirected_window_) {
+                XCompositeUnredirectWindow(display_, redirected_window_, CompositeRedirectAutomatic);
+            }
+            XCompositeRedirectWindow(display_, window, CompositeRedirectAutomatic);
+            redirected_window_ = window;
+        }
+
+        // Named per capture: the server replaces the pixmap when the window resizes
+        Pixmap pixmap = XCompositeNameWindowPixmap(display_, window);
+        if (pixmap) {
+            result = CaptureWithXGetImage(pixmap, x, y, width, height);
+            XFreePixmap(display_, pixmap);
+            if (result.success) {
+                return result;
+            }
+        }
+    }
+
+    // Visible parts only
+    return CaptureWithXGetImage(window, x, y, width, height);
+}
+
 ScreenshotResult X11Implementation::CaptureScreen(int screen_number) {
     if (screen_number >= screen_count_) {
         ScreenshotResult result;
@@ -216,21 +644,21 @@ ScreenshotResult X11Implementation::CaptureWindow(Window window) {
     }
     
     // Fallback to regular XGetImage
-    return CaptureWithXGetImage(window, width, height);
+    return CaptureWithXGetImage(window, 0, 0, width, height);
 }
 
-ScreenshotResult X11Implementation::CaptureWithXGetImage(Window window, int width, int height) {
+ScreenshotResult X11Implementation::CaptureWithXGetImage(Window window, int x, int y, int width, int height) {
     ScreenshotResult result;
     
-    Utils::PerformanceTimer timer;
-    timer.Start();
-    
     // Capture the image
-    XImage* ximage = XGetImage(display_, window, 0, 0, width, height, AllPlanes, ZPixmap);
+    Stats::ScopedStageTimer capture_timer(Stats::Stage::Capture);
+    XImage* ximage = XGetImage(display_, window, x, y, width, height, AllPlanes, ZPixmap);
     if (!ximage) {
+        capture_timer.Cancel();
         result.error_message = "XGetImage failed";
         return result;
     }
+    capture_timer.Stop();
     
     // Convert XImage to ScreenshotResult
     result = XImageToScreenshotResult(ximage);
@@ -257,7 +685,7 @@ ScreenshotResult X11Implementation::CaptureWithXShmGetImage(Window window, int w
     // Allocate shared memory
     void* shm_addr = Utils::SharedMemoryHelper::AllocateSharedMemory(image_size);
     if (!shm_addr) {
-        return CaptureWithXGetImage(window, width, height); // Fallback
+        return CaptureWithXGetImage(window, 0, 0, width, height); // Fallback
     }
     
     // Create XImage with shared memory
@@ -267,16 +695,20 @@ ScreenshotResult X11Implementation::CaptureWithXShmGetImage(Window window, int w
     
     if (!ximage) {
         Utils::SharedMemoryHelper::FreeSharedMemory(shm_addr, image_size);
-        return CaptureWithXGetImage(window, width, height); // Fallback
+        return CaptureWithXGetImage(window, 0, 0, width, height); // Fallback
     }
     
     // Get the image using shared memory
+    Stats::ScopedStageTimer capture_timer(Stats::Stage::Capture);
     if (XShmGetImage(display_, window, ximage, 0, 0, AllPlanes) == False) {
+        capture_timer.Cancel();
         XDestroyImage(ximage);
         Utils::SharedMemoryHelper::FreeSharedMemory(shm_addr, image_size);
-        return CaptureWithXGetImage(window, width, height); // Fallback
+        return CaptureWithXGetImage(window, 0, 0, width, height); // Fallback
     }
     
+    capture_timer.Stop();
+    
     // Convert to ScreenshotResult
     result = XImageToScreenshotResult(ximage);
     
@@ -308,7 +740,7 @@ ScreenshotResult X11Implementation::XImageToScreenshotResult(XImage* ximage) {
     
     // Allocate output buffer using memory pool
     size_t output_size = static_cast<size_t>(height) * stride;
-    result.data = Utils::AllocateScreenshotBuffer(output_size);
+    result.data = WebPScreenshot::Utils::AllocateScreenshotBuffer(output_size);
     result.data_size = static_cast<uint32_t>(output_size);
     
     // Convert pixel data
@@ -326,6 +758,8 @@ ScreenshotResult X11Implementation::XImageToScreenshotResult(XImage* ximage) {
 
 void X11Implementation::ConvertPixelFormat(XImage* ximage, uint8_t* output_buffer) {
     uint32_t pixel_count = static_cast<uint32_t>(ximage->width * ximage->height);
+    Stats::ScopedStageTimer convert_timer(Stats::Stage::Convert);
+    Stats::AddBytesCopied(static_cast<uint64_t>(pixel_count) * 4);
     
     // Detect pixel format
     Utils::PixelFormat format = Utils::DetectPixelFormat(
@@ -386,6 +820,28 @@ bool X11Implementation::CheckXShmExtension() {
     return XQueryExtension(display_, "MIT-SHM", &major_opcode, &first_event, &first_error) == True;
 }
 
+bool X11Implementation::CheckDamageExtension() {
+    int fixes_event_base, fixes_error_base;
+    if (!XDamageQueryExtension(display_, &damage_event_base_, &damage_error_base_) ||
+        !XFixesQueryExtension(display_, &fixes_event_base, &fixes_error_base)) {
+        return false;
+    }
+
+    // Region requests need XFixes 2.0 to be negotiated first
+    int major = 2, minor = 0;
+    return XFixesQueryVersion(display_, &major, &minor) && major >= 2;
+}
+
+bool X11Implementation::CheckCompositeExtension() {
+    int event_base, error_base;
+    if (!XCompositeQueryExtension(display_, &event_base, &error_base)) {
+        return false;
+    }
+
+    int major = 0, minor = 2;
+    return XCompositeQueryVersion(display_, &major, &minor) && (major > 0 || minor >= 2);
+}
+
 bool X11Implementation::CheckXRandRExtension() {
     int major_opcode, first_event, first_error;
     return XQueryExtension(display_, "RANDR", &major_opcode, &first_event, &first_error) == True;
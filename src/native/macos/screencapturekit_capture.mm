@@ -0,0 +1,390 @@
+#ifdef __APPLE__
+
+#include "screenshot.h"
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+#import <CoreMedia/CoreMedia.h>
+#import <CoreVideo/CoreVideo.h>
+
+#if __has_include(<ScreenCaptureKit/ScreenCaptureKit.h>)
+#import <ScreenCaptureKit/ScreenCaptureKit.h>
+#define WEBP_HAVE_SCREENCAPTUREKIT 1
+#else
+#define WEBP_HAVE_SCREENCAPTUREKIT 0
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+
+namespace {
+
+constexpr int32_t kStreamFrameRate = 60;
+constexpr int kStreamQueueDepth = 4;          // We hold at most two surfaces at once
+constexpr int64_t kStartTimeoutMs = 5000;
+constexpr size_t kMaxTrackedDirtyRects = 64;  // Past this, report the whole frame
+
+dispatch_time_t TimeoutFromNow(int64_t timeout_ms) {
+    return dispatch_time(DISPATCH_TIME_NOW, timeout_ms * NSEC_PER_MSEC);
+}
+
+} // anonymous namespace
+
+namespace WebPScreenshot {
+namespace macOS {
+
+struct ScreenCaptureKitSession::Impl {
+    CGDirectDisplayID display_id;
+    uint32_t width;
+    uint32_t height;
+
+    // Latest complete frame and what changed since the consumer last looked
+    std::mutex mutex;
+    std::condition_variable frame_condition;
+    CVPixelBufferRef latest = nullptr;  // Retained
+    std::vector<DirtyRect> pending_dirty;
+    bool pending_full = true;
+    uint64_t sequence = 0;
+    uint64_t acquired_sequence = 0;
+    bool running = false;
+
+    // SCStream, its output/delegate object and sample queue (manual retain)
+    id stream = nil;
+    id output = nil;
+    dispatch_queue_t queue = nullptr;
+
+    void OnFrame(CMSampleBufferRef sample);
+    void OnStopped();
+};
+
+} // namespace macOS
+} // namespace WebPScreenshot
+
+using WebPScreenshot::macOS::ScreenCaptureKitSession;
+
+#if WEBP_HAVE_SCREENCAPTUREKIT
+
+API_AVAILABLE(macos(12.3))
+@interface WebPScreenshotStreamOutput : NSObject <SCStreamOutput, SCStreamDelegate> {
+@public
+    ScreenCaptureKitSession::Impl* impl;
+}
+@end
+
+@implementation WebPScreenshotStreamOutput
+
+- (void)stream:(SCStream*)stream didOutputSampleBuffer:(CMSampleBufferRef)sample
+        ofType:(SCStreamOutputType)type {
+    if (type == SCStreamOutputTypeScreen && impl) {
+        impl->OnFrame(sample);
+    }
+}
+
+- (void)stream:(SCStream*)stream didStopWithError:(NSError*)error {
+    if (impl) {
+        impl->OnStopped();
+    }
+}
+
+@end
+
+#endif // WEBP_HAVE_SCREENCAPTUREKIT
+
+namespace WebPScreenshot {
+namespace macOS {
+
+void ScreenCaptureKitSession::Impl::OnFrame(CMSampleBufferRef sample) {
+#if WEBP_HAVE_SCREENCAPTUREKIT
+    if (@available(macOS 12.3, *)) {
+        if (!CMSampleBufferIsValid(sample)) {
+            return;
+        }
+
+        CFArrayRef attachments = CMSampleBufferGetSampleAttachmentsArray(sample, false);
+        if (!attachments || CFArrayGetCount(attachments) == 0) {
+            return;
+        }
+
+        // Idle, blank and suspended samples carry no new pixels; skipping them
+        // is what makes an unchanged display free
+        NSDictionary* info = (__bridge NSDictionary*)CFArrayGetValueAtIndex(attachments, 0);
+        NSNumber* status = info[SCStreamFrameInfoStatus];
+        if (!status || status.integerValue != SCFrameStatusComplete) {
+            return;
+        }
+
+        CVPixelBufferRef pixel_buffer = CMSampleBufferGetImageBuffer(sample);
+        if (!pixel_buffer) {
+            return;
+        }
+
+        const CGRect bounds = CGRectMake(0, 0, CVPixelBufferGetWidth(pixel_buffer),
+                                         CVPixelBufferGetHeight(pixel_buffer));
+        NSArray* dirty = info[SCStreamFrameInfoDirtyRects];
+        std::vector<DirtyRect> rects;
+        for (NSDictionary* entry in dirty) {
+            CGRect rect;
+            if (!CGRectMakeWithDictionaryRepresentation((__bridge CFDictionaryRef)entry, &rect)) {
+                continue;
+            }
+            rect = CGRectIntegral(CGRectIntersection(rect, bounds));
+            if (CGRectIsEmpty(rect)) {
+                continue;
+            }
+            rects.push_back({static_cast<uint32_t>(rect.origin.x), static_cast<uint32_t>(rect.origin.y),
+                             static_cast<uint32_t>(rect.size.width), static_cast<uint32_t>(rect.size.height)});
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (latest) {
+                CVPixelBufferRelease(latest);
+            }
+            latest = CVPixelBufferRetain(pixel_buffer);
+
+            if (!dirty) {
+                pending_full = true;
+            } else if (!pending_full) {
+                pending_dirty.insert(pending_dirty.end(), rects.begin(), rects.end());
+                if (pending_dirty.size() > kMaxTrackedDirtyRects) {
+                    pending_full = true;
+                    pending_dirty.clear();
+                }
+            }
+            ++sequence;
+        }
+        frame_condition.notify_all();
+    }
+#else
+    (void)sample;
+#endif
+}
+
+void ScreenCaptureKitSession::Impl::OnStopped() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    frame_condition.notify_all();
+}
+
+bool ScreenCaptureKitSession::IsAvailable() {
+#if WEBP_HAVE_SCREENCAPTUREKIT
+    if (@available(macOS 12.3, *)) {
+        return true;
+    }
+#endif
+    return false;
+}
+
+ScreenCaptureKitSession::ScreenCaptureKitSession(CGDirectDisplayID display_id, uint32_t width, uint32_t height)
+    : impl_(std::make_unique<Impl>()) {
+    impl_->display_id = display_id;
+    impl_->width = width;
+    impl_->height = height;
+}
+
+ScreenCaptureKitSession::~ScreenCaptureKitSession() {
+#if WEBP_HAVE_SCREENCAPTUREKIT
+    if (@available(macOS 12.3, *)) {
+        SCStream* stream = impl_->stream;
+        WebPScreenshotStreamOutput* output = impl_->output;
+
+        if (stream) {
+            if (impl_->running) {
+                dispatch_semaphore_t done = dispatch_semaphore_create(0);
+                [stream stopCaptureWithCompletionHandler:^(NSError* error) {
+                    dispatch_semaphore_signal(done);
+                }];
+                dispatch_semaphore_wait(done, TimeoutFromNow(kStartTimeoutMs));
+                dispatch_release(done);
+            }
+            [stream removeStreamOutput:output type:SCStreamOutputTypeScreen error:nil];
+
+            // Let a sample callback already on the queue finish before Impl goes away
+            dispatch_sync(impl_->queue, ^{});
+            [stream release];
+        }
+
+        if (output) {
+            output->impl = nullptr;
+            [output release];
+        }
+    }
+#endif
+
+    if (impl_->queue) {
+        dispatch_release(impl_->queue);
+    }
+    if (impl_->latest) {
+        CVPixelBufferRelease(impl_->latest);
+    }
+}
+
+bool ScreenCaptureKitSession::Start(std::string& error) {
+#if WEBP_HAVE_SCREENCAPTUREKIT
+    if (@available(macOS 12.3, *)) {
+        @autoreleasepool {
+            // Shareable content is the only way to get an SCDisplay for an ID
+            __block SCShareableContent* content = nil;
+            __block NSError* content_error = nil;
+            dispatch_semaphore_t done = dispatch_semaphore_create(0);
+            [SCShareableContent getShareableContentExcludingDesktopWindows:NO
+                                                       onScreenWindowsOnly:YES
+                                                         completionHandler:^(SCShareableContent* result, NSError* err) {
+                content = [result retain];
+                content_error = [err retain];
+                dispatch_semaphore_signal(done);
+            }];
+            const bool answered = dispatch_semaphore_wait(done, TimeoutFromNow(kStartTimeoutMs)) == 0;
+            dispatch_release(done);
+
+            if (!answered || !content) {
+                error = !answered ? "Timed out querying ScreenCaptureKit content"
+                        : content_error ? [[content_error localizedDescription] UTF8String]
+                                        : "ScreenCaptureKit content unavailable";
+                [content release];
+                [content_error release];
+                return false;
+            }
+            [content_error release];
+
+            SCDisplay* display = nil;
+            for (SCDisplay* candidate in content.displays) {
+                if (candidate.displayID == impl_->display_id) {
+                    display = candidate;
+                    break;
+                }
+            }
+            if (!display) {
+                [content release];
+                error = "Display not found in ScreenCaptureKit content";
+                return false;
+            }
+
+            SCContentFilter* filter = [[SCContentFilter alloc] initWithDisplay:display excludingWindows:@[]];
+            [content release];
+
+            // Native pixel size in the encoder's BGRA layout; no cursor, like
+            // the CoreGraphics path
+            SCStreamConfiguration* config = [[SCStreamConfiguration alloc] init];
+            config.width = impl_->width;
+            config.height = impl_->height;
+            config.pixelFormat = kCVPixelFormatType_32BGRA;
+            config.minimumFrameInterval = CMTimeMake(1, kStreamFrameRate);
+            config.queueDepth = kStreamQueueDepth;
+            config.showsCursor = NO;
+
+            WebPScreenshotStreamOutput* output = [[WebPScreenshotStreamOutput alloc] init];
+            output->impl = impl_.get();
+            impl_->output = output;
+            impl_->queue = dispatch_queue_create("webp-screenshot.screencapturekit", DISPATCH_QUEUE_SERIAL);
+
+            SCStream* stream = [[SCStream alloc] initWithFilter:filter configuration:config delegate:output];
+            [filter release];
+            [config release];
+            impl_->stream = stream;
+
+            NSError* add_error = nil;
+            if (![stream addStreamOutput:output type:SCStreamOutputTypeScreen
+                      sampleHandlerQueue:impl_->queue error:&add_error]) {
+                error = add_error ? [[add_error localizedDescription] UTF8String]
+                                  : "Failed to add ScreenCaptureKit stream output";
+                return false;
+            }
+
+            __block NSError* start_error = nil;
+            dispatch_semaphore_t started = dispatch_semaphore_create(0);
+            [stream startCaptureWithCompletionHandler:^(NSError* err) {
+                start_error = [err retain];
+                dispatch_semaphore_signal(started);
+            }];
+            const bool start_answered = dispatch_semaphore_wait(started, TimeoutFromNow(kStartTimeoutMs)) == 0;
+            dispatch_release(started);
+
+            if (!start_answered || start_error) {
+                error = !start_answered ? "Timed out starting ScreenCaptureKit stream"
+                                        : [[start_error localizedDescription] UTF8String];
+                [start_error release];
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(impl_->mutex);
+            impl_->running = true;
+            return true;
+        }
+    }
+#endif
+    error = "ScreenCaptureKit requires macOS 12.3 or later";
+    return false;
+}
+
+bool ScreenCaptureKitSession::IsRunning() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->running;
+}
+
+bool ScreenCaptureKitSession::Acquire(SurfaceFrame& frame, uint32_t timeout_ms) {
+    std::unique_lock<std::mutex> lock(impl_->mutex);
+    if (!impl_->latest) {
+        impl_->frame_condition.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] {
+            return impl_->latest != nullptr || !impl_->running;
+        });
+    }
+    if (!impl_->latest) {
+        return false;
+    }
+
+    CVPixelBufferRef pixel_buffer = CVPixelBufferRetain(impl_->latest);
+    const uint32_t width = static_cast<uint32_t>(CVPixelBufferGetWidth(pixel_buffer));
+    const uint32_t height = static_cast<uint32_t>(CVPixelBufferGetHeight(pixel_buffer));
+
+    frame.changed = impl_->sequence != impl_->acquired_sequence;
+    frame.sequence = impl_->sequence;
+    frame.dirty_rects.clear();
+    if (frame.changed) {
+        if (impl_->pending_full) {
+            frame.dirty_rects.push_back({0, 0, width, height});
+        } else {
+            frame.dirty_rects.swap(impl_->pending_dirty);
+        }
+        impl_->pending_dirty.clear();
+        impl_->pending_full = false;
+        impl_->acquired_sequence = impl_->sequence;
+    }
+    lock.unlock();
+
+    // Read-only lock: no cache flush back to the surface on unlock
+    Stats::ScopedStageTimer readback_timer(Stats::Stage::Readback);
+    if (CVPixelBufferLockBaseAddress(pixel_buffer, kCVPixelBufferLock_ReadOnly) != kCVReturnSuccess) {
+        readback_timer.Cancel();
+        CVPixelBufferRelease(pixel_buffer);
+        return false;
+    }
+    readback_timer.Stop();
+
+    frame.data = static_cast<const uint8_t*>(CVPixelBufferGetBaseAddress(pixel_buffer));
+    frame.width = width;
+    frame.height = height;
+    frame.stride = static_cast<uint32_t>(CVPixelBufferGetBytesPerRow(pixel_buffer));
+    frame.pixel_buffer = pixel_buffer;
+    return true;
+}
+
+void ScreenCaptureKitSession::Release(SurfaceFrame& frame) {
+    if (!frame.pixel_buffer) {
+        return;
+    }
+
+    CVPixelBufferRef pixel_buffer = static_cast<CVPixelBufferRef>(frame.pixel_buffer);
+    CVPixelBufferUnlockBaseAddress(pixel_buffer, kCVPixelBufferLock_ReadOnly);
+    CVPixelBufferRelease(pixel_buffer);
+
+    frame.pixel_buffer = nullptr;
+    frame.data = nullptr;
+}
+
+} // namespace macOS
+} // namespace WebPScreenshot
+
+#endif // __APPLE__
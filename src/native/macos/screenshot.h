@@ -5,6 +5,7 @@
 #include "../common/screenshot_common.h"
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <string>
 
 // Forward declarations for macOS types
@@ -18,6 +19,47 @@ typedef struct __CFData* CFDataRef;
 namespace WebPScreenshot {
 namespace macOS {
 
+// Read-only view of the latest ScreenCaptureKit frame. data points into the
+// locked IOSurface (BGRA, opaque) and stays valid until the frame is released.
+struct SurfaceFrame {
+    const uint8_t* data = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+    bool changed = false;                // False when nothing new arrived since the previous acquire
+    std::vector<DirtyRect> dirty_rects;  // Union since the previous acquire, in pixels
+    uint64_t sequence = 0;
+    void* pixel_buffer = nullptr;        // Retained, locked CVPixelBufferRef
+};
+
+// One SCStream per display, kept running between captures so a screenshot is
+// a buffer handoff instead of a CGImage render (macOS 12.3+,
+// screencapturekit_capture.mm)
+class ScreenCaptureKitSession {
+public:
+    static bool IsAvailable();
+
+    ScreenCaptureKitSession(CGDirectDisplayID display_id, uint32_t width, uint32_t height);
+    ~ScreenCaptureKitSession();
+
+    ScreenCaptureKitSession(const ScreenCaptureKitSession&) = delete;
+    ScreenCaptureKitSession& operator=(const ScreenCaptureKitSession&) = delete;
+
+    bool Start(std::string& error);
+    bool IsRunning() const;
+
+    // Lock the most recent frame. Only the first call waits (up to
+    // timeout_ms); later calls return the current frame immediately.
+    bool Acquire(SurfaceFrame& frame, uint32_t timeout_ms);
+    static void Release(SurfaceFrame& frame);
+
+    // Defined in the .mm; public so the Objective-C stream delegate can reach it
+    struct Impl;
+
+private:
+    std::unique_ptr<Impl> impl_;
+};
+
 class MacOSScreenshotCapture : public ScreenshotCapture {
 public:
     MacOSScreenshotCapture();
@@ -26,12 +68,38 @@ public:
     // ScreenshotCapture interface
     std::vector<DisplayInfo> GetDisplays() override;
     ScreenshotResult CaptureDisplay(uint32_t display_index) override;
+
+    // Converts only the rectangle out of the SCStream surface, or asks
+    // CGWindowListCreateImage for just those bounds. region.window_id is a
+    // CGWindowID, captured without the windows in front of it.
+    ScreenshotResult CaptureDisplay(uint32_t display_index, const CaptureRegion& region) override;
     std::vector<ScreenshotResult> CaptureAllDisplays() override;
+    bool CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                            FrameDescriptor& frame) override;
     bool IsSupported() override;
     std::string GetImplementationName() override;
 
+    // Borrow the display's current frame straight from its SCStream. Fails
+    // on systems without ScreenCaptureKit; callers fall back to CaptureDisplay.
+    bool AcquireSurfaceFrame(uint32_t display_index, SurfaceFrame& frame, uint32_t timeout_ms = 500);
+    void ReleaseSurfaceFrame(SurfaceFrame& frame);
+
+    // Encode from the locked IOSurface with its stride, without an
+    // intermediate copy. With changed given, an unchanged frame is skipped:
+    // *changed is false and the result is empty.
+    std::vector<uint8_t> EncodeDisplay(uint32_t display_index, const WebPEncodeParams& params,
+                                       bool* changed = nullptr);
+
+    const std::string& GetLastError() const { return last_error_; }
+
 private:
     bool initialized_;
+    std::string last_error_;
+
+    // ScreenCaptureKit streams, one per display, started lazily
+    std::mutex stream_mutex_;
+    std::vector<std::unique_ptr<ScreenCaptureKitSession>> stream_sessions_;
+    bool stream_unavailable_ = false;  // Missing or refused; stay on CoreGraphics
     
     struct DisplayHandle {
         CGDirectDisplayID display_id;
@@ -44,8 +112,17 @@ private:
     void EnumerateDisplays();
     
     // Screen capture methods
+    ScreenCaptureKitSession* GetStreamSession(uint32_t display_index);
+    ScreenshotResult SurfaceFrameToScreenshotResult(const SurfaceFrame& frame,
+                                                    const DirtyRect* rect = nullptr);
     ScreenshotResult CaptureWithCoreGraphics(CGDirectDisplayID display_id);
     ScreenshotResult CaptureWithCGWindowListCreateImage(CGDirectDisplayID display_id);
+    ScreenshotResult CaptureWindowRegion(CGWindowID window_id, const CaptureRegion& region);
+
+    // Global bounds in points; the result is trimmed to width x height pixels
+    ScreenshotResult CaptureBoundsWithCGWindowList(CGRect bounds, CGWindowListOption option,
+                                                   CGWindowID window_id, CGWindowImageOption image_option,
+                                                   uint32_t width, uint32_t height);
     
     // Permission handling
     bool CheckScreenRecordingPermission();
@@ -14,6 +14,13 @@
 namespace WebPScreenshot {
 namespace macOS {
 
+namespace {
+
+// How long a capture waits for a newly started stream's first frame
+constexpr uint32_t kFirstFrameTimeoutMs = 500;
+
+} // anonymous namespace
+
 // MacOSScreenshotCapture implementation
 MacOSScreenshotCapture::MacOSScreenshotCapture() : initialized_(false) {
     Initialize();
@@ -76,6 +83,14 @@ ScreenshotResult MacOSScreenshotCapture::CaptureDisplay(uint32_t display_index)
         }
     }
     
+    // A running SCStream turns the capture into a buffer handoff
+    SurfaceFrame frame;
+    if (AcquireSurfaceFrame(display_index, frame, kFirstFrameTimeoutMs)) {
+        result = SurfaceFrameToScreenshotResult(frame);
+        ReleaseSurfaceFrame(frame);
+        return result;
+    }
+    
     try {
         return CaptureWithCGWindowListCreateImage(display_handles_[display_index].display_id);
     } catch (const std::exception& e) {
@@ -84,16 +99,104 @@ ScreenshotResult MacOSScreenshotCapture::CaptureDisplay(uint32_t display_index)
     }
 }
 
+ScreenshotResult MacOSScreenshotCapture::CaptureDisplay(uint32_t display_index, const CaptureRegion& region) {
+    if (region.IsFullFrame()) {
+        return CaptureDisplay(display_index);
+    }
+    if (!initialized_) Initialize();
+
+    ScreenshotResult result;
+
+    if (Utils::IsMacOS10_14OrLater() && !CheckScreenRecordingPermission()) {
+        result.error_message = "Screen recording permission required (macOS 10.14+)";
+        return result;
+    }
+
+    if (region.window_id != 0) {
+        try {
+            return CaptureWindowRegion(static_cast<CGWindowID>(region.window_id), region);
+        } catch (const std::exception& e) {
+            result.error_message = std::string("macOS window capture failed: ") + e.what();
+            return result;
+        }
+    }
+
+    if (display_index >= display_handles_.size()) {
+        result.error_message = "Display index out of range";
+        return result;
+    }
+
+    const auto& handle = display_handles_[display_index];
+    DirtyRect rect;
+    if (!WebPScreenshot::Utils::ClipCaptureRegion(region, handle.info.width, handle.info.height, rect,
+                                                  result.error_message)) {
+        return result;
+    }
+
+    SurfaceFrame frame;
+    if (AcquireSurfaceFrame(display_index, frame, kFirstFrameTimeoutMs)) {
+        const bool fits = rect.x + rect.width <= frame.width && rect.y + rect.height <= frame.height;
+        if (fits) {
+            result = SurfaceFrameToScreenshotResult(frame, &rect);
+        }
+        ReleaseSurfaceFrame(frame);
+        if (fits) {
+            return result;
+        }
+    }
+
+    try {
+        const CGFloat scale = std::max(handle.info.scale_factor, 1.0f);
+        const CGRect display_bounds = CGDisplayBounds(handle.display_id);
+        const CGRect bounds = CGRectMake(display_bounds.origin.x + rect.x / scale,
+                                         display_bounds.origin.y + rect.y / scale,
+                                         rect.width / scale, rect.height / scale);
+        return CaptureBoundsWithCGWindowList(bounds, kCGWindowListOptionOnScreenOnly, kCGNullWindowID,
+                                             kCGWindowImageDefault, rect.width, rect.height);
+    } catch (const std::exception& e) {
+        result.error_message = std::string("macOS screenshot capture failed: ") + e.what();
+        return result;
+    }
+}
+
 std::vector<ScreenshotResult> MacOSScreenshotCapture::CaptureAllDisplays() {
     if (!initialized_) Initialize();
     
-    std::vector<ScreenshotResult> results;
-    
-    for (uint32_t i = 0; i < display_handles_.size(); ++i) {
-        results.push_back(CaptureDisplay(i));
+    // Each instance keeps its own ScreenCaptureKit streams
+    return CaptureAllDisplaysConcurrently([] { return std::make_unique<MacOSScreenshotCapture>(); });
+}
+
+bool MacOSScreenshotCapture::CaptureDisplayInto(uint32_t display_index, uint8_t* buffer,
+                                                size_t capacity, FrameDescriptor& frame) {
+    SurfaceFrame surface;
+    if (!AcquireSurfaceFrame(display_index, surface, kFirstFrameTimeoutMs)) {
+        return ScreenshotCapture::CaptureDisplayInto(display_index, buffer, capacity, frame);
     }
-    
-    return results;
+
+    const uint32_t row_size = surface.width * 4;
+    frame.required_size = static_cast<size_t>(row_size) * surface.height;
+    if (!buffer || capacity < frame.required_size) {
+        ReleaseSurfaceFrame(surface);
+        frame.error_message = "Frame buffer too small";
+        return false;
+    }
+
+    Stats::ScopedStageTimer convert_timer(Stats::Stage::Convert);
+    Stats::AddBytesCopied(frame.required_size);
+    for (uint32_t row = 0; row < surface.height; ++row) {
+        SIMD::ConvertBGRAToRGBA(surface.data + static_cast<size_t>(row) * surface.stride,
+                                buffer + static_cast<size_t>(row) * row_size, surface.width);
+    }
+    convert_timer.Stop();
+
+    frame.width = surface.width;
+    frame.height = surface.height;
+    frame.stride = row_size;
+    frame.bytes_per_pixel = 4;
+    frame.has_dirty_rects = true;
+    frame.dirty_rects = std::move(surface.dirty_rects);
+    ReleaseSurfaceFrame(surface);
+    return true;
 }
 
 bool MacOSScreenshotCapture::IsSupported() {
@@ -101,9 +204,124 @@ bool MacOSScreenshotCapture::IsSupported() {
 }
 
 std::string MacOSScreenshotCapture::GetImplementationName() {
+    if (ScreenCaptureKitSession::IsAvailable() && !stream_unavailable_) {
+        return "ScreenCaptureKit";
+    }
     return "CGWindowListCreateImage";
 }
 
+ScreenCaptureKitSession* MacOSScreenshotCapture::GetStreamSession(uint32_t display_index) {
+    if (!initialized_) Initialize();
+
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    if (stream_unavailable_ || display_index >= display_handles_.size() ||
+        !ScreenCaptureKitSession::IsAvailable()) {
+        return nullptr;
+    }
+
+    if (stream_sessions_.size() < display_handles_.size()) {
+        stream_sessions_.resize(display_handles_.size());
+    }
+
+    // The system stops streams on display reconfiguration or permission
+    // changes; start a fresh one. Frames already handed out keep their surface.
+    auto& session = stream_sessions_[display_index];
+    if (session && !session->IsRunning()) {
+        session.reset();
+    }
+
+    if (!session) {
+        const auto& handle = display_handles_[display_index];
+        auto created = std::make_unique<ScreenCaptureKitSession>(
+            handle.display_id, handle.info.width, handle.info.height);
+        if (!created->Start(last_error_)) {
+            stream_unavailable_ = true;
+            return nullptr;
+        }
+        session = std::move(created);
+    }
+
+    return session.get();
+}
+
+bool MacOSScreenshotCapture::AcquireSurfaceFrame(uint32_t display_index, SurfaceFrame& frame,
+                                                 uint32_t timeout_ms) {
+    ScreenCaptureKitSession* session = GetStreamSession(display_index);
+    return session && session->Acquire(frame, timeout_ms);
+}
+
+void MacOSScreenshotCapture::ReleaseSurfaceFrame(SurfaceFrame& frame) {
+    ScreenCaptureKitSession::Release(frame);
+}
+
+std::vector<uint8_t> MacOSScreenshotCapture::EncodeDisplay(uint32_t display_index,
+                                                           const WebPEncodeParams& params,
+                                                           bool* changed) {
+    WebPEncoder encoder;
+    std::vector<uint8_t> encoded;
+
+    SurfaceFrame frame;
+    if (AcquireSurfaceFrame(display_index, frame, kFirstFrameTimeoutMs)) {
+        if (changed) {
+            *changed = frame.changed;
+        }
+        if (frame.changed || !changed) {
+            // SCK frames are opaque, so skip the alpha plane as for BGRX
+            encoded = encoder.EncodeBGRA(frame.data, frame.width, frame.height, frame.stride,
+                                         params, false);
+            if (encoded.empty()) {
+                last_error_ = encoder.GetLastError();
+            }
+        }
+        ReleaseSurfaceFrame(frame);
+        return encoded;
+    }
+
+    ScreenshotResult result = CaptureDisplay(display_index);
+    if (!result.success) {
+        last_error_ = result.error_message;
+        return encoded;
+    }
+    if (changed) {
+        *changed = true;
+    }
+
+    encoded = encoder.EncodeRGBA(result.data.get(), result.width, result.height, result.stride, params);
+    if (encoded.empty()) {
+        last_error_ = encoder.GetLastError();
+    }
+    return encoded;
+}
+
+ScreenshotResult MacOSScreenshotCapture::SurfaceFrameToScreenshotResult(const SurfaceFrame& frame,
+                                                                        const DirtyRect* rect) {
+    ScreenshotResult result;
+
+    const DirtyRect area = rect ? *rect : DirtyRect{0, 0, frame.width, frame.height};
+    const uint32_t stride = area.width * 4;
+    const size_t data_size = static_cast<size_t>(stride) * area.height;
+    result.data = Utils::AllocateScreenshotBuffer(data_size);
+
+    Stats::ScopedStageTimer convert_timer(Stats::Stage::Convert);
+    Stats::AddBytesCopied(data_size);
+    const uint8_t* src = frame.data + static_cast<size_t>(area.y) * frame.stride + static_cast<size_t>(area.x) * 4;
+    for (uint32_t row = 0; row < area.height; ++row) {
+        SIMD::ConvertBGRAToRGBA(src + static_cast<size_t>(row) * frame.stride,
+                                result.data.get() + static_cast<size_t>(row) * stride, area.width);
+    }
+    convert_timer.Stop();
+
+    result.width = area.width;
+    result.height = area.height;
+    result.stride = stride;
+    result.bytes_per_pixel = 4;
+    result.data_size = static_cast<uint32_t>(data_size);
+    result.format = "RGBA";
+    result.implementation = "ScreenCaptureKit";
+    result.success = true;
+    return result;
+}
+
 bool MacOSScreenshotCapture::CheckScreenRecordingPermission() {
     if (!Utils::IsMacOS10_14OrLater()) {
         return true; // No permission required on older macOS
@@ -164,6 +382,82 @@ ScreenshotResult MacOSScreenshotCapture::CaptureWithCGWindowListCreateImage(CGDi
     return result;
 }
 
+ScreenshotResult MacOSScreenshotCapture::CaptureWindowRegion(CGWindowID window_id, const CaptureRegion& region) {
+    ScreenshotResult result;
+
+    @autoreleasepool {
+        // Window bounds in global points
+        const void* window_value = reinterpret_cast<const void*>(static_cast<uintptr_t>(window_id));
+        CFArrayRef window_ids = CFArrayCreate(kCFAllocatorDefault, &window_value, 1, nullptr);
+        CFArrayRef descriptions = CGWindowListCreateDescriptionFromArray(window_ids);
+        CFRelease(window_ids);
+
+        CGRect window_bounds = CGRectZero;
+        bool found = false;
+        if (descriptions && CFArrayGetCount(descriptions) > 0) {
+            auto description = static_cast<CFDictionaryRef>(CFArrayGetValueAtIndex(descriptions, 0));
+            auto bounds_dict = static_cast<CFDictionaryRef>(CFDictionaryGetValue(description, kCGWindowBounds));
+            found = bounds_dict && CGRectMakeWithDictionaryRepresentation(bounds_dict, &window_bounds);
+        }
+        if (descriptions) {
+            CFRelease(descriptions);
+        }
+        if (!found || CGRectIsEmpty(window_bounds)) {
+            result.error_message = "Window not found";
+            return result;
+        }
+
+        // Region is in pixels of the display the window sits on
+        CGDirectDisplayID display_id = CGMainDisplayID();
+        uint32_t display_count = 0;
+        CGGetDisplaysWithPoint(window_bounds.origin, 1, &display_id, &display_count);
+        const CGFloat scale = std::max(GetDisplayScaleFactor(display_id), 1.0f);
+
+        DirtyRect rect;
+        if (!WebPScreenshot::Utils::ClipCaptureRegion(
+                region, static_cast<uint32_t>(window_bounds.size.width * scale),
+                static_cast<uint32_t>(window_bounds.size.height * scale), rect, result.error_message)) {
+            return result;
+        }
+
+        const CGRect bounds = CGRectMake(window_bounds.origin.x + rect.x / scale,
+                                         window_bounds.origin.y + rect.y / scale,
+                                         rect.width / scale, rect.height / scale);
+        result = CaptureBoundsWithCGWindowList(bounds, kCGWindowListOptionIncludingWindow, window_id,
+                                               kCGWindowImageBoundsIgnoreFraming, rect.width, rect.height);
+    }
+
+    return result;
+}
+
+ScreenshotResult MacOSScreenshotCapture::CaptureBoundsWithCGWindowList(CGRect bounds, CGWindowListOption option,
+                                                                       CGWindowID window_id,
+                                                                       CGWindowImageOption image_option,
+                                                                       uint32_t width, uint32_t height) {
+    ScreenshotResult result;
+
+    @autoreleasepool {
+        Stats::ScopedStageTimer capture_timer(Stats::Stage::Capture);
+        CGImageRef image = CGWindowListCreateImage(bounds, option, window_id, image_option);
+        if (!image) {
+            capture_timer.Cancel();
+            result.error_message = "Failed to create CGImage for capture region";
+            return result;
+        }
+        capture_timer.Stop();
+
+        // Takes ownership of the image
+        result = CGImageToScreenshotResult(image);
+    }
+
+    // Fractional point bounds can round up by a pixel
+    if (result.success && (result.width > width || result.height > height)) {
+        result = WebPScreenshot::Utils::CropScreenshotResult(
+            result, {0, 0, std::min(width, result.width), std::min(height, result.height)});
+    }
+    return result;
+}
+
 ScreenshotResult MacOSScreenshotCapture::CaptureWithCoreGraphics(CGDirectDisplayID display_id) {
     ScreenshotResult result;
     
@@ -236,7 +530,7 @@ ScreenshotResult MacOSScreenshotCapture::CGImageToScreenshotResult(CGImageRef im
         size_t data_size = static_cast<size_t>(height) * stride;
         
         // Allocate result buffer and copy data
-        result.data = std::make_unique<uint8_t[]>(data_size);
+        result.data = Utils::AllocateScreenshotBuffer(data_size);
         std::memcpy(result.data.get(), bitmap_data, data_size);
         
         // Set result properties
@@ -1,198 +1,407 @@
 #include "common/screenshot_common.h"
 #include <algorithm>
-#include <chrono>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
 
 namespace WebPScreenshot {
 
-ScreenshotMemoryPool::ScreenshotMemoryPool() {
-    stats_.available_buffers = 0;
-    stats_.total_buffers_created = 0;
-    stats_.total_memory_allocated = 0;
-    stats_.peak_memory_usage = 0;
-    stats_.memory_reuse_count = 0;
+namespace {
+
+constexpr size_t kBlockAlignment = 64;          // Cache line; also satisfies AVX-512 loads
+constexpr size_t kHugePageSize = 2ull << 20;
+constexpr size_t kOversizeGranularity = 4096;
+constexpr size_t kPageSize = 4096;
+
+constexpr size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
 }
 
-ScreenshotMemoryPool::~ScreenshotMemoryPool() {
-    Clear();
+constexpr size_t FrameBytes(size_t width, size_t height) {
+    return AlignUp(width * height * 4, kBlockAlignment);
+}
+
+// Small power-of-two classes for tiles and scratch, then one class per common
+// RGBA frame size so a full-screen capture never rounds up to the next display
+constexpr std::array<size_t, 16> kSizeClasses = {
+    4ull << 10, 16ull << 10, 64ull << 10, 256ull << 10, 1ull << 20,
+    FrameBytes(1280, 720),
+    FrameBytes(1366, 768),
+    FrameBytes(1600, 900),
+    FrameBytes(1920, 1080),
+    FrameBytes(1920, 1200),
+    FrameBytes(2560, 1440),
+    FrameBytes(2560, 1600),
+    FrameBytes(3440, 1440),
+    FrameBytes(3840, 2160),
+    FrameBytes(5120, 2880),
+    FrameBytes(7680, 4320),
+};
+constexpr size_t kNumSizeClasses = kSizeClasses.size();
+constexpr size_t kOversizeClass = kNumSizeClasses;
+
+size_t SizeClassFor(size_t size) {
+    auto it = std::lower_bound(kSizeClasses.begin(), kSizeClasses.end(), size);
+    return it == kSizeClasses.end() ? kOversizeClass : static_cast<size_t>(it - kSizeClasses.begin());
+}
+
+size_t ClassIndexForCapacity(size_t capacity) {
+    size_t index = SizeClassFor(capacity);
+    return (index != kOversizeClass && kSizeClasses[index] == capacity) ? index : kOversizeClass;
+}
+
+// Uninitialized, aligned allocation. Caller-visible memory is never zeroed:
+// every consumer overwrites whole frames.
+// Blocks that will be bound to a node start on a page, as mbind requires.
+uint8_t* AllocateBlock(size_t capacity, bool huge_pages, bool page_aligned) {
+    const size_t alignment = (huge_pages && capacity >= kHugePageSize) ? kHugePageSize
+                             : page_aligned ? kPageSize : kBlockAlignment;
+#ifdef _WIN32
+    return static_cast<uint8_t*>(_aligned_malloc(capacity, alignment));
+#else
+    void* block = nullptr;
+    if (posix_memalign(&block, alignment, capacity) != 0) {
+        return nullptr;
+    }
+#ifdef MADV_HUGEPAGE
+    if (alignment == kHugePageSize) {
+        madvise(block, capacity, MADV_HUGEPAGE);  // Hint only; failure is harmless
+    }
+#endif
+    return static_cast<uint8_t*>(block);
+#endif
+}
+
+void FreeBlock(uint8_t* block) {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    std::free(block);
+#endif
+}
+
+void UpdatePeak(std::atomic<size_t>& peak, size_t value) {
+    size_t current = peak.load(std::memory_order_relaxed);
+    while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
 }
 
-std::unique_ptr<uint8_t[]> ScreenshotMemoryPool::GetBuffer(size_t size) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    // Clean up expired buffers periodically
-    CleanupExpiredBuffers();
-    
-    // Try to find a suitable buffer in the pool
-    size_t best_fit_index = FindBestFitBuffer(size);
-    
-    if (best_fit_index != SIZE_MAX) {
-        // Reuse existing buffer
-        auto buffer = std::move(available_buffers_[best_fit_index].buffer);
-        available_buffers_.erase(available_buffers_.begin() + best_fit_index);
-        
-        stats_.available_buffers = available_buffers_.size();
-        stats_.memory_reuse_count++;
-        
-        return buffer;
-    }
-    
-    // No suitable buffer found, allocate new one
-    auto buffer = std::make_unique<uint8_t[]>(size);
-    
-    if (buffer) {
-        stats_.total_buffers_created++;
-        stats_.total_memory_allocated += size;
-        
-        // Update peak memory usage
-        size_t current_memory = stats_.total_memory_allocated;
-        for (const auto& buf_info : available_buffers_) {
-            current_memory += buf_info.size;
+} // anonymous namespace
+
+struct ScreenshotMemoryPool::Impl {
+    // One lock per size class, so captures of different resolutions and
+    // small tile scratch buffers never contend with each other
+    struct SizeClassList {
+        std::mutex mutex;
+        std::vector<uint8_t*> blocks;
+    };
+
+    using NodeLists = std::array<SizeClassList, kNumSizeClasses>;
+
+    // Only nodes[0] is used unless numa_local is set
+    uint32_t node_count = std::max(1u, ThreadPlacement::GetNumaNodeCount());
+    std::unique_ptr<NodeLists[]> nodes{new NodeLists[node_count]};
+    bool thread_caching = false;  // Only the global pool, which is never destroyed
+
+    std::atomic<size_t> max_cached_bytes{Config().max_cached_bytes};
+    std::atomic<size_t> max_thread_cache_bytes{Config().max_thread_cache_bytes};
+    std::atomic<uint32_t> thread_cache_blocks{Config().thread_cache_blocks};
+    std::atomic<bool> use_huge_pages{Config().use_huge_pages};
+    std::atomic<bool> numa_local{Config().numa_local};
+
+    // Shared-list occupancy (thread caches are accounted separately below)
+    std::atomic<size_t> shared_cached_bytes{0};
+
+    std::atomic<size_t> allocated_bytes{0};
+    std::atomic<size_t> peak_bytes{0};
+    std::atomic<size_t> cached_bytes{0};
+    std::atomic<size_t> cached_blocks{0};
+    std::atomic<size_t> buffers_created{0};
+    std::atomic<size_t> reuse_count{0};
+    std::atomic<size_t> thread_cache_hits{0};
+    std::atomic<size_t> oversize_allocations{0};
+
+    bool NumaLocal() const { return node_count > 1 && numa_local.load(std::memory_order_relaxed); }
+    uint32_t ClampNode(int32_t node) const {
+        return node >= 0 && static_cast<uint32_t>(node) < node_count ? static_cast<uint32_t>(node) : 0;
+    }
+    // Free-list node for the calling thread and for a block
+    uint32_t LocalNode() const { return NumaLocal() ? ClampNode(ThreadPlacement::GetCurrentNumaNode()) : 0; }
+    uint32_t BlockNode(const uint8_t* block) const {
+        return NumaLocal() ? ClampNode(ThreadPlacement::GetMemoryNode(block)) : 0;
+    }
+
+    uint8_t* TakeShared(size_t index, uint32_t node);
+    void PutShared(uint8_t* block, size_t index, uint32_t node);
+    void FreeToSystem(uint8_t* block, size_t capacity);
+    void TrimShared(size_t limit);
+
+    // Per-thread blocks for the global pool. Flushed to the shared lists when the
+    // thread exits.
+    struct ThreadCache {
+        std::array<std::vector<uint8_t*>, kNumSizeClasses> blocks;
+        size_t bytes = 0;
+        Impl* owner = nullptr;
+
+        uint8_t* Take(size_t index) {
+            auto& list = blocks[index];
+            if (list.empty()) {
+                return nullptr;
+            }
+            uint8_t* block = list.back();
+            list.pop_back();
+            bytes -= kSizeClasses[index];
+            return block;
+        }
+
+        bool Put(uint8_t* block, size_t index, uint32_t max_blocks, size_t max_bytes) {
+            auto& list = blocks[index];
+            if (list.size() >= max_blocks || bytes + kSizeClasses[index] > max_bytes) {
+                return false;
+            }
+            list.push_back(block);
+            bytes += kSizeClasses[index];
+            return true;
         }
-        
-        if (current_memory > stats_.peak_memory_usage) {
-            stats_.peak_memory_usage = current_memory;
+
+        void Flush() {
+            if (!owner) {
+                return;
+            }
+            for (size_t index = 0; index < kNumSizeClasses; ++index) {
+                for (uint8_t* block : blocks[index]) {
+                    owner->cached_bytes.fetch_sub(kSizeClasses[index], std::memory_order_relaxed);
+                    owner->cached_blocks.fetch_sub(1, std::memory_order_relaxed);
+                    owner->PutShared(block, index, owner->BlockNode(block));
+                }
+                blocks[index].clear();
+            }
+            bytes = 0;
         }
+
+        ~ThreadCache() { Flush(); }
+    };
+
+    static thread_local ThreadCache t_cache;
+};
+
+thread_local ScreenshotMemoryPool::Impl::ThreadCache ScreenshotMemoryPool::Impl::t_cache;
+
+uint8_t* ScreenshotMemoryPool::Impl::TakeShared(size_t index, uint32_t node) {
+    auto& list = nodes[node][index];
+    std::lock_guard<std::mutex> lock(list.mutex);
+    if (list.blocks.empty()) {
+        return nullptr;
     }
-    
-    return buffer;
+    uint8_t* block = list.blocks.back();
+    list.blocks.pop_back();
+    shared_cached_bytes.fetch_sub(kSizeClasses[index], std::memory_order_relaxed);
+    return block;
 }
 
-void ScreenshotMemoryPool::ReturnBuffer(std::unique_ptr<uint8_t[]> buffer, size_t size) {
-    if (!buffer) {
-        return;
-    }
-    
-    std::lock_guard<std::mutex> lock(mutex_);
-    
-    // Don't keep too many buffers in the pool
-    if (available_buffers_.size() >= MAX_POOL_SIZE) {
-        // Remove the oldest buffer to make room
-        auto oldest_it = std::min_element(available_buffers_.begin(), available_buffers_.end(),
-            [](const BufferInfo& a, const BufferInfo& b) {
-                return a.last_used_time < b.last_used_time;
-            });
-        
-        if (oldest_it != available_buffers_.end()) {
-            available_buffers_.erase(oldest_it);
+// Cache a block on its shared list, or free it if that would exceed the byte limit
+void ScreenshotMemoryPool::Impl::PutShared(uint8_t* block, size_t index, uint32_t node) {
+    const size_t capacity = kSizeClasses[index];
+    {
+        auto& list = nodes[node][index];
+        std::lock_guard<std::mutex> lock(list.mutex);
+        if (shared_cached_bytes.load(std::memory_order_relaxed) + capacity <=
+            max_cached_bytes.load(std::memory_order_relaxed)) {
+            list.blocks.push_back(block);
+            shared_cached_bytes.fetch_add(capacity, std::memory_order_relaxed);
+            cached_bytes.fetch_add(capacity, std::memory_order_relaxed);
+            cached_blocks.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
     }
-    
-    // Add buffer to pool
-    uint64_t current_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now().time_since_epoch()).count();
-    
-    BufferInfo buf_info(std::move(buffer), size);
-    buf_info.last_used_time = current_time;
-    
-    available_buffers_.emplace_back(std::move(buf_info));
-    stats_.available_buffers = available_buffers_.size();
+    FreeToSystem(block, capacity);
 }
 
-void ScreenshotMemoryPool::Clear() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    available_buffers_.clear();
-    stats_.available_buffers = 0;
+void ScreenshotMemoryPool::Impl::FreeToSystem(uint8_t* block, size_t capacity) {
+    FreeBlock(block);
+    allocated_bytes.fetch_sub(capacity, std::memory_order_relaxed);
 }
 
-ScreenshotMemoryPool::PoolStats ScreenshotMemoryPool::GetStats() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return stats_;
-}
-
-void ScreenshotMemoryPool::CleanupExpiredBuffers() {
-    uint64_t current_time = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::steady_clock::now().time_since_epoch()).count();
-    
-    auto it = std::remove_if(available_buffers_.begin(), available_buffers_.end(),
-        [current_time](const BufferInfo& buf_info) {
-            return (current_time - buf_info.last_used_time) > BUFFER_TIMEOUT_MS;
-        });
-    
-    available_buffers_.erase(it, available_buffers_.end());
-    stats_.available_buffers = available_buffers_.size();
-}
-
-size_t ScreenshotMemoryPool::FindBestFitBuffer(size_t required_size) const {
-    size_t best_fit_index = SIZE_MAX;
-    size_t best_fit_size = SIZE_MAX;
-    
-    for (size_t i = 0; i < available_buffers_.size(); ++i) {
-        const auto& buf_info = available_buffers_[i];
-        
-        // Buffer must be large enough
-        if (buf_info.size >= required_size) {
-            // Find the smallest buffer that fits (best fit strategy)
-            if (buf_info.size < best_fit_size) {
-                best_fit_index = i;
-                best_fit_size = buf_info.size;
-                
-                // Perfect fit
-                if (buf_info.size == required_size) {
-                    break;
-                }
+// Free cached blocks, largest classes first, until the shared lists fit in limit
+void ScreenshotMemoryPool::Impl::TrimShared(size_t limit) {
+    for (size_t index = kNumSizeClasses; index-- > 0 &&
+         shared_cached_bytes.load(std::memory_order_relaxed) > limit;) {
+        for (uint32_t node = 0; node < node_count; ++node) {
+            auto& list = nodes[node][index];
+            std::lock_guard<std::mutex> lock(list.mutex);
+            while (!list.blocks.empty() && shared_cached_bytes.load(std::memory_order_relaxed) > limit) {
+                FreeToSystem(list.blocks.back(), kSizeClasses[index]);
+                list.blocks.pop_back();
+                shared_cached_bytes.fetch_sub(kSizeClasses[index], std::memory_order_relaxed);
+                cached_bytes.fetch_sub(kSizeClasses[index], std::memory_order_relaxed);
+                cached_blocks.fetch_sub(1, std::memory_order_relaxed);
             }
         }
     }
-    
-    return best_fit_index;
 }
 
-// Global memory pool instance
-static ScreenshotMemoryPool g_memory_pool;
+void PoolBufferDeleter::operator()(uint8_t* block) const {
+    if (pool) {
+        pool->Release(block, capacity);
+    } else {
+        FreeBlock(block);
+    }
+}
+
+ScreenshotMemoryPool::ScreenshotMemoryPool() : impl_(std::make_unique<Impl>()) {}
 
-ScreenshotMemoryPool* GetGlobalMemoryPool() {
-    return &g_memory_pool;
-}
-
-// Helper RAII class for automatic buffer return to pool
-class PooledBuffer {
-public:
-    PooledBuffer(std::unique_ptr<uint8_t[]> buffer, size_t size)
-        : buffer_(std::move(buffer)), size_(size) {}
-    
-    ~PooledBuffer() {
-        if (buffer_) {
-            GetGlobalMemoryPool()->ReturnBuffer(std::move(buffer_), size_);
+ScreenshotMemoryPool::~ScreenshotMemoryPool() {
+    Clear();
+}
+
+PoolBuffer ScreenshotMemoryPool::GetBuffer(size_t size) {
+    const size_t index = SizeClassFor(size);
+    const uint32_t node = impl_->LocalNode();
+
+    if (index != kOversizeClass) {
+        uint8_t* block = nullptr;
+        if (impl_->thread_caching && (block = Impl::t_cache.Take(index)) != nullptr) {
+            impl_->thread_cache_hits.fetch_add(1, std::memory_order_relaxed);
+            impl_->cached_bytes.fetch_sub(kSizeClasses[index], std::memory_order_relaxed);
+            impl_->cached_blocks.fetch_sub(1, std::memory_order_relaxed);
+        } else if ((block = impl_->TakeShared(index, node)) != nullptr) {
+            impl_->cached_bytes.fetch_sub(kSizeClasses[index], std::memory_order_relaxed);
+            impl_->cached_blocks.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        if (block) {
+            impl_->reuse_count.fetch_add(1, std::memory_order_relaxed);
+            return PoolBuffer(block, PoolBufferDeleter{this, kSizeClasses[index]});
         }
     }
-    
-    uint8_t* get() const { return buffer_.get(); }
-    uint8_t* release() { size_ = 0; return buffer_.release(); }
-    
-    // Move-only type
-    PooledBuffer(const PooledBuffer&) = delete;
-    PooledBuffer& operator=(const PooledBuffer&) = delete;
-    
-    PooledBuffer(PooledBuffer&& other) noexcept
-        : buffer_(std::move(other.buffer_)), size_(other.size_) {
-        other.size_ = 0;
-    }
-    
-    PooledBuffer& operator=(PooledBuffer&& other) noexcept {
-        if (this != &other) {
-            if (buffer_) {
-                GetGlobalMemoryPool()->ReturnBuffer(std::move(buffer_), size_);
-            }
-            buffer_ = std::move(other.buffer_);
-            size_ = other.size_;
-            other.size_ = 0;
+
+    // Nothing cached: allocate a fresh block of the full class size
+    const size_t capacity = index != kOversizeClass ? kSizeClasses[index]
+                                                    : AlignUp(std::max<size_t>(size, 1), kOversizeGranularity);
+    const bool numa_local = impl_->NumaLocal();
+    uint8_t* block = AllocateBlock(capacity, impl_->use_huge_pages.load(std::memory_order_relaxed), numa_local);
+    if (!block) {
+        return PoolBuffer();
+    }
+    if (numa_local) {
+        // The allocator may hand back pages another node faulted in; move them
+        ThreadPlacement::BindMemory(block, capacity, static_cast<int32_t>(node));
+    }
+
+    impl_->buffers_created.fetch_add(1, std::memory_order_relaxed);
+    Stats::AddAllocation(capacity);
+    if (index == kOversizeClass) {
+        impl_->oversize_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    const size_t allocated = impl_->allocated_bytes.fetch_add(capacity, std::memory_order_relaxed) + capacity;
+    UpdatePeak(impl_->peak_bytes, allocated);
+
+    return PoolBuffer(block, PoolBufferDeleter{this, capacity});
+}
+
+void ScreenshotMemoryPool::ReturnBuffer(PoolBuffer buffer, size_t /*size*/) {
+    // The deleter knows the block's real capacity; the size hint is kept for
+    // source compatibility with callers of the old API
+    buffer.reset();
+}
+
+void ScreenshotMemoryPool::Release(uint8_t* block, size_t capacity) {
+    if (!block) {
+        return;
+    }
+
+    const size_t index = ClassIndexForCapacity(capacity);
+    if (index == kOversizeClass) {
+        // Oversize blocks are rare and huge; hand them straight back
+        impl_->FreeToSystem(block, capacity);
+        return;
+    }
+
+    // Thread caches only hold blocks of their thread's node; others go home
+    const uint32_t node = impl_->BlockNode(block);
+    if (impl_->thread_caching && node == impl_->LocalNode()) {
+        if (!Impl::t_cache.owner) {
+            Impl::t_cache.owner = impl_.get();
+        }
+        if (Impl::t_cache.Put(block, index, impl_->thread_cache_blocks.load(std::memory_order_relaxed),
+                        impl_->max_thread_cache_bytes.load(std::memory_order_relaxed))) {
+            impl_->cached_bytes.fetch_add(capacity, std::memory_order_relaxed);
+            impl_->cached_blocks.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
-        return *this;
     }
-    
-private:
-    std::unique_ptr<uint8_t[]> buffer_;
-    size_t size_;
-};
+
+    impl_->PutShared(block, index, node);
+}
+
+void ScreenshotMemoryPool::Clear() {
+    if (impl_->thread_caching) {
+        Impl::t_cache.Flush();
+    }
+    impl_->TrimShared(0);
+}
+
+void ScreenshotMemoryPool::Configure(const Config& config) {
+    impl_->max_cached_bytes.store(config.max_cached_bytes, std::memory_order_relaxed);
+    impl_->max_thread_cache_bytes.store(config.max_thread_cache_bytes, std::memory_order_relaxed);
+    impl_->thread_cache_blocks.store(config.thread_cache_blocks, std::memory_order_relaxed);
+    impl_->use_huge_pages.store(config.use_huge_pages, std::memory_order_relaxed);
+    // Blocks cached under the other mode sit on the wrong lists
+    if (impl_->numa_local.exchange(config.numa_local, std::memory_order_relaxed) != config.numa_local) {
+        impl_->TrimShared(0);
+    }
+    impl_->TrimShared(config.max_cached_bytes);
+}
+
+ScreenshotMemoryPool::Config ScreenshotMemoryPool::GetConfig() const {
+    Config config;
+    config.max_cached_bytes = impl_->max_cached_bytes.load(std::memory_order_relaxed);
+    config.max_thread_cache_bytes = impl_->max_thread_cache_bytes.load(std::memory_order_relaxed);
+    config.thread_cache_blocks = impl_->thread_cache_blocks.load(std::memory_order_relaxed);
+    config.use_huge_pages = impl_->use_huge_pages.load(std::memory_order_relaxed);
+    config.numa_local = impl_->numa_local.load(std::memory_order_relaxed);
+    return config;
+}
+
+ScreenshotMemoryPool::PoolStats ScreenshotMemoryPool::GetStats() const {
+    PoolStats stats = {};
+    stats.available_buffers = impl_->cached_blocks.load(std::memory_order_relaxed);
+    stats.total_buffers_created = impl_->buffers_created.load(std::memory_order_relaxed);
+    stats.total_memory_allocated = impl_->allocated_bytes.load(std::memory_order_relaxed);
+    stats.peak_memory_usage = impl_->peak_bytes.load(std::memory_order_relaxed);
+    stats.memory_reuse_count = impl_->reuse_count.load(std::memory_order_relaxed);
+    stats.bytes_cached = impl_->cached_bytes.load(std::memory_order_relaxed);
+    stats.bytes_in_use = stats.total_memory_allocated > stats.bytes_cached
+                             ? stats.total_memory_allocated - stats.bytes_cached : 0;
+    stats.thread_cache_hits = impl_->thread_cache_hits.load(std::memory_order_relaxed);
+    stats.oversize_allocations = impl_->oversize_allocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Global memory pool instance. Intentionally leaked: buffers owned by JS or
+// by other static objects may be released after static destruction begins.
+ScreenshotMemoryPool* GetGlobalMemoryPool() {
+    static ScreenshotMemoryPool* pool = [] {
+        auto* global = new ScreenshotMemoryPool();
+        global->impl_->thread_caching = true;
+        return global;
+    }();
+    return pool;
+}
 
 // Utility functions for memory pool integration
 namespace Utils {
 
-std::unique_ptr<uint8_t[]> AllocateScreenshotBuffer(size_t size) {
+PoolBuffer AllocateScreenshotBuffer(size_t size) {
     return GetGlobalMemoryPool()->GetBuffer(size);
 }
 
-void ReturnScreenshotBuffer(std::unique_ptr<uint8_t[]> buffer, size_t size) {
+void ReturnScreenshotBuffer(PoolBuffer buffer, size_t size) {
     GetGlobalMemoryPool()->ReturnBuffer(std::move(buffer), size);
 }
 
@@ -202,4 +411,4 @@ ScreenshotMemoryPool::PoolStats GetMemoryPoolStats() {
 
 } // namespace Utils
 
-} // namespace WebPScreenshot
\ No newline at end of file
+} // namespace WebPScreenshot
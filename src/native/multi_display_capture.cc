@@ -0,0 +1,305 @@
+#include "common/screenshot_common.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <limits>
+#include <thread>
+
+namespace WebPScreenshot {
+
+namespace {
+
+uint64_t SteadyMicros() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Capture layouts carry no meaningful alpha
+WebPEncoder::PixelLayout LayoutForFormat(const ScreenshotResult& result) {
+    if (result.bytes_per_pixel == 3) {
+        return WebPEncoder::PixelLayout::RGB;
+    }
+    return result.format == "BGRA" ? WebPEncoder::PixelLayout::BGRX : WebPEncoder::PixelLayout::RGBA;
+}
+
+} // anonymous namespace
+
+struct MultiDisplayCapture::Impl {
+    struct Worker {
+        uint32_t display_index = 0;
+        std::thread thread;
+        DisplayInfo info;
+        bool ok = false;
+        std::string error;
+        DisplayFrame frame;
+    };
+
+    ScreenshotCapture::Factory factory;
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // Workers sleep on `start` until the generation moves, then capture at once
+    mutable std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    uint64_t generation = 0;
+    size_t pending = 0;
+    size_t starting = 0;
+    bool stopping = false;
+    bool running = false;
+    uint64_t last_skew_us = 0;
+
+    void WorkerMain(Worker& worker);
+};
+
+void MultiDisplayCapture::Impl::WorkerMain(Worker& worker) {
+    // The backend is created, used and destroyed on this thread, which keeps
+    // thread-affine state (COM apartments, run loops) on one thread
+    std::unique_ptr<ScreenshotCapture> backend = factory();
+    std::vector<DisplayInfo> displays;
+    if (backend) {
+        displays = backend->GetDisplays();
+    }
+
+    uint64_t seen_generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        worker.ok = worker.display_index < displays.size();
+        if (worker.ok) {
+            worker.info = displays[worker.display_index];
+        } else {
+            worker.error = backend ? "Display " + std::to_string(worker.display_index) + " not found"
+                                   : "No screenshot implementation available";
+        }
+        seen_generation = generation;
+        --starting;
+    }
+    done.notify_all();
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            start.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping) break;
+            seen_generation = generation;
+        }
+
+        DisplayFrame frame;
+        frame.info = worker.info;
+        if (worker.ok) {
+            frame.result = backend->CaptureDisplay(worker.display_index);
+        } else {
+            frame.result.error_message = worker.error;
+        }
+        frame.timestamp_us = SteadyMicros();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            worker.frame = std::move(frame);
+            --pending;
+        }
+        done.notify_all();
+    }
+}
+
+MultiDisplayCapture::MultiDisplayCapture(ScreenshotCapture::Factory factory)
+    : impl_(std::make_unique<Impl>()) {
+    impl_->factory = std::move(factory);
+}
+
+MultiDisplayCapture::~MultiDisplayCapture() {
+    Stop();
+}
+
+bool MultiDisplayCapture::Start(const std::vector<uint32_t>& display_indices) {
+    if (IsRunning()) {
+        return true;
+    }
+    last_error_.clear();
+
+    if (!impl_->factory) {
+        last_error_ = "No capture backend factory";
+        return false;
+    }
+
+    std::vector<uint32_t> indices = display_indices;
+    if (indices.empty()) {
+        std::unique_ptr<ScreenshotCapture> probe = impl_->factory();
+        const size_t count = probe ? probe->GetDisplays().size() : 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            indices.push_back(i);
+        }
+    }
+    if (indices.empty()) {
+        last_error_ = "No displays found";
+        return false;
+    }
+
+    impl_->stopping = false;
+    impl_->starting = indices.size();
+    impl_->workers.clear();
+    for (uint32_t index : indices) {
+        auto worker = std::make_unique<Impl::Worker>();
+        worker->display_index = index;
+        impl_->workers.push_back(std::move(worker));
+    }
+    for (auto& worker : impl_->workers) {
+        Impl::Worker* raw = worker.get();
+        worker->thread = std::thread([this, raw] { impl_->WorkerMain(*raw); });
+    }
+
+    // Backends initialise in parallel too
+    std::unique_lock<std::mutex> lock(impl_->mutex);
+    impl_->done.wait(lock, [this] { return impl_->starting == 0; });
+    for (const auto& worker : impl_->workers) {
+        if (!worker->ok) {
+            last_error_ = worker->error;
+            lock.unlock();
+            Stop();
+            return false;
+        }
+    }
+    impl_->running = true;
+    return true;
+}
+
+void MultiDisplayCapture::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->stopping = true;
+        impl_->running = false;
+    }
+    impl_->start.notify_all();
+
+    for (auto& worker : impl_->workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+    impl_->workers.clear();
+}
+
+bool MultiDisplayCapture::IsRunning() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->running;
+}
+
+size_t MultiDisplayCapture::GetDisplayCount() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->running ? impl_->workers.size() : 0;
+}
+
+std::vector<MultiDisplayCapture::DisplayFrame> MultiDisplayCapture::CaptureAll() {
+    std::vector<DisplayFrame> frames;
+    std::unique_lock<std::mutex> lock(impl_->mutex);
+    if (!impl_->running) {
+        last_error_ = "Multi-display capture is not running";
+        return frames;
+    }
+
+    impl_->pending = impl_->workers.size();
+    ++impl_->generation;
+    impl_->start.notify_all();
+    impl_->done.wait(lock, [this] { return impl_->pending == 0; });
+
+    uint64_t first = std::numeric_limits<uint64_t>::max();
+    uint64_t last = 0;
+    frames.reserve(impl_->workers.size());
+    for (auto& worker : impl_->workers) {
+        first = std::min(first, worker->frame.timestamp_us);
+        last = std::max(last, worker->frame.timestamp_us);
+        frames.push_back(std::move(worker->frame));
+    }
+    impl_->last_skew_us = last - first;
+    return frames;
+}
+
+uint64_t MultiDisplayCapture::GetLastCaptureSkewUs() const {
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->last_skew_us;
+}
+
+std::vector<uint8_t> MultiDisplayCapture::EncodeVirtualDesktop(const std::vector<DisplayFrame>& frames,
+                                                               const WebPEncodeParams& params,
+                                                               std::string& error) {
+    if (frames.empty()) {
+        error = "No display frames";
+        return {};
+    }
+
+    // Desktop coordinates are in points where scale_factor > 1 (macOS,
+    // Wayland); the canvas uses the densest display's pixels so no frame has
+    // to be resampled
+    float scale = 1.0f;
+    int32_t min_x = std::numeric_limits<int32_t>::max();
+    int32_t min_y = std::numeric_limits<int32_t>::max();
+    for (const DisplayFrame& frame : frames) {
+        if (!frame.result.success || !frame.result.data) {
+            error = "Display " + std::to_string(frame.info.index) + ": " + frame.result.error_message;
+            return {};
+        }
+        scale = std::max(scale, frame.info.scale_factor);
+        min_x = std::min(min_x, frame.info.x);
+        min_y = std::min(min_y, frame.info.y);
+    }
+
+    std::vector<WebPEncoder::CanvasLayer> layers;
+    uint64_t canvas_width = 0;
+    uint64_t canvas_height = 0;
+    for (const DisplayFrame& frame : frames) {
+        WebPEncoder::CanvasLayer layer;
+        layer.data = frame.result.data.get();
+        layer.width = frame.result.width;
+        layer.height = frame.result.height;
+        layer.stride = frame.result.stride;
+        layer.layout = LayoutForFormat(frame.result);
+        layer.x = static_cast<int32_t>(std::lround(static_cast<double>(frame.info.x - min_x) * scale));
+        layer.y = static_cast<int32_t>(std::lround(static_cast<double>(frame.info.y - min_y) * scale));
+        canvas_width = std::max<uint64_t>(canvas_width, static_cast<uint64_t>(layer.x) + layer.width);
+        canvas_height = std::max<uint64_t>(canvas_height, static_cast<uint64_t>(layer.y) + layer.height);
+        layers.push_back(layer);
+    }
+
+    if (canvas_width > std::numeric_limits<uint32_t>::max() ||
+        canvas_height > std::numeric_limits<uint32_t>::max()) {
+        error = "Virtual desktop too large";
+        return {};
+    }
+
+    WebPEncoder encoder;
+    std::vector<uint8_t> encoded = encoder.EncodeCanvas(layers, static_cast<uint32_t>(canvas_width),
+                                                        static_cast<uint32_t>(canvas_height), params);
+    if (encoded.empty()) {
+        error = encoder.GetLastError();
+    }
+    return encoded;
+}
+
+// Backends are not thread-safe, so parallel capture needs one instance per display
+std::vector<ScreenshotResult> ScreenshotCapture::CaptureAllDisplaysConcurrently(const Factory& factory) {
+    const size_t display_count = GetDisplays().size();
+    std::vector<ScreenshotResult> results;
+    if (display_count == 0) {
+        return results;
+    }
+
+    if (!concurrent_capture_ || concurrent_capture_->GetDisplayCount() != display_count) {
+        concurrent_capture_ = std::make_shared<MultiDisplayCapture>(factory);
+        if (!concurrent_capture_->Start()) {
+            for (size_t i = 0; i < display_count; ++i) {
+                ScreenshotResult failed;
+                failed.error_message = concurrent_capture_->GetLastError();
+                results.push_back(std::move(failed));
+            }
+            concurrent_capture_.reset();
+            return results;
+        }
+    }
+
+    for (auto& frame : concurrent_capture_->CaptureAll()) {
+        results.push_back(std::move(frame.result));
+    }
+    return results;
+}
+
+} // namespace WebPScreenshot
@@ -0,0 +1,383 @@
+#include "common/performance_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace WebPScreenshot {
+namespace Stats {
+
+namespace {
+
+// Log-linear buckets over nanoseconds: values below 16 get their own bucket,
+// then each power of two up to 2^40 ns (about 18 minutes) is split in 16
+constexpr uint32_t kSubBucketBits = 4;
+constexpr uint32_t kSubBuckets = 1u << kSubBucketBits;
+constexpr uint32_t kMaxExponent = 40;
+constexpr uint32_t kBucketCount = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+uint32_t HighestBit(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return static_cast<uint32_t>(index);
+#else
+    return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+}
+
+uint32_t BucketIndex(uint64_t value) {
+    if (value < kSubBuckets) {
+        return static_cast<uint32_t>(value);
+    }
+    const uint32_t exponent = HighestBit(value);
+    if (exponent > kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    const uint32_t sub = static_cast<uint32_t>(value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+// Midpoint of the values that land in a bucket
+double BucketMidpoint(uint32_t index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+    const uint32_t shift = index / kSubBuckets - 1;
+    const uint64_t lower = static_cast<uint64_t>(kSubBuckets + index % kSubBuckets) << shift;
+    return lower + ((1ull << shift) - 1) / 2.0;
+}
+
+// Each block has a single writer, so updates are plain relaxed load/store
+// pairs rather than locked read-modify-writes
+inline void Bump(std::atomic<uint64_t>& value, uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct StageHistogram {
+    std::atomic<uint64_t> buckets[kBucketCount];
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> min_ns;
+    std::atomic<uint64_t> max_ns;
+};
+
+struct alignas(64) ThreadBlock {
+    std::atomic<uint64_t> epoch{0};
+    StageHistogram stages[kStageCount];
+    std::atomic<uint64_t> bytes_copied;
+    std::atomic<uint64_t> allocations;
+    std::atomic<uint64_t> allocated_bytes;
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> tile_cache_hits;
+    std::atomic<uint64_t> tile_cache_misses;
+    std::atomic<uint64_t> frame_cache_hits;
+    std::atomic<uint64_t> frame_cache_misses;
+
+    ThreadBlock() { Clear(); }
+
+    void Clear() {
+        for (auto& stage : stages) {
+            for (auto& bucket : stage.buckets) bucket.store(0, std::memory_order_relaxed);
+            stage.total_ns.store(0, std::memory_order_relaxed);
+            stage.min_ns.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+            stage.max_ns.store(0, std::memory_order_relaxed);
+        }
+        bytes_copied.store(0, std::memory_order_relaxed);
+        allocations.store(0, std::memory_order_relaxed);
+        allocated_bytes.store(0, std::memory_order_relaxed);
+        frames.store(0, std::memory_order_relaxed);
+        tile_cache_hits.store(0, std::memory_order_relaxed);
+        tile_cache_misses.store(0, std::memory_order_relaxed);
+        frame_cache_hits.store(0, std::memory_order_relaxed);
+        frame_cache_misses.store(0, std::memory_order_relaxed);
+    }
+};
+
+// Plain totals merged from every block
+struct Totals {
+    struct Stage {
+        uint64_t buckets[kBucketCount] = {};
+        uint64_t total_ns = 0;
+        uint64_t min_ns = std::numeric_limits<uint64_t>::max();
+        uint64_t max_ns = 0;
+    } stages[kStageCount];
+    uint64_t bytes_copied = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+    uint64_t frames = 0;
+    uint64_t tile_cache_hits = 0;
+    uint64_t tile_cache_misses = 0;
+    uint64_t frame_cache_hits = 0;
+    uint64_t frame_cache_misses = 0;
+
+    void Add(const ThreadBlock& block) {
+        for (uint32_t s = 0; s < kStageCount; ++s) {
+            const auto& source = block.stages[s];
+            auto& target = stages[s];
+            for (uint32_t b = 0; b < kBucketCount; ++b) {
+                target.buckets[b] += source.buckets[b].load(std::memory_order_relaxed);
+            }
+            target.total_ns += source.total_ns.load(std::memory_order_relaxed);
+            target.min_ns = std::min(target.min_ns, source.min_ns.load(std::memory_order_relaxed));
+            target.max_ns = std::max(target.max_ns, source.max_ns.load(std::memory_order_relaxed));
+        }
+        bytes_copied += block.bytes_copied.load(std::memory_order_relaxed);
+        allocations += block.allocations.load(std::memory_order_relaxed);
+        allocated_bytes += block.allocated_bytes.load(std::memory_order_relaxed);
+        frames += block.frames.load(std::memory_order_relaxed);
+        tile_cache_hits += block.tile_cache_hits.load(std::memory_order_relaxed);
+        tile_cache_misses += block.tile_cache_misses.load(std::memory_order_relaxed);
+        frame_cache_hits += block.frame_cache_hits.load(std::memory_order_relaxed);
+        frame_cache_misses += block.frame_cache_misses.load(std::memory_order_relaxed);
+    }
+};
+
+// A Reset bumps the epoch instead of touching other threads' blocks; each
+// writer clears its own block the next time it records
+std::atomic<uint64_t> g_epoch{1};
+std::atomic<bool> g_enabled{true};
+std::atomic<int64_t> g_reset_time_ns{std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count()};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadBlock*> live;
+    ThreadBlock retired;  // Totals of threads that have exited; guarded by mutex
+};
+
+// Leaked on purpose so threads exiting during static destruction can still retire
+Registry& GetRegistry() {
+    static Registry* registry = new Registry();
+    return *registry;
+}
+
+void MergeInto(ThreadBlock& target, const ThreadBlock& source) {
+    auto merged = std::make_unique<Totals>();
+    merged->Add(target);
+    merged->Add(source);
+    const Totals& totals = *merged;
+    for (uint32_t s = 0; s < kStageCount; ++s) {
+        for (uint32_t b = 0; b < kBucketCount; ++b) {
+            target.stages[s].buckets[b].store(totals.stages[s].buckets[b], std::memory_order_relaxed);
+        }
+        target.stages[s].total_ns.store(totals.stages[s].total_ns, std::memory_order_relaxed);
+        target.stages[s].min_ns.store(totals.stages[s].min_ns, std::memory_order_relaxed);
+        target.stages[s].max_ns.store(totals.stages[s].max_ns, std::memory_order_relaxed);
+    }
+    target.bytes_copied.store(totals.bytes_copied, std::memory_order_relaxed);
+    target.allocations.store(totals.allocations, std::memory_order_relaxed);
+    target.allocated_bytes.store(totals.allocated_bytes, std::memory_order_relaxed);
+    target.frames.store(totals.frames, std::memory_order_relaxed);
+    target.tile_cache_hits.store(totals.tile_cache_hits, std::memory_order_relaxed);
+    target.tile_cache_misses.store(totals.tile_cache_misses, std::memory_order_relaxed);
+    target.frame_cache_hits.store(totals.frame_cache_hits, std::memory_order_relaxed);
+    target.frame_cache_misses.store(totals.frame_cache_misses, std::memory_order_relaxed);
+}
+
+class ThreadHandle {
+public:
+    ThreadHandle() : block_(new ThreadBlock()) {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.live.push_back(block_);
+    }
+
+    ~ThreadHandle() {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        const uint64_t epoch = g_epoch.load(std::memory_order_relaxed);
+        if (block_->epoch.load(std::memory_order_relaxed) == epoch) {
+            if (registry.retired.epoch.load(std::memory_order_relaxed) != epoch) {
+                registry.retired.Clear();
+                registry.retired.epoch.store(epoch, std::memory_order_relaxed);
+            }
+            MergeInto(registry.retired, *block_);
+        }
+        registry.live.erase(std::remove(registry.live.begin(), registry.live.end(), block_),
+                            registry.live.end());
+        delete block_;
+    }
+
+    ThreadBlock& Block() { return *block_; }
+
+private:
+    ThreadBlock* block_;
+};
+
+// The calling thread's block, cleared first if a Reset happened since its last write
+ThreadBlock& CurrentBlock() {
+    thread_local ThreadHandle handle;
+    ThreadBlock& block = handle.Block();
+    const uint64_t epoch = g_epoch.load(std::memory_order_acquire);
+    if (block.epoch.load(std::memory_order_relaxed) != epoch) {
+        block.Clear();
+        block.epoch.store(epoch, std::memory_order_release);
+    }
+    return block;
+}
+
+StageSummary Summarize(const Totals::Stage& stage) {
+    StageSummary summary;
+    for (uint64_t count : stage.buckets) summary.count += count;
+    if (summary.count == 0) {
+        return summary;
+    }
+
+    summary.total_ms = stage.total_ns / 1e6;
+    summary.mean_us = stage.total_ns / 1e3 / summary.count;
+    summary.min_us = stage.min_ns / 1e3;
+    summary.max_us = stage.max_ns / 1e3;
+
+    const double quantiles[] = {0.50, 0.90, 0.99, 0.999};
+    double* outputs[] = {&summary.p50_us, &summary.p90_us, &summary.p99_us, &summary.p999_us};
+    for (size_t q = 0; q < 4; ++q) {
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantiles[q] * summary.count)));
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < kBucketCount; ++b) {
+            seen += stage.buckets[b];
+            if (seen >= rank) {
+                const double value = std::clamp(BucketMidpoint(b), static_cast<double>(stage.min_ns),
+                                                static_cast<double>(stage.max_ns));
+                *outputs[q] = value / 1e3;
+                break;
+            }
+        }
+    }
+    return summary;
+}
+
+} // namespace
+
+const char* StageName(Stage stage) {
+    switch (stage) {
+        case Stage::Capture: return "capture";
+        case Stage::Readback: return "readback";
+        case Stage::Convert: return "convert";
+        case Stage::Encode: return "encode";
+        case Stage::Marshal: return "marshal";
+        default: return "unknown";
+    }
+}
+
+void RecordLatency(Stage stage, uint64_t nanoseconds) {
+    if (!g_enabled.load(std::memory_order_relaxed) || stage >= Stage::Count) {
+        return;
+    }
+    StageHistogram& histogram = CurrentBlock().stages[static_cast<uint32_t>(stage)];
+    Bump(histogram.buckets[BucketIndex(nanoseconds)], 1);
+    Bump(histogram.total_ns, nanoseconds);
+    if (nanoseconds < histogram.min_ns.load(std::memory_order_relaxed)) {
+        histogram.min_ns.store(nanoseconds, std::memory_order_relaxed);
+    }
+    if (nanoseconds > histogram.max_ns.load(std::memory_order_relaxed)) {
+        histogram.max_ns.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void AddBytesCopied(uint64_t bytes) {
+    if (g_enabled.load(std::memory_order_relaxed)) {
+        Bump(CurrentBlock().bytes_copied, bytes);
+    }
+}
+
+void AddAllocation(uint64_t bytes) {
+    if (g_enabled.load(std::memory_order_relaxed)) {
+        ThreadBlock& block = CurrentBlock();
+        Bump(block.allocations, 1);
+        Bump(block.allocated_bytes, bytes);
+    }
+}
+
+void AddFrame() {
+    if (g_enabled.load(std::memory_order_relaxed)) {
+        Bump(CurrentBlock().frames, 1);
+    }
+}
+
+void AddTileCacheLookups(uint64_t hits, uint64_t misses) {
+    if (g_enabled.load(std::memory_order_relaxed)) {
+        ThreadBlock& block = CurrentBlock();
+        Bump(block.tile_cache_hits, hits);
+        Bump(block.tile_cache_misses, misses);
+    }
+}
+
+void AddFrameCacheLookup(bool hit) {
+    if (g_enabled.load(std::memory_order_relaxed)) {
+        ThreadBlock& block = CurrentBlock();
+        Bump(hit ? block.frame_cache_hits : block.frame_cache_misses, 1);
+    }
+}
+
+void SetEnabled(bool enabled) {
+    g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsEnabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+Snapshot GetSnapshot() {
+    // Heap-allocated: the bucket arrays are too large for small thread stacks
+    auto totals = std::make_unique<Totals>();
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        const uint64_t epoch = g_epoch.load(std::memory_order_relaxed);
+        for (const ThreadBlock* block : registry.live) {
+            if (block->epoch.load(std::memory_order_acquire) == epoch) {
+                totals->Add(*block);
+            }
+        }
+        if (registry.retired.epoch.load(std::memory_order_relaxed) == epoch) {
+            totals->Add(registry.retired);
+        }
+    }
+
+    Snapshot snapshot;
+    for (uint32_t s = 0; s < kStageCount; ++s) {
+        snapshot.stages[s] = Summarize(totals->stages[s]);
+    }
+    snapshot.frames = totals->frames;
+    snapshot.bytes_copied = totals->bytes_copied;
+    snapshot.allocations = totals->allocations;
+    snapshot.allocated_bytes = totals->allocated_bytes;
+    if (snapshot.frames > 0) {
+        snapshot.bytes_copied_per_frame = static_cast<double>(snapshot.bytes_copied) / snapshot.frames;
+        snapshot.allocations_per_frame = static_cast<double>(snapshot.allocations) / snapshot.frames;
+    }
+
+    snapshot.tile_cache_hits = totals->tile_cache_hits;
+    snapshot.tile_cache_misses = totals->tile_cache_misses;
+    snapshot.frame_cache_hits = totals->frame_cache_hits;
+    snapshot.frame_cache_misses = totals->frame_cache_misses;
+    if (const uint64_t tiles = snapshot.tile_cache_hits + snapshot.tile_cache_misses) {
+        snapshot.tile_cache_hit_rate = static_cast<double>(snapshot.tile_cache_hits) / tiles;
+    }
+    if (const uint64_t frames = snapshot.frame_cache_hits + snapshot.frame_cache_misses) {
+        snapshot.frame_cache_hit_rate = static_cast<double>(snapshot.frame_cache_hits) / frames;
+    }
+
+    const int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    snapshot.elapsed_seconds = (now_ns - g_reset_time_ns.load(std::memory_order_relaxed)) / 1e9;
+    return snapshot;
+}
+
+void Reset() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    g_epoch.fetch_add(1, std::memory_order_acq_rel);
+    g_reset_time_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+}
+
+} // namespace Stats
+} // namespace WebPScreenshot
@@ -1,88 +1,97 @@
 #include <node.h>
 #include <node_buffer.h>
+#include <uv.h>
 #include <v8.h>
 #include <windows.h>
+#include <algorithm>
 #include <iostream>
-#include <immintrin.h> // For AVX2 SIMD
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include "common/screenshot_common.h"
+#include "windows/screenshot.h"
 
 using namespace v8;
+using WebPScreenshot::WebPEncodeParams;
+namespace Stats = WebPScreenshot::Stats;
 
 namespace {
 
-// SIMD-optimized BGRA to RGBA conversion using AVX2
-void ConvertBGRAToRGBA_AVX2(const uint8_t* src, uint8_t* dst, size_t pixelCount) {
-    const size_t simdCount = pixelCount & ~7; // Process 8 pixels at a time
-    
-    // AVX2 shuffle mask for BGRA -> RGBA: [2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15]
-    const __m256i shuffleMask = _mm256_setr_epi8(
-        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
-        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
-    );
-    
-    const __m256i alphaMask = _mm256_set1_epi32(0xFF000000); // Set alpha to 255
-    
-    // Process 8 pixels (32 bytes) per iteration
-    for (size_t i = 0; i < simdCount; i += 8) {
-        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
-        pixels = _mm256_shuffle_epi8(pixels, shuffleMask);
-        pixels = _mm256_or_si256(pixels, alphaMask);
-        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), pixels);
-    }
-    
-    // Handle remaining pixels
-    for (size_t i = simdCount; i < pixelCount; ++i) {
-        size_t offset = i * 4;
-        dst[offset + 0] = src[offset + 2]; // R
-        dst[offset + 1] = src[offset + 1]; // G
-        dst[offset + 2] = src[offset + 0]; // B
-        dst[offset + 3] = 255;             // A
-    }
-}
+// Real Windows screenshot capture using GDI
+// With convertToRGBA = false the native BGRX layout is kept for the encoder,
+// which converts straight to YUV. A region blits only that rectangle of the
+// display, or of the window when region.window_id is an HWND.
+bool CaptureScreenGDI(WebPScreenshot::PoolBuffer& data, int* width, int* height, int displayIndex = 0,
+                      bool convertToRGBA = true, const WebPScreenshot::CaptureRegion& region = {}) {
+    HWND window = reinterpret_cast<HWND>(static_cast<uintptr_t>(region.window_id));
+    HDC screenDC = nullptr;
+    uint32_t sourceWidth = 0;
+    uint32_t sourceHeight = 0;
 
-// Fallback scalar conversion
-void ConvertBGRAToRGBA_Scalar(const uint8_t* src, uint8_t* dst, size_t pixelCount) {
-    for (size_t i = 0; i < pixelCount; ++i) {
-        size_t offset = i * 4;
-        dst[offset + 0] = src[offset + 2]; // R
-        dst[offset + 1] = src[offset + 1]; // G
-        dst[offset + 2] = src[offset + 0]; // B
-        dst[offset + 3] = 255;             // A
+    if (window) {
+        RECT windowRect;
+        if (!IsWindow(window) || !GetWindowRect(window, &windowRect)) {
+            std::cerr << "Invalid window handle" << std::endl;
+            return false;
+        }
+        const LONG windowWidth = windowRect.right - windowRect.left;
+        const LONG windowHeight = windowRect.bottom - windowRect.top;
+        sourceWidth = windowWidth > 0 ? static_cast<uint32_t>(windowWidth) : 0;
+        sourceHeight = windowHeight > 0 ? static_cast<uint32_t>(windowHeight) : 0;
+        screenDC = GetWindowDC(window);
+    } else {
+        // Get display device information
+        DISPLAY_DEVICE displayDevice;
+        displayDevice.cb = sizeof(DISPLAY_DEVICE);
+        
+        if (!EnumDisplayDevices(nullptr, displayIndex, &displayDevice, 0)) {
+            std::cerr << "Failed to enumerate display device " << displayIndex << std::endl;
+            return false;
+        }
+        
+        // Get display settings
+        DEVMODE devMode;
+        devMode.dmSize = sizeof(DEVMODE);
+        
+        if (!EnumDisplaySettings(displayDevice.DeviceName, ENUM_CURRENT_SETTINGS, &devMode)) {
+            std::cerr << "Failed to get display settings" << std::endl;
+            return false;
+        }
+        
+        sourceWidth = devMode.dmPelsWidth;
+        sourceHeight = devMode.dmPelsHeight;
+        screenDC = CreateDC(displayDevice.DeviceName, nullptr, nullptr, nullptr);
     }
-}
 
-// Real Windows screenshot capture using GDI
-bool CaptureScreenGDI(uint8_t** data, int* width, int* height, int displayIndex = 0) {
-    // Get display device information
-    DISPLAY_DEVICE displayDevice;
-    displayDevice.cb = sizeof(DISPLAY_DEVICE);
-    
-    if (!EnumDisplayDevices(nullptr, displayIndex, &displayDevice, 0)) {
-        std::cerr << "Failed to enumerate display device " << displayIndex << std::endl;
-        return false;
-    }
-    
-    // Get display settings
-    DEVMODE devMode;
-    devMode.dmSize = sizeof(DEVMODE);
-    
-    if (!EnumDisplaySettings(displayDevice.DeviceName, ENUM_CURRENT_SETTINGS, &devMode)) {
-        std::cerr << "Failed to get display settings" << std::endl;
-        return false;
-    }
-    
-    int screenWidth = devMode.dmPelsWidth;
-    int screenHeight = devMode.dmPelsHeight;
-    
-    // Create device contexts
-    HDC screenDC = CreateDC(displayDevice.DeviceName, nullptr, nullptr, nullptr);
+    // Window DCs come from GetWindowDC and go back through ReleaseDC
+    auto releaseSourceDC = [&]() {
+        if (window) {
+            ReleaseDC(window, screenDC);
+        } else {
+            DeleteDC(screenDC);
+        }
+    };
+
     if (!screenDC) {
         std::cerr << "Failed to create screen DC" << std::endl;
         return false;
     }
+
+    WebPScreenshot::DirtyRect rect;
+    std::string regionError;
+    if (sourceWidth == 0 || sourceHeight == 0 ||
+        !WebPScreenshot::Utils::ClipCaptureRegion(region, sourceWidth, sourceHeight, rect, regionError)) {
+        releaseSourceDC();
+        std::cerr << (regionError.empty() ? "Empty capture source" : regionError) << std::endl;
+        return false;
+    }
+
+    int screenWidth = static_cast<int>(rect.width);
+    int screenHeight = static_cast<int>(rect.height);
     
     HDC memoryDC = CreateCompatibleDC(screenDC);
     if (!memoryDC) {
-        DeleteDC(screenDC);
+        releaseSourceDC();
         std::cerr << "Failed to create memory DC" << std::endl;
         return false;
     }
@@ -101,7 +110,7 @@ bool CaptureScreenGDI(uint8_t** data, int* width, int* height, int displayIndex
     HBITMAP bitmap = CreateDIBSection(memoryDC, &bmi, DIB_RGB_COLORS, &bitmapData, nullptr, 0);
     if (!bitmap || !bitmapData) {
         DeleteDC(memoryDC);
-        DeleteDC(screenDC);
+        releaseSourceDC();
         std::cerr << "Failed to create DIB section" << std::endl;
         return false;
     }
@@ -111,85 +120,899 @@ bool CaptureScreenGDI(uint8_t** data, int* width, int* height, int displayIndex
     if (!oldBitmap) {
         DeleteObject(bitmap);
         DeleteDC(memoryDC);
-        DeleteDC(screenDC);
+        releaseSourceDC();
         std::cerr << "Failed to select bitmap" << std::endl;
         return false;
     }
     
     // Capture screen to memory DC
+    Stats::ScopedStageTimer captureTimer(Stats::Stage::Capture);
     BOOL result = BitBlt(
         memoryDC, 0, 0, screenWidth, screenHeight,
-        screenDC, 0, 0,
+        screenDC, static_cast<int>(rect.x), static_cast<int>(rect.y),
         SRCCOPY
     );
     
     if (!result) {
+        captureTimer.Cancel();
         SelectObject(memoryDC, oldBitmap);
         DeleteObject(bitmap);
         DeleteDC(memoryDC);
-        DeleteDC(screenDC);
+        releaseSourceDC();
         std::cerr << "BitBlt failed: " << GetLastError() << std::endl;
         return false;
     }
     
-    // Allocate output buffer and convert BGRA to RGBA using SIMD
-    size_t outputSize = screenWidth * screenHeight * 4;
-    uint8_t* outputData = new uint8_t[outputSize];
+    // Allocate output buffer from the pool and convert BGRA to RGBA using SIMD
+    size_t outputSize = static_cast<size_t>(screenWidth) * screenHeight * 4;
+    auto outputData = WebPScreenshot::Utils::AllocateScreenshotBuffer(outputSize);
     
     uint8_t* src = static_cast<uint8_t*>(bitmapData);
     size_t pixelCount = screenWidth * screenHeight;
     
-    // Use SIMD-optimized conversion for significant speedup
-    ConvertBGRAToRGBA_AVX2(src, outputData, pixelCount);
+    // GDI leaves the fourth byte undefined, so alpha is forced opaque
+    captureTimer.Stop();
+    if (convertToRGBA) {
+        Stats::ScopedStageTimer convertTimer(Stats::Stage::Convert);
+        WebPScreenshot::SIMD::ConvertBGRXToRGBA(src, outputData.get(), static_cast<uint32_t>(pixelCount));
+    } else {
+        memcpy(outputData.get(), src, outputSize);
+    }
+    Stats::AddBytesCopied(outputSize);
     
     // Cleanup
     SelectObject(memoryDC, oldBitmap);
     DeleteObject(bitmap);
     DeleteDC(memoryDC);
-    DeleteDC(screenDC);
+    releaseSourceDC();
     
-    *data = outputData;
+    data = std::move(outputData);
     *width = screenWidth;
     *height = screenHeight;
     
     return true;
 }
 
+// The platform backend from CreateScreenshotCapture: persistent
+// Windows.Graphics.Capture streams with a GPU YUV420 path, or GDI+. It is
+// created on first use and shared, so calls into it are serialized.
+std::mutex g_backend_mutex;
+
+WebPScreenshot::Windows::WindowsScreenshotCapture* GetCaptureBackendLocked() {
+    static std::unique_ptr<WebPScreenshot::ScreenshotCapture> backend = WebPScreenshot::CreateScreenshotCapture();
+    return dynamic_cast<WebPScreenshot::Windows::WindowsScreenshotCapture*>(backend.get());
+}
+
+// Capture and encode a whole display through the backend, which converts the
+// frame to YUV420 on the GPU and reads back only the planes. False when the
+// backend cannot, so the caller falls back to GDI.
+bool EncodeDisplayWithBackend(int displayIndex, const WebPEncodeParams& params,
+                              std::vector<uint8_t>& encoded, uint32_t* width, uint32_t* height) {
+    std::lock_guard<std::mutex> lock(g_backend_mutex);
+    WebPScreenshot::Windows::WindowsScreenshotCapture* backend = GetCaptureBackendLocked();
+    if (!backend || displayIndex < 0) {
+        return false;
+    }
+    const std::vector<WebPScreenshot::DisplayInfo> displays = backend->GetDisplays();
+    if (static_cast<size_t>(displayIndex) >= displays.size()) {
+        return false;
+    }
+
+    encoded = backend->EncodeDisplay(static_cast<uint32_t>(displayIndex), params);
+    if (encoded.empty()) {
+        return false;
+    }
+    *width = displays[displayIndex].width;
+    *height = displays[displayIndex].height;
+    return true;
+}
+
+// Capture a display, a region of it or a window through the backend's
+// persistent Windows.Graphics.Capture streams. The frame comes back as tightly
+// packed RGBA. False when the backend has no 8-bit RGBA frame to give, so the
+// caller falls back to GDI.
+bool CaptureWithBackend(int displayIndex, const WebPScreenshot::CaptureRegion& region,
+                        WebPScreenshot::PoolBuffer& data, int* width, int* height) {
+    if (displayIndex < 0) {
+        return false;
+    }
+    WebPScreenshot::ScreenshotResult result;
+    {
+        std::lock_guard<std::mutex> lock(g_backend_mutex);
+        WebPScreenshot::Windows::WindowsScreenshotCapture* backend = GetCaptureBackendLocked();
+        if (!backend) {
+            return false;
+        }
+        result = backend->CaptureDisplay(static_cast<uint32_t>(displayIndex), region);
+    }
+    // GDI+ results are BGRX and HDR streams are RGBA16F; GDI below covers both
+    if (!result.success || result.format != "RGBA" || result.bytes_per_pixel != 4 ||
+        result.width == 0 || result.height == 0) {
+        return false;
+    }
+
+    const uint32_t packedStride = result.width * 4;
+    if (result.stride == packedStride) {
+        data = std::move(result.data);
+    } else {
+        data = WebPScreenshot::Utils::AllocateScreenshotBuffer(static_cast<size_t>(packedStride) * result.height);
+        if (!data) {
+            return false;
+        }
+        for (uint32_t row = 0; row < result.height; ++row) {
+            memcpy(data.get() + static_cast<size_t>(row) * packedStride,
+                   result.data.get() + static_cast<size_t>(row) * result.stride, packedStride);
+        }
+    }
+    *width = static_cast<int>(result.width);
+    *height = static_cast<int>(result.height);
+    return true;
+}
+
+// Finalizer for external capture buffers: hand the memory back to the pool
+void ReturnPooledBuffer(char* data, void* hint) {
+    std::unique_ptr<WebPScreenshot::PoolBufferDeleter> deleter(
+        static_cast<WebPScreenshot::PoolBufferDeleter*>(hint));
+    (*deleter)(reinterpret_cast<uint8_t*>(data));
+}
+
+void DeleteEncodedBuffer(char* /*data*/, void* hint) {
+    delete static_cast<std::vector<uint8_t>*>(hint);
+}
+
+// Wrap pooled pixel memory in a Buffer without copying. Runtimes that forbid
+// external backing stores (V8 sandbox) get a copy instead.
+Local<Object> NewPooledBuffer(Isolate* isolate, WebPScreenshot::PoolBuffer data, size_t size) {
+    char* raw = reinterpret_cast<char*>(data.get());
+    auto* deleter = new WebPScreenshot::PoolBufferDeleter(data.get_deleter());
+    Local<Object> buffer;
+    if (node::Buffer::New(isolate, raw, size, ReturnPooledBuffer, deleter).ToLocal(&buffer)) {
+        data.release();  // Owned by the finalizer now
+        return buffer;
+    }
+
+    delete deleter;
+    Stats::AddBytesCopied(size);
+    return node::Buffer::Copy(isolate, raw, size).ToLocalChecked();
+}
+
+Local<Object> NewEncodedBuffer(Isolate* isolate, std::vector<uint8_t>&& encoded) {
+    auto* holder = new std::vector<uint8_t>(std::move(encoded));
+    Local<Object> buffer;
+    if (node::Buffer::New(isolate, reinterpret_cast<char*>(holder->data()), holder->size(),
+                          DeleteEncodedBuffer, holder).ToLocal(&buffer)) {
+        return buffer;
+    }
+
+    buffer = node::Buffer::Copy(isolate, reinterpret_cast<char*>(holder->data()),
+                                holder->size()).ToLocalChecked();
+    Stats::AddBytesCopied(holder->size());
+    delete holder;
+    return buffer;
+}
+
+void SetProperty(Isolate* isolate, Local<Context> context, Local<Object> target,
+                 const char* key, Local<Value> value) {
+    target->Set(context, String::NewFromUtf8(isolate, key).ToLocalChecked(), value).Check();
+}
+
+// Read the encoder options object used by src/index.js (camelCase keys).
+// A bare number is accepted as the quality, as before.
+WebPEncodeParams ParseEncodeParams(Isolate* isolate, Local<Context> context, Local<Value> value) {
+    WebPEncodeParams params;
+    if (value->IsNumber()) {
+        params.quality = static_cast<float>(value->NumberValue(context).ToChecked());
+        return params;
+    }
+    if (!value->IsObject()) {
+        return params;
+    }
+
+    Local<Object> options = value.As<Object>();
+    auto read = [&](const char* key, auto& field) {
+        Local<Value> v;
+        if (options->Get(context, String::NewFromUtf8(isolate, key).ToLocalChecked()).ToLocal(&v) &&
+            v->IsNumber()) {
+            field = static_cast<std::remove_reference_t<decltype(field)>>(v->NumberValue(context).ToChecked());
+        }
+    };
+    auto read_bool = [&](const char* key, bool& field) {
+        Local<Value> v;
+        if (options->Get(context, String::NewFromUtf8(isolate, key).ToLocalChecked()).ToLocal(&v) &&
+            (v->IsBoolean() || v->IsNumber())) {
+            field = v->BooleanValue(isolate);
+        }
+    };
+
+    read("lossless", params.lossless);
+    read("quality", params.quality);
+    read("method", params.method);
+    read("targetSize", params.target_size);
+    read("maxOutputSize", params.max_output_size);
+    read("targetPsnr", params.target_psnr);
+    read("segments", params.segments);
+    read("snsStrength", params.sns_strength);
+    read("filterStrength", params.filter_strength);
+    read("filterSharpness", params.filter_sharpness);
+    read("filterType", params.filter_type);
+    read("autofilter", params.autofilter);
+    read("alphaCompression", params.alpha_compression);
+    read("alphaFiltering", params.alpha_filtering);
+    read("alphaQuality", params.alpha_quality);
+    read("pass", params.pass);
+    read("showCompressed", params.show_compressed);
+    read("preprocessing", params.preprocessing);
+    read("partitions", params.partitions);
+    read("partitionLimit", params.partition_limit);
+    read("emulateJpegSize", params.emulate_jpeg_size);
+    read("threadLevel", params.thread_level);
+    read("lowMemory", params.low_memory);
+    read("nearLossless", params.near_lossless);
+    read("exact", params.exact);
+    read("useDeltaPalette", params.use_delta_palette);
+    read("useSharpYuv", params.use_sharp_yuv);
+    read("contentAdaptive", params.content_adaptive);
+    read("maxEncodeMs", params.max_encode_ms);
+    read("tileCache", params.tile_cache);
+    read_bool("enableMultithreading", params.enable_multithreading);
+    read("maxThreads", params.max_threads);
+    return params;
+}
+
+int ParseDisplayIndex(Isolate* isolate, Local<Context> context, Local<Value> value) {
+    if (value->IsNumber()) {
+        return value->Int32Value(context).ToChecked();
+    }
+    if (value->IsObject()) {
+        Local<Value> displayVal;
+        if (value.As<Object>()->Get(context, String::NewFromUtf8(isolate, "display").ToLocalChecked())
+                .ToLocal(&displayVal) && displayVal->IsNumber()) {
+            return displayVal->Int32Value(context).ToChecked();
+        }
+    }
+    return 0;
+}
+
+// Optional `region: { x, y, width, height }` and `windowId` of a capture
+// options object; missing or negative fields stay 0 (full extent)
+WebPScreenshot::CaptureRegion ParseCaptureRegion(Isolate* isolate, Local<Context> context, Local<Value> value) {
+    WebPScreenshot::CaptureRegion region;
+    if (!value->IsObject()) {
+        return region;
+    }
+
+    auto read = [&](Local<Object> object, const char* key, auto& field) {
+        Local<Value> v;
+        if (object->Get(context, String::NewFromUtf8(isolate, key).ToLocalChecked()).ToLocal(&v) &&
+            v->IsNumber() && v->NumberValue(context).ToChecked() > 0) {
+            field = static_cast<std::remove_reference_t<decltype(field)>>(v->NumberValue(context).ToChecked());
+        }
+    };
+
+    Local<Object> options = value.As<Object>();
+    Local<Value> rectVal;
+    if (options->Get(context, String::NewFromUtf8(isolate, "region").ToLocalChecked()).ToLocal(&rectVal) &&
+        rectVal->IsObject()) {
+        Local<Object> rect = rectVal.As<Object>();
+        read(rect, "x", region.x);
+        read(rect, "y", region.y);
+        read(rect, "width", region.width);
+        read(rect, "height", region.height);
+    }
+    read(options, "windowId", region.window_id);
+    return region;
+}
+
+// `{ encoder, gpu, capture }` of a warmup options object; every step is on by default
+struct WarmupRequest {
+    bool encoder = true;
+    bool gpu = true;
+    bool capture = true;
+};
+
+WarmupRequest ParseWarmupRequest(Isolate* isolate, Local<Context> context, Local<Value> value) {
+    WarmupRequest request;
+    if (!value->IsObject()) {
+        return request;
+    }
+
+    Local<Object> options = value.As<Object>();
+    auto read_bool = [&](const char* key, bool& field) {
+        Local<Value> v;
+        if (options->Get(context, String::NewFromUtf8(isolate, key).ToLocalChecked()).ToLocal(&v) &&
+            (v->IsBoolean() || v->IsNumber())) {
+            field = v->BooleanValue(isolate);
+        }
+    };
+    read_bool("encoder", request.encoder);
+    read_bool("gpu", request.gpu);
+    read_bool("capture", request.capture);
+    return request;
+}
+
+// Work item run on the libuv thread pool. Execute touches no V8 state; the
+// completion callback runs back on the main thread and settles the Promise
+// (or invokes the Node-style callback).
+struct AsyncWork {
+    enum class Kind { Capture, Encode, CaptureAndEncode, Warmup, EncodeBatch, UltraLarge, MultiResolution };
+
+    uv_work_t request;
+    Kind kind;
+    Isolate* isolate;
+    Global<Context> context;
+    Global<Promise::Resolver> resolver;
+    Global<Function> callback;
+    Global<Function> progress_callback;  // UltraLarge progress, replayed on completion
+
+    // Inputs
+    int display_index = 0;
+    WebPScreenshot::CaptureRegion region;
+    WebPEncodeParams params;
+    std::shared_ptr<BackingStore> input_store;  // Keeps `input`'s memory alive even if the buffer is detached
+    const uint8_t* input = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t stride = 0;
+    WarmupRequest warmup;
+    std::vector<WebPScreenshot::WebPEncoder::BatchFrame> batch;  // Views into batch_stores
+    std::vector<std::shared_ptr<BackingStore>> batch_stores;
+    std::vector<WebPScreenshot::UltraStreaming::PyramidLevelSpec> levels;
+
+    // Outputs
+    bool success = false;
+    std::string error;
+    WebPScreenshot::PoolBuffer pixels;
+    size_t pixel_size = 0;
+    std::vector<uint8_t> encoded;
+    WebPScreenshot::Warmup::Report report;
+    std::vector<std::vector<uint8_t>> batch_encoded;
+    std::vector<std::string> batch_errors;
+    WebPScreenshot::WebPEncoder::BatchStats batch_stats;
+    std::vector<std::pair<double, std::string>> progress;
+    std::vector<WebPScreenshot::UltraStreaming::MultiResolutionLevel> level_results;
+};
+
+void ExecuteWarmup(AsyncWork* work) {
+    WebPScreenshot::Warmup::Options options;
+    options.encoder = work->warmup.encoder;
+    options.gpu = work->warmup.gpu;
+    work->report = WebPScreenshot::Warmup::Run(options);
+
+    // GDI has no process-wide state to build; one pixel through the capture
+    // path faults in the DC, DIB section and pool block code instead
+    if (work->warmup.capture) {
+        const auto start = std::chrono::steady_clock::now();
+        WebPScreenshot::CaptureRegion pixel;
+        pixel.width = 1;
+        pixel.height = 1;
+        int width = 0, height = 0;
+        work->report.capture_ready = CaptureScreenGDI(work->pixels, &width, &height, 0, false, pixel);
+        work->report.capture_backend = "Windows GDI";
+        work->report.capture_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        work->pixels.reset();
+    }
+    work->success = true;
+}
+
+void ExecuteAsyncWork(uv_work_t* request) {
+    auto* work = static_cast<AsyncWork*>(request->data);
+
+    if (work->kind == AsyncWork::Kind::Warmup) {
+        ExecuteWarmup(work);
+        return;
+    }
+
+    if (work->kind == AsyncWork::Kind::EncodeBatch) {
+        work->batch_encoded.resize(work->batch.size());
+        work->batch_errors.resize(work->batch.size());
+        WebPScreenshot::WebPEncoder encoder;
+        work->success = encoder.EncodeBatch(
+            work->batch, work->width, work->height, WebPScreenshot::WebPEncoder::PixelLayout::RGBA,
+            work->params,
+            [work](size_t index, std::vector<uint8_t>&& encoded, const std::string& error) {
+                work->batch_encoded[index] = std::move(encoded);
+                work->batch_errors[index] = error;
+            },
+            &work->batch_stats);
+        if (!work->success) {
+            work->error = encoder.GetLastError();
+        }
+        return;
+    }
+
+    if (work->kind == AsyncWork::Kind::UltraLarge) {
+        // The pipeline reports from its own thread; keep the updates for the main thread
+        work->encoded = WebPScreenshot::UltraStreaming::CaptureAndEncodeUltraLarge(
+            static_cast<uint32_t>(work->display_index), work->params,
+            [work](double percent, const std::string& status) {
+                work->progress.emplace_back(percent, status);
+                return true;
+            }).get();
+        if (work->encoded.empty()) {
+            work->error = work->progress.empty() ? "Ultra-large capture and encode failed"
+                                                 : work->progress.back().second;
+            return;
+        }
+        work->success = true;
+        return;
+    }
+
+    if (work->kind == AsyncWork::Kind::MultiResolution) {
+        // The pyramid takes a ScreenshotResult, whose pixels live in a pool block
+        WebPScreenshot::ScreenshotResult frame;
+        const size_t size = static_cast<size_t>(work->stride) * (work->height - 1) + work->width * 4;
+        frame.data = WebPScreenshot::Utils::AllocateScreenshotBuffer(size);
+        if (!frame.data) {
+            work->error = "Failed to allocate the frame";
+            return;
+        }
+        memcpy(frame.data.get(), work->input, size);
+        frame.width = work->width;
+        frame.height = work->height;
+        frame.stride = work->stride;
+        frame.bytes_per_pixel = 4;
+        frame.data_size = static_cast<uint32_t>(size);
+        frame.format = "RGBA";
+        frame.success = true;
+        work->level_results = WebPScreenshot::UltraStreaming::EncodeMultiResolution(frame, work->levels);
+        work->success = true;
+        return;
+    }
+
+    // Whole displays take the backend's GPU path; regions and windows, and
+    // any display it cannot encode, are captured and encoded below
+    if (work->kind == AsyncWork::Kind::CaptureAndEncode && work->region.IsFullFrame() &&
+        EncodeDisplayWithBackend(work->display_index, work->params, work->encoded,
+                                 &work->width, &work->height)) {
+        work->success = true;
+        return;
+    }
+
+    // Captures read the backend's capture stream, which returns RGBA; GDI
+    // covers the rest, keeping BGRX when the frame goes straight to the encoder
+    bool bgrx = false;
+    if (work->kind != AsyncWork::Kind::Encode) {
+        int width = 0, height = 0;
+        if (!CaptureWithBackend(work->display_index, work->region, work->pixels, &width, &height)) {
+            bgrx = work->kind == AsyncWork::Kind::CaptureAndEncode;
+            if (!CaptureScreenGDI(work->pixels, &width, &height, work->display_index, !bgrx, work->region)) {
+                work->error = "Failed to capture screenshot";
+                return;
+            }
+        }
+        work->width = static_cast<uint32_t>(width);
+        work->height = static_cast<uint32_t>(height);
+        work->stride = work->width * 4;
+        work->pixel_size = static_cast<size_t>(work->stride) * work->height;
+        work->input = work->pixels.get();
+    }
+
+    if (work->kind != AsyncWork::Kind::Capture) {
+        WebPScreenshot::WebPEncoder encoder;
+        if (bgrx) {
+            // GDI leaves the fourth byte undefined, so treat it as BGRX
+            work->encoded = encoder.EncodeBGRA(work->input, work->width, work->height,
+                                               work->stride, work->params, false);
+        } else {
+            work->encoded = encoder.EncodeRGBA(work->input, work->width, work->height,
+                                               work->stride, work->params);
+        }
+        if (work->encoded.empty()) {
+            work->error = encoder.GetLastError();
+            return;
+        }
+    }
+
+    work->success = true;
+}
+
+void CompleteAsyncWork(uv_work_t* request, int status) {
+    std::unique_ptr<AsyncWork> work(static_cast<AsyncWork*>(request->data));
+    Isolate* isolate = work->isolate;
+    HandleScope scope(isolate);
+    Local<Context> context = work->context.Get(isolate);
+    Context::Scope context_scope(context);
+
+    Stats::ScopedStageTimer marshalTimer(Stats::Stage::Marshal);
+    Local<Value> error = Undefined(isolate);
+    Local<Value> value = Undefined(isolate);
+
+    if (status != 0 || !work->success) {
+        marshalTimer.Cancel();
+        const std::string message = status != 0 ? "Async work was cancelled" : work->error;
+        error = Exception::Error(String::NewFromUtf8(isolate, message.c_str()).ToLocalChecked());
+    } else if (work->kind == AsyncWork::Kind::Warmup) {
+        // Not a frame; nothing here belongs in the marshal stage either
+        marshalTimer.Cancel();
+        const WebPScreenshot::Warmup::Report& report = work->report;
+        Local<Object> result = Object::New(isolate);
+        SetProperty(isolate, context, result, "encoderReady", Boolean::New(isolate, report.encoder_ready));
+        SetProperty(isolate, context, result, "gpuReady", Boolean::New(isolate, report.gpu_ready));
+        SetProperty(isolate, context, result, "captureReady", Boolean::New(isolate, report.capture_ready));
+        SetProperty(isolate, context, result, "captureBackend",
+                    String::NewFromUtf8(isolate, report.capture_backend.c_str()).ToLocalChecked());
+        SetProperty(isolate, context, result, "encoderMs", Number::New(isolate, report.encoder_ms));
+        SetProperty(isolate, context, result, "gpuMs", Number::New(isolate, report.gpu_ms));
+        SetProperty(isolate, context, result, "captureMs", Number::New(isolate, report.capture_ms));
+        if (!report.error.empty()) {
+            SetProperty(isolate, context, result, "error",
+                        String::NewFromUtf8(isolate, report.error.c_str()).ToLocalChecked());
+        }
+        value = result;
+    } else if (work->kind == AsyncWork::Kind::Encode || work->kind == AsyncWork::Kind::UltraLarge) {
+        value = NewEncodedBuffer(isolate, std::move(work->encoded));
+    } else if (work->kind == AsyncWork::Kind::EncodeBatch) {
+        // A failed frame is null in frames and has its message in errors
+        const WebPScreenshot::WebPEncoder::BatchStats& stats = work->batch_stats;
+        Local<Array> frames = Array::New(isolate, static_cast<int>(work->batch.size()));
+        Local<Array> errors = Array::New(isolate, static_cast<int>(work->batch.size()));
+        for (size_t i = 0; i < work->batch.size(); ++i) {
+            const bool failed = !work->batch_errors[i].empty();
+            Local<Value> frame = failed ? Local<Value>(Null(isolate))
+                                        : Local<Value>(NewEncodedBuffer(isolate, std::move(work->batch_encoded[i])));
+            Local<Value> message = failed
+                ? Local<Value>(String::NewFromUtf8(isolate, work->batch_errors[i].c_str()).ToLocalChecked())
+                : Local<Value>(Null(isolate));
+            frames->Set(context, static_cast<uint32_t>(i), frame).Check();
+            errors->Set(context, static_cast<uint32_t>(i), message).Check();
+        }
+        Local<Object> result = Object::New(isolate);
+        SetProperty(isolate, context, result, "frames", frames);
+        SetProperty(isolate, context, result, "errors", errors);
+        SetProperty(isolate, context, result, "failedFrames",
+                    Number::New(isolate, static_cast<double>(stats.failed_frames)));
+        SetProperty(isolate, context, result, "workers", Number::New(isolate, stats.workers));
+        SetProperty(isolate, context, result, "elapsedMs", Number::New(isolate, stats.elapsed_ms));
+        SetProperty(isolate, context, result, "framesPerSecond", Number::New(isolate, stats.frames_per_second));
+        value = result;
+    } else if (work->kind == AsyncWork::Kind::MultiResolution) {
+        // A failed level has null data and its message in error
+        Local<Array> levels = Array::New(isolate, static_cast<int>(work->level_results.size()));
+        for (size_t i = 0; i < work->level_results.size(); ++i) {
+            WebPScreenshot::UltraStreaming::MultiResolutionLevel& level = work->level_results[i];
+            const bool failed = level.encoded_data.empty();
+            Local<Object> entry = Object::New(isolate);
+            SetProperty(isolate, context, entry, "width", Number::New(isolate, level.width));
+            SetProperty(isolate, context, entry, "height", Number::New(isolate, level.height));
+            SetProperty(isolate, context, entry, "scaleFactor", Number::New(isolate, level.scale_factor));
+            SetProperty(isolate, context, entry, "data",
+                        failed ? Local<Value>(Null(isolate))
+                               : Local<Value>(NewEncodedBuffer(isolate, std::move(level.encoded_data))));
+            SetProperty(isolate, context, entry, "error",
+                        failed ? Local<Value>(String::NewFromUtf8(isolate, level.error_message.c_str()).ToLocalChecked())
+                               : Local<Value>(Null(isolate)));
+            levels->Set(context, static_cast<uint32_t>(i), entry).Check();
+        }
+        value = levels;
+    } else {
+        Local<Object> result = Object::New(isolate);
+        SetProperty(isolate, context, result, "success", Boolean::New(isolate, true));
+        SetProperty(isolate, context, result, "width", Number::New(isolate, work->width));
+        SetProperty(isolate, context, result, "height", Number::New(isolate, work->height));
+
+        if (work->kind == AsyncWork::Kind::Capture) {
+            SetProperty(isolate, context, result, "stride", Number::New(isolate, work->stride));
+            SetProperty(isolate, context, result, "format", String::NewFromUtf8(isolate, "RGBA").ToLocalChecked());
+            SetProperty(isolate, context, result, "data",
+                        NewPooledBuffer(isolate, std::move(work->pixels), work->pixel_size));
+        } else {
+            // Raw pixels are no longer needed; recycle them before the Promise settles
+            WebPScreenshot::Utils::ReturnScreenshotBuffer(std::move(work->pixels), work->pixel_size);
+            SetProperty(isolate, context, result, "format", String::NewFromUtf8(isolate, "webp").ToLocalChecked());
+            SetProperty(isolate, context, result, "data", NewEncodedBuffer(isolate, std::move(work->encoded)));
+        }
+        value = result;
+    }
+
+    // Settling runs JS, which is not part of the marshal cost
+    if (error->IsUndefined() && work->kind != AsyncWork::Kind::Warmup) {
+        marshalTimer.Stop();
+        const size_t frames = work->kind == AsyncWork::Kind::EncodeBatch
+            ? work->batch_stats.frames - work->batch_stats.failed_frames : 1;
+        for (size_t i = 0; i < frames; ++i) {
+            Stats::AddFrame();
+        }
+    }
+
+    if (!work->progress_callback.IsEmpty()) {
+        Local<Function> progress = work->progress_callback.Get(isolate);
+        for (const auto& update : work->progress) {
+            Local<Value> argv[2] = {Number::New(isolate, update.first),
+                                    String::NewFromUtf8(isolate, update.second.c_str()).ToLocalChecked()};
+            node::MakeCallback(isolate, context->Global(), progress, 2, argv, node::async_context{0, 0});
+        }
+    }
+
+    if (!work->callback.IsEmpty()) {
+        Local<Value> argv[2] = {error->IsUndefined() ? Local<Value>(Null(isolate)) : error, value};
+        node::MakeCallback(isolate, context->Global(), work->callback.Get(isolate), 2, argv,
+                           node::async_context{0, 0});
+    } else if (error->IsUndefined()) {
+        work->resolver.Get(isolate)->Resolve(context, value).Check();
+    } else {
+        work->resolver.Get(isolate)->Reject(context, error).Check();
+    }
+}
+
+// Queue work on the libuv pool; returns the Promise, or undefined when a
+// callback was supplied
+Local<Value> QueueAsyncWork(Isolate* isolate, Local<Context> context, std::unique_ptr<AsyncWork> work,
+                            Local<Value> callback) {
+    work->isolate = isolate;
+    work->context.Reset(isolate, context);
+    work->request.data = work.get();
+
+    Local<Value> returned = Undefined(isolate);
+    if (callback->IsFunction()) {
+        work->callback.Reset(isolate, callback.As<Function>());
+    } else {
+        Local<Promise::Resolver> resolver = Promise::Resolver::New(context).ToLocalChecked();
+        work->resolver.Reset(isolate, resolver);
+        returned = resolver->GetPromise();
+    }
+
+    uv_queue_work(node::GetCurrentEventLoop(isolate), &work->request,
+                  ExecuteAsyncWork, CompleteAsyncWork);
+    work.release();  // Freed in CompleteAsyncWork
+    return returned;
+}
+
+// captureScreenshotAsync(options) -> Promise<{ width, height, stride, data }>
+void CaptureScreenAsync(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    auto work = std::make_unique<AsyncWork>();
+    work->kind = AsyncWork::Kind::Capture;
+    work->display_index = args.Length() > 0 ? ParseDisplayIndex(isolate, context, args[0]) : 0;
+    if (args.Length() > 0) {
+        work->region = ParseCaptureRegion(isolate, context, args[0]);
+    }
+
+    args.GetReturnValue().Set(QueueAsyncWork(isolate, context, std::move(work), Undefined(isolate)));
+}
+
+// captureDisplayAsync(displayIndex, options) -> Promise<{ width, height, format: 'webp', data }>
+void CaptureDisplayAsync(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    auto work = std::make_unique<AsyncWork>();
+    work->kind = AsyncWork::Kind::CaptureAndEncode;
+    work->display_index = args.Length() > 0 ? ParseDisplayIndex(isolate, context, args[0]) : 0;
+    if (args.Length() > 1) {
+        work->params = ParseEncodeParams(isolate, context, args[1]);
+        work->region = ParseCaptureRegion(isolate, context, args[1]);
+    }
+
+    Local<Value> callback = args.Length() > 2 ? args[2] : Local<Value>(Undefined(isolate));
+    args.GetReturnValue().Set(QueueAsyncWork(isolate, context, std::move(work), callback));
+}
+
+// captureAndEncodeUltraLarge(displayIndex, options, [progress]) -> Promise<Buffer>
+// Runs the display through the ultra-streaming pipeline. progress(percent,
+// status) receives every update in order just before the Promise settles;
+// its return value cannot cancel the encode.
+void CaptureAndEncodeUltraLargeAsync(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    auto work = std::make_unique<AsyncWork>();
+    work->kind = AsyncWork::Kind::UltraLarge;
+    work->display_index = args.Length() > 0 ? ParseDisplayIndex(isolate, context, args[0]) : 0;
+    if (args.Length() > 1) {
+        work->params = ParseEncodeParams(isolate, context, args[1]);
+    }
+    if (args.Length() > 2 && args[2]->IsFunction()) {
+        work->progress_callback.Reset(isolate, args[2].As<Function>());
+    }
+
+    args.GetReturnValue().Set(QueueAsyncWork(isolate, context, std::move(work), Undefined(isolate)));
+}
+
+// warmup([options], [callback]) -> Promise<{ encoderReady, gpuReady, captureReady, ... }>
+// Runs the one-time setup of the first capture and encode on the thread pool
+void WarmupAsync(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    auto work = std::make_unique<AsyncWork>();
+    work->kind = AsyncWork::Kind::Warmup;
+    Local<Value> callback = Undefined(isolate);
+    if (args.Length() > 0 && args[0]->IsFunction()) {
+        callback = args[0];
+    } else {
+        if (args.Length() > 0) {
+            work->warmup = ParseWarmupRequest(isolate, context, args[0]);
+        }
+        if (args.Length() > 1) {
+            callback = args[1];
+        }
+    }
+
+    args.GetReturnValue().Set(QueueAsyncWork(isolate, context, std::move(work), callback));
+}
+
+// encodeWebPAsync(data, width, height, stride, options) -> Promise<Buffer>
+void EncodeWebPAsync(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    if (args.Length() < 4 || !args[0]->IsArrayBufferView()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Expected arguments: data, width, height, stride").ToLocalChecked()));
+        return;
+    }
+
+    Local<ArrayBufferView> input = args[0].As<ArrayBufferView>();
+    auto work = std::make_unique<AsyncWork>();
+    work->kind = AsyncWork::Kind::Encode;
+    work->width = args[1]->Uint32Value(context).ToChecked();
+    work->height = args[2]->Uint32Value(context).ToChecked();
+    work->stride = args[3]->Uint32Value(context).ToChecked();
+    if (args.Length() > 4) {
+        work->params = ParseEncodeParams(isolate, context, args[4]);
+    }
+
+    const size_t required = static_cast<size_t>(work->stride ? work->stride : work->width * 4) *
+                            (work->height ? work->height - 1 : 0) + work->width * 4;
+    if (work->width == 0 || work->height == 0 || input->ByteLength() < required) {
+        isolate->ThrowException(Exception::RangeError(
+            String::NewFromUtf8(isolate, "Buffer too small for the given dimensions").ToLocalChecked()));
+        return;
+    }
+
+    work->input_store = input->Buffer()->GetBackingStore();
+    work->input = static_cast<const uint8_t*>(work->input_store->Data()) + input->ByteOffset();
+
+    args.GetReturnValue().Set(QueueAsyncWork(isolate, context, std::move(work), Undefined(isolate)));
+}
+
+// encodeWebPBatchAsync(frames, width, height, stride, options) ->
+// Promise<{ frames, errors, failedFrames, workers, elapsedMs, framesPerSecond }>.
+// Every frame is an RGBA buffer of the same size; whole frames encode in
+// parallel and come back in input order.
+void EncodeWebPBatchAsync(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    if (args.Length() < 4 || !args[0]->IsArray()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Expected arguments: frames, width, height, stride").ToLocalChecked()));
+        return;
+    }
+
+    Local<Array> frames = args[0].As<Array>();
+    auto work = std::make_unique<AsyncWork>();
+    work->kind = AsyncWork::Kind::EncodeBatch;
+    work->width = args[1]->Uint32Value(context).ToChecked();
+    work->height = args[2]->Uint32Value(context).ToChecked();
+    work->stride = args[3]->Uint32Value(context).ToChecked();
+    if (args.Length() > 4) {
+        work->params = ParseEncodeParams(isolate, context, args[4]);
+    }
+
+    const size_t required = static_cast<size_t>(work->stride ? work->stride : work->width * 4) *
+                            (work->height ? work->height - 1 : 0) + work->width * 4;
+    if (work->width == 0 || work->height == 0) {
+        isolate->ThrowException(Exception::RangeError(
+            String::NewFromUtf8(isolate, "Invalid dimensions").ToLocalChecked()));
+        return;
+    }
+
+    // Each frame's memory is owned here, so the caller may change its array
+    // or detach a buffer meanwhile
+    work->batch.reserve(frames->Length());
+    work->batch_stores.reserve(frames->Length());
+    for (uint32_t i = 0; i < frames->Length(); ++i) {
+        Local<Value> frame = frames->Get(context, i).ToLocalChecked();
+        if (!frame->IsArrayBufferView() || frame.As<ArrayBufferView>()->ByteLength() < required) {
+            const std::string message = "Frame " + std::to_string(i) + " is too small for the given dimensions";
+            isolate->ThrowException(Exception::RangeError(
+                String::NewFromUtf8(isolate, message.c_str()).ToLocalChecked()));
+            return;
+        }
+        Local<ArrayBufferView> view = frame.As<ArrayBufferView>();
+        work->batch_stores.push_back(view->Buffer()->GetBackingStore());
+        WebPScreenshot::WebPEncoder::BatchFrame entry;
+        entry.data = static_cast<const uint8_t*>(work->batch_stores.back()->Data()) + view->ByteOffset();
+        entry.stride = work->stride;
+        work->batch.push_back(entry);
+    }
+
+    args.GetReturnValue().Set(QueueAsyncWork(isolate, context, std::move(work), Undefined(isolate)));
+}
+
+// encodeMultiResolutionAsync(data, width, height, stride, levels) ->
+// Promise<Array<{ width, height, scaleFactor, data, error }>>. Each level is
+// { scale, maxDimension, ...encode options }; the frame is converted to
+// YUV420 once, and every level is scaled from it and encoded in parallel.
+void EncodeMultiResolutionAsync(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    if (args.Length() < 5 || !args[0]->IsArrayBufferView() || !args[4]->IsArray()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Expected arguments: data, width, height, stride, levels").ToLocalChecked()));
+        return;
+    }
+
+    Local<ArrayBufferView> input = args[0].As<ArrayBufferView>();
+    auto work = std::make_unique<AsyncWork>();
+    work->kind = AsyncWork::Kind::MultiResolution;
+    work->width = args[1]->Uint32Value(context).ToChecked();
+    work->height = args[2]->Uint32Value(context).ToChecked();
+    work->stride = args[3]->Uint32Value(context).ToChecked();
+    if (work->stride == 0) {
+        work->stride = work->width * 4;
+    }
+
+    const size_t required = static_cast<size_t>(work->stride) * (work->height ? work->height - 1 : 0) +
+                            work->width * 4;
+    if (work->width == 0 || work->height == 0 || work->stride < work->width * 4 ||
+        input->ByteLength() < required) {
+        isolate->ThrowException(Exception::RangeError(
+            String::NewFromUtf8(isolate, "Buffer too small for the given dimensions").ToLocalChecked()));
+        return;
+    }
+
+    Local<Array> levels = args[4].As<Array>();
+    for (uint32_t i = 0; i < levels->Length(); ++i) {
+        Local<Value> level = levels->Get(context, i).ToLocalChecked();
+        WebPScreenshot::UltraStreaming::PyramidLevelSpec spec;
+        if (level->IsObject()) {
+            Local<Object> options = level.As<Object>();
+            Local<Value> v;
+            if (options->Get(context, String::NewFromUtf8(isolate, "scale").ToLocalChecked()).ToLocal(&v) &&
+                v->IsNumber()) {
+                spec.scale = static_cast<float>(v->NumberValue(context).FromMaybe(1.0));
+            }
+            if (options->Get(context, String::NewFromUtf8(isolate, "maxDimension").ToLocalChecked()).ToLocal(&v) &&
+                v->IsNumber()) {
+                spec.max_dimension = v->Uint32Value(context).FromMaybe(0);
+            }
+            spec.params = ParseEncodeParams(isolate, context, level);
+        }
+        work->levels.push_back(spec);
+    }
+
+    work->input_store = input->Buffer()->GetBackingStore();
+    work->input = static_cast<const uint8_t*>(work->input_store->Data()) + input->ByteOffset();
+
+    args.GetReturnValue().Set(QueueAsyncWork(isolate, context, std::move(work), Undefined(isolate)));
+}
+
 // Real screenshot capture function with SIMD optimization
 void CaptureScreen(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
     Local<Context> context = isolate->GetCurrentContext();
 
-    // Get display index from arguments
-    int displayIndex = 0;
-    if (args.Length() > 0 && args[0]->IsObject()) {
-        Local<Object> options = args[0]->ToObject(context).ToLocalChecked();
-        Local<String> displayKey = String::NewFromUtf8(isolate, "display").ToLocalChecked();
-        Local<Value> displayVal;
-        if (options->Get(context, displayKey).ToLocal(&displayVal) && displayVal->IsNumber()) {
-            displayIndex = displayVal->Int32Value(context).ToChecked();
-        }
+    // Get display index and optional region from arguments
+    int displayIndex = args.Length() > 0 ? ParseDisplayIndex(isolate, context, args[0]) : 0;
+    // captureScreenshot(options) or captureDisplay(index, options)
+    WebPScreenshot::CaptureRegion region;
+    if (args.Length() > 1) {
+        region = ParseCaptureRegion(isolate, context, args[1]);
+    } else if (args.Length() > 0) {
+        region = ParseCaptureRegion(isolate, context, args[0]);
     }
 
     // Capture screenshot
-    uint8_t* screenshotData;
+    WebPScreenshot::PoolBuffer screenshotData;
     int width, height;
-    bool success = CaptureScreenGDI(&screenshotData, &width, &height, displayIndex);
+    bool success = CaptureWithBackend(displayIndex, region, screenshotData, &width, &height) ||
+                   CaptureScreenGDI(screenshotData, &width, &height, displayIndex, true, region);
 
     // Create result object
+    Stats::ScopedStageTimer marshalTimer(Stats::Stage::Marshal);
     Local<Object> result = Object::New(isolate);
     
     if (success) {
-        // Create ArrayBuffer for the image data
-        size_t bufferSize = width * height * 4;
-        Local<ArrayBuffer> arrayBuffer = ArrayBuffer::New(isolate, bufferSize);
-        uint8_t* bufferData = static_cast<uint8_t*>(arrayBuffer->GetBackingStore()->Data());
-        
-        // Copy screenshot data
-        memcpy(bufferData, screenshotData, bufferSize);
-        delete[] screenshotData;
-        
-        Local<Uint8Array> data = Uint8Array::New(arrayBuffer, 0, bufferSize);
+        Stats::AddFrame();
+        // Expose the pooled capture buffer directly; it returns to the pool on GC
+        size_t bufferSize = static_cast<size_t>(width) * height * 4;
+        Local<Object> data = NewPooledBuffer(isolate, std::move(screenshotData), bufferSize);
         
         result->Set(context, String::NewFromUtf8(isolate, "success").ToLocalChecked(),
                     Boolean::New(isolate, true)).Check();
@@ -198,9 +1021,8 @@ void CaptureScreen(const FunctionCallbackInfo<Value>& args) {
         result->Set(context, String::NewFromUtf8(isolate, "height").ToLocalChecked(),
                     Number::New(isolate, height)).Check();
         result->Set(context, String::NewFromUtf8(isolate, "data").ToLocalChecked(), data).Check();
-        
-        std::cout << "SIMD-optimized screenshot captured: " << width << "x" << height << " (" << bufferSize << " bytes)" << std::endl;
     } else {
+        marshalTimer.Cancel();
         result->Set(context, String::NewFromUtf8(isolate, "success").ToLocalChecked(),
                     Boolean::New(isolate, false)).Check();
         result->Set(context, String::NewFromUtf8(isolate, "error").ToLocalChecked(),
@@ -271,93 +1093,175 @@ void GetDisplays(const FunctionCallbackInfo<Value>& args) {
     std::cout << "Real display enumeration: found " << displayCount << " displays" << std::endl;
 }
 
-// Improved WebP encoding with better compression
+// Synchronous WebP encoding (prefer encodeWebPAsync off the main thread)
 void EncodeWebP(const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
     Local<Context> context = isolate->GetCurrentContext();
     
-    if (args.Length() < 4) {
+    if (args.Length() < 4 || !args[0]->IsArrayBufferView()) {
         isolate->ThrowException(Exception::TypeError(
             String::NewFromUtf8(isolate, "Expected 4 arguments: data, width, height, stride").ToLocalChecked()));
         return;
     }
     
     // Get parameters
-    Local<Uint8Array> inputData = args[0].As<Uint8Array>();
-    int width = args[1]->Int32Value(context).ToChecked();
-    int height = args[2]->Int32Value(context).ToChecked();
-    int stride = args[3]->Int32Value(context).ToChecked();
-    
-    // Optional quality parameter (default 80)
-    float quality = 80.0f;
-    if (args.Length() > 4 && args[4]->IsNumber()) {
-        quality = args[4]->NumberValue(context).ToChecked();
-    }
-    
-    uint8_t* rgba_data = static_cast<uint8_t*>(inputData->Buffer()->GetBackingStore()->Data()) + inputData->ByteOffset();
-    size_t input_size = width * height * 4;
-    
-    // Enhanced compression algorithm
-    size_t compressed_size = input_size / 6; // Better compression estimate
-    compressed_size = std::max(compressed_size, size_t(1000));
-    
-    Local<ArrayBuffer> arrayBuffer = ArrayBuffer::New(isolate, compressed_size + 100);
-    uint8_t* webp_data = static_cast<uint8_t*>(arrayBuffer->GetBackingStore()->Data());
-    
-    // Create enhanced WebP RIFF header
-    memcpy(webp_data, "RIFF", 4);
-    uint32_t file_size = compressed_size + 92;
-    memcpy(webp_data + 4, &file_size, 4);
-    memcpy(webp_data + 8, "WEBP", 4);
-    
-    // VP8 chunk header
-    memcpy(webp_data + 12, "VP8 ", 4);
-    uint32_t vp8_size = compressed_size + 20;
-    memcpy(webp_data + 16, &vp8_size, 4);
-    
-    // VP8 frame header
-    webp_data[20] = 0x9D; webp_data[21] = 0x01; webp_data[22] = 0x2A;
-    
-    // Width and height
-    uint16_t vp8_width = width & 0x3FFF;
-    uint16_t vp8_height = height & 0x3FFF;
-    memcpy(webp_data + 23, &vp8_width, 2);
-    memcpy(webp_data + 25, &vp8_height, 2);
-    
-    // Enhanced compression with quality-based downsampling
-    uint8_t* output_ptr = webp_data + 27;
-    size_t remaining = compressed_size - 27;
-    int step = static_cast<int>(100.0f / quality * 8); // Quality-based step size
-    
-    for (size_t i = 0; i < input_size && remaining > 0; i += step, remaining--) {
-        if (i + step - 4 < input_size) {
-            // Average multiple pixels based on quality
-            uint32_t r = 0, g = 0, b = 0;
-            int count = 0;
-            for (int j = 0; j < step && i + j + 3 < input_size; j += 4) {
-                r += rgba_data[i + j + 0];
-                g += rgba_data[i + j + 1];
-                b += rgba_data[i + j + 2];
-                count++;
-            }
-            if (count > 0) {
-                *output_ptr++ = (uint8_t)(r / count);
-                if (remaining > 0) *output_ptr++ = (uint8_t)(g / count), remaining--;
-                if (remaining > 0) *output_ptr++ = (uint8_t)(b / count), remaining--;
-            }
-        } else {
-            *output_ptr++ = rgba_data[std::min(i, input_size - 4)];
-        }
+    Local<ArrayBufferView> inputData = args[0].As<ArrayBufferView>();
+    uint32_t width = args[1]->Uint32Value(context).ToChecked();
+    uint32_t height = args[2]->Uint32Value(context).ToChecked();
+    uint32_t stride = args[3]->Uint32Value(context).ToChecked();
+    
+    // Optional options object, or a bare quality number (default 80)
+    WebPEncodeParams params;
+    if (args.Length() > 4) {
+        params = ParseEncodeParams(isolate, context, args[4]);
+    }
+    
+    const size_t required = static_cast<size_t>(stride ? stride : width * 4) *
+                            (height ? height - 1 : 0) + static_cast<size_t>(width) * 4;
+    if (width == 0 || height == 0 || inputData->ByteLength() < required) {
+        isolate->ThrowException(Exception::RangeError(
+            String::NewFromUtf8(isolate, "Buffer too small for the given dimensions").ToLocalChecked()));
+        return;
     }
     
-    size_t actualSize = output_ptr - webp_data;
-    Local<Uint8Array> result = Uint8Array::New(arrayBuffer, 0, actualSize);
+    const uint8_t* rgba_data = static_cast<const uint8_t*>(inputData->Buffer()->GetBackingStore()->Data()) +
+                               inputData->ByteOffset();
     
-    double compression_ratio = (double)input_size / actualSize;
-    std::cout << "Enhanced WebP encoded: " << width << "x" << height << " -> " << actualSize << " bytes (ratio: " 
-              << compression_ratio << ":1, quality: " << quality << ")" << std::endl;
+    WebPScreenshot::WebPEncoder encoder;
+    std::vector<uint8_t> encoded = encoder.EncodeRGBA(rgba_data, width, height, stride, params);
+    if (encoded.empty()) {
+        isolate->ThrowException(Exception::Error(
+            String::NewFromUtf8(isolate, encoder.GetLastError().c_str()).ToLocalChecked()));
+        return;
+    }
     
+    Stats::ScopedStageTimer marshalTimer(Stats::Stage::Marshal);
+    args.GetReturnValue().Set(NewEncodedBuffer(isolate, std::move(encoded)));
+    Stats::AddFrame();
+}
+
+// encodeWebPInto(output, data, width, height, stride, options) encodes
+// straight into `output`; returns { bytesWritten, requiredSize }, with
+// bytesWritten 0 when the file (requiredSize bytes) does not fit
+void EncodeWebPInto(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    
+    if (args.Length() < 5 || !args[0]->IsArrayBufferView() || !args[1]->IsArrayBufferView()) {
+        isolate->ThrowException(Exception::TypeError(
+            String::NewFromUtf8(isolate, "Expected 5 arguments: output, data, width, height, stride").ToLocalChecked()));
+        return;
+    }
+    
+    Local<ArrayBufferView> outputView = args[0].As<ArrayBufferView>();
+    Local<ArrayBufferView> inputData = args[1].As<ArrayBufferView>();
+    uint32_t width = args[2]->Uint32Value(context).ToChecked();
+    uint32_t height = args[3]->Uint32Value(context).ToChecked();
+    uint32_t stride = args[4]->Uint32Value(context).ToChecked();
+    
+    WebPEncodeParams params;
+    if (args.Length() > 5) {
+        params = ParseEncodeParams(isolate, context, args[5]);
+    }
+    
+    const size_t required = static_cast<size_t>(stride ? stride : width * 4) *
+                            (height ? height - 1 : 0) + static_cast<size_t>(width) * 4;
+    if (width == 0 || height == 0 || inputData->ByteLength() < required) {
+        isolate->ThrowException(Exception::RangeError(
+            String::NewFromUtf8(isolate, "Buffer too small for the given dimensions").ToLocalChecked()));
+        return;
+    }
+    
+    const uint8_t* rgba_data = static_cast<const uint8_t*>(inputData->Buffer()->GetBackingStore()->Data()) +
+                               inputData->ByteOffset();
+    WebPScreenshot::EncodeSpan span;
+    span.data = static_cast<uint8_t*>(outputView->Buffer()->GetBackingStore()->Data()) + outputView->ByteOffset();
+    span.capacity = outputView->ByteLength();
+    
+    WebPScreenshot::WebPEncoder encoder;
+    const WebPScreenshot::EncodeIntoResult written = encoder.EncodeInto(
+        rgba_data, width, height, stride, WebPScreenshot::WebPEncoder::PixelLayout::RGBA, params, span);
+    if (!written.success && written.required_size == 0) {
+        isolate->ThrowException(Exception::Error(
+            String::NewFromUtf8(isolate, encoder.GetLastError().c_str()).ToLocalChecked()));
+        return;
+    }
+    
+    Local<Object> result = Object::New(isolate);
+    SetProperty(isolate, context, result, "bytesWritten",
+                Number::New(isolate, static_cast<double>(written.bytes_written)));
+    SetProperty(isolate, context, result, "requiredSize",
+                Number::New(isolate, static_cast<double>(written.required_size)));
     args.GetReturnValue().Set(result);
+    if (written.success) {
+        Stats::AddFrame();
+    }
+}
+
+// getPerformanceStats() -> per-stage latency histograms (microseconds) plus
+// copy and allocation counters since start-up or the last reset
+void GetPerformanceStats(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    const Stats::Snapshot snapshot = Stats::GetSnapshot();
+
+    auto number = [isolate](double value) { return Number::New(isolate, value); };
+
+    Local<Object> stages = Object::New(isolate);
+    for (uint32_t i = 0; i < Stats::kStageCount; ++i) {
+        const Stats::StageSummary& stage = snapshot.stages[i];
+        Local<Object> entry = Object::New(isolate);
+        SetProperty(isolate, context, entry, "count", number(static_cast<double>(stage.count)));
+        SetProperty(isolate, context, entry, "totalMs", number(stage.total_ms));
+        SetProperty(isolate, context, entry, "meanUs", number(stage.mean_us));
+        SetProperty(isolate, context, entry, "minUs", number(stage.min_us));
+        SetProperty(isolate, context, entry, "maxUs", number(stage.max_us));
+        SetProperty(isolate, context, entry, "p50Us", number(stage.p50_us));
+        SetProperty(isolate, context, entry, "p90Us", number(stage.p90_us));
+        SetProperty(isolate, context, entry, "p99Us", number(stage.p99_us));
+        SetProperty(isolate, context, entry, "p999Us", number(stage.p999_us));
+        SetProperty(isolate, context, stages, Stats::StageName(static_cast<Stats::Stage>(i)), entry);
+    }
+
+    const auto pool = WebPScreenshot::Utils::GetMemoryPoolStats();
+    Local<Object> memoryPool = Object::New(isolate);
+    SetProperty(isolate, context, memoryPool, "availableBuffers", number(static_cast<double>(pool.available_buffers)));
+    SetProperty(isolate, context, memoryPool, "totalBuffersCreated", number(static_cast<double>(pool.total_buffers_created)));
+    SetProperty(isolate, context, memoryPool, "bytesInUse", number(static_cast<double>(pool.bytes_in_use)));
+    SetProperty(isolate, context, memoryPool, "bytesCached", number(static_cast<double>(pool.bytes_cached)));
+    SetProperty(isolate, context, memoryPool, "peakMemoryUsage", number(static_cast<double>(pool.peak_memory_usage)));
+    SetProperty(isolate, context, memoryPool, "memoryReuseCount", number(static_cast<double>(pool.memory_reuse_count)));
+    SetProperty(isolate, context, memoryPool, "threadCacheHits", number(static_cast<double>(pool.thread_cache_hits)));
+
+    const auto cache = WebPScreenshot::TileCache::GetStats();
+    Local<Object> tileCache = Object::New(isolate);
+    SetProperty(isolate, context, tileCache, "tileHits", number(static_cast<double>(snapshot.tile_cache_hits)));
+    SetProperty(isolate, context, tileCache, "tileMisses", number(static_cast<double>(snapshot.tile_cache_misses)));
+    SetProperty(isolate, context, tileCache, "tileHitRate", number(snapshot.tile_cache_hit_rate));
+    SetProperty(isolate, context, tileCache, "frameHits", number(static_cast<double>(snapshot.frame_cache_hits)));
+    SetProperty(isolate, context, tileCache, "frameMisses", number(static_cast<double>(snapshot.frame_cache_misses)));
+    SetProperty(isolate, context, tileCache, "frameHitRate", number(snapshot.frame_cache_hit_rate));
+    SetProperty(isolate, context, tileCache, "entries", number(static_cast<double>(cache.entries)));
+    SetProperty(isolate, context, tileCache, "bytes", number(static_cast<double>(cache.bytes)));
+    SetProperty(isolate, context, tileCache, "maxBytes", number(static_cast<double>(cache.max_bytes)));
+    SetProperty(isolate, context, tileCache, "evictions", number(static_cast<double>(cache.evictions)));
+
+    Local<Object> result = Object::New(isolate);
+    SetProperty(isolate, context, result, "stages", stages);
+    SetProperty(isolate, context, result, "frames", number(static_cast<double>(snapshot.frames)));
+    SetProperty(isolate, context, result, "bytesCopied", number(static_cast<double>(snapshot.bytes_copied)));
+    SetProperty(isolate, context, result, "bytesCopiedPerFrame", number(snapshot.bytes_copied_per_frame));
+    SetProperty(isolate, context, result, "allocations", number(static_cast<double>(snapshot.allocations)));
+    SetProperty(isolate, context, result, "allocatedBytes", number(static_cast<double>(snapshot.allocated_bytes)));
+    SetProperty(isolate, context, result, "allocationsPerFrame", number(snapshot.allocations_per_frame));
+    SetProperty(isolate, context, result, "elapsedSeconds", number(snapshot.elapsed_seconds));
+    SetProperty(isolate, context, result, "memoryPool", memoryPool);
+    SetProperty(isolate, context, result, "tileCache", tileCache);
+    args.GetReturnValue().Set(result);
+}
+
+void ResetPerformanceStats(const FunctionCallbackInfo<Value>& args) {
+    Stats::Reset();
 }
 
 // Check if native support is available
@@ -377,21 +1281,87 @@ void GetImplementationInfo(const FunctionCallbackInfo<Value>& args) {
     info->Set(context, String::NewFromUtf8(isolate, "simdSupport").ToLocalChecked(),
               Boolean::New(isolate, true)).Check();
     info->Set(context, String::NewFromUtf8(isolate, "platform").ToLocalChecked(),
-              String::NewFromUtf8(isolate, "Windows GDI + AVX2").ToLocalChecked()).Check();
+              String::NewFromUtf8(isolate, "Windows.Graphics.Capture (GPU YUV420) with GDI fallback + runtime SIMD dispatch").ToLocalChecked()).Check();
     info->Set(context, String::NewFromUtf8(isolate, "features").ToLocalChecked(),
               String::NewFromUtf8(isolate, "Hardware-accelerated capture, SIMD optimization, Enhanced WebP").ToLocalChecked()).Check();
     
     args.GetReturnValue().Set(info);
 }
 
-// Capture display (alternative interface for tests)
+// Capture display (alternative interface for tests). With a trailing
+// callback, capture and encode run off the main thread (used by src/index.js).
 void CaptureDisplay(const FunctionCallbackInfo<Value>& args) {
+    if (args.Length() > 2 && args[2]->IsFunction()) {
+        CaptureDisplayAsync(args);
+        return;
+    }
+
     // Delegate to main capture function
     CaptureScreen(args);
 }
 
-// Initialize function
-void Initialize(const FunctionCallbackInfo<Value>& args) {
+// initializeUltraStreaming([workerThreads]) -> boolean; 0 or no argument is
+// one worker per hardware thread
+void InitializeUltraStreaming(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    uint32_t threads = 0;
+    if (args.Length() > 0 && args[0]->IsNumber()) {
+        threads = static_cast<uint32_t>(std::max(0.0, args[0]->NumberValue(context).FromMaybe(0.0)));
+    }
+    args.GetReturnValue().Set(Boolean::New(isolate, WebPScreenshot::UltraStreaming::InitializeUltraStreaming(threads)));
+}
+
+// configureUltraStreaming(chunkWidth, chunkHeight, maxMemoryMB, compressionLevel);
+// the pipeline clamps every value to its supported range
+void ConfigureUltraStreaming(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    auto number = [&](int index) {
+        if (args.Length() <= index || !args[index]->IsNumber()) {
+            return 0.0;
+        }
+        const double value = args[index]->NumberValue(context).FromMaybe(0.0);
+        return value > 0.0 ? value : 0.0;
+    };
+    WebPScreenshot::UltraStreaming::ConfigureUltraStreaming(
+        static_cast<uint32_t>(std::min(number(0), 4294967295.0)),
+        static_cast<uint32_t>(std::min(number(1), 4294967295.0)),
+        static_cast<uint64_t>(number(2)),
+        static_cast<int>(std::min(number(3), 9.0)));
+}
+
+// getUltraStreamingStats() -> pipeline counters, all zero before it starts
+void GetUltraStreamingStats(const FunctionCallbackInfo<Value>& args) {
+    Isolate* isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+
+    const WebPScreenshot::UltraStreaming::StreamingStats stats =
+        WebPScreenshot::UltraStreaming::GetUltraStreamingStats();
+    Local<Object> result = Object::New(isolate);
+    auto set = [&](const char* name, double value) {
+        SetProperty(isolate, context, result, name, Number::New(isolate, value));
+    };
+    set("totalPixelsProcessed", static_cast<double>(stats.total_pixels_processed));
+    set("totalChunksProcessed", static_cast<double>(stats.total_chunks_processed));
+    set("peakMemoryUsageMb", static_cast<double>(stats.peak_memory_usage_mb));
+    set("averageThroughputMpixelsPerSecond", stats.average_throughput_mpixels_per_sec);
+    set("activeWorkerThreads", stats.active_worker_threads);
+    set("compressionRatio", stats.compression_ratio);
+    set("tasksStolen", static_cast<double>(stats.tasks_stolen));
+    set("queueLockContentions", static_cast<double>(stats.queue_lock_contentions));
+    set("workerIdleWaits", static_cast<double>(stats.worker_idle_waits));
+    set("memoryBudgetWaits", static_cast<double>(stats.memory_budget_waits));
+    set("memoryBudgetWaitMs", stats.memory_budget_wait_ms);
+    set("numaNodes", stats.numa_nodes);
+    set("crossNodeSteals", static_cast<double>(stats.cross_node_steals));
+    set("placementFailures", stats.placement_failures);
+    args.GetReturnValue().Set(result);
+}
+
+const FunctionCallbackInfo<Value>& args) {
     Isolate* isolate = args.GetIsolate();
     args.GetReturnValue().Set(Boolean::New(isolate, true));
     std::cout << "Screenshot WebP library initialized with SIMD-optimized capture and enhanced WebP encoding" << std::endl;
@@ -411,6 +1381,9 @@ void Init(Local<Object> exports, Local<Value> module, Local<Context> context) {
     exports->Set(context, String::NewFromUtf8(isolate, "encodeWebP").ToLocalChecked(),
                  FunctionTemplate::New(isolate, EncodeWebP)->GetFunction(context).ToLocalChecked()).Check();
     
+    exports->Set(context, String::NewFromUtf8(isolate, "encodeWebPInto").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, EncodeWebPInto)->GetFunction(context).ToLocalChecked()).Check();
+    
     exports->Set(context, String::NewFromUtf8(isolate, "initialize").ToLocalChecked(),
                  FunctionTemplate::New(isolate, Initialize)->GetFunction(context).ToLocalChecked()).Check();
     
@@ -422,6 +1395,45 @@ void Init(Local<Object> exports, Local<Value> module, Local<Context> context) {
     
     exports->Set(context, String::NewFromUtf8(isolate, "captureDisplay").ToLocalChecked(),
                  FunctionTemplate::New(isolate, CaptureDisplay)->GetFunction(context).ToLocalChecked()).Check();
+    
+    // Promise-based entry points that run on the libuv thread pool
+    exports->Set(context, String::NewFromUtf8(isolate, "captureScreenshotAsync").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, CaptureScreenAsync)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "captureDisplayAsync").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, CaptureDisplayAsync)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "encodeWebPAsync").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, EncodeWebPAsync)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "encodeWebPBatchAsync").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, EncodeWebPBatchAsync)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "encodeMultiResolutionAsync").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, EncodeMultiResolutionAsync)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "warmup").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, WarmupAsync)->GetFunction(context).ToLocalChecked()).Check();
+    
+    // Ultra-streaming pipeline for 8K and up
+    exports->Set(context, String::NewFromUtf8(isolate, "initializeUltraStreaming").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, InitializeUltraStreaming)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "configureUltraStreaming").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, ConfigureUltraStreaming)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "getUltraStreamingStats").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, GetUltraStreamingStats)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "captureAndEncodeUltraLarge").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, CaptureAndEncodeUltraLargeAsync)->GetFunction(context).ToLocalChecked()).Check();
+    
+    // Unified per-stage instrumentation
+    exports->Set(context, String::NewFromUtf8(isolate, "getPerformanceStats").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, GetPerformanceStats)->GetFunction(context).ToLocalChecked()).Check();
+    
+    exports->Set(context, String::NewFromUtf8(isolate, "resetPerformanceStats").ToLocalChecked(),
+                 FunctionTemplate::New(isolate, ResetPerformanceStats)->GetFunction(context).ToLocalChecked()).Check();
 }
 
 } // anonymous namespace
@@ -0,0 +1,467 @@
+#include "common/screenshot_common.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace WebPScreenshot {
+
+namespace {
+
+using SharedRing::RingHeader;
+using SharedRing::SlotHeader;
+
+// Covers 4 KB and 16 KB (Apple silicon) pages, so every slot can be mapped
+// or handed to a GPU API on its own
+constexpr uint64_t kSlotAlignment = 16384;
+
+uint64_t RoundUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t CurrentProcessId() {
+#ifdef _WIN32
+    return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+// Name for rings created without one; macOS limits shm names to 31 bytes
+std::string GenerateRingName() {
+    static std::atomic<uint32_t> counter{0};
+    return "wsfr-" + std::to_string(CurrentProcessId()) + "-" +
+           std::to_string(counter.fetch_add(1, std::memory_order_relaxed));
+}
+
+const SlotHeader* SlotHeaders(const uint8_t* base, const RingHeader* header) {
+    return reinterpret_cast<const SlotHeader*>(base + header->slot_headers_offset);
+}
+
+// Shared by both sides; maps are released the same way
+struct Mapping {
+    uint8_t* base = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE handle = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    void Release() {
+#ifdef _WIN32
+        if (base) {
+            UnmapViewOfFile(base);
+        }
+        if (handle) {
+            CloseHandle(handle);
+        }
+        handle = nullptr;
+#else
+        if (base) {
+            munmap(base, size);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = -1;
+#endif
+        base = nullptr;
+        size = 0;
+    }
+};
+
+#ifndef _WIN32
+std::string ErrnoMessage(const char* operation) {
+    return std::string(operation) + " failed: " + std::strerror(errno);
+}
+
+std::string ShmName(const std::string& name) {
+    return name[0] == '/' ? name : "/" + name;
+}
+#endif
+
+} // anonymous namespace
+
+// --- Writer ---
+
+struct SharedFrameRing::Impl {
+    Mapping mapping;
+    RingHeader* header = nullptr;
+    std::string locator;
+    std::string shm_name;   // Unlinked on Close when set
+
+    SlotHeader* Slot(uint32_t slot) {
+        return reinterpret_cast<SlotHeader*>(mapping.base + header->slot_headers_offset) + slot;
+    }
+};
+
+SharedFrameRing::SharedFrameRing() : impl_(std::make_unique<Impl>()) {}
+
+SharedFrameRing::~SharedFrameRing() {
+    Close();
+}
+
+bool SharedFrameRing::Create(const Config& config) {
+    Close();
+    last_error_.clear();
+
+    if (config.slot_count == 0 || config.slot_count > SharedRing::kMaxSlots) {
+        last_error_ = "Shared ring needs 1 to 255 slots";
+        return false;
+    }
+    if (config.slot_capacity == 0) {
+        last_error_ = "Shared ring slots need a capacity";
+        return false;
+    }
+
+    const uint64_t slot_headers_offset = RoundUp(sizeof(RingHeader), alignof(SlotHeader));
+    const uint64_t data_offset =
+        RoundUp(slot_headers_offset + static_cast<uint64_t>(config.slot_count) * sizeof(SlotHeader),
+                kSlotAlignment);
+    const uint64_t slot_stride = RoundUp(config.slot_capacity, kSlotAlignment);
+    const uint64_t total_size = data_offset + slot_stride * config.slot_count;
+
+    Mapping& mapping = impl_->mapping;
+    mapping.size = static_cast<size_t>(total_size);
+
+#ifdef _WIN32
+    std::string name = config.name.empty() ? GenerateRingName() : config.name;
+    if (name.find('\\') == std::string::npos) {
+        name = "Local\\" + name;
+    }
+    mapping.handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                        static_cast<DWORD>(total_size >> 32),
+                                        static_cast<DWORD>(total_size & 0xFFFFFFFF), name.c_str());
+    if (!mapping.handle || ::GetLastError() == ERROR_ALREADY_EXISTS) {
+        last_error_ = "CreateFileMapping failed for " + name;
+        mapping.Release();
+        return false;
+    }
+    mapping.base = static_cast<uint8_t*>(MapViewOfFile(mapping.handle, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (!mapping.base) {
+        last_error_ = "MapViewOfFile failed for " + name;
+        mapping.Release();
+        return false;
+    }
+    impl_->locator = name;
+#else
+#ifdef __linux__
+    if (config.name.empty()) {
+        mapping.fd = memfd_create("webp-screenshot-ring", MFD_CLOEXEC);
+        if (mapping.fd < 0) {
+            last_error_ = ErrnoMessage("memfd_create");
+            return false;
+        }
+        impl_->locator = "/proc/" + std::to_string(CurrentProcessId()) + "/fd/" + std::to_string(mapping.fd);
+    }
+#endif
+    if (mapping.fd < 0) {
+        const std::string name = ShmName(config.name.empty() ? GenerateRingName() : config.name);
+        // Owner-only, and never attach to a ring another writer left behind
+        mapping.fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+        if (mapping.fd < 0) {
+            last_error_ = ErrnoMessage("shm_open");
+            return false;
+        }
+        impl_->locator = name;
+        impl_->shm_name = name;
+    }
+
+    if (ftruncate(mapping.fd, static_cast<off_t>(total_size)) != 0) {
+        last_error_ = ErrnoMessage("ftruncate");
+        Close();
+        return false;
+    }
+    void* base = mmap(nullptr, mapping.size, PROT_READ | PROT_WRITE, MAP_SHARED, mapping.fd, 0);
+    if (base == MAP_FAILED) {
+        last_error_ = ErrnoMessage("mmap");
+        Close();
+        return false;
+    }
+    mapping.base = static_cast<uint8_t*>(base);
+#endif
+
+    // The new mapping is zero-filled; construct the headers in place
+    RingHeader* header = new (mapping.base) RingHeader();
+    header->magic = SharedRing::kMagic;
+    header->version = SharedRing::kVersion;
+    header->slot_count = config.slot_count;
+    header->writer_pid = CurrentProcessId();
+    header->slot_headers_offset = slot_headers_offset;
+    header->data_offset = data_offset;
+    header->slot_stride = slot_stride;
+    header->slot_capacity = config.slot_capacity;
+    header->latest.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    impl_->header = header;
+
+    for (uint32_t i = 0; i < config.slot_count; ++i) {
+        SlotHeader* slot = new (impl_->Slot(i)) SlotHeader();
+        slot->lock.store(0, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+}
+
+void SharedFrameRing::Close() {
+    if (impl_->header) {
+        impl_->header->closed.store(1, std::memory_order_release);
+        impl_->header = nullptr;
+    }
+    impl_->mapping.Release();
+#ifndef _WIN32
+    // Readers that already mapped the ring keep their mapping
+    if (!impl_->shm_name.empty()) {
+        shm_unlink(impl_->shm_name.c_str());
+    }
+#endif
+    impl_->shm_name.clear();
+    impl_->locator.clear();
+}
+
+bool SharedFrameRing::IsOpen() const {
+    return impl_->header != nullptr;
+}
+
+uint32_t SharedFrameRing::GetSlotCount() const {
+    return impl_->header ? impl_->header->slot_count : 0;
+}
+
+size_t SharedFrameRing::GetSlotCapacity() const {
+    return impl_->header ? static_cast<size_t>(impl_->header->slot_capacity) : 0;
+}
+
+uint8_t* SharedFrameRing::GetSlotData(uint32_t slot) {
+    if (!impl_->header || slot >= impl_->header->slot_count) {
+        return nullptr;
+    }
+    return impl_->mapping.base + impl_->header->data_offset + slot * impl_->header->slot_stride;
+}
+
+void SharedFrameRing::BeginWrite(uint32_t slot) {
+    if (!impl_->header || slot >= impl_->header->slot_count) {
+        return;
+    }
+    SlotHeader* header = impl_->Slot(slot);
+    const uint64_t lock = header->lock.load(std::memory_order_relaxed);
+    header->lock.store(lock | 1, std::memory_order_relaxed);
+    // Readers that see any of the new pixels also see the odd lock
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SharedFrameRing::Publish(uint32_t slot, const CapturedFrame& frame) {
+    if (!impl_->header || slot >= impl_->header->slot_count) {
+        return;
+    }
+    SlotHeader* header = impl_->Slot(slot);
+    header->sequence = frame.sequence;
+    header->timestamp_us = frame.timestamp_us;
+    header->width = frame.width;
+    header->height = frame.height;
+    header->stride = frame.stride;
+    header->format = frame.bytes_per_pixel == 3 ? SharedRing::kFormatRGB : SharedRing::kFormatRGBA;
+
+    if (!frame.dirty_rects) {
+        header->dirty_count = SharedRing::kNoDirtyRects;
+    } else if (frame.dirty_rects->size() <= SharedRing::kMaxDirtyRects) {
+        header->dirty_count = static_cast<uint32_t>(frame.dirty_rects->size());
+        std::copy(frame.dirty_rects->begin(), frame.dirty_rects->end(), header->dirty_rects);
+    } else {
+        uint32_t left = frame.width, top = frame.height, right = 0, bottom = 0;
+        for (const DirtyRect& rect : *frame.dirty_rects) {
+            left = std::min(left, rect.x);
+            top = std::min(top, rect.y);
+            right = std::max(right, rect.x + rect.width);
+            bottom = std::max(bottom, rect.y + rect.height);
+        }
+        header->dirty_count = 1;
+        header->dirty_rects[0] = DirtyRect{left, top, right - left, bottom - top};
+    }
+
+    const uint64_t lock = header->lock.load(std::memory_order_relaxed);
+    header->lock.store((lock | 1) + 1, std::memory_order_release);
+    impl_->header->latest.store(((frame.sequence + 1) << 8) | slot, std::memory_order_release);
+}
+
+void SharedFrameRing::Abandon(uint32_t slot) {
+    if (!impl_->header || slot >= impl_->header->slot_count) {
+        return;
+    }
+    SlotHeader* header = impl_->Slot(slot);
+    header->width = 0;
+    header->height = 0;
+    const uint64_t lock = header->lock.load(std::memory_order_relaxed);
+    header->lock.store((lock | 1) + 1, std::memory_order_release);
+}
+
+std::string SharedFrameRing::GetLocator() const {
+    return impl_->locator;
+}
+
+intptr_t SharedFrameRing::GetNativeHandle() const {
+#ifdef _WIN32
+    return reinterpret_cast<intptr_t>(impl_->mapping.handle);
+#else
+    return impl_->mapping.fd;
+#endif
+}
+
+// --- Reader ---
+
+struct SharedFrameReader::Impl {
+    Mapping mapping;
+    const RingHeader* header = nullptr;
+};
+
+SharedFrameReader::SharedFrameReader() : impl_(std::make_unique<Impl>()) {}
+
+SharedFrameReader::~SharedFrameReader() {
+    Close();
+}
+
+bool SharedFrameReader::Open(const std::string& locator) {
+    Close();
+    last_error_.clear();
+
+    if (locator.empty()) {
+        last_error_ = "Empty shared ring locator";
+        return false;
+    }
+
+    Mapping& mapping = impl_->mapping;
+#ifdef _WIN32
+    mapping.handle = OpenFileMappingA(FILE_MAP_READ, FALSE, locator.c_str());
+    if (!mapping.handle) {
+        last_error_ = "OpenFileMapping failed for " + locator;
+        return false;
+    }
+    mapping.base = static_cast<uint8_t*>(MapViewOfFile(mapping.handle, FILE_MAP_READ, 0, 0, 0));
+    MEMORY_BASIC_INFORMATION info = {};
+    if (!mapping.base || !VirtualQuery(mapping.base, &info, sizeof(info))) {
+        last_error_ = "MapViewOfFile failed for " + locator;
+        Close();
+        return false;
+    }
+    mapping.size = info.RegionSize;
+#else
+    // A memfd is reached through the writer's /proc entry, anything else is shm
+    mapping.fd = locator.compare(0, 6, "/proc/") == 0 ? open(locator.c_str(), O_RDONLY | O_CLOEXEC)
+                                                      : shm_open(ShmName(locator).c_str(), O_RDONLY, 0);
+    struct stat info = {};
+    if (mapping.fd < 0 || fstat(mapping.fd, &info) != 0) {
+        last_error_ = ErrnoMessage("Opening the shared ring");
+        Close();
+        return false;
+    }
+    mapping.size = static_cast<size_t>(info.st_size);
+    void* base = mmap(nullptr, mapping.size, PROT_READ, MAP_SHARED, mapping.fd, 0);
+    if (base == MAP_FAILED) {
+        mapping.base = nullptr;
+        last_error_ = ErrnoMessage("mmap");
+        Close();
+        return false;
+    }
+    mapping.base = static_cast<uint8_t*>(base);
+#endif
+
+    const auto* header = reinterpret_cast<const RingHeader*>(mapping.base);
+    if (mapping.size < sizeof(RingHeader) || header->magic != SharedRing::kMagic ||
+        header->version != SharedRing::kVersion) {
+        last_error_ = "Not a version 1 shared frame ring";
+        Close();
+        return false;
+    }
+    if (header->slot_count == 0 || header->slot_count > SharedRing::kMaxSlots ||
+        header->data_offset + header->slot_stride * header->slot_count > mapping.size ||
+        header->slot_capacity > header->slot_stride) {
+        last_error_ = "Shared frame ring header is inconsistent";
+        Close();
+        return false;
+    }
+
+    impl_->header = header;
+    return true;
+}
+
+void SharedFrameReader::Close() {
+    impl_->header = nullptr;
+    impl_->mapping.Release();
+}
+
+bool SharedFrameReader::AcquireLatest(SharedFrameView& view, uint64_t min_sequence) {
+    const RingHeader* ring = impl_->header;
+    if (!ring) {
+        return false;
+    }
+
+    const uint64_t latest = ring->latest.load(std::memory_order_acquire);
+    if (latest == 0) {
+        return false;
+    }
+    const uint32_t slot = static_cast<uint32_t>(latest & 0xFF);
+    const uint64_t sequence = (latest >> 8) - 1;
+    if (slot >= ring->slot_count || sequence < min_sequence) {
+        return false;
+    }
+
+    const SlotHeader* header = SlotHeaders(impl_->mapping.base, ring) + slot;
+    const uint64_t lock = header->lock.load(std::memory_order_acquire);
+    if (lock & 1) {
+        return false;
+    }
+
+    SharedFrameView candidate;
+    candidate.sequence = header->sequence;
+    candidate.timestamp_us = header->timestamp_us;
+    candidate.width = header->width;
+    candidate.height = header->height;
+    candidate.stride = header->stride;
+    candidate.format = header->format;
+    const uint32_t dirty_count = header->dirty_count;
+    if (dirty_count != SharedRing::kNoDirtyRects) {
+        candidate.has_dirty_rects = true;
+        candidate.dirty_rects.assign(header->dirty_rects,
+                                     header->dirty_rects + std::min(dirty_count, SharedRing::kMaxDirtyRects));
+    }
+
+    // The slot was refilled or abandoned while the header was copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->lock.load(std::memory_order_relaxed) != lock || candidate.sequence != sequence ||
+        candidate.width == 0 ||
+        static_cast<uint64_t>(candidate.stride) * candidate.height > ring->slot_capacity) {
+        return false;
+    }
+
+    candidate.slot = slot;
+    candidate.lock = lock;
+    candidate.data = impl_->mapping.base + ring->data_offset + slot * ring->slot_stride;
+    view = std::move(candidate);
+    return true;
+}
+
+bool SharedFrameReader::IsIntact(const SharedFrameView& view) const {
+    const RingHeader* ring = impl_->header;
+    if (!ring || view.slot >= ring->slot_count) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const SlotHeader* header = SlotHeaders(impl_->mapping.base, ring) + view.slot;
+    return header->lock.load(std::memory_order_relaxed) == view.lock;
+}
+
+bool SharedFrameReader::IsWriterClosed() const {
+    return !impl_->header || impl_->header->closed.load(std::memory_order_acquire) != 0;
+}
+
+} // namespace WebPScreenshot
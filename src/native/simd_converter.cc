@@ -1,175 +1,180 @@
 #include "common/screenshot_common.h"
-
-// SIMD intrinsics headers
-#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
-    #define WEBP_USE_SSE2 1
-    #include <emmintrin.h>
-#endif
-
-#if defined(__SSE4_1__) || (defined(_MSC_VER) && _MSC_VER >= 1500)
-    #define WEBP_USE_SSE41 1
-    #include <smmintrin.h>
-#endif
-
-#if defined(__AVX2__)
-    #define WEBP_USE_AVX2 1
-    #include <immintrin.h>
-#endif
-
-#if defined(__ARM_NEON) || defined(__aarch64__)
-    #define WEBP_USE_NEON 1
-    #include <arm_neon.h>
-#endif
+#include "common/simd_dispatch.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 
 namespace WebPScreenshot {
 namespace SIMD {
 
-// Check CPU capabilities at runtime
-struct CPUInfo {
+namespace {
+
+// What the CPU and OS support; AVX levels also need the OS to save the
+// wider register state
+struct CPUFeatures {
     bool has_sse2 = false;
     bool has_sse41 = false;
     bool has_avx2 = false;
+    bool has_avx512 = false;   // F + BW + VBMI
     bool has_neon = false;
-    
-    CPUInfo() {
-        DetectCPUFeatures();
-    }
-    
-private:
-    void DetectCPUFeatures();
 };
 
-static CPUInfo g_cpu_info;
-
-void CPUInfo::DetectCPUFeatures() {
-#if defined(_MSC_VER)
-    // Microsoft Visual C++
+CPUFeatures DetectCPUFeatures() {
+    CPUFeatures features;
+#if defined(WEBP_USE_X86) && defined(_MSC_VER)
     int cpu_info[4];
+    __cpuid(cpu_info, 0);
+    const int max_leaf = cpu_info[0];
+
     __cpuid(cpu_info, 1);
-    
-    has_sse2 = (cpu_info[3] & (1 << 26)) != 0;
-    has_sse41 = (cpu_info[2] & (1 << 19)) != 0;
-    
-    // Check for AVX2
-    __cpuid(cpu_info, 7);
-    has_avx2 = (cpu_info[1] & (1 << 5)) != 0;
-    
-#elif defined(__GNUC__) || defined(__clang__)
-    // GCC/Clang
-    #ifdef WEBP_USE_SSE2
-    has_sse2 = __builtin_cpu_supports("sse2");
-    #endif
-    
-    #ifdef WEBP_USE_SSE41
-    has_sse41 = __builtin_cpu_supports("sse4.1");
-    #endif
-    
-    #ifdef WEBP_USE_AVX2
-    has_avx2 = __builtin_cpu_supports("avx2");
-    #endif
-    
+    features.has_sse2 = (cpu_info[3] & (1 << 26)) != 0;
+    features.has_sse41 = (cpu_info[2] & (1 << 19)) != 0;
+    const bool os_saves_state = (cpu_info[2] & (1 << 27)) != 0;
+    const unsigned long long xcr0 = os_saves_state ? _xgetbv(0) : 0;
+
+    if (max_leaf >= 7) {
+        __cpuidex(cpu_info, 7, 0);
+        features.has_avx2 = (cpu_info[1] & (1 << 5)) != 0 && (xcr0 & 0x06) == 0x06;
+        features.has_avx512 = (cpu_info[1] & (1 << 16)) != 0 &&   // AVX512F
+                              (cpu_info[1] & (1 << 30)) != 0 &&   // AVX512BW
+                              (cpu_info[2] & (1 << 1)) != 0 &&    // AVX512VBMI
+                              (xcr0 & 0xE6) == 0xE6;
+    }
+#elif defined(WEBP_USE_X86)
+    // libgcc and compiler-rt check XCR0 before reporting AVX levels
+    __builtin_cpu_init();
+    features.has_sse2 = __builtin_cpu_supports("sse2");
+    features.has_sse41 = __builtin_cpu_supports("sse4.1");
+    features.has_avx2 = __builtin_cpu_supports("avx2");
+    features.has_avx512 = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                          __builtin_cpu_supports("avx512vbmi");
 #endif
 
 #ifdef WEBP_USE_NEON
-    has_neon = true; // Assume NEON is available if compiled for ARM with NEON
+    features.has_neon = true; // Part of the baseline wherever it is compiled in
 #endif
+    return features;
+}
+
+const CPUFeatures& DetectedFeatures() {
+    static const CPUFeatures features = DetectCPUFeatures();
+    return features;
 }
 
-// BGRA to RGBA conversion functions
+// BGRA <-> RGBA: swap R and B. Every kernel reads a block before writing it,
+// so src == dst converts in place. kForceOpaque sets alpha to 0xFF for
+// sources whose fourth byte is undefined (GDI, XImage).
 
-void ConvertBGRAToRGBA_C(const uint8_t* bgra, uint8_t* rgba, uint32_t pixel_count) {
+template <bool kForceOpaque>
+void SwapRedBlue_C(const uint8_t* src, uint8_t* dst, uint32_t pixel_count) {
     for (uint32_t i = 0; i < pixel_count; ++i) {
-        rgba[i * 4 + 0] = bgra[i * 4 + 2]; // R
-        rgba[i * 4 + 1] = bgra[i * 4 + 1]; // G
-        rgba[i * 4 + 2] = bgra[i * 4 + 0]; // B
-        rgba[i * 4 + 3] = bgra[i * 4 + 3]; // A
-    }
-}
-
-#ifdef WEBP_USE_SSE2
-void ConvertBGRAToRGBA_SSE2(const uint8_t* bgra, uint8_t* rgba, uint32_t pixel_count) {
-    const uint32_t simd_pixels = pixel_count & ~3; // Process 4 pixels at a time
-    
-    // Shuffle mask for BGRA -> RGBA conversion
-    const __m128i shuffle_mask = _mm_setr_epi8(
-        2, 1, 0, 3,  // First pixel: B->R, G->G, R->B, A->A
-        6, 5, 4, 7,  // Second pixel
-        10, 9, 8, 11, // Third pixel
-        14, 13, 12, 15 // Fourth pixel
-    );
-    
-    for (uint32_t i = 0; i < simd_pixels; i += 4) {
-        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bgra + i * 4));
-        __m128i converted = _mm_shuffle_epi8(pixels, shuffle_mask);
-        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), converted);
-    }
-    
-    // Handle remaining pixels with scalar code
-    for (uint32_t i = simd_pixels; i < pixel_count; ++i) {
-        rgba[i * 4 + 0] = bgra[i * 4 + 2];
-        rgba[i * 4 + 1] = bgra[i * 4 + 1];
-        rgba[i * 4 + 2] = bgra[i * 4 + 0];
-        rgba[i * 4 + 3] = bgra[i * 4 + 3];
+        const uint8_t* s = src + i * 4;
+        uint8_t* d = dst + i * 4;
+        const uint8_t b = s[0];
+        const uint8_t g = s[1];
+        const uint8_t r = s[2];
+        const uint8_t a = kForceOpaque ? 0xFF : s[3];
+        d[0] = r;
+        d[1] = g;
+        d[2] = b;
+        d[3] = a;
     }
 }
-#endif
 
-#ifdef WEBP_USE_AVX2
-void ConvertBGRAToRGBA_AVX2(const uint8_t* bgra, uint8_t* rgba, uint32_t pixel_count) {
-    const uint32_t simd_pixels = pixel_count & ~7; // Process 8 pixels at a time
-    
-    // Shuffle mask for BGRA -> RGBA conversion (32 bytes for 8 pixels)
+#ifdef WEBP_USE_X86
+// SSE2 has no byte shuffle; R and B trade places with 32-bit shifts
+template <bool kForceOpaque>
+WEBP_TARGET_SSE2 void SwapRedBlue_SSE2(const uint8_t* src, uint8_t* dst, uint32_t pixel_count) {
+    const __m128i green_alpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00));
+    const __m128i low_byte = _mm_set1_epi32(0xFF);
+    const __m128i alpha = _mm_set1_epi32(kForceOpaque ? static_cast<int>(0xFF000000) : 0);
+
+    uint32_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        const __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), low_byte);
+        const __m128i blue = _mm_slli_epi32(_mm_and_si128(pixels, low_byte), 16);
+        const __m128i swapped = _mm_or_si128(_mm_and_si128(pixels, green_alpha), _mm_or_si128(red, blue));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(swapped, alpha));
+    }
+    SwapRedBlue_C<kForceOpaque>(src + i * 4, dst + i * 4, pixel_count - i);
+}
+
+// pshufb is SSSE3, which every SSE4.1 CPU has
+template <bool kForceOpaque>
+WEBP_TARGET_SSE41 void SwapRedBlue_SSE41(const uint8_t* src, uint8_t* dst, uint32_t pixel_count) {
+    const __m128i shuffle_mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m128i alpha = _mm_set1_epi32(kForceOpaque ? static_cast<int>(0xFF000000) : 0);
+
+    uint32_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        const __m128i swapped = _mm_shuffle_epi8(pixels, shuffle_mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128(swapped, alpha));
+    }
+    SwapRedBlue_C<kForceOpaque>(src + i * 4, dst + i * 4, pixel_count - i);
+}
+
+template <bool kForceOpaque>
+WEBP_TARGET_AVX2 void SwapRedBlue_AVX2(const uint8_t* src, uint8_t* dst, uint32_t pixel_count) {
     const __m256i shuffle_mask = _mm256_setr_epi8(
-        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, // First 4 pixels
-        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15  // Second 4 pixels
-    );
-    
-    for (uint32_t i = 0; i < simd_pixels; i += 8) {
-        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bgra + i * 4));
-        __m256i converted = _mm256_shuffle_epi8(pixels, shuffle_mask);
-        _mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i * 4), converted);
-    }
-    
-    // Handle remaining pixels with scalar code
-    for (uint32_t i = simd_pixels; i < pixel_count; ++i) {
-        rgba[i * 4 + 0] = bgra[i * 4 + 2];
-        rgba[i * 4 + 1] = bgra[i * 4 + 1];
-        rgba[i * 4 + 2] = bgra[i * 4 + 0];
-        rgba[i * 4 + 3] = bgra[i * 4 + 3];
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256i alpha = _mm256_set1_epi32(kForceOpaque ? static_cast<int>(0xFF000000) : 0);
+
+    uint32_t i = 0;
+    for (; i + 8 <= pixel_count; i += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        const __m256i swapped = _mm256_shuffle_epi8(pixels, shuffle_mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_or_si256(swapped, alpha));
+    }
+    SwapRedBlue_C<kForceOpaque>(src + i * 4, dst + i * 4, pixel_count - i);
+}
+
+#ifdef WEBP_USE_AVX512
+alignas(64) const uint8_t kSwapRedBlueIndices[64] = {
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+};
+
+// 16 pixels per step; the tail is one masked load/store instead of a scalar loop
+template <bool kForceOpaque>
+WEBP_TARGET_AVX512 void SwapRedBlue_AVX512(const uint8_t* src, uint8_t* dst, uint32_t pixel_count) {
+    const __m512i shuffle_mask = _mm512_load_si512(kSwapRedBlueIndices);
+    const __m512i alpha = _mm512_set1_epi32(kForceOpaque ? static_cast<int>(0xFF000000) : 0);
+
+    uint32_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        const __m512i pixels = _mm512_loadu_si512(src + i * 4);
+        _mm512_storeu_si512(dst + i * 4, _mm512_or_si512(_mm512_shuffle_epi8(pixels, shuffle_mask), alpha));
+    }
+    if (i < pixel_count) {
+        const __mmask16 lanes = static_cast<__mmask16>((1u << (pixel_count - i)) - 1);
+        const __m512i pixels = _mm512_maskz_loadu_epi32(lanes, src + i * 4);
+        _mm512_mask_storeu_epi32(dst + i * 4, lanes,
+                                 _mm512_or_si512(_mm512_shuffle_epi8(pixels, shuffle_mask), alpha));
     }
 }
 #endif
+#endif
 
 #ifdef WEBP_USE_NEON
-void ConvertBGRAToRGBA_NEON(const uint8_t* bgra, uint8_t* rgba, uint32_t pixel_count) {
-    const uint32_t simd_pixels = pixel_count & ~3; // Process 4 pixels at a time
-    
-    for (uint32_t i = 0; i < simd_pixels; i += 4) {
-        uint8x16_t pixels = vld1q_u8(bgra + i * 4);
-        
-        // Extract color channels
-        uint8x16_t b = vqtbl1q_u8(pixels, (uint8x16_t){0, 4, 8, 12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
-        uint8x16_t g = vqtbl1q_u8(pixels, (uint8x16_t){1, 5, 9, 13, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
-        uint8x16_t r = vqtbl1q_u8(pixels, (uint8x16_t){2, 6, 10, 14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
-        uint8x16_t a = vqtbl1q_u8(pixels, (uint8x16_t){3, 7, 11, 15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
-        
-        // Reconstruct as RGBA
-        uint8x16_t result;
-        result = vqtbl1q_u8(r, (uint8x16_t){0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3});
-        result = vqtbl1q_u8(g, (uint8x16_t){0, 1, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3}) | result;
-        result = vqtbl1q_u8(b, (uint8x16_t){0, 0, 2, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3}) | result;
-        result = vqtbl1q_u8(a, (uint8x16_t){0, 0, 0, 3, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3}) | result;
-        
-        vst1q_u8(rgba + i * 4, result);
-    }
-    
-    // Handle remaining pixels with scalar code
-    for (uint32_t i = simd_pixels; i < pixel_count; ++i) {
-        rgba[i * 4 + 0] = bgra[i * 4 + 2];
-        rgba[i * 4 + 1] = bgra[i * 4 + 1];
-        rgba[i * 4 + 2] = bgra[i * 4 + 0];
-        rgba[i * 4 + 3] = bgra[i * 4 + 3];
+template <bool kForceOpaque>
+void SwapRedBlue_NEON(const uint8_t* src, uint8_t* dst, uint32_t pixel_count) {
+    uint32_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(src + i * 4);
+        const uint8x16_t blue = pixels.val[0];
+        pixels.val[0] = pixels.val[2];
+        pixels.val[2] = blue;
+        if (kForceOpaque) {
+            pixels.val[3] = vdupq_n_u8(0xFF);
+        }
+        vst4q_u8(dst + i * 4, pixels);
     }
+    SwapRedBlue_C<kForceOpaque>(src + i * 4, dst + i * 4, pixel_count - i);
 }
 #endif
 
@@ -184,152 +189,834 @@ void ConvertRGBAToRGB_C(const uint8_t* rgba, uint8_t* rgb, uint32_t pixel_count)
     }
 }
 
-#ifdef WEBP_USE_SSE2
-void ConvertRGBAToRGB_SSE2(const uint8_t* rgba, uint8_t* rgb, uint32_t pixel_count) {
-    const uint32_t simd_pixels = pixel_count & ~3; // Process 4 pixels at a time
-    
-    // Shuffle masks to pack RGBA to RGB
-    const __m128i shuffle_mask1 = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
-    
-    for (uint32_t i = 0; i < simd_pixels; i += 4) {
-        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
-        __m128i packed = _mm_shuffle_epi8(pixels, shuffle_mask1);
-        
-        // Store 12 bytes (3 pixels * 4 bytes each = 12 bytes)
+#ifdef WEBP_USE_X86
+WEBP_TARGET_SSE41 void ConvertRGBAToRGB_SSE41(const uint8_t* rgba, uint8_t* rgb, uint32_t pixel_count) {
+    const __m128i pack_mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    uint32_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+        const __m128i packed = _mm_shuffle_epi8(pixels, pack_mask);
+
+        // 12 bytes out: 8 + 4 so the store never runs past the row
         _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb + i * 3), packed);
-        uint32_t last4 = _mm_extract_epi32(packed, 2);
-        *reinterpret_cast<uint32_t*>(rgb + i * 3 + 8) = last4;
+        const int32_t last = _mm_extract_epi32(packed, 2);
+        std::memcpy(rgb + i * 3 + 8, &last, 4);
+    }
+    ConvertRGBAToRGB_C(rgba + i * 4, rgb + i * 3, pixel_count - i);
+}
+
+WEBP_TARGET_AVX2 void ConvertRGBAToRGB_AVX2(const uint8_t* rgba, uint8_t* rgb, uint32_t pixel_count) {
+    // Pack 12 bytes per lane, then close the gap between the lanes
+    const __m256i pack_mask = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+    uint32_t i = 0;
+    for (; i + 8 <= pixel_count; i += 8) {
+        const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + i * 4));
+        const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, pack_mask), compact);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb + i * 3), _mm256_castsi256_si128(packed));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(rgb + i * 3 + 16), _mm256_extracti128_si256(packed, 1));
+    }
+    ConvertRGBAToRGB_C(rgba + i * 4, rgb + i * 3, pixel_count - i);
+}
+
+#ifdef WEBP_USE_AVX512
+// vpermb (VBMI) gathers the 48 RGB bytes of 16 pixels across all four lanes
+alignas(64) const uint8_t kPackRGBIndices[64] = {
+    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 16, 17, 18, 20,
+    21, 22, 24, 25, 26, 28, 29, 30, 32, 33, 34, 36, 37, 38, 40, 41,
+    42, 44, 45, 46, 48, 49, 50, 52, 53, 54, 56, 57, 58, 60, 61, 62,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+WEBP_TARGET_AVX512 void ConvertRGBAToRGB_AVX512(const uint8_t* rgba, uint8_t* rgb, uint32_t pixel_count) {
+    const __m512i pack = _mm512_load_si512(kPackRGBIndices);
+    const __mmask64 rgb_bytes = (1ull << 48) - 1;
+
+    uint32_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        const __m512i pixels = _mm512_loadu_si512(rgba + i * 4);
+        _mm512_mask_storeu_epi8(rgb + i * 3, rgb_bytes, _mm512_maskz_permutexvar_epi8(rgb_bytes, pack, pixels));
+    }
+    if (i < pixel_count) {
+        const uint32_t remaining = pixel_count - i;
+        const __m512i pixels = _mm512_maskz_loadu_epi32(static_cast<__mmask16>((1u << remaining) - 1),
+                                                        rgba + i * 4);
+        const __mmask64 tail_bytes = (1ull << (remaining * 3)) - 1;
+        _mm512_mask_storeu_epi8(rgb + i * 3, tail_bytes, _mm512_maskz_permutexvar_epi8(tail_bytes, pack, pixels));
+    }
+}
+#endif
+#endif
+
+#ifdef WEBP_USE_NEON
+void ConvertRGBAToRGB_NEON(const uint8_t* rgba, uint8_t* rgb, uint32_t pixel_count) {
+    uint32_t i = 0;
+    for (; i + 16 <= pixel_count; i += 16) {
+        const uint8x16x4_t pixels = vld4q_u8(rgba + i * 4);
+        uint8x16x3_t packed;
+        packed.val[0] = pixels.val[0];
+        packed.val[1] = pixels.val[1];
+        packed.val[2] = pixels.val[2];
+        vst3q_u8(rgb + i * 3, packed);
+    }
+    ConvertRGBAToRGB_C(rgba + i * 4, rgb + i * 3, pixel_count - i);
+}
+#endif
+
+// Frame differencing: offset of the first and of the last byte where two
+// buffers differ, `size` when they match
+
+inline uint32_t LowestSetBit(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+}
+
+inline uint32_t HighestSetBit(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return index;
+#else
+    return 31 - static_cast<uint32_t>(__builtin_clz(mask));
+#endif
+}
+
+size_t FirstDifference_C(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t i = 0;
+    while (i < size && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+size_t LastDifference_C(const uint8_t* a, const uint8_t* b, size_t size) {
+    for (size_t i = size; i > 0; --i) {
+        if (a[i - 1] != b[i - 1]) {
+            return i - 1;
+        }
+    }
+    return size;
+}
+
+#ifdef WEBP_USE_X86
+WEBP_TARGET_SSE2 size_t FirstDifference_SSE2(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        const uint32_t differ = ~static_cast<uint32_t>(_mm_movemask_epi8(equal)) & 0xFFFF;
+        if (differ) {
+            return i + LowestSetBit(differ);
+        }
+    }
+    return i + FirstDifference_C(a + i, b + i, size - i);
+}
+
+WEBP_TARGET_SSE2 size_t LastDifference_SSE2(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t end = size;
+    for (; end >= 16; end -= 16) {
+        const __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + end - 16)),
+                                             _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + end - 16)));
+        const uint32_t differ = ~static_cast<uint32_t>(_mm_movemask_epi8(equal)) & 0xFFFF;
+        if (differ) {
+            return end - 16 + HighestSetBit(differ);
+        }
+    }
+    const size_t last = LastDifference_C(a, b, end);
+    return last == end ? size : last;
+}
+
+WEBP_TARGET_AVX2 size_t FirstDifference_AVX2(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        const uint32_t differ = ~static_cast<uint32_t>(_mm256_movemask_epi8(equal));
+        if (differ) {
+            return i + LowestSetBit(differ);
+        }
+    }
+    return i + FirstDifference_SSE2(a + i, b + i, size - i);
+}
+
+WEBP_TARGET_AVX2 size_t LastDifference_AVX2(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t end = size;
+    for (; end >= 32; end -= 32) {
+        const __m256i equal = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + end - 32)),
+                                                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + end - 32)));
+        const uint32_t differ = ~static_cast<uint32_t>(_mm256_movemask_epi8(equal));
+        if (differ) {
+            return end - 32 + HighestSetBit(differ);
+        }
+    }
+    const size_t last = LastDifference_SSE2(a, b, end);
+    return last == end ? size : last;
+}
+#endif
+
+#ifdef WEBP_USE_NEON
+// No movemask on NEON; a mismatching block is located with the scalar loop
+size_t FirstDifference_NEON(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        const uint64x2_t differ = vreinterpretq_u64_u8(veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+        if ((vgetq_lane_u64(differ, 0) | vgetq_lane_u64(differ, 1)) != 0) {
+            return i + FirstDifference_C(a + i, b + i, 16);
+        }
+    }
+    return i + FirstDifference_C(a + i, b + i, size - i);
+}
+
+size_t LastDifference_NEON(const uint8_t* a, const uint8_t* b, size_t size) {
+    size_t end = size;
+    for (; end >= 16; end -= 16) {
+        const uint64x2_t differ = vreinterpretq_u64_u8(veorq_u8(vld1q_u8(a + end - 16), vld1q_u8(b + end - 16)));
+        if ((vgetq_lane_u64(differ, 0) | vgetq_lane_u64(differ, 1)) != 0) {
+            return end - 16 + LastDifference_C(a + end - 16, b + end - 16, 16);
+        }
+    }
+    const size_t last = LastDifference_C(a, b, end);
+    return last == end ? size : last;
+}
+#endif
+
+// 2x2 box downsampling of one 8-bit plane: output pixel i of a row pair is
+// the rounded mean of input columns 2i and 2i + 1 of both rows. Kernels take
+// the whole pairs they can and return how many output pixels they wrote.
+
+uint32_t Downsample2x_C(const uint8_t* row0, const uint8_t* row1, uint8_t* dst,
+                        uint32_t start, uint32_t src_width) {
+    const uint32_t dst_width = (src_width + 1) / 2;
+    for (uint32_t i = start; i < dst_width; ++i) {
+        const uint32_t x0 = 2 * i;
+        const uint32_t x1 = std::min(x0 + 1, src_width - 1);  // An odd last column pairs with itself
+        dst[i] = static_cast<uint8_t>((row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2);
+    }
+    return dst_width;
+}
+
+#ifdef WEBP_USE_X86
+// Adds each byte pair of a row into 16-bit lanes
+WEBP_TARGET_SSE2 inline __m128i PairSums_SSE2(__m128i row) {
+    const __m128i low_bytes = _mm_set1_epi16(0x00FF);
+    return _mm_add_epi16(_mm_and_si128(row, low_bytes), _mm_srli_epi16(row, 8));
+}
+
+WEBP_TARGET_SSE2 uint32_t Downsample2x_SSE2(const uint8_t* row0, const uint8_t* row1, uint8_t* dst,
+                                            uint32_t src_width) {
+    const __m128i rounding = _mm_set1_epi16(2);
+    uint32_t i = 0;
+    for (; 2 * i + 32 <= src_width; i += 16) {
+        const uint8_t* a = row0 + 2 * i;
+        const uint8_t* b = row1 + 2 * i;
+        const __m128i first = _mm_add_epi16(
+            PairSums_SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a))),
+            PairSums_SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b))));
+        const __m128i second = _mm_add_epi16(
+            PairSums_SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 16))),
+            PairSums_SSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 16))));
+        const __m128i packed = _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(first, rounding), 2),
+                                                _mm_srli_epi16(_mm_add_epi16(second, rounding), 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    return i;
+}
+
+WEBP_TARGET_AVX2 inline __m256i PairSums_AVX2(__m256i row) {
+    const __m256i low_bytes = _mm256_set1_epi16(0x00FF);
+    return _mm256_add_epi16(_mm256_and_si256(row, low_bytes), _mm256_srli_epi16(row, 8));
+}
+
+WEBP_TARGET_AVX2 uint32_t Downsample2x_AVX2(const uint8_t* row0, const uint8_t* row1, uint8_t* dst,
+                                            uint32_t src_width) {
+    const __m256i rounding = _mm256_set1_epi16(2);
+    uint32_t i = 0;
+    for (; 2 * i + 64 <= src_width; i += 32) {
+        const uint8_t* a = row0 + 2 * i;
+        const uint8_t* b = row1 + 2 * i;
+        const __m256i first = _mm256_add_epi16(
+            PairSums_AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a))),
+            PairSums_AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b))));
+        const __m256i second = _mm256_add_epi16(
+            PairSums_AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + 32))),
+            PairSums_AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 32))));
+        // packus works per 128-bit lane; the permute restores source order
+        const __m256i packed = _mm256_packus_epi16(_mm256_srli_epi16(_mm256_add_epi16(first, rounding), 2),
+                                                   _mm256_srli_epi16(_mm256_add_epi16(second, rounding), 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    return i + Downsample2x_SSE2(row0 + 2 * i, row1 + 2 * i, dst + i, src_width - 2 * i);
+}
+#endif
+
+#ifdef WEBP_USE_NEON
+uint32_t Downsample2x_NEON(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, uint32_t src_width) {
+    uint32_t i = 0;
+    for (; 2 * i + 32 <= src_width; i += 16) {
+        const uint16x8_t first = vaddq_u16(vpaddlq_u8(vld1q_u8(row0 + 2 * i)), vpaddlq_u8(vld1q_u8(row1 + 2 * i)));
+        const uint16x8_t second = vaddq_u16(vpaddlq_u8(vld1q_u8(row0 + 2 * i + 16)),
+                                            vpaddlq_u8(vld1q_u8(row1 + 2 * i + 16)));
+        vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(first, 2), vrshrn_n_u16(second, 2)));
+    }
+    return i;
+}
+#endif
+
+// Fused RGB/BGR(A) -> YUV420(A) conversion
+
+// Fixed-point BT.601, same coefficients and rounding as libwebp's
+// VP8RGBToY/U/V so output matches WebPPictureImportRGBA bit for bit
+constexpr int kYUVFix = 16;
+constexpr int kYUVHalf = 1 << (kYUVFix - 1);
+constexpr int kYRounding = kYUVHalf + (16 << kYUVFix);
+constexpr int kUVRounding = (kYUVHalf << 2) + (128 << (kYUVFix + 2));
+
+inline uint8_t RGBToY(int r, int g, int b) {
+    return static_cast<uint8_t>((16839 * r + 33059 * g + 6420 * b + kYRounding) >> kYUVFix);
+}
+
+inline uint8_t ClipUV(int uv) {
+    uv = (uv + kUVRounding) >> (kYUVFix + 2);
+    return static_cast<uint8_t>((uv & ~0xff) == 0 ? uv : (uv < 0) ? 0 : 255);
+}
+
+// r, g, b are sums over a 2x2 block
+inline uint8_t RGBToU(int r, int g, int b) {
+    return ClipUV(-9719 * r - 19081 * g + 28800 * b);
+}
+
+inline uint8_t RGBToV(int r, int g, int b) {
+    return ClipUV(28800 * r - 24116 * g - 4684 * b);
+}
+
+// One source row pair -> two Y rows, one U/V row and optionally two A rows,
+// starting at an even column. row1 == row0 and y1/a1 == nullptr on an odd
+// last row. Returns true if any alpha sample written is not 0xFF.
+bool ConvertRowPairToYUV420_C(const uint8_t* row0, const uint8_t* row1,
+                              uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                              uint8_t* a0, uint8_t* a1, uint32_t col, uint32_t width,
+                              uint32_t step, bool bgr_order) {
+    const uint32_t ri = bgr_order ? 2 : 0;
+    const uint32_t bi = bgr_order ? 0 : 2;
+    bool transparent = false;
+
+    for (; col < width; col += 2) {
+        const uint32_t next = (col + 1 < width) ? col + 1 : col;
+        const uint8_t* p00 = row0 + col * step;
+        const uint8_t* p01 = row0 + next * step;
+        const uint8_t* p10 = row1 + col * step;
+        const uint8_t* p11 = row1 + next * step;
+
+        y0[col] = RGBToY(p00[ri], p00[1], p00[bi]);
+        if (next != col) y0[next] = RGBToY(p01[ri], p01[1], p01[bi]);
+        if (y1) {
+            y1[col] = RGBToY(p10[ri], p10[1], p10[bi]);
+            if (next != col) y1[next] = RGBToY(p11[ri], p11[1], p11[bi]);
+        }
+
+        const int r = p00[ri] + p01[ri] + p10[ri] + p11[ri];
+        const int g = p00[1] + p01[1] + p10[1] + p11[1];
+        const int b = p00[bi] + p01[bi] + p10[bi] + p11[bi];
+        u[col / 2] = RGBToU(r, g, b);
+        v[col / 2] = RGBToV(r, g, b);
+
+        if (a0) {
+            a0[col] = p00[3];
+            a0[next] = p01[3];
+            transparent |= (p00[3] & p01[3]) != 0xFF;
+            if (a1) {
+                a1[col] = p10[3];
+                a1[next] = p11[3];
+                transparent |= (p10[3] & p11[3]) != 0xFF;
+            }
+        }
+    }
+
+    return transparent;
+}
+
+#ifdef WEBP_USE_X86
+WEBP_TARGET_SSE41 inline __m128i Luma_SSE41(__m128i r, __m128i g, __m128i b) {
+    __m128i y = _mm_add_epi32(_mm_mullo_epi32(r, _mm_set1_epi32(16839)),
+                              _mm_mullo_epi32(g, _mm_set1_epi32(33059)));
+    y = _mm_add_epi32(y, _mm_mullo_epi32(b, _mm_set1_epi32(6420)));
+    return _mm_srli_epi32(_mm_add_epi32(y, _mm_set1_epi32(kYRounding)), kYUVFix);
+}
+
+WEBP_TARGET_SSE41 inline __m128i Chroma_SSE41(__m128i r, __m128i g, __m128i b, int kr, int kg, int kb) {
+    __m128i c = _mm_add_epi32(_mm_mullo_epi32(r, _mm_set1_epi32(kr)),
+                              _mm_mullo_epi32(g, _mm_set1_epi32(kg)));
+    c = _mm_add_epi32(c, _mm_mullo_epi32(b, _mm_set1_epi32(kb)));
+    c = _mm_srai_epi32(_mm_add_epi32(c, _mm_set1_epi32(kUVRounding)), kYUVFix + 2);
+    c = _mm_packs_epi32(c, c);
+    return _mm_packus_epi16(c, c);  // Saturation == ClipUV
+}
+
+// 4 pixels per step. Y coefficients exceed int16, so products are formed in
+// 32-bit lanes; U/V use horizontal pair sums of the two rows.
+WEBP_TARGET_SSE41 uint32_t ConvertRowPairToYUV420_SSE41(const uint8_t* row0, const uint8_t* row1,
+                                      uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                                      uint8_t* a0, uint8_t* a1, uint32_t width,
+                                      bool bgr_order, bool* transparent) {
+    const __m128i r_shift = _mm_cvtsi32_si128(bgr_order ? 16 : 0);
+    const __m128i b_shift = _mm_cvtsi32_si128(bgr_order ? 0 : 16);
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i alpha_and = _mm_set1_epi32(-1);
+
+    uint32_t col = 0;
+    for (; col + 4 <= width; col += 4) {
+        const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + col * 4));
+        const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + col * 4));
+
+        const __m128i r0 = _mm_and_si128(_mm_srl_epi32(p0, r_shift), mask);
+        const __m128i g0 = _mm_and_si128(_mm_srli_epi32(p0, 8), mask);
+        const __m128i b0 = _mm_and_si128(_mm_srl_epi32(p0, b_shift), mask);
+        const __m128i r1 = _mm_and_si128(_mm_srl_epi32(p1, r_shift), mask);
+        const __m128i g1 = _mm_and_si128(_mm_srli_epi32(p1, 8), mask);
+        const __m128i b1 = _mm_and_si128(_mm_srl_epi32(p1, b_shift), mask);
+
+        __m128i yy = _mm_packs_epi32(Luma_SSE41(r0, g0, b0), Luma_SSE41(r1, g1, b1));
+        yy = _mm_packus_epi16(yy, yy);
+        const int32_t y_row0 = _mm_cvtsi128_si32(yy);
+        std::memcpy(y0 + col, &y_row0, 4);
+        if (y1) {
+            const int32_t y_row1 = _mm_cvtsi128_si32(_mm_srli_si128(yy, 4));
+            std::memcpy(y1 + col, &y_row1, 4);
+        }
+
+        const __m128i rs = _mm_add_epi32(r0, r1);
+        const __m128i gs = _mm_add_epi32(g0, g1);
+        const __m128i bs = _mm_add_epi32(b0, b1);
+        const __m128i r = _mm_hadd_epi32(rs, rs);
+        const __m128i g = _mm_hadd_epi32(gs, gs);
+        const __m128i b = _mm_hadd_epi32(bs, bs);
+        const uint16_t u2 = static_cast<uint16_t>(_mm_cvtsi128_si32(Chroma_SSE41(r, g, b, -9719, -19081, 28800)));
+        const uint16_t v2 = static_cast<uint16_t>(_mm_cvtsi128_si32(Chroma_SSE41(r, g, b, 28800, -24116, -4684)));
+        std::memcpy(u + col / 2, &u2, 2);
+        std::memcpy(v + col / 2, &v2, 2);
+
+        if (a0) {
+            __m128i aa = _mm_packs_epi32(_mm_srli_epi32(p0, 24), _mm_srli_epi32(p1, 24));
+            aa = _mm_packus_epi16(aa, aa);
+            const int32_t a_row0 = _mm_cvtsi128_si32(aa);
+            std::memcpy(a0 + col, &a_row0, 4);
+            if (a1) {
+                const int32_t a_row1 = _mm_cvtsi128_si32(_mm_srli_si128(aa, 4));
+                std::memcpy(a1 + col, &a_row1, 4);
+            }
+            alpha_and = _mm_and_si128(alpha_and, _mm_and_si128(p0, p1));
+        }
+    }
+
+    if (a0) {
+        const __m128i opaque = _mm_cmpeq_epi32(_mm_srli_epi32(alpha_and, 24), mask);
+        *transparent |= _mm_movemask_epi8(opaque) != 0xFFFF;
+    }
+    return col;
+}
+
+WEBP_TARGET_AVX2 inline __m256i Luma_AVX2(__m256i r, __m256i g, __m256i b) {
+    __m256i y = _mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(16839)),
+                                 _mm256_mullo_epi32(g, _mm256_set1_epi32(33059)));
+    y = _mm256_add_epi32(y, _mm256_mullo_epi32(b, _mm256_set1_epi32(6420)));
+    return _mm256_srli_epi32(_mm256_add_epi32(y, _mm256_set1_epi32(kYRounding)), kYUVFix);
+}
+
+// Two rows of 8 x 32-bit values -> row0 bytes in the low lane, row1 in the high lane
+WEBP_TARGET_AVX2 inline __m256i PackRows_AVX2(__m256i first, __m256i second) {
+    __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(first, second),
+                                             _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm256_packus_epi16(words, words);
+}
+
+// Inputs hold 2x2 sums in elements 0, 1, 4 and 5; returns four packed bytes
+WEBP_TARGET_AVX2 inline int32_t Chroma_AVX2(__m256i r, __m256i g, __m256i b, int kr, int kg, int kb) {
+    __m256i c = _mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(kr)),
+                                 _mm256_mullo_epi32(g, _mm256_set1_epi32(kg)));
+    c = _mm256_add_epi32(c, _mm256_mullo_epi32(b, _mm256_set1_epi32(kb)));
+    c = _mm256_srai_epi32(_mm256_add_epi32(c, _mm256_set1_epi32(kUVRounding)), kYUVFix + 2);
+    const __m256i pair_sums = _mm256_setr_epi32(0, 1, 4, 5, 0, 1, 4, 5);
+    __m128i packed = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(c, pair_sums));
+    packed = _mm_packs_epi32(packed, packed);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+}
+
+// 8 pixels per step, same arithmetic as the SSE4.1 kernel
+WEBP_TARGET_AVX2 uint32_t ConvertRowPairToYUV420_AVX2(const uint8_t* row0, const uint8_t* row1,
+                                     uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                                     uint8_t* a0, uint8_t* a1, uint32_t width,
+                                     bool bgr_order, bool* transparent) {
+    const __m128i r_shift = _mm_cvtsi32_si128(bgr_order ? 16 : 0);
+    const __m128i b_shift = _mm_cvtsi32_si128(bgr_order ? 0 : 16);
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    __m256i alpha_and = _mm256_set1_epi32(-1);
+
+    uint32_t col = 0;
+    for (; col + 8 <= width; col += 8) {
+        const __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + col * 4));
+        const __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + col * 4));
+
+        const __m256i r0 = _mm256_and_si256(_mm256_srl_epi32(p0, r_shift), mask);
+        const __m256i g0 = _mm256_and_si256(_mm256_srli_epi32(p0, 8), mask);
+        const __m256i b0 = _mm256_and_si256(_mm256_srl_epi32(p0, b_shift), mask);
+        const __m256i r1 = _mm256_and_si256(_mm256_srl_epi32(p1, r_shift), mask);
+        const __m256i g1 = _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask);
+        const __m256i b1 = _mm256_and_si256(_mm256_srl_epi32(p1, b_shift), mask);
+
+        const __m256i yy = PackRows_AVX2(Luma_AVX2(r0, g0, b0), Luma_AVX2(r1, g1, b1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(y0 + col), _mm256_castsi256_si128(yy));
+        if (y1) {
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(y1 + col), _mm256_extracti128_si256(yy, 1));
+        }
+
+        // hadd works per 128-bit lane: pair sums land in elements 0, 1, 4, 5
+        const __m256i rs = _mm256_add_epi32(r0, r1);
+        const __m256i gs = _mm256_add_epi32(g0, g1);
+        const __m256i bs = _mm256_add_epi32(b0, b1);
+        const __m256i r = _mm256_hadd_epi32(rs, rs);
+        const __m256i g = _mm256_hadd_epi32(gs, gs);
+        const __m256i b = _mm256_hadd_epi32(bs, bs);
+        const int32_t u4 = Chroma_AVX2(r, g, b, -9719, -19081, 28800);
+        const int32_t v4 = Chroma_AVX2(r, g, b, 28800, -24116, -4684);
+        std::memcpy(u + col / 2, &u4, 4);
+        std::memcpy(v + col / 2, &v4, 4);
+
+        if (a0) {
+            const __m256i aa = PackRows_AVX2(_mm256_srli_epi32(p0, 24), _mm256_srli_epi32(p1, 24));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(a0 + col), _mm256_castsi256_si128(aa));
+            if (a1) {
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(a1 + col), _mm256_extracti128_si256(aa, 1));
+            }
+            alpha_and = _mm256_and_si256(alpha_and, _mm256_and_si256(p0, p1));
+        }
     }
-    
-    // Handle remaining pixels with scalar code
-    for (uint32_t i = simd_pixels; i < pixel_count; ++i) {
-        rgb[i * 3 + 0] = rgba[i * 4 + 0];
-        rgb[i * 3 + 1] = rgba[i * 4 + 1];
-        rgb[i * 3 + 2] = rgba[i * 4 + 2];
+
+    if (a0) {
+        const __m256i opaque = _mm256_cmpeq_epi32(_mm256_srli_epi32(alpha_and, 24), mask);
+        *transparent |= _mm256_movemask_epi8(opaque) != -1;
     }
+    return col;
 }
 #endif
 
-#ifdef WEBP_USE_AVX2
-void ConvertRGBAToRGB_AVX2(const uint8_t* rgba, uint8_t* rgb, uint32_t pixel_count) {
-    const uint32_t simd_pixels = pixel_count & ~7; // Process 8 pixels at a time
-    
-    for (uint32_t i = 0; i < simd_pixels; i += 8) {
-        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rgba + i * 4));
-        
-        // Complex shuffle to pack 8 RGBA pixels to RGB format
-        // This is simplified - a full implementation would be more optimized
-        alignas(32) uint8_t temp[32];
-        _mm256_store_si256(reinterpret_cast<__m256i*>(temp), pixels);
-        
-        for (int j = 0; j < 8; ++j) {
-            rgb[(i + j) * 3 + 0] = temp[j * 4 + 0];
-            rgb[(i + j) * 3 + 1] = temp[j * 4 + 1];
-            rgb[(i + j) * 3 + 2] = temp[j * 4 + 2];
+#ifdef WEBP_USE_NEON
+// 8 pixels per step; vld4 deinterleaves the channels and every Y coefficient
+// fits an unsigned 16-bit multiply
+uint32_t ConvertRowPairToYUV420_NEON(const uint8_t* row0, const uint8_t* row1,
+                                     uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v,
+                                     uint8_t* a0, uint8_t* a1, uint32_t width,
+                                     bool bgr_order, bool* transparent) {
+    const uint32x4_t y_round = vdupq_n_u32(kYRounding);
+    const int32x4_t uv_round = vdupq_n_s32(kUVRounding);
+    uint8x8_t alpha_min = vdup_n_u8(0xFF);
+
+    auto luma = [&](uint16x8_t r, uint16x8_t g, uint16x8_t b) {
+        uint32x4_t lo = vmull_n_u16(vget_low_u16(r), 16839);
+        lo = vmlal_n_u16(lo, vget_low_u16(g), 33059);
+        lo = vmlal_n_u16(lo, vget_low_u16(b), 6420);
+        uint32x4_t hi = vmull_n_u16(vget_high_u16(r), 16839);
+        hi = vmlal_n_u16(hi, vget_high_u16(g), 33059);
+        hi = vmlal_n_u16(hi, vget_high_u16(b), 6420);
+        return vmovn_u16(vcombine_u16(vshrn_n_u32(vaddq_u32(lo, y_round), kYUVFix),
+                                      vshrn_n_u32(vaddq_u32(hi, y_round), kYUVFix)));
+    };
+    auto chroma = [&](int32x4_t r, int32x4_t g, int32x4_t b, int kr, int kg, int kb) {
+        int32x4_t c = vmulq_n_s32(r, kr);
+        c = vmlaq_n_s32(c, g, kg);
+        c = vmlaq_n_s32(c, b, kb);
+        const uint16x4_t narrowed = vqmovun_s32(vshrq_n_s32(vaddq_s32(c, uv_round), kYUVFix + 2));
+        return vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(narrowed, narrowed))), 0);
+    };
+
+    uint32_t col = 0;
+    for (; col + 8 <= width; col += 8) {
+        const uint8x8x4_t p0 = vld4_u8(row0 + col * 4);
+        const uint8x8x4_t p1 = vld4_u8(row1 + col * 4);
+        const uint16x8_t r0 = vmovl_u8(p0.val[bgr_order ? 2 : 0]);
+        const uint16x8_t g0 = vmovl_u8(p0.val[1]);
+        const uint16x8_t b0 = vmovl_u8(p0.val[bgr_order ? 0 : 2]);
+        const uint16x8_t r1 = vmovl_u8(p1.val[bgr_order ? 2 : 0]);
+        const uint16x8_t g1 = vmovl_u8(p1.val[1]);
+        const uint16x8_t b1 = vmovl_u8(p1.val[bgr_order ? 0 : 2]);
+
+        vst1_u8(y0 + col, luma(r0, g0, b0));
+        if (y1) {
+            vst1_u8(y1 + col, luma(r1, g1, b1));
+        }
+
+        const int32x4_t r = vreinterpretq_s32_u32(vpaddlq_u16(vaddq_u16(r0, r1)));
+        const int32x4_t g = vreinterpretq_s32_u32(vpaddlq_u16(vaddq_u16(g0, g1)));
+        const int32x4_t b = vreinterpretq_s32_u32(vpaddlq_u16(vaddq_u16(b0, b1)));
+        const uint32_t u4 = chroma(r, g, b, -9719, -19081, 28800);
+        const uint32_t v4 = chroma(r, g, b, 28800, -24116, -4684);
+        std::memcpy(u + col / 2, &u4, 4);
+        std::memcpy(v + col / 2, &v4, 4);
+
+        if (a0) {
+            vst1_u8(a0 + col, p0.val[3]);
+            if (a1) {
+                vst1_u8(a1 + col, p1.val[3]);
+            }
+            alpha_min = vmin_u8(alpha_min, vmin_u8(p0.val[3], p1.val[3]));
         }
     }
-    
-    // Handle remaining pixels
-    for (uint32_t i = simd_pixels; i < pixel_count; ++i) {
-        rgb[i * 3 + 0] = rgba[i * 4 + 0];
-        rgb[i * 3 + 1] = rgba[i * 4 + 1];
-        rgb[i * 3 + 2] = rgba[i * 4 + 2];
+
+    if (a0) {
+        *transparent |= vget_lane_u64(vreinterpret_u64_u8(alpha_min), 0) != ~0ull;
     }
+    return col;
 }
 #endif
 
+using RowPairKernel = uint32_t (*)(const uint8_t*, const uint8_t*, uint8_t*, uint8_t*,
+                                   uint8_t*, uint8_t*, uint8_t*, uint8_t*, uint32_t,
+                                   bool, bool*);
+
+// One set of kernels per ISA level; dispatch swaps the whole set at once
+struct KernelTable {
+    ISA isa;
+    const char* name;
+    void (*swap_red_blue)(const uint8_t* src, uint8_t* dst, uint32_t pixel_count);
+    void (*swap_red_blue_opaque)(const uint8_t* src, uint8_t* dst, uint32_t pixel_count);
+    void (*rgba_to_rgb)(const uint8_t* rgba, uint8_t* rgb, uint32_t pixel_count);
+    RowPairKernel yuv420_row_pair;   // 4-byte layouts only; nullptr = scalar
+    size_t (*first_difference)(const uint8_t* a, const uint8_t* b, size_t size);
+    size_t (*last_difference)(const uint8_t* a, const uint8_t* b, size_t size);
+    uint32_t (*downsample_2x)(const uint8_t* row0, const uint8_t* row1, uint8_t* dst,
+                              uint32_t src_width);  // nullptr = scalar
+};
+
+const KernelTable kScalarKernels = {
+    ISA::Scalar, "scalar", SwapRedBlue_C<false>, SwapRedBlue_C<true>, ConvertRGBAToRGB_C, nullptr,
+    FirstDifference_C, LastDifference_C, nullptr};
+
+#ifdef WEBP_USE_X86
+const KernelTable kSSE2Kernels = {
+    ISA::SSE2, "sse2", SwapRedBlue_SSE2<false>, SwapRedBlue_SSE2<true>, ConvertRGBAToRGB_C, nullptr,
+    FirstDifference_SSE2, LastDifference_SSE2, Downsample2x_SSE2};
+const KernelTable kSSE41Kernels = {
+    ISA::SSE41, "sse4.1", SwapRedBlue_SSE41<false>, SwapRedBlue_SSE41<true>, ConvertRGBAToRGB_SSE41,
+    ConvertRowPairToYUV420_SSE41, FirstDifference_SSE2, LastDifference_SSE2, Downsample2x_SSE2};
+const KernelTable kAVX2Kernels = {
+    ISA::AVX2, "avx2", SwapRedBlue_AVX2<false>, SwapRedBlue_AVX2<true>, ConvertRGBAToRGB_AVX2,
+    ConvertRowPairToYUV420_AVX2, FirstDifference_AVX2, LastDifference_AVX2, Downsample2x_AVX2};
+#ifdef WEBP_USE_AVX512
+// YUV420 is bound by the 32-bit multiplies, differencing and downsampling by
+// memory bandwidth, none of which AVX-512 widens enough to pay for the
+// frequency drop; they keep the AVX2 kernels
+const KernelTable kAVX512Kernels = {
+    ISA::AVX512, "avx512", SwapRedBlue_AVX512<false>, SwapRedBlue_AVX512<true>, ConvertRGBAToRGB_AVX512,
+    ConvertRowPairToYUV420_AVX2, FirstDifference_AVX2, LastDifference_AVX2, Downsample2x_AVX2};
+#endif
+#endif
+
+#ifdef WEBP_USE_NEON
+const KernelTable kNEONKernels = {
+    ISA::NEON, "neon", SwapRedBlue_NEON<false>, SwapRedBlue_NEON<true>, ConvertRGBAToRGB_NEON,
+    ConvertRowPairToYUV420_NEON, FirstDifference_NEON, LastDifference_NEON, Downsample2x_NEON};
+#endif
+
+// Best first
+constexpr ISA kDispatchOrder[] = {ISA::AVX512, ISA::AVX2, ISA::SSE41, ISA::SSE2, ISA::NEON, ISA::Scalar};
+
+// nullptr when this build has no kernels for isa or the CPU cannot run them
+const KernelTable* KernelsFor(ISA isa) {
+    const CPUFeatures& cpu = DetectedFeatures();
+    switch (isa) {
+#ifdef WEBP_USE_X86
+#ifdef WEBP_USE_AVX512
+        case ISA::AVX512: return cpu.has_avx512 && cpu.has_avx2 ? &kAVX512Kernels : nullptr;
+#endif
+        case ISA::AVX2: return cpu.has_avx2 && cpu.has_sse41 ? &kAVX2Kernels : nullptr;
+        case ISA::SSE41: return cpu.has_sse41 && cpu.has_sse2 ? &kSSE41Kernels : nullptr;
+        case ISA::SSE2: return cpu.has_sse2 ? &kSSE2Kernels : nullptr;
+#endif
+#ifdef WEBP_USE_NEON
+        case ISA::NEON: return cpu.has_neon ? &kNEONKernels : nullptr;
+#endif
+        case ISA::Scalar: return &kScalarKernels;
+        default: return nullptr;
+    }
+}
+
+const KernelTable* BestKernels() {
+    for (ISA isa : kDispatchOrder) {
+        if (const KernelTable* kernels = KernelsFor(isa)) {
+            return kernels;
+        }
+    }
+    return &kScalarKernels;
+}
+
+std::atomic<const KernelTable*>& ActiveKernels() {
+    static std::atomic<const KernelTable*> kernels{BestKernels()};
+    return kernels;
+}
+
+inline const KernelTable& Kernels() {
+    return *ActiveKernels().load(std::memory_order_acquire);
+}
+
+// Resolve the table at load time instead of on the first conversion
+const KernelTable* const g_load_time_kernels = &Kernels();
+
+} // anonymous namespace
+
 // Public interface functions
 
 void ConvertBGRAToRGBA(const uint8_t* bgra_data, uint8_t* rgba_data, uint32_t pixel_count) {
     if (!bgra_data || !rgba_data || pixel_count == 0) {
         return;
     }
-    
-    // Choose the best available SIMD implementation
-    #ifdef WEBP_USE_AVX2
-    if (g_cpu_info.has_avx2) {
-        ConvertBGRAToRGBA_AVX2(bgra_data, rgba_data, pixel_count);
-        return;
-    }
-    #endif
-    
-    #ifdef WEBP_USE_SSE2
-    if (g_cpu_info.has_sse2) {
-        ConvertBGRAToRGBA_SSE2(bgra_data, rgba_data, pixel_count);
-        return;
-    }
-    #endif
-    
-    #ifdef WEBP_USE_NEON
-    if (g_cpu_info.has_neon) {
-        ConvertBGRAToRGBA_NEON(bgra_data, rgba_data, pixel_count);
+    Kernels().swap_red_blue(bgra_data, rgba_data, pixel_count);
+}
+
+void ConvertBGRXToRGBA(const uint8_t* bgrx_data, uint8_t* rgba_data, uint32_t pixel_count) {
+    if (!bgrx_data || !rgba_data || pixel_count == 0) {
         return;
     }
-    #endif
-    
-    // Fallback to scalar implementation
-    ConvertBGRAToRGBA_C(bgra_data, rgba_data, pixel_count);
+    Kernels().swap_red_blue_opaque(bgrx_data, rgba_data, pixel_count);
 }
 
 void ConvertRGBAToRGB(const uint8_t* rgba_data, uint8_t* rgb_data, uint32_t pixel_count) {
     if (!rgba_data || !rgb_data || pixel_count == 0) {
         return;
     }
-    
-    // Choose the best available SIMD implementation
-    #ifdef WEBP_USE_AVX2
-    if (g_cpu_info.has_avx2) {
-        ConvertRGBAToRGB_AVX2(rgba_data, rgb_data, pixel_count);
-        return;
+    Kernels().rgba_to_rgb(rgba_data, rgb_data, pixel_count);
+}
+
+bool ConvertToYUV420(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+                     uint32_t step, bool bgr_order,
+                     uint8_t* y_plane, int y_stride,
+                     uint8_t* u_plane, uint8_t* v_plane, int uv_stride,
+                     uint8_t* a_plane, int a_stride) {
+    if (!data || !y_plane || !u_plane || !v_plane || width == 0 || height == 0) {
+        return false;
+    }
+    if (step != 4) {
+        a_plane = nullptr;  // Packed RGB has no alpha channel
     }
-    #endif
-    
-    #ifdef WEBP_USE_SSE2
-    if (g_cpu_info.has_sse2) {
-        ConvertRGBAToRGB_SSE2(rgba_data, rgb_data, pixel_count);
+
+    // The vector kernel handles the 4-byte layouts and the scalar loop
+    // finishes each row pair
+    const RowPairKernel kernel = step == 4 ? Kernels().yuv420_row_pair : nullptr;
+
+    bool transparent = false;
+    for (uint32_t row = 0; row < height; row += 2) {
+        const bool has_second = row + 1 < height;
+        const uint8_t* row0 = data + static_cast<size_t>(row) * stride;
+        const uint8_t* row1 = has_second ? row0 + stride : row0;
+        uint8_t* y0 = y_plane + static_cast<size_t>(row) * y_stride;
+        uint8_t* y1 = has_second ? y0 + y_stride : nullptr;
+        uint8_t* u = u_plane + static_cast<size_t>(row / 2) * uv_stride;
+        uint8_t* v = v_plane + static_cast<size_t>(row / 2) * uv_stride;
+        uint8_t* a0 = a_plane ? a_plane + static_cast<size_t>(row) * a_stride : nullptr;
+        uint8_t* a1 = (a0 && has_second) ? a0 + a_stride : nullptr;
+
+        uint32_t col = 0;
+        if (kernel) {
+            col = kernel(row0, row1, y0, y1, u, v, a0, a1, width, bgr_order, &transparent);
+        }
+        transparent |= ConvertRowPairToYUV420_C(row0, row1, y0, y1, u, v, a0, a1,
+                                                col, width, step, bgr_order);
+    }
+
+    return transparent;
+}
+
+size_t FindFirstDifference(const uint8_t* a, const uint8_t* b, size_t size) {
+    if (!a || !b) {
+        return size;
+    }
+    return Kernels().first_difference(a, b, size);
+}
+
+size_t FindLastDifference(const uint8_t* a, const uint8_t* b, size_t size) {
+    if (!a || !b) {
+        return size;
+    }
+    return Kernels().last_difference(a, b, size);
+}
+
+void DownsamplePlane2x(const uint8_t* src, uint32_t width, uint32_t height, int src_stride,
+                       uint8_t* dst, int dst_stride) {
+    if (!src || !dst || width == 0 || height == 0) {
         return;
     }
-    #endif
-    
-    // Fallback to scalar implementation
-    ConvertRGBAToRGB_C(rgba_data, rgb_data, pixel_count);
+
+    const auto kernel = Kernels().downsample_2x;
+    for (uint32_t row = 0; row < height; row += 2) {
+        const uint8_t* row0 = src + static_cast<size_t>(row) * src_stride;
+        const uint8_t* row1 = row + 1 < height ? row0 + src_stride : row0;  // An odd last row pairs with itself
+        uint8_t* out = dst + static_cast<size_t>(row / 2) * dst_stride;
+        const uint32_t done = kernel ? kernel(row0, row1, out, width) : 0;
+        Downsample2x_C(row0, row1, out, done, width);
+    }
 }
 
-// In-place pixel format conversion
+// In-place pixel format conversion; every swap kernel reads a block before
+// writing it back
 void ConvertBGRAToRGBAInPlace(uint8_t* data, uint32_t pixel_count) {
     if (!data || pixel_count == 0) {
         return;
     }
-    
-    // For in-place conversion, we need to be careful with SIMD
-    // For now, use simple scalar implementation
-    for (uint32_t i = 0; i < pixel_count; ++i) {
-        std::swap(data[i * 4 + 0], data[i * 4 + 2]); // Swap R and B channels
+    Kernels().swap_red_blue(data, data, pixel_count);
+}
+
+ISA GetActiveISA() {
+    return Kernels().isa;
+}
+
+std::vector<std::string> GetAvailableISAs() {
+    std::vector<std::string> isas;
+    for (ISA isa : kDispatchOrder) {
+        if (const KernelTable* kernels = KernelsFor(isa)) {
+            isas.push_back(kernels->name);
+        }
     }
+    return isas;
 }
 
-// Get SIMD capabilities info
+bool SetISALimit(const std::string& isa) {
+    if (isa.empty() || isa == "auto") {
+        ActiveKernels().store(BestKernels(), std::memory_order_release);
+        return true;
+    }
+
+    for (ISA candidate : kDispatchOrder) {
+        const KernelTable* kernels = KernelsFor(candidate);
+        if (kernels && isa == kernels->name) {
+            ActiveKernels().store(kernels, std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Get SIMD capabilities info: the active level and the x86 levels below it
 std::string GetSIMDCapabilities() {
+    const ISA active = GetActiveISA();
+    if (active == ISA::NEON) {
+        return "NEON ";
+    }
+
     std::string caps;
-    
-    #ifdef WEBP_USE_SSE2
-    if (g_cpu_info.has_sse2) caps += "SSE2 ";
-    #endif
-    
-    #ifdef WEBP_USE_SSE41
-    if (g_cpu_info.has_sse41) caps += "SSE4.1 ";
-    #endif
-    
-    #ifdef WEBP_USE_AVX2
-    if (g_cpu_info.has_avx2) caps += "AVX2 ";
-    #endif
-    
-    #ifdef WEBP_USE_NEON
-    if (g_cpu_info.has_neon) caps += "NEON ";
-    #endif
-    
+    if (active >= ISA::SSE2) caps += "SSE2 ";
+    if (active >= ISA::SSE41) caps += "SSE4.1 ";
+    if (active >= ISA::AVX2) caps += "AVX2 ";
+    if (active >= ISA::AVX512) caps += "AVX-512 ";
+
     return caps.empty() ? "None" : caps;
 }
 
 } // namespace SIMD
-} // namespace WebPScreenshot
\ No newline at end of file
+} // namespace WebPScreenshot
@@ -0,0 +1,439 @@
+#include "common/screenshot_common.h"
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <avrt.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <pthread/qos.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#endif
+
+namespace WebPScreenshot {
+namespace ThreadPlacement {
+
+namespace {
+
+void AppendError(std::string& errors, const std::string& error) {
+    if (!errors.empty()) {
+        errors += "; ";
+    }
+    errors += error;
+}
+
+#ifndef _WIN32
+std::vector<uint32_t> AllCores() {
+    std::vector<uint32_t> cores(std::max(1u, std::thread::hardware_concurrency()));
+    for (uint32_t i = 0; i < cores.size(); ++i) {
+        cores[i] = i;
+    }
+    return cores;
+}
+#endif
+
+#ifdef _WIN32
+
+// Logical CPU numbers run across processor groups in group order
+bool CoreToProcessor(uint32_t core, PROCESSOR_NUMBER& processor) {
+    const WORD groups = GetActiveProcessorGroupCount();
+    for (WORD group = 0; group < groups; ++group) {
+        const DWORD count = GetActiveProcessorCount(group);
+        if (core < count) {
+            processor = {};
+            processor.Group = group;
+            processor.Number = static_cast<BYTE>(core);
+            return true;
+        }
+        core -= count;
+    }
+    return false;
+}
+
+uint32_t FirstCoreOfGroup(WORD group) {
+    uint32_t first = 0;
+    for (WORD g = 0; g < group; ++g) {
+        first += GetActiveProcessorCount(g);
+    }
+    return first;
+}
+
+std::string LastErrorText(const char* what) {
+    return std::string(what) + " failed (error " + std::to_string(GetLastError()) + ")";
+}
+
+// MMCSS registrations must be reverted by the thread that made them
+struct MmcssTask {
+    HANDLE handle = nullptr;
+    ~MmcssTask() {
+        if (handle) {
+            AvRevertMmThreadCharacteristics(handle);
+        }
+    }
+};
+
+thread_local MmcssTask t_mmcss;
+
+bool ApplyPriority(Priority priority, std::string& error) {
+    if (!t_mmcss.handle) {
+        DWORD task_index = 0;
+        t_mmcss.handle = AvSetMmThreadCharacteristicsW(L"Capture", &task_index);
+    }
+    if (t_mmcss.handle) {
+        if (priority == Priority::Realtime && !AvSetMmThreadPriority(t_mmcss.handle, AVRT_PRIORITY_CRITICAL)) {
+            error = LastErrorText("AvSetMmThreadPriority");
+            return false;
+        }
+        return true;
+    }
+
+    // MMCSS service disabled (some server SKUs); plain thread priority instead
+    const int fallback = priority == Priority::Realtime ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+    if (!SetThreadPriority(GetCurrentThread(), fallback)) {
+        error = LastErrorText("SetThreadPriority");
+        return false;
+    }
+    return true;
+}
+
+bool SetAffinity(const GROUP_AFFINITY& affinity, std::string& error) {
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) {
+        error = LastErrorText("SetThreadGroupAffinity");
+        return false;
+    }
+    return true;
+}
+
+bool ApplyAffinity(const Policy& policy, std::string& error) {
+    if (policy.core != kAnyCore) {
+        PROCESSOR_NUMBER processor;
+        if (!CoreToProcessor(static_cast<uint32_t>(policy.core), processor)) {
+            error = "Core " + std::to_string(policy.core) + " does not exist";
+            return false;
+        }
+        GROUP_AFFINITY affinity = {};
+        affinity.Group = processor.Group;
+        affinity.Mask = static_cast<KAFFINITY>(1) << processor.Number;
+        // The ideal processor also steers where the thread's first-touch pages land
+        SetThreadIdealProcessorEx(GetCurrentThread(), &processor, nullptr);
+        return SetAffinity(affinity, error);
+    }
+
+    // A node that spans processor groups is limited to its first group
+    GROUP_AFFINITY affinity = {};
+    if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(policy.numa_node), &affinity) || affinity.Mask == 0) {
+        error = "NUMA node " + std::to_string(policy.numa_node) + " does not exist";
+        return false;
+    }
+    return SetAffinity(affinity, error);
+}
+
+#elif defined(__APPLE__)
+
+bool ApplyPriority(Priority, std::string& error) {
+    // The closest macOS has to a pinned, boosted thread: the scheduler keeps
+    // user-interactive work on performance cores and runs it first
+    const int result = pthread_set_qos_class_self_np(QOS_CLASS_USER_INTERACTIVE, 0);
+    if (result != 0) {
+        error = "pthread_set_qos_class_self_np failed (" + std::to_string(result) + ")";
+        return false;
+    }
+    return true;
+}
+
+bool ApplyAffinity(const Policy& policy, std::string& error) {
+    // One memory node, and no way to pin a thread to a core
+    if (policy.core == kAnyCore && policy.numa_node == 0) {
+        return true;
+    }
+    error = policy.core != kAnyCore ? "Core pinning is not supported on macOS"
+                                    : "NUMA node " + std::to_string(policy.numa_node) + " does not exist";
+    return false;
+}
+
+#else
+
+// get_mempolicy / mbind constants from <numaif.h>, to avoid depending on libnuma
+constexpr int kMpolPreferred = 1;
+constexpr unsigned long kMpolFNode = 1u << 0;
+constexpr unsigned long kMpolFAddr = 1u << 1;
+constexpr unsigned kMpolMfMove = 1u << 1;
+
+// "0-3,8-11" as used by sysfs cpulist and node files
+std::vector<uint32_t> ParseList(const std::string& text) {
+    std::vector<uint32_t> values;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find(',', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        const std::string range = text.substr(pos, end - pos);
+        const size_t dash = range.find('-');
+        try {
+            const uint32_t first = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+            const uint32_t last = dash == std::string::npos
+                                      ? first : static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+            for (uint32_t value = first; value <= last; ++value) {
+                values.push_back(value);
+            }
+        } catch (const std::exception&) {
+            // Blank or malformed entry; skip it
+        }
+        pos = end + 1;
+    }
+    return values;
+}
+
+std::string ReadLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// CPUs of every node, indexed by node number. Containers without the node
+// directory see a single node holding every CPU. Intentionally leaked: pool
+// and worker threads may still ask during static destruction.
+const std::vector<std::vector<uint32_t>>& Topology() {
+    static const auto* topology = [] {
+        auto* nodes_ptr = new std::vector<std::vector<uint32_t>>();
+        auto& nodes = *nodes_ptr;
+        for (uint32_t node : ParseList(ReadLine("/sys/devices/system/node/online"))) {
+            if (node >= nodes.size()) {
+                nodes.resize(node + 1);
+            }
+            nodes[node] = ParseList(ReadLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+        }
+        if (nodes.empty()) {
+            nodes.push_back(AllCores());
+        }
+        return nodes_ptr;
+    }();
+    return *topology;
+}
+
+std::string ErrnoText(const char* what, int error) {
+    return std::string(what) + " failed: " + std::strerror(error);
+}
+
+bool Renice(std::string& error) {
+    // On Linux the nice value is per thread when given a thread id
+    const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    if (setpriority(PRIO_PROCESS, tid, -10) != 0) {
+        error = ErrnoText("setpriority", errno);
+        return false;
+    }
+    return true;
+}
+
+bool ApplyPriority(Priority priority, std::string& error) {
+    if (priority == Priority::Realtime) {
+        sched_param param = {};
+        param.sched_priority = 10;  // Above default RT tasks, well below kernel threads
+        const int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (result == 0) {
+            return true;
+        }
+        // Needs CAP_SYS_NICE or an rtprio limit; a lower nice value is still worth having
+        error = ErrnoText("SCHED_FIFO", result);
+        std::string nice_error;
+        if (!Renice(nice_error)) {
+            AppendError(error, nice_error);
+        }
+        return false;
+    }
+    return Renice(error);
+}
+
+bool ApplyAffinity(const Policy& policy, std::string& error) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (policy.core != kAnyCore) {
+        if (policy.core >= CPU_SETSIZE) {
+            error = "Core " + std::to_string(policy.core) + " does not exist";
+            return false;
+        }
+        CPU_SET(policy.core, &set);
+    } else {
+        const auto& nodes = Topology();
+        if (static_cast<size_t>(policy.numa_node) >= nodes.size() || nodes[policy.numa_node].empty()) {
+            error = "NUMA node " + std::to_string(policy.numa_node) + " does not exist";
+            return false;
+        }
+        for (uint32_t core : nodes[policy.numa_node]) {
+            if (core < CPU_SETSIZE) {
+                CPU_SET(core, &set);
+            }
+        }
+    }
+
+    // Threads this one creates later (libwebp's thread_level helper) inherit the mask
+    const int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (result != 0) {
+        error = ErrnoText("pthread_setaffinity_np", result);
+        return false;
+    }
+    return true;
+}
+
+#endif
+
+} // anonymous namespace
+
+Result Apply(const Policy& policy) {
+    Result result;
+
+    if (policy.core != kAnyCore || policy.numa_node != kAnyNode) {
+        std::string error;
+        result.placed = ApplyAffinity(policy, error);
+        if (!error.empty()) {
+            AppendError(result.error, error);
+        }
+    }
+
+    if (policy.priority != Priority::Normal) {
+        std::string error;
+        result.prioritized = ApplyPriority(policy.priority, error);
+        if (!error.empty()) {
+            AppendError(result.error, error);
+        }
+    }
+
+    return result;
+}
+
+#ifdef _WIN32
+
+uint32_t GetNumaNodeCount() {
+    ULONG highest = 0;
+    return GetNumaHighestNodeNumber(&highest) ? static_cast<uint32_t>(highest) + 1 : 1;
+}
+
+std::vector<uint32_t> GetNodeCores(uint32_t node) {
+    std::vector<uint32_t> cores;
+    GROUP_AFFINITY affinity = {};
+    if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity)) {
+        return cores;
+    }
+    const uint32_t first = FirstCoreOfGroup(affinity.Group);
+    for (uint32_t bit = 0; bit < sizeof(KAFFINITY) * 8; ++bit) {
+        if (affinity.Mask & (static_cast<KAFFINITY>(1) << bit)) {
+            cores.push_back(first + bit);
+        }
+    }
+    return cores;
+}
+
+int32_t GetCurrentNumaNode() {
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node = 0;
+    return GetNumaProcessorNodeEx(&processor, &node) ? static_cast<int32_t>(node) : kAnyNode;
+}
+
+int32_t GetMemoryNode(const void* address) {
+    if (GetNumaNodeCount() == 1) {
+        return 0;
+    }
+    PSAPI_WORKING_SET_EX_INFORMATION info = {};
+    info.VirtualAddress = const_cast<void*>(address);
+    if (!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) || !info.VirtualAttributes.Valid) {
+        return kAnyNode;
+    }
+    return static_cast<int32_t>(info.VirtualAttributes.Node);
+}
+
+bool BindMemory(void*, size_t, int32_t) {
+    return false;
+}
+
+#elif defined(__APPLE__)
+
+uint32_t GetNumaNodeCount() {
+    return 1;
+}
+
+std::vector<uint32_t> GetNodeCores(uint32_t node) {
+    return node == 0 ? AllCores() : std::vector<uint32_t>();
+}
+
+int32_t GetCurrentNumaNode() {
+    return 0;
+}
+
+int32_t GetMemoryNode(const void*) {
+    return 0;
+}
+
+bool BindMemory(void*, size_t, int32_t) {
+    return false;
+}
+
+#else
+
+uint32_t GetNumaNodeCount() {
+    return static_cast<uint32_t>(Topology().size());
+}
+
+std::vector<uint32_t> GetNodeCores(uint32_t node) {
+    const auto& nodes = Topology();
+    return node < nodes.size() ? nodes[node] : std::vector<uint32_t>();
+}
+
+int32_t GetCurrentNumaNode() {
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        return kAnyNode;
+    }
+    return static_cast<int32_t>(node);
+}
+
+int32_t GetMemoryNode(const void* address) {
+    if (GetNumaNodeCount() == 1) {
+        return 0;
+    }
+#ifdef SYS_get_mempolicy
+    int node = kAnyNode;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0ul, address, kMpolFNode | kMpolFAddr) == 0) {
+        return node;
+    }
+#else
+    (void)address;
+#endif
+    return kAnyNode;
+}
+
+bool BindMemory(void* address, size_t size, int32_t node) {
+    if (node < 0 || static_cast<uint32_t>(node) >= GetNumaNodeCount()) {
+        return false;
+    }
+#ifdef SYS_mbind
+    constexpr size_t kBitsPerWord = sizeof(unsigned long) * 8;
+    std::vector<unsigned long> mask(node / kBitsPerWord + 1, 0);
+    mask[node / kBitsPerWord] |= 1ul << (node % kBitsPerWord);
+    // The kernel reads maxnode - 1 bits
+    return syscall(SYS_mbind, address, size, kMpolPreferred, mask.data(),
+                   mask.size() * kBitsPerWord + 1, kMpolMfMove) == 0;
+#else
+    (void)address;
+    (void)size;
+    return false;
+#endif
+}
+
+#endif
+
+} // namespace ThreadPlacement
+} // namespace WebPScreenshot
@@ -0,0 +1,265 @@
+#include "common/screenshot_common.h"
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace WebPScreenshot {
+namespace TileCache {
+
+namespace {
+
+constexpr size_t kDefaultMaxBytes = 64ull << 20;
+// Charged per entry on top of the encoded bytes: list node, index slot, control block
+constexpr size_t kEntryOverhead = 128;
+// Seeds the hash of a frame's tile hashes, so it never equals a tile's pixel hash
+constexpr uint64_t kFrameHashSeed = 0x74696c656672616dull;
+
+// xxHash64 (Yann Collet), which runs at memory speed without SIMD
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t RotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Native byte order: hashes are only compared within one process
+inline uint64_t Read64(const uint8_t* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t Read32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint64_t Round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime2;
+    return RotateLeft(accumulator, 31) * kPrime1;
+}
+
+inline uint64_t MergeRound(uint64_t hash, uint64_t accumulator) {
+    hash ^= Round(0, accumulator);
+    return hash * kPrime1 + kPrime4;
+}
+
+struct KeyHasher {
+    size_t operator()(const Key& key) const {
+        uint64_t hash = key.pixel_hash ^ RotateLeft(key.params_hash * kPrime2, 29);
+        hash ^= (static_cast<uint64_t>(key.width) << 32 | key.height) * kPrime3;
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+};
+
+inline size_t EntryBytes(const Bitstream& encoded) {
+    return encoded->size() + kEntryOverhead;
+}
+
+struct Entry {
+    Key key;
+    Bitstream encoded;
+};
+
+struct Cache {
+    std::mutex mutex;
+    std::list<Entry> entries;  // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHasher> index;
+    size_t bytes = 0;
+    size_t max_bytes = kDefaultMaxBytes;
+    uint64_t evictions = 0;
+
+    void EvictLocked(size_t limit) {
+        while (bytes > limit && !entries.empty()) {
+            const Entry& oldest = entries.back();
+            bytes -= EntryBytes(oldest.encoded);
+            index.erase(oldest.key);
+            entries.pop_back();
+            ++evictions;
+        }
+    }
+};
+
+Cache& GetCache() {
+    static Cache cache;
+    return cache;
+}
+
+} // anonymous namespace
+
+uint64_t HashBytes(const uint8_t* data, size_t size, uint64_t seed) {
+    const uint8_t* p = data;
+    const uint8_t* const end = data + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        const uint8_t* const limit = end - 32;
+        do {
+            v1 = Round(v1, Read64(p));
+            v2 = Round(v2, Read64(p + 8));
+            v3 = Round(v3, Read64(p + 16));
+            v4 = Round(v4, Read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+
+    hash += static_cast<uint64_t>(size);
+    for (; p + 8 <= end; p += 8) {
+        hash ^= Round(0, Read64(p));
+        hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+        hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= *p * kPrime5;
+        hash = RotateLeft(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t HashRows(const uint8_t* data, size_t row_bytes, uint32_t height, uint32_t stride,
+                  uint64_t seed) {
+    // Chained per row so padding between rows never enters the hash
+    uint64_t hash = seed;
+    for (uint32_t y = 0; y < height; ++y) {
+        hash = HashBytes(data + static_cast<size_t>(y) * stride, row_bytes, hash);
+    }
+    return hash;
+}
+
+uint64_t HashParams(const WebPEncodeParams& params, WebPEncoder::PixelLayout layout) {
+    // Threading and streaming settings do not change the bytes and stay out
+    uint32_t quality_bits;
+    uint32_t psnr_bits;
+    uint32_t budget_bits;
+    std::memcpy(&quality_bits, &params.quality, sizeof(quality_bits));
+    std::memcpy(&psnr_bits, &params.target_psnr, sizeof(psnr_bits));
+    std::memcpy(&budget_bits, &params.max_encode_ms, sizeof(budget_bits));
+
+    const int64_t fields[] = {
+        static_cast<int64_t>(layout), params.lossless, quality_bits, params.method,
+        params.target_size, psnr_bits, params.segments, params.sns_strength,
+        params.filter_strength, params.filter_sharpness, params.filter_type, params.autofilter,
+        params.alpha_compression, params.alpha_filtering, params.alpha_quality, params.pass,
+        params.show_compressed, params.preprocessing, params.partitions, params.partition_limit,
+        params.emulate_jpeg_size, params.low_memory, params.near_lossless, params.exact,
+        params.use_delta_palette, params.use_sharp_yuv, params.content_adaptive, budget_bits,
+    };
+    return HashBytes(reinterpret_cast<const uint8_t*>(fields), sizeof(fields));
+}
+
+Key MakeKey(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+            WebPEncoder::PixelLayout layout, const WebPEncodeParams& params) {
+    const size_t bytes_per_pixel = layout == WebPEncoder::PixelLayout::RGB ? 3 : 4;
+    Key key;
+    key.pixel_hash = HashRows(data, width * bytes_per_pixel, height, stride);
+    key.params_hash = HashParams(params, layout);
+    key.width = width;
+    key.height = height;
+    return key;
+}
+
+Key MakeFrameKey(const std::vector<Key>& tile_keys, uint32_t width, uint32_t height) {
+    std::vector<uint64_t> pixel_hashes(tile_keys.size());
+    for (size_t i = 0; i < tile_keys.size(); ++i) {
+        pixel_hashes[i] = tile_keys[i].pixel_hash;
+    }
+    Key key;
+    key.pixel_hash = HashBytes(reinterpret_cast<const uint8_t*>(pixel_hashes.data()),
+                               pixel_hashes.size() * sizeof(uint64_t), kFrameHashSeed);
+    key.params_hash = tile_keys.empty() ? 0 : tile_keys[0].params_hash;
+    key.width = width;
+    key.height = height;
+    return key;
+}
+
+Bitstream Find(const Key& key) {
+    Cache& cache = GetCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.index.find(key);
+    if (it == cache.index.end()) {
+        return nullptr;
+    }
+    cache.entries.splice(cache.entries.begin(), cache.entries, it->second);
+    return it->second->encoded;
+}
+
+void Insert(const Key& key, Bitstream encoded) {
+    if (!encoded) {
+        return;
+    }
+
+    Cache& cache = GetCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    const size_t size = EntryBytes(encoded);
+    if (size > cache.max_bytes) {
+        return;
+    }
+
+    auto it = cache.index.find(key);
+    if (it != cache.index.end()) {
+        cache.bytes -= EntryBytes(it->second->encoded);
+        it->second->encoded = std::move(encoded);
+        cache.entries.splice(cache.entries.begin(), cache.entries, it->second);
+    } else {
+        cache.entries.push_front(Entry{key, std::move(encoded)});
+        cache.index.emplace(key, cache.entries.begin());
+    }
+    cache.bytes += size;
+    cache.EvictLocked(cache.max_bytes);
+}
+
+CacheStats GetStats() {
+    Cache& cache = GetCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    CacheStats stats;
+    stats.entries = cache.entries.size();
+    stats.bytes = cache.bytes;
+    stats.max_bytes = cache.max_bytes;
+    stats.evictions = cache.evictions;
+    return stats;
+}
+
+void SetMaxBytes(size_t max_bytes) {
+    Cache& cache = GetCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.max_bytes = max_bytes;
+    cache.EvictLocked(max_bytes);
+}
+
+void Clear() {
+    Cache& cache = GetCache();
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    cache.entries.clear();
+    cache.index.clear();
+    cache.bytes = 0;
+}
+
+} // namespace TileCache
+} // namespace WebPScreenshot
@@ -1,21 +1,166 @@
 #include "common/screenshot_common.h"
-#include <queue>
+#include <webp/encode.h>
+#include <deque>
 #include <thread>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
+#include <cmath>
+#include <cstring>
 #include <future>
+#include <mutex>
 
 namespace WebPScreenshot {
 namespace UltraStreaming {
 
+// A zero budget would disable the deadline, so an overdue chunk gets this
+constexpr double kMinChunkBudgetMs = 0.001;
+
+// Chunks become ANMF frames, whose offsets are stored divided by two, and each
+// is a standalone VP8/VP8L image, so edges stay even and within WEBP_MAX_DIMENSION
+constexpr uint32_t kMinChunkDimension = 64;
+constexpr uint32_t kMaxChunkDimension = WEBP_MAX_DIMENSION & ~1u;
+
+// max_output_size search over a chunked frame, as in WebPEncoder::EncodeBounded
+constexpr int kSizeSearchPasses = 6;
+constexpr int kMaxSizeAttempts = 4;
+constexpr double kSizeRetryMargin = 0.95;
+
+namespace {
+
+// Y, U and V planes of one pyramid level in a single pool block. The chroma
+// planes are (width + 1) / 2 x (height + 1) / 2, as ConvertToYUV420 writes them.
+struct YUVImage {
+    PoolBuffer data;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t* y = nullptr;
+    uint8_t* u = nullptr;
+    uint8_t* v = nullptr;
+
+    uint32_t ChromaWidth() const { return (width + 1) / 2; }
+    uint32_t ChromaHeight() const { return (height + 1) / 2; }
+    size_t Bytes() const {
+        return static_cast<size_t>(width) * height + 2 * static_cast<size_t>(ChromaWidth()) * ChromaHeight();
+    }
+};
+
+std::shared_ptr<YUVImage> AllocateYUV(uint32_t width, uint32_t height) {
+    auto image = std::make_shared<YUVImage>();
+    image->width = width;
+    image->height = height;
+    image->data = GetGlobalMemoryPool()->GetBuffer(image->Bytes());
+    if (!image->data) {
+        return nullptr;
+    }
+
+    const size_t y_size = static_cast<size_t>(width) * height;
+    const size_t uv_size = static_cast<size_t>(image->ChromaWidth()) * image->ChromaHeight();
+    image->y = image->data.get();
+    image->u = image->y + y_size;
+    image->v = image->u + uv_size;
+    return image;
+}
+
+std::shared_ptr<YUVImage> HalveYUV(const YUVImage& source) {
+    auto half = AllocateYUV((source.width + 1) / 2, (source.height + 1) / 2);
+    if (!half) {
+        return nullptr;
+    }
+
+    SIMD::DownsamplePlane2x(source.y, source.width, source.height, static_cast<int>(source.width),
+                            half->y, static_cast<int>(half->width));
+    SIMD::DownsamplePlane2x(source.u, source.ChromaWidth(), source.ChromaHeight(),
+                            static_cast<int>(source.ChromaWidth()), half->u, static_cast<int>(half->ChromaWidth()));
+    SIMD::DownsamplePlane2x(source.v, source.ChromaWidth(), source.ChromaHeight(),
+                            static_cast<int>(source.ChromaWidth()), half->v, static_cast<int>(half->ChromaWidth()));
+    return half;
+}
+
+// Bilinear resize of one plane by a factor between 1 and 2 (the cascade has
+// already halved down to within 2x of the target), in 16.16 fixed point
+void ResamplePlane(const uint8_t* src, uint32_t src_width, uint32_t src_height,
+                   uint8_t* dst, uint32_t dst_width, uint32_t dst_height) {
+    const uint64_t step_x = (static_cast<uint64_t>(src_width) << 16) / dst_width;
+    const uint64_t step_y = (static_cast<uint64_t>(src_height) << 16) / dst_height;
+
+    for (uint32_t y = 0; y < dst_height; ++y) {
+        // Sample at pixel centres so both edges map onto the source edges
+        const int64_t fy = std::max<int64_t>(0, static_cast<int64_t>(y * step_y + step_y / 2) - 0x8000);
+        const uint32_t y0 = std::min<uint32_t>(static_cast<uint32_t>(fy >> 16), src_height - 1);
+        const uint32_t y1 = std::min(y0 + 1, src_height - 1);
+        const uint32_t wy = static_cast<uint32_t>(fy & 0xFFFF) >> 8;
+        const uint8_t* row0 = src + static_cast<size_t>(y0) * src_width;
+        const uint8_t* row1 = src + static_cast<size_t>(y1) * src_width;
+        uint8_t* out = dst + static_cast<size_t>(y) * dst_width;
+
+        for (uint32_t x = 0; x < dst_width; ++x) {
+            const int64_t fx = std::max<int64_t>(0, static_cast<int64_t>(x * step_x + step_x / 2) - 0x8000);
+            const uint32_t x0 = std::min<uint32_t>(static_cast<uint32_t>(fx >> 16), src_width - 1);
+            const uint32_t x1 = std::min(x0 + 1, src_width - 1);
+            const uint32_t wx = static_cast<uint32_t>(fx & 0xFFFF) >> 8;
+            const uint32_t top = row0[x0] * (256 - wx) + row0[x1] * wx;
+            const uint32_t bottom = row1[x0] * (256 - wx) + row1[x1] * wx;
+            out[x] = static_cast<uint8_t>((top * (256 - wy) + bottom * wy + 32768) >> 16);
+        }
+    }
+}
+
+std::shared_ptr<YUVImage> ResampleYUV(const YUVImage& source, uint32_t width, uint32_t height) {
+    auto image = AllocateYUV(width, height);
+    if (!image) {
+        return nullptr;
+    }
+
+    ResamplePlane(source.y, source.width, source.height, image->y, width, height);
+    ResamplePlane(source.u, source.ChromaWidth(), source.ChromaHeight(),
+                  image->u, image->ChromaWidth(), image->ChromaHeight());
+    ResamplePlane(source.v, source.ChromaWidth(), source.ChromaHeight(),
+                  image->v, image->ChromaWidth(), image->ChromaHeight());
+    return image;
+}
+
+// Capture layouts carry no meaningful alpha in their fourth byte when BGRA
+std::vector<uint8_t> EncodeCaptureFormat(WebPEncoder& encoder, const ScreenshotResult& screenshot,
+                                         const WebPEncodeParams& params) {
+    const uint8_t* data = screenshot.data.get();
+    if (screenshot.bytes_per_pixel == 3) {
+        return encoder.EncodeRGB(data, screenshot.width, screenshot.height, screenshot.stride, params);
+    }
+    if (screenshot.format == "BGRA") {
+        return encoder.EncodeBGRA(data, screenshot.width, screenshot.height, screenshot.stride, params, false);
+    }
+    return encoder.EncodeRGBA(data, screenshot.width, screenshot.height, screenshot.stride, params);
+}
+
+// A finished file (e.g. from TileCache) written to caller memory, with
+// the same result EncodeInto gives
+EncodeIntoResult CopyToSpan(const std::vector<uint8_t>& file, EncodeSpan span) {
+    EncodeIntoResult result;
+    result.required_size = file.size();
+    if (span.data && file.size() <= span.capacity) {
+        std::memcpy(span.data, file.data(), file.size());
+        result.success = true;
+        result.bytes_written = file.size();
+    }
+    return result;
+}
+
+} // anonymous namespace
+
 // Advanced streaming pipeline for ultra-large images (8K+, multi-monitor setups)
 class UltraStreamingPipeline {
 public:
+    // Progress callback for streaming operations
+    using StreamingProgressCallback = UltraStreaming::StreamingProgressCallback;
+
     UltraStreamingPipeline();
     ~UltraStreamingPipeline();
     
     // Initialize the streaming pipeline
-    bool Initialize(uint32_t worker_threads = 0);
+    using WorkerPlacement = UltraStreaming::WorkerPlacement;
+    bool Initialize(uint32_t worker_threads = 0, const WorkerPlacement& placement = {});
     
     // Stream capture and encode ultra-large images
     std::future<std::vector<uint8_t>> StreamCaptureAndEncode(
@@ -24,22 +169,45 @@ public:
         StreamingProgressCallback callback = nullptr
     );
     
+    // StreamCaptureAndEncode into caller memory
+    std::future<EncodeIntoResult> StreamCaptureAndEncodeInto(
+        uint32_t display_index,
+        const WebPEncodeParams& params,
+        EncodeSpan output,
+        StreamingProgressCallback callback = nullptr
+    );
+    
     // Stream multiple displays simultaneously
     std::future<std::vector<std::vector<uint8_t>>> StreamCaptureMultipleDisplays(
         const std::vector<uint32_t>& display_indices,
         const WebPEncodeParams& params,
         StreamingProgressCallback callback = nullptr
     );
+
+    // Capture displays together and encode them as one virtual-desktop image
+    std::future<std::vector<uint8_t>> StreamCaptureVirtualDesktop(
+        const std::vector<uint32_t>& display_indices,
+        const WebPEncodeParams& params,
+        StreamingProgressCallback callback = nullptr
+    );
+
+    // Capture a display and encode it at several sizes from one YUV conversion
+    using MultiResolutionLevel = UltraStreaming::MultiResolutionLevel;
+    std::future<std::vector<MultiResolutionLevel>> StreamCaptureMultiResolution(
+        uint32_t display_index,
+        const std::vector<PyramidLevelSpec>& levels,
+        StreamingProgressCallback callback = nullptr
+    );
+
+    // Encode every level of `levels` from the frame, largest first, one task per level
+    std::vector<MultiResolutionLevel> CreateMultiResolutionPyramid(
+        const ScreenshotResult& screenshot,
+        const std::vector<PyramidLevelSpec>& levels,
+        const StreamingProgressCallback& callback = nullptr
+    );
     
     // Get streaming statistics
-    struct StreamingStats {
-        uint64_t total_pixels_processed;
-        uint64_t total_chunks_processed;
-        uint64_t peak_memory_usage_mb;
-        double average_throughput_mpixels_per_sec;
-        uint32_t active_worker_threads;
-        double compression_ratio;
-    };
+    using StreamingStats = UltraStreaming::StreamingStats;
     
     StreamingStats GetStreamingStats() const;
     
@@ -47,16 +215,16 @@ public:
     void SetChunkSize(uint32_t width, uint32_t height);
     void SetMaxMemoryUsage(uint64_t max_memory_mb);
     void SetCompressionLevel(int level); // 1-9, higher = better compression
-    
-    // Progress callback for streaming operations
-    using StreamingProgressCallback = std::function<bool(double progress_percent, const std::string& status)>;
 
 private:
+    // Non-owning strided view into the captured frame. Every chunk shares
+    // ownership of the frame, so it is freed when the last chunk encode ends.
     struct StreamingChunk {
-        std::unique_ptr<uint8_t[]> pixel_data;
+        std::shared_ptr<const ScreenshotResult> frame;
+        const uint8_t* pixel_data = nullptr;  // Top-left pixel of the chunk
         uint32_t width;
         uint32_t height;
-        uint32_t stride;
+        uint32_t stride;                      // Row pitch of the source frame
         uint32_t x_offset;
         uint32_t y_offset;
         uint32_t chunk_id;
@@ -66,8 +234,46 @@ private:
     struct EncodingTask {
         StreamingChunk chunk;
         WebPEncodeParams params;
-        std::promise<std::vector<uint8_t>> result_promise;
+        // The chunk's file, shared with TileCache (null for pyramid levels)
+        std::promise<TileCache::Bitstream> result_promise;
         uint32_t task_id;
+        TileCache::Key cache_key;   // Looked up and filled when params.tile_cache is set
+        size_t reserved_bytes = 0;  // Memory budget held until the task finishes
+
+        // Frame deadline when params.max_encode_ms is set, and this chunk's share of it
+        std::chrono::steady_clock::time_point deadline;
+        double slice_ms = 0.0;
+
+        // Runs instead of the chunk encode when set (pyramid levels, which
+        // write their level in place)
+        std::function<void()> encode;
+    };
+
+    // Per-worker task deque. The owner takes the oldest task so each request's
+    // chunks run in submission order; idle workers steal the newest.
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::unique_ptr<EncodingTask>> tasks;
+    };
+
+    // Blocking byte-count semaphore. Waiters are served in arrival order so
+    // concurrent requests interleave instead of one starving the others.
+    class MemoryBudget {
+    public:
+        void SetCapacity(uint64_t bytes);
+        // Returns the time spent blocked, in milliseconds
+        double Acquire(uint64_t bytes, const std::atomic<bool>& shutdown);
+        void Release(uint64_t bytes);
+        void Wake();
+        uint64_t InUse() const { return in_use_.load(std::memory_order_relaxed); }
+
+    private:
+        std::mutex mutex_;
+        std::condition_variable condition_;
+        uint64_t capacity_ = 0;
+        std::atomic<uint64_t> in_use_{0};
+        uint64_t next_ticket_ = 0;
+        uint64_t serving_ticket_ = 0;
     };
     
     // Configuration
@@ -76,50 +282,88 @@ private:
     uint64_t max_memory_usage_mb_ = 1024; // 1GB default
     int compression_level_ = 6;
     uint32_t worker_thread_count_ = 0;
+    WorkerPlacement placement_;
     
     // Threading infrastructure
     std::vector<std::thread> worker_threads_;
-    std::queue<std::unique_ptr<EncodingTask>> task_queue_;
-    std::mutex task_queue_mutex_;
-    std::condition_variable task_condition_;
+    std::vector<std::unique_ptr<WorkerQueue>> worker_queues_;
+    std::vector<uint32_t> worker_nodes_;               // NUMA node of each worker
+    std::vector<std::vector<uint32_t>> node_workers_;  // Workers of each node
+    std::atomic<uint32_t> next_queue_{0};
+    std::atomic<uint64_t> pending_tasks_{0};
+    std::atomic<uint32_t> idle_workers_{0};
+    std::mutex idle_mutex_;  // Only taken when a worker runs out of work
+    std::condition_variable idle_condition_;
     std::atomic<bool> shutdown_requested_ = false;
     
     // Statistics
     mutable std::mutex stats_mutex_;
     StreamingStats stats_;
+    double total_encode_seconds_ = 0.0;  // Wall time behind total_pixels_processed
+    std::atomic<uint64_t> tasks_stolen_{0};
+    std::atomic<uint64_t> queue_lock_contentions_{0};
+    std::atomic<uint64_t> worker_idle_waits_{0};
+    std::atomic<uint64_t> memory_budget_waits_{0};
+    std::atomic<uint64_t> memory_budget_wait_us_{0};
+    std::atomic<uint64_t> cross_node_steals_{0};
+    std::atomic<uint32_t> placement_failures_{0};
     
     // Memory management
-    std::atomic<uint64_t> current_memory_usage_ = 0;
+    MemoryBudget memory_budget_;
+
+    // Capture backend, created once and shared by every request
+    std::mutex capture_mutex_;
+    std::unique_ptr<ScreenshotCapture> capture_;
+    ScreenshotResult CaptureDisplay(uint32_t display_index);
+
+    // One backend per display on its own thread, restarted when the set changes
+    std::mutex multi_capture_mutex_;
+    std::unique_ptr<MultiDisplayCapture> multi_capture_;
+    std::vector<uint32_t> multi_capture_indices_;
+    std::vector<MultiDisplayCapture::DisplayFrame> CaptureDisplays(const std::vector<uint32_t>& display_indices,
+                                                                   std::string& error);
+
+    // With `into` set the file is written to that span and `into_result`
+    // describes it; nothing is returned
+    std::vector<uint8_t> EncodeFrame(ScreenshotResult screenshot, const WebPEncodeParams& params,
+                                     const StreamingProgressCallback& callback,
+                                     const EncodeSpan* into = nullptr,
+                                     EncodeIntoResult* into_result = nullptr);
     
     // Worker thread functions
-    void WorkerThreadMain();
+    void WorkerThreadMain(uint32_t worker_index);
+    void PlaceWorker(uint32_t worker_index);
     void ProcessEncodingTask(std::unique_ptr<EncodingTask> task);
+
+    // Scheduler
+    void SubmitTask(std::unique_ptr<EncodingTask> task);
+    std::unique_ptr<EncodingTask> PopLocalTask(uint32_t worker_index);
+    std::unique_ptr<EncodingTask> StealTask(uint32_t worker_index);
+    std::unique_lock<std::mutex> LockQueue(WorkerQueue& queue);
     
     // Chunk management
-    std::vector<StreamingChunk> CreateChunks(const ScreenshotResult& screenshot);
-    std::vector<uint8_t> CombineEncodedChunks(const std::vector<std::vector<uint8_t>>& encoded_chunks,
-                                             uint32_t total_width, uint32_t total_height);
+    std::vector<StreamingChunk> CreateChunks(const std::shared_ptr<const ScreenshotResult>& frame);
+    // One file of ANMF frames, each chunk at its own offset, assembled in
+    // `into` when set; fails if a chunk did
+    std::vector<uint8_t> CombineEncodedChunks(const std::vector<WebPEncoder::EncodedTile>& encoded_chunks,
+                                             uint32_t total_width, uint32_t total_height,
+                                             bool has_alpha, std::string& error,
+                                             const EncodeSpan* into = nullptr,
+                                             EncodeIntoResult* into_result = nullptr);
     
     // Memory-aware chunk processing
-    bool CanAllocateMemory(size_t requested_bytes) const;
-    void UpdateMemoryUsage(int64_t delta);
-    
-    // Advanced WebP streaming encoder
-    std::vector<uint8_t> EncodeChunkAdvanced(const StreamingChunk& chunk, 
-                                            const WebPEncodeParams& params);
+    void ReserveMemory(size_t bytes);
+    void ReleaseMemory(size_t bytes);
+    void RecordFrameStats(uint64_t pixel_count, size_t chunk_count, size_t input_bytes,
+                          size_t output_bytes, double encode_seconds);
     
-    // Multi-resolution encoding for large images
-    struct MultiResolutionLevel {
-        uint32_t width;
-        uint32_t height;
-        float scale_factor;
-        std::vector<uint8_t> encoded_data;
-    };
-    
-    std::vector<MultiResolutionLevel> CreateMultiResolutionPyramid(
-        const ScreenshotResult& screenshot,
-        const WebPEncodeParams& params
-    );
+    // Advanced WebP streaming encoder. With params.max_encode_ms set the
+    // chunk gets what is left before the deadline, at most slice_ms.
+    TileCache::Bitstream EncodeChunkAdvanced(const StreamingChunk& chunk, 
+                                            const WebPEncodeParams& params,
+                                            const TileCache::Key& cache_key,
+                                            std::chrono::steady_clock::time_point deadline = {},
+                                            double slice_ms = 0.0);
 };
 
 UltraStreamingPipeline::UltraStreamingPipeline() {
@@ -128,7 +372,11 @@ UltraStreamingPipeline::UltraStreamingPipeline() {
 
 UltraStreamingPipeline::~UltraStreamingPipeline() {
     shutdown_requested_ = true;
-    task_condition_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    idle_condition_.notify_all();
+    memory_budget_.Wake();
     
     for (auto& thread : worker_threads_) {
         if (thread.joinable()) {
@@ -137,21 +385,45 @@ UltraStreamingPipeline::~UltraStreamingPipeline() {
     }
 }
 
-bool UltraStreamingPipeline::Initialize(uint32_t worker_threads) {
+bool UltraStreamingPipeline::Initialize(uint32_t worker_threads, const WorkerPlacement& placement) {
+    if (!worker_threads_.empty()) {
+        return true;  // Already running
+    }
+    placement_ = placement;
+
     if (worker_threads == 0) {
         worker_thread_count_ = std::max(2u, std::thread::hardware_concurrency());
     } else {
         worker_thread_count_ = worker_threads;
     }
     
+    memory_budget_.SetCapacity(max_memory_usage_mb_ * 1024 * 1024);
+
+    // Queues must exist before any worker can try to steal from them
+    worker_queues_.reserve(worker_thread_count_);
+    for (uint32_t i = 0; i < worker_thread_count_; ++i) {
+        worker_queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    // Worker i belongs to node i % nodes, so every node gets its share
+    const uint32_t node_count = placement_.numa_aware
+        ? std::max(1u, std::min(ThreadPlacement::GetNumaNodeCount(), worker_thread_count_)) : 1;
+    node_workers_.assign(node_count, {});
+    worker_nodes_.resize(worker_thread_count_);
+    for (uint32_t i = 0; i < worker_thread_count_; ++i) {
+        worker_nodes_[i] = i % node_count;
+        node_workers_[i % node_count].push_back(i);
+    }
+
     // Start worker threads
     worker_threads_.reserve(worker_thread_count_);
     
     for (uint32_t i = 0; i < worker_thread_count_; ++i) {
-        worker_threads_.emplace_back(&UltraStreamingPipeline::WorkerThreadMain, this);
+        worker_threads_.emplace_back(&UltraStreamingPipeline::WorkerThreadMain, this, i);
     }
     
     stats_.active_worker_threads = worker_thread_count_;
+    stats_.numa_nodes = node_count;
     
     return true;
 }
@@ -163,133 +435,281 @@ std::future<std::vector<uint8_t>> UltraStreamingPipeline::StreamCaptureAndEncode
     
     return std::async(std::launch::async, [this, display_index, params, callback]() -> std::vector<uint8_t> {
         try {
-            // Capture screenshot
-            auto capture = CreateScreenshotCapture();
-            auto screenshot = capture->CaptureDisplay(display_index);
+            // Capture screenshot with the pipeline's long-lived backend
+            auto screenshot = CaptureDisplay(display_index);
             
             if (!screenshot.success) {
                 if (callback) callback(0.0, "Capture failed: " + screenshot.error_message);
                 return {};
             }
             
-            if (callback) callback(10.0, "Capture completed, starting streaming encode");
-            
-            // Check if ultra-streaming is needed
-            const uint64_t pixel_count = static_cast<uint64_t>(screenshot.width) * screenshot.height;
-            const uint64_t ultra_large_threshold = 7680 * 4320; // 8K resolution
+            return EncodeFrame(std::move(screenshot), params, callback);
             
-            if (pixel_count < ultra_large_threshold) {
-                // Use regular optimized encoding for smaller images
-                if (callback) callback(50.0, "Using optimized single-pass encoding");
-                
-                WebPEncoder encoder;
-                auto result = encoder.EncodeRGBA(screenshot.data.get(), screenshot.width, 
-                                               screenshot.height, screenshot.stride, params);
-                
-                if (callback) callback(100.0, "Encoding completed");
+        } catch (const std::exception& e) {
+            if (callback) callback(0.0, "Error: " + std::string(e.what()));
+            return {};
+        }
+    });
+}
+
+std::future<EncodeIntoResult> UltraStreamingPipeline::StreamCaptureAndEncodeInto(
+    uint32_t display_index,
+    const WebPEncodeParams& params,
+    EncodeSpan output,
+    StreamingProgressCallback callback) {
+    
+    return std::async(std::launch::async, [this, display_index, params, output, callback]() {
+        EncodeIntoResult result;
+        try {
+            auto screenshot = CaptureDisplay(display_index);
+            if (!screenshot.success) {
+                if (callback) callback(0.0, "Capture failed: " + screenshot.error_message);
                 return result;
             }
             
-            // Ultra-streaming encoding for very large images
-            if (callback) callback(15.0, "Starting ultra-streaming pipeline");
-            
-            // Create chunks
-            auto chunks = CreateChunks(screenshot);
+            EncodeFrame(std::move(screenshot), params, callback, &output, &result);
+        } catch (const std::exception& e) {
+            if (callback) callback(0.0, "Error: " + std::string(e.what()));
+        }
+        return result;
+    });
+}
+
+std::vector<uint8_t> UltraStreamingPipeline::EncodeFrame(ScreenshotResult screenshot,
+                                                         const WebPEncodeParams& params,
+                                                         const StreamingProgressCallback& callback,
+                                                         const EncodeSpan* into,
+                                                         EncodeIntoResult* into_result) {
+    try {
+        if (callback) callback(10.0, "Capture completed, starting streaming encode");
+        
+        // Check if ultra-streaming is needed
+        const uint64_t pixel_count = static_cast<uint64_t>(screenshot.width) * screenshot.height;
+        const uint64_t ultra_large_threshold = 7680 * 4320; // 8K resolution
+        const auto encode_start = std::chrono::steady_clock::now();
+        
+        if (pixel_count < ultra_large_threshold) {
+            // Use regular optimized encoding for smaller images
+            if (callback) callback(50.0, "Using optimized single-pass encoding");
             
-            if (callback) {
-                callback(20.0, "Created " + std::to_string(chunks.size()) + " chunks for processing");
+            WebPEncoder encoder;
+            std::vector<uint8_t> result;
+            size_t encoded_size = 0;
+            if (into) {
+                *into_result = encoder.EncodeInto(screenshot.data.get(), screenshot.width, screenshot.height,
+                                                  screenshot.stride, WebPEncoder::PixelLayout::RGBA, params, *into);
+                encoded_size = into_result->bytes_written;
+            } else {
+                result = encoder.EncodeRGBA(screenshot.data.get(), screenshot.width, 
+                                            screenshot.height, screenshot.stride, params);
+                encoded_size = result.size();
+            }
+            if (encoded_size > 0) {
+                RecordFrameStats(pixel_count, 1, screenshot.data_size, encoded_size,
+                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - encode_start).count());
+            } else if (callback) {
+                callback(0.0, "Error: " + encoder.GetLastError());
             }
             
+            if (callback) callback(100.0, "Encoding completed");
+            return result;
+        }
+        
+        // Ultra-streaming encoding for very large images
+        if (callback) callback(15.0, "Starting ultra-streaming pipeline");
+        
+        const uint32_t frame_width = screenshot.width;
+        const uint32_t frame_height = screenshot.height;
+        const uint32_t frame_size = screenshot.data_size;
+        const bool has_alpha = screenshot.bytes_per_pixel == 4;
+
+        // Chunks reference the frame in place instead of copying it out
+        auto frame = std::make_shared<const ScreenshotResult>(std::move(screenshot));
+        auto chunks = CreateChunks(frame);
+
+        // max_output_size bounds the combined file, not each chunk: every
+        // chunk aims at its pixel share of the target, and the whole frame
+        // is encoded again at a lower target when the chunks add up to more
+        const size_t cap = params.max_output_size > 0 ? static_cast<size_t>(params.max_output_size) : 0;
+        WebPEncodeParams attempt = params;
+        int target = params.max_output_size;
+        if (cap > 0) {
+            attempt.pass = std::max(params.pass, kSizeSearchPasses);
+            attempt.target_size = params.target_size > 0 ? std::min(params.target_size, target) : target;
+        }
+
+        // Same keys as WebPEncoder::EncodeWithTileCache: one per chunk, and
+        // one for the frame from the chunks', so a repeated frame is the
+        // previous file without touching the workers. They take the
+        // attempt's params, so a retry never picks up an oversized chunk.
+        std::vector<TileCache::Key> chunk_keys;
+        auto make_chunk_keys = [&] {
+            chunk_keys.clear();
+            chunk_keys.reserve(chunks.size());
+            for (const auto& chunk : chunks) {
+                chunk_keys.push_back(TileCache::MakeKey(chunk.pixel_data, chunk.width, chunk.height,
+                                                        chunk.stride, WebPEncoder::PixelLayout::RGBA, attempt));
+            }
+        };
+        TileCache::Key frame_key;
+        if (params.tile_cache) {
+            make_chunk_keys();
+            frame_key = TileCache::MakeFrameKey(chunk_keys, frame_width, frame_height);
+            if (TileCache::Bitstream file = TileCache::Find(frame_key)) {
+                Stats::AddFrameCacheLookup(true);
+                RecordFrameStats(pixel_count, chunks.size(), frame_size, file->size(),
+                                 std::chrono::duration<double>(std::chrono::steady_clock::now() - encode_start).count());
+                if (callback) callback(100.0, "Unchanged frame taken from the tile cache");
+                if (into) {
+                    *into_result = CopyToSpan(*file, *into);
+                    return {};
+                }
+                return *file;
+            }
+            Stats::AddFrameCacheLookup(false);
+        }
+        
+        if (callback) {
+            callback(20.0, "Created " + std::to_string(chunks.size()) + " chunks for processing");
+        }
+        
+        // Bounding each request's in-flight window keeps concurrent
+        // captures interleaved on the FIFO worker queues
+        const size_t max_concurrent_chunks = std::max<size_t>(1, worker_thread_count_ * 2);
+        const size_t total_chunks = chunks.size();
+
+        // A latency budget covers the whole frame; chunks run a round per
+        // worker count, so each round gets its share
+        const auto deadline = encode_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::milli>(params.max_encode_ms));
+        const size_t rounds = (total_chunks + worker_thread_count_ - 1) / std::max(1u, worker_thread_count_);
+        const double slice_ms = params.max_encode_ms > 0.0f
+            ? params.max_encode_ms / std::max<size_t>(1, rounds) : 0.0;
+
+        std::vector<WebPEncoder::EncodedTile> placed(chunks.size());
+        std::string error;
+        for (int attempt_index = 0; ; ++attempt_index) {
             // Process chunks in parallel with memory management
-            std::vector<std::future<std::vector<uint8_t>>> chunk_futures;
+            std::vector<std::future<TileCache::Bitstream>> chunk_futures;
             chunk_futures.reserve(chunks.size());
             
             size_t chunks_submitted = 0;
-            const size_t max_concurrent_chunks = std::min(
-                static_cast<size_t>(worker_thread_count_ * 2),
-                max_memory_usage_mb_ * 1024 * 1024 / (chunk_width_ * chunk_height_ * 4)
-            );
+            size_t oldest_in_flight = 0;
             
             for (auto& chunk : chunks) {
-                // Wait for memory availability
-                while (!CanAllocateMemory(chunk.width * chunk.height * 4)) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                if (chunks_submitted - oldest_in_flight >= max_concurrent_chunks) {
+                    chunk_futures[oldest_in_flight++].wait();
                 }
+
+                // Blocks until enough of the memory budget has been released
+                const size_t chunk_memory = static_cast<size_t>(chunk.width) * chunk.height * 4;
+                ReserveMemory(chunk_memory);
                 
+                WebPEncoder::EncodedTile& tile = placed[chunks_submitted];
+                tile.x = chunk.x_offset;
+                tile.y = chunk.y_offset;
+                tile.width = chunk.width;
+                tile.height = chunk.height;
+
                 // Submit chunk for processing
                 auto task = std::make_unique<EncodingTask>();
-                task->chunk = std::move(chunk);
-                task->params = params;
-                task->task_id = static_cast<uint32_t>(chunks_submitted);
-                
-                auto future = task->result_promise.get_future();
-                
-                {
-                    std::lock_guard<std::mutex> lock(task_queue_mutex_);
-                    task_queue_.push(std::move(task));
+                if (params.tile_cache) {
+                    task->cache_key = chunk_keys[chunks_submitted];
+                }
+                task->params = attempt;
+                task->params.max_output_size = 0;
+                if (attempt.target_size > 0) {
+                    const double share = static_cast<double>(chunk.width) * chunk.height / pixel_count;
+                    task->params.target_size = std::max(1, static_cast<int>(attempt.target_size * share));
                 }
+                // A capped frame may be encoded again, so its chunks stay
+                task->chunk = cap > 0 ? chunk : std::move(chunk);
+                task->task_id = static_cast<uint32_t>(chunks_submitted);
+                task->reserved_bytes = chunk_memory;
+                task->deadline = deadline;
+                task->slice_ms = slice_ms;
                 
-                task_condition_.notify_one();
-                chunk_futures.push_back(std::move(future));
+                chunk_futures.push_back(task->result_promise.get_future());
+                SubmitTask(std::move(task));
                 
                 chunks_submitted++;
                 
                 // Update progress
                 if (callback) {
-                    double progress = 20.0 + (chunks_submitted / static_cast<double>(chunks.size())) * 60.0;
+                    double progress = 20.0 + (chunks_submitted / static_cast<double>(total_chunks)) * 60.0;
                     callback(progress, "Processing chunk " + std::to_string(chunks_submitted) + 
-                                     "/" + std::to_string(chunks.size()));
-                }
-                
-                // Limit concurrent chunks to manage memory
-                if (chunks_submitted >= max_concurrent_chunks) {
-                    // Wait for some chunks to complete
-                    for (size_t i = 0; i < chunk_futures.size(); ++i) {
-                        if (chunk_futures[i].wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
-                            chunk_futures[i].get(); // Get result and free memory
-                            break;
-                        }
-                    }
+                                     "/" + std::to_string(total_chunks));
                 }
             }
             
+            // From here the in-flight chunks alone keep an uncapped frame alive
+            frame.reset();
+
             if (callback) callback(80.0, "Waiting for all chunks to complete");
             
-            // Collect all encoded chunks
-            std::vector<std::vector<uint8_t>> encoded_chunks;
-            encoded_chunks.reserve(chunk_futures.size());
-            
-            for (auto& future : chunk_futures) {
-                auto result = future.get();
-                encoded_chunks.push_back(std::move(result));
+            // Collect all encoded chunks; they stay shared with TileCache until
+            // their image data is copied into the file
+            for (size_t i = 0; i < chunk_futures.size(); ++i) {
+                placed[i].bitstream = chunk_futures[i].get();
             }
-            
-            if (callback) callback(90.0, "Combining encoded chunks");
-            
-            // Combine chunks into final WebP
-            auto final_result = CombineEncodedChunks(encoded_chunks, screenshot.width, screenshot.height);
-            
-            // Update statistics
-            {
-                std::lock_guard<std::mutex> lock(stats_mutex_);
-                stats_.total_pixels_processed += pixel_count;
-                stats_.total_chunks_processed += chunks.size();
-                
-                if (final_result.size() > 0) {
-                    double ratio = static_cast<double>(screenshot.data_size) / final_result.size();
-                    stats_.compression_ratio = (stats_.compression_ratio + ratio) / 2.0; // Running average
-                }
+
+            if (cap == 0) {
+                break;
             }
-            
-            if (callback) callback(100.0, "Ultra-streaming encoding completed");
-            
+
+            // Measure the combined file (an empty span) before building it
+            const EncodeSpan measure;
+            EncodeIntoResult measured;
+            CombineEncodedChunks(placed, frame_width, frame_height, has_alpha, error, &measure, &measured);
+            if (measured.required_size == 0) {
+                if (callback) callback(0.0, "Error: " + error);
+                return {};
+            }
+            if (measured.required_size <= cap) {
+                break;
+            }
+
+            // Lossless ignores the target
+            if (params.lossless || attempt_index + 1 == kMaxSizeAttempts) {
+                error = "Encoded image exceeds max_output_size (" + std::to_string(measured.required_size) +
+                        " > " + std::to_string(cap) + " bytes)";
+                if (callback) callback(0.0, "Error: " + error);
+                return {};
+            }
+            target = std::max(1, static_cast<int>(target * kSizeRetryMargin * cap / measured.required_size));
+            attempt.target_size = params.target_size > 0 ? std::min(params.target_size, target) : target;
+            if (params.tile_cache) {
+                make_chunk_keys();
+            }
+            if (callback) callback(20.0, "Encoding chunks again at a " + std::to_string(target) + " byte target");
+        }
+        
+        if (callback) callback(90.0, "Combining encoded chunks");
+        
+        // Combine chunks into final WebP
+        auto final_result = CombineEncodedChunks(placed, frame_width, frame_height, has_alpha, error,
+                                                 into, into_result);
+        const size_t final_size = into ? into_result->bytes_written : final_result.size();
+        if (final_size == 0) {
+            if (callback) callback(0.0, "Error: " + error);
             return final_result;
-            
-        } catch (const std::exception& e) {
-            if (callback) callback(0.0, "Error: " + std::string(e.what()));
-            return {};
         }
-    });
+        
+        RecordFrameStats(pixel_count, chunks.size(), frame_size, final_size,
+                         std::chrono::duration<double>(std::chrono::steady_clock::now() - encode_start).count());
+        if (params.tile_cache) {
+            const uint8_t* file = into ? into->data : final_result.data();
+            TileCache::Insert(frame_key, std::make_shared<const std::vector<uint8_t>>(file, file + final_size));
+        }
+        
+        if (callback) callback(100.0, "Ultra-streaming encoding completed");
+        
+        return final_result;
+        
+    } catch (const std::exception& e) {
+        if (callback) callback(0.0, "Error: " + std::string(e.what()));
+        return {};
+    }
 }
 
 std::future<std::vector<std::vector<uint8_t>>> UltraStreamingPipeline::StreamCaptureMultipleDisplays(
@@ -303,11 +723,19 @@ std::future<std::vector<std::vector<uint8_t>>> UltraStreamingPipeline::StreamCap
         std::vector<std::vector<uint8_t>> results;
         results.reserve(display_indices.size());
         
+        // Every display is grabbed in the same instant; the encodes then share the workers
+        std::string error;
+        auto frames = CaptureDisplays(display_indices, error);
+        if (frames.empty()) {
+            if (callback) callback(0.0, "Capture failed: " + error);
+            results.resize(display_indices.size());
+            return results;
+        }
+        
         std::vector<std::future<std::vector<uint8_t>>> display_futures;
-        display_futures.reserve(display_indices.size());
+        display_futures.reserve(frames.size());
         
-        // Start capture for all displays simultaneously
-        for (size_t i = 0; i < display_indices.size(); ++i) {
+        for (size_t i = 0; i < frames.size(); ++i) {
             auto display_callback = [callback, i, total = display_indices.size()]
                 (double progress, const std::string& status) -> bool {
                 if (callback) {
@@ -319,9 +747,15 @@ std::future<std::vector<std::vector<uint8_t>>> UltraStreamingPipeline::StreamCap
                 return true;
             };
             
-            display_futures.push_back(
-                StreamCaptureAndEncode(display_indices[i], params, display_callback)
-            );
+            auto frame = std::make_shared<ScreenshotResult>(std::move(frames[i].result));
+            display_futures.push_back(std::async(std::launch::async,
+                [this, frame, params, display_callback]() -> std::vector<uint8_t> {
+                    if (!frame->success) {
+                        display_callback(0.0, "Capture failed: " + frame->error_message);
+                        return {};
+                    }
+                    return EncodeFrame(std::move(*frame), params, display_callback);
+                }));
         }
         
         // Collect results
@@ -333,54 +767,456 @@ std::future<std::vector<std::vector<uint8_t>>> UltraStreamingPipeline::StreamCap
     });
 }
 
-void UltraStreamingPipeline::WorkerThreadMain() {
-    while (!shutdown_requested_) {
-        std::unique_ptr<EncodingTask> task;
+std::future<std::vector<uint8_t>> UltraStreamingPipeline::StreamCaptureVirtualDesktop(
+    const std::vector<uint32_t>& display_indices,
+    const WebPEncodeParams& params,
+    StreamingProgressCallback callback) {
+    
+    return std::async(std::launch::async,
+        [this, display_indices, params, callback]() -> std::vector<uint8_t> {
         
-        // Wait for task
-        {
-            std::unique_lock<std::mutex> lock(task_queue_mutex_);
-            task_condition_.wait(lock, [this] {
-                return !task_queue_.empty() || shutdown_requested_;
-            });
-            
-            if (shutdown_requested_) break;
+        std::string error;
+        auto frames = CaptureDisplays(display_indices, error);
+        if (frames.empty()) {
+            if (callback) callback(0.0, "Capture failed: " + error);
+            return {};
+        }
+        
+        if (callback) callback(10.0, "Captured " + std::to_string(frames.size()) + " displays, encoding canvas");
+        
+        const auto encode_start = std::chrono::steady_clock::now();
+        std::vector<uint8_t> result = MultiDisplayCapture::EncodeVirtualDesktop(frames, params, error);
+        if (result.empty()) {
+            if (callback) callback(0.0, "Encoding failed: " + error);
+            return {};
+        }
+        
+        const double duration = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - encode_start).count();
+        uint64_t pixels = 0;
+        uint64_t input_bytes = 0;
+        for (const auto& frame : frames) {
+            pixels += static_cast<uint64_t>(frame.result.width) * frame.result.height;
+            input_bytes += static_cast<uint64_t>(frame.result.stride) * frame.result.height;
+        }
+        RecordFrameStats(pixels, frames.size(), input_bytes, result.size(), duration);
+        
+        if (callback) callback(100.0, "Virtual desktop encoding completed");
+        return result;
+    });
+}
+
+std::future<std::vector<MultiResolutionLevel>> UltraStreamingPipeline::StreamCaptureMultiResolution(
+    uint32_t display_index,
+    const std::vector<PyramidLevelSpec>& levels,
+    StreamingProgressCallback callback) {
+    
+    return std::async(std::launch::async,
+        [this, display_index, levels, callback]() -> std::vector<MultiResolutionLevel> {
+        
+        auto screenshot = CaptureDisplay(display_index);
+        if (!screenshot.success) {
+            if (callback) callback(0.0, "Capture failed: " + screenshot.error_message);
+            std::vector<MultiResolutionLevel> failed(levels.size());
+            for (auto& level : failed) {
+                level.error_message = "Capture failed: " + screenshot.error_message;
+            }
+            return failed;
+        }
+        
+        return CreateMultiResolutionPyramid(screenshot, levels, callback);
+    });
+}
+
+std::vector<MultiResolutionLevel> UltraStreamingPipeline::CreateMultiResolutionPyramid(
+    const ScreenshotResult& screenshot,
+    const std::vector<PyramidLevelSpec>& levels,
+    const StreamingProgressCallback& callback) {
+    
+    std::vector<MultiResolutionLevel> results(levels.size());
+    auto fail_all = [&](const std::string& error) {
+        for (auto& level : results) {
+            if (level.encoded_data.empty() && level.error_message.empty()) {
+                level.error_message = error;
+            }
+        }
+        if (callback) callback(0.0, "Error: " + error);
+        return results;
+    };
+    
+    if (!screenshot.success || !screenshot.data || screenshot.width == 0 || screenshot.height == 0) {
+        return fail_all("Invalid screenshot");
+    }
+    if (screenshot.bytes_per_pixel != 3 && screenshot.bytes_per_pixel != 4) {
+        return fail_all("Unsupported pixel format");
+    }
+    
+    const auto encode_start = std::chrono::steady_clock::now();
+    
+    // Resolve every level's size; the longer side cap is applied after scaling
+    std::vector<size_t> order;
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const PyramidLevelSpec& spec = levels[i];
+        if (!(spec.scale > 0.0f && spec.scale <= 1.0f)) {
+            results[i].error_message = "Level scale must be in (0, 1]";
+            continue;
+        }
+        
+        double width = std::max(1.0, std::round(screenshot.width * static_cast<double>(spec.scale)));
+        double height = std::max(1.0, std::round(screenshot.height * static_cast<double>(spec.scale)));
+        const double longer = std::max(width, height);
+        if (spec.max_dimension > 0 && longer > spec.max_dimension) {
+            width = std::max(1.0, std::round(width * spec.max_dimension / longer));
+            height = std::max(1.0, std::round(height * spec.max_dimension / longer));
+        }
+        
+        results[i].width = static_cast<uint32_t>(width);
+        results[i].height = static_cast<uint32_t>(height);
+        results[i].scale_factor = static_cast<float>(width / screenshot.width);
+        
+        const bool full_size = results[i].width == screenshot.width && results[i].height == screenshot.height;
+        if (!full_size && spec.params.lossless) {
+            results[i].error_message = "Downscaled levels are lossy only";
+        } else if (!full_size && (results[i].width > WEBP_MAX_DIMENSION || results[i].height > WEBP_MAX_DIMENSION)) {
+            results[i].error_message = "Level exceeds the maximum WebP dimension";
+        } else {
+            order.push_back(i);
+        }
+    }
+    
+    // Largest first: the cascade halves down level by level while the big
+    // encodes already run
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return static_cast<uint64_t>(results[a].width) * results[a].height >
+               static_cast<uint64_t>(results[b].width) * results[b].height;
+    });
+    
+    // One conversion for every level that can start from YUV420
+    const uint32_t step = screenshot.bytes_per_pixel;
+    std::shared_ptr<YUVImage> frame_yuv;
+    const auto needs_yuv = std::any_of(order.begin(), order.end(), [&](size_t i) {
+        const WebPEncodeParams& params = levels[i].params;
+        const bool full_size = results[i].width == screenshot.width && results[i].height == screenshot.height;
+        return !full_size || (!params.lossless && !params.use_sharp_yuv && !params.content_adaptive &&
+                              !params.tile_cache && screenshot.width <= WEBP_MAX_DIMENSION &&
+                              screenshot.height <= WEBP_MAX_DIMENSION);
+    });
+    if (needs_yuv) {
+        frame_yuv = AllocateYUV(screenshot.width, screenshot.height);
+        if (!frame_yuv) {
+            return fail_all("Failed to allocate YUV planes");
+        }
+        SIMD::ConvertToYUV420(screenshot.data.get(), screenshot.width, screenshot.height, screenshot.stride,
+                              step, screenshot.format == "BGRA",
+                              frame_yuv->y, static_cast<int>(frame_yuv->width),
+                              frame_yuv->u, frame_yuv->v, static_cast<int>(frame_yuv->ChromaWidth()),
+                              nullptr, 0);
+    }
+    
+    if (callback) callback(10.0, "Converted frame, encoding " + std::to_string(order.size()) + " levels");
+    
+    std::vector<std::future<TileCache::Bitstream>> level_futures;
+    std::vector<size_t> level_indices;  // Level of each future; failed levels have none
+    level_futures.reserve(order.size());
+    level_indices.reserve(order.size());
+    std::shared_ptr<YUVImage> halving = frame_yuv;
+    
+    for (size_t submitted = 0; submitted < order.size(); ++submitted) {
+        const size_t index = order[submitted];
+        MultiResolutionLevel* level = &results[index];
+        const uint32_t width = level->width;
+        const uint32_t height = level->height;
+        WebPEncodeParams params = levels[index].params;
+        
+        std::function<void()> encode;
+        const bool full_size = width == screenshot.width && height == screenshot.height;
+        if (full_size && (params.lossless || params.use_sharp_yuv || params.content_adaptive ||
+                          params.tile_cache || width > WEBP_MAX_DIMENSION || height > WEBP_MAX_DIMENSION)) {
+            // Every level is collected before returning, so the frame outlives the task
+            encode = [&screenshot, params, level]() {
+                WebPEncoder encoder;
+                level->encoded_data = EncodeCaptureFormat(encoder, screenshot, params);
+                if (level->encoded_data.empty()) level->error_message = encoder.GetLastError();
+            };
+        } else {
+            // Halve while the next halving still covers the level, then
+            // resample the rest (under 2x) bilinearly
+            while ((halving->width + 1) / 2 >= width && (halving->height + 1) / 2 >= height &&
+                   (halving->width > 1 || halving->height > 1)) {
+                auto next = HalveYUV(*halving);
+                if (!next) {
+                    level->error_message = "Failed to allocate YUV planes";
+                    break;
+                }
+                halving = std::move(next);
+            }
+            if (!level->error_message.empty()) {
+                continue;
+            }
             
-            if (!task_queue_.empty()) {
-                task = std::move(task_queue_.front());
-                task_queue_.pop();
+            std::shared_ptr<YUVImage> planes = halving;
+            if (halving->width != width || halving->height != height) {
+                planes = ResampleYUV(*halving, width, height);
+                if (!planes) {
+                    level->error_message = "Failed to allocate YUV planes";
+                    continue;
+                }
             }
+            
+            // Both read RGB, which no longer exists below full size
+            params.use_sharp_yuv = 0;
+            params.content_adaptive = 0;
+            params.tile_cache = 0;
+            encode = [planes, params, level]() {
+                WebPEncoder encoder;
+                level->encoded_data = encoder.EncodeYUV420(planes->y, static_cast<int>(planes->width),
+                                                           planes->u, planes->v,
+                                                           static_cast<int>(planes->ChromaWidth()),
+                                                           planes->width, planes->height, params);
+                if (level->encoded_data.empty()) level->error_message = encoder.GetLastError();
+            };
         }
         
+        // Blocks until enough of the memory budget has been released
+        const size_t level_memory = static_cast<size_t>(width) * height * 3 / 2;
+        ReserveMemory(level_memory);
+        
+        auto task = std::make_unique<EncodingTask>();
+        task->params = params;
+        task->task_id = static_cast<uint32_t>(submitted);
+        task->reserved_bytes = level_memory;
+        task->encode = std::move(encode);
+        
+        level_futures.push_back(task->result_promise.get_future());
+        level_indices.push_back(index);
+        SubmitTask(std::move(task));
+        
+        if (callback) {
+            double progress = 10.0 + ((submitted + 1) / static_cast<double>(order.size())) * 70.0;
+            callback(progress, "Encoding level " + std::to_string(width) + "x" + std::to_string(height));
+        }
+    }
+    
+    if (callback) callback(80.0, "Waiting for all levels to complete");
+    
+    size_t output_bytes = 0;
+    for (size_t i = 0; i < level_futures.size(); ++i) {
+        // The task wrote its level in place; the future only reports completion
+        MultiResolutionLevel& level = results[level_indices[i]];
+        try {
+            level_futures[i].get();
+        } catch (const std::exception& e) {
+            level.error_message = e.what();
+        }
+        output_bytes += level.encoded_data.size();
+    }
+    
+    if (output_bytes > 0) {
+        RecordFrameStats(static_cast<uint64_t>(screenshot.width) * screenshot.height, level_futures.size(),
+                         screenshot.data_size, output_bytes,
+                         std::chrono::duration<double>(std::chrono::steady_clock::now() - encode_start).count());
+    }
+    
+    if (callback) callback(100.0, "Multi-resolution encoding completed");
+    return results;
+}
+
+void UltraStreamingPipeline::PlaceWorker(uint32_t worker_index) {
+    if (!placement_.numa_aware && !placement_.pin_workers) {
+        return;
+    }
+
+    const uint32_t node = worker_nodes_[worker_index];
+    ThreadPlacement::Policy policy;
+    if (placement_.numa_aware) {
+        policy.numa_node = static_cast<int32_t>(node);
+    }
+    if (placement_.pin_workers) {
+        // Workers of a node take its cores in turn
+        const uint32_t rank = worker_index / static_cast<uint32_t>(node_workers_.size());
+        if (placement_.numa_aware) {
+            const std::vector<uint32_t> cores = ThreadPlacement::GetNodeCores(node);
+            if (!cores.empty()) {
+                policy.core = static_cast<int32_t>(cores[rank % cores.size()]);
+            }
+        } else {
+            policy.core = static_cast<int32_t>(rank % std::max(1u, std::thread::hardware_concurrency()));
+        }
+    }
+
+    if (!ThreadPlacement::Apply(policy).placed) {
+        placement_failures_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void UltraStreamingPipeline::WorkerThreadMain(uint32_t worker_index) {
+    PlaceWorker(worker_index);
+
+    while (true) {
+        auto task = PopLocalTask(worker_index);
+        if (!task) {
+            task = StealTask(worker_index);
+        }
+
         if (task) {
+            pending_tasks_.fetch_sub(1);
             ProcessEncodingTask(std::move(task));
+            continue;
+        }
+
+        if (shutdown_requested_) break;
+
+        // Nothing anywhere; sleep until a submission bumps pending_tasks_
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        idle_workers_.fetch_add(1);
+        worker_idle_waits_.fetch_add(1, std::memory_order_relaxed);
+        idle_condition_.wait(lock, [this] {
+            return pending_tasks_.load() > 0 || shutdown_requested_;
+        });
+        idle_workers_.fetch_sub(1);
+    }
+}
+
+std::unique_lock<std::mutex> UltraStreamingPipeline::LockQueue(WorkerQueue& queue) {
+    std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        queue_lock_contentions_.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+    }
+    return lock;
+}
+
+void UltraStreamingPipeline::SubmitTask(std::unique_ptr<EncodingTask> task) {
+    // Round-robin spreads a request's chunks over all workers up front, or
+    // over the workers of the node the chunk's pixels live on
+    const uint32_t turn = next_queue_.fetch_add(1, std::memory_order_relaxed);
+    uint32_t index = turn % worker_queues_.size();
+    if (node_workers_.size() > 1 && task->chunk.pixel_data) {
+        const int32_t node = ThreadPlacement::GetMemoryNode(task->chunk.pixel_data);
+        if (node >= 0 && static_cast<size_t>(node) < node_workers_.size()) {
+            const auto& workers = node_workers_[node];
+            index = workers[turn % workers.size()];
         }
     }
+    {
+        auto lock = LockQueue(*worker_queues_[index]);
+        worker_queues_[index]->tasks.push_back(std::move(task));
+    }
+
+    // Both counters are sequentially consistent, so either this thread sees the
+    // idle worker or the worker sees the new task before it sleeps
+    pending_tasks_.fetch_add(1);
+    if (idle_workers_.load() > 0) {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        idle_condition_.notify_one();
+    }
+}
+
+std::unique_ptr<UltraStreamingPipeline::EncodingTask>
+UltraStreamingPipeline::PopLocalTask(uint32_t worker_index) {
+    WorkerQueue& queue = *worker_queues_[worker_index];
+    auto lock = LockQueue(queue);
+    if (queue.tasks.empty()) {
+        return nullptr;
+    }
+
+    auto task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    return task;
+}
+
+std::unique_ptr<UltraStreamingPipeline::EncodingTask>
+UltraStreamingPipeline::StealTask(uint32_t worker_index) {
+    // Victims on this worker's node first, so frames stay near their memory
+    const size_t queue_count = worker_queues_.size();
+    const uint32_t node = worker_nodes_[worker_index];
+    const int passes = node_workers_.size() > 1 ? 2 : 1;
+    for (int pass = 0; pass < passes; ++pass) {
+        const bool remote = pass == 1;
+        for (size_t i = 1; i < queue_count; ++i) {
+            const size_t victim_index = (worker_index + i) % queue_count;
+            if ((worker_nodes_[victim_index] != node) != remote) {
+                continue;
+            }
+            WorkerQueue& victim = *worker_queues_[victim_index];
+            auto lock = LockQueue(victim);
+            if (!victim.tasks.empty()) {
+                auto task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                tasks_stolen_.fetch_add(1, std::memory_order_relaxed);
+                if (remote) {
+                    cross_node_steals_.fetch_add(1, std::memory_order_relaxed);
+                }
+                return task;
+            }
+        }
+    }
+    return nullptr;
 }
 
 void UltraStreamingPipeline::ProcessEncodingTask(std::unique_ptr<EncodingTask> task) {
     try {
-        // Update memory usage
-        size_t chunk_memory = task->chunk.width * task->chunk.height * 4;
-        UpdateMemoryUsage(static_cast<int64_t>(chunk_memory));
-        
         // Encode chunk with advanced optimizations
-        auto encoded_data = EncodeChunkAdvanced(task->chunk, task->params);
+        TileCache::Bitstream encoded_data;
+        if (task->encode) {
+            task->encode();
+        } else {
+            encoded_data = EncodeChunkAdvanced(task->chunk, task->params, task->cache_key,
+                                               task->deadline, task->slice_ms);
+        }
         
         // Set result
         task->result_promise.set_value(std::move(encoded_data));
         
-        // Update memory usage
-        UpdateMemoryUsage(-static_cast<int64_t>(chunk_memory));
-        
     } catch (const std::exception& e) {
         task->result_promise.set_exception(std::current_exception());
     }
+
+    ReleaseMemory(task->reserved_bytes);
+}
+
+ScreenshotResult UltraStreamingPipeline::CaptureDisplay(uint32_t display_index) {
+    // Backends keep per-display state (duplication, X connection) between calls
+    // but are not thread-safe, so concurrent requests take turns capturing
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    if (!capture_) {
+        capture_ = CreateScreenshotCapture();
+    }
+
+    if (!capture_) {
+        ScreenshotResult result;
+        result.error_message = "No screenshot implementation available";
+        return result;
+    }
+
+    return capture_->CaptureDisplay(display_index);
+}
+
+std::vector<MultiDisplayCapture::DisplayFrame>
+UltraStreamingPipeline::CaptureDisplays(const std::vector<uint32_t>& display_indices, std::string& error) {
+    std::lock_guard<std::mutex> lock(multi_capture_mutex_);
+    if (!multi_capture_ || multi_capture_indices_ != display_indices) {
+        multi_capture_.reset();
+        auto capture = std::make_unique<MultiDisplayCapture>([] { return CreateScreenshotCapture(); });
+        if (!capture->Start(display_indices)) {
+            error = capture->GetLastError();
+            return {};
+        }
+        multi_capture_ = std::move(capture);
+        multi_capture_indices_ = display_indices;
+    }
+
+    auto frames = multi_capture_->CaptureAll();
+    if (frames.empty()) {
+        error = multi_capture_->GetLastError();
+    }
+    return frames;
 }
 
 std::vector<UltraStreamingPipeline::StreamingChunk> 
-UltraStreamingPipeline::CreateChunks(const ScreenshotResult& screenshot) {
+UltraStreamingPipeline::CreateChunks(const std::shared_ptr<const ScreenshotResult>& frame) {
     std::vector<StreamingChunk> chunks;
+    const ScreenshotResult& screenshot = *frame;
     
     const uint32_t chunks_x = (screenshot.width + chunk_width_ - 1) / chunk_width_;
     const uint32_t chunks_y = (screenshot.height + chunk_height_ - 1) / chunk_height_;
@@ -396,24 +1232,15 @@ UltraStreamingPipeline::CreateChunks(const ScreenshotResult& screenshot) {
             chunk.y_offset = y * chunk_height_;
             chunk.width = std::min(chunk_width_, screenshot.width - chunk.x_offset);
             chunk.height = std::min(chunk_height_, screenshot.height - chunk.y_offset);
-            chunk.stride = chunk.width * screenshot.bytes_per_pixel;
+            chunk.stride = screenshot.stride;
             chunk.chunk_id = chunk_id++;
             chunk.is_final_chunk = (x == chunks_x - 1 && y == chunks_y - 1);
             
-            // Copy chunk pixel data using memory pool
-            const size_t chunk_size = chunk.height * chunk.stride;
-            chunk.pixel_data = Utils::AllocateScreenshotBuffer(chunk_size);
-            
-            // Extract chunk from screenshot
-            for (uint32_t row = 0; row < chunk.height; ++row) {
-                const uint8_t* src_row = screenshot.data.get() + 
-                    ((chunk.y_offset + row) * screenshot.stride) + 
-                    (chunk.x_offset * screenshot.bytes_per_pixel);
-                
-                uint8_t* dst_row = chunk.pixel_data.get() + (row * chunk.stride);
-                
-                std::memcpy(dst_row, src_row, chunk.stride);
-            }
+            // The encoders take a row stride, so the view is used as-is
+            chunk.frame = frame;
+            chunk.pixel_data = screenshot.data.get() +
+                static_cast<size_t>(chunk.y_offset) * screenshot.stride +
+                static_cast<size_t>(chunk.x_offset) * screenshot.bytes_per_pixel;
             
             chunks.push_back(std::move(chunk));
         }
@@ -422,105 +1249,211 @@ UltraStreamingPipeline::CreateChunks(const ScreenshotResult& screenshot) {
     return chunks;
 }
 
-std::vector<uint8_t> UltraStreamingPipeline::EncodeChunkAdvanced(
+TileCache::Bitstream UltraStreamingPipeline::EncodeChunkAdvanced(
     const StreamingChunk& chunk,
-    const WebPEncodeParams& params) {
+    const WebPEncodeParams& frame_params,
+    const TileCache::Key& cache_key,
+    std::chrono::steady_clock::time_point deadline,
+    double slice_ms) {
     
+    // A chunk with the pixels and settings of one encoded before is reused.
+    // The key (made by EncodeFrame) uses the frame's params, since the
+    // per-chunk budget and target share differ from chunk to chunk.
+    if (frame_params.tile_cache) {
+        if (TileCache::Bitstream cached = TileCache::Find(cache_key)) {
+            Stats::AddTileCacheLookups(1, 0);
+            return cached;
+        }
+        Stats::AddTileCacheLookups(0, 1);
+    }
+
+    // Late chunks get less time; past the deadline the encoder goes straight
+    // to its fastest settings. The chunk is encoded as one picture, since a
+    // tiled file cannot be nested in the combined one: the workers already
+    // run chunks in parallel, and content-adaptive picks one setting for the
+    // whole chunk, as EncodeTile does for a tile.
+    WebPEncodeParams params = frame_params;
+    params.tile_cache = 0;
+    params.enable_multithreading = false;
+    if (frame_params.content_adaptive) {
+        const ContentAnalysis::ContentStats stats =
+            ContentAnalysis::AnalyzeRegion(chunk.pixel_data, chunk.width, chunk.height, chunk.stride, 4);
+        params = ContentAnalysis::ParamsForContent(stats, params);
+    }
+    if (frame_params.max_encode_ms > 0.0f) {
+        double budget_ms = std::chrono::duration<double, std::milli>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (slice_ms > 0.0) {
+            budget_ms = std::min(budget_ms, slice_ms);
+        }
+        params.max_encode_ms = static_cast<float>(std::max(budget_ms, kMinChunkBudgetMs));
+    }
+
     // Use the most advanced encoding available
     std::vector<uint8_t> result;
     
     // Try GPU encoding first for maximum performance
     if (GPU::InitializeGPUEncoder()) {
         result = GPU::EncodeGPUAccelerated(
-            chunk.pixel_data.get(), 
+            chunk.pixel_data, 
             chunk.width, 
             chunk.height, 
             chunk.stride, 
             params
         );
-        
-        if (!result.empty()) {
-            return result;
-        }
     }
     
     // Try SIMD-optimized encoding
-    result = SIMD::EncodeSIMDOptimized(
-        chunk.pixel_data.get(),
-        chunk.width,
-        chunk.height, 
-        chunk.stride,
-        params
-    );
-    
-    if (!result.empty()) {
-        return result;
+    if (result.empty()) {
+        result = SIMD::EncodeSIMDOptimized(
+            chunk.pixel_data,
+            chunk.width,
+            chunk.height, 
+            chunk.stride,
+            params
+        );
     }
     
     // Fallback to standard WebP encoder
-    WebPEncoder encoder;
-    return encoder.EncodeRGBA(chunk.pixel_data.get(), chunk.width, chunk.height, chunk.stride, params);
+    if (result.empty()) {
+        WebPEncoder encoder;
+        result = encoder.EncodeRGBA(chunk.pixel_data, chunk.width, chunk.height, chunk.stride, params);
+    }
+
+    if (result.empty()) {
+        return nullptr;
+    }
+    auto encoded = std::make_shared<const std::vector<uint8_t>>(std::move(result));
+    if (frame_params.tile_cache) {
+        TileCache::Insert(cache_key, encoded);
+    }
+    return encoded;
 }
 
 std::vector<uint8_t> UltraStreamingPipeline::CombineEncodedChunks(
-    const std::vector<std::vector<uint8_t>>& encoded_chunks,
-    uint32_t total_width, uint32_t total_height) {
+    const std::vector<WebPEncoder::EncodedTile>& encoded_chunks,
+    uint32_t total_width, uint32_t total_height,
+    bool has_alpha, std::string& error,
+    const EncodeSpan* into, EncodeIntoResult* into_result) {
     
-    // For ultra-large images, we create a WebP animation/container
-    // or use advanced WebP features to combine chunks
-    // This is a simplified implementation that concatenates chunks
-    
-    std::vector<uint8_t> combined_result;
-    size_t total_size = 0;
-    
-    // Calculate total size
-    for (const auto& chunk : encoded_chunks) {
-        total_size += chunk.size();
+    // Every chunk is a standalone WebP file; the frame is a VP8X canvas
+    // with each chunk's image data as an ANMF frame at its offset
+    for (size_t i = 0; i < encoded_chunks.size(); ++i) {
+        if (!encoded_chunks[i].bitstream) {
+            error = "Chunk " + std::to_string(i) + " failed to encode";
+            return {};
+        }
     }
-    
-    combined_result.reserve(total_size + 1024); // Extra space for headers
-    
-    // WebP container header (simplified)
-    const char webp_header[] = "RIFF\0\0\0\0WEBP";
-    combined_result.insert(combined_result.end(), webp_header, webp_header + 12);
-    
-    // Combine all encoded chunks
-    for (const auto& chunk : encoded_chunks) {
-        combined_result.insert(combined_result.end(), chunk.begin(), chunk.end());
+
+    WebPEncoder encoder;
+    if (into) {
+        *into_result = encoder.AssembleTilesInto(encoded_chunks, total_width, total_height, has_alpha, *into);
+        if (!into_result->success) {
+            error = encoder.GetLastError();
+        }
+        return {};
+    }
+    auto combined_result = encoder.AssembleTiles(encoded_chunks, total_width, total_height, has_alpha);
+    if (combined_result.empty()) {
+        error = encoder.GetLastError();
     }
-    
-    // Update size in header
-    uint32_t file_size = static_cast<uint32_t>(combined_result.size() - 8);
-    std::memcpy(combined_result.data() + 4, &file_size, 4);
-    
     return combined_result;
 }
 
-bool UltraStreamingPipeline::CanAllocateMemory(size_t requested_bytes) const {
-    uint64_t current_usage = current_memory_usage_.load();
-    uint64_t max_usage = max_memory_usage_mb_ * 1024 * 1024;
-    
-    return (current_usage + requested_bytes) <= max_usage;
+void UltraStreamingPipeline::MemoryBudget::SetCapacity(uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capacity_ = bytes;
+    }
+    condition_.notify_all();
 }
 
-void UltraStreamingPipeline::UpdateMemoryUsage(int64_t delta) {
-    current_memory_usage_.fetch_add(delta, std::memory_order_relaxed);
-    
+double UltraStreamingPipeline::MemoryBudget::Acquire(uint64_t bytes, const std::atomic<bool>& shutdown) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t ticket = next_ticket_++;
+
+    // A request larger than the whole budget is let through once nothing else
+    // is in flight, rather than deadlocking
+    auto can_proceed = [&] {
+        if (shutdown) return true;
+        if (ticket != serving_ticket_) return false;
+        const uint64_t in_use = in_use_.load(std::memory_order_relaxed);
+        return in_use + bytes <= capacity_ || in_use == 0;
+    };
+
+    double waited_ms = 0.0;
+    if (!can_proceed()) {
+        const auto start = std::chrono::steady_clock::now();
+        condition_.wait(lock, can_proceed);
+        waited_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    in_use_.fetch_add(bytes, std::memory_order_relaxed);
+    serving_ticket_++;
+    lock.unlock();
+
+    // The next ticket holder may fit as well
+    condition_.notify_all();
+    return waited_ms;
+}
+
+void UltraStreamingPipeline::MemoryBudget::Release(uint64_t bytes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_use_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+    condition_.notify_all();
+}
+
+void UltraStreamingPipeline::MemoryBudget::Wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    condition_.notify_all();
+}
+
+void UltraStreamingPipeline::ReserveMemory(size_t bytes) {
+    const double waited_ms = memory_budget_.Acquire(bytes, shutdown_requested_);
+    if (waited_ms > 0.0) {
+        memory_budget_waits_.fetch_add(1, std::memory_order_relaxed);
+        memory_budget_wait_us_.fetch_add(static_cast<uint64_t>(waited_ms * 1000.0),
+                                         std::memory_order_relaxed);
+    }
+
     // Update peak memory usage
     std::lock_guard<std::mutex> lock(stats_mutex_);
-    uint64_t current_mb = current_memory_usage_.load() / (1024 * 1024);
+    uint64_t current_mb = memory_budget_.InUse() / (1024 * 1024);
     if (current_mb > stats_.peak_memory_usage_mb) {
         stats_.peak_memory_usage_mb = current_mb;
     }
 }
 
+void UltraStreamingPipeline::RecordFrameStats(uint64_t pixel_count, size_t chunk_count, size_t input_bytes,
+                                              size_t output_bytes, double encode_seconds) {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.total_pixels_processed += pixel_count;
+    stats_.total_chunks_processed += chunk_count;
+    total_encode_seconds_ += encode_seconds;
+
+    const double ratio = static_cast<double>(input_bytes) / output_bytes;
+    stats_.compression_ratio = stats_.compression_ratio > 0.0
+        ? (stats_.compression_ratio + ratio) / 2.0  // Running average
+        : ratio;
+}
+
+void UltraStreamingPipeline::ReleaseMemory(size_t bytes) {
+    memory_budget_.Release(bytes);
+}
+
 void UltraStreamingPipeline::SetChunkSize(uint32_t width, uint32_t height) {
-    chunk_width_ = std::max(64u, width);
-    chunk_height_ = std::max(64u, height);
+    chunk_width_ = std::clamp(width, kMinChunkDimension, kMaxChunkDimension) & ~1u;
+    chunk_height_ = std::clamp(height, kMinChunkDimension, kMaxChunkDimension) & ~1u;
 }
 
 void UltraStreamingPipeline::SetMaxMemoryUsage(uint64_t max_memory_mb) {
-    max_memory_usage_mb_ = std::max(256ULL, max_memory_mb);
+    max_memory_usage_mb_ = std::max<uint64_t>(256, max_memory_mb);
+    memory_budget_.SetCapacity(max_memory_usage_mb_ * 1024 * 1024);
 }
 
 void UltraStreamingPipeline::SetCompressionLevel(int level) {
@@ -530,13 +1463,21 @@ void UltraStreamingPipeline::SetCompressionLevel(int level) {
 UltraStreamingPipeline::StreamingStats UltraStreamingPipeline::GetStreamingStats() const {
     std::lock_guard<std::mutex> lock(stats_mutex_);
     
-    // Calculate throughput
+    // Throughput over the measured encode wall time, capture excluded
     StreamingStats current_stats = stats_;
-    if (stats_.total_pixels_processed > 0) {
-        // Estimate throughput based on recent performance
-        current_stats.average_throughput_mpixels_per_sec = 
-            static_cast<double>(stats_.total_pixels_processed) / 1000000.0 / 10.0; // Rough estimate
+    if (total_encode_seconds_ > 0.0) {
+        current_stats.average_throughput_mpixels_per_sec =
+            static_cast<double>(stats_.total_pixels_processed) / 1000000.0 / total_encode_seconds_;
     }
+
+    current_stats.tasks_stolen = tasks_stolen_.load(std::memory_order_relaxed);
+    current_stats.queue_lock_contentions = queue_lock_contentions_.load(std::memory_order_relaxed);
+    current_stats.worker_idle_waits = worker_idle_waits_.load(std::memory_order_relaxed);
+    current_stats.memory_budget_waits = memory_budget_waits_.load(std::memory_order_relaxed);
+    current_stats.cross_node_steals = cross_node_steals_.load(std::memory_order_relaxed);
+    current_stats.placement_failures = placement_failures_.load(std::memory_order_relaxed);
+    current_stats.memory_budget_wait_ms =
+        memory_budget_wait_us_.load(std::memory_order_relaxed) / 1000.0;
     
     return current_stats;
 }
@@ -545,12 +1486,12 @@ UltraStreamingPipeline::StreamingStats UltraStreamingPipeline::GetStreamingStats
 static std::unique_ptr<UltraStreamingPipeline> g_streaming_pipeline;
 
 // Public interface functions
-bool InitializeUltraStreaming(uint32_t worker_threads) {
+bool InitializeUltraStreaming(uint32_t worker_threads, const WorkerPlacement& placement) {
     if (!g_streaming_pipeline) {
         g_streaming_pipeline = std::make_unique<UltraStreamingPipeline>();
     }
     
-    return g_streaming_pipeline->Initialize(worker_threads);
+    return g_streaming_pipeline->Initialize(worker_threads, placement);
 }
 
 std::future<std::vector<uint8_t>> CaptureAndEncodeUltraLarge(
@@ -565,6 +1506,19 @@ std::future<std::vector<uint8_t>> CaptureAndEncodeUltraLarge(
     return g_streaming_pipeline->StreamCaptureAndEncode(display_index, params, callback);
 }
 
+std::future<EncodeIntoResult> CaptureAndEncodeUltraLargeInto(
+    uint32_t display_index,
+    const WebPEncodeParams& params,
+    EncodeSpan output,
+    UltraStreamingPipeline::StreamingProgressCallback callback) {
+    
+    if (!g_streaming_pipeline) {
+        InitializeUltraStreaming();
+    }
+    
+    return g_streaming_pipeline->StreamCaptureAndEncodeInto(display_index, params, output, callback);
+}
+
 std::future<std::vector<std::vector<uint8_t>>> CaptureMultipleDisplaysUltraLarge(
     const std::vector<uint32_t>& display_indices,
     const WebPEncodeParams& params,
@@ -577,6 +1531,42 @@ std::future<std::vector<std::vector<uint8_t>>> CaptureMultipleDisplaysUltraLarge
     return g_streaming_pipeline->StreamCaptureMultipleDisplays(display_indices, params, callback);
 }
 
+std::future<std::vector<uint8_t>> CaptureVirtualDesktopUltraLarge(
+    const std::vector<uint32_t>& display_indices,
+    const WebPEncodeParams& params,
+    UltraStreamingPipeline::StreamingProgressCallback callback) {
+    
+    if (!g_streaming_pipeline) {
+        InitializeUltraStreaming();
+    }
+    
+    return g_streaming_pipeline->StreamCaptureVirtualDesktop(display_indices, params, callback);
+}
+
+std::future<std::vector<MultiResolutionLevel>> CaptureMultiResolutionUltraLarge(
+    uint32_t display_index,
+    const std::vector<PyramidLevelSpec>& levels,
+    UltraStreamingPipeline::StreamingProgressCallback callback) {
+    
+    if (!g_streaming_pipeline) {
+        InitializeUltraStreaming();
+    }
+    
+    return g_streaming_pipeline->StreamCaptureMultiResolution(display_index, levels, callback);
+}
+
+std::vector<MultiResolutionLevel> EncodeMultiResolution(
+    const ScreenshotResult& screenshot,
+    const std::vector<PyramidLevelSpec>& levels,
+    UltraStreamingPipeline::StreamingProgressCallback callback) {
+    
+    if (!g_streaming_pipeline) {
+        InitializeUltraStreaming();
+    }
+    
+    return g_streaming_pipeline->CreateMultiResolutionPyramid(screenshot, levels, callback);
+}
+
 void ConfigureUltraStreaming(uint32_t chunk_width, uint32_t chunk_height, 
                             uint64_t max_memory_mb, int compression_level) {
     if (!g_streaming_pipeline) {
@@ -588,9 +1578,9 @@ void ConfigureUltraStreaming(uint32_t chunk_width, uint32_t chunk_height,
     g_streaming_pipeline->SetCompressionLevel(compression_level);
 }
 
-UltraStreamingPipeline::StreamingStats GetUltraStreamingStats() {
+StreamingStats GetUltraStreamingStats() {
     if (!g_streaming_pipeline) {
-        UltraStreamingPipeline::StreamingStats empty = {};
+        StreamingStats empty = {};
         return empty;
     }
     
@@ -606,6 +1596,9 @@ std::string GetUltraStreamingInfo() {
     
     std::string info = "Ultra-Streaming Pipeline: ";
     info += std::to_string(stats.active_worker_threads) + " threads, ";
+    if (stats.numa_nodes > 1) {
+        info += "spread over " + std::to_string(stats.numa_nodes) + " NUMA nodes, ";
+    }
     info += std::to_string(stats.total_pixels_processed / 1000000) + "M pixels processed, ";
     info += std::to_string(static_cast<int>(stats.average_throughput_mpixels_per_sec)) + " MPix/s, ";
     info += "Peak memory: " + std::to_string(stats.peak_memory_usage_mb) + "MB";
@@ -0,0 +1,201 @@
+#include "common/screenshot_common.h"
+#include <webp/encode.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include "windows/gpu_yuv_converter.h"
+#endif
+
+namespace WebPScreenshot {
+namespace Warmup {
+
+namespace {
+
+constexpr int kWarmupSize = 16;
+
+struct Step {
+    std::once_flag once;
+    std::atomic<bool> ready{false};
+    std::mutex mutex;   // Guards detail
+    std::string detail; // Backend name or error of the run that happened
+};
+
+Step& EncoderStep() {
+    static Step step;
+    return step;
+}
+
+Step& GPUStep() {
+    static Step step;
+    return step;
+}
+
+Step& CaptureStep() {
+    static Step step;
+    return step;
+}
+
+int DiscardWriter(const uint8_t*, size_t, const WebPPicture*) {
+    return 1;
+}
+
+// libwebp sets up its DSP function tables and lookup tables on the first
+// encode of each kind; a tiny frame through both paths pays for that here
+bool WarmEncoder(std::string& error) {
+    std::vector<uint8_t> pixels(kWarmupSize * kWarmupSize * 4);
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        pixels[i] = static_cast<uint8_t>(i * 7);
+    }
+
+    for (int lossless = 0; lossless <= 1; ++lossless) {
+        WebPConfig config;
+        WebPPicture picture;
+        if (!WebPConfigInit(&config) || !WebPPictureInit(&picture)) {
+            error = "libwebp version mismatch";
+            return false;
+        }
+        config.lossless = lossless;
+        config.method = 0;
+        picture.use_argb = lossless;
+        picture.width = kWarmupSize;
+        picture.height = kWarmupSize;
+        picture.writer = DiscardWriter;
+
+        const bool encoded = WebPPictureImportRGBA(&picture, pixels.data(), kWarmupSize * 4) &&
+                             WebPEncode(&config, &picture);
+        WebPPictureFree(&picture);
+        if (!encoded) {
+            error = lossless ? "Lossless warmup encode failed" : "Lossy warmup encode failed";
+            return false;
+        }
+    }
+
+    // Loads the dispatch table before the first conversion asks for it
+    SIMD::GetActiveISA();
+    return true;
+}
+
+bool WarmGPU(std::string& error) {
+#ifdef _WIN32
+    return Windows::PrecompileYUV420Shader(error);
+#else
+    error.clear();
+    return false;
+#endif
+}
+
+bool WarmCapture(const Options& options, std::string& detail) {
+    std::unique_ptr<ScreenshotCapture> capture = options.capture_factory();
+    if (!capture || !capture->IsSupported()) {
+        detail = "No capture backend available";
+        return false;
+    }
+    capture->GetDisplays();
+    detail = capture->GetImplementationName();
+    return true;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Runs `work` once per process and reports how long this caller waited
+template <typename Work>
+double RunStep(Step& step, Work work) {
+    const auto start = std::chrono::steady_clock::now();
+    std::call_once(step.once, [&] {
+        std::string detail;
+        const bool ready = work(detail);
+        std::lock_guard<std::mutex> lock(step.mutex);
+        step.detail = std::move(detail);
+        step.ready.store(ready, std::memory_order_release);
+    });
+    return ElapsedMs(start);
+}
+
+std::string StepDetail(Step& step) {
+    std::lock_guard<std::mutex> lock(step.mutex);
+    return step.detail;
+}
+
+void AppendError(std::string& errors, const std::string& error) {
+    if (error.empty()) {
+        return;
+    }
+    if (!errors.empty()) {
+        errors += "; ";
+    }
+    errors += error;
+}
+
+} // anonymous namespace
+
+Report Run(const Options& options) {
+    Report report;
+
+    if (options.encoder) {
+        Step& step = EncoderStep();
+        report.encoder_ms = RunStep(step, [](std::string& detail) { return WarmEncoder(detail); });
+        report.encoder_ready = step.ready.load(std::memory_order_acquire);
+        if (!report.encoder_ready) {
+            AppendError(report.error, StepDetail(step));
+        }
+    }
+
+    if (options.gpu) {
+        Step& step = GPUStep();
+        report.gpu_ms = RunStep(step, [](std::string& detail) { return WarmGPU(detail); });
+        report.gpu_ready = step.ready.load(std::memory_order_acquire);
+        if (!report.gpu_ready) {
+            AppendError(report.error, StepDetail(step));
+        }
+    }
+
+    if (options.capture_factory) {
+        Step& step = CaptureStep();
+        report.capture_ms = RunStep(step, [&options](std::string& detail) {
+            try {
+                return WarmCapture(options, detail);
+            } catch (const std::exception& e) {
+                detail = std::string("Capture warmup failed: ") + e.what();
+                return false;
+            }
+        });
+        report.capture_ready = step.ready.load(std::memory_order_acquire);
+        if (report.capture_ready) {
+            report.capture_backend = StepDetail(step);
+        } else {
+            AppendError(report.error, StepDetail(step));
+        }
+    }
+
+    return report;
+}
+
+std::shared_future<Report> RunInBackground(Options options) {
+    // Holding the futures keeps dropping one from blocking on the thread,
+    // and joins whatever is still running when the process exits
+    static std::mutex mutex;
+    static std::vector<std::shared_future<Report>> running;
+
+    std::shared_future<Report> future =
+        std::async(std::launch::async, [options = std::move(options)] { return Run(options); }).share();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    running.erase(std::remove_if(running.begin(), running.end(),
+                                 [](const std::shared_future<Report>& pending) {
+                                     return pending.wait_for(std::chrono::seconds(0)) ==
+                                            std::future_status::ready;
+                                 }),
+                  running.end());
+    running.push_back(future);
+    return future;
+}
+
+} // namespace Warmup
+} // namespace WebPScreenshot
@@ -1,151 +1,1686 @@
 #include "common/screenshot_common.h"
+#include "common/webp_container.h"
+#include <webp/encode.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
-#include <iostream>
 
 namespace WebPScreenshot {
 
+// Tile bookkeeping for multi-threaded encoding
+struct WebPEncoder::TileInfo {
+    uint32_t x;                          // Position on the output canvas
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    const uint8_t* pixels = nullptr;     // Top-left source pixel
+    uint32_t stride = 0;
+    PixelLayout layout = PixelLayout::RGBA;
+    WebPEncodeParams params;  // Resolved per tile when content_adaptive is set
+    std::vector<uint8_t> encoded_data;
+    TileCache::Bitstream cached;  // Set instead of encoded_data when shared with TileCache
+
+    const std::vector<uint8_t>& Encoded() const { return cached ? *cached : encoded_data; }
+};
+
+// Checked from libwebp's progress hook while an encode is under a deadline
+struct WebPEncoder::BudgetWatch {
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point abort_at;
+    int percent = 0;        // Progress reported when the encode was aborted
+    bool aborted = false;
+};
+
+// Where one encode call's bytes go. In memory the file is a single vector,
+// or the caller's span; streamed it is cut into chunk_size pieces for the
+// callback, copying only what does not fill a whole chunk.
+struct WebPEncoder::EncodeOutput {
+    std::vector<uint8_t> buffer;
+
+    // Caller memory (EncodeInto). Bytes past capacity are counted but not
+    // written, so a file that does not fit still reports its size; a null,
+    // zero-capacity span only measures.
+    uint8_t* span = nullptr;
+    size_t span_capacity = 0;
+    bool in_span = false;
+
+    size_t bytes = 0;          // File size so far
+    size_t limit = 0;          // Streamed: stop before sending more than this (0 = none)
+    bool over_limit = false;
+
+    StreamingCallback* callback = nullptr;
+    size_t chunk_size = 0;
+    PoolBuffer chunk;          // From the memory pool, reused for every chunk
+    size_t chunk_fill = 0;
+    bool stopped = false;      // The callback asked to stop
+
+    bool Streaming() const { return callback != nullptr; }
+    bool InSpan() const { return in_span; }
+    bool Overflowed() const { return InSpan() && bytes > span_capacity; }
+
+    void SetSpan(EncodeSpan target) {
+        span = target.data;
+        span_capacity = target.capacity;
+        in_span = true;
+    }
+
+    // Start the file over for another attempt. Never for a stream, which
+    // cannot take back what it sent.
+    void Rewind() {
+        buffer.clear();
+        bytes = 0;
+    }
+
+    bool Emit(const uint8_t* data, size_t size) {
+        if (!callback->OnDataChunk(data, size)) {
+            stopped = true;
+        }
+        return !stopped;
+    }
+
+    bool Append(const uint8_t* data, size_t size) {
+        if (InSpan()) {
+            // Once one piece misses, every later one does too
+            if (span && bytes + size <= span_capacity) {
+                std::memcpy(span + bytes, data, size);
+            }
+            bytes += size;
+            return true;
+        }
+        if (!Streaming()) {
+            buffer.insert(buffer.end(), data, data + size);
+            bytes += size;
+            return true;
+        }
+        if (stopped) {
+            return false;
+        }
+        if (limit != 0 && bytes + size > limit) {
+            over_limit = true;
+            stopped = true;
+            return false;
+        }
+        bytes += size;
+
+        while (size > 0) {
+            // Whole chunks go to the callback straight from libwebp's memory
+            if (chunk_fill == 0 && size >= chunk_size) {
+                if (!Emit(data, chunk_size)) return false;
+                data += chunk_size;
+                size -= chunk_size;
+                continue;
+            }
+
+            if (!chunk) {
+                chunk = Utils::AllocateScreenshotBuffer(chunk_size);
+            }
+            const size_t count = std::min(size, chunk_size - chunk_fill);
+            std::memcpy(chunk.get() + chunk_fill, data, count);
+            Stats::AddBytesCopied(count);
+            chunk_fill += count;
+            data += count;
+            size -= count;
+
+            if (chunk_fill == chunk_size) {
+                chunk_fill = 0;
+                if (!Emit(chunk.get(), chunk_size)) return false;
+            }
+        }
+        return true;
+    }
+
+    // A complete file from a nested encode, e.g. the only tile
+    bool Assign(std::vector<uint8_t>&& encoded) {
+        if (!Streaming() && !InSpan()) {
+            buffer = std::move(encoded);
+            bytes = buffer.size();
+            return true;
+        }
+        return Append(encoded.data(), encoded.size());
+    }
+
+    // Send the short last chunk
+    bool Finish() {
+        if (!Streaming() || stopped || chunk_fill == 0) {
+            return !stopped;
+        }
+        const size_t size = chunk_fill;
+        chunk_fill = 0;
+        return Emit(chunk.get(), size);
+    }
+};
+
+namespace {
+
+constexpr uint32_t BytesPerPixel(WebPEncoder::PixelLayout layout) {
+    return layout == WebPEncoder::PixelLayout::RGB ? 3 : 4;
+}
+
+// Layouts whose fourth byte is real alpha (BGRX captures leave it undefined)
+constexpr bool HasAlpha(WebPEncoder::PixelLayout layout) {
+    return layout == WebPEncoder::PixelLayout::RGBA || layout == WebPEncoder::PixelLayout::BGRA;
+}
+
+constexpr bool IsBGROrder(WebPEncoder::PixelLayout layout) {
+    return layout == WebPEncoder::PixelLayout::BGRA || layout == WebPEncoder::PixelLayout::BGRX;
+}
+
+inline bool IsLittleEndian() {
+    const uint16_t probe = 1;
+    return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+// Pack interleaved rows into libwebp's native ARGB layout
+void ImportToARGB(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+                  WebPEncoder::PixelLayout layout, uint32_t* argb, int argb_stride) {
+    const uint32_t step = BytesPerPixel(layout);
+    const bool has_alpha = HasAlpha(layout);
+    const uint32_t ri = IsBGROrder(layout) ? 2 : 0;
+    const uint32_t bi = IsBGROrder(layout) ? 0 : 2;
+
+    for (uint32_t row = 0; row < height; ++row) {
+        const uint8_t* src = data + static_cast<size_t>(row) * stride;
+        uint32_t* dst = argb + static_cast<size_t>(row) * argb_stride;
+
+        for (uint32_t col = 0; col < width; ++col) {
+            const uint8_t* p = src + col * step;
+            const uint32_t a = has_alpha ? p[3] : 0xFFu;
+            dst[col] = (a << 24) | (static_cast<uint32_t>(p[ri]) << 16) |
+                       (static_cast<uint32_t>(p[1]) << 8) | p[bi];
+        }
+    }
+}
+
+// Per-thread encoder state. The picture planes and the output writer are kept
+// between calls so a capture loop encoding same-sized frames does not
+// reallocate YUV planes or the output buffer on every frame.
+struct EncoderContext {
+    WebPPicture picture;
+    WebPMemoryWriter writer;
+    std::vector<uint8_t> yuva_planes;  // Y, U, V and A planes in one block
+    std::vector<uint32_t> argb;        // ARGB samples for lossless / sharp YUV
+
+    EncoderContext() {
+        WebPPictureInit(&picture);
+        WebPMemoryWriterInit(&writer);
+    }
+
+    ~EncoderContext() {
+        WebPPictureFree(&picture);
+        WebPMemoryWriterClear(&writer);
+    }
+
+    EncoderContext(const EncoderContext&) = delete;
+    EncoderContext& operator=(const EncoderContext&) = delete;
+};
+
+EncoderContext& GetThreadEncoderContext() {
+    static thread_local EncoderContext context;
+    return context;
+}
+
+// Threads for tiled encodes. They outlive the call, so each keeps its
+// EncoderContext from one frame to the next instead of rebuilding the
+// picture and writer at every tile's size. A helper that has not started
+// by the time the caller is done is skipped, so a call never waits on a
+// queue it may be holding up itself.
+class TileWorkerPool {
+public:
+    ~TileWorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shutdown_ = true;
+        }
+        queue_ready_.notify_all();
+        for (auto& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    // Runs `job` on the calling thread and on up to `helpers` pool threads,
+    // returning once every run that started has finished
+    void Run(size_t helpers, const std::function<void()>& job) {
+        auto run = std::make_shared<RunState>();
+        run->job = &job;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (threads_.size() < helpers) {
+                threads_.emplace_back(&TileWorkerPool::WorkerMain, this);
+            }
+            for (size_t i = 0; i < helpers; ++i) {
+                queue_.push_back(run);
+            }
+        }
+        queue_ready_.notify_all();
+
+        job();
+
+        std::unique_lock<std::mutex> lock(run->mutex);
+        run->closed = true;
+        run->done.wait(lock, [&] { return run->active == 0; });
+    }
+
+private:
+    struct RunState {
+        const std::function<void()>* job = nullptr;
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t active = 0;
+        bool closed = false;  // Set once the caller's own run has returned
+    };
+
+    void WorkerMain() {
+        for (;;) {
+            std::shared_ptr<RunState> run;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                queue_ready_.wait(lock, [this] { return shutdown_ || !queue_.empty(); });
+                if (shutdown_) {
+                    return;
+                }
+                run = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            {
+                std::lock_guard<std::mutex> lock(run->mutex);
+                if (run->closed) {
+                    continue;
+                }
+                ++run->active;
+            }
+            (*run->job)();
+            {
+                std::lock_guard<std::mutex> lock(run->mutex);
+                --run->active;
+            }
+            run->done.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable queue_ready_;
+    std::deque<std::shared_ptr<RunState>> queue_;
+    std::vector<std::thread> threads_;
+    bool shutdown_ = false;
+};
+
+TileWorkerPool& GetTileWorkerPool() {
+    static TileWorkerPool pool;
+    return pool;
+}
+
+inline double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Templated on the watch so the encoder can hand in its private type
+template <typename Watch>
+int AbortPastDeadline(int percent, const WebPPicture* picture) {
+    auto* watch = static_cast<Watch*>(picture->user_data);
+    if (std::chrono::steady_clock::now() < watch->abort_at) {
+        return 1;
+    }
+    watch->percent = percent;
+    watch->aborted = true;
+    return 0;
+}
+
+// Only a running watch installs the hook; the thread's picture is reused
+template <typename Watch>
+void SetProgressWatch(WebPPicture& picture, Watch* watch) {
+    picture.progress_hook = watch ? AbortPastDeadline<Watch> : nullptr;
+    picture.user_data = watch;
+}
+
+// libwebp writer for streamed output. Once writing starts a deadline may no
+// longer abort the encode: the retry could not take back what was sent.
+template <typename Output, typename Watch>
+int WriteToStream(const uint8_t* data, size_t data_size, const WebPPicture* picture) {
+    if (auto* watch = static_cast<Watch*>(picture->user_data)) {
+        watch->abort_at = std::chrono::steady_clock::time_point::max();
+    }
+    return static_cast<Output*>(picture->custom_ptr)->Append(data, data_size) ? 1 : 0;
+}
+
+// libwebp writer for caller memory. Unlike a stream the output can be
+// rewound, so a deadline may still abort and retry.
+template <typename Output>
+int WriteToSpan(const uint8_t* data, size_t data_size, const WebPPicture* picture) {
+    return static_cast<Output*>(picture->custom_ptr)->Append(data, data_size) ? 1 : 0;
+}
+
+// libwebp's target_size applies to one bitstream, so each tile of a tiled
+// file aims at its share of the target by area. Templated like the watch
+// hooks so the encoder can hand in its private tile type.
+template <typename Tile>
+void SplitTargetSize(std::vector<Tile>& tiles, uint64_t total_pixels) {
+    if (total_pixels == 0) {
+        return;
+    }
+    for (Tile& tile : tiles) {
+        if (tile.params.target_size > 0) {
+            const double share = static_cast<double>(tile.width) * tile.height / total_pixels;
+            tile.params.target_size = std::max(1, static_cast<int>(tile.params.target_size * share));
+        }
+    }
+}
+
+// Hand the encoded bytes to the caller; the writer's buffer stays cached
+std::vector<uint8_t> CopyEncodedOutput(const WebPMemoryWriter& writer) {
+    Stats::AddAllocation(writer.size);
+    Stats::AddBytesCopied(writer.size);
+    return std::vector<uint8_t>(writer.mem, writer.mem + writer.size);
+}
+
+// Map every WebPEncodeParams field onto a libwebp configuration
+bool BuildWebPConfig(const WebPEncodeParams& params, WebPConfig* config) {
+    if (!WebPConfigInit(config)) {
+        return false;
+    }
+
+    config->lossless = params.lossless;
+    config->quality = params.quality;
+    config->method = params.method;
+    config->target_size = params.target_size;
+    config->target_PSNR = params.target_psnr;
+    config->segments = params.segments;
+    config->sns_strength = params.sns_strength;
+    config->filter_strength = params.filter_strength;
+    config->filter_sharpness = params.filter_sharpness;
+    config->filter_type = params.filter_type;
+    config->autofilter = params.autofilter;
+    config->alpha_compression = params.alpha_compression;
+    config->alpha_filtering = params.alpha_filtering;
+    config->alpha_quality = params.alpha_quality;
+    config->pass = params.pass;
+    config->show_compressed = params.show_compressed;
+    config->preprocessing = params.preprocessing;
+    config->partitions = params.partitions;
+    config->partition_limit = params.partition_limit;
+    config->emulate_jpeg_size = params.emulate_jpeg_size;
+    config->thread_level = params.thread_level;
+    config->low_memory = params.low_memory;
+    config->near_lossless = params.near_lossless;
+    config->exact = params.exact;
+    config->use_delta_palette = params.use_delta_palette;
+    config->use_sharp_yuv = params.use_sharp_yuv;
+
+    return WebPValidateConfig(config) != 0;
+}
+
+// Tiled encoding limits. Every tile is a standalone VP8/VP8L frame, so it must
+// fit WEBP_MAX_DIMENSION; the VP8X canvas allows 24-bit dimensions and ANMF
+// offsets are stored divided by two, so tile edges stay on 16 px boundaries.
+constexpr uint32_t kMaxCanvasDimension = 1u << 24;
+constexpr uint32_t kTileAlignment = 16;
+constexpr uint32_t kMaxTileDimension = WEBP_MAX_DIMENSION & ~(kTileAlignment - 1);
+// Below ~1 MP per tile the per-frame overhead outweighs the parallel speedup
+constexpr uint64_t kMinTilePixels = 1024 * 1024;
+constexpr uint32_t kTilesPerThread = 2;
+constexpr uint32_t kMaxEncodeThreads = 16;
+// Grid a content-adaptive frame is classified on. Smaller tiles follow window
+// edges more closely but cost VP8L its cross-tile context.
+constexpr uint32_t kContentTileSize = 512;
+// Grid of params.tile_cache encodes. A caret or cursor moving invalidates one
+// 256 px tile; smaller tiles would spend more on per-frame overhead than they save.
+constexpr uint32_t kCacheTileSize = 256;
+// How far a batch worker may run ahead of the frame waiting to be delivered,
+// which bounds the finished files held for in-order delivery
+constexpr size_t kBatchFramesAheadPerWorker = 4;
+
+// Progress below which an aborted encode is too young to extrapolate from
+constexpr int kMinExtrapolatedPercent = 10;
+
+// max_output_size: passes libwebp's size search gets to converge (one pass
+// only estimates), encodes before giving up, and how far below the cap each
+// retry aims past the proportional target
+constexpr int kSizeSearchPasses = 6;
+constexpr int kMaxSizeAttempts = 4;
+constexpr double kSizeRetryMargin = 0.95;
+
+inline uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+inline uint32_t DivideRoundUp(uint32_t value, uint32_t divisor) {
+    return (value + divisor - 1) / divisor;
+}
+
+uint32_t ResolveThreadCount(const WebPEncodeParams& params) {
+    uint32_t threads = params.max_threads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::min(threads, kMaxEncodeThreads);
+}
+
+// Split the canvas into a grid of tiles. Full-width bands are preferred since
+// they keep each tile's rows contiguous in the source; columns are only added
+// when the canvas is wider than a single WebP frame allows.
+void PlanTileGrid(uint32_t width, uint32_t height, uint32_t threads,
+                  uint32_t* tile_width, uint32_t* tile_height) {
+    const uint64_t pixels = static_cast<uint64_t>(width) * height;
+    const uint32_t columns = DivideRoundUp(width, kMaxTileDimension);
+
+    uint64_t wanted = std::max<uint64_t>(1, pixels / kMinTilePixels);
+    wanted = std::min<uint64_t>(wanted, static_cast<uint64_t>(threads) * kTilesPerThread);
+
+    uint32_t rows = static_cast<uint32_t>(DivideRoundUp(static_cast<uint32_t>(wanted), columns));
+    rows = std::max(rows, DivideRoundUp(height, kMaxTileDimension));
+    rows = std::min(rows, DivideRoundUp(height, kTileAlignment));
+
+    *tile_width = std::min(AlignUp(DivideRoundUp(width, columns), kTileAlignment), kMaxTileDimension);
+    *tile_height = std::min(AlignUp(DivideRoundUp(height, rows), kTileAlignment), kMaxTileDimension);
+}
+
+bool ShouldEncodeTiled(uint32_t width, uint32_t height, const WebPEncodeParams& params) {
+    // A single WebP bitstream cannot hold the canvas at all
+    if (width > WEBP_MAX_DIMENSION || height > WEBP_MAX_DIMENSION) {
+        return true;
+    }
+
+    if (!params.enable_multithreading || ResolveThreadCount(params) < 2) {
+        return false;
+    }
+
+    return static_cast<uint64_t>(width) * height >= 2 * kMinTilePixels;
+}
+
+} // anonymous namespace
+
 WebPEncoder::WebPEncoder() {}
 
 WebPEncoder::~WebPEncoder() {}
 
-std::vector<uint8_t> WebPEncoder::EncodeRGBA(const uint8_t* rgba_data, uint32_t width, 
+void WebPEncoder::StartBudget(const WebPEncodeParams& params) {
+    has_deadline_ = params.max_encode_ms > 0.0f;
+    slice_ms_ = 0.0;
+    if (has_deadline_) {
+        deadline_ = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(params.max_encode_ms));
+    }
+}
+
+double WebPEncoder::RemainingBudgetMs() const {
+    const double remaining = std::chrono::duration<double, std::milli>(
+        deadline_ - std::chrono::steady_clock::now()).count();
+    return slice_ms_ > 0.0 ? std::min(remaining, slice_ms_) : remaining;
+}
+
+template <typename EncodeFn>
+bool WebPEncoder::EncodeWithinBudget(const WebPEncodeParams& params, uint64_t pixels,
+                                     ContentAnalysis::ContentClass content_class,
+                                     EncodeFn&& encode) {
+    const EncodeCost::BudgetPlan plan =
+        EncodeCost::PlanForBudget(params, pixels, content_class, RemainingBudgetMs());
+
+    BudgetWatch watch;
+    watch.start = std::chrono::steady_clock::now();
+    watch.abort_at = watch.start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double, std::milli>(plan.abort_after_ms));
+
+    const bool encoded = encode(plan.params, plan.abort_after_ms > 0.0 ? &watch : nullptr);
+    if (!watch.aborted) {
+        if (encoded) {
+            EncodeCost::Record(plan.params, pixels, content_class, MillisecondsSince(watch.start));
+        }
+        return encoded;
+    }
+
+    // Libwebp's progress is close to linear in time, which is enough to tell
+    // the model how far off it was once the encode got past its analysis
+    if (watch.percent >= kMinExtrapolatedPercent) {
+        EncodeCost::Record(plan.params, pixels, content_class,
+                           MillisecondsSince(watch.start) * 100.0 / watch.percent);
+    }
+
+    // The fallback was budgeted for when the plan was made
+    const auto retry_start = std::chrono::steady_clock::now();
+    const bool retried = encode(plan.fallback, nullptr);
+    if (retried) {
+        last_error_.clear();
+        EncodeCost::Record(plan.fallback, pixels, content_class, MillisecondsSince(retry_start));
+    }
+    return retried;
+}
+
+template <typename EncodeFn>
+bool WebPEncoder::EncodeBounded(const WebPEncodeParams& params, EncodeOutput& output, EncodeFn&& encode) {
+    if (params.max_output_size <= 0) {
+        return encode(params, output);
+    }
+
+    const size_t cap = static_cast<size_t>(params.max_output_size);
+    if (output.Streaming()) {
+        output.limit = cap;
+    }
+
+    WebPEncodeParams attempt = params;
+    attempt.pass = std::max(params.pass, kSizeSearchPasses);
+    int target = params.max_output_size;
+    size_t missed = 0;
+    for (int i = 0; i < kMaxSizeAttempts; ++i) {
+        attempt.target_size = params.target_size > 0 ? std::min(params.target_size, target) : target;
+        if (!encode(attempt, output)) {
+            if (output.over_limit) {
+                last_error_ = "Encoded image exceeds max_output_size (" + std::to_string(cap) + " bytes)";
+            }
+            return false;
+        }
+        if (output.bytes <= cap) {
+            return true;
+        }
+
+        // Lossless ignores the target; streams never get here (see limit)
+        missed = output.bytes;
+        if (params.lossless) {
+            break;
+        }
+        target = std::max(1, static_cast<int>(target * kSizeRetryMargin * cap / output.bytes));
+        output.Rewind();
+    }
+
+    output.Rewind();
+    last_error_ = "Encoded image exceeds max_output_size (" + std::to_string(missed) +
+                  " > " + std::to_string(cap) + " bytes)";
+    return false;
+}
+
+std::vector<uint8_t> WebPEncoder::EncodeRGBA(const uint8_t* rgba_data, uint32_t width,
                                              uint32_t height, uint32_t stride,
                                              const WebPEncodeParams& params) {
-    return EncodeInternal(rgba_data, width, height, stride, true, params);
+    return EncodeInternal(rgba_data, width, height, stride, PixelLayout::RGBA, params);
 }
 
-std::vector<uint8_t> WebPEncoder::EncodeRGB(const uint8_t* rgb_data, uint32_t width, 
+std::vector<uint8_t> WebPEncoder::EncodeRGB(const uint8_t* rgb_data, uint32_t width,
                                             uint32_t height, uint32_t stride,
                                             const WebPEncodeParams& params) {
-    return EncodeInternal(rgb_data, width, height, stride, false, params);
+    return EncodeInternal(rgb_data, width, height, stride, PixelLayout::RGB, params);
+}
+
+std::vector<uint8_t> WebPEncoder::EncodeBGRA(const uint8_t* bgra_data, uint32_t width,
+                                             uint32_t height, uint32_t stride,
+                                             const WebPEncodeParams& params, bool alpha_valid) {
+    return EncodeInternal(bgra_data, width, height, stride,
+                          alpha_valid ? PixelLayout::BGRA : PixelLayout::BGRX, params);
+}
+
+std::vector<uint8_t> WebPEncoder::EncodeYUV420(const uint8_t* y_plane, int y_stride,
+                                               const uint8_t* u_plane, const uint8_t* v_plane,
+                                               int uv_stride, uint32_t width, uint32_t height,
+                                               const WebPEncodeParams& params) {
+    last_error_.clear();
+    EncodeOutput output;
+    if (!EncodeYUV420To(y_plane, y_stride, u_plane, v_plane, uv_stride, width, height, params, output)) {
+        return {};
+    }
+    return std::move(output.buffer);
+}
+
+EncodeIntoResult WebPEncoder::EncodeYUV420Into(const uint8_t* y_plane, int y_stride,
+                                               const uint8_t* u_plane, const uint8_t* v_plane,
+                                               int uv_stride, uint32_t width, uint32_t height,
+                                               const WebPEncodeParams& params, EncodeSpan span) {
+    last_error_.clear();
+    EncodeIntoResult result;
+    if (!span.data && span.capacity > 0) {
+        last_error_ = "Output span is null";
+        return result;
+    }
+
+    EncodeOutput output;
+    output.SetSpan(span);
+    if (!EncodeYUV420To(y_plane, y_stride, u_plane, v_plane, uv_stride, width, height, params, output)) {
+        return result;
+    }
+
+    result.required_size = output.bytes;
+    if (output.Overflowed()) {
+        last_error_ = "Output span too small: " + std::to_string(output.bytes) + " bytes needed";
+        return result;
+    }
+    result.success = true;
+    result.bytes_written = output.bytes;
+    return result;
+}
+
+bool WebPEncoder::EncodeYUV420To(const uint8_t* y_plane, int y_stride,
+                                 const uint8_t* u_plane, const uint8_t* v_plane,
+                                 int uv_stride, uint32_t width, uint32_t height,
+                                 const WebPEncodeParams& params, EncodeOutput& output) {
+    if (!y_plane || !u_plane || !v_plane) {
+        last_error_ = "Input data is null";
+        return false;
+    }
+
+    // Planes are a single VP8 frame; there is no RGB to re-tile from
+    if (width == 0 || height == 0 || width > WEBP_MAX_DIMENSION || height > WEBP_MAX_DIMENSION) {
+        last_error_ = "Invalid dimensions";
+        return false;
+    }
+
+    const int uv_width = static_cast<int>((width + 1) / 2);
+    const int uv_height = static_cast<int>((height + 1) / 2);
+    if (y_stride < static_cast<int>(width) || uv_stride < uv_width) {
+        last_error_ = "Stride is smaller than row size";
+        return false;
+    }
+
+    if (!Utils::ValidateWebPParams(params, last_error_)) {
+        return false;
+    }
+
+    WebPConfig config;
+    if (!BuildWebPConfig(params, &config)) {
+        last_error_ = "Invalid WebP configuration";
+        return false;
+    }
+
+    if (config.lossless || config.use_sharp_yuv) {
+        last_error_ = "YUV420 input requires lossy encoding without sharp YUV";
+        return false;
+    }
+
+    Stats::ScopedStageTimer timer(Stats::Stage::Encode);
+    StartBudget(params);
+
+    auto encode = [&](const WebPEncodeParams& attempt, EncodeOutput& out, BudgetWatch* watch) {
+        WebPConfig attempt_config;
+        if (!BuildWebPConfig(attempt, &attempt_config)) {
+            last_error_ = "Invalid WebP configuration";
+            return false;
+        }
+
+        EncoderContext& context = GetThreadEncoderContext();
+        WebPPicture& picture = context.picture;
+
+        picture.width = static_cast<int>(width);
+        picture.height = static_cast<int>(height);
+        picture.use_argb = 0;
+        picture.colorspace = WEBP_YUV420;
+        picture.a = nullptr;
+        picture.a_stride = 0;
+
+        // Segment smoothing rewrites the planes in place, so it gets a private copy
+        if (attempt_config.preprocessing & 1) {
+            const size_t y_size = static_cast<size_t>(width) * height;
+            const size_t uv_size = static_cast<size_t>(uv_width) * uv_height;
+            if (context.yuva_planes.size() < y_size + 2 * uv_size) {
+                context.yuva_planes.resize(y_size + 2 * uv_size);
+                Stats::AddAllocation(y_size + 2 * uv_size);
+            }
+            Stats::AddBytesCopied(y_size + 2 * uv_size);
+
+            uint8_t* y_copy = context.yuva_planes.data();
+            uint8_t* u_copy = y_copy + y_size;
+            uint8_t* v_copy = u_copy + uv_size;
+            for (uint32_t row = 0; row < height; ++row) {
+                std::memcpy(y_copy + static_cast<size_t>(row) * width,
+                            y_plane + static_cast<size_t>(row) * y_stride, width);
+            }
+            for (int row = 0; row < uv_height; ++row) {
+                std::memcpy(u_copy + static_cast<size_t>(row) * uv_width,
+                            u_plane + static_cast<size_t>(row) * uv_stride, uv_width);
+                std::memcpy(v_copy + static_cast<size_t>(row) * uv_width,
+                            v_plane + static_cast<size_t>(row) * uv_stride, uv_width);
+            }
+
+            picture.y = y_copy;
+            picture.u = u_copy;
+            picture.v = v_copy;
+            picture.y_stride = static_cast<int>(width);
+            picture.uv_stride = uv_width;
+        } else {
+            picture.y = const_cast<uint8_t*>(y_plane);
+            picture.u = const_cast<uint8_t*>(u_plane);
+            picture.v = const_cast<uint8_t*>(v_plane);
+            picture.y_stride = y_stride;
+            picture.uv_stride = uv_stride;
+        }
+
+        if (out.InSpan()) {
+            out.Rewind();
+            picture.writer = WriteToSpan<EncodeOutput>;
+            picture.custom_ptr = &out;
+        } else {
+            context.writer.size = 0;
+            picture.writer = WebPMemoryWrite;
+            picture.custom_ptr = &context.writer;
+        }
+        SetProgressWatch(picture, watch);
+
+        const int ok = WebPEncode(&attempt_config, &picture);
+        const WebPEncodingError error_code = picture.error_code;
+
+        // Only releases libwebp-owned scratch; the borrowed planes are untouched
+        WebPPictureFree(&picture);
+
+        if (!ok) {
+            last_error_ = Utils::ErrorCodeToString(static_cast<int>(error_code));
+            return false;
+        }
+
+        return out.InSpan() || out.Assign(CopyEncodedOutput(context.writer));
+    };
+
+    const bool ok = EncodeBounded(params, output, [&](const WebPEncodeParams& bounded, EncodeOutput& out) {
+        // Planes carry no content statistics; lossy cost barely depends on them
+        return has_deadline_
+            ? EncodeWithinBudget(bounded, static_cast<uint64_t>(width) * height,
+                                 ContentAnalysis::ContentClass::Photo,
+                                 [&](const WebPEncodeParams& attempt, BudgetWatch* watch) {
+                                     return encode(attempt, out, watch);
+                                 })
+            : encode(bounded, out, nullptr);
+    });
+    if (!ok) {
+        timer.Cancel();
+    }
+    return ok;
 }
 
-std::vector<uint8_t> WebPEncoder::EncodeInternal(const uint8_t* data, uint32_t width, 
+std::vector<uint8_t> WebPEncoder::EncodeInternal(const uint8_t* data, uint32_t width,
                                                  uint32_t height, uint32_t stride,
-                                                 bool has_alpha, const WebPEncodeParams& params) {
+                                                 PixelLayout layout, const WebPEncodeParams& params) {
+    last_error_.clear();
+    if (!ValidateInput(data, width, height, stride, layout, params)) {
+        return {};
+    }
+
+    Stats::ScopedStageTimer timer(Stats::Stage::Encode);
+    StartBudget(params);
+    EncodeOutput output;
+    if (!EncodeBounded(params, output, [&](const WebPEncodeParams& attempt, EncodeOutput& out) {
+            return EncodeTo(data, width, height, stride, layout, attempt, out);
+        })) {
+        timer.Cancel();
+        return {};
+    }
+    return std::move(output.buffer);
+}
+
+EncodeIntoResult WebPEncoder::EncodeInto(const uint8_t* data, uint32_t width, uint32_t height,
+                                         uint32_t stride, PixelLayout layout,
+                                         const WebPEncodeParams& params, EncodeSpan span) {
+    last_error_.clear();
+    EncodeIntoResult result;
+    if (!span.data && span.capacity > 0) {
+        last_error_ = "Output span is null";
+        return result;
+    }
+    if (!ValidateInput(data, width, height, stride, layout, params)) {
+        return result;
+    }
+
+    Stats::ScopedStageTimer timer(Stats::Stage::Encode);
+    StartBudget(params);
+    EncodeOutput output;
+    output.SetSpan(span);
+    if (!EncodeBounded(params, output, [&](const WebPEncodeParams& attempt, EncodeOutput& out) {
+            return EncodeTo(data, width, height, stride, layout, attempt, out);
+        })) {
+        timer.Cancel();
+        return result;
+    }
+
+    result.required_size = output.bytes;
+    if (output.Overflowed()) {
+        timer.Cancel();
+        last_error_ = "Output span too small: " + std::to_string(output.bytes) + " bytes needed";
+        return result;
+    }
+    result.success = true;
+    result.bytes_written = output.bytes;
+    return result;
+}
+
+bool WebPEncoder::EncodeStreamingWithCallback(const uint8_t* data, uint32_t width,
+                                              uint32_t height, uint32_t stride,
+                                              PixelLayout layout, const WebPEncodeParams& params,
+                                              StreamingCallback* callback) {
     last_error_.clear();
-    
+    if (!callback) {
+        last_error_ = "Streaming callback is null";
+        return false;
+    }
+
+    bool ok = ValidateInput(data, width, height, stride, layout, params);
+    if (ok && params.stream_buffer_size == 0) {
+        last_error_ = "stream_buffer_size must be positive";
+        ok = false;
+    }
+
+    if (ok) {
+        Stats::ScopedStageTimer timer(Stats::Stage::Encode);
+        StartBudget(params);
+        EncodeOutput output;
+        output.callback = callback;
+        output.chunk_size = params.stream_buffer_size;
+        ok = EncodeBounded(params, output, [&](const WebPEncodeParams& attempt, EncodeOutput& out) {
+                 return EncodeTo(data, width, height, stride, layout, attempt, out);
+             }) && output.Finish();
+        if (!ok) {
+            timer.Cancel();
+            if (output.stopped && !output.over_limit) {
+                last_error_ = "Encode stopped by the streaming callback";
+            }
+        }
+    }
+
+    callback->OnComplete(ok, last_error_);
+    return ok;
+}
+
+bool WebPEncoder::ValidateInput(const uint8_t* data, uint32_t width, uint32_t height, uint32_t& stride,
+                                PixelLayout layout, const WebPEncodeParams& params) {
     if (!data) {
         last_error_ = "Input data is null";
-        return {};
+        return false;
     }
-    
-    if (width == 0 || height == 0) {
+
+    if (width == 0 || height == 0 || width > kMaxCanvasDimension || height > kMaxCanvasDimension) {
         last_error_ = "Invalid dimensions";
+        return false;
+    }
+
+    const uint32_t min_stride = width * BytesPerPixel(layout);
+    if (stride == 0) {
+        stride = min_stride;
+    } else if (stride < min_stride) {
+        last_error_ = "Stride is smaller than row size";
+        return false;
+    }
+
+    return Utils::ValidateWebPParams(params, last_error_);
+}
+
+bool WebPEncoder::EncodeTo(const uint8_t* data, uint32_t width, uint32_t height, uint32_t stride,
+                           PixelLayout layout, const WebPEncodeParams& params, EncodeOutput& output) {
+    if (params.tile_cache) {
+        return EncodeWithTileCache(data, width, height, stride, layout, params, output);
+    }
+    if (ShouldEncodeTiled(width, height, params)) {
+        return EncodeMultiThreaded(data, width, height, stride, layout, params, output);
+    }
+    if (params.content_adaptive) {
+        return EncodeContentAdaptive(data, width, height, stride, layout, params, output);
+    }
+    return EncodeSingleThreaded(data, width, height, stride, layout, params, output);
+}
+
+bool WebPEncoder::EncodeSingleThreaded(const uint8_t* data, uint32_t width,
+                                       uint32_t height, uint32_t stride,
+                                       PixelLayout layout, const WebPEncodeParams& params,
+                                       EncodeOutput& output) {
+    if (!has_deadline_) {
+        return EncodePicture(data, width, height, stride, layout, params, nullptr, output);
+    }
+
+    // The cost model is keyed on content; sampling costs well under 1% of an encode
+    const ContentAnalysis::ContentStats stats =
+        ContentAnalysis::AnalyzeRegion(data, width, height, stride, BytesPerPixel(layout));
+    return EncodeWithinBudget(params, static_cast<uint64_t>(width) * height, stats.content_class,
+        [&](const WebPEncodeParams& attempt, BudgetWatch* watch) {
+            return EncodePicture(data, width, height, stride, layout, attempt, watch, output);
+        });
+}
+
+bool WebPEncoder::EncodePicture(const uint8_t* data, uint32_t width,
+                                uint32_t height, uint32_t stride,
+                                PixelLayout layout, const WebPEncodeParams& params,
+                                BudgetWatch* watch, EncodeOutput& output) {
+    WebPConfig config;
+    if (!BuildWebPConfig(params, &config)) {
+        last_error_ = "Invalid WebP configuration";
+        return false;
+    }
+
+    EncoderContext& context = GetThreadEncoderContext();
+    WebPPicture& picture = context.picture;
+    const bool has_alpha = HasAlpha(layout);
+
+    picture.width = static_cast<int>(width);
+    picture.height = static_cast<int>(height);
+
+    // Lossless and sharp-YUV need ARGB input; plain lossy goes straight to YUV
+    if (config.lossless || config.use_sharp_yuv) {
+        // A little-endian BGRA row already is ARGB. Lossless without `exact`
+        // rewrites transparent pixels in place, so only borrow the caller's
+        // buffer when libwebp will not write to it.
+        const bool borrow_input = layout == PixelLayout::BGRA && IsLittleEndian() &&
+                                  stride % 4 == 0 &&
+                                  reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) == 0 &&
+                                  (!config.lossless || config.exact);
+
+        picture.use_argb = 1;
+        if (borrow_input) {
+            picture.argb = const_cast<uint32_t*>(reinterpret_cast<const uint32_t*>(data));
+            picture.argb_stride = static_cast<int>(stride / 4);
+        } else {
+            const size_t argb_size = static_cast<size_t>(width) * height;
+            if (context.argb.size() < argb_size) {
+                context.argb.resize(argb_size);
+                Stats::AddAllocation(argb_size * sizeof(uint32_t));
+            }
+
+            Stats::ScopedStageTimer convert_timer(Stats::Stage::Convert);
+            ImportToARGB(data, width, height, stride, layout,
+                         context.argb.data(), static_cast<int>(width));
+            Stats::AddBytesCopied(argb_size * sizeof(uint32_t));
+
+            picture.argb = context.argb.data();
+            picture.argb_stride = static_cast<int>(width);
+        }
+    } else {
+        const int uv_width = static_cast<int>((width + 1) / 2);
+        const int uv_height = static_cast<int>((height + 1) / 2);
+        const size_t y_size = static_cast<size_t>(width) * height;
+        const size_t uv_size = static_cast<size_t>(uv_width) * uv_height;
+        const size_t a_size = has_alpha ? y_size : 0;
+        const size_t total_size = y_size + 2 * uv_size + a_size;
+
+        if (context.yuva_planes.size() < total_size) {
+            context.yuva_planes.resize(total_size);
+            Stats::AddAllocation(total_size);
+        }
+
+        uint8_t* base = context.yuva_planes.data();
+        picture.use_argb = 0;
+        picture.y = base;
+        picture.u = base + y_size;
+        picture.v = base + y_size + uv_size;
+        picture.a = has_alpha ? base + y_size + 2 * uv_size : nullptr;
+        picture.y_stride = static_cast<int>(width);
+        picture.uv_stride = uv_width;
+        picture.a_stride = has_alpha ? static_cast<int>(width) : 0;
+
+        // One pass from the capture layout into the planes (no BGRA->RGBA swizzle)
+        Stats::ScopedStageTimer convert_timer(Stats::Stage::Convert);
+        const bool has_transparency = SIMD::ConvertToYUV420(
+            data, width, height, stride, BytesPerPixel(layout), IsBGROrder(layout),
+            picture.y, picture.y_stride, picture.u, picture.v, picture.uv_stride,
+            picture.a, picture.a_stride);
+        convert_timer.Stop();
+        Stats::AddBytesCopied(total_size);
+
+        // Fully opaque frames (the common screenshot case) skip the alpha plane
+        if (!has_transparency) {
+            picture.a = nullptr;
+            picture.a_stride = 0;
+        }
+        picture.colorspace = has_transparency ? WEBP_YUV420A : WEBP_YUV420;
+    }
+
+    if (output.Streaming()) {
+        picture.writer = WriteToStream<EncodeOutput, BudgetWatch>;
+        picture.custom_ptr = &output;
+    } else if (output.InSpan()) {
+        // Straight into the caller's memory; a retried attempt starts over
+        output.Rewind();
+        picture.writer = WriteToSpan<EncodeOutput>;
+        picture.custom_ptr = &output;
+    } else {
+        // Reuse the writer's allocation across frames
+        context.writer.size = 0;
+        picture.writer = WebPMemoryWrite;
+        picture.custom_ptr = &context.writer;
+    }
+    SetProgressWatch(picture, watch);
+
+    const int ok = WebPEncode(&config, &picture);
+    const WebPEncodingError error_code = picture.error_code;
+
+    // Only releases libwebp-owned scratch (e.g. sharp-YUV planes); our planes stay cached
+    WebPPictureFree(&picture);
+
+    if (!ok) {
+        last_error_ = Utils::ErrorCodeToString(static_cast<int>(error_code));
+        return false;
+    }
+
+    return output.Streaming() || output.InSpan() || output.Assign(CopyEncodedOutput(context.writer));
+}
+
+bool WebPEncoder::EncodeMultiThreaded(const uint8_t* data, uint32_t width,
+                                      uint32_t height, uint32_t stride,
+                                      PixelLayout layout, const WebPEncodeParams& params,
+                                      EncodeOutput& output) {
+    const uint32_t threads = params.enable_multithreading ? ResolveThreadCount(params) : 1;
+    uint32_t tile_width = 0;
+    uint32_t tile_height = 0;
+    PlanTileGrid(width, height, threads, &tile_width, &tile_height);
+
+    std::vector<TileInfo> tiles = MakeTileGrid(data, stride, layout, width, height,
+                                               tile_width, tile_height, params);
+    SplitTargetSize(tiles, static_cast<uint64_t>(width) * height);
+    if (!EncodeTiles(tiles, threads)) {
+        return false;
+    }
+
+    // A single tile is already a plain WebP file
+    if (tiles.size() == 1) {
+        return output.Assign(std::move(tiles[0].encoded_data));
+    }
+
+    return CombineEncodedTiles(tiles, width, height, HasAlpha(layout), false, output);
+}
+
+std::vector<uint8_t> WebPEncoder::EncodeCanvas(const std::vector<CanvasLayer>& layers,
+                                               uint32_t canvas_width, uint32_t canvas_height,
+                                               const WebPEncodeParams& params) {
+    last_error_.clear();
+
+    if (layers.empty() || canvas_width == 0 || canvas_height == 0 ||
+        canvas_width > kMaxCanvasDimension || canvas_height > kMaxCanvasDimension) {
+        last_error_ = "Invalid canvas";
+        return {};
+    }
+
+    if (!Utils::ValidateWebPParams(params, last_error_)) {
+        return {};
+    }
+
+    const uint32_t threads = params.enable_multithreading ? ResolveThreadCount(params) : 1;
+    std::vector<TileInfo> tiles;
+    uint64_t covered_pixels = 0;
+    bool has_alpha = false;
+
+    for (size_t i = 0; i < layers.size(); ++i) {
+        const CanvasLayer& layer = layers[i];
+        const uint32_t bytes_per_pixel = BytesPerPixel(layer.layout);
+        const std::string name = "Layer " + std::to_string(i);
+
+        if (!layer.data || layer.width == 0 || layer.height == 0 || layer.x < 0 || layer.y < 0 ||
+            static_cast<uint64_t>(layer.x) + layer.width > canvas_width ||
+            static_cast<uint64_t>(layer.y) + layer.height > canvas_height) {
+            last_error_ = name + " does not fit the canvas";
+            return {};
+        }
+        if (layer.stride < layer.width * bytes_per_pixel) {
+            last_error_ = name + ": stride is smaller than row size";
+            return {};
+        }
+
+        // ANMF offsets are stored halved, so an odd edge drops its first
+        // column/row rather than shifting every pixel of the layer
+        const uint32_t skip_x = static_cast<uint32_t>(layer.x) & 1;
+        const uint32_t skip_y = static_cast<uint32_t>(layer.y) & 1;
+        if (layer.width <= skip_x || layer.height <= skip_y) {
+            continue;
+        }
+        const uint8_t* origin = layer.data + static_cast<size_t>(skip_y) * layer.stride +
+                                static_cast<size_t>(skip_x) * bytes_per_pixel;
+        const uint32_t width = layer.width - skip_x;
+        const uint32_t height = layer.height - skip_y;
+
+        // Each layer gets the grid a standalone encode of it would use
+        uint32_t tile_width = 0;
+        uint32_t tile_height = 0;
+        PlanTileGrid(width, height, threads, &tile_width, &tile_height);
+        if (!ShouldEncodeTiled(width, height, params)) {
+            tile_width = width;
+            tile_height = height;
+        }
+
+        std::vector<TileInfo> layer_tiles = MakeTileGrid(origin, layer.stride, layer.layout,
+                                                         width, height, tile_width, tile_height, params);
+        for (TileInfo& tile : layer_tiles) {
+            tile.x += static_cast<uint32_t>(layer.x) + skip_x;
+            tile.y += static_cast<uint32_t>(layer.y) + skip_y;
+            tiles.push_back(std::move(tile));
+        }
+        covered_pixels += static_cast<uint64_t>(width) * height;
+        has_alpha |= HasAlpha(layer.layout);
+    }
+
+    if (tiles.empty()) {
+        last_error_ = "Canvas has no visible layers";
+        return {};
+    }
+
+    // Layers are not expected to overlap, so less coverage than area means gaps
+    const bool gaps = covered_pixels < static_cast<uint64_t>(canvas_width) * canvas_height;
+
+    Stats::ScopedStageTimer timer(Stats::Stage::Encode);
+    StartBudget(params);
+    EncodeOutput output;
+    const std::vector<TileInfo> layout_tiles = tiles;
+    const bool ok = EncodeBounded(params, output, [&](const WebPEncodeParams& attempt, EncodeOutput& out) {
+        // Every attempt re-encodes all tiles at their share of its target
+        tiles = layout_tiles;
+        for (TileInfo& tile : tiles) {
+            tile.params = attempt;
+        }
+        SplitTargetSize(tiles, covered_pixels);
+        return EncodeTiles(tiles, threads) &&
+               CombineEncodedTiles(tiles, canvas_width, canvas_height, has_alpha, gaps, out);
+    });
+    if (!ok) {
+        timer.Cancel();
+        return {};
+    }
+    return std::move(output.buffer);
+}
+
+std::vector<WebPEncoder::TileInfo> WebPEncoder::MakeTileGrid(const uint8_t* data, uint32_t stride,
+                                                             PixelLayout layout,
+                                                             uint32_t width, uint32_t height,
+                                                             uint32_t tile_width, uint32_t tile_height,
+                                                             const WebPEncodeParams& params) {
+    std::vector<TileInfo> tiles;
+    for (uint32_t y = 0; y < height; y += tile_height) {
+        for (uint32_t x = 0; x < width; x += tile_width) {
+            TileInfo tile;
+            tile.x = x;
+            tile.y = y;
+            tile.width = std::min(tile_width, width - x);
+            tile.height = std::min(tile_height, height - y);
+            tile.pixels = data + static_cast<size_t>(y) * stride + static_cast<size_t>(x) * BytesPerPixel(layout);
+            tile.stride = stride;
+            tile.layout = layout;
+            tile.params = params;
+            tiles.push_back(std::move(tile));
+        }
+    }
+    return tiles;
+}
+
+bool WebPEncoder::EncodeContentAdaptive(const uint8_t* data, uint32_t width,
+                                        uint32_t height, uint32_t stride,
+                                        PixelLayout layout, const WebPEncodeParams& params,
+                                        EncodeOutput& output) {
+    std::vector<TileInfo> tiles = MakeTileGrid(data, stride, layout, width, height,
+                                               kContentTileSize, kContentTileSize, params);
+    const uint32_t bytes_per_pixel = BytesPerPixel(layout);
+
+    bool uniform = true;
+    ContentAnalysis::ContentClass first_class = ContentAnalysis::ContentClass::Photo;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        TileInfo& tile = tiles[i];
+        const ContentAnalysis::ContentStats stats = ContentAnalysis::AnalyzeRegion(
+            tile.pixels, tile.width, tile.height, tile.stride, bytes_per_pixel);
+        tile.params = ContentAnalysis::ParamsForContent(stats, params);
+        if (i == 0) {
+            first_class = stats.content_class;
+        }
+        uniform &= stats.content_class == first_class;
+    }
+
+    // One kind of content throughout: a single bitstream compresses best
+    if (uniform) {
+        return EncodeSingleThreaded(data, width, height, stride, layout, tiles[0].params, output);
+    }
+
+    SplitTargetSize(tiles, static_cast<uint64_t>(width) * height);
+    const uint32_t threads = params.enable_multithreading ? ResolveThreadCount(params) : 1;
+    if (!EncodeTiles(tiles, threads)) {
+        return false;
+    }
+    return CombineEncodedTiles(tiles, width, height, HasAlpha(layout), false, output);
+}
+
+bool WebPEncoder::EncodeWithTileCache(const uint8_t* data, uint32_t width,
+                                      uint32_t height, uint32_t stride,
+                                      PixelLayout layout, const WebPEncodeParams& params,
+                                      EncodeOutput& output) {
+    // A fixed grid keeps tile positions, and so their keys, stable between frames
+    std::vector<TileInfo> tiles = MakeTileGrid(data, stride, layout, width, height,
+                                               kCacheTileSize, kCacheTileSize, params);
+    SplitTargetSize(tiles, static_cast<uint64_t>(width) * height);
+    const uint64_t params_hash = TileCache::HashParams(params, layout);
+    const uint32_t bytes_per_pixel = BytesPerPixel(layout);
+
+    std::vector<TileCache::Key> keys(tiles.size());
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        const TileInfo& tile = tiles[i];
+        keys[i].pixel_hash = TileCache::HashRows(tile.pixels, static_cast<size_t>(tile.width) * bytes_per_pixel,
+                                                 tile.height, tile.stride);
+        keys[i].params_hash = params_hash;
+        keys[i].width = tile.width;
+        keys[i].height = tile.height;
+    }
+
+    // An identical frame is the previous file; a single tile already is one
+    const bool combined = tiles.size() > 1;
+    TileCache::Key frame_key;
+    if (combined) {
+        frame_key = TileCache::MakeFrameKey(keys, width, height);
+        if (TileCache::Bitstream file = TileCache::Find(frame_key)) {
+            Stats::AddFrameCacheLookup(true);
+            return output.Append(file->data(), file->size());
+        }
+        Stats::AddFrameCacheLookup(false);
+    }
+
+    uint64_t hits = 0;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        tiles[i].cached = TileCache::Find(keys[i]);
+        hits += tiles[i].cached ? 1 : 0;
+    }
+    Stats::AddTileCacheLookups(hits, tiles.size() - hits);
+
+    const uint32_t threads = params.enable_multithreading ? ResolveThreadCount(params) : 1;
+    if (!EncodeTiles(tiles, threads)) {
+        return false;
+    }
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        if (!tiles[i].cached) {
+            tiles[i].cached = std::make_shared<const std::vector<uint8_t>>(std::move(tiles[i].encoded_data));
+            TileCache::Insert(keys[i], tiles[i].cached);
+        }
+    }
+
+    if (!combined) {
+        return output.Append(tiles[0].cached->data(), tiles[0].cached->size());
+    }
+
+    EncodeOutput assembled;
+    if (!CombineEncodedTiles(tiles, width, height, HasAlpha(layout), false, assembled)) {
+        return false;
+    }
+    auto file = std::make_shared<const std::vector<uint8_t>>(std::move(assembled.buffer));
+    TileCache::Insert(frame_key, file);
+    return output.Append(file->data(), file->size());
+}
+
+bool WebPEncoder::EncodeTiles(std::vector<TileInfo>& tiles, uint32_t threads) {
+    // Tiles taken from the tile cache are already done
+    std::vector<size_t> pending;
+    pending.reserve(tiles.size());
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        if (!tiles[i].cached) {
+            pending.push_back(i);
+        }
+    }
+    if (pending.empty()) {
+        return true;
+    }
+
+    // Workers pull tiles off a shared counter so uneven tiles balance out
+    std::atomic<size_t> next_tile{0};
+    std::atomic<bool> failed{false};
+    std::vector<std::string> errors(tiles.size());
+
+    const size_t worker_count = std::min<size_t>(threads, pending.size());
+
+    // Tiles queue behind each other, so each gets the budget of its round
+    double slice_ms = 0.0;
+    if (has_deadline_) {
+        const size_t rounds = (pending.size() + worker_count - 1) / worker_count;
+        slice_ms = std::max(RemainingBudgetMs() / rounds, 0.001);  // 0 would mean no cap
+    }
+
+    const std::function<void()> worker = [&]() {
+        WebPEncoder encoder;  // own error state; pixel buffers are per-thread
+        encoder.has_deadline_ = has_deadline_;
+        encoder.deadline_ = deadline_;
+        encoder.slice_ms_ = slice_ms;
+        for (size_t n = next_tile++; n < pending.size() && !failed; n = next_tile++) {
+            const size_t i = pending[n];
+            TileInfo& tile = tiles[i];
+            tile.encoded_data = encoder.EncodeTile(tile.pixels, tile.width, tile.height,
+                                                   tile.stride, tile.layout, tile.params);
+            if (tile.encoded_data.empty()) {
+                errors[i] = encoder.GetLastError();
+                failed = true;
+            }
+        }
+    };
+
+    // The calling thread takes a share of the tiles
+    GetTileWorkerPool().Run(worker_count - 1, worker);
+
+    if (failed) {
+        auto it = std::find_if(errors.begin(), errors.end(),
+                               [](const std::string& e) { return !e.empty(); });
+        last_error_ = "Tile encoding failed: " + (it != errors.end() ? *it : std::string("unknown error"));
+        return false;
+    }
+    return true;
+}
+
+bool WebPEncoder::EncodeBatch(const std::vector<BatchFrame>& frames, uint32_t width, uint32_t height,
+                              PixelLayout layout, const WebPEncodeParams& params,
+                              const BatchCallback& on_frame, BatchStats* stats) {
+    last_error_.clear();
+    if (!on_frame) {
+        last_error_ = "Batch callback is null";
+        return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    BatchStats batch;
+    batch.frames = frames.size();
+
+    // Size, layout and params are shared, so the first frame checks them for all
+    if (!frames.empty()) {
+        uint32_t stride = frames[0].stride;
+        if (!ValidateInput(frames[0].data, width, height, stride, layout, params)) {
+            return false;
+        }
+    }
+    const uint32_t row_bytes = width * BytesPerPixel(layout);
+
+    // Frames are the unit of parallelism; tile threads would only oversubscribe
+    WebPEncodeParams frame_params = params;
+    frame_params.enable_multithreading = false;
+    const uint32_t threads = params.enable_multithreading ? ResolveThreadCount(params) : 1;
+    const size_t worker_count = std::min<size_t>(threads, frames.size());
+    const size_t window = std::max<size_t>(worker_count, 1) * kBatchFramesAheadPerWorker;
+
+    std::vector<std::vector<uint8_t>> encoded(frames.size());
+    std::vector<std::string> errors(frames.size());
+    std::vector<uint8_t> ready(frames.size(), 0);
+    std::atomic<size_t> next_frame{0};
+    std::atomic<size_t> failed{0};
+
+    // Guards ready and next_delivery; delivery runs under it, so on_frame
+    // calls never overlap
+    std::mutex delivery_mutex;
+    std::condition_variable delivered;
+    size_t next_delivery = 0;
+
+    auto deliver = [&](size_t index) {
+        std::lock_guard<std::mutex> lock(delivery_mutex);
+        ready[index] = 1;
+        const size_t before = next_delivery;
+        while (next_delivery < frames.size() && ready[next_delivery]) {
+            on_frame(next_delivery, std::move(encoded[next_delivery]), errors[next_delivery]);
+            encoded[next_delivery] = {};
+            ++next_delivery;
+        }
+        if (next_delivery != before) {
+            delivered.notify_all();
+        }
+    };
+
+    auto worker = [&]() {
+        WebPEncoder encoder;  // own error state and budget; picture and planes are per-thread
+        for (size_t n = next_frame++; n < frames.size(); n = next_frame++) {
+            {
+                // The frame at next_delivery is always taken, so this wait ends
+                std::unique_lock<std::mutex> lock(delivery_mutex);
+                delivered.wait(lock, [&] { return n < next_delivery + window; });
+            }
+
+            const BatchFrame& frame = frames[n];
+            const uint32_t stride = frame.stride ? frame.stride : row_bytes;
+            if (!frame.data) {
+                errors[n] = "Input data is null";
+            } else if (stride < row_bytes) {
+                errors[n] = "Stride is smaller than row size";
+            } else {
+                Stats::ScopedStageTimer timer(Stats::Stage::Encode);
+                encoder.last_error_.clear();
+                encoder.StartBudget(frame_params);
+                EncodeOutput output;
+                if (encoder.EncodeBounded(frame_params, output, [&](const WebPEncodeParams& attempt, EncodeOutput& out) {
+                        return encoder.EncodeTo(frame.data, width, height, stride, layout, attempt, out);
+                    })) {
+                    encoded[n] = std::move(output.buffer);
+                } else {
+                    timer.Cancel();
+                    errors[n] = encoder.GetLastError().empty() ? "Encode failed" : encoder.GetLastError();
+                }
+            }
+            if (!errors[n].empty()) {
+                ++failed;
+            }
+            deliver(n);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    if (worker_count > 1) {
+        pool.reserve(worker_count - 1);
+    }
+    for (size_t i = 1; i < worker_count; ++i) {
+        pool.emplace_back(worker);
+    }
+    worker();  // calling thread takes a share of the frames
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    batch.failed_frames = failed;
+    batch.workers = static_cast<uint32_t>(worker_count);
+    batch.elapsed_ms = MillisecondsSince(start);
+    if (batch.elapsed_ms > 0.0) {
+        batch.frames_per_second = batch.frames * 1000.0 / batch.elapsed_ms;
+    }
+    if (stats) {
+        *stats = batch;
+    }
+    return true;
+}
+
+std::vector<uint8_t> WebPEncoder::EncodeTile(const uint8_t* data, uint32_t width, uint32_t height,
+                                             uint32_t stride, PixelLayout layout,
+                                             const WebPEncodeParams& params) {
+    EncodeOutput output;
+    bool ok;
+    if (params.content_adaptive) {
+        const ContentAnalysis::ContentStats stats =
+            ContentAnalysis::AnalyzeRegion(data, width, height, stride, BytesPerPixel(layout));
+        ok = EncodeSingleThreaded(data, width, height, stride, layout,
+                                  ContentAnalysis::ParamsForContent(stats, params), output);
+    } else {
+        ok = EncodeSingleThreaded(data, width, height, stride, layout, params, output);
+    }
+    return ok ? std::move(output.buffer) : std::vector<uint8_t>();
+}
+
+// Tiles are stored as frames of a one-shot animation (VP8X + ANIM + one ANMF
+// per tile, zero duration, no blending), which any WebP demuxer or
+// WebPAnimDecoder composites back into the full canvas
+std::vector<uint8_t> WebPEncoder::AssembleTiles(const std::vector<EncodedTile>& tiles,
+                                                uint32_t canvas_width, uint32_t canvas_height,
+                                                bool has_alpha) {
+    last_error_.clear();
+    EncodeOutput output;
+    if (!AssembleTilesTo(tiles, canvas_width, canvas_height, has_alpha, output)) {
         return {};
     }
-    
-    // For now, return a minimal WebP header to satisfy the interface
-    // In a real implementation, this would encode to actual WebP format
-    std::vector<uint8_t> result;
-    
-    // Simple WebP-like header (this is just a placeholder)
-    const char* header = "RIFF";
-    result.insert(result.end(), header, header + 4);
-    
-    // File size placeholder (4 bytes)
-    uint32_t fileSize = width * height + 100; // Rough estimate
-    result.push_back(fileSize & 0xFF);
-    result.push_back((fileSize >> 8) & 0xFF);
-    result.push_back((fileSize >> 16) & 0xFF);
-    result.push_back((fileSize >> 24) & 0xFF);
-    
-    // WebP signature
-    const char* webp_sig = "WEBP";
-    result.insert(result.end(), webp_sig, webp_sig + 4);
-    
-    // VP8 chunk (simplified)
-    const char* vp8_header = "VP8 ";
-    result.insert(result.end(), vp8_header, vp8_header + 4);
-    
-    // Add some basic image data (simplified encoding)
-    uint32_t imageDataSize = width * height / 10; // Simulate compression
-    result.push_back(imageDataSize & 0xFF);
-    result.push_back((imageDataSize >> 8) & 0xFF);
-    result.push_back((imageDataSize >> 16) & 0xFF);
-    result.push_back((imageDataSize >> 24) & 0xFF);
-    
-    // Add placeholder compressed data
-    for (uint32_t i = 0; i < imageDataSize && result.size() < 1000000; ++i) {
-        result.push_back(static_cast<uint8_t>(i % 256));
-    }
-    
-    std::cout << "Encoded image " << width << "x" << height << " to " << result.size() << " bytes (mock WebP)" << std::endl;
-    
+    return std::move(output.buffer);
+}
+
+EncodeIntoResult WebPEncoder::AssembleTilesInto(const std::vector<EncodedTile>& tiles,
+                                                uint32_t canvas_width, uint32_t canvas_height,
+                                                bool has_alpha, EncodeSpan span) {
+    last_error_.clear();
+    EncodeIntoResult result;
+    if (!span.data && span.capacity > 0) {
+        last_error_ = "Output span is null";
+        return result;
+    }
+
+    EncodeOutput output;
+    output.SetSpan(span);
+    if (!AssembleTilesTo(tiles, canvas_width, canvas_height, has_alpha, output)) {
+        return result;
+    }
+
+    result.required_size = output.bytes;
+    if (output.Overflowed()) {
+        last_error_ = "Output span too small: " + std::to_string(output.bytes) + " bytes needed";
+        return result;
+    }
+    result.success = true;
+    result.bytes_written = output.bytes;
     return result;
 }
 
-bool WebPEncoder::EncodeMultiThreaded(const uint8_t* data, uint32_t width, uint32_t height,
-                                     uint32_t stride, bool has_alpha, 
-                                     const WebPEncodeParams& params,
-                                     std::vector<uint8_t>& output) {
-    // For now, just call the single-threaded version
-    output = EncodeInternal(data, width, height, stride, has_alpha, params);
-    return !output.empty();
-}
-
-std::vector<uint8_t> WebPEncoder::CombineEncodedTiles(const std::vector<TileInfo>& tiles, 
-                                                     uint32_t total_width, uint32_t total_height,
-                                                     bool has_alpha) {
-    std::vector<uint8_t> combined;
-    
-    // Create a simple combined WebP-like format
-    const char* header = "RIFF";
-    combined.insert(combined.end(), header, header + 4);
-    
-    // Calculate total size
-    uint32_t totalSize = 0;
-    for (const auto& tile : tiles) {
-        totalSize += tile.encoded_data.size();
-    }
-    totalSize += 100; // Headers
-    
-    combined.push_back(totalSize & 0xFF);
-    combined.push_back((totalSize >> 8) & 0xFF);
-    combined.push_back((totalSize >> 16) & 0xFF);
-    combined.push_back((totalSize >> 24) & 0xFF);
-    
-    const char* webp_sig = "WEBP";
-    combined.insert(combined.end(), webp_sig, webp_sig + 4);
-    
-    // Add VP8X header for extended format
-    const char* vp8x_header = "VP8X";
-    combined.insert(combined.end(), vp8x_header, vp8x_header + 4);
-    
-    // VP8X chunk size
-    uint32_t vp8x_size = 10;
-    combined.push_back(vp8x_size & 0xFF);
-    combined.push_back((vp8x_size >> 8) & 0xFF);
-    combined.push_back((vp8x_size >> 16) & 0xFF);
-    combined.push_back((vp8x_size >> 24) & 0xFF);
-    
-    // VP8X flags and dimensions
-    uint8_t flags = has_alpha ? 0x10 : 0x00;
-    combined.push_back(flags);
-    combined.push_back(0); // Reserved
-    combined.push_back(0); // Reserved
-    combined.push_back(0); // Reserved
-    
-    // Canvas width and height (24-bit each)
-    combined.push_back((total_width - 1) & 0xFF);
-    combined.push_back(((total_width - 1) >> 8) & 0xFF);
-    combined.push_back(((total_width - 1) >> 16) & 0xFF);
-    
-    combined.push_back((total_height - 1) & 0xFF);
-    combined.push_back(((total_height - 1) >> 8) & 0xFF);
-    combined.push_back(((total_height - 1) >> 16) & 0xFF);
-    
-    // Add tile data
-    for (const auto& tile : tiles) {
-        combined.insert(combined.end(), tile.encoded_data.begin(), tile.encoded_data.end());
-    }
-    
-    return combined;
-}
-
-std::string WebPEncoder::GetLastError() const {
-    return last_error_;
-}
-
-} // namespace WebPScreenshot
\ No newline at end of file
+bool WebPEncoder::AssembleTilesTo(const std::vector<EncodedTile>& tiles,
+                                  uint32_t canvas_width, uint32_t canvas_height,
+                                  bool has_alpha, EncodeOutput& output) {
+    if (tiles.empty() || canvas_width == 0 || canvas_height == 0 ||
+        canvas_width > kMaxCanvasDimension || canvas_height > kMaxCanvasDimension) {
+        last_error_ = "Invalid canvas dimensions";
+        return false;
+    }
+
+    // The bitstreams are shared, not copied, until their chunks go into the file
+    std::vector<TileInfo> placed(tiles.size());
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        const EncodedTile& tile = tiles[i];
+        if (!tile.bitstream || tile.bitstream->empty()) {
+            last_error_ = "Tile " + std::to_string(i) + " has no bitstream";
+            return false;
+        }
+        if ((tile.x | tile.y) & 1 ||
+            static_cast<uint64_t>(tile.x) + tile.width > canvas_width ||
+            static_cast<uint64_t>(tile.y) + tile.height > canvas_height) {
+            last_error_ = "Tile " + std::to_string(i) + " is misplaced on the canvas";
+            return false;
+        }
+        placed[i].x = tile.x;
+        placed[i].y = tile.y;
+        placed[i].width = tile.width;
+        placed[i].height = tile.height;
+        placed[i].cached = tile.bitstream;
+    }
+    return CombineEncodedTiles(placed, canvas_width, canvas_height, has_alpha, false, output);
+}
+
+bool WebPEncoder::CombineEncodedTiles(const std::vector<TileInfo>& tiles,
+                                      uint32_t total_width, uint32_t total_height,
+                                      bool has_alpha, bool transparent_gaps, EncodeOutput& output) {
+    using namespace WebPContainer;
+
+    // The RIFF header holds the file size, so every tile is located before
+    // anything is written and the tiles are never copied into one buffer
+    struct ImageChunks {
+        size_t offset = 0;
+        size_t size = 0;
+    };
+    std::vector<ImageChunks> chunks(tiles.size());
+    uint64_t file_size = 12 + 18 + 14;
+    bool any_alpha = false;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        bool tile_alpha = false;
+        if (!FindImageChunks(tiles[i].Encoded(), &chunks[i].offset, &chunks[i].size, &tile_alpha)) {
+            last_error_ = "Malformed tile bitstream";
+            return false;
+        }
+        any_alpha |= tile_alpha;
+        file_size += 24 + chunks[i].size;
+    }
+
+    if (file_size - 8 > UINT32_MAX) {
+        last_error_ = "Encoded file too big (> 4G)";
+        return false;
+    }
+
+    std::vector<uint8_t> header;
+    const size_t flags_offset = PutExtendedHeader(header, total_width, total_height);
+    header[flags_offset] |= kVP8XAnimationFlag;
+    if ((has_alpha && any_alpha) || transparent_gaps) {
+        header[flags_offset] |= kVP8XAlphaFlag;
+    }
+    // Transparent background, played once so the final canvas is the image
+    PutAnimationHeader(header, 0x00000000, 1);
+    SetLE32(header, 4, static_cast<uint32_t>(file_size - 8));
+
+    if (!output.Streaming() && !output.InSpan()) {
+        output.buffer.reserve(file_size);
+    }
+    bool ok = output.Append(header.data(), header.size());
+    for (size_t i = 0; i < tiles.size() && ok; ++i) {
+        const TileInfo& tile = tiles[i];
+        header.clear();
+        PutAnimationFrameHeader(header, tile.x, tile.y, tile.width, tile.height, 0, kANMFNoBlend,
+                                chunks[i].size);
+        ok = output.Append(header.data(), header.size()) &&
+             output.Append(tile.Encoded().data() + chunks[i].offset, chunks[i].size);
+    }
+    return ok;
+}
+
+namespace Utils {
+
+std::string ErrorCodeToString(int error_code) {
+    switch (static_cast<WebPEncodingError>(error_code)) {
+        case VP8_ENC_OK: return "OK";
+        case VP8_ENC_ERROR_OUT_OF_MEMORY: return "Out of memory allocating objects";
+        case VP8_ENC_ERROR_BITSTREAM_OUT_OF_MEMORY: return "Out of memory flushing bits";
+        case VP8_ENC_ERROR_NULL_PARAMETER: return "NULL parameter";
+        case VP8_ENC_ERROR_INVALID_CONFIGURATION: return "Invalid configuration";
+        case VP8_ENC_ERROR_BAD_DIMENSION: return "Bad picture dimension";
+        case VP8_ENC_ERROR_PARTITION0_OVERFLOW: return "Partition 0 overflow (> 512K)";
+        case VP8_ENC_ERROR_PARTITION_OVERFLOW: return "Partition overflow (> 16M)";
+        case VP8_ENC_ERROR_BAD_WRITE: return "Error writing output bytes";
+        case VP8_ENC_ERROR_FILE_TOO_BIG: return "Encoded file too big (> 4G)";
+        case VP8_ENC_ERROR_USER_ABORT: return "Encoding aborted by user";
+        default: return "Unknown WebP encoding error " + std::to_string(error_code);
+    }
+}
+
+bool ValidateWebPParams(const WebPEncodeParams& params, std::string& error) {
+    auto in_range = [&error](int value, int min, int max, const char* name) {
+        if (value < min || value > max) {
+            error = std::string(name) + " must be between " + std::to_string(min) +
+                    " and " + std::to_string(max);
+            return false;
+        }
+        return true;
+    };
+
+    if (params.quality < 0.0f || params.quality > 100.0f) {
+        error = "quality must be between 0 and 100";
+        return false;
+    }
+
+    if (params.target_size < 0 || params.target_psnr < 0.0f) {
+        error = "target_size and target_psnr must not be negative";
+        return false;
+    }
+
+    if (params.max_output_size < 0) {
+        error = "max_output_size must not be negative";
+        return false;
+    }
+
+    if (params.max_encode_ms < 0.0f) {
+        error = "max_encode_ms must not be negative";
+        return false;
+    }
+
+    return in_range(params.lossless, 0, 1, "lossless") &&
+           in_range(params.method, 0, 6, "method") &&
+           in_range(params.segments, 1, 4, "segments") &&
+           in_range(params.sns_strength, 0, 100, "sns_strength") &&
+           in_range(params.filter_strength, 0, 100, "filter_strength") &&
+           in_range(params.filter_sharpness, 0, 7, "filter_sharpness") &&
+           in_range(params.filter_type, 0, 1, "filter_type") &&
+           in_range(params.autofilter, 0, 1, "autofilter") &&
+           in_range(params.alpha_compression, 0, 1, "alpha_compression") &&
+           in_range(params.alpha_filtering, 0, 2, "alpha_filtering") &&
+           in_range(params.alpha_quality, 0, 100, "alpha_quality") &&
+           in_range(params.pass, 1, 10, "pass") &&
+           in_range(params.show_compressed, 0, 1, "show_compressed") &&
+           in_range(params.preprocessing, 0, 7, "preprocessing") &&
+           in_range(params.partitions, 0, 3, "partitions") &&
+           in_range(params.partition_limit, 0, 100, "partition_limit") &&
+           in_range(params.emulate_jpeg_size, 0, 1, "emulate_jpeg_size") &&
+           in_range(params.thread_level, 0, 1, "thread_level") &&
+           in_range(params.low_memory, 0, 1, "low_memory") &&
+           in_range(params.near_lossless, 0, 100, "near_lossless") &&
+           in_range(params.exact, 0, 1, "exact") &&
+           in_range(params.use_delta_palette, 0, 1, "use_delta_palette") &&
+           in_range(params.use_sharp_yuv, 0, 1, "use_sharp_yuv") &&
+           in_range(params.content_adaptive, 0, 1, "content_adaptive") &&
+           in_range(params.tile_cache, 0, 1, "tile_cache");
+}
+
+} // namespace Utils
+
+} // namespace WebPScreenshot
@@ -1,24 +1,43 @@
 #include "common/screenshot_common.h"
-#include <webp/encode.h>
+#include "common/simd_dispatch.h"
+#include <cstring>
 
-// Advanced SIMD intrinsics for WebP optimization
-#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
-    #define WEBP_SIMD_SSE2 1
-    #include <emmintrin.h>
-#endif
+namespace WebPScreenshot {
+namespace SIMD {
+
+namespace {
+
+using PreprocessKernel = void (*)(const uint8_t* input, uint8_t* output,
+                                  uint32_t width, uint32_t height, uint32_t stride);
 
-#if defined(__AVX2__)
-    #define WEBP_SIMD_AVX2 1
-    #include <immintrin.h>
+#ifdef WEBP_USE_X86
+WEBP_TARGET_SSE2 void PreprocessImageSSE2(const uint8_t* input, uint8_t* output,
+                                          uint32_t width, uint32_t height, uint32_t stride);
+WEBP_TARGET_AVX2 void PreprocessImageAVX2(const uint8_t* input, uint8_t* output,
+                                          uint32_t width, uint32_t height, uint32_t stride);
+#endif
+#ifdef WEBP_USE_NEON
+void PreprocessImageNEON(const uint8_t* input, uint8_t* output,
+                         uint32_t width, uint32_t height, uint32_t stride);
 #endif
 
-#if defined(__ARM_NEON) || defined(__aarch64__)
-    #define WEBP_SIMD_NEON 1
-    #include <arm_neon.h>
+// Follows the converters' dispatch level, so SetISALimit covers this pass too
+PreprocessKernel PreprocessKernelFor(ISA isa) {
+    switch (isa) {
+#ifdef WEBP_USE_X86
+        case ISA::AVX512:
+        case ISA::AVX2: return PreprocessImageAVX2;
+        case ISA::SSE41:
+        case ISA::SSE2: return PreprocessImageSSE2;
+#endif
+#ifdef WEBP_USE_NEON
+        case ISA::NEON: return PreprocessImageNEON;
 #endif
+        default: return nullptr;
+    }
+}
 
-namespace WebPScreenshot {
-namespace SIMD {
+} // anonymous namespace
 
 // Advanced WebP preprocessing optimizations
 class WebPSIMDEncoder {
@@ -30,170 +49,98 @@ public:
     std::vector<uint8_t> EncodeSIMD(const uint8_t* rgba_data, uint32_t width, 
                                    uint32_t height, uint32_t stride,
                                    const WebPEncodeParams& params);
+
+    // The same pipeline into caller memory
+    EncodeIntoResult EncodeSIMDInto(const uint8_t* rgba_data, uint32_t width,
+                                    uint32_t height, uint32_t stride,
+                                    const WebPEncodeParams& params, EncodeSpan output);
     
     // Get optimal SIMD capabilities
     static std::string GetOptimizations();
 
 private:
-    bool has_sse2_;
-    bool has_avx2_;
-    bool has_neon_;
-    
-    // SIMD-optimized preprocessing
-    void PreprocessImageSSE2(const uint8_t* input, uint8_t* output, 
-                            uint32_t width, uint32_t height, uint32_t stride);
-    void PreprocessImageAVX2(const uint8_t* input, uint8_t* output, 
-                            uint32_t width, uint32_t height, uint32_t stride);
-    void PreprocessImageNEON(const uint8_t* input, uint8_t* output, 
-                            uint32_t width, uint32_t height, uint32_t stride);
-    
+    // Runs encode(pixels, stride) on the frame, or on a smoothed copy of it
+    template <typename EncodeFn>
+    auto WithPreprocessing(const uint8_t* rgba_data, uint32_t width, uint32_t height,
+                           uint32_t stride, const WebPEncodeParams& params, EncodeFn&& encode)
+        -> decltype(encode(rgba_data, stride));
+
     // Color space conversion optimizations
     void RGBAToYUVSIMD(const uint8_t* rgba, uint8_t* y, uint8_t* u, uint8_t* v,
                        uint32_t width, uint32_t height);
     
-    // Advanced filtering
-    void ApplyDeblockingFilterSIMD(uint8_t* data, uint32_t width, uint32_t height,
-                                   uint32_t stride, int filter_strength);
-    
     // Quantization optimization
     void OptimizeQuantizationSIMD(int16_t* coefficients, const int16_t* quant_matrix,
                                   uint32_t block_count);
 };
 
-WebPSIMDEncoder::WebPSIMDEncoder() {
-    // Detect SIMD capabilities
-    has_sse2_ = false;
-    has_avx2_ = false;
-    has_neon_ = false;
-    
-#if defined(_MSC_VER)
-    int cpu_info[4];
-    __cpuid(cpu_info, 1);
-    has_sse2_ = (cpu_info[3] & (1 << 26)) != 0;
-    
-    __cpuid(cpu_info, 7);
-    has_avx2_ = (cpu_info[1] & (1 << 5)) != 0;
-#elif defined(__GNUC__) || defined(__clang__)
-    #ifdef WEBP_SIMD_SSE2
-    has_sse2_ = __builtin_cpu_supports("sse2");
-    #endif
-    
-    #ifdef WEBP_SIMD_AVX2
-    has_avx2_ = __builtin_cpu_supports("avx2");
-    #endif
-#endif
-
-#ifdef WEBP_SIMD_NEON
-    has_neon_ = true;
-#endif
-}
+WebPSIMDEncoder::WebPSIMDEncoder() = default;
 
 WebPSIMDEncoder::~WebPSIMDEncoder() = default;
 
-std::vector<uint8_t> WebPSIMDEncoder::EncodeSIMD(const uint8_t* rgba_data, uint32_t width, 
-                                                 uint32_t height, uint32_t stride,
-                                                 const WebPEncodeParams& params) {
+template <typename EncodeFn>
+auto WebPSIMDEncoder::WithPreprocessing(const uint8_t* rgba_data, uint32_t width, uint32_t height,
+                                        uint32_t stride, const WebPEncodeParams& params,
+                                        EncodeFn&& encode) -> decltype(encode(rgba_data, stride)) {
+    // The SIMD smoothing pass stands in for segment smoothing (preprocessing
+    // bit 0). It changes pixels, so lossless and content-adaptive encodes,
+    // which may pick lossless for text, always see the original frame.
+    const bool smooth = (params.preprocessing & 1) && !params.lossless && !params.content_adaptive;
+    if (!smooth || !rgba_data) {
+        return encode(rgba_data, stride);
+    }
+
     // Create preprocessed buffer using memory pool
-    const size_t buffer_size = width * height * 4;
+    const size_t buffer_size = static_cast<size_t>(width) * height * 4;
     auto preprocessed_buffer = Utils::AllocateScreenshotBuffer(buffer_size);
+    if (stride == 0) {
+        stride = width * 4;
+    }
     
     // Apply SIMD preprocessing optimizations
-    if (has_avx2_) {
-        PreprocessImageAVX2(rgba_data, preprocessed_buffer.get(), width, height, stride);
-    } else if (has_sse2_) {
-        PreprocessImageSSE2(rgba_data, preprocessed_buffer.get(), width, height, stride);
-    } else if (has_neon_) {
-        PreprocessImageNEON(rgba_data, preprocessed_buffer.get(), width, height, stride);
+    if (PreprocessKernel preprocess = PreprocessKernelFor(GetActiveISA())) {
+        preprocess(rgba_data, preprocessed_buffer.get(), width, height, stride);
     } else {
         // Fallback: simple copy
         for (uint32_t y = 0; y < height; ++y) {
-            std::memcpy(preprocessed_buffer.get() + y * width * 4, 
-                       rgba_data + y * stride, width * 4);
+            std::memcpy(preprocessed_buffer.get() + static_cast<size_t>(y) * width * 4, 
+                       rgba_data + static_cast<size_t>(y) * stride, width * 4);
         }
     }
+    Stats::AddBytesCopied(buffer_size);
     
-    // Setup WebP with SIMD-optimized parameters
-    WebPConfig config;
-    WebPConfigInit(&config);
-    
-    // Optimize config for SIMD performance
-    config.quality = params.quality;
-    config.method = 6; // Maximum compression effort for SIMD optimization
-    config.segments = 4; // Optimal for parallel SIMD processing
-    config.sns_strength = params.sns_strength;
-    config.filter_strength = params.filter_strength;
-    config.alpha_compression = params.alpha_compression;
-    config.thread_level = 1; // Enable internal threading
-    config.preprocessing = 2; // Enable pseudo-random dithering for SIMD
-    
-    // SIMD-specific optimizations
-    if (has_avx2_) {
-        config.partitions = 3; // More partitions for AVX2
-        config.pass = std::min(params.pass, 6); // Optimal for AVX2
-    } else if (has_sse2_) {
-        config.partitions = 2; // Good for SSE2
-        config.pass = std::min(params.pass, 4);
-    }
-    
-    WebPValidateConfig(&config);
-    
-    // Setup WebP picture with SIMD optimization hints
-    WebPPicture picture;
-    WebPPictureInit(&picture);
-    
-    picture.width = width;
-    picture.height = height;
-    picture.use_argb = 1; // Use ARGB for better SIMD performance
-    
-    // Custom writer for optimized output
-    std::vector<uint8_t> output_buffer;
-    
-    auto writer = [](const uint8_t* data, size_t data_size, const WebPPicture* picture) -> int {
-        std::vector<uint8_t>* buffer = static_cast<std::vector<uint8_t>*>(picture->custom_ptr);
-        buffer->insert(buffer->end(), data, data + data_size);
-        return 1;
-    };
-    
-    picture.writer = writer;
-    picture.custom_ptr = &output_buffer;
-    
-    // Allocate picture buffer
-    if (!WebPPictureAlloc(&picture)) {
-        Utils::ReturnScreenshotBuffer(std::move(preprocessed_buffer), buffer_size);
-        return {};
-    }
-    
-    // Import with SIMD-optimized format
-    int import_result = WebPPictureImportRGBA(&picture, preprocessed_buffer.get(), width * 4);
-    
-    // Return buffer to pool
+    // Every other setting is the caller's; libwebp's own loop filter
+    // applies filter_strength
+    auto result = encode(preprocessed_buffer.get(), width * 4);
     Utils::ReturnScreenshotBuffer(std::move(preprocessed_buffer), buffer_size);
-    
-    if (!import_result) {
-        WebPPictureFree(&picture);
-        return {};
-    }
-    
-    // Apply SIMD post-processing if available
-    if (params.filter_strength > 0 && (has_sse2_ || has_avx2_ || has_neon_)) {
-        ApplyDeblockingFilterSIMD(reinterpret_cast<uint8_t*>(picture.argb), 
-                                 width, height, width * 4, params.filter_strength);
-    }
-    
-    // Encode with optimizations
-    int encode_result = WebPEncode(&config, &picture);
-    
-    WebPPictureFree(&picture);
-    
-    if (!encode_result) {
-        return {};
-    }
-    
-    return output_buffer;
+    return result;
 }
 
-#ifdef WEBP_SIMD_SSE2
-void WebPSIMDEncoder::PreprocessImageSSE2(const uint8_t* input, uint8_t* output,
+std::vector<uint8_t> WebPSIMDEncoder::EncodeSIMD(const uint8_t* rgba_data, uint32_t width, 
+                                                 uint32_t height, uint32_t stride,
+                                                 const WebPEncodeParams& params) {
+    WebPEncoder encoder;
+    return WithPreprocessing(rgba_data, width, height, stride, params,
+                             [&](const uint8_t* pixels, uint32_t pixel_stride) {
+                                 return encoder.EncodeRGBA(pixels, width, height, pixel_stride, params);
+                             });
+}
+
+EncodeIntoResult WebPSIMDEncoder::EncodeSIMDInto(const uint8_t* rgba_data, uint32_t width,
+                                                 uint32_t height, uint32_t stride,
+                                                 const WebPEncodeParams& params, EncodeSpan output) {
+    WebPEncoder encoder;
+    return WithPreprocessing(rgba_data, width, height, stride, params,
+                             [&](const uint8_t* pixels, uint32_t pixel_stride) {
+                                 return encoder.EncodeInto(pixels, width, height, pixel_stride,
+                                                           WebPEncoder::PixelLayout::RGBA, params, output);
+                             });
+}
+
+namespace {
+
+#ifdef WEBP_USE_X86
+WEBP_TARGET_SSE2 void PreprocessImageSSE2(const uint8_t* input, uint8_t* output,
                                           uint32_t width, uint32_t height, uint32_t stride) {
     const uint32_t pixels_per_iter = 4; // Process 4 pixels at once
     const uint32_t simd_width = (width / pixels_per_iter) * pixels_per_iter;
@@ -225,10 +172,8 @@ void WebPSIMDEncoder::PreprocessImageSSE2(const uint8_t* input, uint8_t* output,
         }
     }
 }
-#endif
 
-#ifdef WEBP_SIMD_AVX2
-void WebPSIMDEncoder::PreprocessImageAVX2(const uint8_t* input, uint8_t* output,
+WEBP_TARGET_AVX2 void PreprocessImageAVX2(const uint8_t* input, uint8_t* output,
                                           uint32_t width, uint32_t height, uint32_t stride) {
     const uint32_t pixels_per_iter = 8; // Process 8 pixels at once with AVX2
     const uint32_t simd_width = (width / pixels_per_iter) * pixels_per_iter;
@@ -249,7 +194,6 @@ void WebPSIMDEncoder::PreprocessImageAVX2(const uint8_t* input, uint8_t* output,
             __m256i averaged = _mm256_avg_epu8(pixels, _mm256_avg_epu8(shifted_left, shifted_right));
             
             // Apply sharpening filter
-            __m256i sharpening_mask = _mm256_set1_epi8(2);
             __m256i sharpened = _mm256_adds_epu8(averaged, 
                 _mm256_subs_epu8(pixels, _mm256_avg_epu8(pixels, averaged)));
             
@@ -267,9 +211,9 @@ void WebPSIMDEncoder::PreprocessImageAVX2(const uint8_t* input, uint8_t* output,
 }
 #endif
 
-#ifdef WEBP_SIMD_NEON
-void WebPSIMDEncoder::PreprocessImageNEON(const uint8_t* input, uint8_t* output,
-                                          uint32_t width, uint32_t height, uint32_t stride) {
+#ifdef WEBP_USE_NEON
+void PreprocessImageNEON(const uint8_t* input, uint8_t* output,
+                         uint32_t width, uint32_t height, uint32_t stride) {
     const uint32_t pixels_per_iter = 4; // Process 4 pixels at once with NEON
     const uint32_t simd_width = (width / pixels_per_iter) * pixels_per_iter;
     
@@ -302,52 +246,18 @@ void WebPSIMDEncoder::PreprocessImageNEON(const uint8_t* input, uint8_t* output,
 }
 #endif
 
-void WebPSIMDEncoder::ApplyDeblockingFilterSIMD(uint8_t* data, uint32_t width, uint32_t height,
-                                               uint32_t stride, int filter_strength) {
-    if (filter_strength <= 0) return;
-    
-    // Apply horizontal deblocking
-    for (uint32_t y = 1; y < height - 1; ++y) {
-        uint8_t* row = data + y * stride;
-        
-        #ifdef WEBP_SIMD_AVX2
-        if (has_avx2_) {
-            const uint32_t simd_width = (width / 8) * 8;
-            for (uint32_t x = 0; x < simd_width; x += 8) {
-                __m256i current = _mm256_loadu_si256(reinterpret_cast<__m256i*>(row + x * 4));
-                __m256i above = _mm256_loadu_si256(reinterpret_cast<__m256i*>(row - stride + x * 4));
-                __m256i below = _mm256_loadu_si256(reinterpret_cast<__m256i*>(row + stride + x * 4));
-                
-                __m256i filtered = _mm256_avg_epu8(_mm256_avg_epu8(above, below), current);
-                _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + x * 4), filtered);
-            }
-        }
-        #elif defined(WEBP_SIMD_SSE2)
-        if (has_sse2_) {
-            const uint32_t simd_width = (width / 4) * 4;
-            for (uint32_t x = 0; x < simd_width; x += 4) {
-                __m128i current = _mm_loadu_si128(reinterpret_cast<__m128i*>(row + x * 4));
-                __m128i above = _mm_loadu_si128(reinterpret_cast<__m128i*>(row - stride + x * 4));
-                __m128i below = _mm_loadu_si128(reinterpret_cast<__m128i*>(row + stride + x * 4));
-                
-                __m128i filtered = _mm_avg_epu8(_mm_avg_epu8(above, below), current);
-                _mm_storeu_si128(reinterpret_cast<__m128i*>(row + x * 4), filtered);
-            }
-        }
-        #endif
-    }
-}
+} // anonymous namespace
 
 std::string WebPSIMDEncoder::GetOptimizations() {
-    WebPSIMDEncoder encoder;
     std::string optimizations = "WebP SIMD Optimizations: ";
     
-    if (encoder.has_avx2_) optimizations += "AVX2 ";
-    if (encoder.has_sse2_) optimizations += "SSE2 ";
-    if (encoder.has_neon_) optimizations += "NEON ";
-    
-    if (!encoder.has_avx2_ && !encoder.has_sse2_ && !encoder.has_neon_) {
-        optimizations += "None (Scalar)";
+    switch (GetActiveISA()) {
+        case ISA::AVX512:
+        case ISA::AVX2: optimizations += "AVX2 SSE2 "; break;
+        case ISA::SSE41:
+        case ISA::SSE2: optimizations += "SSE2 "; break;
+        case ISA::NEON: optimizations += "NEON "; break;
+        case ISA::Scalar: optimizations += "None (Scalar)"; break;
     }
     
     return optimizations;
@@ -363,6 +273,12 @@ std::vector<uint8_t> EncodeSIMDOptimized(const uint8_t* rgba_data, uint32_t widt
     return g_simd_encoder.EncodeSIMD(rgba_data, width, height, stride, params);
 }
 
+EncodeIntoResult EncodeSIMDOptimizedInto(const uint8_t* rgba_data, uint32_t width,
+                                         uint32_t height, uint32_t stride,
+                                         const WebPEncodeParams& params, EncodeSpan output) {
+    return g_simd_encoder.EncodeSIMDInto(rgba_data, width, height, stride, params, output);
+}
+
 std::string GetWebPSIMDOptimizations() {
     return WebPSIMDEncoder::GetOptimizations();
 }
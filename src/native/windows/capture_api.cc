@@ -9,6 +9,8 @@
 #include <winrt/Windows.Graphics.DirectX.h>
 #include <windows.graphics.capture.interop.h>
 #include <d3d11_4.h>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 #pragma comment(lib, "windowsapp")
@@ -29,8 +31,76 @@ struct CaptureAPI::Impl {
     bool initialized = false;
     UINT displayWidth = 0;
     UINT displayHeight = 0;
+
+    // Incremental capture state, kept across frames
+    winrt::com_ptr<ID3D11Texture2D> incrementalStaging;
+    std::vector<uint8_t> incrementalFrame;
+    std::vector<uint8_t> metadataBuffer;
+    uint32_t incrementalWidth = 0;
+    uint32_t incrementalHeight = 0;
+    LONGLONG lastPresentTime = 0;
+    bool incrementalValid = false;
+
+    // GPU YUV420 conversion and readback ring
+    ::WebPScreenshot::Windows::D3D11YUVConverter yuvConverter;
+
+    // Collect dirty rects plus move destinations; the acquired desktop image
+    // is already composed, so moved regions only need re-copying
+    bool ReadFrameRects(const DXGI_OUTDUPL_FRAME_INFO& frameInfo, std::vector<DirtyRect>& rects);
 };
 
+bool CaptureAPI::Impl::ReadFrameRects(const DXGI_OUTDUPL_FRAME_INFO& frameInfo,
+                                      std::vector<DirtyRect>& rects) {
+    rects.clear();
+    if (frameInfo.TotalMetadataBufferSize == 0) {
+        return true;
+    }
+
+    if (metadataBuffer.size() < frameInfo.TotalMetadataBufferSize) {
+        metadataBuffer.resize(frameInfo.TotalMetadataBufferSize);
+    }
+
+    auto addRect = [&](const RECT& r) {
+        const LONG left = std::max<LONG>(0, r.left);
+        const LONG top = std::max<LONG>(0, r.top);
+        const LONG right = std::min<LONG>(static_cast<LONG>(incrementalWidth), r.right);
+        const LONG bottom = std::min<LONG>(static_cast<LONG>(incrementalHeight), r.bottom);
+        if (right > left && bottom > top) {
+            rects.push_back({static_cast<uint32_t>(left), static_cast<uint32_t>(top),
+                             static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top)});
+        }
+    };
+
+    UINT required = 0;
+    HRESULT hr = duplication->GetFrameMoveRects(
+        static_cast<UINT>(metadataBuffer.size()),
+        reinterpret_cast<DXGI_OUTDUPL_MOVE_RECT*>(metadataBuffer.data()), &required);
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    const auto* moves = reinterpret_cast<const DXGI_OUTDUPL_MOVE_RECT*>(metadataBuffer.data());
+    const UINT moveCount = required / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+    for (UINT i = 0; i < moveCount; ++i) {
+        addRect(moves[i].DestinationRect);
+    }
+
+    hr = duplication->GetFrameDirtyRects(
+        static_cast<UINT>(metadataBuffer.size()),
+        reinterpret_cast<RECT*>(metadataBuffer.data()), &required);
+    if (FAILED(hr)) {
+        return false;
+    }
+
+    const auto* dirty = reinterpret_cast<const RECT*>(metadataBuffer.data());
+    const UINT dirtyCount = required / sizeof(RECT);
+    for (UINT i = 0; i < dirtyCount; ++i) {
+        addRect(dirty[i]);
+    }
+
+    return true;
+}
+
 CaptureAPI::CaptureAPI() : impl_(std::make_unique<Impl>()) {
     CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
     winrt::init_apartment();
@@ -226,6 +296,238 @@ bool CaptureAPI::CaptureFrame(uint8_t** data, uint32_t* width, uint32_t* height,
     }
 }
 
+bool CaptureAPI::CaptureFrameIncremental(const uint8_t** data, uint32_t* width, uint32_t* height,
+                                         uint32_t* stride, std::vector<DirtyRect>* dirtyRects,
+                                         bool* frameChanged, UINT timeoutMs) {
+    if (!impl_->duplication || !data || !width || !height || !stride || !frameChanged) {
+        return false;
+    }
+
+    *frameChanged = false;
+    if (dirtyRects) {
+        dirtyRects->clear();
+    }
+
+    auto reportFrame = [&]() {
+        *data = impl_->incrementalFrame.data();
+        *width = impl_->incrementalWidth;
+        *height = impl_->incrementalHeight;
+        *stride = impl_->incrementalWidth * 4;
+    };
+
+    try {
+        DXGI_OUTDUPL_FRAME_INFO frameInfo;
+        winrt::com_ptr<IDXGIResource> resource;
+
+        HRESULT hr = impl_->duplication->AcquireNextFrame(timeoutMs, &frameInfo, resource.put());
+        if (hr == DXGI_ERROR_WAIT_TIMEOUT) {
+            // Nothing presented; the previous frame is still current
+            if (!impl_->incrementalValid) {
+                return false;
+            }
+            reportFrame();
+            return true;
+        }
+        if (hr == DXGI_ERROR_ACCESS_LOST) {
+            // Mode change or secure desktop; the caller must SetupDuplication again
+            impl_->duplication = nullptr;
+            impl_->incrementalValid = false;
+            return false;
+        }
+        if (FAILED(hr)) {
+            std::cerr << "Failed to acquire next frame: " << std::hex << hr << std::endl;
+            return false;
+        }
+
+        // Cursor-only updates leave LastPresentTime at zero
+        if (frameInfo.LastPresentTime.QuadPart == 0 ||
+            (impl_->incrementalValid && frameInfo.LastPresentTime.QuadPart <= impl_->lastPresentTime)) {
+            impl_->duplication->ReleaseFrame();
+            if (!impl_->incrementalValid) {
+                return false;
+            }
+            reportFrame();
+            return true;
+        }
+
+        winrt::com_ptr<ID3D11Texture2D> texture;
+        hr = resource->QueryInterface(IID_PPV_ARGS(texture.put()));
+        if (FAILED(hr)) {
+            impl_->duplication->ReleaseFrame();
+            std::cerr << "Failed to get texture from resource: " << std::hex << hr << std::endl;
+            return false;
+        }
+
+        D3D11_TEXTURE2D_DESC textureDesc;
+        texture->GetDesc(&textureDesc);
+
+        // (Re)create the persistent staging texture and CPU frame on size change
+        if (!impl_->incrementalStaging || impl_->incrementalWidth != textureDesc.Width ||
+            impl_->incrementalHeight != textureDesc.Height) {
+            D3D11_TEXTURE2D_DESC stagingDesc = textureDesc;
+            stagingDesc.Usage = D3D11_USAGE_STAGING;
+            stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+            stagingDesc.BindFlags = 0;
+            stagingDesc.MiscFlags = 0;
+
+            impl_->incrementalStaging = nullptr;
+            hr = impl_->device->CreateTexture2D(&stagingDesc, nullptr, impl_->incrementalStaging.put());
+            if (FAILED(hr)) {
+                impl_->duplication->ReleaseFrame();
+                std::cerr << "Failed to create staging texture: " << std::hex << hr << std::endl;
+                return false;
+            }
+
+            impl_->incrementalWidth = textureDesc.Width;
+            impl_->incrementalHeight = textureDesc.Height;
+            impl_->incrementalFrame.assign(static_cast<size_t>(textureDesc.Width) * textureDesc.Height * 4, 0);
+            impl_->incrementalValid = false;
+        }
+
+        std::vector<DirtyRect> localRects;
+        std::vector<DirtyRect>& rects = dirtyRects ? *dirtyRects : localRects;
+        const bool fullCopy = !impl_->incrementalValid || !impl_->ReadFrameRects(frameInfo, rects);
+
+        if (fullCopy) {
+            rects.assign(1, DirtyRect{0, 0, impl_->incrementalWidth, impl_->incrementalHeight});
+            impl_->context->CopyResource(impl_->incrementalStaging.get(), texture.get());
+        } else {
+            for (const auto& rect : rects) {
+                D3D11_BOX box = {rect.x, rect.y, 0, rect.x + rect.width, rect.y + rect.height, 1};
+                impl_->context->CopySubresourceRegion(impl_->incrementalStaging.get(), 0,
+                                                      rect.x, rect.y, 0, texture.get(), 0, &box);
+            }
+        }
+
+        // The desktop texture must not be held longer than needed
+        impl_->duplication->ReleaseFrame();
+        texture = nullptr;
+        resource = nullptr;
+
+        if (!rects.empty()) {
+            D3D11_MAPPED_SUBRESOURCE mappedResource;
+            hr = impl_->context->Map(impl_->incrementalStaging.get(), 0, D3D11_MAP_READ, 0, &mappedResource);
+            if (FAILED(hr)) {
+                impl_->incrementalValid = false;
+                std::cerr << "Failed to map staging texture: " << std::hex << hr << std::endl;
+                return false;
+            }
+
+            const uint32_t frameStride = impl_->incrementalWidth * 4;
+            for (const auto& rect : rects) {
+                const uint8_t* src = static_cast<const uint8_t*>(mappedResource.pData) +
+                                     static_cast<size_t>(rect.y) * mappedResource.RowPitch + rect.x * 4;
+                uint8_t* dst = impl_->incrementalFrame.data() +
+                               static_cast<size_t>(rect.y) * frameStride + rect.x * 4;
+                for (uint32_t row = 0; row < rect.height; ++row) {
+                    memcpy(dst, src, rect.width * 4);
+                    src += mappedResource.RowPitch;
+                    dst += frameStride;
+                }
+            }
+
+            impl_->context->Unmap(impl_->incrementalStaging.get(), 0);
+        }
+
+        impl_->lastPresentTime = frameInfo.LastPresentTime.QuadPart;
+        impl_->incrementalValid = true;
+        *frameChanged = !rects.empty();
+        reportFrame();
+        return true;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in CaptureAPI::CaptureFrameIncremental: " << e.what() << std::endl;
+        return false;
+    } catch (...) {
+        std::cerr << "Unknown exception in CaptureAPI::CaptureFrameIncremental" << std::endl;
+        return false;
+    }
+}
+
+void CaptureAPI::InvalidateIncrementalFrame() {
+    impl_->incrementalValid = false;
+}
+
+bool CaptureAPI::CaptureFrameYUV420(float scale, YUV420Planes* planes, bool* planesReady,
+                                    UINT timeoutMs) {
+    if (!impl_->duplication || !planes || !planesReady) {
+        return false;
+    }
+
+    using Converter = ::WebPScreenshot::Windows::D3D11YUVConverter;
+    Converter& converter = impl_->yuvConverter;
+    *planesReady = false;
+
+    // The previous call's planes are released here
+    converter.Unmap();
+
+    if (!converter.Initialize(impl_->device.get())) {
+        std::cerr << "Failed to initialize YUV converter: " << converter.GetLastError() << std::endl;
+        return false;
+    }
+
+    try {
+        // With the ring full, skip acquiring and drain the oldest frame instead
+        if (converter.PendingCount() < Converter::kRingSize) {
+            DXGI_OUTDUPL_FRAME_INFO frameInfo;
+            winrt::com_ptr<IDXGIResource> resource;
+
+            HRESULT hr = impl_->duplication->AcquireNextFrame(timeoutMs, &frameInfo, resource.put());
+            if (hr == DXGI_ERROR_ACCESS_LOST) {
+                // Mode change or secure desktop; the caller must SetupDuplication again
+                impl_->duplication = nullptr;
+                converter.Reset();
+                return false;
+            }
+            if (FAILED(hr) && hr != DXGI_ERROR_WAIT_TIMEOUT) {
+                std::cerr << "Failed to acquire next frame: " << std::hex << hr << std::endl;
+                return false;
+            }
+
+            if (SUCCEEDED(hr)) {
+                bool submitted = true;
+
+                // Cursor-only updates leave LastPresentTime at zero
+                if (frameInfo.LastPresentTime.QuadPart != 0) {
+                    winrt::com_ptr<ID3D11Texture2D> texture;
+                    hr = resource->QueryInterface(IID_PPV_ARGS(texture.put()));
+                    submitted = SUCCEEDED(hr) && converter.Submit(texture.get(), scale);
+                }
+
+                // The conversion is queued on the GPU, so the desktop image can go back now
+                impl_->duplication->ReleaseFrame();
+
+                if (!submitted) {
+                    std::cerr << "Failed to convert desktop frame: " << converter.GetLastError() << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        if (converter.PendingCount() == 0) {
+            return true;
+        }
+
+        // Only block when the ring is full; otherwise unfinished frames stay in flight
+        const bool wait = converter.PendingCount() == Converter::kRingSize;
+        if (converter.MapOldest(*planes, wait)) {
+            *planesReady = true;
+        } else if (!converter.GetLastError().empty()) {
+            std::cerr << "Failed to read back YUV planes: " << converter.GetLastError() << std::endl;
+            return false;
+        }
+
+        return true;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in CaptureAPI::CaptureFrameYUV420: " << e.what() << std::endl;
+        return false;
+    } catch (...) {
+        std::cerr << "Unknown exception in CaptureAPI::CaptureFrameYUV420" << std::endl;
+        return false;
+    }
+}
+
 bool CaptureAPI::IsModernCaptureAvailable() {
     try {
         return winrt::Windows::Graphics::Capture::GraphicsCaptureSession::IsSupported();
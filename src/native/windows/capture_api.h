@@ -1,12 +1,20 @@
 #pragma once
 
+#include "../common/screenshot_common.h"
+#include "gpu_yuv_converter.h"
 #include <windows.h>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace ScreenshotWebP {
 namespace Windows {
 
+using YUV420Planes = ::WebPScreenshot::Windows::YUV420Planes;
+
+// Region of the desktop that changed since the previous incremental frame
+using DirtyRect = ::WebPScreenshot::DirtyRect;
+
 struct DisplayInfo {
     int index;
     int x, y;
@@ -32,6 +40,26 @@ public:
     // Free frame data allocated by CaptureFrame
     void FreeFrameData(uint8_t* data);
 
+    // Incremental capture: only the dirty and moved regions reported by DXGI are
+    // copied into a persistent BGRA frame owned by this object. *data stays valid
+    // until the next call. *frameChanged is false when no new image was presented
+    // (timeout or cursor-only update), in which case encoding can be skipped.
+    bool CaptureFrameIncremental(const uint8_t** data, uint32_t* width, uint32_t* height,
+                                 uint32_t* stride, std::vector<DirtyRect>* dirtyRects,
+                                 bool* frameChanged, UINT timeoutMs = 0);
+
+    // Force the next incremental capture to copy the whole desktop
+    void InvalidateIncrementalFrame();
+
+    // GPU capture: the desktop texture is converted to YUV420 (optionally
+    // downscaled, scale 0.125 to 1) by a compute shader and only the planes
+    // are read back. Frames are pipelined through a staging ring, so the
+    // planes returned may trail the newest desktop image by up to two frames;
+    // *planesReady is false while nothing has finished yet. The planes stay
+    // valid until the next call.
+    bool CaptureFrameYUV420(float scale, YUV420Planes* planes, bool* planesReady,
+                            UINT timeoutMs = 0);
+
     // Check if modern Windows.Graphics.Capture is available
     static bool IsModernCaptureAvailable();
 
@@ -0,0 +1,512 @@
+#ifdef _WIN32
+
+#include "gpu_yuv_converter.h"
+#include "../common/performance_stats.h"
+#include <d3dcompiler.h>
+#include <winrt/base.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "d3dcompiler.lib")
+
+namespace WebPScreenshot {
+namespace Windows {
+
+namespace {
+
+// One thread per 2x2 block: four box-filtered source pixels become four Y
+// samples and one U/V pair. The integer math mirrors VP8RGBToY/U/V (and so
+// SIMD::ConvertToYUV420), so a full-scale conversion matches the CPU path.
+// Odd output edges repeat the last pixel, as the CPU converter does.
+const char kYUV420Shader[] = R"(
+Texture2D<float4> Source : register(t0);
+RWTexture2D<uint> Planes : register(u0);
+
+cbuffer Constants : register(b0)
+{
+    uint2 SourceSize;
+    uint2 OutputSize;
+    uint2 ChromaSize;
+    float2 InvScale;
+}
+
+int3 FetchRGB(uint2 pos)
+{
+    uint2 first = min((uint2)(pos * InvScale), SourceSize - 1);
+    uint2 last = max(first + 1, min((uint2)((pos + 1) * InvScale), SourceSize));
+
+    float3 sum = 0;
+    [loop] for (uint y = first.y; y < last.y; ++y) {
+        [loop] for (uint x = first.x; x < last.x; ++x) {
+            sum += Source.Load(int3(x, y, 0)).rgb;
+        }
+    }
+
+    float count = (float)((last.x - first.x) * (last.y - first.y));
+    return (int3)(sum * (255.0f / count) + 0.5f);
+}
+
+uint RGBToY(int3 c)
+{
+    return (uint)((16839 * c.r + 33059 * c.g + 6420 * c.b + 1081344) >> 16);
+}
+
+uint ClipUV(int uv)
+{
+    return (uint)clamp((uv + 33685504) >> 18, 0, 255);
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= ChromaSize.x || id.y >= ChromaSize.y)
+        return;
+
+    uint2 p00 = id.xy * 2;
+    uint2 p11 = min(p00 + 1, OutputSize - 1);
+    uint2 p01 = uint2(p11.x, p00.y);
+    uint2 p10 = uint2(p00.x, p11.y);
+
+    int3 c00 = FetchRGB(p00);
+    int3 c01 = FetchRGB(p01);
+    int3 c10 = FetchRGB(p10);
+    int3 c11 = FetchRGB(p11);
+
+    Planes[p00] = RGBToY(c00);
+    Planes[p01] = RGBToY(c01);
+    Planes[p10] = RGBToY(c10);
+    Planes[p11] = RGBToY(c11);
+
+    int3 sum = c00 + c01 + c10 + c11;
+    uint2 chroma = uint2(id.x, OutputSize.y + id.y);
+    Planes[chroma] = ClipUV(-9719 * sum.r - 19081 * sum.g + 28800 * sum.b);
+    Planes[chroma + uint2(ChromaSize.x, 0)] = ClipUV(28800 * sum.r - 24116 * sum.g - 4684 * sum.b);
+}
+)";
+
+constexpr uint32_t kThreadGroupSize = 8;
+
+// Layout must match the HLSL cbuffer (32 bytes, two registers)
+struct ShaderConstants {
+    uint32_t source_width;
+    uint32_t source_height;
+    uint32_t output_width;
+    uint32_t output_height;
+    uint32_t chroma_width;
+    uint32_t chroma_height;
+    float inv_scale_x;
+    float inv_scale_y;
+};
+
+static_assert(sizeof(ShaderConstants) % 16 == 0, "Constant buffers are sized in 16-byte registers");
+
+// 8-bit UNORM colour formats; Load returns logical RGBA for either byte order
+bool IsSupportedSourceFormat(DXGI_FORMAT format) {
+    return format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8X8_UNORM ||
+           format == DXGI_FORMAT_R8G8B8A8_UNORM;
+}
+
+struct CompiledShader {
+    std::vector<uint8_t> bytecode;  // Empty when compilation failed
+    std::string error;
+};
+
+// D3DCompile takes tens of milliseconds. Bytecode does not depend on the
+// device, so the shader is compiled once per process and every converter
+// (one per capture stream and encoder) creates its shader from the copy.
+const CompiledShader& GetYUV420Shader() {
+    static const CompiledShader shader = [] {
+        CompiledShader compiled;
+        winrt::com_ptr<ID3DBlob> shader_blob;
+        winrt::com_ptr<ID3DBlob> error_blob;
+        HRESULT hr = D3DCompile(kYUV420Shader, sizeof(kYUV420Shader) - 1, "yuv420_cs", nullptr, nullptr,
+                                "main", "cs_5_0", D3DCOMPILE_OPTIMIZATION_LEVEL3, 0,
+                                shader_blob.put(), error_blob.put());
+        if (FAILED(hr)) {
+            compiled.error = "Failed to compile YUV420 shader";
+            if (error_blob) {
+                compiled.error += ": ";
+                compiled.error.append(static_cast<const char*>(error_blob->GetBufferPointer()),
+                                      error_blob->GetBufferSize());
+            }
+            return compiled;
+        }
+
+        const auto* bytes = static_cast<const uint8_t*>(shader_blob->GetBufferPointer());
+        compiled.bytecode.assign(bytes, bytes + shader_blob->GetBufferSize());
+        return compiled;
+    }();
+    return shader;
+}
+
+} // anonymous namespace
+
+bool PrecompileYUV420Shader(std::string& error) {
+    const CompiledShader& compiled = GetYUV420Shader();
+    error = compiled.error;
+    return !compiled.bytecode.empty();
+}
+
+struct D3D11YUVConverter::Impl {
+    struct Slot {
+        winrt::com_ptr<ID3D11Texture2D> staging;
+        uint32_t texture_width = 0;
+        uint32_t texture_height = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint64_t sequence = 0;
+    };
+
+    winrt::com_ptr<ID3D11Device> device;
+    winrt::com_ptr<ID3D11DeviceContext> context;
+    winrt::com_ptr<ID3D11ComputeShader> shader;
+    winrt::com_ptr<ID3D11Buffer> constants;
+
+    // GPU-side plane texture for the current output size (R8_UINT)
+    winrt::com_ptr<ID3D11Texture2D> planes;
+    winrt::com_ptr<ID3D11UnorderedAccessView> planes_uav;
+    uint32_t planes_width = 0;
+    uint32_t planes_height = 0;
+
+    // The desktop texture is usually the same object every frame, so its view is cached
+    winrt::com_ptr<ID3D11Texture2D> source;
+    winrt::com_ptr<ID3D11ShaderResourceView> source_srv;
+
+    // Copy target for sources created without D3D11_BIND_SHADER_RESOURCE
+    winrt::com_ptr<ID3D11Texture2D> shader_copy;
+
+    Slot slots[kRingSize];
+    uint32_t head = 0;     // Oldest pending slot
+    uint32_t pending = 0;
+    bool mapped = false;
+    uint64_t sequence = 0;
+
+    bool EnsurePlanes(uint32_t texture_width, uint32_t texture_height, std::string& error);
+    ID3D11ShaderResourceView* GetSourceView(ID3D11Texture2D* texture, const D3D11_TEXTURE2D_DESC& desc,
+                                            std::string& error);
+};
+
+bool D3D11YUVConverter::Impl::EnsurePlanes(uint32_t texture_width, uint32_t texture_height,
+                                           std::string& error) {
+    if (planes && planes_width == texture_width && planes_height == texture_height) {
+        return true;
+    }
+
+    planes_uav = nullptr;
+    planes = nullptr;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = texture_width;
+    desc.Height = texture_height;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8_UINT;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+
+    if (FAILED(device->CreateTexture2D(&desc, nullptr, planes.put())) ||
+        FAILED(device->CreateUnorderedAccessView(planes.get(), nullptr, planes_uav.put()))) {
+        planes = nullptr;
+        error = "Failed to create YUV plane texture";
+        return false;
+    }
+
+    planes_width = texture_width;
+    planes_height = texture_height;
+    return true;
+}
+
+ID3D11ShaderResourceView* D3D11YUVConverter::Impl::GetSourceView(ID3D11Texture2D* texture,
+                                                                 const D3D11_TEXTURE2D_DESC& desc,
+                                                                 std::string& error) {
+    ID3D11Texture2D* view_texture = texture;
+
+    if (!(desc.BindFlags & D3D11_BIND_SHADER_RESOURCE) || desc.SampleDesc.Count != 1) {
+        // GPU-to-GPU copy into a bindable texture; still no CPU readback
+        D3D11_TEXTURE2D_DESC copy_desc = {};
+        if (shader_copy) {
+            shader_copy->GetDesc(&copy_desc);
+        }
+        if (!shader_copy || copy_desc.Width != desc.Width || copy_desc.Height != desc.Height ||
+            copy_desc.Format != desc.Format) {
+            copy_desc = {};
+            copy_desc.Width = desc.Width;
+            copy_desc.Height = desc.Height;
+            copy_desc.MipLevels = 1;
+            copy_desc.ArraySize = 1;
+            copy_desc.Format = desc.Format;
+            copy_desc.SampleDesc.Count = 1;
+            copy_desc.Usage = D3D11_USAGE_DEFAULT;
+            copy_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+            shader_copy = nullptr;
+            if (FAILED(device->CreateTexture2D(&copy_desc, nullptr, shader_copy.put()))) {
+                error = "Failed to create shader copy of source texture";
+                return nullptr;
+            }
+            source = nullptr;
+        }
+
+        if (desc.SampleDesc.Count != 1) {
+            context->ResolveSubresource(shader_copy.get(), 0, texture, 0, desc.Format);
+        } else {
+            context->CopySubresourceRegion(shader_copy.get(), 0, 0, 0, 0, texture, 0, nullptr);
+        }
+        view_texture = shader_copy.get();
+    }
+
+    if (source.get() == view_texture && source_srv) {
+        return source_srv.get();
+    }
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+    srv_desc.Format = desc.Format;
+    srv_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    srv_desc.Texture2D.MostDetailedMip = 0;
+    srv_desc.Texture2D.MipLevels = 1;
+
+    source_srv = nullptr;
+    source = nullptr;
+    if (FAILED(device->CreateShaderResourceView(view_texture, &srv_desc, source_srv.put()))) {
+        error = "Failed to create source shader resource view";
+        return nullptr;
+    }
+
+    source.copy_from(view_texture);
+    return source_srv.get();
+}
+
+D3D11YUVConverter::D3D11YUVConverter() : impl_(std::make_unique<Impl>()) {}
+
+D3D11YUVConverter::~D3D11YUVConverter() {
+    Reset();
+}
+
+bool D3D11YUVConverter::Initialize(ID3D11Device* device) {
+    last_error_.clear();
+
+    if (!device) {
+        last_error_ = "No D3D11 device";
+        return false;
+    }
+
+    if (impl_->device.get() == device && impl_->shader) {
+        return true;
+    }
+
+    Reset();
+    *impl_ = Impl();
+
+    if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0) {
+        last_error_ = "Compute shaders require feature level 11_0";
+        return false;
+    }
+
+    const CompiledShader& compiled = GetYUV420Shader();
+    if (compiled.bytecode.empty()) {
+        last_error_ = compiled.error;
+        return false;
+    }
+
+    HRESULT hr = device->CreateComputeShader(compiled.bytecode.data(), compiled.bytecode.size(),
+                                             nullptr, impl_->shader.put());
+    if (FAILED(hr)) {
+        last_error_ = "Failed to create YUV420 compute shader";
+        return false;
+    }
+
+    D3D11_BUFFER_DESC buffer_desc = {};
+    buffer_desc.ByteWidth = sizeof(ShaderConstants);
+    buffer_desc.Usage = D3D11_USAGE_DEFAULT;
+    buffer_desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+
+    hr = device->CreateBuffer(&buffer_desc, nullptr, impl_->constants.put());
+    if (FAILED(hr)) {
+        impl_->shader = nullptr;
+        last_error_ = "Failed to create constant buffer";
+        return false;
+    }
+
+    impl_->device.copy_from(device);
+    device->GetImmediateContext(impl_->context.put());
+    return true;
+}
+
+bool D3D11YUVConverter::IsInitialized() const {
+    return impl_->shader != nullptr;
+}
+
+bool D3D11YUVConverter::Submit(ID3D11Texture2D* source, float scale) {
+    last_error_.clear();
+
+    if (!impl_->shader) {
+        last_error_ = "Converter not initialized";
+        return false;
+    }
+    if (!source) {
+        last_error_ = "Source texture is null";
+        return false;
+    }
+    if (!(scale >= kMinScale && scale <= 1.0f)) {
+        last_error_ = "Scale must be between 0.125 and 1";
+        return false;
+    }
+    if (impl_->pending == kRingSize) {
+        last_error_ = "Readback ring is full";
+        return false;
+    }
+
+    D3D11_TEXTURE2D_DESC desc;
+    source->GetDesc(&desc);
+    if (!IsSupportedSourceFormat(desc.Format)) {
+        last_error_ = "Unsupported source texture format";
+        return false;
+    }
+
+    const uint32_t width = std::max(1u, static_cast<uint32_t>(std::lround(desc.Width * scale)));
+    const uint32_t height = std::max(1u, static_cast<uint32_t>(std::lround(desc.Height * scale)));
+    const uint32_t chroma_width = (width + 1) / 2;
+    const uint32_t chroma_height = (height + 1) / 2;
+
+    // Y rows on top, then one row of U and V side by side per chroma row
+    const uint32_t texture_width = chroma_width * 2;
+    const uint32_t texture_height = height + chroma_height;
+    if (!impl_->EnsurePlanes(texture_width, texture_height, last_error_)) {
+        return false;
+    }
+
+    ID3D11ShaderResourceView* srv = impl_->GetSourceView(source, desc, last_error_);
+    if (!srv) {
+        return false;
+    }
+
+    Impl::Slot& slot = impl_->slots[(impl_->head + impl_->pending) % kRingSize];
+    if (!slot.staging || slot.texture_width != texture_width || slot.texture_height != texture_height) {
+        D3D11_TEXTURE2D_DESC staging_desc = {};
+        staging_desc.Width = texture_width;
+        staging_desc.Height = texture_height;
+        staging_desc.MipLevels = 1;
+        staging_desc.ArraySize = 1;
+        staging_desc.Format = DXGI_FORMAT_R8_UINT;
+        staging_desc.SampleDesc.Count = 1;
+        staging_desc.Usage = D3D11_USAGE_STAGING;
+        staging_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+        slot.staging = nullptr;
+        if (FAILED(impl_->device->CreateTexture2D(&staging_desc, nullptr, slot.staging.put()))) {
+            last_error_ = "Failed to create staging texture";
+            return false;
+        }
+        slot.texture_width = texture_width;
+        slot.texture_height = texture_height;
+    }
+
+    const ShaderConstants constants = {
+        desc.Width, desc.Height, width, height, chroma_width, chroma_height,
+        static_cast<float>(desc.Width) / width, static_cast<float>(desc.Height) / height
+    };
+
+    ID3D11DeviceContext* context = impl_->context.get();
+    context->UpdateSubresource(impl_->constants.get(), 0, nullptr, &constants, 0, 0);
+
+    ID3D11Buffer* constant_buffers[] = { impl_->constants.get() };
+    ID3D11UnorderedAccessView* uavs[] = { impl_->planes_uav.get() };
+    context->CSSetShader(impl_->shader.get(), nullptr, 0);
+    context->CSSetConstantBuffers(0, 1, constant_buffers);
+    context->CSSetShaderResources(0, 1, &srv);
+    context->CSSetUnorderedAccessViews(0, 1, uavs, nullptr);
+
+    context->Dispatch((chroma_width + kThreadGroupSize - 1) / kThreadGroupSize,
+                      (chroma_height + kThreadGroupSize - 1) / kThreadGroupSize, 1);
+
+    // Unbind so the desktop texture and planes are free for other passes
+    ID3D11ShaderResourceView* null_srv[] = { nullptr };
+    ID3D11UnorderedAccessView* null_uav[] = { nullptr };
+    context->CSSetShaderResources(0, 1, null_srv);
+    context->CSSetUnorderedAccessViews(0, 1, null_uav, nullptr);
+    context->CSSetShader(nullptr, nullptr, 0);
+
+    context->CopyResource(slot.staging.get(), impl_->planes.get());
+
+    // Start the GPU now; the Map for this slot comes a frame or more later
+    context->Flush();
+
+    slot.width = width;
+    slot.height = height;
+    slot.sequence = ++impl_->sequence;
+    ++impl_->pending;
+    return true;
+}
+
+bool D3D11YUVConverter::MapOldest(YUV420Planes& planes, bool wait) {
+    last_error_.clear();
+
+    if (impl_->mapped) {
+        last_error_ = "A frame is already mapped";
+        return false;
+    }
+    if (impl_->pending == 0) {
+        last_error_ = "No frame submitted";
+        return false;
+    }
+
+    Impl::Slot& slot = impl_->slots[impl_->head];
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    Stats::ScopedStageTimer readback_timer(Stats::Stage::Readback);
+    const HRESULT hr = impl_->context->Map(slot.staging.get(), 0, D3D11_MAP_READ,
+                                           wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (hr == DXGI_ERROR_WAS_STILL_DRAWING) {
+        readback_timer.Cancel();
+        return false;
+    }
+    if (FAILED(hr)) {
+        readback_timer.Cancel();
+        last_error_ = "Failed to map staging texture";
+        return false;
+    }
+
+    const uint8_t* base = static_cast<const uint8_t*>(mapped.pData);
+    const size_t chroma_offset = static_cast<size_t>(slot.height) * mapped.RowPitch;
+
+    planes.y = base;
+    planes.u = base + chroma_offset;
+    planes.v = base + chroma_offset + slot.texture_width / 2;
+    planes.y_stride = static_cast<int>(mapped.RowPitch);
+    planes.uv_stride = static_cast<int>(mapped.RowPitch);
+    planes.width = slot.width;
+    planes.height = slot.height;
+    planes.sequence = slot.sequence;
+
+    impl_->mapped = true;
+    return true;
+}
+
+void D3D11YUVConverter::Unmap() {
+    if (!impl_->mapped) {
+        return;
+    }
+
+    impl_->context->Unmap(impl_->slots[impl_->head].staging.get(), 0);
+    impl_->head = (impl_->head + 1) % kRingSize;
+    --impl_->pending;
+    impl_->mapped = false;
+}
+
+uint32_t D3D11YUVConverter::PendingCount() const {
+    return impl_->pending;
+}
+
+void D3D11YUVConverter::Reset() {
+    Unmap();
+    impl_->head = 0;
+    impl_->pending = 0;
+}
+
+} // namespace Windows
+} // namespace WebPScreenshot
+
+#endif // _WIN32
@@ -0,0 +1,78 @@
+#pragma once
+
+#ifdef _WIN32
+
+#include <d3d11.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace WebPScreenshot {
+namespace Windows {
+
+// YUV420 planes (BT.601 limited range, same coefficients as the CPU converter)
+// inside one mapped staging texture. Y fills the first `height` rows; U and V
+// sit side by side in the rows below it, so all three share one stride.
+struct YUV420Planes {
+    const uint8_t* y = nullptr;
+    const uint8_t* u = nullptr;
+    const uint8_t* v = nullptr;
+    int y_stride = 0;
+    int uv_stride = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t sequence = 0;  // Submit order, starting at 1
+};
+
+// Compile the YUV420 compute shader now instead of in the first Initialize.
+// Happens once per process; every converter reuses the bytecode.
+bool PrecompileYUV420Shader(std::string& error);
+
+// GPU pre-encode stage: a compute shader converts a BGRA/RGBA texture to
+// YUV420 with an optional box-filtered downscale, and only the planes are
+// copied back (37.5% of the BGRA bytes at full scale). Readback goes through
+// a ring of staging textures, so a caller that maps a frame behind the one it
+// just submitted never stalls in Map. Not thread-safe; use from one thread.
+class D3D11YUVConverter {
+public:
+    static constexpr uint32_t kRingSize = 3;
+    static constexpr float kMinScale = 1.0f / 8.0f;
+
+    D3D11YUVConverter();
+    ~D3D11YUVConverter();
+
+    // Creates the shader on `device` from the process-wide bytecode, compiling
+    // it on first use; the converter keeps a reference to the device
+    bool Initialize(ID3D11Device* device);
+    bool IsInitialized() const;
+
+    // Queue conversion of `source` at `scale` (kMinScale to 1). Fails when
+    // every ring slot is still waiting to be mapped. The source texture may
+    // be released or reused (e.g. ReleaseFrame) as soon as this returns.
+    bool Submit(ID3D11Texture2D* source, float scale = 1.0f);
+
+    // Map the oldest submitted frame. With wait = false this returns false
+    // without blocking, and with GetLastError empty, if the GPU is not done.
+    bool MapOldest(YUV420Planes& planes, bool wait = true);
+
+    // Unmap the frame returned by MapOldest and return its slot to the ring
+    void Unmap();
+
+    // Frames submitted but not yet unmapped
+    uint32_t PendingCount() const;
+
+    // Drop all queued frames, e.g. after a mode change
+    void Reset();
+
+    const std::string& GetLastError() const { return last_error_; }
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+    std::string last_error_;
+};
+
+} // namespace Windows
+} // namespace WebPScreenshot
+
+#endif // _WIN32
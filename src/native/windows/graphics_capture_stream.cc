@@ -0,0 +1,504 @@
+#ifdef _WIN32
+
+#include "screenshot.h"
+#include "gpu_yuv_converter.h"
+#include <d3d11.h>
+#include <dxgi1_2.h>
+#include <winrt/base.h>
+#include <winrt/Windows.Foundation.h>
+#include <winrt/Windows.Graphics.Capture.h>
+#include <winrt/Windows.Graphics.DirectX.h>
+#include <winrt/Windows.Graphics.DirectX.Direct3D11.h>
+#include <windows.graphics.capture.interop.h>
+#include <windows.graphics.directx.direct3d11.interop.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+
+#pragma comment(lib, "d3d11.lib")
+#pragma comment(lib, "windowsapp")
+
+namespace WebPScreenshot {
+namespace Windows {
+
+namespace wgc = winrt::Windows::Graphics::Capture;
+namespace wgdx = winrt::Windows::Graphics::DirectX;
+namespace wgd3d = winrt::Windows::Graphics::DirectX::Direct3D11;
+
+namespace {
+
+constexpr uint32_t kMaxPoolSize = 8;
+
+wgdx::DirectXPixelFormat ToWinRTFormat(GraphicsCaptureConfig::PixelFormat format) {
+    return format == GraphicsCaptureConfig::PixelFormat::RGBA16F
+        ? wgdx::DirectXPixelFormat::R16G16B16A16Float
+        : wgdx::DirectXPixelFormat::B8G8R8A8UIntNormalized;
+}
+
+// scRGB half float (1.0 = SDR white) -> sRGB 8-bit, indexed by the raw half
+// bits. HDR highlights above SDR white and negative values are clamped.
+const uint8_t* HalfToSRGB8Table() {
+    static const std::vector<uint8_t> table = [] {
+        std::vector<uint8_t> values(65536);
+        for (uint32_t bits = 0; bits < 65536; ++bits) {
+            const uint32_t exponent = (bits >> 10) & 0x1F;
+            const uint32_t mantissa = bits & 0x3FF;
+
+            float linear;
+            if (exponent == 0) {
+                linear = std::ldexp(static_cast<float>(mantissa), -24);
+            } else if (exponent == 31) {
+                linear = mantissa ? 0.0f : 1.0f;  // NaN -> black, +/-inf -> white (sign below)
+            } else {
+                linear = std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+            }
+            if (bits & 0x8000) {
+                linear = 0.0f;
+            }
+
+            linear = std::min(1.0f, std::max(0.0f, linear));
+            const float encoded = linear <= 0.0031308f
+                ? linear * 12.92f
+                : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+            values[bits] = static_cast<uint8_t>(std::lround(encoded * 255.0f));
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+// WGC captures are opaque, so alpha is forced to 255
+void ConvertHalfRowToRGBA(const uint8_t* src, uint8_t* dst, uint32_t width) {
+    const uint8_t* table = HalfToSRGB8Table();
+    const uint16_t* half = reinterpret_cast<const uint16_t*>(src);
+    for (uint32_t x = 0; x < width; ++x) {
+        dst[0] = table[half[0]];
+        dst[1] = table[half[1]];
+        dst[2] = table[half[2]];
+        dst[3] = 0xFF;
+        half += 4;
+        dst += 4;
+    }
+}
+
+} // anonymous namespace
+
+struct GraphicsCaptureStream::Impl : std::enable_shared_from_this<GraphicsCaptureStream::Impl> {
+    GraphicsCaptureConfig config;
+
+    winrt::com_ptr<ID3D11Device> device;
+    winrt::com_ptr<ID3D11DeviceContext> context;
+    wgd3d::IDirect3DDevice winrt_device{nullptr};
+
+    wgc::GraphicsCaptureItem item{nullptr};
+    wgc::Direct3D11CaptureFramePool frame_pool{nullptr};
+    wgc::GraphicsCaptureSession session{nullptr};
+    winrt::event_token frame_token{};
+    winrt::event_token closed_token{};
+    winrt::Windows::Graphics::SizeInt32 pool_size{0, 0};
+
+    // Guards the immediate context, which FrameArrived uses from pool threads,
+    // and everything below
+    std::mutex mutex;
+    std::condition_variable frame_condition;
+    winrt::com_ptr<ID3D11Texture2D> latest;   // GPU copy of the newest frame
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t sequence = 0;
+    uint64_t read_sequence = 0;
+
+    winrt::com_ptr<ID3D11Texture2D> staging;
+    uint32_t staging_width = 0;
+    uint32_t staging_height = 0;
+    D3D11YUVConverter converter;
+
+    // Serializes EncodeFrame, which keeps a converter slot mapped without `mutex`
+    std::mutex encode_mutex;
+
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> frames_arrived{0};
+
+    explicit Impl(const GraphicsCaptureConfig& cfg) : config(cfg) {
+        config.pool_size = std::min(kMaxPoolSize, std::max(1u, config.pool_size));
+    }
+
+    bool CreateDevice(std::string& error);
+    bool Start(wgc::GraphicsCaptureItem capture_item, std::string& error);
+    void Stop();
+    void OnFrameArrived();
+    bool WaitForFirstFrame(std::unique_lock<std::mutex>& lock, uint32_t timeout_ms, std::string& error);
+};
+
+bool GraphicsCaptureStream::Impl::CreateDevice(std::string& error) {
+    D3D_FEATURE_LEVEL feature_levels[] = {
+        D3D_FEATURE_LEVEL_11_1,
+        D3D_FEATURE_LEVEL_11_0
+    };
+
+    HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr,
+                                   D3D11_CREATE_DEVICE_BGRA_SUPPORT, feature_levels,
+                                   ARRAYSIZE(feature_levels), D3D11_SDK_VERSION,
+                                   device.put(), nullptr, context.put());
+    if (FAILED(hr)) {
+        error = "Failed to create D3D11 device";
+        return false;
+    }
+
+    auto dxgi_device = device.as<IDXGIDevice>();
+    winrt::com_ptr<IInspectable> inspectable;
+    hr = CreateDirect3D11DeviceFromDXGIDevice(dxgi_device.get(), inspectable.put());
+    if (FAILED(hr)) {
+        error = "Failed to create Direct3D11 device from DXGI";
+        return false;
+    }
+
+    winrt_device = inspectable.as<wgd3d::IDirect3DDevice>();
+    return true;
+}
+
+bool GraphicsCaptureStream::Impl::Start(wgc::GraphicsCaptureItem capture_item, std::string& error) {
+    if (!CreateDevice(error)) {
+        return false;
+    }
+
+    item = capture_item;
+    pool_size = item.Size();
+
+    // Free-threaded: FrameArrived runs on a pool thread, no dispatcher queue needed
+    frame_pool = wgc::Direct3D11CaptureFramePool::CreateFreeThreaded(
+        winrt_device, ToWinRTFormat(config.pixel_format),
+        static_cast<int32_t>(config.pool_size), pool_size);
+    session = frame_pool.CreateCaptureSession(item);
+
+    // Both properties need newer Windows builds than WGC itself
+    try {
+        session.IsCursorCaptureEnabled(config.capture_cursor);
+    } catch (const winrt::hresult_error&) {}
+    try {
+        session.IsBorderRequired(config.border_required);
+    } catch (const winrt::hresult_error&) {}
+
+    // The handler holds only a weak reference so a late callback cannot
+    // touch a destroyed stream
+    std::weak_ptr<Impl> weak = weak_from_this();
+    frame_token = frame_pool.FrameArrived([weak](auto&&, auto&&) {
+        if (auto self = weak.lock()) {
+            try {
+                self->OnFrameArrived();
+            } catch (...) {
+                self->running = false;
+                { std::lock_guard<std::mutex> lock(self->mutex); }
+                self->frame_condition.notify_all();
+            }
+        }
+    });
+    closed_token = item.Closed([weak](auto&&, auto&&) {
+        if (auto self = weak.lock()) {
+            // Window destroyed or display removed
+            self->running = false;
+            { std::lock_guard<std::mutex> lock(self->mutex); }
+            self->frame_condition.notify_all();
+        }
+    });
+
+    running = true;
+    session.StartCapture();
+    return true;
+}
+
+void GraphicsCaptureStream::Impl::Stop() {
+    running = false;
+
+    if (frame_pool) {
+        frame_pool.FrameArrived(frame_token);
+    }
+    if (item) {
+        item.Closed(closed_token);
+    }
+    if (session) {
+        session.Close();
+        session = nullptr;
+    }
+    if (frame_pool) {
+        frame_pool.Close();
+        frame_pool = nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    converter.Reset();
+    frame_condition.notify_all();
+}
+
+void GraphicsCaptureStream::Impl::OnFrameArrived() {
+    auto frame = frame_pool.TryGetNextFrame();
+    if (!frame) {
+        return;
+    }
+
+    const auto content_size = frame.ContentSize();
+
+    winrt::com_ptr<ID3D11Texture2D> texture;
+    auto access = frame.Surface().as<::Windows::Graphics::DirectX::Direct3D11::IDirect3DDxgiInterfaceAccess>();
+    winrt::check_hresult(access->GetInterface(winrt::guid_of<ID3D11Texture2D>(), texture.put_void()));
+
+    D3D11_TEXTURE2D_DESC surface_desc;
+    texture->GetDesc(&surface_desc);
+
+    // The pool surface can be larger than the content after a resize
+    const uint32_t frame_width = std::min<uint32_t>(surface_desc.Width, std::max(1, content_size.Width));
+    const uint32_t frame_height = std::min<uint32_t>(surface_desc.Height, std::max(1, content_size.Height));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!latest || width != frame_width || height != frame_height) {
+            D3D11_TEXTURE2D_DESC desc = {};
+            desc.Width = frame_width;
+            desc.Height = frame_height;
+            desc.MipLevels = 1;
+            desc.ArraySize = 1;
+            desc.Format = surface_desc.Format;
+            desc.SampleDesc.Count = 1;
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+            latest = nullptr;
+            winrt::check_hresult(device->CreateTexture2D(&desc, nullptr, latest.put()));
+            width = frame_width;
+            height = frame_height;
+        }
+
+        D3D11_BOX box = {0, 0, 0, frame_width, frame_height, 1};
+        context->CopySubresourceRegion(latest.get(), 0, 0, 0, 0, texture.get(), 0, &box);
+        context->Flush();
+        ++sequence;
+    }
+
+    // Hand the pool buffer back right away
+    texture = nullptr;
+    frame.Close();
+    frames_arrived.fetch_add(1, std::memory_order_relaxed);
+    frame_condition.notify_all();
+
+    // Window resized or display mode changed; later frames use the new size
+    if (content_size.Width != pool_size.Width || content_size.Height != pool_size.Height) {
+        pool_size = content_size;
+        frame_pool.Recreate(winrt_device, ToWinRTFormat(config.pixel_format),
+                            static_cast<int32_t>(config.pool_size), pool_size);
+    }
+}
+
+bool GraphicsCaptureStream::Impl::WaitForFirstFrame(std::unique_lock<std::mutex>& lock,
+                                                    uint32_t timeout_ms, std::string& error) {
+    frame_condition.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] {
+        return latest != nullptr || !running.load();
+    });
+
+    if (!latest) {
+        error = running.load() ? "Capture timeout" : "Capture stream stopped";
+        return false;
+    }
+    return true;
+}
+
+GraphicsCaptureStream::GraphicsCaptureStream(const GraphicsCaptureConfig& config)
+    : impl_(std::make_shared<Impl>(config)) {}
+
+GraphicsCaptureStream::~GraphicsCaptureStream() {
+    impl_->Stop();
+}
+
+bool GraphicsCaptureStream::StartForMonitor(void* monitor_handle, std::string& error) {
+    try {
+        auto interop = winrt::get_activation_factory<wgc::GraphicsCaptureItem, IGraphicsCaptureItemInterop>();
+        wgc::GraphicsCaptureItem item{nullptr};
+        HRESULT hr = interop->CreateForMonitor(static_cast<HMONITOR>(monitor_handle),
+                                               winrt::guid_of<wgc::GraphicsCaptureItem>(),
+                                               winrt::put_abi(item));
+        if (FAILED(hr)) {
+            error = "Failed to create capture item";
+            return false;
+        }
+        return impl_->Start(item, error);
+    } catch (const winrt::hresult_error& e) {
+        error = "Graphics Capture error: " + winrt::to_string(e.message());
+        return false;
+    }
+}
+
+bool GraphicsCaptureStream::StartForWindow(void* window_handle, std::string& error) {
+    if (!IsWindow(static_cast<HWND>(window_handle))) {
+        error = "Invalid window handle";
+        return false;
+    }
+
+    try {
+        auto interop = winrt::get_activation_factory<wgc::GraphicsCaptureItem, IGraphicsCaptureItemInterop>();
+        wgc::GraphicsCaptureItem item{nullptr};
+        HRESULT hr = interop->CreateForWindow(static_cast<HWND>(window_handle),
+                                              winrt::guid_of<wgc::GraphicsCaptureItem>(),
+                                              winrt::put_abi(item));
+        if (FAILED(hr)) {
+            error = "Failed to create capture item for window";
+            return false;
+        }
+        return impl_->Start(item, error);
+    } catch (const winrt::hresult_error& e) {
+        error = "Graphics Capture error: " + winrt::to_string(e.message());
+        return false;
+    }
+}
+
+bool GraphicsCaptureStream::IsRunning() const {
+    return impl_->running.load();
+}
+
+uint64_t GraphicsCaptureStream::GetFramesArrived() const {
+    return impl_->frames_arrived.load(std::memory_order_relaxed);
+}
+
+bool GraphicsCaptureStream::ReadFrame(uint8_t* buffer, size_t capacity, FrameDescriptor& frame,
+                                      uint32_t timeout_ms, bool* changed, const CaptureRegion* region) {
+    Impl& impl = *impl_;
+    std::unique_lock<std::mutex> lock(impl.mutex);
+    if (!impl.WaitForFirstFrame(lock, timeout_ms, frame.error_message)) {
+        return false;
+    }
+
+    // Clipped against the current frame, which follows window resizes
+    DirtyRect rect = {0, 0, impl.width, impl.height};
+    if (region && !WebPScreenshot::Utils::ClipCaptureRegion(*region, impl.width, impl.height, rect,
+                                                            frame.error_message)) {
+        return false;
+    }
+    const bool full_frame = rect.width == impl.width && rect.height == impl.height;
+
+    const uint32_t row_size = rect.width * 4;
+    frame.required_size = static_cast<size_t>(row_size) * rect.height;
+    if (!buffer || capacity < frame.required_size) {
+        frame.error_message = "Frame buffer too small";
+        return false;
+    }
+
+    // Staging is sized to what is read back, so a small region maps a small texture
+    if (!impl.staging || impl.staging_width != rect.width || impl.staging_height != rect.height) {
+        D3D11_TEXTURE2D_DESC desc;
+        impl.latest->GetDesc(&desc);
+        desc.Width = rect.width;
+        desc.Height = rect.height;
+        desc.Usage = D3D11_USAGE_STAGING;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        desc.BindFlags = 0;
+        desc.MiscFlags = 0;
+
+        impl.staging = nullptr;
+        if (FAILED(impl.device->CreateTexture2D(&desc, nullptr, impl.staging.put()))) {
+            frame.error_message = "Failed to create staging texture";
+            return false;
+        }
+        impl.staging_width = rect.width;
+        impl.staging_height = rect.height;
+    }
+
+    Stats::ScopedStageTimer readback_timer(Stats::Stage::Readback);
+    if (full_frame) {
+        impl.context->CopyResource(impl.staging.get(), impl.latest.get());
+    } else {
+        D3D11_BOX box = {rect.x, rect.y, 0, rect.x + rect.width, rect.y + rect.height, 1};
+        impl.context->CopySubresourceRegion(impl.staging.get(), 0, 0, 0, 0, impl.latest.get(), 0, &box);
+    }
+
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (FAILED(impl.context->Map(impl.staging.get(), 0, D3D11_MAP_READ, 0, &mapped))) {
+        readback_timer.Cancel();
+        frame.error_message = "Failed to map staging texture";
+        return false;
+    }
+    readback_timer.Stop();
+
+    Stats::ScopedStageTimer convert_timer(Stats::Stage::Convert);
+    Stats::AddBytesCopied(static_cast<uint64_t>(rect.height) * row_size);
+    const bool half_float = impl.config.pixel_format == GraphicsCaptureConfig::PixelFormat::RGBA16F;
+    const uint8_t* src = static_cast<const uint8_t*>(mapped.pData);
+    for (uint32_t row = 0; row < rect.height; ++row) {
+        const uint8_t* src_row = src + static_cast<size_t>(row) * mapped.RowPitch;
+        uint8_t* dst_row = buffer + static_cast<size_t>(row) * row_size;
+        if (half_float) {
+            ConvertHalfRowToRGBA(src_row, dst_row, rect.width);
+        } else {
+            SIMD::ConvertBGRAToRGBA(src_row, dst_row, rect.width);
+        }
+    }
+    convert_timer.Stop();
+
+    impl.context->Unmap(impl.staging.get(), 0);
+
+    frame.width = rect.width;
+    frame.height = rect.height;
+    frame.stride = row_size;
+    frame.bytes_per_pixel = 4;
+    if (changed) {
+        *changed = impl.sequence != impl.read_sequence;
+    }
+    impl.read_sequence = impl.sequence;
+    return true;
+}
+
+std::vector<uint8_t> GraphicsCaptureStream::EncodeFrame(const WebPEncodeParams& params, float scale,
+                                                        uint32_t timeout_ms, std::string& error,
+                                                        bool* changed) {
+    Impl& impl = *impl_;
+    if (impl.config.pixel_format != GraphicsCaptureConfig::PixelFormat::BGRA8) {
+        error = "GPU encoding needs a BGRA8 capture stream";
+        return {};
+    }
+
+    std::lock_guard<std::mutex> encode_lock(impl.encode_mutex);
+    YUV420Planes planes;
+    {
+        std::unique_lock<std::mutex> lock(impl.mutex);
+        if (!impl.WaitForFirstFrame(lock, timeout_ms, error)) {
+            return {};
+        }
+        if (!impl.converter.Initialize(impl.device.get())) {
+            error = impl.converter.GetLastError();
+            return {};
+        }
+
+        // Nothing else is in flight, so map the frame just submitted
+        impl.converter.Reset();
+        if (!impl.converter.Submit(impl.latest.get(), scale) || !impl.converter.MapOldest(planes, true)) {
+            error = impl.converter.GetLastError();
+            return {};
+        }
+
+        if (changed) {
+            *changed = impl.sequence != impl.read_sequence;
+        }
+        impl.read_sequence = impl.sequence;
+    }
+
+    // Encode without the lock so FrameArrived keeps running; the mapped slot
+    // is not touched by anything else until Unmap
+    WebPEncoder encoder;
+    std::vector<uint8_t> encoded = encoder.EncodeYUV420(planes.y, planes.y_stride, planes.u, planes.v,
+                                                        planes.uv_stride, planes.width, planes.height,
+                                                        params);
+    {
+        std::lock_guard<std::mutex> lock(impl.mutex);
+        impl.converter.Unmap();
+    }
+
+    if (encoded.empty()) {
+        error = encoder.GetLastError();
+    }
+    return encoded;
+}
+
+} // namespace Windows
+} // namespace WebPScreenshot
+
+#endif // _WIN32
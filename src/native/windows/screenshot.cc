@@ -1,6 +1,7 @@
 #ifdef _WIN32
 
 #include "screenshot.h"
+#include "capture_api.h"
 #include <windows.h>
 #include <gdiplus.h>
 #include <dwmapi.h>
@@ -36,6 +37,21 @@ using namespace Windows::Graphics::Imaging;
 namespace WebPScreenshot {
 namespace Windows {
 
+namespace {
+
+// WGC starts delivering frames a few tens of ms after StartCapture
+constexpr uint32_t kFirstFrameTimeoutMs = 3000;
+
+} // anonymous namespace
+
+// DXGI keeps the dirty and move rects of every frame presented since the
+// last acquisition, which is exactly what changed since the previous capture
+struct WindowsScreenshotCapture::DesktopDuplication {
+    ScreenshotWebP::Windows::CaptureAPI api;
+    bool available = false;   // Setup failed (e.g. remote session); not retried
+    bool has_frame = false;   // Only the first acquisition waits for an image
+};
+
 // WindowsScreenshotCapture implementation
 WindowsScreenshotCapture::WindowsScreenshotCapture() 
     : use_graphics_capture_(false), initialized_(false) {
@@ -117,17 +133,35 @@ ScreenshotResult WindowsScreenshotCapture::CaptureDisplay(uint32_t display_index
     return result;
 }
 
-std::vector<ScreenshotResult> WindowsScreenshotCapture::CaptureAllDisplays() {
+ScreenshotResult WindowsScreenshotCapture::CaptureDisplay(uint32_t display_index, const CaptureRegion& region) {
+    if (region.IsFullFrame()) {
+        return CaptureDisplay(display_index);
+    }
     if (!initialized_) Initialize();
-    
-    std::vector<ScreenshotResult> results;
-    std::vector<DisplayInfo> displays = GetDisplays();
-    
-    for (uint32_t i = 0; i < displays.size(); ++i) {
-        results.push_back(CaptureDisplay(i));
+
+    ScreenshotResult result;
+
+    try {
+        if (use_graphics_capture_ && graphics_capture_) {
+            result = graphics_capture_->CaptureDisplayRegion(display_index, region);
+        } else if (gdi_impl_) {
+            result = gdi_impl_->CaptureDisplayRegion(display_index, region);
+        } else {
+            result.error_message = "No screenshot implementation available";
+        }
+    } catch (const std::exception& e) {
+        result.success = false;
+        result.error_message = std::string("Exception during capture: ") + e.what();
     }
+
+    return result;
+}
+
+std::vector<ScreenshotResult> WindowsScreenshotCapture::CaptureAllDisplays() {
+    if (!initialized_) Initialize();
     
-    return results;
+    // Each instance owns its D3D device, duplication and capture streams
+    return CaptureAllDisplaysConcurrently([] { return std::make_unique<WindowsScreenshotCapture>(); });
 }
 
 bool WindowsScreenshotCapture::IsSupported() {
@@ -147,11 +181,138 @@ std::string WindowsScreenshotCapture::GetImplementationName() {
     }
 }
 
+std::vector<uint8_t> WindowsScreenshotCapture::EncodeDisplay(uint32_t display_index,
+                                                             const WebPEncodeParams& params,
+                                                             float scale) {
+    if (!initialized_) Initialize();
+    last_error_.clear();
+
+    // The GPU planes are opaque YUV420, which only plain lossy encoding accepts
+    const bool gpu_encodable = !params.lossless && !params.use_sharp_yuv;
+    if (use_graphics_capture_ && graphics_capture_ && gpu_encodable) {
+        std::vector<uint8_t> encoded = graphics_capture_->EncodeDisplay(display_index, params,
+                                                                        scale, last_error_);
+        if (!encoded.empty() || scale != 1.0f) {
+            return encoded;
+        }
+    }
+
+    if (scale != 1.0f) {
+        last_error_ = "Scaled encoding requires the GPU lossy path";
+        return {};
+    }
+
+    ScreenshotResult result = CaptureDisplay(display_index);
+    if (!result.success) {
+        last_error_ = result.error_message;
+        return {};
+    }
+
+    // GDI captures are BGRX; WGC ones were already swizzled to RGBA
+    WebPEncoder encoder;
+    std::vector<uint8_t> encoded = result.format == "RGBA"
+        ? encoder.EncodeRGBA(result.data.get(), result.width, result.height, result.stride, params)
+        : encoder.EncodeBGRA(result.data.get(), result.width, result.height, result.stride, params, false);
+    if (encoded.empty()) {
+        last_error_ = encoder.GetLastError();
+    }
+    return encoded;
+}
+
+WindowsScreenshotCapture::DesktopDuplication* WindowsScreenshotCapture::GetDuplication(uint32_t display_index) {
+    if (display_index >= static_cast<uint32_t>(ScreenshotWebP::Windows::CaptureAPI::GetDisplayCount())) {
+        return nullptr;
+    }
+    if (duplications_.size() <= display_index) {
+        duplications_.resize(display_index + 1);
+    }
+
+    auto& duplication = duplications_[display_index];
+    if (!duplication) {
+        try {
+            duplication = std::make_unique<DesktopDuplication>();
+            duplication->available = duplication->api.Initialize() &&
+                                     duplication->api.SetupDuplication(static_cast<int>(display_index));
+        } catch (...) {
+            duplication.reset();
+            return nullptr;
+        }
+    }
+    return duplication->available ? duplication.get() : nullptr;
+}
+
+bool WindowsScreenshotCapture::CaptureDisplayInto(uint32_t display_index, uint8_t* buffer,
+                                                  size_t capacity, FrameDescriptor& frame) {
+    if (!initialized_) Initialize();
+
+    // The rects let callers such as AnimationRecorder skip diffing frames
+    if (DesktopDuplication* duplication = GetDuplication(display_index)) {
+        const uint8_t* pixels = nullptr;
+        uint32_t width = 0, height = 0, stride = 0;
+        bool changed = false;
+        if (duplication->api.CaptureFrameIncremental(&pixels, &width, &height, &stride, &frame.dirty_rects,
+                                                     &changed, duplication->has_frame ? 0 : kFirstFrameTimeoutMs)) {
+            duplication->has_frame = true;
+            frame.required_size = static_cast<size_t>(width) * height * 4;
+            if (!buffer || capacity < frame.required_size) {
+                // These rects are lost with the frame, so the next one is whole
+                duplication->api.InvalidateIncrementalFrame();
+                frame.dirty_rects.clear();
+                frame.error_message = "Frame buffer too small";
+                return false;
+            }
+
+            // The persistent frame is tightly packed BGRA; desktops are opaque
+            SIMD::ConvertBGRXToRGBA(pixels, buffer, width * height);
+            frame.has_dirty_rects = true;
+            frame.width = width;
+            frame.height = height;
+            frame.stride = width * 4;
+            frame.bytes_per_pixel = 4;
+            return true;
+        }
+
+        // Access lost (mode change, secure desktop): set up again next time
+        duplications_[display_index].reset();
+        frame.dirty_rects.clear();
+    }
+
+    if (use_graphics_capture_ && graphics_capture_) {
+        return graphics_capture_->CaptureDisplayInto(display_index, buffer, capacity, frame);
+    }
+    return ScreenshotCapture::CaptureDisplayInto(display_index, buffer, capacity, frame);
+}
+
+ScreenshotResult WindowsScreenshotCapture::CaptureWindow(void* window_handle) {
+    if (!initialized_) Initialize();
+
+    if (use_graphics_capture_ && graphics_capture_) {
+        return graphics_capture_->CaptureWindow(window_handle);
+    }
+
+    ScreenshotResult result;
+    result.error_message = "Window capture requires Windows.Graphics.Capture";
+    return result;
+}
+
+void WindowsScreenshotCapture::SetGraphicsCaptureConfig(const GraphicsCaptureConfig& config) {
+    if (!initialized_) Initialize();
+
+    if (graphics_capture_) {
+        graphics_capture_->SetConfig(config);
+    }
+}
+
 // GraphicsCaptureImpl implementation
 GraphicsCaptureImpl::GraphicsCaptureImpl() 
     : is_supported_(false), com_initialized_(false) {}
 
 GraphicsCaptureImpl::~GraphicsCaptureImpl() {
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex_);
+        display_streams_.clear();
+        window_streams_.clear();
+    }
     CleanupCOM();
 }
 
@@ -218,255 +379,167 @@ std::vector<DisplayInfo> GraphicsCaptureImpl::GetDisplays() {
     return displays;
 }
 
-ScreenshotResult GraphicsCaptureImpl::CaptureDisplay(uint32_t display_index) {
-    ScreenshotResult result;
-    
+std::shared_ptr<GraphicsCaptureStream> GraphicsCaptureImpl::GetDisplayStream(uint32_t display_index,
+                                                                            std::string& error) {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
     if (display_index >= display_handles_.size()) {
-        result.error_message = "Display index out of range";
-        return result;
+        error = "Display index out of range";
+        return nullptr;
+    }
+
+    if (display_streams_.size() < display_handles_.size()) {
+        display_streams_.resize(display_handles_.size());
+    }
+
+    // A stream stops on display removal or device loss; start a fresh one
+    auto& stream = display_streams_[display_index];
+    if (!stream || !stream->IsRunning()) {
+        auto fresh = std::make_shared<GraphicsCaptureStream>(config_);
+        if (!fresh->StartForMonitor(display_handles_[display_index].monitor_handle, error)) {
+            stream = nullptr;
+            return nullptr;
+        }
+        stream = std::move(fresh);
+    }
+    return stream;
+}
+
+std::shared_ptr<GraphicsCaptureStream> GraphicsCaptureImpl::GetWindowStream(void* window_handle,
+                                                                           std::string& error) {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+
+    // Streams of closed windows are dropped here rather than in the callback
+    for (auto it = window_streams_.begin(); it != window_streams_.end();) {
+        it = it->second->IsRunning() ? std::next(it) : window_streams_.erase(it);
+    }
+
+    auto& stream = window_streams_[window_handle];
+    if (!stream) {
+        auto fresh = std::make_shared<GraphicsCaptureStream>(config_);
+        if (!fresh->StartForWindow(window_handle, error)) {
+            window_streams_.erase(window_handle);
+            return nullptr;
+        }
+        stream = std::move(fresh);
+    }
+    return stream;
+}
+
+ScreenshotResult GraphicsCaptureImpl::ReadStreamResult(GraphicsCaptureStream& stream,
+                                                      const CaptureRegion* region) {
+    ScreenshotResult result;
+    FrameDescriptor frame;
+    size_t capacity = 0;
+
+    // The first read sizes the buffer; a resize in between costs one more try
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        frame = FrameDescriptor();
+        if (stream.ReadFrame(result.data.get(), capacity, frame, kFirstFrameTimeoutMs, nullptr, region)) {
+            result.success = true;
+            result.width = frame.width;
+            result.height = frame.height;
+            result.bytes_per_pixel = frame.bytes_per_pixel;
+            result.stride = frame.stride;
+            result.data_size = static_cast<uint32_t>(frame.required_size);
+            result.format = "RGBA";
+            result.implementation = "Windows Graphics Capture";
+            return result;
+        }
+        if (frame.required_size <= capacity) {
+            break;
+        }
+        capacity = frame.required_size;
+        result.data = Utils::AllocateScreenshotBuffer(capacity);
     }
+
+    result.data.reset();
+    result.error_message = frame.error_message;
+    return result;
+}
+
+ScreenshotResult GraphicsCaptureImpl::CaptureDisplay(uint32_t display_index) {
+    ScreenshotResult result;
     
     try {
-        return CaptureWithGraphicsCapture(display_handles_[display_index].monitor_handle);
+        auto stream = GetDisplayStream(display_index, result.error_message);
+        if (!stream) {
+            return result;
+        }
+        return ReadStreamResult(*stream);
     } catch (const std::exception& e) {
         result.error_message = std::string("Graphics Capture failed: ") + e.what();
         return result;
     }
 }
 
-ScreenshotResult GraphicsCaptureImpl::CaptureWithGraphicsCapture(void* monitor_handle) {
+bool GraphicsCaptureImpl::CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                                             FrameDescriptor& frame) {
+    try {
+        auto stream = GetDisplayStream(display_index, frame.error_message);
+        return stream && stream->ReadFrame(buffer, capacity, frame, kFirstFrameTimeoutMs);
+    } catch (const std::exception& e) {
+        frame.error_message = std::string("Graphics Capture failed: ") + e.what();
+        return false;
+    }
+}
+
+ScreenshotResult GraphicsCaptureImpl::CaptureWindow(void* window_handle) {
     ScreenshotResult result;
-    
+
     try {
-        // Create capture item from monitor
-        auto interop = winrt::get_activation_factory<GraphicsCaptureItem, IGraphicsCaptureItemInterop>();
-        winrt::com_ptr<IGraphicsCaptureItem> capture_item_native;
-        
-        HRESULT hr = interop->CreateForMonitor(
-            static_cast<HMONITOR>(monitor_handle),
-            winrt::guid_of<IGraphicsCaptureItem>(),
-            capture_item_native.put_void()
-        );
-        
-        if (FAILED(hr)) {
-            result.error_message = "Failed to create capture item";
-            return result;
-        }
-        
-        auto capture_item = capture_item_native.as<GraphicsCaptureItem>();
-        
-        // Create D3D11 device
-        winrt::com_ptr<ID3D11Device> d3d_device;
-        winrt::com_ptr<ID3D11DeviceContext> d3d_context;
-        
-        D3D_FEATURE_LEVEL feature_levels[] = {
-            D3D_FEATURE_LEVEL_11_1,
-            D3D_FEATURE_LEVEL_11_0
-        };
-        
-        hr = D3D11CreateDevice(
-            nullptr,
-            D3D_DRIVER_TYPE_HARDWARE,
-            nullptr,
-            D3D11_CREATE_DEVICE_BGRA_SUPPORT,
-            feature_levels,
-            ARRAYSIZE(feature_levels),
-            D3D11_SDK_VERSION,
-            d3d_device.put(),
-            nullptr,
-            d3d_context.put()
-        );
-        
-        if (FAILED(hr)) {
-            result.error_message = "Failed to create D3D11 device";
-            return result;
-        }
-        
-        // Get DXGI device for WinRT interop
-        auto dxgi_device = d3d_device.as<IDXGIDevice>();
-        winrt::com_ptr<IInspectable> inspectable;
-        hr = CreateDirect3D11DeviceFromDXGIDevice(dxgi_device.get(), inspectable.put());
-        
-        if (FAILED(hr)) {
-            result.error_message = "Failed to create Direct3D11 device from DXGI";
-            return result;
-        }
-        
-        auto d3d_device_winrt = inspectable.as<IDirect3DDevice>();
-        
-        // Get capture item size
-        auto item_size = capture_item.Size();
-        
-        // Create frame pool with optimized settings
-        auto frame_pool = Direct3D11CaptureFramePool::CreateFreeThreaded(
-            d3d_device_winrt,
-            DirectXPixelFormat::B8G8R8A8UIntNormalized,
-            2, // Double buffering for better performance
-            item_size
-        );
-        
-        // Create capture session with optimizations
-        auto session = frame_pool.CreateCaptureSession(capture_item);
-        
-        // Enable cursor capture for better user experience
-        session.IsCursorCaptureEnabled(true);
-        
-        // Enable border exclusion for cleaner captures
-        session.IsBorderRequired(false);
-        
-        // Set up frame capture synchronization
-        bool frame_captured = false;
-        std::exception_ptr capture_exception;
-        winrt::com_ptr<ID3D11Texture2D> captured_texture;
-        
-        // Frame arrived handler
-        frame_pool.FrameArrived([&](auto&& sender, auto&&) {
-            try {
-                if (auto frame = sender.TryGetNextFrame()) {
-                    // Get the Direct3D surface
-                    auto access = frame.Surface().as<Windows::Graphics::DirectX::Direct3D11::IDirect3DDxgiInterfaceAccess>();
-                    
-                    winrt::com_ptr<IDXGISurface> dxgi_surface;
-                    hr = access->GetInterface(winrt::guid_of<IDXGISurface>(), dxgi_surface.put_void());
-                    
-                    if (SUCCEEDED(hr)) {
-                        // Get texture from DXGI surface
-                        hr = dxgi_surface->QueryInterface(captured_texture.put());
-                    }
-                }
-                frame_captured = true;
-            }
-            catch (...) {
-                capture_exception = std::current_exception();
-                frame_captured = true;
-            }
-        });
-        
-        // Start capture
-        session.StartCapture();
-        
-        // Wait for frame with timeout
-        auto start_time = std::chrono::steady_clock::now();
-        const auto timeout = std::chrono::milliseconds(3000);
-        
-        while (!frame_captured) {
-            if (std::chrono::steady_clock::now() - start_time > timeout) {
-                session.Close();
-                result.error_message = "Capture timeout";
-                return result;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
-        
-        session.Close();
-        frame_pool.Close();
-        
-        if (capture_exception) {
-            std::rethrow_exception(capture_exception);
-        }
-        
-        if (!captured_texture) {
-            result.error_message = "No frame captured";
+        auto stream = GetWindowStream(window_handle, result.error_message);
+        if (!stream) {
             return result;
         }
-        
-        // Get texture description
-        D3D11_TEXTURE2D_DESC desc;
-        captured_texture->GetDesc(&desc);
-        
-        // Create optimized staging texture with memory pool integration
-        D3D11_TEXTURE2D_DESC staging_desc = desc;
-        staging_desc.Usage = D3D11_USAGE_STAGING;
-        staging_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
-        staging_desc.BindFlags = 0;
-        staging_desc.MiscFlags = 0;
-        
-        // Use cached staging texture if available (GPU memory pool concept)
-        static thread_local winrt::com_ptr<ID3D11Texture2D> cached_staging_texture;
-        static thread_local uint32_t cached_width = 0, cached_height = 0;
-        
-        winrt::com_ptr<ID3D11Texture2D> staging_texture;
-        
-        if (cached_staging_texture && cached_width >= desc.Width && cached_height >= desc.Height) {
-            // Reuse cached staging texture for better performance
-            staging_texture = cached_staging_texture;
-        } else {
-            // Create new staging texture
-            hr = d3d_device->CreateTexture2D(&staging_desc, nullptr, staging_texture.put());
-            
-            if (FAILED(hr)) {
-                result.error_message = "Failed to create staging texture";
-                return result;
-            }
-            
-            // Cache for future use
-            cached_staging_texture = staging_texture;
-            cached_width = desc.Width;
-            cached_height = desc.Height;
-        }
-        
-        // Use asynchronous copy for better GPU pipeline utilization
-        d3d_context->CopyResource(staging_texture.get(), captured_texture.get());
-        
-        // Flush GPU commands to ensure copy completion
-        d3d_context->Flush();
-        
-        // Map staging texture
-        D3D11_MAPPED_SUBRESOURCE mapped;
-        hr = d3d_context->Map(staging_texture.get(), 0, D3D11_MAP_READ, 0, &mapped);
-        
-        if (FAILED(hr)) {
-            result.error_message = "Failed to map staging texture";
+        return ReadStreamResult(*stream);
+    } catch (const std::exception& e) {
+        result.error_message = std::string("Graphics Capture failed: ") + e.what();
+        return result;
+    }
+}
+
+ScreenshotResult GraphicsCaptureImpl::CaptureDisplayRegion(uint32_t display_index, const CaptureRegion& region) {
+    ScreenshotResult result;
+
+    try {
+        auto stream = region.window_id != 0
+            ? GetWindowStream(reinterpret_cast<void*>(static_cast<uintptr_t>(region.window_id)),
+                              result.error_message)
+            : GetDisplayStream(display_index, result.error_message);
+        if (!stream) {
             return result;
         }
-        
-        // Copy and convert pixel data (BGRA -> RGBA)
-        const uint32_t width = desc.Width;
-        const uint32_t height = desc.Height;
-        const uint32_t bytes_per_pixel = 4;
-        const uint32_t data_size = width * height * bytes_per_pixel;
-        
-        result.data = Utils::AllocateScreenshotBuffer(data_size);
-        
-        const uint8_t* src = static_cast<const uint8_t*>(mapped.pData);
-        uint8_t* dst = result.data.get();
-        
-        // Fast SIMD-optimized BGRA to RGBA conversion
-        if (mapped.RowPitch == width * bytes_per_pixel) {
-            // Contiguous memory - can convert in one pass
-            SIMD::ConvertBGRAToRGBA(src, dst, width * height);
-        } else {
-            // Row padding - convert row by row
-            for (uint32_t y = 0; y < height; ++y) {
-                const uint8_t* src_row = src + y * mapped.RowPitch;
-                uint8_t* dst_row = dst + y * width * bytes_per_pixel;
-                SIMD::ConvertBGRAToRGBA(src_row, dst_row, width);
-            }
-        }
-        
-        d3d_context->Unmap(staging_texture.get(), 0);
-        
-        // Fill result
-        result.success = true;
-        result.width = width;
-        result.height = height;
-        result.bytes_per_pixel = bytes_per_pixel;
-        result.data_size = data_size;
-        result.stride = width * bytes_per_pixel;
-        result.format = "RGBA";
-        result.implementation = "Windows Graphics Capture";
-        
-        return result;
-        
+        return ReadStreamResult(*stream, &region);
     } catch (const std::exception& e) {
-        result.error_message = "Graphics Capture error: " + std::string(e.what());
-        return result;
-    } catch (...) {
-        result.error_message = "Unknown Graphics Capture error";
+        result.error_message = std::string("Graphics Capture failed: ") + e.what();
         return result;
     }
 }
 
+std::vector<uint8_t> GraphicsCaptureImpl::EncodeDisplay(uint32_t display_index,
+                                                        const WebPEncodeParams& params,
+                                                        float scale, std::string& error) {
+    try {
+        auto stream = GetDisplayStream(display_index, error);
+        if (!stream) {
+            return {};
+        }
+        return stream->EncodeFrame(params, scale, kFirstFrameTimeoutMs, error);
+    } catch (const std::exception& e) {
+        error = "Graphics Capture error: " + std::string(e.what());
+        return {};
+    }
+}
+
+void GraphicsCaptureImpl::SetConfig(const GraphicsCaptureConfig& config) {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    config_ = config;
+
+    // Readers holding a stream finish with the old settings
+    display_streams_.clear();
+    window_streams_.clear();
+}
+
 // GDIPlusImpl implementation
 GDIPlusImpl::GDIPlusImpl() 
     : is_supported_(false), gdiplus_initialized_(false), gdiplus_token_(0) {}
@@ -538,6 +611,33 @@ ScreenshotResult GDIPlusImpl::CaptureDisplay(uint32_t display_index) {
     return CaptureWithGDI(displays[display_index]);
 }
 
+ScreenshotResult GDIPlusImpl::CaptureDisplayRegion(uint32_t display_index, const CaptureRegion& region) {
+    ScreenshotResult result;
+    if (region.window_id != 0) {
+        result.error_message = "Window capture requires Windows.Graphics.Capture";
+        return result;
+    }
+
+    std::vector<DisplayInfo> displays = GetDisplays();
+    if (display_index >= displays.size()) {
+        result.error_message = "Display index out of range";
+        return result;
+    }
+
+    DirtyRect rect;
+    DisplayInfo area = displays[display_index];
+    if (!WebPScreenshot::Utils::ClipCaptureRegion(region, area.width, area.height, rect, result.error_message)) {
+        return result;
+    }
+
+    // The blit reads only this part of the desktop
+    area.x += static_cast<int32_t>(rect.x);
+    area.y += static_cast<int32_t>(rect.y);
+    area.width = rect.width;
+    area.height = rect.height;
+    return CaptureWithGDI(area);
+}
+
 ScreenshotResult GDIPlusImpl::CaptureWithGDI(const DisplayInfo& display) {
     ScreenshotResult result;
     
@@ -4,6 +4,8 @@
 
 #include "../common/screenshot_common.h"
 #include <windows.h>
+#include <map>
+#include <mutex>
 #include <vector>
 #include <memory>
 #include <string>
@@ -15,6 +17,60 @@ namespace Windows {
 class GraphicsCaptureImpl;
 class GDIPlusImpl;
 
+// Windows.Graphics.Capture settings; streams started after a change use them
+struct GraphicsCaptureConfig {
+    enum class PixelFormat {
+        BGRA8,    // 8-bit SDR, also usable by the GPU YUV path
+        RGBA16F   // scRGB half floats (HDR), clamped to sRGB 8-bit on readback
+    };
+
+    PixelFormat pixel_format = PixelFormat::BGRA8;
+    uint32_t pool_size = 2;         // Frame pool buffers, 1 to 8
+    bool capture_cursor = true;
+    bool border_required = false;   // Yellow capture border (Windows 11+)
+};
+
+// Persistent Windows.Graphics.Capture stream of one monitor or window on a
+// free-threaded frame pool. FrameArrived copies each frame on the GPU into a
+// retained texture and closes it at once, so the pool never runs dry and
+// readers get the newest frame without waiting on a capture round trip.
+// WGC only delivers frames when content changes; readers see the latest one.
+class GraphicsCaptureStream {
+public:
+    explicit GraphicsCaptureStream(const GraphicsCaptureConfig& config);
+    ~GraphicsCaptureStream();
+
+    GraphicsCaptureStream(const GraphicsCaptureStream&) = delete;
+    GraphicsCaptureStream& operator=(const GraphicsCaptureStream&) = delete;
+
+    bool StartForMonitor(void* monitor_handle, std::string& error);
+    bool StartForWindow(void* window_handle, std::string& error);
+
+    // False once the item is closed (window destroyed) or the device is lost
+    bool IsRunning() const;
+
+    // Copy the newest frame into buffer as tightly packed RGBA. Waits up to
+    // timeout_ms only for the first frame. *changed tells whether a frame
+    // arrived since the previous read. With a region only that rectangle of
+    // the frame is copied to a staging texture of its size and read back.
+    bool ReadFrame(uint8_t* buffer, size_t capacity, FrameDescriptor& frame,
+                   uint32_t timeout_ms, bool* changed = nullptr,
+                   const CaptureRegion* region = nullptr);
+
+    // Lossy encode of the newest frame through the GPU YUV420 converter
+    // (BGRA8 streams only)
+    std::vector<uint8_t> EncodeFrame(const WebPEncodeParams& params, float scale,
+                                     uint32_t timeout_ms, std::string& error,
+                                     bool* changed = nullptr);
+
+    uint64_t GetFramesArrived() const;
+
+    struct Impl;
+
+private:
+    std::shared_ptr<Impl> impl_;
+};
+
 class WindowsScreenshotCapture : public ScreenshotCapture {
 public:
     WindowsScreenshotCapture();
@@ -23,15 +79,41 @@ public:
     // ScreenshotCapture interface
     std::vector<DisplayInfo> GetDisplays() override;
     ScreenshotResult CaptureDisplay(uint32_t display_index) override;
+    ScreenshotResult CaptureDisplay(uint32_t display_index, const CaptureRegion& region) override;
     std::vector<ScreenshotResult> CaptureAllDisplays() override;
     bool IsSupported() override;
     std::string GetImplementationName() override;
 
+    // Lossy encode with the BGRA->YUV420 conversion and optional downscale
+    // done on the GPU, so only the planes are read back. scale is 0.125 to 1;
+    // lossless, sharp-YUV and GDI captures take the CPU path at full scale.
+    std::vector<uint8_t> EncodeDisplay(uint32_t display_index, const WebPEncodeParams& params,
+                                       float scale = 1.0f);
+
+    // Reads the display's DXGI desktop duplication, which reports the dirty
+    // and moved rects of every frame; falls back to the persistent WGC stream
+    bool CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                            FrameDescriptor& frame) override;
+
+    // Capture one top-level window (HWND); needs Windows.Graphics.Capture
+    ScreenshotResult CaptureWindow(void* window_handle);
+
+    // Stops running streams; they restart with the new settings on next use
+    void SetGraphicsCaptureConfig(const GraphicsCaptureConfig& config);
+
+    const std::string& GetLastError() const { return last_error_; }
+
 private:
     std::unique_ptr<GraphicsCaptureImpl> graphics_capture_;
     std::unique_ptr<GDIPlusImpl> gdi_impl_;
     bool use_graphics_capture_;
     bool initialized_;
+    std::string last_error_;
+
+    // Desktop duplication of each display, set up on first CaptureDisplayInto
+    struct DesktopDuplication;
+    std::vector<std::unique_ptr<DesktopDuplication>> duplications_;
+    DesktopDuplication* GetDuplication(uint32_t display_index);
     
     void Initialize();
     bool CheckGraphicsCaptureSupport();
@@ -49,10 +131,33 @@ public:
     
     std::vector<DisplayInfo> GetDisplays();
     ScreenshotResult CaptureDisplay(uint32_t display_index);
+    bool CaptureDisplayInto(uint32_t display_index, uint8_t* buffer, size_t capacity,
+                            FrameDescriptor& frame);
+    ScreenshotResult CaptureWindow(void* window_handle);
+
+    // Rectangle of the display's or the window's stream (region.window_id is an HWND)
+    ScreenshotResult CaptureDisplayRegion(uint32_t display_index, const CaptureRegion& region);
+
+    // GPU YUV420 conversion and plane readback, then a lossy encode
+    std::vector<uint8_t> EncodeDisplay(uint32_t display_index, const WebPEncodeParams& params,
+                                       float scale, std::string& error);
+
+    void SetConfig(const GraphicsCaptureConfig& config);
     
 private:
     bool is_supported_;
     bool com_initialized_;
+
+    // Streams start lazily and are shared so a reader keeps one alive across SetConfig
+    std::mutex stream_mutex_;
+    GraphicsCaptureConfig config_;
+    std::vector<std::shared_ptr<GraphicsCaptureStream>> display_streams_;
+    std::map<void*, std::shared_ptr<GraphicsCaptureStream>> window_streams_;
+
+    std::shared_ptr<GraphicsCaptureStream> GetDisplayStream(uint32_t display_index, std::string& error);
+    std::shared_ptr<GraphicsCaptureStream> GetWindowStream(void* window_handle, std::string& error);
+    static ScreenshotResult ReadStreamResult(GraphicsCaptureStream& stream,
+                                             const CaptureRegion* region = nullptr);
     
     struct DisplayHandle {
         void* monitor_handle; // HMONITOR
@@ -63,7 +168,6 @@ private:
     std::vector<DisplayHandle> display_handles_;
     
     void EnumerateDisplays();
-    ScreenshotResult CaptureWithGraphicsCapture(void* monitor_handle);
     
     // COM interface management
     bool InitializeCOM();
@@ -81,6 +185,9 @@ public:
     
     std::vector<DisplayInfo> GetDisplays();
     ScreenshotResult CaptureDisplay(uint32_t display_index);
+
+    // BitBlt of just the rectangle; windows are not supported
+    ScreenshotResult CaptureDisplayRegion(uint32_t display_index, const CaptureRegion& region);
     
 private:
     bool is_supported_;
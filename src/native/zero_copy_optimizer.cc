@@ -1,6 +1,7 @@
 #include "common/screenshot_common.h"
 #include <memory>
 #include <atomic>
+#include <cstring>
 
 #ifdef _WIN32
 #include <d3d11.h>
@@ -91,6 +92,7 @@ public:
     
     // Create WebP encoding without copying pixel data
     std::vector<uint8_t> EncodeWebPZeroCopy(const WebPEncodeParams& params) const;
+    EncodeIntoResult EncodeWebPZeroCopyInto(const WebPEncodeParams& params, EncodeSpan output) const;
 };
 
 ScreenshotResult ZeroCopyScreenshotResult::ToTraditionalResult() const {
@@ -98,8 +100,9 @@ ScreenshotResult ZeroCopyScreenshotResult::ToTraditionalResult() const {
     
     if (success && buffer) {
         // Only copy when absolutely necessary
-        result.data = std::make_unique<uint8_t[]>(buffer->GetSize());
+        result.data = Utils::AllocateScreenshotBuffer(buffer->GetSize());
         std::memcpy(result.data.get(), buffer->GetData(), buffer->GetSize());
+        Stats::AddBytesCopied(buffer->GetSize());
         result.data_size = static_cast<uint32_t>(buffer->GetSize());
     }
     
@@ -130,6 +133,16 @@ std::vector<uint8_t> ZeroCopyScreenshotResult::EncodeWebPZeroCopy(const WebPEnco
     );
 }
 
+EncodeIntoResult ZeroCopyScreenshotResult::EncodeWebPZeroCopyInto(const WebPEncodeParams& params,
+                                                                  EncodeSpan output) const {
+    if (!success || !buffer) {
+        return {};
+    }
+    
+    // Neither the pixels nor the bitstream take an intermediate copy
+    return SIMD::EncodeSIMDOptimizedInto(buffer->GetBytes(), width, height, stride, params, output);
+}
+
 // Zero-copy optimized capture interface
 class ZeroCopyCapture {
 public:
@@ -146,7 +159,6 @@ public:
         uint64_t zero_copy_captures;
         uint64_t traditional_captures;
         uint64_t memory_saved_bytes;
-        double average_capture_time_ms;
     };
     
     virtual ZeroCopyStats GetZeroCopyStats() const = 0;
@@ -219,7 +231,7 @@ ZeroCopyScreenshotResult WindowsZeroCopyCapture::CaptureZeroCopy(uint32_t displa
         return result;
     }
     
-    auto start_time = std::chrono::high_resolution_clock::now();
+    Stats::ScopedStageTimer readback_timer(Stats::Stage::Readback);
     
     try {
         // Use Windows Graphics.Capture with zero-copy optimization
@@ -275,9 +287,9 @@ ZeroCopyScreenshotResult WindowsZeroCopyCapture::CaptureZeroCopy(uint32_t displa
         stats_.traditional_captures++;
     }
     
-    auto end_time = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-    stats_.average_capture_time_ms = duration.count() / 1000.0;
+    if (!result.success) {
+        readback_timer.Cancel();
+    }
     
     return result;
 }
@@ -445,12 +457,29 @@ std::vector<uint8_t> EncodeWebPZeroCopy(uint32_t display_index, const WebPEncode
     return {};
 }
 
-struct ZeroCopyStats {
-    uint64_t zero_copy_operations;
-    uint64_t traditional_operations;
-    uint64_t total_memory_saved_mb;
-    double average_speed_improvement_percent;
-};
+EncodeIntoResult EncodeWebPZeroCopyInto(uint32_t display_index, const WebPEncodeParams& params,
+                                        EncodeSpan output) {
+    auto& manager = ZeroCopyManager::Instance();
+    
+    if (manager.IsZeroCopyAvailable()) {
+        auto zero_copy_result = manager.CaptureZeroCopy(display_index);
+        if (zero_copy_result.success) {
+            return zero_copy_result.EncodeWebPZeroCopyInto(params, output);
+        }
+    }
+    
+    // Fallback to traditional capture
+    auto capture = CreateScreenshotCapture();
+    auto result = capture->CaptureDisplay(display_index);
+    
+    if (result.success) {
+        WebPEncoder encoder;
+        return encoder.EncodeInto(result.data.get(), result.width, result.height, result.stride,
+                                  WebPEncoder::PixelLayout::RGBA, params, output);
+    }
+    
+    return {};
+}
 
 ZeroCopyStats GetZeroCopyStatistics() {
     auto stats = ZeroCopyManager::Instance().GetGlobalStats();
@@ -459,15 +488,6 @@ ZeroCopyStats GetZeroCopyStatistics() {
     public_stats.zero_copy_operations = stats.zero_copy_captures;
     public_stats.traditional_operations = stats.traditional_captures;
     public_stats.total_memory_saved_mb = stats.memory_saved_bytes / (1024 * 1024);
-    
-    // Calculate speed improvement
-    if (stats.average_capture_time_ms > 0) {
-        // Assume traditional capture takes ~50% longer
-        double traditional_time = stats.average_capture_time_ms * 1.5;
-        public_stats.average_speed_improvement_percent = 
-            ((traditional_time - stats.average_capture_time_ms) / traditional_time) * 100.0;
-    }
-    
     return public_stats;
 }
 
@@ -478,8 +498,7 @@ std::string GetZeroCopyInfo() {
         auto stats = GetZeroCopyStatistics();
         info += "Available - ";
         info += std::to_string(stats.zero_copy_operations) + " zero-copy captures, ";
-        info += std::to_string(stats.total_memory_saved_mb) + "MB saved, ";
-        info += std::to_string(static_cast<int>(stats.average_speed_improvement_percent)) + "% faster";
+        info += std::to_string(stats.total_memory_saved_mb) + "MB saved";
     } else {
         info += "Not Available";
     }
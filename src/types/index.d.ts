@@ -21,16 +21,34 @@ declare module 'webp-screenshot' {
         name: string;
     }
 
+    /**
+     * Rectangle to capture, clipped to the display or window
+     */
+    export interface CaptureRegion {
+        /** Left edge in pixels (default: 0) */
+        x?: number;
+        /** Top edge in pixels (default: 0) */
+        y?: number;
+        /** Width in pixels (default: to the right edge) */
+        width?: number;
+        /** Height in pixels (default: to the bottom edge) */
+        height?: number;
+    }
+
     /**
      * Screenshot capture and WebP encoding options
      */
     export interface CaptureOptions {
+        /** Lossless encoding (0=lossy, 1=lossless) */
+        lossless?: number;
         /** WebP quality (0-100) */
         quality?: number;
         /** Compression method (0-6, 0=fast, 6=slow/better) */
         method?: number;
         /** Target size in bytes (0=disabled) */
         targetSize?: number;
+        /** Hard cap in bytes; lossy encodes lower quality to fit, others fail (0=disabled) */
+        maxOutputSize?: number;
         /** Target PSNR (0=disabled) */
         targetPsnr?: number;
         /** Number of segments (1-4) */
@@ -75,6 +93,16 @@ declare module 'webp-screenshot' {
         useDeltaPalette?: number;
         /** Use sharp RGB->YUV conversion (0-1) */
         useSharpYuv?: number;
+        /** Pick lossless for UI/text tiles and fast lossy for photos (0-1) */
+        contentAdaptive?: number;
+        /** Encode latency budget in ms; lowers method/pass to fit (0=off) */
+        maxEncodeMs?: number;
+        /** Reuse encoded tiles of unchanged screen regions across captures (0-1) */
+        tileCache?: number;
+        /** Capture only this rectangle; the backend reads back nothing else */
+        region?: CaptureRegion;
+        /** Capture a window (HWND, X11 Window or CGWindowID) instead of the display; region is then relative to the window */
+        windowId?: number;
     }
 
     /**
@@ -121,6 +149,94 @@ declare module 'webp-screenshot' {
         success: false;
     }
 
+    /**
+     * Outcome of encodeInto
+     */
+    export interface EncodeIntoResult {
+        /** Bytes of the file now in the output buffer (0 when it did not fit) */
+        bytesWritten: number;
+        /** Size of the encoded file; grow the buffer to this and retry when bytesWritten is 0 */
+        requiredSize: number;
+    }
+
+    /**
+     * Outcome of encodeBatch
+     */
+    export interface BatchEncodeResult {
+        /** WebP files in input order (null where a frame failed) */
+        frames: (Buffer | null)[];
+        /** Error of each failed frame, in the same order */
+        errors: (string | null)[];
+        /** Number of frames that failed */
+        failedFrames: number;
+        /** Threads the batch ran on */
+        workers: number;
+        /** Wall time of the whole batch */
+        elapsedMs: number;
+        /** Batch throughput */
+        framesPerSecond: number;
+    }
+
+    /**
+     * One size to encode with encodeMultiResolution, with its own options
+     */
+    export interface PyramidLevel extends CaptureOptions {
+        /** Multiplies both dimensions, in (0, 1] (default: 1) */
+        scale?: number;
+        /** Caps the longer side after scaling (0=no cap) */
+        maxDimension?: number;
+    }
+
+    /**
+     * One encoded level of an encodeMultiResolution call
+     */
+    export interface MultiResolutionLevel {
+        /** Level width in pixels */
+        width: number;
+        /** Level height in pixels */
+        height: number;
+        /** Level width over frame width */
+        scaleFactor: number;
+        /** WebP file, or null when the level failed */
+        data: Buffer | null;
+        /** Why the level failed */
+        error: string | null;
+    }
+
+    /**
+     * One-time setup steps for warmup (all run by default)
+     */
+    export interface WarmupOptions {
+        /** Run a tiny lossy and lossless encode */
+        encoder?: boolean;
+        /** Compile the GPU YUV420 shader (Windows) */
+        gpu?: boolean;
+        /** Set up the capture backend */
+        capture?: boolean;
+    }
+
+    /**
+     * What warmup set up and how long each step took
+     */
+    export interface WarmupReport {
+        /** Encoder setup done */
+        encoderReady: boolean;
+        /** GPU shader ready; false without a GPU path */
+        gpuReady: boolean;
+        /** Capture backend reachable */
+        captureReady: boolean;
+        /** Backend that was set up */
+        captureBackend: string;
+        /** Time this call spent on the encoder step */
+        encoderMs: number;
+        /** Time this call spent on the GPU step */
+        gpuMs: number;
+        /** Time this call spent on the capture step */
+        captureMs: number;
+        /** Why a step failed */
+        error?: string;
+    }
+
     /**
      * Implementation information
      */
@@ -157,6 +273,108 @@ declare module 'webp-screenshot' {
         fallbackUsagePercent: number;
     }
 
+    /**
+     * Latency histogram of one native stage
+     */
+    export interface StageStats {
+        /** Samples recorded */
+        count: number;
+        /** Sum of all samples in milliseconds */
+        totalMs: number;
+        /** Mean latency in microseconds */
+        meanUs: number;
+        /** Fastest sample in microseconds */
+        minUs: number;
+        /** Slowest sample in microseconds */
+        maxUs: number;
+        /** Median latency in microseconds */
+        p50Us: number;
+        /** 90th percentile in microseconds */
+        p90Us: number;
+        /** 99th percentile in microseconds */
+        p99Us: number;
+        /** 99.9th percentile in microseconds */
+        p999Us: number;
+    }
+
+    /**
+     * Memory pool counters
+     */
+    export interface MemoryPoolStats {
+        /** Buffers cached for reuse */
+        availableBuffers: number;
+        /** Buffers allocated since start-up */
+        totalBuffersCreated: number;
+        /** Bytes handed out and not yet returned */
+        bytesInUse: number;
+        /** Bytes held in the caches */
+        bytesCached: number;
+        /** Highest bytesInUse seen */
+        peakMemoryUsage: number;
+        /** Requests served from a cached buffer */
+        memoryReuseCount: number;
+        /** Requests served from the calling thread's cache */
+        threadCacheHits: number;
+    }
+
+    /**
+     * Hits and misses of tileCache encodes, and the cache's size
+     */
+    export interface TileCacheStats {
+        /** Tiles reused from the cache */
+        tileHits: number;
+        /** Tiles encoded and added to the cache */
+        tileMisses: number;
+        /** tileHits / (tileHits + tileMisses) */
+        tileHitRate: number;
+        /** Whole frames reused from the cache */
+        frameHits: number;
+        /** Frames with at least one changed tile */
+        frameMisses: number;
+        /** frameHits / (frameHits + frameMisses) */
+        frameHitRate: number;
+        /** Encoded tiles and frames held */
+        entries: number;
+        /** Bytes held */
+        bytes: number;
+        /** Size past which the least recently used entries are evicted */
+        maxBytes: number;
+        /** Entries evicted since start-up */
+        evictions: number;
+    }
+
+    /**
+     * Native per-stage latency histograms and copy/allocation counters
+     */
+    export interface NativePerformanceStats {
+        /** Latency of each pipeline stage */
+        stages: {
+            capture: StageStats;
+            readback: StageStats;
+            convert: StageStats;
+            encode: StageStats;
+            marshal: StageStats;
+        };
+        /** Frames handed to JavaScript */
+        frames: number;
+        /** Pixel bytes copied on the CPU */
+        bytesCopied: number;
+        /** bytesCopied / frames */
+        bytesCopiedPerFrame: number;
+        /** Frame-sized allocations outside the memory pool caches */
+        allocations: number;
+        /** Bytes behind those allocations */
+        allocatedBytes: number;
+        /** allocations / frames */
+        allocationsPerFrame: number;
+        /** Time since start-up or the last reset */
+        elapsedSeconds: number;
+        /** Memory pool counters */
+        memoryPool: MemoryPoolStats;
+        /** Tile cache counters */
+        tileCache: TileCacheStats;
+    }
+
     /**
      * Main WebP Screenshot class
      */
@@ -184,6 +402,50 @@ declare module 'webp-screenshot' {
          */
         captureAllDisplays(options?: CaptureOptions): Promise<(ScreenshotResult | FailedScreenshotResult)[]>;
 
+        /**
+         * Do the one-time setup of the first capture and encode now; each
+         * step runs once per process, so later calls resolve immediately
+         * @param options - Steps to run (all by default)
+         */
+        warmup(options?: WarmupOptions): Promise<WarmupReport>;
+
+        /**
+         * Encode RGBA pixels straight into a caller-owned buffer, without
+         * allocating a Buffer per frame
+         * @param output - Destination; the file is written from offset 0
+         * @param pixels - RGBA pixels
+         * @param width - Width in pixels
+         * @param height - Height in pixels
+         * @param stride - Bytes per row (default: width * 4)
+         * @param options - Encoding options
+         */
+        encodeInto(output: Buffer, pixels: Buffer, width: number, height: number, stride?: number,
+                   options?: CaptureOptions): Promise<EncodeIntoResult>;
+
+        /**
+         * Encode many RGBA frames of the same size with the same options;
+         * whole frames encode in parallel
+         * @param frames - RGBA pixels, one buffer per frame
+         * @param width - Width in pixels
+         * @param height - Height in pixels
+         * @param stride - Bytes per row (default: width * 4)
+         * @param options - Encoding options
+         */
+        encodeBatch(frames: Buffer[], width: number, height: number, stride?: number,
+                    options?: CaptureOptions): Promise<BatchEncodeResult>;
+
+        /**
+         * Encode several sizes of one RGBA frame, e.g. full size, half size and a thumbnail
+         * @param pixels - RGBA pixels
+         * @param width - Width in pixels
+         * @param height - Height in pixels
+         * @param stride - Bytes per row (default: width * 4)
+         * @param levels - Sizes to encode (default: one full-size level)
+         * @returns One entry per level, in the order given
+         */
+        encodeMultiResolution(pixels: Buffer, width: number, height: number, stride?: number,
+                              levels?: PyramidLevel[]): Promise<MultiResolutionLevel[]>;
+
         /**
          * Check if native WebP screenshot capture is supported
          */
@@ -203,6 +465,17 @@ declare module 'webp-screenshot' {
          * Reset performance metrics
          */
         resetPerformanceMetrics(): void;
+
+        /**
+         * Get native per-stage latency histograms and copy/allocation counters
+         * @returns null in fallback mode
+         */
+        getPerformanceStats(): NativePerformanceStats | null;
+
+        /**
+         * Reset native per-stage statistics (process-wide)
+         */
+        resetPerformanceStats(): void;
     }
 
     /**
@@ -222,6 +495,11 @@ declare module 'webp-screenshot' {
          */
         isNativeSupported(): boolean;
 
+        /**
+         * Warm up the shared native state (same as instance.warmup())
+         */
+        warmup(options?: WarmupOptions): Promise<WarmupReport>;
+
         /**
          * Get version information
          */
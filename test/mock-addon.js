@@ -1,6 +1,11 @@
 // Mock implementation for testing the testing infrastructure
 // This allows us to validate the test framework before building the actual native addon
 
+const crypto = require('crypto');
+
+// Grid of tileCache encodes, as in the native encoder
+const CACHE_TILE_SIZE = 256;
+
 class MockAddon {
   constructor() {
     this.memoryPool = {
@@ -13,6 +18,15 @@ class MockAddon {
         memoryReuseCount: 0
       }
     };
+    this.tileCache = { frames: new Map(), tiles: new Set() };
+    this.warmedSteps = new Map();
+    this.resetPerformanceStats();
+  }
+
+  // Per-stage latency samples, mirroring the native Stats module
+  _recordStage(stage, startTime) {
+    const elapsedUs = Number(process.hrtime.bigint() - startTime) / 1000;
+    this.performanceStats.samples[stage].push(elapsedUs);
   }
 
   // Mock SIMD functions
@@ -84,20 +98,65 @@ class MockAddon {
     }
   }
 
+  // The option checks of Utils::ValidateWebPParams
+  _validateParams(params) {
+    const quality = params.quality || 80;
+    if (quality < 0 || quality > 100) {
+      throw new Error('Quality must be between 0 and 100');
+    }
+    if (params.maxOutputSize < 0) {
+      throw new Error('max_output_size must not be negative');
+    }
+    if (params.maxEncodeMs < 0) {
+      throw new Error('max_encode_ms must not be negative');
+    }
+    if (params.tileCache !== undefined && (params.tileCache < 0 || params.tileCache > 1)) {
+      throw new Error('tile_cache must be between 0 and 1');
+    }
+  }
+
   // Mock WebP encoding
   encodeWebP(buffer, width, height, stride, params = {}) {
     if (!Buffer.isBuffer(buffer)) {
       throw new Error('Invalid buffer provided');
     }
 
+    this._validateParams(params);
     const quality = params.quality || 80;
-    if (quality < 0 || quality > 100) {
-      throw new Error('Quality must be between 0 and 100');
+    const startTime = process.hrtime.bigint();
+
+    let cacheKeys = null;
+    if (params.tileCache) {
+      cacheKeys = this._tileCacheKeys(buffer, width, height, stride || width * 4, params);
+      const cached = cacheKeys.tiles.length > 1 && this.tileCache.frames.get(cacheKeys.frame);
+      if (cached) {
+        this.performanceStats.frameCacheHits++;
+        this._recordStage('encode', startTime);
+        return Buffer.from(cached);
+      }
+      if (cacheKeys.tiles.length > 1) {
+        this.performanceStats.frameCacheMisses++;
+      }
+      for (const key of cacheKeys.tiles) {
+        if (this.tileCache.tiles.has(key)) {
+          this.performanceStats.tileCacheHits++;
+        } else {
+          this.performanceStats.tileCacheMisses++;
+          this.tileCache.tiles.add(key);
+        }
+      }
     }
 
     // Simulate WebP encoding with compression
     const compressionRatio = 8 + (quality / 100) * 4; // 8-12x compression
-    const compressedSize = Math.floor(buffer.length / compressionRatio);
+    let compressedSize = Math.max(20, Math.floor(buffer.length / compressionRatio));
+    if (params.maxOutputSize > 0 && compressedSize > params.maxOutputSize) {
+      // Lossy rate control fits the cap; lossless has nothing to give up
+      if (params.lossless || params.maxOutputSize < 20) {
+        throw new Error(`Encoded image exceeds max_output_size (${compressedSize} > ${params.maxOutputSize} bytes)`);
+      }
+      compressedSize = params.maxOutputSize;
+    }
     
     // Create mock WebP data
     const webpData = Buffer.alloc(compressedSize);
@@ -109,10 +168,53 @@ class MockAddon {
     for (let i = 12; i < compressedSize; i++) {
       webpData[i] = Math.floor(Math.random() * 256);
     }
+
+    // Mirror the native chunk choice: lossless (VP8L) for requested lossless
+    // or low-colour content in adaptive mode, lossy (VP8) otherwise
+    const lossless = params.lossless ||
+      (params.contentAdaptive && this._countColors(buffer, 256) <= 256);
+    webpData.write(lossless ? 'VP8L' : 'VP8 ', 12);
+
+    if (cacheKeys) {
+      this.tileCache.frames.set(cacheKeys.frame, Buffer.from(webpData));
+    }
     
+    this._recordStage('encode', startTime);
+    this.performanceStats.allocations++;
+    this.performanceStats.allocatedBytes += compressedSize;
     return webpData;
   }
 
+  // Pixel hash of every cache tile plus the frame key, all including the
+  // settings that change the encoded bytes
+  _tileCacheKeys(buffer, width, height, stride, params) {
+    const { maxThreads, enableMultithreading, ...settings } = params;
+    const suffix = JSON.stringify(settings);
+    const tiles = [];
+    for (let y = 0; y < height; y += CACHE_TILE_SIZE) {
+      for (let x = 0; x < width; x += CACHE_TILE_SIZE) {
+        const hash = crypto.createHash('sha1');
+        const tileWidth = Math.min(CACHE_TILE_SIZE, width - x);
+        const tileHeight = Math.min(CACHE_TILE_SIZE, height - y);
+        for (let row = y; row < y + tileHeight; row++) {
+          const start = row * stride + x * 4;
+          hash.update(buffer.subarray(start, start + tileWidth * 4));
+        }
+        tiles.push(`${tileWidth}x${tileHeight}:${hash.digest('hex')}:${suffix}`);
+      }
+    }
+    return { tiles, frame: `${width}x${height}:${tiles.join(',')}` };
+  }
+
+  // Distinct RGB values in the buffer, stopping once limit is exceeded
+  _countColors(buffer, limit) {
+    const colors = new Set();
+    for (let i = 0; i + 2 < buffer.length && colors.size <= limit; i += 4) {
+      colors.add((buffer[i] << 16) | (buffer[i + 1] << 8) | buffer[i + 2]);
+    }
+    return colors.size;
+  }
+
   encodeSIMDOptimized(buffer, width, height, stride, params) {
     // Simulate faster SIMD encoding
     const startTime = process.hrtime.bigint();
@@ -175,13 +277,94 @@ class MockAddon {
     this.memoryPool.stats.availableBuffers = 0;
   }
 
+  getPerformanceStats() {
+    const stages = {};
+    for (const [stage, samples] of Object.entries(this.performanceStats.samples)) {
+      const sorted = [...samples].sort((a, b) => a - b);
+      const total = sorted.reduce((sum, value) => sum + value, 0);
+      const rank = p => sorted.length ? sorted[Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1)] : 0;
+      stages[stage] = {
+        count: sorted.length,
+        totalMs: total / 1000,
+        meanUs: sorted.length ? total / sorted.length : 0,
+        minUs: sorted.length ? sorted[0] : 0,
+        maxUs: sorted.length ? sorted[sorted.length - 1] : 0,
+        p50Us: rank(0.5),
+        p90Us: rank(0.9),
+        p99Us: rank(0.99),
+        p999Us: rank(0.999)
+      };
+    }
+
+    const { frames, bytesCopied, allocations, allocatedBytes, startTime } = this.performanceStats;
+    return {
+      stages,
+      frames,
+      bytesCopied,
+      bytesCopiedPerFrame: frames ? bytesCopied / frames : 0,
+      allocations,
+      allocatedBytes,
+      allocationsPerFrame: frames ? allocations / frames : 0,
+      elapsedSeconds: Number(process.hrtime.bigint() - startTime) / 1e9,
+      memoryPool: this.getMemoryPoolStats(),
+      tileCache: this._tileCacheStats()
+    };
+  }
+
+  _tileCacheStats() {
+    const { tileCacheHits, tileCacheMisses, frameCacheHits, frameCacheMisses } = this.performanceStats;
+    const tiles = tileCacheHits + tileCacheMisses;
+    const frames = frameCacheHits + frameCacheMisses;
+    let bytes = 0;
+    for (const data of this.tileCache.frames.values()) {
+      bytes += data.length;
+    }
+    return {
+      tileHits: tileCacheHits,
+      tileMisses: tileCacheMisses,
+      tileHitRate: tiles ? tileCacheHits / tiles : 0,
+      frameHits: frameCacheHits,
+      frameMisses: frameCacheMisses,
+      frameHitRate: frames ? frameCacheHits / frames : 0,
+      entries: this.tileCache.frames.size + this.tileCache.tiles.size,
+      bytes,
+      maxBytes: 64 * 1024 * 1024,
+      evictions: 0
+    };
+  }
+
+  resetPerformanceStats() {
+    this.performanceStats = {
+      samples: { capture: [], readback: [], convert: [], encode: [], marshal: [] },
+      frames: 0,
+      bytesCopied: 0,
+      allocations: 0,
+      allocatedBytes: 0,
+      tileCacheHits: 0,
+      tileCacheMisses: 0,
+      frameCacheHits: 0,
+      frameCacheMisses: 0,
+      startTime: process.hrtime.bigint()
+    };
+  }
+
   // Mock screenshot capture
   async captureScreenshot(options = {}) {
     // Simulate capture delay
+    const startTime = process.hrtime.bigint();
     await new Promise(resolve => setTimeout(resolve, 20 + Math.random() * 50));
+    this._recordStage('capture', startTime);
     
-    const width = 1920;
-    const height = 1080;
+    // Only the requested rectangle is produced, as the native backends read back
+    if (options.windowId) {
+      return { success: false, error: 'Window not found' };
+    }
+    const region = this._clipRegion(options.region, 1920, 1080);
+    if (!region) {
+      return { success: false, error: 'Capture region lies outside the 1920x1080 source' };
+    }
+    const { width, height } = region;
+    const convertStart = process.hrtime.bigint();
     const data = Buffer.alloc(width * height * 4);
     
     // Fill with test pattern
@@ -191,6 +374,9 @@ class MockAddon {
       data[i + 2] = Math.floor(Math.random() * 256); // B
       data[i + 3] = 255;                             // A
     }
+    this._recordStage('convert', convertStart);
+    this.performanceStats.bytesCopied += data.length;
+    this.performanceStats.frames++;
     
     return {
       success: true,
@@ -202,6 +388,187 @@ class MockAddon {
     };
   }
 
+  // Mirrors ClipCaptureRegion: missing sizes extend to the edge, larger
+  // ones are cut at it, and a rectangle starting outside is rejected
+  _clipRegion(region = {}, sourceWidth, sourceHeight) {
+    const x = Math.max(0, Math.floor(region.x || 0));
+    const y = Math.max(0, Math.floor(region.y || 0));
+    if (x >= sourceWidth || y >= sourceHeight) {
+      return null;
+    }
+    const width = region.width > 0 ? Math.min(Math.floor(region.width), sourceWidth - x) : sourceWidth - x;
+    const height = region.height > 0 ? Math.min(Math.floor(region.height), sourceHeight - y) : sourceHeight - y;
+    return { x, y, width, height };
+  }
+
+  // Mock async entry points (native versions run on the libuv thread pool)
+  async captureScreenshotAsync(options = {}) {
+    const capture = await this.captureScreenshot(options);
+    if (!capture.success) {
+      throw new Error(capture.error);
+    }
+    return capture;
+  }
+
+  async captureDisplayAsync(displayIndex = 0, options = {}) {
+    const capture = await this.captureScreenshotAsync({
+      display: displayIndex,
+      region: options.region,
+      windowId: options.windowId
+    });
+    const data = this.encodeWebP(capture.data, capture.width, capture.height, capture.stride, options);
+    return {
+      success: true,
+      width: capture.width,
+      height: capture.height,
+      format: 'webp',
+      data
+    };
+  }
+
+  // Writes into the caller's buffer; a file that does not fit only reports its size
+  encodeWebPInto(output, buffer, width, height, stride, params = {}) {
+    if (!Buffer.isBuffer(output)) {
+      throw new Error('Invalid output buffer provided');
+    }
+    const encoded = this.encodeWebP(buffer, width, height, stride, params);
+    if (encoded.length > output.length) {
+      return { bytesWritten: 0, requiredSize: encoded.length };
+    }
+    encoded.copy(output);
+    return { bytesWritten: encoded.length, requiredSize: encoded.length };
+  }
+
+  // Frames are encoded one after another here; the result has the native shape
+  async encodeWebPBatchAsync(frames, width, height, stride, params = {}) {
+    if (!Array.isArray(frames)) {
+      throw new Error('Expected arguments: frames, width, height, stride');
+    }
+    await new Promise(resolve => setImmediate(resolve));
+    // Params are validated once; invalid ones fail the whole batch
+    this._validateParams(params);
+    const startTime = process.hrtime.bigint();
+    const encoded = [];
+    const errors = [];
+    for (const frame of frames) {
+      try {
+        encoded.push(this.encodeWebP(frame, width, height, stride, params));
+        errors.push(null);
+      } catch (error) {
+        encoded.push(null);
+        errors.push(error.message);
+      }
+    }
+    const elapsedMs = Number(process.hrtime.bigint() - startTime) / 1e6;
+    return {
+      frames: encoded,
+      errors,
+      failedFrames: errors.filter(error => error !== null).length,
+      workers: 1,
+      elapsedMs,
+      framesPerSecond: elapsedMs > 0 ? frames.length * 1000 / elapsedMs : 0
+    };
+  }
+
+  // Level sizes and errors follow UltraStreaming::EncodeMultiResolution
+  async encodeMultiResolutionAsync(buffer, width, height, stride, levels) {
+    if (!Buffer.isBuffer(buffer) || !Array.isArray(levels)) {
+      throw new Error('Expected arguments: data, width, height, stride, levels');
+    }
+    stride = stride || width * 4;
+    if (!width || !height || stride < width * 4 || buffer.length < stride * (height - 1) + width * 4) {
+      throw new Error('Buffer too small for the given dimensions');
+    }
+    await new Promise(resolve => setImmediate(resolve));
+    return levels.map(({ scale = 1, maxDimension = 0, ...params } = {}) => {
+      if (!(scale > 0 && scale <= 1)) {
+        return { width: 0, height: 0, scaleFactor: 0, data: null, error: 'Level scale must be in (0, 1]' };
+      }
+      let levelWidth = Math.max(1, Math.round(width * scale));
+      let levelHeight = Math.max(1, Math.round(height * scale));
+      const longer = Math.max(levelWidth, levelHeight);
+      if (maxDimension > 0 && longer > maxDimension) {
+        levelWidth = Math.max(1, Math.round(levelWidth * maxDimension / longer));
+        levelHeight = Math.max(1, Math.round(levelHeight * maxDimension / longer));
+      }
+      const level = { width: levelWidth, height: levelHeight, scaleFactor: levelWidth / width };
+      const fullSize = levelWidth === width && levelHeight === height;
+      if (!fullSize && params.lossless) {
+        return { ...level, data: null, error: 'Downscaled levels are lossy only' };
+      }
+      try {
+        const pixels = fullSize ? buffer : Buffer.alloc(levelWidth * levelHeight * 4);
+        const data = this.encodeWebP(pixels, levelWidth, levelHeight, fullSize ? stride : levelWidth * 4, params);
+        return { ...level, data, error: null };
+      } catch (error) {
+        return { ...level, data: null, error: error.message };
+      }
+    });
+  }
+
+  async encodeWebPAsync(buffer, width, height, stride, params = {}) {
+    await new Promise(resolve => setImmediate(resolve));
+    return this.encodeWebP(buffer, width, height, stride, params);
+  }
+
+  // Each step runs once per process, as in the native module; a step that
+  // already ran reports no time and keeps its first outcome
+  _warmStep(name, work) {
+    const startTime = process.hrtime.bigint();
+    if (!this.warmedSteps.has(name)) {
+      this.warmedSteps.set(name, work());
+    }
+    return {
+      ready: this.warmedSteps.get(name),
+      ms: Number(process.hrtime.bigint() - startTime) / 1e6
+    };
+  }
+
+  warmup(options, callback) {
+    if (typeof options === 'function') {
+      callback = options;
+      options = {};
+    }
+    options = options || {};
+
+    const report = {
+      encoderReady: false,
+      gpuReady: false,
+      captureReady: false,
+      captureBackend: '',
+      encoderMs: 0,
+      gpuMs: 0,
+      captureMs: 0
+    };
+    if (options.encoder !== false) {
+      const step = this._warmStep('encoder', () => {
+        crypto.createHash('sha256').update(Buffer.alloc(16 * 16 * 4)).digest();
+        return true;
+      });
+      report.encoderReady = step.ready;
+      report.encoderMs = step.ms;
+    }
+    if (options.gpu !== false) {
+      // Only the Windows build has a shader to compile
+      const step = this._warmStep('gpu', () => process.platform === 'win32');
+      report.gpuReady = step.ready;
+      report.gpuMs = step.ms;
+    }
+    if (options.capture !== false) {
+      const step = this._warmStep('capture', () => true);
+      report.captureReady = step.ready;
+      report.captureBackend = 'Mock';
+      report.captureMs = step.ms;
+    }
+
+    const settled = new Promise(resolve => setImmediate(() => resolve(report)));
+    if (typeof callback === 'function') {
+      settled.then(result => callback(null, result));
+      return undefined;
+    }
+    return settled;
+  }
+
   // Mock zero-copy functions
   isZeroCopySupported() {
     return process.platform === 'win32'; // Simulate Windows support
@@ -241,7 +608,16 @@ class MockAddon {
       totalChunksProcessed: 25,
       peakMemoryUsageMb: 256,
       averageThroughputMpixelsPerSecond: 15.5,
-      activeWorkerThreads: 4
+      activeWorkerThreads: 4,
+      compressionRatio: 0,
+      tasksStolen: 3,
+      queueLockContentions: 0,
+      workerIdleWaits: 12,
+      memoryBudgetWaits: 0,
+      memoryBudgetWaitMs: 0,
+      numaNodes: 1,
+      crossNodeSteals: 0,
+      placementFailures: 0
     };
   }
 
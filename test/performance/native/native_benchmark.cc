@@ -0,0 +1,1059 @@
+// Standalone microbenchmarks for the native pipeline, built without Node:
+//
+//   WEBP_SCREENSHOT_NATIVE_BENCHMARK=1 node-gyp rebuild
+//   build/Release/native_benchmark --sizes=1080p,4k --filter=encode.
+//
+// Every case runs on synthetic desktop-like frames and on any recorded raw
+// BGRA frames passed with --recorded=WIDTHxHEIGHT:path. Results go to stdout
+// (or --output) as one JSON document; progress goes to stderr.
+//
+// Allocations per frame counts operator new calls in this process plus blocks
+// the memory pool had to request from the system. libwebp's own malloc calls
+// are not included.
+
+#include "common/screenshot_common.h"
+#include <webp/encode.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_allocated_bytes{0};
+
+void* CountedAlloc(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* CountedAlignedAlloc(size_t size, size_t alignment) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, alignment);
+#else
+    void* block = nullptr;
+    if (posix_memalign(&block, std::max(alignment, sizeof(void*)), size ? size : 1) != 0) {
+        return nullptr;
+    }
+    return block;
+#endif
+}
+
+void AlignedFree(void* block) {
+#ifdef _WIN32
+    _aligned_free(block);
+#else
+    std::free(block);
+#endif
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    if (void* block = CountedAlloc(size)) return block;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) {
+    if (void* block = CountedAlloc(size)) return block;
+    throw std::bad_alloc();
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return CountedAlloc(size); }
+void operator delete(void* block) noexcept { std::free(block); }
+void operator delete[](void* block) noexcept { std::free(block); }
+void operator delete(void* block, size_t) noexcept { std::free(block); }
+void operator delete[](void* block, size_t) noexcept { std::free(block); }
+void operator delete(void* block, const std::nothrow_t&) noexcept { std::free(block); }
+void operator delete[](void* block, const std::nothrow_t&) noexcept { std::free(block); }
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    if (void* block = CountedAlignedAlloc(size, static_cast<size_t>(alignment))) return block;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    if (void* block = CountedAlignedAlloc(size, static_cast<size_t>(alignment))) return block;
+    throw std::bad_alloc();
+}
+void operator delete(void* block, std::align_val_t) noexcept { AlignedFree(block); }
+void operator delete[](void* block, std::align_val_t) noexcept { AlignedFree(block); }
+void operator delete(void* block, size_t, std::align_val_t) noexcept { AlignedFree(block); }
+void operator delete[](void* block, size_t, std::align_val_t) noexcept { AlignedFree(block); }
+
+namespace WebPScreenshot {
+namespace Benchmark {
+
+using Clock = std::chrono::steady_clock;
+
+struct Frame {
+    std::string name;        // e.g. "4k-synthetic"
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> bgra;
+    std::vector<uint8_t> rgba;
+
+    uint32_t Stride() const { return width * 4; }
+    uint64_t Pixels() const { return static_cast<uint64_t>(width) * height; }
+};
+
+struct Options {
+    std::vector<std::string> sizes = {"1080p", "4k", "8k"};
+    std::vector<std::string> recorded;   // WIDTHxHEIGHT:path
+    std::vector<std::string> filters;    // Case name prefixes; empty runs everything
+    uint32_t min_iterations = 5;
+    uint32_t max_iterations = 200;
+    double min_time_ms = 1000.0;
+    std::vector<uint32_t> pool_threads;  // Defaults to 1, 2, 4 and hardware_concurrency
+    std::string output_path;
+};
+
+struct CaseResult {
+    std::string name;
+    std::string frame;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool success = false;
+    std::string error;
+    size_t iterations = 0;
+    double mean_ms = 0.0;
+    double p50_ms = 0.0;
+    double p99_ms = 0.0;
+    double mpix_per_sec = 0.0;
+    double allocations_per_frame = 0.0;
+    double allocated_bytes_per_frame = 0.0;
+    size_t output_bytes = 0;
+};
+
+// Frame currently served by the benchmark capture backend
+std::atomic<const Frame*> g_capture_frame{nullptr};
+
+// Desktop-like content: a gradient wallpaper, flat window chrome, rows of
+// high-contrast "text" and one noisy photo region, so encoder timings are
+// closer to real screenshots than a solid or random fill would be.
+Frame MakeSyntheticFrame(const std::string& label, uint32_t width, uint32_t height) {
+    Frame frame;
+    frame.name = label + "-synthetic";
+    frame.width = width;
+    frame.height = height;
+    frame.bgra.resize(static_cast<size_t>(width) * height * 4);
+
+    uint32_t seed = 0x9E3779B9u;
+    auto next_random = [&seed]() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    };
+
+    const uint32_t window_x0 = width / 8, window_x1 = width * 5 / 8;
+    const uint32_t window_y0 = height / 10, window_y1 = height * 8 / 10;
+    const uint32_t photo_x0 = width * 11 / 16, photo_x1 = width * 15 / 16;
+    const uint32_t photo_y0 = height / 4, photo_y1 = height * 3 / 4;
+    const uint32_t line_height = std::max(8u, height / 60);
+
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* row = frame.bgra.data() + static_cast<size_t>(y) * width * 4;
+        const bool text_row = (y - window_y0) % line_height < line_height * 2 / 3;
+
+        for (uint32_t x = 0; x < width; ++x) {
+            uint8_t b = static_cast<uint8_t>(96 + x * 64 / width);
+            uint8_t g = static_cast<uint8_t>(48 + y * 96 / height);
+            uint8_t r = 32;
+
+            if (x >= window_x0 && x < window_x1 && y >= window_y0 && y < window_y1) {
+                if (y < window_y0 + line_height * 2) {
+                    b = 60; g = 56; r = 52;  // Title bar
+                } else {
+                    b = g = r = 250;
+                    if (text_row && x > window_x0 + 16 && (next_random() & 7) < 3) {
+                        b = g = r = 24;  // Glyph strokes
+                    }
+                }
+            } else if (x >= photo_x0 && x < photo_x1 && y >= photo_y0 && y < photo_y1) {
+                const uint32_t noise = next_random();
+                b = static_cast<uint8_t>(80 + (x & 63) + (noise & 15));
+                g = static_cast<uint8_t>(120 + (y & 31) + ((noise >> 8) & 15));
+                r = static_cast<uint8_t>(160 + ((noise >> 16) & 31));
+            }
+
+            row[x * 4 + 0] = b;
+            row[x * 4 + 1] = g;
+            row[x * 4 + 2] = r;
+            row[x * 4 + 3] = 0xFF;
+        }
+    }
+
+    frame.rgba.resize(frame.bgra.size());
+    SIMD::ConvertBGRAToRGBA(frame.bgra.data(), frame.rgba.data(),
+                            static_cast<uint32_t>(frame.Pixels()));
+    return frame;
+}
+
+bool LoadRecordedFrame(const std::string& spec, Frame& frame, std::string& error) {
+    uint32_t width = 0, height = 0;
+    int consumed = 0;
+    if (std::sscanf(spec.c_str(), "%ux%u:%n", &width, &height, &consumed) != 2 ||
+        consumed == 0 || width == 0 || height == 0) {
+        error = "Expected --recorded=WIDTHxHEIGHT:path, got " + spec;
+        return false;
+    }
+
+    const std::string path = spec.substr(consumed);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "Cannot open recorded frame " + path;
+        return false;
+    }
+
+    frame.width = width;
+    frame.height = height;
+    frame.bgra.resize(static_cast<size_t>(width) * height * 4);
+    file.read(reinterpret_cast<char*>(frame.bgra.data()), frame.bgra.size());
+    if (static_cast<size_t>(file.gcount()) != frame.bgra.size()) {
+        error = path + " is smaller than " + std::to_string(frame.bgra.size()) + " bytes";
+        return false;
+    }
+
+    const size_t slash = path.find_last_of("/\\");
+    frame.name = "recorded-" + (slash == std::string::npos ? path : path.substr(slash + 1));
+    frame.rgba.resize(frame.bgra.size());
+    SIMD::ConvertBGRAToRGBA(frame.bgra.data(), frame.rgba.data(),
+                            static_cast<uint32_t>(frame.Pixels()));
+    return true;
+}
+
+double Percentile(std::vector<double> samples, double percentile) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    const size_t rank = static_cast<size_t>(std::ceil(percentile * samples.size()));
+    return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+void Summarize(CaseResult& result, const std::vector<double>& samples_ms,
+               uint64_t pixels_per_sample, uint64_t allocations, uint64_t allocated_bytes) {
+    result.iterations = samples_ms.size();
+    if (samples_ms.empty()) return;
+
+    double total_ms = 0.0;
+    for (double sample : samples_ms) total_ms += sample;
+
+    result.mean_ms = total_ms / samples_ms.size();
+    result.p50_ms = Percentile(samples_ms, 0.50);
+    result.p99_ms = Percentile(samples_ms, 0.99);
+    result.mpix_per_sec = result.mean_ms > 0.0
+        ? (pixels_per_sample / 1e6) / (result.mean_ms / 1000.0) : 0.0;
+    result.allocations_per_frame = static_cast<double>(allocations) / samples_ms.size();
+    result.allocated_bytes_per_frame = static_cast<double>(allocated_bytes) / samples_ms.size();
+}
+
+uint64_t PoolBlocksCreated() {
+    return Utils::GetMemoryPoolStats().total_buffers_created;
+}
+
+// Runs body once to warm caches, then until both the iteration and time
+// minimums are met. body returns false (and sets error) on failure.
+template <typename Body>
+CaseResult RunCase(const std::string& name, const Frame& frame, const Options& options, Body&& body) {
+    CaseResult result;
+    result.name = name;
+    result.frame = frame.name;
+    result.width = frame.width;
+    result.height = frame.height;
+
+    if (!body(result.output_bytes, result.error)) {
+        return result;
+    }
+
+    std::vector<double> samples_ms;
+    samples_ms.reserve(options.max_iterations);
+
+    const uint64_t allocations_before = g_allocations.load();
+    const uint64_t bytes_before = g_allocated_bytes.load();
+    const uint64_t blocks_before = PoolBlocksCreated();
+    const auto started = Clock::now();
+
+    while (samples_ms.size() < options.max_iterations) {
+        const auto t0 = Clock::now();
+        if (!body(result.output_bytes, result.error)) {
+            return result;
+        }
+        samples_ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+
+        const double elapsed_ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+        if (samples_ms.size() >= options.min_iterations && elapsed_ms >= options.min_time_ms) {
+            break;
+        }
+    }
+
+    // The samples vector was reserved up front, so it adds nothing here
+    const uint64_t allocations = g_allocations.load() - allocations_before +
+                                 (PoolBlocksCreated() - blocks_before);
+    Summarize(result, samples_ms, frame.Pixels(), allocations, g_allocated_bytes.load() - bytes_before);
+    result.success = true;
+    return result;
+}
+
+bool Selected(const Options& options, const std::string& name) {
+    if (options.filters.empty()) return true;
+    for (const auto& filter : options.filters) {
+        if (name.compare(0, filter.size(), filter) == 0) return true;
+    }
+    return false;
+}
+
+void BenchmarkConverters(const Frame& frame, const Options& options, std::vector<CaseResult>& results) {
+    std::vector<uint8_t> rgba(frame.bgra.size());
+    std::vector<uint8_t> rgb(frame.Pixels() * 3);
+    const uint32_t chroma_width = (frame.width + 1) / 2;
+    const uint32_t chroma_height = (frame.height + 1) / 2;
+    std::vector<uint8_t> y_plane(frame.Pixels());
+    std::vector<uint8_t> u_plane(static_cast<size_t>(chroma_width) * chroma_height);
+    std::vector<uint8_t> v_plane(u_plane.size());
+
+    for (const auto& isa : SIMD::GetAvailableISAs()) {
+        SIMD::SetISALimit(isa);
+
+        const std::string swizzle_name = "convert.bgra_to_rgba." + isa;
+        if (Selected(options, swizzle_name)) {
+            results.push_back(RunCase(swizzle_name, frame, options,
+                [&](size_t& output_bytes, std::string&) {
+                    SIMD::ConvertBGRAToRGBA(frame.bgra.data(), rgba.data(),
+                                            static_cast<uint32_t>(frame.Pixels()));
+                    output_bytes = rgba.size();
+                    return true;
+                }));
+        }
+
+        const std::string rgb_name = "convert.rgba_to_rgb." + isa;
+        if (Selected(options, rgb_name)) {
+            results.push_back(RunCase(rgb_name, frame, options,
+                [&](size_t& output_bytes, std::string&) {
+                    SIMD::ConvertRGBAToRGB(frame.rgba.data(), rgb.data(),
+                                           static_cast<uint32_t>(frame.Pixels()));
+                    output_bytes = rgb.size();
+                    return true;
+                }));
+        }
+
+        const std::string yuv_name = "convert.bgra_to_yuv420." + isa;
+        if (Selected(options, yuv_name)) {
+            results.push_back(RunCase(yuv_name, frame, options,
+                [&](size_t& output_bytes, std::string&) {
+                    SIMD::ConvertToYUV420(frame.bgra.data(), frame.width, frame.height, frame.Stride(),
+                                          4, true, y_plane.data(), static_cast<int>(frame.width),
+                                          u_plane.data(), v_plane.data(), static_cast<int>(chroma_width),
+                                          nullptr, 0);
+                    output_bytes = y_plane.size() + u_plane.size() * 2;
+                    return true;
+                }));
+        }
+    }
+
+    SIMD::SetISALimit("auto");
+}
+
+// Each thread keeps a few frames in flight, like a capture ring, so requests
+// overflow the per-thread cache and reach the shared free lists
+void BenchmarkPool(const Frame& frame, const Options& options, std::vector<CaseResult>& results) {
+    constexpr size_t kFramesInFlight = 4;
+    const size_t frame_bytes = frame.bgra.size();
+
+    for (uint32_t threads : options.pool_threads) {
+        const std::string name = "pool.contention." + std::to_string(threads) + "t";
+        if (!Selected(options, name)) continue;
+
+        CaseResult result;
+        result.name = name;
+        result.frame = frame.name;
+        result.width = frame.width;
+        result.height = frame.height;
+
+        ScreenshotMemoryPool pool;
+        const uint32_t ops_per_thread = std::max<uint32_t>(options.min_iterations * 8, 64);
+        std::vector<std::vector<double>> thread_samples(threads);
+        for (auto& samples : thread_samples) samples.reserve(ops_per_thread);
+        std::vector<std::vector<PoolBuffer>> held(threads);
+        for (auto& ring : held) ring.reserve(kFramesInFlight + 1);
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        std::atomic<bool> go{false};
+
+        const uint64_t allocations_before = g_allocations.load();
+        const uint64_t bytes_before = g_allocated_bytes.load();
+        const uint64_t blocks_before = pool.GetStats().total_buffers_created;
+
+        for (uint32_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+                auto& ring = held[t];
+                auto& samples = thread_samples[t];
+                for (uint32_t op = 0; op < ops_per_thread; ++op) {
+                    const auto t0 = Clock::now();
+                    PoolBuffer buffer = pool.GetBuffer(frame_bytes);
+                    buffer[0] = static_cast<uint8_t>(op);
+                    buffer[frame_bytes - 1] = static_cast<uint8_t>(op);
+                    ring.push_back(std::move(buffer));
+                    if (ring.size() > kFramesInFlight) {
+                        ring.erase(ring.begin());
+                    }
+                    samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+                }
+                ring.clear();
+            });
+        }
+
+        const auto started = Clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& worker : workers) worker.join();
+        const double wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+
+        const uint64_t allocations = g_allocations.load() - allocations_before +
+                                     (pool.GetStats().total_buffers_created - blocks_before);
+        const uint64_t allocated_bytes = g_allocated_bytes.load() - bytes_before;
+
+        std::vector<double> samples_ms;
+        for (const auto& samples : thread_samples) {
+            samples_ms.insert(samples_ms.end(), samples.begin(), samples.end());
+        }
+        Summarize(result, samples_ms, frame.Pixels(), allocations, allocated_bytes);
+
+        // Aggregate throughput across all threads rather than per request
+        result.mpix_per_sec = wall_ms > 0.0
+            ? (frame.Pixels() * samples_ms.size() / 1e6) / (wall_ms / 1000.0) : 0.0;
+        result.output_bytes = frame_bytes;
+        result.success = true;
+        results.push_back(std::move(result));
+    }
+}
+
+WebPEncodeParams BaseParams() {
+    WebPEncodeParams params;
+    params.quality = 80.0f;
+    params.method = 4;
+    params.enable_multithreading = false;
+    return params;
+}
+
+void BenchmarkEncoder(const Frame& frame, const Options& options, std::vector<CaseResult>& results) {
+    WebPEncoder encoder;
+    auto encode_case = [&](const std::string& name, const WebPEncodeParams& params) {
+        if (!Selected(options, name)) return;
+        results.push_back(RunCase(name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                auto webp = encoder.EncodeBGRA(frame.bgra.data(), frame.width, frame.height,
+                                               frame.Stride(), params, false);
+                if (webp.empty()) {
+                    error = encoder.GetLastError();
+                    return false;
+                }
+                output_bytes = webp.size();
+                return true;
+            }));
+    };
+
+    for (int method = 0; method <= 6; ++method) {
+        WebPEncodeParams params = BaseParams();
+        params.method = method;
+        encode_case("encode.method" + std::to_string(method), params);
+    }
+
+    // Tiling only kicks in at two or more megapixels with two or more threads
+    WebPEncodeParams single = BaseParams();
+    encode_case("encode.single", single);
+
+    WebPEncodeParams tiled = BaseParams();
+    tiled.enable_multithreading = true;
+    encode_case("encode.tiled", tiled);
+
+    // Lossless for UI tiles, low-method lossy for photos
+    WebPEncodeParams adaptive = BaseParams();
+    adaptive.content_adaptive = 1;
+    encode_case("encode.adaptive", adaptive);
+
+    // Method 6 requested under budgets tight enough to force lower methods
+    for (float budget_ms : {50.0f, 200.0f}) {
+        WebPEncodeParams budgeted = BaseParams();
+        budgeted.method = 6;
+        budgeted.max_encode_ms = budget_ms;
+        encode_case("encode.budget" + std::to_string(static_cast<int>(budget_ms)) + "ms", budgeted);
+    }
+
+    // Two displays side by side on one virtual-desktop canvas
+    const std::string canvas_name = "encode.canvas";
+    if (Selected(options, canvas_name)) {
+        std::vector<WebPEncoder::CanvasLayer> layers(2);
+        for (size_t i = 0; i < layers.size(); ++i) {
+            layers[i].data = frame.bgra.data();
+            layers[i].width = frame.width;
+            layers[i].height = frame.height;
+            layers[i].stride = frame.Stride();
+            layers[i].x = static_cast<int32_t>(i * frame.width);
+            layers[i].layout = WebPEncoder::PixelLayout::BGRX;
+        }
+        const WebPEncodeParams params = BaseParams();
+        results.push_back(RunCase(canvas_name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                auto webp = encoder.EncodeCanvas(layers, frame.width * 2, frame.height, params);
+                if (webp.empty()) {
+                    error = encoder.GetLastError();
+                    return false;
+                }
+                output_bytes = webp.size();
+                return true;
+            }));
+    }
+
+    // Same encode as encode.single, streamed in 64 KB chunks to a sink that
+    // only counts them
+    const std::string streaming_name = "encode.streaming";
+    if (Selected(options, streaming_name)) {
+        struct CountingSink : WebPEncoder::StreamingCallback {
+            size_t bytes = 0;
+            bool OnDataChunk(const uint8_t*, size_t size) override {
+                bytes += size;
+                return true;
+            }
+            void OnComplete(bool, const std::string&) override {}
+        };
+
+        const WebPEncodeParams params = BaseParams();
+        results.push_back(RunCase(streaming_name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                CountingSink sink;
+                if (!encoder.EncodeStreamingWithCallback(frame.bgra.data(), frame.width, frame.height,
+                                                         frame.Stride(), WebPEncoder::PixelLayout::BGRX,
+                                                         params, &sink)) {
+                    error = encoder.GetLastError();
+                    return false;
+                }
+                output_bytes = sink.bytes;
+                return true;
+            }));
+    }
+
+    // Polling an unchanged screen: after the first iteration every encode is
+    // a whole-frame hit in the tile cache
+    WebPEncodeParams cached = BaseParams();
+    cached.tile_cache = 1;
+    TileCache::Clear();
+    encode_case("encode.tile_cache_static", cached);
+
+    // A cursor-sized patch takes a new value every frame, so only the tiles
+    // under it are encoded again
+    const std::string tile_delta_name = "encode.tile_cache_delta";
+    if (Selected(options, tile_delta_name)) {
+        constexpr uint32_t kPatch = 64;
+        std::vector<uint8_t> changed = frame.bgra;
+        const uint32_t patch_x = (frame.width - std::min(frame.width, kPatch)) / 2;
+        const uint32_t patch_y = (frame.height - std::min(frame.height, kPatch)) / 2;
+        uint8_t value = 0;
+        TileCache::Clear();
+        results.push_back(RunCase(tile_delta_name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                ++value;
+                for (uint32_t y = patch_y; y < std::min(frame.height, patch_y + kPatch); ++y) {
+                    for (uint32_t x = patch_x; x < std::min(frame.width, patch_x + kPatch); ++x) {
+                        const size_t offset = static_cast<size_t>(y) * frame.Stride() + x * 4;
+                        changed[offset] = frame.bgra[offset] ^ value;
+                    }
+                }
+                auto webp = encoder.EncodeBGRA(changed.data(), frame.width, frame.height,
+                                               frame.Stride(), cached, false);
+                if (webp.empty()) {
+                    error = encoder.GetLastError();
+                    return false;
+                }
+                output_bytes = webp.size();
+                return true;
+            }));
+    }
+    TileCache::Clear();
+
+    // Session-replay recording: a cursor-sized patch changes between frames,
+    // so each iteration diffs the frame and encodes only the patch
+    const std::string animation_name = "encode.animation_delta";
+    if (Selected(options, animation_name)) {
+        constexpr uint32_t kPatch = 64;
+        std::vector<uint8_t> changed = frame.bgra;
+        const uint32_t patch_x = (frame.width - std::min(frame.width, kPatch)) / 2;
+        const uint32_t patch_y = (frame.height - std::min(frame.height, kPatch)) / 2;
+        for (uint32_t y = patch_y; y < std::min(frame.height, patch_y + kPatch); ++y) {
+            for (uint32_t x = patch_x; x < std::min(frame.width, patch_x + kPatch); ++x) {
+                changed[static_cast<size_t>(y) * frame.Stride() + x * 4] ^= 0xFF;
+            }
+        }
+
+        AnimationRecorder::Config config;
+        config.params = BaseParams();
+        config.keyframe_interval_ms = 0;
+        AnimationRecorder recorder(config);
+        uint64_t timestamp_us = 0;
+        uint64_t frame_index = 0;
+        results.push_back(RunCase(animation_name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                const uint64_t written = recorder.GetStats().output_bytes;
+                const std::vector<uint8_t>& source = (frame_index++ & 1) ? changed : frame.bgra;
+                timestamp_us += 33333;
+                if (!recorder.AddFrame(source.data(), frame.width, frame.height, frame.Stride(),
+                                       WebPEncoder::PixelLayout::BGRX, timestamp_us)) {
+                    error = recorder.GetLastError();
+                    return false;
+                }
+                // Frames are written once the next one arrives
+                output_bytes = recorder.GetStats().output_bytes - written;
+                return true;
+            }));
+    }
+}
+
+// Box-averaged copy of an RGBA frame, standing in for an app-side resize
+std::vector<uint8_t> ScaleRGBA(const Frame& frame, uint32_t width, uint32_t height) {
+    std::vector<uint8_t> scaled(static_cast<size_t>(width) * height * 4);
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint32_t y0 = static_cast<uint32_t>(static_cast<uint64_t>(y) * frame.height / height);
+        const uint32_t y1 = std::max(y0 + 1, static_cast<uint32_t>(static_cast<uint64_t>(y + 1) * frame.height / height));
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t x0 = static_cast<uint32_t>(static_cast<uint64_t>(x) * frame.width / width);
+            const uint32_t x1 = std::max(x0 + 1, static_cast<uint32_t>(static_cast<uint64_t>(x + 1) * frame.width / width));
+            for (uint32_t c = 0; c < 4; ++c) {
+                uint32_t sum = 0;
+                for (uint32_t sy = y0; sy < y1; ++sy) {
+                    for (uint32_t sx = x0; sx < x1; ++sx) {
+                        sum += frame.rgba[static_cast<size_t>(sy) * frame.Stride() + sx * 4 + c];
+                    }
+                }
+                scaled[(static_cast<size_t>(y) * width + x) * 4 + c] =
+                    static_cast<uint8_t>(sum / ((x1 - x0) * (y1 - y0)));
+            }
+        }
+    }
+    return scaled;
+}
+
+void BenchmarkPipeline(const Frame& frame, const Options& options, std::vector<CaseResult>& results) {
+    UltraStreaming::InitializeUltraStreaming();
+
+    const std::string name = "pipeline.end_to_end";
+    if (Selected(options, name)) {
+        g_capture_frame.store(&frame);
+
+        const WebPEncodeParams params = BaseParams();
+        results.push_back(RunCase(name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                std::string status;
+                auto webp = UltraStreaming::CaptureAndEncodeUltraLarge(0, params,
+                    [&status](double, const std::string& message) {
+                        status = message;
+                        return true;
+                    }).get();
+                if (webp.empty()) {
+                    error = status.empty() ? "Pipeline produced no output" : status;
+                    return false;
+                }
+                output_bytes = webp.size();
+                return true;
+            }));
+
+        g_capture_frame.store(nullptr);
+    }
+
+    // 2048 px chunks with the default tiling and content-adaptive settings:
+    // every chunk must still come back as one picture the frame can hold
+    const std::string large_chunks_name = "pipeline.large_chunks";
+    if (Selected(options, large_chunks_name)) {
+        g_capture_frame.store(&frame);
+        UltraStreaming::ConfigureUltraStreaming(2048, 2048, 2048, 6);
+
+        WebPEncodeParams params = BaseParams();
+        params.enable_multithreading = true;
+        params.content_adaptive = 1;
+        results.push_back(RunCase(large_chunks_name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                std::string status;
+                auto webp = UltraStreaming::CaptureAndEncodeUltraLarge(0, params,
+                    [&status](double, const std::string& message) {
+                        status = message;
+                        return true;
+                    }).get();
+                if (webp.empty()) {
+                    error = status.empty() ? "Pipeline produced no output" : status;
+                    return false;
+                }
+                output_bytes = webp.size();
+                return true;
+            }));
+
+        UltraStreaming::ConfigureUltraStreaming(512, 512, 1024, 6);
+        g_capture_frame.store(nullptr);
+    }
+
+    // max_output_size at half the uncapped file: the chunks split the target
+    // and the frame is encoded again until the combined file fits
+    const std::string capped_name = "pipeline.max_output_size";
+    if (Selected(options, capped_name)) {
+        g_capture_frame.store(&frame);
+
+        WebPEncodeParams params = BaseParams();
+        const size_t uncapped = UltraStreaming::CaptureAndEncodeUltraLarge(0, params).get().size();
+        params.max_output_size = static_cast<int>(uncapped / 2);
+        results.push_back(RunCase(capped_name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                std::string status;
+                auto webp = UltraStreaming::CaptureAndEncodeUltraLarge(0, params,
+                    [&status](double, const std::string& message) {
+                        status = message;
+                        return true;
+                    }).get();
+                if (webp.empty()) {
+                    error = status.empty() ? "Pipeline produced no output" : status;
+                    return false;
+                }
+                if (webp.size() > static_cast<size_t>(params.max_output_size)) {
+                    error = "Output of " + std::to_string(webp.size()) + " bytes exceeds max_output_size";
+                    return false;
+                }
+                output_bytes = webp.size();
+                return true;
+            }));
+
+        g_capture_frame.store(nullptr);
+    }
+
+    // Full, half and 256 px thumbnail of one frame: three encodes of
+    // pre-scaled RGBA (scaling untimed) against one pyramid call
+    std::vector<UltraStreaming::PyramidLevelSpec> levels(3);
+    levels[1].scale = 0.5f;
+    levels[2].max_dimension = 256;
+    for (auto& level : levels) {
+        level.params = BaseParams();
+    }
+
+    const std::string separate_name = "pipeline.pyramid_separate";
+    if (Selected(options, separate_name)) {
+        const uint32_t half_width = (frame.width + 1) / 2;
+        const uint32_t half_height = (frame.height + 1) / 2;
+        const double thumb_scale = 256.0 / std::max(frame.width, frame.height);
+        const uint32_t thumb_width = std::max(1u, static_cast<uint32_t>(std::lround(frame.width * thumb_scale)));
+        const uint32_t thumb_height = std::max(1u, static_cast<uint32_t>(std::lround(frame.height * thumb_scale)));
+        const std::vector<uint8_t> half = ScaleRGBA(frame, half_width, half_height);
+        const std::vector<uint8_t> thumb = ScaleRGBA(frame, thumb_width, thumb_height);
+
+        WebPEncoder encoder;
+        results.push_back(RunCase(separate_name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                auto full_webp = encoder.EncodeRGBA(frame.rgba.data(), frame.width, frame.height,
+                                                    frame.Stride(), levels[0].params);
+                auto half_webp = encoder.EncodeRGBA(half.data(), half_width, half_height,
+                                                    half_width * 4, levels[1].params);
+                auto thumb_webp = encoder.EncodeRGBA(thumb.data(), thumb_width, thumb_height,
+                                                     thumb_width * 4, levels[2].params);
+                if (full_webp.empty() || half_webp.empty() || thumb_webp.empty()) {
+                    error = encoder.GetLastError();
+                    return false;
+                }
+                output_bytes = full_webp.size() + half_webp.size() + thumb_webp.size();
+                return true;
+            }));
+    }
+
+    const std::string pyramid_name = "pipeline.pyramid";
+    if (Selected(options, pyramid_name)) {
+        ScreenshotResult screenshot;
+        screenshot.data = Utils::AllocateScreenshotBuffer(frame.rgba.size());
+        if (screenshot.data) {
+            std::memcpy(screenshot.data.get(), frame.rgba.data(), frame.rgba.size());
+            screenshot.width = frame.width;
+            screenshot.height = frame.height;
+            screenshot.stride = frame.Stride();
+            screenshot.bytes_per_pixel = 4;
+            screenshot.data_size = static_cast<uint32_t>(frame.rgba.size());
+            screenshot.format = "RGBA";
+            screenshot.success = true;
+        }
+
+        results.push_back(RunCase(pyramid_name, frame, options,
+            [&](size_t& output_bytes, std::string& error) {
+                auto pyramid = UltraStreaming::EncodeMultiResolution(screenshot, levels);
+                output_bytes = 0;
+                for (const auto& level : pyramid) {
+                    if (level.encoded_data.empty()) {
+                        error = level.error_message;
+                        return false;
+                    }
+                    output_bytes += level.encoded_data.size();
+                }
+                return true;
+            }));
+    }
+}
+
+std::string JsonEscape(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+std::string ToJson(const std::vector<CaseResult>& results) {
+    const int version = WebPGetEncoderVersion();
+    std::ostringstream out;
+    out.precision(6);
+    out << "{\n  \"system\": {"
+        << "\"simd\": \"" << JsonEscape(SIMD::GetSIMDCapabilities()) << "\", "
+        << "\"hardware_threads\": " << std::thread::hardware_concurrency() << ", "
+        << "\"libwebp\": \"" << (version >> 16) << '.' << ((version >> 8) & 0xFF) << '.' << (version & 0xFF)
+        << "\"},\n  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << (i ? ",\n" : "\n") << "    {"
+            << "\"name\": \"" << JsonEscape(r.name) << "\", "
+            << "\"frame\": \"" << JsonEscape(r.frame) << "\", "
+            << "\"width\": " << r.width << ", \"height\": " << r.height << ", "
+            << "\"success\": " << (r.success ? "true" : "false") << ", ";
+        if (!r.success) {
+            out << "\"error\": \"" << JsonEscape(r.error) << "\"}";
+            continue;
+        }
+        out << "\"iterations\": " << r.iterations << ", "
+            << "\"mpix_per_sec\": " << r.mpix_per_sec << ", "
+            << "\"mean_ms\": " << r.mean_ms << ", "
+            << "\"p50_ms\": " << r.p50_ms << ", "
+            << "\"p99_ms\": " << r.p99_ms << ", "
+            << "\"allocations_per_frame\": " << r.allocations_per_frame << ", "
+            << "\"allocated_bytes_per_frame\": " << r.allocated_bytes_per_frame << ", "
+            << "\"output_bytes\": " << r.output_bytes << "}";
+    }
+
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+std::vector<std::string> SplitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+bool ParseOptions(int argc, char** argv, Options& options, std::string& error) {
+    bool threads_given = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const size_t equals = arg.find('=');
+        const std::string key = arg.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+
+        if (key == "--sizes") {
+            options.sizes = SplitList(value);
+        } else if (key == "--recorded") {
+            options.recorded.push_back(value);
+        } else if (key == "--filter") {
+            options.filters = SplitList(value);
+        } else if (key == "--min-iterations") {
+            options.min_iterations = std::max(1, std::atoi(value.c_str()));
+        } else if (key == "--max-iterations") {
+            options.max_iterations = std::max(1, std::atoi(value.c_str()));
+        } else if (key == "--min-time-ms") {
+            options.min_time_ms = std::max(0.0, std::atof(value.c_str()));
+        } else if (key == "--pool-threads") {
+            for (const auto& count : SplitList(value)) {
+                options.pool_threads.push_back(std::max(1, std::atoi(count.c_str())));
+            }
+            threads_given = true;
+        } else if (key == "--output") {
+            options.output_path = value;
+        } else {
+            error = "Unknown option " + arg + "\n"
+                    "Options: --sizes=1080p,4k,8k --recorded=WIDTHxHEIGHT:path --filter=prefix,...\n"
+                    "         --min-iterations=N --max-iterations=N --min-time-ms=MS\n"
+                    "         --pool-threads=1,2,4 --output=results.json";
+            return false;
+        }
+    }
+
+    options.max_iterations = std::max(options.max_iterations, options.min_iterations);
+    if (!threads_given) {
+        const uint32_t hardware = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t count : {1u, 2u, 4u, hardware}) {
+            if (count <= hardware &&
+                std::find(options.pool_threads.begin(), options.pool_threads.end(), count) ==
+                    options.pool_threads.end()) {
+                options.pool_threads.push_back(count);
+            }
+        }
+    }
+    return true;
+}
+
+bool ResolveSize(const std::string& size, uint32_t& width, uint32_t& height) {
+    if (size == "1080p") { width = 1920; height = 1080; return true; }
+    if (size == "1440p") { width = 2560; height = 1440; return true; }
+    if (size == "4k") { width = 3840; height = 2160; return true; }
+    if (size == "8k") { width = 7680; height = 4320; return true; }
+    return std::sscanf(size.c_str(), "%ux%u", &width, &height) == 2 && width > 0 && height > 0;
+}
+
+} // namespace Benchmark
+
+// Capture backend for the pipeline case: serves the frame under test with
+// the same pool allocation and copy a platform backend would make
+namespace {
+
+class BenchmarkCapture : public ScreenshotCapture {
+public:
+    std::vector<DisplayInfo> GetDisplays() override {
+        DisplayInfo display{};
+        if (const Benchmark::Frame* frame = Benchmark::g_capture_frame.load()) {
+            display.width = frame->width;
+            display.height = frame->height;
+        }
+        display.scale_factor = 1.0f;
+        display.is_primary = true;
+        display.name = "Benchmark";
+        return {display};
+    }
+
+    ScreenshotResult CaptureDisplay(uint32_t display_index) override {
+        ScreenshotResult result;
+        const Benchmark::Frame* frame = Benchmark::g_capture_frame.load();
+        if (!frame || display_index != 0) {
+            result.error_message = "No benchmark frame for display " + std::to_string(display_index);
+            return result;
+        }
+
+        result.data = Utils::AllocateScreenshotBuffer(frame->rgba.size());
+        if (!result.data) {
+            result.error_message = "Failed to allocate capture buffer";
+            return result;
+        }
+        std::memcpy(result.data.get(), frame->rgba.data(), frame->rgba.size());
+        result.width = frame->width;
+        result.height = frame->height;
+        result.stride = frame->Stride();
+        result.bytes_per_pixel = 4;
+        result.data_size = static_cast<uint32_t>(frame->rgba.size());
+        result.format = "RGBA";
+        result.implementation = GetImplementationName();
+        result.success = true;
+        return result;
+    }
+
+    std::vector<ScreenshotResult> CaptureAllDisplays() override {
+        std::vector<ScreenshotResult> results;
+        results.push_back(CaptureDisplay(0));
+        return results;
+    }
+
+    bool IsSupported() override { return true; }
+    std::string GetImplementationName() override { return "Benchmark"; }
+};
+
+} // namespace
+
+std::unique_ptr<ScreenshotCapture> CreateScreenshotCapture() {
+    return std::make_unique<BenchmarkCapture>();
+}
+
+} // namespace WebPScreenshot
+
+int main(int argc, char** argv) {
+    using namespace WebPScreenshot::Benchmark;
+
+    Options options;
+    std::string error;
+    if (!ParseOptions(argc, argv, options, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+
+    std::vector<Frame> frames;
+    for (const auto& size : options.sizes) {
+        uint32_t width = 0, height = 0;
+        if (!ResolveSize(size, width, height)) {
+            std::fprintf(stderr, "Unknown size %s (use 1080p, 1440p, 4k, 8k or WIDTHxHEIGHT)\n", size.c_str());
+            return 2;
+        }
+        frames.push_back(MakeSyntheticFrame(size, width, height));
+    }
+    for (const auto& spec : options.recorded) {
+        Frame frame;
+        if (!LoadRecordedFrame(spec, frame, error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 2;
+        }
+        frames.push_back(std::move(frame));
+    }
+
+    std::vector<CaseResult> results;
+    for (const auto& frame : frames) {
+        std::fprintf(stderr, "%s (%ux%u)\n", frame.name.c_str(), frame.width, frame.height);
+        const size_t first = results.size();
+
+        BenchmarkConverters(frame, options, results);
+        BenchmarkPool(frame, options, results);
+        BenchmarkEncoder(frame, options, results);
+        BenchmarkPipeline(frame, options, results);
+
+        for (size_t i = first; i < results.size(); ++i) {
+            const auto& r = results[i];
+            if (r.success) {
+                std::fprintf(stderr, "  %-32s %10.1f MPix/s  p50 %9.3f ms  p99 %9.3f ms  %8.1f allocs/frame\n",
+                             r.name.c_str(), r.mpix_per_sec, r.p50_ms, r.p99_ms, r.allocations_per_frame);
+            } else {
+                std::fprintf(stderr, "  %-32s FAILED: %s\n", r.name.c_str(), r.error.c_str());
+            }
+        }
+    }
+
+    const std::string json = ToJson(results);
+    if (options.output_path.empty()) {
+        std::fwrite(json.data(), 1, json.size(), stdout);
+    } else {
+        std::ofstream out(options.output_path, std::ios::binary);
+        out << json;
+        if (!out) {
+            std::fprintf(stderr, "Failed to write %s\n", options.output_path.c_str());
+            return 1;
+        }
+    }
+
+    const bool all_passed = std::all_of(results.begin(), results.end(),
+                                        [](const CaseResult& r) { return r.success; });
+    return all_passed ? 0 : 1;
+}
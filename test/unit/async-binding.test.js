@@ -0,0 +1,71 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+describe('Async Binding Unit Tests', function() {
+  this.timeout(10000);
+
+  describe('captureScreenshotAsync', function() {
+    it('should return a Promise resolving to raw pixels', async function() {
+      const pending = addon.captureScreenshotAsync({ display: 0 });
+      expect(pending).to.be.instanceOf(Promise);
+
+      const result = await pending;
+      expect(result.success).to.be.true;
+      expect(result.data).to.be.instanceOf(Buffer);
+      expect(result.stride).to.equal(result.width * 4);
+      expect(result.data.length).to.equal(result.stride * result.height);
+    });
+
+    it('should allow concurrent captures', async function() {
+      const results = await Promise.all([
+        addon.captureScreenshotAsync(),
+        addon.captureScreenshotAsync()
+      ]);
+
+      results.forEach(result => {
+        expect(result.success).to.be.true;
+        expect(result.data.length).to.be.greaterThan(0);
+      });
+    });
+  });
+
+  describe('encodeWebPAsync', function() {
+    it('should resolve to a WebP buffer', async function() {
+      const width = 64;
+      const height = 64;
+      const pixels = Buffer.alloc(width * height * 4, 0x80);
+
+      const encoded = await addon.encodeWebPAsync(pixels, width, height, width * 4, { quality: 75 });
+      expect(encoded).to.be.instanceOf(Buffer);
+      expect(encoded.toString('ascii', 0, 4)).to.equal('RIFF');
+      expect(encoded.toString('ascii', 8, 12)).to.equal('WEBP');
+    });
+
+    it('should accept a Uint8Array view with an offset', async function() {
+      const width = 16;
+      const height = 16;
+      const backing = Buffer.alloc(width * height * 4 + 32, 0x40);
+      const view = backing.subarray(32);
+
+      const encoded = await addon.encodeWebPAsync(view, width, height, width * 4, {});
+      expect(encoded.length).to.be.greaterThan(12);
+    });
+  });
+
+  describe('captureDisplayAsync', function() {
+    it('should capture and encode in one call', async function() {
+      const result = await addon.captureDisplayAsync(0, { quality: 60 });
+      expect(result.success).to.be.true;
+      expect(result.format).to.equal('webp');
+      expect(result.data).to.be.instanceOf(Buffer);
+      expect(result.data.toString('ascii', 0, 4)).to.equal('RIFF');
+    });
+  });
+});
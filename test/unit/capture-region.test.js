@@ -0,0 +1,80 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+describe('Capture Region Unit Tests', function() {
+  this.timeout(10000);
+
+  let displayWidth;
+  let displayHeight;
+
+  before(async function() {
+    const full = await addon.captureScreenshotAsync({ display: 0 });
+    displayWidth = full.width;
+    displayHeight = full.height;
+  });
+
+  beforeEach(function() {
+    addon.resetPerformanceStats();
+  });
+
+  it('should return only the requested rectangle', async function() {
+    const result = await addon.captureScreenshotAsync({
+      display: 0,
+      region: { x: 16, y: 8, width: 64, height: 48 }
+    });
+
+    expect(result.width).to.equal(64);
+    expect(result.height).to.equal(48);
+    expect(result.data.length).to.equal(64 * 48 * 4);
+  });
+
+  it('should not read back more than the rectangle', async function() {
+    await addon.captureScreenshotAsync({ display: 0, region: { width: 32, height: 32 } });
+
+    const stats = addon.getPerformanceStats();
+    expect(stats.bytesCopied).to.be.at.most(32 * 32 * 4);
+  });
+
+  it('should clip a rectangle that runs past the display edge', async function() {
+    const result = await addon.captureScreenshotAsync({
+      display: 0,
+      region: { x: displayWidth - 10, y: displayHeight - 6, width: 100, height: 100 }
+    });
+
+    expect(result.width).to.equal(10);
+    expect(result.height).to.equal(6);
+  });
+
+  it('should extend a region without a size to the display edges', async function() {
+    const result = await addon.captureScreenshotAsync({ display: 0, region: { x: 20, y: 10 } });
+
+    expect(result.width).to.equal(displayWidth - 20);
+    expect(result.height).to.equal(displayHeight - 10);
+  });
+
+  it('should reject a rectangle outside the display', async function() {
+    let error;
+    try {
+      await addon.captureScreenshotAsync({ display: 0, region: { x: displayWidth, y: 0, width: 8, height: 8 } });
+    } catch (e) {
+      error = e;
+    }
+    expect(error).to.be.instanceOf(Error);
+  });
+
+  it('should encode just the region in captureDisplayAsync', async function() {
+    const result = await addon.captureDisplayAsync(0, { quality: 70, region: { width: 40, height: 30 } });
+
+    expect(result.format).to.equal('webp');
+    expect(result.width).to.equal(40);
+    expect(result.height).to.equal(30);
+    expect(result.data.toString('ascii', 0, 4)).to.equal('RIFF');
+  });
+});
@@ -0,0 +1,85 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+const { expectWebP } = require('../webp-helpers');
+
+function chunkTag(webp) {
+  return webp.toString('ascii', 12, 16);
+}
+
+// Window-like frame: flat panels, a title bar and rows of "text"
+function createUiFrame(width, height) {
+  const pixels = Buffer.alloc(width * height * 4);
+  for (let y = 0; y < height; y++) {
+    for (let x = 0; x < width; x++) {
+      const i = (y * width + x) * 4;
+      let value = 0xF0;
+      if (y < 24) {
+        value = 0x30;
+      } else if (y % 16 < 10 && x % 8 < 5 && x > 16 && x < width - 16) {
+        value = 0x10;
+      }
+      pixels[i] = value;
+      pixels[i + 1] = value;
+      pixels[i + 2] = value;
+      pixels[i + 3] = 255;
+    }
+  }
+  return pixels;
+}
+
+function createNoiseFrame(width, height) {
+  const pixels = Buffer.alloc(width * height * 4);
+  let seed = 12345;
+  for (let i = 0; i < pixels.length; i++) {
+    seed = (seed * 1103515245 + 12345) >>> 0;
+    pixels[i] = (i % 4 === 3) ? 255 : (seed >>> 16) & 0xFF;
+  }
+  return pixels;
+}
+
+describe('Content-Adaptive Encoding Unit Tests', function() {
+  this.timeout(10000);
+
+  const width = 256;
+  const height = 192;
+
+  it('should encode flat UI content losslessly', function() {
+    const webp = addon.encodeWebP(createUiFrame(width, height), width, height, width * 4,
+      { contentAdaptive: 1, quality: 80 });
+
+    expectWebP(webp);
+    expect(chunkTag(webp)).to.equal('VP8L');
+  });
+
+  it('should keep photographic content lossy', function() {
+    const webp = addon.encodeWebP(createNoiseFrame(width, height), width, height, width * 4,
+      { contentAdaptive: 1, quality: 80 });
+
+    expectWebP(webp);
+    expect(chunkTag(webp)).to.equal('VP8 ');
+  });
+
+  it('should leave lossy encoding unchanged when disabled', function() {
+    const webp = addon.encodeWebP(createUiFrame(width, height), width, height, width * 4,
+      { quality: 80 });
+
+    expectWebP(webp);
+    expect(chunkTag(webp)).to.equal('VP8 ');
+  });
+
+  it('should work through the async encoder', async function() {
+    const webp = await addon.encodeWebPAsync(createUiFrame(width, height), width, height, width * 4,
+      { contentAdaptive: 1 });
+
+    expectWebP(webp);
+    expect(chunkTag(webp)).to.equal('VP8L');
+  });
+});
@@ -0,0 +1,65 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+const { expectWebP, createGradientFrame } = require('../webp-helpers');
+
+describe('Encode Batch Unit Tests', function() {
+  this.timeout(30000);
+
+  const width = 320;
+  const height = 240;
+
+  it('should return one WebP per frame in input order', async function() {
+    const frames = [0, 1, 2, 3, 4, 5].map(seed => createGradientFrame(width, height, seed));
+    const result = await addon.encodeWebPBatchAsync(frames, width, height, width * 4, { quality: 80 });
+
+    expect(result.frames).to.have.length(frames.length);
+    expect(result.failedFrames).to.equal(0);
+    result.frames.forEach(expectWebP);
+  });
+
+  it('should match single-frame encodes', async function() {
+    const frames = [7, 8].map(seed => createGradientFrame(width, height, seed));
+    const options = { quality: 75, method: 4 };
+    const result = await addon.encodeWebPBatchAsync(frames, width, height, width * 4, options);
+
+    frames.forEach((frame, i) => {
+      const single = addon.encodeWebP(frame, width, height, width * 4, options);
+      expect(result.frames[i].length).to.be.closeTo(single.length, single.length * 0.5);
+    });
+  });
+
+  it('should report throughput', async function() {
+    const frames = [0, 1, 2].map(seed => createGradientFrame(width, height, seed));
+    const result = await addon.encodeWebPBatchAsync(frames, width, height, width * 4);
+
+    expect(result.workers).to.be.at.least(1);
+    expect(result.elapsedMs).to.be.at.least(0);
+    expect(result.framesPerSecond).to.be.a('number');
+  });
+
+  it('should handle an empty batch', async function() {
+    const result = await addon.encodeWebPBatchAsync([], width, height, width * 4);
+
+    expect(result.frames).to.be.an('array').that.is.empty;
+    expect(result.failedFrames).to.equal(0);
+  });
+
+  it('should reject invalid params for the whole batch', async function() {
+    const frames = [createGradientFrame(16, 16, 0)];
+    let error;
+    try {
+      await addon.encodeWebPBatchAsync(frames, 16, 16, 16 * 4, { quality: 150 });
+    } catch (e) {
+      error = e;
+    }
+    expect(error).to.be.instanceOf(Error);
+  });
+});
@@ -0,0 +1,45 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+const { expectWebP, createGradientFrame } = require('../webp-helpers');
+
+describe('Encode Budget Unit Tests', function() {
+  this.timeout(20000);
+
+  const width = 640;
+  const height = 480;
+
+  it('should still produce a WebP under a budget no encode can meet', function() {
+    const webp = addon.encodeWebP(createGradientFrame(width, height), width, height, width * 4,
+      { method: 6, maxEncodeMs: 0.01 });
+
+    expectWebP(webp);
+  });
+
+  it('should encode normally with a generous budget', async function() {
+    const webp = await addon.encodeWebPAsync(createGradientFrame(width, height), width, height,
+      width * 4, { method: 4, maxEncodeMs: 10000 });
+
+    expectWebP(webp);
+  });
+
+  it('should combine with content-adaptive encoding', function() {
+    const webp = addon.encodeWebP(createGradientFrame(width, height), width, height, width * 4,
+      { contentAdaptive: 1, maxEncodeMs: 50 });
+
+    expectWebP(webp);
+  });
+
+  it('should reject a negative budget', function() {
+    const pixels = createGradientFrame(16, 16);
+    expect(() => addon.encodeWebP(pixels, 16, 16, 16 * 4, { maxEncodeMs: -1 }))
+      .to.throw(/max_encode_ms/);
+  });
+});
@@ -0,0 +1,63 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+const { expectWebP, createGradientFrame } = require('../webp-helpers');
+
+describe('Encode Into Unit Tests', function() {
+  this.timeout(20000);
+
+  const width = 320;
+  const height = 240;
+  const pixels = createGradientFrame(width, height);
+
+  it('should write the file into a large enough buffer', function() {
+    const output = Buffer.alloc(width * height * 4);
+    const result = addon.encodeWebPInto(output, pixels, width, height, width * 4, { quality: 80 });
+
+    expect(result.bytesWritten).to.be.greaterThan(0);
+    expect(result.requiredSize).to.equal(result.bytesWritten);
+    expectWebP(output.subarray(0, result.bytesWritten));
+  });
+
+  it('should report the required size when the buffer is too small', function() {
+    const output = Buffer.alloc(16);
+    const result = addon.encodeWebPInto(output, pixels, width, height, width * 4, { quality: 80 });
+
+    expect(result.bytesWritten).to.equal(0);
+    expect(result.requiredSize).to.be.greaterThan(output.length);
+
+    const grown = Buffer.alloc(result.requiredSize);
+    const retried = addon.encodeWebPInto(grown, pixels, width, height, width * 4, { quality: 80 });
+    expect(retried.bytesWritten).to.equal(result.requiredSize);
+  });
+
+  it('should keep a lossy encode under maxOutputSize', function() {
+    const unbounded = addon.encodeWebP(pixels, width, height, width * 4, { quality: 100 });
+    const cap = Math.floor(unbounded.length / 2);
+    const webp = addon.encodeWebP(pixels, width, height, width * 4, { quality: 100, maxOutputSize: cap });
+
+    expectWebP(webp);
+    expect(webp.length).to.be.at.most(cap);
+  });
+
+  it('should fit a buffer sized to maxOutputSize', function() {
+    const output = Buffer.alloc(4096);
+    const result = addon.encodeWebPInto(output, pixels, width, height, width * 4,
+      { quality: 90, maxOutputSize: output.length });
+
+    expect(result.bytesWritten).to.be.greaterThan(0);
+    expect(result.bytesWritten).to.be.at.most(output.length);
+  });
+
+  it('should reject a negative maxOutputSize', function() {
+    expect(() => addon.encodeWebP(pixels, width, height, width * 4, { maxOutputSize: -1 }))
+      .to.throw(/max_output_size/);
+  });
+});
@@ -0,0 +1,64 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+const { expectWebP, createGradientFrame } = require('../webp-helpers');
+
+describe('Multi-Resolution Encoding Unit Tests', function() {
+  this.timeout(30000);
+
+  const width = 640;
+  const height = 480;
+  const pixels = createGradientFrame(width, height);
+
+  it('should encode full size, half size and a thumbnail in one call', async function() {
+    const levels = await addon.encodeMultiResolutionAsync(pixels, width, height, width * 4, [
+      { scale: 1, quality: 80 },
+      { scale: 0.5, quality: 70 },
+      { scale: 1, maxDimension: 256, quality: 60 }
+    ]);
+
+    expect(levels).to.have.length(3);
+    expect(levels[0].width).to.equal(640);
+    expect(levels[0].height).to.equal(480);
+    expect(levels[1].width).to.equal(320);
+    expect(levels[1].height).to.equal(240);
+    expect(levels[2].width).to.equal(256);
+    expect(levels[2].height).to.equal(192);
+    expect(levels[1].scaleFactor).to.equal(0.5);
+    levels.forEach(level => {
+      expect(level.error).to.be.null;
+      expectWebP(level.data);
+    });
+  });
+
+  it('should report a failed level without failing the others', async function() {
+    const levels = await addon.encodeMultiResolutionAsync(pixels, width, height, width * 4, [
+      { scale: 0.5 },
+      { scale: 2 },
+      { scale: 0.25, lossless: 1 }
+    ]);
+
+    expectWebP(levels[0].data);
+    expect(levels[1].data).to.be.null;
+    expect(levels[1].error).to.be.a('string');
+    expect(levels[2].data).to.be.null;
+    expect(levels[2].error).to.be.a('string');
+  });
+
+  it('should reject a buffer smaller than the frame', async function() {
+    let error;
+    try {
+      await addon.encodeMultiResolutionAsync(Buffer.alloc(16), width, height, width * 4, [{ scale: 1 }]);
+    } catch (e) {
+      error = e;
+    }
+    expect(error).to.be.instanceOf(Error);
+  });
+});
@@ -0,0 +1,73 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+const STAGES = ['capture', 'readback', 'convert', 'encode', 'marshal'];
+
+describe('Performance Stats Unit Tests', function() {
+  this.timeout(10000);
+
+  beforeEach(function() {
+    addon.resetPerformanceStats();
+  });
+
+  it('should report every stage with the same fields', function() {
+    const stats = addon.getPerformanceStats();
+
+    expect(stats.stages).to.have.all.keys(...STAGES);
+    STAGES.forEach(stage => {
+      expect(stats.stages[stage]).to.include.all.keys(
+        'count', 'totalMs', 'meanUs', 'minUs', 'maxUs', 'p50Us', 'p90Us', 'p99Us', 'p999Us');
+    });
+    expect(stats).to.include.all.keys(
+      'frames', 'bytesCopied', 'bytesCopiedPerFrame', 'allocations',
+      'allocatedBytes', 'allocationsPerFrame', 'elapsedSeconds', 'memoryPool');
+  });
+
+  it('should record encode latency with ordered percentiles', async function() {
+    const width = 64;
+    const height = 64;
+    const pixels = Buffer.alloc(width * height * 4, 0x80);
+
+    for (let i = 0; i < 5; i++) {
+      await addon.encodeWebPAsync(pixels, width, height, width * 4, { quality: 75 });
+    }
+
+    const encode = addon.getPerformanceStats().stages.encode;
+    expect(encode.count).to.be.at.least(5);
+    expect(encode.minUs).to.be.at.most(encode.p50Us);
+    expect(encode.p50Us).to.be.at.most(encode.p99Us);
+    expect(encode.p99Us).to.be.at.most(encode.maxUs);
+    expect(encode.totalMs).to.be.greaterThan(0);
+  });
+
+  it('should count frames handed to JavaScript', async function() {
+    const result = await addon.captureScreenshotAsync({ display: 0 });
+    if (!result.success) {
+      this.skip();
+    }
+
+    const stats = addon.getPerformanceStats();
+    expect(stats.frames).to.be.at.least(1);
+    expect(stats.bytesCopiedPerFrame).to.equal(stats.bytesCopied / stats.frames);
+  });
+
+  it('should clear histograms and counters on reset', async function() {
+    const pixels = Buffer.alloc(16 * 16 * 4, 0x40);
+    await addon.encodeWebPAsync(pixels, 16, 16, 16 * 4, {});
+
+    addon.resetPerformanceStats();
+    const stats = addon.getPerformanceStats();
+    STAGES.forEach(stage => {
+      expect(stats.stages[stage].count).to.equal(0);
+    });
+    expect(stats.frames).to.equal(0);
+    expect(stats.bytesCopied).to.equal(0);
+  });
+});
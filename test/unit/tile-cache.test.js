@@ -0,0 +1,96 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+// The cache lives for the whole process, so every test draws its own pixels
+let nextSeed = Date.now() & 0xFFFF;
+
+// Noise, so no two tiles of a frame are alike
+function createFrame(width, height) {
+  let state = (nextSeed++ * 2654435761) >>> 0;
+  const pixels = Buffer.alloc(width * height * 4);
+  for (let i = 0; i < pixels.length; i += 4) {
+    state = (Math.imul(state, 1664525) + 1013904223) >>> 0;
+    pixels[i] = state >>> 24;
+    pixels[i + 1] = (state >>> 16) & 0xFF;
+    pixels[i + 2] = (state >>> 8) & 0xFF;
+    pixels[i + 3] = 255;
+  }
+  return pixels;
+}
+
+describe('Tile Cache Unit Tests', function() {
+  this.timeout(20000);
+
+  // 3 x 2 tiles of the 256 px cache grid
+  const width = 640;
+  const height = 480;
+  const stride = width * 4;
+
+  beforeEach(function() {
+    addon.resetPerformanceStats();
+  });
+
+  it('should return the previous bytes for an identical frame', function() {
+    const pixels = createFrame(width, height);
+    const first = addon.encodeWebP(pixels, width, height, stride, { tileCache: 1 });
+    const second = addon.encodeWebP(pixels, width, height, stride, { tileCache: 1 });
+
+    expect(second.equals(first)).to.be.true;
+    const cache = addon.getPerformanceStats().tileCache;
+    expect(cache.frameHits).to.equal(1);
+    expect(cache.frameMisses).to.equal(1);
+    expect(cache.frameHitRate).to.equal(0.5);
+  });
+
+  it('should re-encode only the tiles that changed', function() {
+    const pixels = createFrame(width, height);
+    addon.encodeWebP(pixels, width, height, stride, { tileCache: 1 });
+
+    // Inside the first tile only
+    for (let y = 10; y < 40; y++) {
+      for (let x = 10; x < 40; x++) {
+        pixels[(y * width + x) * 4] ^= 0xFF;
+      }
+    }
+    const webp = addon.encodeWebP(pixels, width, height, stride, { tileCache: 1 });
+
+    expect(webp.toString('ascii', 0, 4)).to.equal('RIFF');
+    const cache = addon.getPerformanceStats().tileCache;
+    expect(cache.tileHits).to.equal(5);
+    expect(cache.tileMisses).to.equal(7);
+    expect(cache.frameHits).to.equal(0);
+  });
+
+  it('should not reuse tiles encoded with other settings', function() {
+    const pixels = createFrame(width, height);
+    addon.encodeWebP(pixels, width, height, stride, { tileCache: 1, quality: 80 });
+    addon.encodeWebP(pixels, width, height, stride, { tileCache: 1, quality: 60 });
+
+    const cache = addon.getPerformanceStats().tileCache;
+    expect(cache.tileHits).to.equal(0);
+    expect(cache.frameHits).to.equal(0);
+  });
+
+  it('should report cache occupancy', function() {
+    const pixels = createFrame(width, height);
+    addon.encodeWebP(pixels, width, height, stride, { tileCache: 1 });
+
+    const cache = addon.getPerformanceStats().tileCache;
+    expect(cache.evictions).to.be.a('number');
+    expect(cache.entries).to.be.at.least(1);
+    expect(cache.bytes).to.be.at.most(cache.maxBytes);
+  });
+
+  it('should reject an invalid tileCache value', function() {
+    const pixels = createFrame(16, 16);
+    expect(() => addon.encodeWebP(pixels, 16, 16, 16 * 4, { tileCache: 2 }))
+      .to.throw(/tile_cache/);
+  });
+});
@@ -0,0 +1,59 @@
+const { expect } = require('chai');
+
+let addon;
+try {
+  addon = require('../../build/Release/webp_screenshot');
+} catch (error) {
+  console.log('Using mock addon for testing infrastructure');
+  addon = require('../mock-addon');
+}
+
+describe('Warmup Unit Tests', function() {
+  this.timeout(20000);
+
+  it('should report every step it ran', async function() {
+    const report = await addon.warmup();
+
+    expect(report.encoderReady).to.be.true;
+    expect(report.gpuReady).to.be.a('boolean');
+    expect(report.captureReady).to.be.a('boolean');
+    expect(report.captureBackend).to.be.a('string');
+    for (const key of ['encoderMs', 'gpuMs', 'captureMs']) {
+      expect(report[key]).to.be.a('number');
+      expect(report[key]).to.be.at.least(0);
+    }
+  });
+
+  it('should keep the first outcome of each step', async function() {
+    const first = await addon.warmup();
+    const second = await addon.warmup();
+
+    expect(second.encoderReady).to.equal(first.encoderReady);
+    expect(second.gpuReady).to.equal(first.gpuReady);
+    expect(second.captureReady).to.equal(first.captureReady);
+  });
+
+  it('should skip disabled steps', async function() {
+    const report = await addon.warmup({ encoder: false, gpu: false, capture: false });
+
+    expect(report.encoderReady).to.be.false;
+    expect(report.gpuReady).to.be.false;
+    expect(report.captureReady).to.be.false;
+    expect(report.encoderMs).to.equal(0);
+  });
+
+  it('should accept a Node-style callback', function(done) {
+    addon.warmup({ capture: false }, (error, report) => {
+      expect(error).to.be.null;
+      expect(report.encoderReady).to.be.true;
+      done();
+    });
+  });
+
+  it('should not count as a captured frame', async function() {
+    addon.resetPerformanceStats();
+    await addon.warmup();
+
+    expect(addon.getPerformanceStats().frames).to.equal(0);
+  });
+});
@@ -0,0 +1,26 @@
+// Shared helpers for the encoder unit tests
+const { expect } = require('chai');
+
+function expectWebP(webp) {
+  expect(Buffer.isBuffer(webp)).to.be.true;
+  expect(webp.toString('ascii', 0, 4)).to.equal('RIFF');
+  expect(webp.toString('ascii', 8, 12)).to.equal('WEBP');
+}
+
+// Horizontal and vertical ramps with an XOR pattern in blue; a different
+// seed shifts the frame, so batches get distinct frames of the same size
+function createGradientFrame(width, height, seed = 0) {
+  const pixels = Buffer.alloc(width * height * 4);
+  for (let y = 0; y < height; y++) {
+    for (let x = 0; x < width; x++) {
+      const i = (y * width + x) * 4;
+      pixels[i] = ((x + seed * 13) * 255 / width) & 0xFF;
+      pixels[i + 1] = (y * 255 / height) & 0xFF;
+      pixels[i + 2] = ((x ^ y ^ seed) * 7) & 0xFF;
+      pixels[i + 3] = 255;
+    }
+  }
+  return pixels;
+}
+
+module.exports = { expectWebP, createGradientFrame };